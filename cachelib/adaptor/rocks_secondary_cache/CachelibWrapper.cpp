@@ -17,6 +17,7 @@
 #include "cachelib/adaptor/rocks_secondary_cache/CachelibWrapper.h"
 
 #include "cachelib/facebook/utils/FbInternalRuntimeUpdateWrapper.h"
+#include "folly/futures/Future.h"
 #include "folly/init/Init.h"
 #include "folly/synchronization/Rcu.h"
 #include "rocksdb/version.h"
@@ -37,11 +38,11 @@ folly::rcu_domain& GetRcuDomain() {
 
 class RocksCachelibWrapperHandle : public rocksdb::SecondaryCacheResultHandle {
  public:
-  RocksCachelibWrapperHandle(folly::SemiFuture<FbCacheReadHandle>&& future,
+  RocksCachelibWrapperHandle(FbCacheReadHandle&& handle,
                              const rocksdb::Cache::CacheItemHelper* helper,
                              rocksdb::Cache::CreateContext* create_context,
                              std::unique_lock<folly::rcu_domain>&& guard)
-      : future_(std::move(future)),
+      : handle_(std::move(handle)),
         helper_(helper),
         create_context_(create_context),
         val_(nullptr),
@@ -55,49 +56,45 @@ class RocksCachelibWrapperHandle : public rocksdb::SecondaryCacheResultHandle {
       delete;
 
   bool IsReady() override {
-    bool ready = true;
-    if (!is_value_ready_) {
-      ready = future_.isReady();
-      if (ready) {
-        handle_ = std::move(future_).value();
-        CalcValue();
-      }
+    if (!is_value_ready_ && handle_.isReady()) {
+      CalcValue();
     }
-    return ready;
+    return is_value_ready_;
   }
 
   void Wait() override {
     if (!is_value_ready_) {
-      future_.wait();
-      handle_ = std::move(future_).value();
+      handle_.wait();
       CalcValue();
     }
   }
 
+  // The lookups that missed in DRAM are already in flight on the navy
+  // threads. Rather than blocking on them one by one, hook a promise to each
+  // through ReadHandle::onReady and block once until all of them are
+  // fulfilled. The values are created on this thread afterwards.
   static void WaitAll(
       std::vector<rocksdb::SecondaryCacheResultHandle*> handles) {
-    std::vector<folly::SemiFuture<FbCacheReadHandle>> h_semi;
+    std::vector<RocksCachelibWrapperHandle*> pending;
+    std::vector<folly::SemiFuture<FbCacheReadHandle>> futures;
     for (auto h_ptr : handles) {
       RocksCachelibWrapperHandle* hdl =
           static_cast<RocksCachelibWrapperHandle*>(h_ptr);
-      if (hdl->is_value_ready_) {
+      if (hdl->IsReady()) {
         continue;
       }
-      h_semi.emplace_back(std::move(hdl->future_));
+      pending.push_back(hdl);
+      futures.emplace_back(std::move(hdl->handle_).toSemiFuture());
     }
-    auto all_handles = folly::collectAll(std::move(h_semi));
-    auto new_handles = std::move(all_handles).get();
-    assert(new_handles.size() == h_semi.size());
-    int result_idx = 0;
-    for (size_t i = 0; i < handles.size(); ++i) {
-      RocksCachelibWrapperHandle* hdl =
-          static_cast<RocksCachelibWrapperHandle*>(handles[i]);
-      if (hdl->is_value_ready_) {
-        continue;
-      }
-      hdl->handle_ = std::move(new_handles[result_idx]).value();
-      result_idx++;
-      hdl->CalcValue();
+    if (futures.empty()) {
+      return;
+    }
+
+    auto results = folly::collectAll(std::move(futures)).get();
+    assert(results.size() == pending.size());
+    for (size_t i = 0; i < pending.size(); ++i) {
+      pending[i]->handle_ = std::move(results[i]).value();
+      pending[i]->CalcValue();
     }
   }
 
@@ -107,7 +104,6 @@ class RocksCachelibWrapperHandle : public rocksdb::SecondaryCacheResultHandle {
 
  private:
   FbCacheReadHandle handle_;
-  folly::SemiFuture<FbCacheReadHandle> future_;
   const rocksdb::Cache::CacheItemHelper* const helper_;
   rocksdb::Cache::CreateContext* const create_context_;
   void* val_;
@@ -189,23 +185,20 @@ RocksCachelibWrapper::Lookup(const rocksdb::Slice& key,
 
   if (cache) {
     auto handle = cache->find(FbCacheKey(key.data(), key.size()));
-    // We cannot dereference the handle in anyway. Any dereference will make it
-    // synchronous, so get the SamiFuture right away
+    // We cannot dereference the handle in anyway before it is ready. Any
+    // dereference will make it synchronous. A DRAM hit or a miss is ready
+    // right away; a lookup that went to flash is waited on through Wait() or
+    // WaitAll().
     // std::move the std::unique_lock<rcu_domain> (reader lock) to the
     // RocksCachelibWrapperHandle, and will be released when the handle is
     // destroyed.
     hdl = std::make_unique<RocksCachelibWrapperHandle>(
-        std::move(handle).toSemiFuture(),
-        helper,
-        create_context,
-        std::move(guard));
-    if (hdl->IsReady() || wait) {
-      if (!hdl->IsReady()) { // WART: double-call IsReady()
-        hdl->Wait();
-      }
-      if (hdl->Value() == nullptr) {
-        hdl.reset();
-      }
+        std::move(handle), helper, create_context, std::move(guard));
+    if (wait) {
+      hdl->Wait();
+    }
+    if (hdl->IsReady() && hdl->Value() == nullptr) {
+      hdl.reset();
     }
   }
 
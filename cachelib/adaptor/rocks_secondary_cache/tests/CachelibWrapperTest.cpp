@@ -272,6 +272,55 @@ TEST_F(CachelibWrapperTest, WaitAllTest) {
   }
 }
 
+TEST_F(CachelibWrapperTest, WaitAllMixedTest) {
+  // Items inserted first spill into the cache file, the last ones stay in
+  // DRAM. A batch that mixes both must complete the DRAM hits right away and
+  // the flash hits in WaitAll().
+  int num_blocks = kVolatileSize / 1020 + 200;
+  std::vector<TestItem> items;
+  for (int i = 0; i < num_blocks; ++i) {
+    std::string str = RandomString(1020);
+    items.emplace_back(str.data(), str.length());
+    ASSERT_EQ(cache()->Insert("k" + std::to_string(i),
+                              &items.back(),
+                              &CachelibWrapperTest::helper_,
+                              /*force_insert=*/false),
+              Status::OK());
+  }
+
+  std::vector<int> blocks;
+  for (int i = 0; i < 50; ++i) {
+    blocks.push_back(i);
+    blocks.push_back(num_blocks - 1 - i);
+  }
+  std::vector<std::unique_ptr<SecondaryCacheResultHandle>> handles;
+  std::vector<SecondaryCacheResultHandle*> handle_ptrs;
+  for (int block : blocks) {
+    bool is_in_sec_cache{false};
+    handles.emplace_back(CacheLookup("k" + std::to_string(block),
+                                     /*wait=*/false,
+                                     /*advise_erase=*/false, is_in_sec_cache));
+    ASSERT_NE(handles.back(), nullptr);
+    handle_ptrs.emplace_back(handles.back().get());
+  }
+  // the last inserted item is a DRAM hit
+  ASSERT_TRUE(handles.back()->IsReady());
+
+  cache()->WaitAll(handle_ptrs);
+  // waiting again on completed handles is a no-op
+  cache()->WaitAll(handle_ptrs);
+  for (size_t i = 0; i < handles.size(); ++i) {
+    ASSERT_TRUE(handles[i]->IsReady());
+    TestItem* item = static_cast<TestItem*>(handles[i]->Value());
+    ASSERT_NE(item, nullptr);
+    ASSERT_EQ(item->Size(), items[blocks[i]].Size());
+    ASSERT_EQ(
+        memcmp(item->Buf(), items[blocks[i]].Buf(), items[blocks[i]].Size()),
+        0);
+    delete item;
+  }
+}
+
 TEST_F(CachelibWrapperTest, CreateFailTest) {
   std::string str1 = RandomString(1020);
   TestItem item1(str1.data(), str1.length());
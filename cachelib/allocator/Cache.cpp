@@ -166,6 +166,11 @@ void CacheBase::updateCompactCacheStats(const std::string& statPrefix,
   counters_.updateDelta(prefix + "timeout.lock", stats.lockTimeout);
   counters_.updateDelta(prefix + "timeout.promote", stats.promoteTimeout);
 
+  counters_.updateDelta(prefix + "resize.migrate.access",
+                        stats.resizeMigrationsOnAccess);
+  counters_.updateDelta(prefix + "resize.migrate.sweep",
+                        stats.resizeMigrationsSwept);
+
   const double hitRate =
       util::hitRatioCalc(counters_.getDelta(prefix + "get.total"),
                          counters_.getDelta(prefix + "get.miss"));
@@ -411,6 +416,8 @@ void CacheBase::updateGlobalCacheStats(const std::string& statPrefix) const {
                           stats.numNvmGetMissExpired);
     counters_.updateDelta(statPrefix + "nvm.gets.coalesced",
                           stats.numNvmGetCoalesced);
+    counters_.updateDelta(statPrefix + "nvm.gets.transient",
+                          stats.numNvmGetTransient);
 
     counters_.updateDelta(statPrefix + "nvm.puts", stats.numNvmPuts);
     counters_.updateDelta(statPrefix + "nvm.puts.clean",
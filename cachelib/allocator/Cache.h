@@ -36,6 +36,7 @@ class PoolResizer;
 class PoolRebalancer;
 class PoolOptimizer;
 class MemoryMonitor;
+class StatsSeriesWriter;
 
 // Forward declaration.
 class RebalanceStrategy;
@@ -115,6 +116,9 @@ class CacheBase {
     return {};
   }
 
+  // sink for the stats time series, or nullptr if none is configured
+  virtual StatsSeriesWriter* getStatsSeries() const { return nullptr; }
+
   // @param poolId   the pool id
   virtual AllSlabReleaseEvents getAllSlabReleaseEvents(PoolId poolId) const = 0;
 
@@ -31,6 +31,7 @@
 #include <mutex>
 #include <optional>
 #include <stdexcept>
+#include <type_traits>
 #include <utility>
 
 #pragma GCC diagnostic push
@@ -75,12 +76,14 @@
 #include "cachelib/common/Exceptions.h"
 #include "cachelib/common/Hash.h"
 #include "cachelib/common/Mutex.h"
+#include "cachelib/common/PerfCounters.h"
 #include "cachelib/common/PeriodicWorker.h"
 #include "cachelib/common/Serialization.h"
 #include "cachelib/common/Shards.h"
 #include "cachelib/common/Throttler.h"
 #include "cachelib/common/Time.h"
 #include "cachelib/common/Utils.h"
+#include "cachelib/common/ExactMrc.h"
 #include "cachelib/common/FootprintMRC.h"
 #include "cachelib/shm/ShmManager.h"
 
@@ -88,6 +91,18 @@ namespace facebook::cachelib {
 
 using folly::fibers::TimedMutex;
 
+namespace detail {
+// true if the MMContainer can add a node at the cold end of its queues
+template <typename MMContainer, typename Node, typename = void>
+struct HasAddCold : std::false_type {};
+
+template <typename MMContainer, typename Node>
+struct HasAddCold<MMContainer,
+                  Node,
+                  std::void_t<decltype(std::declval<MMContainer&>().addCold(
+                      std::declval<Node&>()))>> : std::true_type {};
+} // namespace detail
+
 template <typename AllocatorT>
 class FbInternalRuntimeUpdateWrapper;
 
@@ -1004,6 +1019,14 @@ class CacheAllocator : public CacheBase {
   
   const FootprintMRC* getFootprintMrcForPool(PoolId) const override;                                                                      
 
+  // exact per-class miss ratio curves of the pool, or nullptr if
+  // enableExactMrc is not set
+  const ExactMrc* getExactMrcForPool(PoolId pid) const;
+
+  StatsSeriesWriter* getStatsSeries() const override {
+    return config_.statsSeries.get();
+  }
+
   std::unordered_map<uint64_t, uint64_t> queryShardsHistogram(
       PoolId pid, ClassId cid) const override;
 
@@ -1653,9 +1676,11 @@ class CacheAllocator : public CacheBase {
   // the item.
   //
   // @param  item  Item that we want to insert.
+  // @param  cold  insert the item where it is evicted first unless it is
+  //               accessed again, if the MMContainer supports it.
   //
   // @throw std::runtime_error if the handle is already in the mm container
-  void insertInMMContainer(Item& item);
+  void insertInMMContainer(Item& item, bool cold = false);
 
   // Removes an item from the corresponding MMContainer if it is in the
   // container. The caller must hold a valid handle for the item.
@@ -1704,12 +1729,16 @@ class CacheAllocator : public CacheBase {
   //              insert call, and INSERT_FROM_NVM, cooresponding to the insert
   //              call that happens when an item is promoted from NVM storage
   //              to memory.
+  // @param cold  insert the item into the MMContainer where it is evicted
+  //              first, see insertInMMContainer.
   //
   // @return true if the handle was successfully inserted into the hashtable
   //         and is now accessible to everyone. False if there was an error.
   //
   // @throw std::invalid_argument if the handle is already accessible or invalid
-  bool insertImpl(const WriteHandle& handle, AllocatorApiEvent event);
+  bool insertImpl(const WriteHandle& handle,
+                  AllocatorApiEvent event,
+                  bool cold = false);
 
   // Removes an item from the access container and MM container.
   //
@@ -2001,6 +2030,12 @@ class CacheAllocator : public CacheBase {
                                                        const std::string name,
                                                        AccessConfig config);
 
+  // creates the shm segment that the writers of the main access container
+  // stamp their bucket locks in, so that ReadOnlySharedCacheView can look up
+  // items without locks. The stamps do not need to survive restarts, so the
+  // segment is created anew on every start.
+  void initBucketStamps(AccessContainer& container, const AccessConfig& config);
+
   std::optional<bool> saveNvmCache();
   void saveRamCache();
 
@@ -2261,6 +2296,8 @@ class CacheAllocator : public CacheBase {
 
   std::unordered_map<PoolId, FootprintMRC> footprintMRCs_;
 
+  std::unordered_map<PoolId, std::unique_ptr<ExactMrc>> exactMrcs_;
+
   // lock to serilize access of isCompactCachePool_ array, including creation of
   // compact cache pools
   mutable folly::SharedMutex compactCachePoolsLock_;
@@ -2511,6 +2548,9 @@ void CacheAllocator<CacheTrait>::initCommon(bool dramCacheAttached) {
       }
       nvmAdmissionPolicy_->initMinTTL(config_.nvmAdmissionMinTTL);
     }
+    if (nvmAdmissionPolicy_) {
+      nvmAdmissionPolicy_->initCache(*this);
+    }
   }
   initStats();
   initNvmCache(dramCacheAttached);
@@ -2627,8 +2667,11 @@ CacheAllocator<CacheTrait>::initAccessContainer(InitMemType type,
     return std::make_unique<AccessContainer>(
         config, compressor_,
         [this](Item* it) -> WriteHandle { return acquire(it); });
-  } else if (type == InitMemType::kMemNew) {
-    return std::make_unique<AccessContainer>(
+  }
+
+  std::unique_ptr<AccessContainer> container;
+  if (type == InitMemType::kMemNew) {
+    container = std::make_unique<AccessContainer>(
         config,
         shmManager_
             ->createShm(
@@ -2640,7 +2683,7 @@ CacheAllocator<CacheTrait>::initAccessContainer(InitMemType type,
         compressor_,
         [this](Item* it) -> WriteHandle { return acquire(it); });
   } else if (type == InitMemType::kMemAttach) {
-    return std::make_unique<AccessContainer>(
+    container = std::make_unique<AccessContainer>(
         deserializer_->deserialize<AccessSerializationType>(),
         config,
         shmManager_->attachShm(name),
@@ -2648,12 +2691,30 @@ CacheAllocator<CacheTrait>::initAccessContainer(InitMemType type,
         [this](Item* it) -> WriteHandle { return acquire(it); });
   }
 
+  if (container) {
+    if (name == detail::kShmHashTableName &&
+        config_.isSharedCacheViewLookupEnabled()) {
+      initBucketStamps(*container, config);
+    }
+    return container;
+  }
+
   // Invalid type
   throw std::runtime_error(folly::sformat(
       "Cannot initialize access container, unknown InitMemType: {}.",
       static_cast<int>(type)));
 }
 
+template <typename CacheTrait>
+void CacheAllocator<CacheTrait>::initBucketStamps(AccessContainer& container,
+                                                  const AccessConfig& config) {
+  const auto size =
+      AccessType::BucketStamps::getRequiredSize(config.getLocksPower());
+  shmManager_->removeShm(detail::kShmHashTableStampsName);
+  auto addr = shmManager_->createShm(detail::kShmHashTableStampsName, size);
+  container.enableBucketStamps(addr.addr);
+}
+
 template <typename CacheTrait>
 std::unique_ptr<Deserializer> CacheAllocator<CacheTrait>::createDeserializer() {
   auto infoAddr = shmManager_->attachShm(detail::kShmInfoName);
@@ -2691,6 +2752,7 @@ CacheAllocator<CacheTrait>::allocateInternal(PoolId pid,
                                              uint32_t expiryTime,
                                              bool fromBgThread) {
   util::LatencyTracker tracker{stats().allocateLatency_};
+  PerfRegionScope perfScope{PerfRegion::kAllocate};
 
   SCOPE_FAIL { stats_.invalidAllocs.inc(); };
 
@@ -3365,23 +3427,37 @@ bool CacheAllocator<CacheTrait>::replaceChainedItemInMMContainer(
 }
 
 template <typename CacheTrait>
-void CacheAllocator<CacheTrait>::insertInMMContainer(Item& item) {
+void CacheAllocator<CacheTrait>::insertInMMContainer(Item& item, bool cold) {
   XDCHECK(!item.isInMMContainer());
   auto& mmContainer = getMMContainer(item);
-  if (!mmContainer.add(item)) {
+  bool added = false;
+  if constexpr (detail::HasAddCold<MMContainer, Item>::value) {
+    added = cold ? mmContainer.addCold(item) : mmContainer.add(item);
+  } else {
+    added = mmContainer.add(item);
+  }
+  if (!added) {
     throw std::runtime_error(folly::sformat(
         "Invalid state. Node {} was already in the container.", &item));
   }
-  if (config_.enableShardsMrc) {
-    const auto allocInfo =
-        allocator_->getAllocInfo(static_cast<const void*>(&item));
-    poolClassToShards_[allocInfo.poolId][allocInfo.classId]->feed(
-        HashedKey(item.getKey()));
-  }
-  if (config_.enableFootPrintMrc){
-    const auto allocInfo =
-        allocator_->getAllocInfo(static_cast<const void*>(&item));
-    footprintMRCs_[allocInfo.poolId].feed(item.getKey(), allocInfo.classId);
+  {
+    PerfRegionScope perfScope{PerfRegion::kMrcFeed};
+    if (config_.enableShardsMrc) {
+      const auto allocInfo =
+          allocator_->getAllocInfo(static_cast<const void*>(&item));
+      poolClassToShards_[allocInfo.poolId][allocInfo.classId]->feed(
+          HashedKey(item.getKey()));
+    }
+    if (config_.enableFootPrintMrc) {
+      const auto allocInfo =
+          allocator_->getAllocInfo(static_cast<const void*>(&item));
+      footprintMRCs_[allocInfo.poolId].feed(item.getKey(), allocInfo.classId);
+    }
+    if (config_.enableExactMrc) {
+      const auto allocInfo =
+          allocator_->getAllocInfo(static_cast<const void*>(&item));
+      exactMrcs_[allocInfo.poolId]->feed(item.getKey(), allocInfo.classId);
+    }
   }
 }
 
@@ -3404,7 +3480,8 @@ bool CacheAllocator<CacheTrait>::insert(const WriteHandle& handle) {
 
 template <typename CacheTrait>
 bool CacheAllocator<CacheTrait>::insertImpl(const WriteHandle& handle,
-                                            AllocatorApiEvent event) {
+                                            AllocatorApiEvent event,
+                                            bool cold) {
   XDCHECK(handle);
   XDCHECK(event == AllocatorApiEvent::INSERT ||
           event == AllocatorApiEvent::INSERT_FROM_NVM);
@@ -3418,7 +3495,7 @@ bool CacheAllocator<CacheTrait>::insertImpl(const WriteHandle& handle,
 
   // insert into the MM container before we make it accessible. Find will
   // return this item as soon as it is accessible.
-  insertInMMContainer(*(handle.getInternal()));
+  insertInMMContainer(*(handle.getInternal()), cold);
 
   AllocatorApiResult result;
   if (!accessContainer_->insert(*(handle.getInternal()))) {
@@ -3764,6 +3841,7 @@ CacheAllocator<CacheTrait>::getNextCandidate(PoolId pid,
 template <typename CacheTrait>
 typename CacheAllocator<CacheTrait>::Item*
 CacheAllocator<CacheTrait>::findEviction(PoolId pid, ClassId cid) {
+  PerfRegionScope perfScope{PerfRegion::kFindEviction};
   // Keep searching for a candidate until we were able to evict it
   // or until the search limit has been exhausted
   unsigned int searchTries = 0;
@@ -4197,6 +4275,7 @@ CacheAllocator<CacheTrait>::findFastToWrite(typename Item::Key key) {
 template <typename CacheTrait>
 typename CacheAllocator<CacheTrait>::WriteHandle
 CacheAllocator<CacheTrait>::findImpl(typename Item::Key key, AccessMode mode) {
+  PerfRegionScope perfScope{PerfRegion::kFind};
   auto handle = findInternalWithExpiration(key, AllocatorApiEvent::FIND);
   if (handle) {
     markUseful(handle, mode);
@@ -4210,8 +4289,9 @@ CacheAllocator<CacheTrait>::findImpl(typename Item::Key key, AccessMode mode) {
   // Hybrid-cache's dram miss-path. Handle becomes async once we look up from
   // nvm-cache. Naively accessing the memory directly after this can be slow.
   // We also don't need to call `markUseful()` as if we have a hit, we will
-  // have promoted this item into DRAM cache at the front of eviction queue.
-  return nvmCache_->find(HashedKey{key});
+  // have promoted this item into DRAM cache, or returned it without inserting
+  // it. Lookups to write always promote the item.
+  return nvmCache_->find(HashedKey{key}, mode);
 }
 
 template <typename CacheTrait>
@@ -4258,13 +4338,20 @@ bool CacheAllocator<CacheTrait>::recordAccessInMMContainer(Item& item,
   const auto allocInfo =
       allocator_->getAllocInfo(static_cast<const void*>(&item));
   (*stats_.cacheHits)[allocInfo.poolId][allocInfo.classId].inc();
-  if (config_.enableShardsMrc) {
-    poolClassToShards_[allocInfo.poolId][allocInfo.classId]->feed(
-        HashedKey(item.getKey()));
-  }
+  {
+    PerfRegionScope perfScope{PerfRegion::kMrcFeed};
+    if (config_.enableShardsMrc) {
+      poolClassToShards_[allocInfo.poolId][allocInfo.classId]->feed(
+          HashedKey(item.getKey()));
+    }
 
-  if(config_.enableFootPrintMrc) {
-    footprintMRCs_[allocInfo.poolId].feed(item.getKey(), allocInfo.classId);
+    if (config_.enableFootPrintMrc) {
+      footprintMRCs_[allocInfo.poolId].feed(item.getKey(), allocInfo.classId);
+    }
+
+    if (config_.enableExactMrc) {
+      exactMrcs_[allocInfo.poolId]->feed(item.getKey(), allocInfo.classId);
+    }
   }
 
   // track recently accessed items if needed
@@ -4273,6 +4360,7 @@ bool CacheAllocator<CacheTrait>::recordAccessInMMContainer(Item& item,
   }
 
   auto& mmContainer = getMMContainer(allocInfo.poolId, allocInfo.classId);
+  PerfRegionScope perfScope{PerfRegion::kRecordAccess};
   return mmContainer.recordAccess(item, mode);
 }
 
@@ -4530,6 +4618,18 @@ PoolId CacheAllocator<CacheTrait>::addPool(
   if(config_.enableFootPrintMrc) {
     footprintMRCs_[pid] = FootprintMRC(config_.footprintBufferSize);
   }
+  if (config_.enableExactMrc) {
+    const auto& pool = allocator_->getPool(pid);
+    std::vector<uint32_t> allocsPerSlab;
+    for (unsigned int cid = 0; cid < pool.getNumClassId(); ++cid) {
+      allocsPerSlab.push_back(
+          pool.getAllocationClass(static_cast<ClassId>(cid))
+              .getAllocsPerSlab());
+    }
+    exactMrcs_[pid] = std::make_unique<ExactMrc>(
+        std::move(allocsPerSlab),
+        config_.enableFootPrintMrc ? config_.footprintBufferSize : 0);
+  }
   createMMContainers(pid, std::move(config));
   setRebalanceStrategy(pid, std::move(rebalanceStrategy));
   setResizeStrategy(pid, std::move(resizeStrategy));
@@ -4578,6 +4678,13 @@ const FootprintMRC* CacheAllocator<CacheTrait>::getFootprintMrcForPool(PoolId pi
   return it != footprintMRCs_.end() ? &it->second : nullptr;
 }
 
+template <typename CacheTrait>
+const ExactMrc* CacheAllocator<CacheTrait>::getExactMrcForPool(
+    PoolId pid) const {
+  auto it = exactMrcs_.find(pid);
+  return it != exactMrcs_.end() ? it->second.get() : nullptr;
+}
+
 template <typename CacheTrait>
 std::map<uint64_t, double> CacheAllocator<CacheTrait>::queryShardsMrc(
     PoolId pid, ClassId cid) const {
@@ -6048,6 +6155,8 @@ bool CacheAllocator<CacheTrait>::cleanupStrayShmSegments(
     ShmManager::removeByName(cacheDir, detail::kShmHashTableName, posix);
     ShmManager::removeByName(cacheDir, detail::kShmChainedItemHashTableName,
                              posix);
+    ShmManager::removeByName(cacheDir, detail::kShmHashTableStampsName,
+                             posix);
   }
   return true;
 }
@@ -40,6 +40,7 @@
 #include "cachelib/allocator/RebalanceStrategy.h"
 #include "cachelib/allocator/Util.h"
 #include "cachelib/common/EventInterface.h"
+#include "cachelib/common/StatsSeries.h"
 #include "cachelib/common/Throttler.h"
 
 namespace facebook {
@@ -208,6 +209,13 @@ class CacheAllocatorConfig {
   // cachePersistence()
   CacheAllocatorConfig& usePosixForShm();
 
+  // lets processes that map the cache through ReadOnlySharedCacheView look up
+  // items by key without going through this process. Writers of the hash
+  // table then also stamp its locks in a small shm segment.
+  // @throw std::invalid_argument if called without enabling
+  // cachePersistence()
+  CacheAllocatorConfig& enableSharedCacheViewLookups();
+
   // Configures cache memory tiers. Each tier represents a cache region inside
   // byte-addressable memory such as DRAM, Pmem, CXLmem.
   // Accepts vector of MemoryTierCacheConfig. Each vector element describes
@@ -390,6 +398,10 @@ class CacheAllocatorConfig {
 
   bool isUsingPosixShm() const noexcept { return usePosixShm; }
 
+  bool isSharedCacheViewLookupEnabled() const noexcept {
+    return sharedCacheViewLookups;
+  }
+
   // validate the config, and return itself if valid
   const CacheAllocatorConfig& validate() const;
 
@@ -422,6 +434,9 @@ class CacheAllocatorConfig {
   // if true, uses posix shm; if not, uses sys-v (default)
   bool usePosixShm{false};
 
+  // if true, the hash table locks are stamped for ReadOnlySharedCacheView
+  bool sharedCacheViewLookups{false};
+
   // Attach shared memory to a fixed base address
   void* slabMemoryBaseAddr = nullptr;
 
@@ -533,6 +548,16 @@ class CacheAllocatorConfig {
 
   unsigned int footprintBufferSize{20000000};
 
+  // Compute the exact per-class miss ratio curves of every pool from the same
+  // accesses the Shards and footprint estimators see. Analysis only: keeps
+  // one entry per distinct key. The windowed curve covers footprintBufferSize
+  // accesses when the footprint estimator is enabled.
+  bool enableExactMrc{false};
+
+  // If set, slab movements and rebalance decisions are recorded into this
+  // stats time series.
+  std::shared_ptr<StatsSeriesWriter> statsSeries;
+
   // Memory monitoring config
   MemoryMonitor::Config memMonitorConfig;
 
@@ -917,6 +942,18 @@ CacheAllocatorConfig<T>& CacheAllocatorConfig<T>::usePosixForShm() {
   return *this;
 }
 
+template <typename T>
+CacheAllocatorConfig<T>&
+CacheAllocatorConfig<T>::enableSharedCacheViewLookups() {
+  if (cacheDir.empty()) {
+    throw std::invalid_argument(
+        "Shared cache view lookups can be enabled only when cache persistence "
+        "is enabled");
+  }
+  sharedCacheViewLookups = true;
+  return *this;
+}
+
 template <typename T>
 CacheAllocatorConfig<T>& CacheAllocatorConfig<T>::enableItemReaperInBackground(
     std::chrono::milliseconds interval, util::Throttler::Config config) {
@@ -1176,6 +1213,8 @@ std::map<std::string, std::string> CacheAllocatorConfig<T>::serialize() const {
   configMap["size"] = std::to_string(size);
   configMap["cacheDir"] = cacheDir;
   configMap["posixShm"] = isUsingPosixShm() ? "set" : "empty";
+  configMap["sharedCacheViewLookups"] =
+      std::to_string(sharedCacheViewLookups);
 
   configMap["defaultAllocSizes"] = "";
   // Stringify std::set
@@ -1201,6 +1240,7 @@ std::map<std::string, std::string> CacheAllocatorConfig<T>::serialize() const {
   configMap["enableShardsMrc"] = std::to_string(enableShardsMrc);
   configMap["enableFootPrintMrc"] = std::to_string(enableFootPrintMrc);
   configMap["footprintBufferSize"] = std::to_string(footprintBufferSize);
+  configMap["enableExactMrc"] = std::to_string(enableExactMrc);
   // Stringify enum
   switch (memMonitorConfig.mode) {
   case MemoryMonitor::FreeMemory:
@@ -21,5 +21,6 @@ const std::string kShmInfoName = "shm_info";
 const std::string kShmCacheName = "shm_cache";
 const std::string kShmHashTableName = "shm_hash_table";
 const std::string kShmChainedItemHashTableName = "shm_chained_alloc_hash_table";
+const std::string kShmHashTableStampsName = "shm_hash_table_stamps";
 
 } // namespace facebook::cachelib::detail
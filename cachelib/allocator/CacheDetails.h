@@ -37,6 +37,10 @@ extern const std::string kShmHashTableName;
 // identifier for the auxilary hash table for chained items
 extern const std::string kShmChainedItemHashTableName;
 
+// identifier for the stamps of the main hash table's locks if
+// ReadOnlySharedCacheView lookups are enabled
+extern const std::string kShmHashTableStampsName;
+
 } // namespace detail
 } // namespace cachelib
 } // namespace facebook
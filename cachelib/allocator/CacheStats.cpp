@@ -50,7 +50,7 @@ struct SizeVerify {};
 
 void Stats::populateGlobalCacheStats(GlobalCacheStats& ret) const {
 #ifndef SKIP_SIZE_VERIFY
-  SizeVerify<sizeof(Stats)> a = SizeVerify<16352>{};
+  SizeVerify<sizeof(Stats)> a = SizeVerify<16360>{};
   std::ignore = a;
 #endif
   ret.numCacheGets = numCacheGets.get();
@@ -69,6 +69,7 @@ void Stats::populateGlobalCacheStats(GlobalCacheStats& ret) const {
   ret.numNvmGetMissDueToInflightRemove = numNvmGetMissDueToInflightRemove.get();
   ret.numNvmGetMissErrs = numNvmGetMissErrs.get();
   ret.numNvmGetCoalesced = numNvmGetCoalesced.get();
+  ret.numNvmGetTransient = numNvmGetTransient.get();
   ret.numNvmPuts = numNvmPuts.get();
   ret.numNvmDeletes = numNvmDeletes.get();
   ret.numNvmSkippedDeletes = numNvmSkippedDeletes.get();
@@ -394,6 +394,9 @@ struct GlobalCacheStats {
   // number of gets that joined a concurrent fill for same item
   uint64_t numNvmGetCoalesced{0};
 
+  // number of gets that returned an item from nvm without inserting it
+  uint64_t numNvmGetTransient{0};
+
   // number of deletes issues to nvm
   uint64_t numNvmDeletes{0};
 
@@ -633,6 +636,11 @@ struct CCacheStats {
   uint64_t lockTimeout;
   uint64_t promoteTimeout;
 
+  // buckets migrated by online resizes, on access by requests and by the
+  // sweep of the resize
+  uint64_t resizeMigrationsOnAccess;
+  uint64_t resizeMigrationsSwept;
+
   double hitRatio() const;
 
   CCacheStats& operator+=(const CCacheStats& other) {
@@ -658,6 +666,9 @@ struct CCacheStats {
     lockTimeout += other.lockTimeout;
     promoteTimeout += other.promoteTimeout;
 
+    resizeMigrationsOnAccess += other.resizeMigrationsOnAccess;
+    resizeMigrationsSwept += other.resizeMigrationsSwept;
+
     return *this;
   }
 };
@@ -78,6 +78,9 @@ struct Stats {
   // number of gets that joined a concurrent fill for same item
   AtomicCounter numNvmGetCoalesced{0};
 
+  // number of gets that returned an item from nvm without inserting it
+  AtomicCounter numNvmGetTransient{0};
+
   // number of deletes issues to nvm
   TLCounter numNvmDeletes{0};
 
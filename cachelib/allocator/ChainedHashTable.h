@@ -18,6 +18,7 @@
 
 #include <folly/Optional.h>
 
+#include <atomic>
 #include <cstdint>
 #include <map>
 #include <stdexcept>
@@ -332,6 +333,79 @@ class ChainedHashTable {
     Hasher hasher_ = std::make_shared<MurmurHash2>();
   };
 
+  // Sequence numbers of the bucket locks, kept in memory that other processes
+  // can map. A writer makes the number of its lock odd while it changes a
+  // bucket under that lock and even again after, so that a reader which can
+  // not take the lock, like ReadOnlySharedCacheView, can tell whether the
+  // buckets it walked changed under it. There is one number per lock, so
+  // writers holding different locks never touch the same number.
+  class BucketStamps {
+   public:
+    // get the required size for the stamps of 2^locksPower locks.
+    static size_t getRequiredSize(unsigned int locksPower) noexcept {
+      return sizeof(uint32_t) << locksPower;
+    }
+
+    // stamps nothing
+    BucketStamps() = default;
+
+    // @param memStart    memory of getRequiredSize(locksPower) bytes
+    // @param locksPower  number of locks in base 2 logarithm
+    BucketStamps(void* memStart, unsigned int locksPower) noexcept
+        : stamps_(static_cast<uint32_t*>(memStart)),
+          locksMask_((1ULL << locksPower) - 1) {}
+
+    explicit operator bool() const noexcept { return stamps_ != nullptr; }
+
+    // returns the stamp to validate the read with. An odd stamp means a
+    // writer is changing the bucket and the read can not succeed.
+    uint32_t beginRead(size_t bucket) const noexcept {
+      return __atomic_load_n(&stamps_[bucket & locksMask_], __ATOMIC_ACQUIRE);
+    }
+
+    // returns true if no writer changed the bucket since beginRead returned
+    // the stamp, so everything read in between is consistent.
+    bool validateRead(size_t bucket, uint32_t stamp) const noexcept {
+      std::atomic_thread_fence(std::memory_order_acquire);
+      return !(stamp & 1) &&
+             __atomic_load_n(&stamps_[bucket & locksMask_],
+                             __ATOMIC_RELAXED) == stamp;
+    }
+
+    // Makes the stamp of the bucket's lock odd for the lifetime of the scope.
+    // Must be created while holding the lock exclusively. Does nothing if the
+    // stamps are not enabled.
+    class WriteScope {
+     public:
+      WriteScope(const BucketStamps& stamps, size_t bucket) noexcept
+          : stamp_(stamps ? &stamps.stamps_[bucket & stamps.locksMask_]
+                          : nullptr) {
+        if (stamp_) {
+          seq_ = __atomic_load_n(stamp_, __ATOMIC_RELAXED);
+          __atomic_store_n(stamp_, seq_ + 1, __ATOMIC_RELAXED);
+          std::atomic_thread_fence(std::memory_order_release);
+        }
+      }
+
+      ~WriteScope() {
+        if (stamp_) {
+          __atomic_store_n(stamp_, seq_ + 2, __ATOMIC_RELEASE);
+        }
+      }
+
+      WriteScope(const WriteScope&) = delete;
+      WriteScope& operator=(const WriteScope&) = delete;
+
+     private:
+      uint32_t* stamp_;
+      uint32_t seq_{0};
+    };
+
+   private:
+    uint32_t* stamps_{nullptr};
+    uint64_t locksMask_{0};
+  };
+
   // Interface for the Container that implements a hash table. Maintains
   // the node's isInAccessContainer state. T must implement an interface to
   // markAccessible(), unmarkAccessible() and isAccessible().
@@ -524,6 +598,13 @@ class ChainedHashTable {
       return config_.getBucketsPower();
     }
 
+    // makes the writers stamp their bucket locks in the given memory, which
+    // must hold BucketStamps::getRequiredSize(config.getLocksPower()) bytes.
+    // Must be called before the container is shared between threads.
+    void enableBucketStamps(void* memStart) noexcept {
+      stamps_ = BucketStamps{memStart, config_.getLocksPower()};
+    }
+
     // Iterator interface for the hashtable. Iterates over the hashtable
     // bucket by bucket and takes a snapshot of the bucket to iterate over. It
     // guarantees that all keys that were present when the iteration started
@@ -669,6 +750,9 @@ class ChainedHashTable {
     // locks protecting the hashtable buckets
     mutable LockT locks_;
 
+    // stamps of the locks for readers in other processes, if enabled
+    BucketStamps stamps_;
+
     std::atomic<unsigned int> numIterators_{0};
 
     // Cached stats for distribution
@@ -1004,6 +1088,7 @@ bool ChainedHashTable::Container<T, HookPtr, LockT>::insert(T& node) noexcept {
 
   const auto bucket = ht_.getBucket(node.getKey());
   auto l = locks_.lockExclusive(bucket);
+  BucketStamps::WriteScope stamp{stamps_, bucket};
   const bool res = ht_.insertInBucket(node, bucket);
 
   if (res) {
@@ -1025,6 +1110,7 @@ ChainedHashTable::Container<T, HookPtr, LockT>::insertOrReplace(T& node) {
 
   const auto bucket = ht_.getBucket(node.getKey());
   auto l = locks_.lockExclusive(bucket);
+  BucketStamps::WriteScope stamp{stamps_, bucket};
   T* oldNode = ht_.insertOrReplaceInBucket(node, bucket);
   XDCHECK_NE(reinterpret_cast<uintptr_t>(&node),
              reinterpret_cast<uintptr_t>(oldNode));
@@ -1073,6 +1159,7 @@ bool ChainedHashTable::Container<T, HookPtr, LockT>::replaceIf(T& oldNode,
   const auto key = newNode.getKey();
   const auto bucket = ht_.getBucket(key);
   auto l = locks_.lockExclusive(bucket);
+  BucketStamps::WriteScope stamp{stamps_, bucket};
 
   if (oldNode.isAccessible() && predicate(oldNode)) {
     ht_.insertOrReplaceInBucket(newNode, bucket);
@@ -1089,6 +1176,7 @@ template <typename T,
 bool ChainedHashTable::Container<T, HookPtr, LockT>::remove(T& node) noexcept {
   const auto bucket = ht_.getBucket(node.getKey());
   auto l = locks_.lockExclusive(bucket);
+  BucketStamps::WriteScope stamp{stamps_, bucket};
 
   // check inside the lock to prevent from racing removes
   if (!node.isAccessible()) {
@@ -1109,6 +1197,7 @@ typename T::Handle ChainedHashTable::Container<T, HookPtr, LockT>::removeIf(
     T& node, const std::function<bool(const T& node)>& predicate) {
   const auto bucket = ht_.getBucket(node.getKey());
   auto l = locks_.lockExclusive(bucket);
+  BucketStamps::WriteScope stamp{stamps_, bucket};
 
   // check inside the lock to prevent from racing removes
   if (node.isAccessible() && predicate(node)) {
@@ -394,8 +394,12 @@ struct ReadHandleImpl {
       // that asynchronously created the handle. Fix up the thread local
       // refcount so that alloc_.release does not decrement it to negative.
       alloc_.adjustHandleCountForThread_private(1);
+      // nvmcache can hand out an item it did not insert, whose handle is
+      // still nascent.
+      const bool isNascent =
+          flags_ & static_cast<uint8_t>(HandleFlags::kNascent);
       try {
-        alloc_.release(it, /* isNascent */ false);
+        alloc_.release(it, isNascent);
       } catch (const std::exception& e) {
         XLOGF(CRITICAL, "Failed to release {:#10x} : {}",
               static_cast<void*>(it), e.what());
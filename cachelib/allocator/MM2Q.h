@@ -463,6 +463,16 @@ class MM2Q {
     //          is unchanged.
     bool add(T& node) noexcept;
 
+    // adds the given node into the container like add(), but at the head of
+    // the cold queue instead of the hot one. The node is evicted before the
+    // ones in the hot queue unless it is accessed again, which moves it to the
+    // warm queue. Used for nodes that are not known to be hot yet.
+    //
+    // @param node  The node to be added to the container.
+    // @return  True if the node was successfully added to the container. False
+    //          if the node was already in the container.
+    bool addCold(T& node) noexcept;
+
     // removes the node from the lru and sets it previous and next to nullptr.
     //
     // @param node  The node to be removed from the container.
@@ -905,6 +915,26 @@ bool MM2Q::Container<T, HookPtr>::add(T& node) noexcept {
   });
 }
 
+template <typename T, MM2Q::Hook<T> T::*HookPtr>
+bool MM2Q::Container<T, HookPtr>::addCold(T& node) noexcept {
+  const auto currTime = static_cast<Time>(util::getCurrentTimeSec());
+  return lruMutex_->lock_combine([this, &node, currTime]() {
+    if (node.isInMMContainer()) {
+      return false;
+    }
+
+    unmarkHot(node);
+    markCold(node);
+    unmarkTail(node);
+    lru_.getList(LruType::Cold).linkAtHead(node);
+    rebalance();
+
+    node.markInMMContainer();
+    setUpdateTime(node, currTime);
+    return true;
+  });
+}
+
 template <typename T, MM2Q::Hook<T> T::*HookPtr>
 typename MM2Q::Container<T, HookPtr>::LockedIterator
 MM2Q::Container<T, HookPtr>::getEvictionIterator() const noexcept {
@@ -17,7 +17,18 @@
 #pragma once
 
 #include <folly/Range.h>
+#include <folly/container/F14Map.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <mutex>
+
+#include "cachelib/allocator/CacheStats.h"
+#include "cachelib/allocator/memory/MemoryAllocator.h"
+#include "cachelib/allocator/memory/Slab.h"
 #include "cachelib/common/ApproxSplitSet.h"
 #include "cachelib/common/AtomicCounter.h"
 #include "cachelib/common/PercentileStats.h"
@@ -132,6 +143,11 @@ class NvmAdmissionPolicy {
 
   uint64_t getMinTTL() const { return minTTL_; }
 
+  // Called once by the cache the policy is set for, before it makes any
+  // admission decision. Policies that read the state of the cache, like its
+  // stats, keep the reference. The cache outlives the calls to the policy.
+  virtual void initCache(const Cache&) {}
+
   // Implement this method for the detailed admission decision logic.
   // By default this accepts all items.
   virtual bool acceptImpl(const Item&, folly::Range<ChainedItemIter>) {
@@ -225,5 +241,209 @@ class RejectFirstAP final : public NvmAdmissionPolicy<Cache> {
   AtomicCounter admitsByDramHits_{0};
   const bool useDramHitSignal_{true};
 };
+
+// an admission policy that admits an evicted item only if it is predicted to
+// be read again before it would be evicted from flash. The predictions use the
+// signals the DRAM rebalancer works with. For every allocation class, the time
+// until an item at the tail is accessed again is estimated from the tail hits
+// of the class, or from its hits per item when its MM container does not
+// track tail hits. An item that was hit in DRAM blends that estimate with
+// the time between its insertion and its last access. With a write budget,
+// the retention time the predictions are compared against shrinks while more
+// bytes are admitted than the budget allows, and grows back otherwise.
+template <typename Cache>
+class EvictionAgeAP final : public NvmAdmissionPolicy<Cache> {
+ public:
+  using Item = typename Cache::Item;
+  using ChainedItemIter = typename Cache::ChainedItemIter;
+
+  struct Config {
+    // time an item is expected to stay in flash before it is evicted
+    std::chrono::seconds flashRetention{3600};
+
+    // bytes per second admitted to flash. 0 means no budget.
+    uint64_t writeBudgetBytesPerSec{0};
+
+    // how often the class signals are read from the cache
+    std::chrono::seconds refreshInterval{10};
+  };
+
+  explicit EvictionAgeAP(Config config)
+      : config_{config},
+        retentionSecs_{static_cast<uint32_t>(config.flashRetention.count())} {
+    if (config_.flashRetention.count() <= 0) {
+      throw std::invalid_argument("flash retention must be positive");
+    }
+  }
+
+  void initCache(const Cache& cache) final override { cache_ = &cache; }
+
+  // reads the class signals from the cache and adapts the retention time to
+  // the write budget. Called by the admission decisions every
+  // refreshInterval, and a no-op if another thread is refreshing.
+  //
+  // @param nowSec  the current time in seconds
+  void refresh(uint32_t nowSec) {
+    std::unique_lock<std::mutex> l(refreshMutex_, std::try_to_lock);
+    if (!l.owns_lock() || cache_ == nullptr) {
+      return;
+    }
+    const uint32_t lastSec = lastRefreshSec_.load(std::memory_order_relaxed);
+    const double elapsed = nowSec > lastSec ? nowSec - lastSec : 0;
+    lastRefreshSec_.store(nowSec, std::memory_order_relaxed);
+
+    for (auto pid : cache_->getRegularPoolIds()) {
+      const auto poolStats = cache_->getPoolStats(pid);
+      for (const auto& [cid, stat] : poolStats.cacheStats) {
+        const uint64_t tailHits = stat.containerStat.numTailAccesses;
+        auto [it, inserted] = signals_.try_emplace(
+            pid * MemoryAllocator::kMaxClasses + cid,
+            ClassSignals{stat.numHits, tailHits});
+        auto& prev = it->second;
+        if (!inserted && elapsed > 0 && stat.allocSize > 0) {
+          reuseSecs_[pid][cid].store(
+              estimateReuseSecs(prev, stat, tailHits, elapsed),
+              std::memory_order_relaxed);
+        }
+        prev = ClassSignals{stat.numHits, tailHits};
+      }
+    }
+
+    const uint64_t admittedBytes = admittedBytes_.get();
+    if (config_.writeBudgetBytesPerSec > 0 && elapsed > 0) {
+      const double rate = (admittedBytes - lastAdmittedBytes_) / elapsed;
+      const double maxRetention = config_.flashRetention.count();
+      double retention = retentionSecs_.load(std::memory_order_relaxed);
+      if (rate > config_.writeBudgetBytesPerSec) {
+        retention *= config_.writeBudgetBytesPerSec / rate;
+      } else {
+        retention = retention * kRetentionGrowth + 1;
+      }
+      retentionSecs_.store(
+          static_cast<uint32_t>(std::clamp(retention, 1.0, maxRetention)),
+          std::memory_order_relaxed);
+    }
+    lastAdmittedBytes_ = admittedBytes;
+  }
+
+ protected:
+  bool acceptImpl(const Item& it,
+                  folly::Range<ChainedItemIter>) final override {
+    const uint32_t now = util::getCurrentTimeSec();
+    if (now >= lastRefreshSec_.load(std::memory_order_relaxed) +
+                   config_.refreshInterval.count()) {
+      refresh(now);
+    }
+
+    uint32_t reuseSecs = kNoSignal;
+    if (cache_ != nullptr) {
+      const auto allocInfo =
+          cache_->getAllocInfo(static_cast<const void*>(&it));
+      reuseSecs = reuseSecs_[allocInfo.poolId][allocInfo.classId].load(
+          std::memory_order_relaxed);
+    }
+    if (it.getLastAccessTime() > it.getCreationTime()) {
+      reuseSecs = blendOwnReuseSecs(
+          reuseSecs, it.getLastAccessTime() - it.getCreationTime());
+      ownHitPredictions_.inc();
+    }
+
+    // classes without a signal yet are admitted like by the default policy
+    const bool accept =
+        reuseSecs == kNoSignal ||
+        reuseSecs <= retentionSecs_.load(std::memory_order_relaxed);
+    if (accept) {
+      admittedBytes_.add(it.getTotalSize());
+    }
+    return accept;
+  }
+
+  bool acceptImpl(typename Item::Key) final override {
+    // we don't know the class of the key, so always return true
+    return true;
+  }
+
+  void getCountersImpl(const util::CounterVisitor& visitor) final override {
+    visitor("ap.eviction_age_retention_secs",
+            retentionSecs_.load(std::memory_order_relaxed));
+    visitor("ap.eviction_age_admitted_bytes", admittedBytes_.get(),
+            util::CounterVisitor::CounterType::RATE);
+    visitor("ap.eviction_age_own_hit_predictions", ownHitPredictions_.get(),
+            util::CounterVisitor::CounterType::RATE);
+  }
+
+ private:
+  // the counters of a class at the last refresh
+  struct ClassSignals {
+    uint64_t hits{0};
+    uint64_t tailHits{0};
+  };
+
+  // the reuse of classes that have not been refreshed twice yet
+  static constexpr uint32_t kNoSignal = 0;
+  // the reuse of classes whose items were not accessed at all
+  static constexpr uint32_t kNoReuse = std::numeric_limits<uint32_t>::max();
+  // how fast the retention time grows back while under the write budget
+  static constexpr double kRetentionGrowth = 1.1;
+
+  // estimates the seconds until an item at the tail of the class is accessed
+  // again, from the accesses per second of such an item
+  static uint32_t estimateReuseSecs(const ClassSignals& prev,
+                                    const CacheStat& stat,
+                                    uint64_t tailHits,
+                                    double elapsed) {
+    double rate = 0;
+    if (tailHits > prev.tailHits) {
+      // the tail is the last slab worth of items
+      const double tailItems =
+          std::max<double>(1, Slab::kSize / stat.allocSize);
+      rate = (tailHits - prev.tailHits) / elapsed / tailItems;
+    } else if (stat.numHits > prev.hits && stat.numItems() > 0) {
+      rate = (stat.numHits - prev.hits) / elapsed / stat.numItems();
+    }
+    if (rate <= 0) {
+      return kNoReuse;
+    }
+    return static_cast<uint32_t>(
+        std::clamp(1 / rate, 1.0, static_cast<double>(kNoReuse - 1)));
+  }
+
+  // blends the reuse estimate of the class with the time between the
+  // insertion and the last access of an item that was hit in DRAM. That time
+  // spans all the hits of the item, so it is not trusted on its own: the
+  // access rates of both are averaged, which keeps the result within twice
+  // the shorter of the two.
+  static uint32_t blendOwnReuseSecs(uint32_t classReuseSecs,
+                                    uint32_t ownReuseSecs) {
+    if (classReuseSecs == kNoSignal) {
+      return ownReuseSecs;
+    }
+    const double classRate =
+        classReuseSecs == kNoReuse ? 0 : 1.0 / classReuseSecs;
+    const double rate = (classRate + 1.0 / ownReuseSecs) / 2;
+    return static_cast<uint32_t>(
+        std::clamp(1 / rate, 1.0, static_cast<double>(kNoReuse - 1)));
+  }
+
+  const Config config_;
+  const Cache* cache_{nullptr};
+
+  // predicted seconds until reuse of an evicted item, per pool and class
+  std::array<std::array<std::atomic<uint32_t>, MemoryAllocator::kMaxClasses>,
+             MemoryAllocator::kMaxPools>
+      reuseSecs_{};
+
+  // retention time the predictions are compared against
+  std::atomic<uint32_t> retentionSecs_;
+
+  std::atomic<uint32_t> lastRefreshSec_{0};
+  AtomicCounter admittedBytes_{0};
+  AtomicCounter ownHitPredictions_{0};
+
+  // protects the state below, only used by the refreshing thread
+  std::mutex refreshMutex_;
+  folly::F14FastMap<uint32_t, ClassSignals> signals_;
+  uint64_t lastAdmittedBytes_{0};
+};
 } // namespace cachelib
 } // namespace facebook
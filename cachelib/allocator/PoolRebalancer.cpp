@@ -23,6 +23,9 @@
 #include <stdexcept>
 #include <thread>
 
+#include "cachelib/common/PerfCounters.h"
+#include "cachelib/common/StatsSeries.h"
+
 namespace facebook::cachelib {
 
 PoolRebalancer::PoolRebalancer(CacheBase& cache,
@@ -87,8 +90,11 @@ void PoolRebalancer::releaseSlab(PoolId pid,
                                  ClassId receiverClassId,
                                 uint64_t request_id) {
   const auto now = util::getCurrentTimeMs();
-  cache_.releaseSlab(pid, victimClassId, receiverClassId,
-                     SlabReleaseMode::kRebalance);
+  {
+    PerfRegionScope perfScope{PerfRegion::kRebalancerRelease};
+    cache_.releaseSlab(pid, victimClassId, receiverClassId,
+                       SlabReleaseMode::kRebalance);
+  }
   const auto elapsed_time =
       static_cast<uint64_t>(util::getCurrentTimeMs() - now);
   const PoolStats poolStats = cache_.getPoolStats(pid);
@@ -114,16 +120,31 @@ void PoolRebalancer::releaseSlab(PoolId pid,
         poolStats.evictionAgeForClass(victimClassId), receiverEvictionAge,
         poolStats.mpStats.acStats.at(victimClassId).freeAllocs);
   
-  folly::dynamic logData = folly::dynamic::object(
-          "request_id", request_id)(
-          "pool_id", static_cast<int>(pid))(
-          "victim", folly::dynamic::object("id", static_cast<int>(victimClassId)))(
-          "receiver", folly::dynamic::object("id", static_cast<int>(receiverClassId)));
-    
-  std::string jsonString = folly::toJson(logData);
-  XLOGF(DBG, "Slab_movement_event: {}", jsonString);
-  
-  
+  if (auto* series = cache_.getStatsSeries()) {
+    StatsSeriesRecord record;
+    record.requestId = request_id;
+    record.kind = StatsSeriesRecord::kSlabMove;
+    record.poolId = pid;
+    record.classId = victimClassId;
+    record.otherClassId = receiverClassId;
+    record.values = {
+        static_cast<double>(poolStats.numSlabsForClass(victimClassId)),
+        static_cast<double>(numSlabsInReceiver),
+        static_cast<double>(poolStats.evictionAgeForClass(victimClassId)),
+        static_cast<double>(receiverEvictionAge),
+        static_cast<double>(elapsed_time)};
+    series->append(record);
+  }
+
+  // only build the json when somebody reads it
+  if (XLOG_IS_ON(DBG)) {
+    folly::dynamic logData = folly::dynamic::object(
+            "request_id", request_id)(
+            "pool_id", static_cast<int>(pid))(
+            "victim", folly::dynamic::object("id", static_cast<int>(victimClassId)))(
+            "receiver", folly::dynamic::object("id", static_cast<int>(receiverClassId)));
+    XLOGF(DBG, "Slab_movement_event: {}", folly::toJson(logData));
+  }
 }
 
 RebalanceContext PoolRebalancer::pickVictimByFreeAlloc(PoolId pid) const {
@@ -163,7 +184,10 @@ bool PoolRebalancer::tryRebalancing(PoolId pid, RebalanceStrategy& strategy, uin
   auto currentTimeSec = util::getCurrentTimeMs();
   XLOGF(DBG,
         "[{}] Trigger rebalance at request_id: {} ", strategy.getStringType(), request_id);
-  const auto context = strategy.pickVictimAndReceiver(cache_, pid);
+  const auto context = [&] {
+    PerfRegionScope perfScope{PerfRegion::kRebalancerPick};
+    return strategy.pickVictimAndReceiver(cache_, pid);
+  }();
 
   lastRebalance_[pid] = strategy.isThrashing(pid, context);
 
@@ -193,6 +217,16 @@ bool PoolRebalancer::tryRebalancing(PoolId pid, RebalanceStrategy& strategy, uin
   releaseStats_.recordLoopTime(end > currentTimeSec ? end - currentTimeSec : 0);
   rebalanceStats_.recordLoopTime(end > begin ? end - begin : 0);
 
+  if (auto* series = cache_.getStatsSeries()) {
+    StatsSeriesRecord record;
+    record.requestId = request_id;
+    record.kind = StatsSeriesRecord::kRebalance;
+    record.poolId = pid;
+    record.classId = context.victimClassId;
+    record.otherClassId = context.receiverClassId;
+    series->append(record);
+  }
+
   XLOGF(DBG, "rebalance_event: request_id: {}, pool_id: {}, victim_class_id: {}, receiver_class_id: {}",
     request_id,
     static_cast<int>(pid),
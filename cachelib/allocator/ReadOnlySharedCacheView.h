@@ -16,24 +16,46 @@
 
 #pragma once
 
+#include <folly/portability/Asm.h>
+
+#include <cstring>
 #include <memory>
+#include <stdexcept>
 #include <string>
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wconversion"
 #include <folly/Format.h>
+#include <folly/Range.h>
 #pragma GCC diagnostic pop
 
 #include "cachelib/allocator/CacheDetails.h"
+#include "cachelib/allocator/ChainedHashTable.h"
+#include "cachelib/allocator/memory/CompressedPtr.h"
+#include "cachelib/allocator/memory/Slab.h"
+#include "cachelib/allocator/memory/SlabAllocator.h"
 #include "cachelib/shm/ShmManager.h"
 
 namespace facebook {
 namespace cachelib {
 
 // used as a read only into a shared cache. The cache is owned by another
-// process and we peek into the items in the cache based on their offsets.
+// process and we peek into the items in the cache based on their offsets, or
+// look them up by key if the owner enabled it.
 class ReadOnlySharedCacheView {
  public:
+  // outcome of looking up an item by key through the view
+  enum class LookupStatus {
+    // the item was found and its value copied out
+    kFound,
+    // the key is not in the cache or its item has expired
+    kNotFound,
+    // the owner changed the bucket of the key during every attempt
+    kConflict,
+  };
+
+  static constexpr unsigned int kDefaultLookupAttempts = 4;
+
   // tries to attach to an existing cache with the cacheDir if present under
   // the correct shm mode.
   //
@@ -49,7 +71,9 @@ class ReadOnlySharedCacheView {
   explicit ReadOnlySharedCacheView(const std::string& cacheDir,
                                    bool usePosixShm,
                                    void* addr = nullptr)
-      : shm_(ShmManager::attachShmReadOnly(
+      : cacheDir_(cacheDir),
+        usePosixShm_(usePosixShm),
+        shm_(ShmManager::attachShmReadOnly(
             cacheDir, detail::kShmCacheName, usePosixShm, addr)) {}
 
   // returns the absolute address at which the shared memory mapping is mounted.
@@ -83,10 +107,204 @@ class ReadOnlySharedCacheView {
                                    offset);
   }
 
+  // attaches the hash table of the cache and the stamps of its locks, so that
+  // find() can look up items by key. The owner must have been created with
+  // Config::enableSharedCacheViewLookups() and accessConfig must be the
+  // access config of the owner. The view must be attached again after the
+  // owner restarts.
+  //
+  // @throw std::invalid_argument if the segments can not be attached or are
+  //        too small for the config.
+  void attachAccessContainer(const ChainedHashTable::Config& accessConfig) {
+    const auto cacheMapping = shm_->getCurrentMapping();
+    if (cacheMapping.addr == nullptr) {
+      throw std::invalid_argument("the cache segment is not mapped");
+    }
+    auto hashTableShm = ShmManager::attachShmReadOnly(
+        cacheDir_, detail::kShmHashTableName, usePosixShm_);
+    auto stampsShm = ShmManager::attachShmReadOnly(
+        cacheDir_, detail::kShmHashTableStampsName, usePosixShm_);
+    const size_t hashTableSize =
+        sizeof(CompressedPtr) * accessConfig.getNumBuckets();
+    const size_t stampsSize = ChainedHashTable::BucketStamps::getRequiredSize(
+        accessConfig.getLocksPower());
+    if (hashTableShm->getSize() < hashTableSize ||
+        stampsShm->getSize() < stampsSize) {
+      throw std::invalid_argument(folly::sformat(
+          "Hash table segments of {} and {} bytes do not fit bucket power {} "
+          "and lock power {}",
+          hashTableShm->getSize(), stampsShm->getSize(),
+          accessConfig.getBucketsPower(), accessConfig.getLocksPower()));
+    }
+
+    // the cache segment starts with the slab headers, followed by the slabs
+    // that compressed pointers index. See SlabAllocator.
+    const size_t numSlabs = cacheMapping.size / Slab::kSize;
+    numUsableSlabs_ = SlabAllocator::getNumUsableSlabs(cacheMapping.size);
+    slabHeaders_ = static_cast<const SlabHeader*>(cacheMapping.addr);
+    slabMemoryStart_ = static_cast<const char*>(cacheMapping.addr) +
+                       (numSlabs - numUsableSlabs_) * Slab::kSize;
+
+    buckets_ = static_cast<const CompressedPtr*>(
+        hashTableShm->getCurrentMapping().addr);
+    numBucketsMask_ = accessConfig.getNumBuckets() - 1;
+    stamps_ = ChainedHashTable::BucketStamps{
+        stampsShm->getCurrentMapping().addr, accessConfig.getLocksPower()};
+    hasher_ = accessConfig.getHasher();
+    hashTableShm_ = std::move(hashTableShm);
+    stampsShm_ = std::move(stampsShm);
+  }
+
+  // looks up the key without taking any of the owner's locks and copies the
+  // value of its item out. The bucket of the key is walked optimistically and
+  // the result only counts if the stamp of the bucket's lock shows that the
+  // owner did not change the bucket meanwhile. Otherwise the lookup is tried
+  // again, up to maxAttempts times.
+  //
+  // For items with chained items only the parent's value is copied. A value
+  // the owner changes in place through a WriteHandle, without replacing the
+  // item, is not detected as a change.
+  //
+  // @param CacheT      the type of the owner's cache, which decides the item
+  //                    layout
+  // @param key         the key to look up
+  // @param value       receives the value. Only meaningful on kFound.
+  // @param maxAttempts number of times to walk the bucket
+  //
+  // @throw std::logic_error if attachAccessContainer() was not called
+  template <typename CacheT>
+  LookupStatus find(folly::StringPiece key,
+                    std::string& value,
+                    unsigned int maxAttempts = kDefaultLookupAttempts) const;
+
  private:
+  // walks the bucket once and copies the value of the key's item out. Returns
+  // kConflict if the bucket held something no consistent bucket could, which
+  // means the owner is changing it.
+  template <typename CacheT>
+  LookupStatus findInBucket(folly::StringPiece key,
+                            size_t bucket,
+                            std::string& value) const;
+
+  // returns the item that the compressed pointer points to in our mapping,
+  // along with its allocation size, or nullptr if the pointer is not valid.
+  const char* unCompress(CompressedPtr ptr, uint32_t& allocSize) const;
+
+  // longest hash chain we walk before assuming the bucket is changing
+  static constexpr unsigned int kMaxChainLength = 1024;
+
+  // the directory and shm mode of the cache
+  const std::string cacheDir_;
+  const bool usePosixShm_;
+
   // the segment backing the cache
   std::unique_ptr<ShmSegment> shm_;
+
+  // the segments of the hash table and the stamps of its locks, if attached
+  std::unique_ptr<ShmSegment> hashTableShm_;
+  std::unique_ptr<ShmSegment> stampsShm_;
+
+  // layout of the slabs in the cache segment
+  const SlabHeader* slabHeaders_{nullptr};
+  const char* slabMemoryStart_{nullptr};
+  unsigned int numUsableSlabs_{0};
+
+  // the hash table buckets in our mapping
+  const CompressedPtr* buckets_{nullptr};
+  size_t numBucketsMask_{0};
+  ChainedHashTable::BucketStamps stamps_;
+  Hasher hasher_;
 };
 
+inline const char* ReadOnlySharedCacheView::unCompress(
+    CompressedPtr ptr, uint32_t& allocSize) const {
+  // pointers are not compressed with tiers, so the slab index takes the bits
+  // above the allocation index. See CompressedPtr.
+  constexpr unsigned int kNumAllocIdxBits =
+      Slab::kNumSlabBits - Slab::kMinAllocPower;
+  const uint32_t raw = ptr.getRaw();
+  const uint32_t slabIdx = raw >> kNumAllocIdxBits;
+  const uint32_t allocIdx = raw & ((1u << kNumAllocIdxBits) - 1);
+  if (slabIdx >= numUsableSlabs_) {
+    return nullptr;
+  }
+
+  SlabHeader header;
+  std::memcpy(&header, &slabHeaders_[slabIdx], sizeof(header));
+  allocSize = header.allocSize;
+  if (allocSize < CompressedPtr::getMinAllocSize() ||
+      static_cast<uint64_t>(allocIdx + 1) * allocSize > Slab::kSize) {
+    return nullptr;
+  }
+  return slabMemoryStart_ + static_cast<size_t>(slabIdx) * Slab::kSize +
+         static_cast<size_t>(allocIdx) * allocSize;
+}
+
+template <typename CacheT>
+ReadOnlySharedCacheView::LookupStatus ReadOnlySharedCacheView::findInBucket(
+    folly::StringPiece key, size_t bucket, std::string& value) const {
+  using Item = typename CacheT::Item;
+
+  CompressedPtr next;
+  std::memcpy(&next, &buckets_[bucket], sizeof(next));
+  for (unsigned int i = 0; i < kMaxChainLength && !next.isNull(); i++) {
+    uint32_t allocSize = 0;
+    const char* memory = unCompress(next, allocSize);
+    if (memory == nullptr || allocSize < sizeof(Item)) {
+      return LookupStatus::kConflict;
+    }
+
+    // the item may change under us, so its header is read once into a copy
+    // that everything below goes by.
+    unsigned char copy[sizeof(Item)];
+    std::memcpy(copy, memory, sizeof(Item));
+    const auto& item = *reinterpret_cast<const Item*>(copy);
+    const auto itemKey = item.getKey();
+    const size_t keyOffset =
+        itemKey.data() - reinterpret_cast<const char*>(copy);
+    const size_t valueOffset = keyOffset + itemKey.size();
+    if (valueOffset + item.getSize() > allocSize) {
+      return LookupStatus::kConflict;
+    }
+
+    if (itemKey.size() == key.size() &&
+        std::memcmp(memory + keyOffset, key.data(), key.size()) == 0) {
+      if (item.isExpired()) {
+        return LookupStatus::kNotFound;
+      }
+      value.assign(memory + valueOffset, item.getSize());
+      return LookupStatus::kFound;
+    }
+    next = item.accessHook_.getHashNext();
+  }
+  return next.isNull() ? LookupStatus::kNotFound : LookupStatus::kConflict;
+}
+
+template <typename CacheT>
+ReadOnlySharedCacheView::LookupStatus ReadOnlySharedCacheView::find(
+    folly::StringPiece key,
+    std::string& value,
+    unsigned int maxAttempts) const {
+  if (buckets_ == nullptr) {
+    throw std::logic_error("the access container of the cache is not attached");
+  }
+
+  const size_t bucket = (*hasher_)(key.data(), key.size()) & numBucketsMask_;
+  for (unsigned int i = 0; i < maxAttempts; i++) {
+    const uint32_t stamp = stamps_.beginRead(bucket);
+    if (stamp & 1) {
+      // the owner is changing the bucket right now
+      folly::asm_volatile_pause();
+      continue;
+    }
+    const auto status = findInBucket<CacheT>(key, bucket, value);
+    if (status != LookupStatus::kConflict &&
+        stamps_.validateRead(bucket, stamp)) {
+      return status;
+    }
+  }
+  return LookupStatus::kConflict;
+}
+
 } // namespace cachelib
 } // namespace facebook
@@ -91,12 +91,16 @@ class CacheAPIWrapperForNvm {
   //
   // @param cache  the cache instance using nvmcache
   // @param handle the handle for the allocation.
+  // @param cold   insert the item where it is evicted first from DRAM unless
+  //               it is accessed again
   // @return true if the handle was successfully inserted into the hashtable
   //         and is now accessible to everyone. False if there was an error.
   // @throw  std::invalid_argument if the handle is already accessible or
   //         invalid
-  static bool insertFromNvm(C& cache, const WriteHandle& handle) {
-    return cache.insertImpl(handle, AllocatorApiEvent::INSERT_FROM_NVM);
+  static bool insertFromNvm(C& cache,
+                            const WriteHandle& handle,
+                            bool cold = false) {
+    return cache.insertImpl(handle, AllocatorApiEvent::INSERT_FROM_NVM, cold);
   }
 
   // Acquire the wait context for the handle. This is used by nvmcache to
@@ -16,15 +16,23 @@
 
 #pragma once
 
-#include <folly/Hash.h>
 #include <folly/Range.h>
 #include <folly/container/F14Map.h>
 #include <folly/fibers/TimedMutex.h>
+#include <folly/hash/Hash.h>
 #include <folly/lang/Align.h>
+#include <folly/lang/Bits.h>
 #include <folly/logging/xlog.h>
 
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <utility>
 
+#include "cachelib/common/ConditionVariable.h"
+
 namespace facebook {
 namespace cachelib {
 
@@ -34,49 +42,115 @@ using folly::fibers::TimedMutex;
 // invalidated and can be used to execute some function if not invalidated. The
 // user guarantees that the lifetime of the token is within the lifetime of the
 // string piece with which they obtain the token.
+//
+// The puts are tracked in an open addressed table of atomic slots, one per
+// token, that records the hash of the key and the state of the token. A key
+// is probed for in a small window of slots starting at a position given by
+// its hash, so acquiring, invalidating, executing and releasing tokens are
+// lock free. Keys are only compared by their hash, so a collision invalidates
+// or fails a put for another key, which only costs an nvmcache write. The
+// table is sized by reserve() for the puts expected in flight. If the window
+// of a key is taken, its put is tracked by the hash of the key in an overflow
+// map under the mutex instead, so that a burst of puts does not fail. An
+// invalidation of a token whose function is being executed waits on the
+// mutex until the function is done.
+//
+// A token that is rekeyed belongs to a put batched after its item was
+// released. Lookups leave such a token valid and wait for the put to be done
+// instead, since cancelling it would lose the item.
 class alignas(folly::hardware_destructive_interference_size) InFlightPuts {
-  using LockGuard = std::lock_guard<TimedMutex>;
-  using UniqueLock = std::unique_lock<TimedMutex>;
-
  public:
   class PutToken;
-  // inserts an in-flight put into the map if none exists and acquires a
+
+  InFlightPuts() { reserve(0); }
+
+  // sizes the table for about expectedPuts puts in flight at a time. Not
+  // thread safe; only to be called before the table is used.
+  void reserve(size_t expectedPuts) {
+    // keep the table at most half full, so that windows are rarely taken
+    const size_t numSlots = folly::nextPowTwo(
+        std::clamp<size_t>(2 * expectedPuts, kMinSlots, kMaxSlots));
+    slots_ = std::make_unique<std::atomic<uint64_t>[]>(numSlots);
+    mask_ = static_cast<uint32_t>(numSlots - 1);
+    shift_ = 64 - (folly::findLastSet(numSlots) - 1);
+  }
+
+  // inserts an in-flight put into the table if none exists and acquires a
   // token. Caller can check if the token is valid to determine if they can
-  // use it to complete the operation.
+  // use it to complete the operation. Fails if a put for the key is in
+  // flight already.
   PutToken tryAcquireToken(folly::StringPiece key) {
-    UniqueLock l(mutex_, std::try_to_lock);
-    if (!l.owns_lock()) {
+    const uint64_t tag = tagOf(key);
+    // record for same key being inflight written to nvmcache should be rare.
+    // In that case, fail the latter one.
+    if (find(tag) != kNoSlot || inOverflow(tag)) {
       return PutToken{};
     }
 
-    auto ret = keys_.emplace(key, true);
-    // record for same key being inflight written to nvmcache should be rare.
-    // In that case, fail the latter one.
-    if (ret.second) {
-      return PutToken{key, *this};
+    for (uint32_t p = 0; p < kProbes; p++) {
+      const uint32_t i = slotOf(tag, p);
+      uint64_t expected = kEmpty;
+      if (slots_[i].load(std::memory_order_relaxed) == kEmpty &&
+          slots_[i].compare_exchange_strong(expected, tag | kValid,
+                                            std::memory_order_seq_cst)) {
+        // a racing acquire for the same key can claim another slot or an
+        // overflow entry. Both back off then, since neither can tell which
+        // one came first.
+        if (find(tag, i) != kNoSlot || inOverflow(tag)) {
+          slots_[i].store(kEmpty, std::memory_order_release);
+          return PutToken{};
+        }
+        return PutToken{key, tag, i, *this};
+      }
     }
-    return PutToken{};
+
+    std::lock_guard<TimedMutex> l(mutex_);
+    if (!overflow_.emplace(tag, kValid).second) {
+      return PutToken{};
+    }
+    numOverflow_.fetch_add(1, std::memory_order_seq_cst);
+    if (find(tag) != kNoSlot) {
+      overflow_.erase(tag);
+      numOverflow_.fetch_sub(1, std::memory_order_relaxed);
+      return PutToken{};
+    }
+    return PutToken{key, tag, kOverflowSlot, *this};
   }
 
   // marks the token as invalidated. This will ensure that we dont execute any
   // function on this token and simply remove the token when the token gets
-  // destroyed.
+  // destroyed. Waits for a function being executed on the token to finish.
   void invalidateToken(folly::StringPiece key) {
-    LockGuard l(mutex_);
-    auto it = keys_.find(key);
-    if (it != keys_.end()) {
-      it->second = false;
+    invalidate(tagOf(key), false /* keepBatched */);
+  }
+
+  // invalidates the token like invalidateToken, unless it was rekeyed for a
+  // batched put.
+  //
+  // @return  true if a batched put for the key stays in flight
+  bool invalidateUnbatchedToken(folly::StringPiece key) {
+    return invalidate(tagOf(key), true /* keepBatched */);
+  }
+
+  // waits until the batched put for the key is done or invalidated.
+  void waitForBatchedToken(folly::StringPiece key) {
+    const uint64_t tag = tagOf(key);
+    std::unique_lock<TimedMutex> l(mutex_);
+    numWaiters_.fetch_add(1, std::memory_order_seq_cst);
+    while (isBatchedLocked(tag)) {
+      busyCond_.wait(l);
     }
+    numWaiters_.fetch_sub(1, std::memory_order_relaxed);
   }
 
-  // Represents an insertion into the inflight map. this token can be used to
+  // Represents an insertion into the inflight table. this token can be used to
   // execute some action if the token was not invalidated in the mean time.
   class PutToken {
    public:
     PutToken() noexcept {}
     ~PutToken() {
       if (puts_) {
-        puts_->removeToken(key_);
+        puts_->removeToken(tag_, slot_);
       }
     }
 
@@ -85,7 +159,11 @@ class alignas(folly::hardware_destructive_interference_size) InFlightPuts {
     PutToken& operator=(const PutToken&) = delete;
 
     // moving is okay
-    PutToken(PutToken&& other) noexcept : key_(other.key_), puts_(other.puts_) {
+    PutToken(PutToken&& other) noexcept
+        : key_(other.key_),
+          tag_(other.tag_),
+          slot_(other.slot_),
+          puts_(other.puts_) {
       other.reset();
     }
 
@@ -105,8 +183,10 @@ class alignas(folly::hardware_destructive_interference_size) InFlightPuts {
     // invalidation. destroys the token state accordingly.
     template <typename F>
     bool executeIfValid(F&& fn) {
-      if (isValid() &&
-          puts_->executeIfValid(key_, std::forward<decltype(fn)>(fn))) {
+      if (isValid() && puts_->executeIfValid(tag_, slot_, [&fn]() {
+            fn();
+            return true;
+          })) {
         // successfully executed, reset the token.
         reset();
         return true;
@@ -114,6 +194,50 @@ class alignas(folly::hardware_destructive_interference_size) InFlightPuts {
       return false;
     }
 
+    // executes fn if the token is valid and there has been no invalidation,
+    // like executeIfValid. fn returns whether it is done, and the token state
+    // is only destroyed then. Otherwise the token stays valid, so that fn can
+    // be executed again later.
+    //
+    // @return  true if fn was executed
+    template <typename F>
+    bool executeIfValidUntilDone(F&& fn) {
+      bool done = false;
+      if (isValid() && puts_->executeIfValid(tag_, slot_, [&fn, &done]() {
+            done = fn();
+            return done;
+          })) {
+        if (done) {
+          reset();
+        }
+        return true;
+      }
+      return false;
+    }
+
+    // executes fn if the token is valid and there has been no invalidation,
+    // like executeIfValid. Instead of destroying the token state afterwards,
+    // the token is moved to key, a copy of its key that outlives the original
+    // one, and marked batched. This keeps a put in flight after the item it
+    // was obtained for is released, and lookups wait for it.
+    //
+    // @return  true if fn was executed
+    template <typename F>
+    bool rekeyIfValid(folly::StringPiece key, F&& fn) {
+      XDCHECK_EQ(key, key_);
+      if (isValid() && puts_->executeIfValid(
+                           tag_, slot_,
+                           [&fn]() {
+                             fn();
+                             return false;
+                           },
+                           true /* batch */)) {
+        key_ = key;
+        return true;
+      }
+      return false;
+    }
+
    private:
     void reset() noexcept {
       puts_ = nullptr;
@@ -122,49 +246,270 @@ class alignas(folly::hardware_destructive_interference_size) InFlightPuts {
     }
 
     friend InFlightPuts;
-    PutToken(folly::StringPiece key, InFlightPuts& puts)
-        : key_(key), puts_(&puts) {}
+    PutToken(folly::StringPiece key,
+             uint64_t tag,
+             uint32_t slot,
+             InFlightPuts& puts)
+        : key_(key), tag_(tag), slot_(slot), puts_(&puts) {}
 
     // key corresponding to the token
     folly::StringPiece key_{};
 
-    // map holding the state
+    // hash of the key and the slot holding the state of the token, or
+    // kOverflowSlot if the overflow map holds it
+    uint64_t tag_{0};
+    uint32_t slot_{0};
+
+    // table holding the state
     InFlightPuts* puts_{nullptr};
   };
 
  private:
-  // execute only if the token is present and was not invalidated.
-  //  @param key the item key
-  //  @param fn  function to execute
+  // the low bits of a slot hold the state of the token, the others the hash
+  // of its key
+  static constexpr uint64_t kEmpty = 0;
+  static constexpr uint64_t kValid = 1;
+  static constexpr uint64_t kInvalid = 2;
+  static constexpr uint64_t kBusy = 3;
+  static constexpr uint64_t kBatched = 4;
+  static constexpr uint64_t kStateMask = 7;
+  static constexpr uint64_t kTagMask = ~kStateMask;
+
+  // bounds of the number of slots
+  static constexpr size_t kMinSlots = 16;
+  static constexpr size_t kMaxSlots = size_t{1} << 24;
+  // number of slots a key can be held in, a cache line worth
+  static constexpr uint32_t kProbes = 8;
+  static constexpr uint32_t kNoSlot = std::numeric_limits<uint32_t>::max();
+  // slot of the tokens held in the overflow map
+  static constexpr uint32_t kOverflowSlot = kNoSlot;
+
+  static uint64_t tagOf(folly::StringPiece key) {
+    return folly::hasher<folly::StringPiece>{}(key) & kTagMask;
+  }
+
+  // @return  the p-th slot of the window of the tag. The window starts at the
+  //          high bits of the tag, since nvmcache shards keys by the low ones.
+  uint32_t slotOf(uint64_t tag, uint32_t p) const {
+    return (static_cast<uint32_t>(tag >> shift_) + p) & mask_;
+  }
+
+  // @return  the slot of a token for the tag other than skip, or kNoSlot
+  uint32_t find(uint64_t tag, uint32_t skip = kNoSlot) const {
+    for (uint32_t p = 0; p < kProbes; p++) {
+      const uint32_t i = slotOf(tag, p);
+      // sequentially consistent with acquiring a slot and an overflow entry,
+      // so that racing acquires for the same key see each other
+      const auto word = slots_[i].load(std::memory_order_seq_cst);
+      if (i != skip && word != kEmpty && (word & kTagMask) == tag) {
+        return i;
+      }
+    }
+    return kNoSlot;
+  }
+
+  // invalidates the token for the tag, leaving it valid if it is batched and
+  // keepBatched is set.
+  //
+  // @return  true if a batched token was left valid
+  bool invalidate(uint64_t tag, bool keepBatched) {
+    bool batched = false;
+    for (uint32_t p = 0; p < kProbes; p++) {
+      auto& slot = slots_[slotOf(tag, p)];
+      uint64_t word = slot.load(std::memory_order_acquire);
+      while ((word & kTagMask) == tag && (word & kStateMask) != kEmpty) {
+        const uint64_t state = word & kStateMask;
+        if (state == kBusy) {
+          waitWhileBusy(slot, word);
+          word = slot.load(std::memory_order_acquire);
+          continue;
+        }
+        if (state == kInvalid) {
+          break;
+        }
+        if (state == kBatched && keepBatched) {
+          batched = true;
+          break;
+        }
+        if (slot.compare_exchange_weak(word, tag | kInvalid,
+                                       std::memory_order_seq_cst)) {
+          if (state == kBatched) {
+            notifyWaiters();
+          }
+          break;
+        }
+      }
+    }
+
+    if (numOverflow_.load(std::memory_order_seq_cst) == 0) {
+      return batched;
+    }
+    std::unique_lock<TimedMutex> l(mutex_);
+    auto it = overflow_.find(tag);
+    while (it != overflow_.end() && it->second == kBusy) {
+      busyCond_.wait(l);
+      it = overflow_.find(tag);
+    }
+    if (it != overflow_.end()) {
+      if (it->second == kBatched && keepBatched) {
+        batched = true;
+      } else if (it->second == kBatched) {
+        it->second = kInvalid;
+        busyCond_.notifyAll();
+      } else {
+        it->second = kInvalid;
+      }
+    }
+    return batched;
+  }
+
+  // @return  true if a token for the tag is batched or busy. Called with the
+  //          mutex held.
+  bool isBatchedLocked(uint64_t tag) const {
+    for (uint32_t p = 0; p < kProbes; p++) {
+      const auto word = slots_[slotOf(tag, p)].load(std::memory_order_seq_cst);
+      const uint64_t state = word & kStateMask;
+      if ((word & kTagMask) == tag && (state == kBatched || state == kBusy)) {
+        return true;
+      }
+    }
+    auto it = overflow_.find(tag);
+    return it != overflow_.end() &&
+           (it->second == kBatched || it->second == kBusy);
+  }
+
+  // @return  true if the overflow map holds a token for the tag
+  bool inOverflow(uint64_t tag) {
+    if (numOverflow_.load(std::memory_order_seq_cst) == 0) {
+      return false;
+    }
+    std::lock_guard<TimedMutex> l(mutex_);
+    return overflow_.count(tag) != 0;
+  }
+
+  // execute only if the token was not invalidated. fn returns whether the
+  // token is done, which destroys its state.
+  //  @param tag    hash of the key of the token
+  //  @param slot   slot of the token
+  //  @param fn     function to execute
+  //  @param batch  mark the token batched if it is not done
   //
-  //  @return  true if the function was executed and token was destroyed
-  //          appropriately
+  //  @return  true if the function was executed
   //  @throw    if fn throws, token is preserved.
   template <typename F>
-  bool executeIfValid(folly::StringPiece key, F&& fn) {
-    LockGuard l(mutex_);
-    auto it = keys_.find(key);
-    const bool valid = it != keys_.end() && it->second;
-    if (valid) {
-      fn();
-      keys_.erase(it);
-      return true;
+  bool executeIfValid(uint64_t tag,
+                      uint32_t slot,
+                      F&& fn,
+                      bool batch = false) {
+    uint64_t state = kEmpty;
+    if (slot == kOverflowSlot) {
+      std::lock_guard<TimedMutex> l(mutex_);
+      auto it = overflow_.find(tag);
+      XDCHECK(it != overflow_.end());
+      state = it->second;
+      if (state != kValid && state != kBatched) {
+        return false;
+      }
+      it->second = kBusy;
+    } else {
+      uint64_t word = slots_[slot].load(std::memory_order_acquire);
+      do {
+        state = word & kStateMask;
+        if (state != kValid && state != kBatched) {
+          return false;
+        }
+      } while (!slots_[slot].compare_exchange_weak(
+          word, tag | kBusy, std::memory_order_acq_rel));
+    }
+
+    bool done = false;
+    try {
+      done = fn();
+    } catch (...) {
+      finishBusy(tag, slot, state);
+      throw;
+    }
+    finishBusy(tag, slot, done ? kEmpty : (batch ? kBatched : state));
+    return true;
+  }
+
+  // moves a busy token to its state after executing the function and wakes up
+  // the invalidations waiting for it.
+  void finishBusy(uint64_t tag, uint32_t slot, uint64_t state) {
+    if (slot == kOverflowSlot) {
+      std::lock_guard<TimedMutex> l(mutex_);
+      if (state == kEmpty) {
+        eraseOverflowLocked(tag);
+      } else {
+        overflow_[tag] = state;
+      }
+      busyCond_.notifyAll();
+      return;
+    }
+
+    slots_[slot].store(state == kEmpty ? kEmpty : tag | state,
+                       std::memory_order_seq_cst);
+    notifyWaiters();
+  }
+
+  // wakes up the threads waiting for a slot to change, if there are any. The
+  // change is sequentially consistent with registering a waiter, so that
+  // either the waiter sees the change or we see the waiter.
+  void notifyWaiters() {
+    if (numWaiters_.load(std::memory_order_seq_cst) > 0) {
+      std::lock_guard<TimedMutex> l(mutex_);
+      busyCond_.notifyAll();
+    }
+  }
+
+  // waits until the slot no longer holds busy, the state read from it.
+  void waitWhileBusy(std::atomic<uint64_t>& slot, uint64_t busy) {
+    std::unique_lock<TimedMutex> l(mutex_);
+    numWaiters_.fetch_add(1, std::memory_order_seq_cst);
+    while (slot.load(std::memory_order_seq_cst) == busy) {
+      busyCond_.wait(l);
     }
-    return false;
+    numWaiters_.fetch_sub(1, std::memory_order_relaxed);
   }
 
-  // erases the record from inflight map.
-  void removeToken(folly::StringPiece key) {
-    LockGuard l(mutex_);
-    auto res = keys_.erase(key);
-    XDCHECK_EQ(res, 1u);
+  // erases the record from the inflight table.
+  void removeToken(uint64_t tag, uint32_t slot) {
+    if (slot == kOverflowSlot) {
+      std::lock_guard<TimedMutex> l(mutex_);
+      XDCHECK_NE(overflow_.at(tag), kBusy);
+      eraseOverflowLocked(tag);
+      busyCond_.notifyAll();
+      return;
+    }
+    XDCHECK_NE(slots_[slot].load(std::memory_order_relaxed) & kStateMask,
+               kBusy);
+    slots_[slot].store(kEmpty, std::memory_order_seq_cst);
+    notifyWaiters();
   }
 
-  // map storing the presence of a token  and its validity
-  folly::F14FastMap<folly::StringPiece, bool, folly::Hash> keys_;
+  void eraseOverflowLocked(uint64_t tag) {
+    auto it = overflow_.find(tag);
+    XDCHECK(it != overflow_.end());
+    overflow_.erase(it);
+    numOverflow_.fetch_sub(1, std::memory_order_relaxed);
+  }
 
-  // mutex protecting the map.
+  // the hash of the key and the state of every token
+  std::unique_ptr<std::atomic<uint64_t>[]> slots_;
+  uint32_t mask_{0};
+  // shift of a tag to the start of its window
+  uint32_t shift_{0};
+
+  // held while waiting for a busy or batched token and while the overflow
+  // map is accessed, not while a function is executed
   TimedMutex mutex_;
+  util::ConditionVariable busyCond_;
+  // number of threads waiting for a busy or batched slot
+  std::atomic<uint32_t> numWaiters_{0};
+
+  // state of the tokens that did not get a slot, by the hash of their key
+  folly::F14FastMap<uint64_t, uint64_t> overflow_;
+  std::atomic<uint32_t> numOverflow_{0};
 };
 
 } // namespace cachelib
@@ -155,6 +155,26 @@ BigHashConfig& BigHashConfig::setSizePctAndMaxItemSize(
   return *this;
 }
 
+BigHashConfig& BigHashConfig::setAdaptiveSmallItemMaxSize(
+    uint32_t bucketSize,
+    uint32_t updateIntervalSecs,
+    unsigned int hysteresisPct) {
+  if (updateIntervalSecs == 0) {
+    throw std::invalid_argument(
+        "update interval of the adaptive small item max size should be "
+        "greater than 0");
+  }
+  if (hysteresisPct > 100) {
+    throw std::invalid_argument(folly::sformat(
+        "hysteresis pct should be in the range of [0, 100], but {} is set",
+        hysteresisPct));
+  }
+  adaptiveBucketSize_ = bucketSize;
+  adaptiveUpdateIntervalSecs_ = updateIntervalSecs;
+  adaptiveHysteresisPct_ = hysteresisPct;
+  return *this;
+}
+
 // job scheduler settings
 
 void NavyConfig::setReaderAndWriterThreads(unsigned int readerThreads,
@@ -245,6 +265,12 @@ std::map<std::string, std::string> EnginesConfig::serialize() const {
       folly::to<std::string>(bigHash().getBucketBfSize());
   configMap["navyConfig::bigHashSmallItemMaxSize"] =
       folly::to<std::string>(bigHash().getSmallItemMaxSize());
+  configMap["navyConfig::bigHashAdaptiveBucketSize"] =
+      folly::to<std::string>(bigHash().getAdaptiveBucketSize());
+  configMap["navyConfig::bigHashAdaptiveUpdateIntervalSecs"] =
+      folly::to<std::string>(bigHash().getAdaptiveUpdateIntervalSecs());
+  configMap["navyConfig::bigHashAdaptiveHysteresisPct"] =
+      folly::to<std::string>(bigHash().getAdaptiveHysteresisPct());
   return configMap;
 }
 
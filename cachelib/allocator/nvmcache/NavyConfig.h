@@ -402,8 +402,22 @@ class BigHashConfig {
     return *this;
   }
 
+  // Learn the small item max size instead of keeping it fixed. Starting from
+  // smallItemMaxSize, it moves by buckets of bucketSize bytes towards the
+  // engine that gets more hits per byte written, once one of them leads by
+  // more than hysteresisPct percent. 0 bucketSize, the default, disables it.
+  // @throw std::invalid_argument if updateIntervalSecs is 0 or hysteresisPct
+  //        is not in the range of [0, 100].
+  BigHashConfig& setAdaptiveSmallItemMaxSize(uint32_t bucketSize,
+                                             uint32_t updateIntervalSecs = 60,
+                                             unsigned int hysteresisPct = 20);
+
   bool isBloomFilterEnabled() const { return bucketBfSize_ > 0; }
 
+  bool isAdaptiveSmallItemMaxSizeEnabled() const {
+    return adaptiveBucketSize_ > 0;
+  }
+
   unsigned int getSizePct() const { return sizePct_; }
 
   uint32_t getBucketSize() const { return bucketSize_; }
@@ -412,6 +426,16 @@ class BigHashConfig {
 
   uint64_t getSmallItemMaxSize() const { return smallItemMaxSize_; }
 
+  uint32_t getAdaptiveBucketSize() const { return adaptiveBucketSize_; }
+
+  uint32_t getAdaptiveUpdateIntervalSecs() const {
+    return adaptiveUpdateIntervalSecs_;
+  }
+
+  unsigned int getAdaptiveHysteresisPct() const {
+    return adaptiveHysteresisPct_;
+  }
+
  private:
   // Percentage of how much of the device out of all is given to BigHash
   // engine in Navy, e.g. 50.
@@ -425,6 +449,13 @@ class BigHashConfig {
   uint64_t bucketBfSize_{8};
   // The maximum item size to put into Navy BigHash engine.
   uint64_t smallItemMaxSize_{};
+  // Size buckets the learned small item max size moves by. 0 keeps it fixed.
+  uint32_t adaptiveBucketSize_{0};
+  // How often the learned small item max size is re-evaluated.
+  uint32_t adaptiveUpdateIntervalSecs_{60};
+  // By how many percent the hits per byte written of one engine have to
+  // exceed the other's for the small item max size to move.
+  unsigned int adaptiveHysteresisPct_{20};
 };
 
 // Config for a pair of small,large engines.
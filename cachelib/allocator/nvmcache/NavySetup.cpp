@@ -104,6 +104,12 @@ uint64_t setupBigHash(const navy::BigHashConfig& bigHashConfig,
   }
 
   proto.setBigHash(std::move(bigHash), bigHashConfig.getSmallItemMaxSize());
+  if (bigHashConfig.isAdaptiveSmallItemMaxSizeEnabled()) {
+    proto.setAdaptiveSmallItemMaxSize(
+        bigHashConfig.getAdaptiveBucketSize(),
+        std::chrono::seconds{bigHashConfig.getAdaptiveUpdateIntervalSecs()},
+        bigHashConfig.getAdaptiveHysteresisPct() / 100.0);
+  }
 
   if (bigHashCacheOffset <= bigHashStartOffsetLimit) {
     throw std::invalid_argument("NVM cache size is not big enough!");
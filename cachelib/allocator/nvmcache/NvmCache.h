@@ -23,10 +23,14 @@
 #include <folly/json/dynamic.h>
 #include <folly/json/json.h>
 
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <limits>
 #include <stdexcept>
 #include <vector>
 
+#include "cachelib/allocator/Cache.h"
 #include "cachelib/allocator/nvmcache/CacheApiWrapper.h"
 #include "cachelib/allocator/nvmcache/InFlightPuts.h"
 #include "cachelib/allocator/nvmcache/NavyConfig.h"
@@ -35,10 +39,13 @@
 #include "cachelib/allocator/nvmcache/ReqContexts.h"
 #include "cachelib/allocator/nvmcache/TombStones.h"
 #include "cachelib/allocator/nvmcache/WaitContext.h"
+#include "cachelib/allocator/nvmcache/WritebackBatch.h"
 #include "cachelib/common/AtomicCounter.h"
+#include "cachelib/common/CountMinSketch.h"
 #include "cachelib/common/EventInterface.h"
 #include "cachelib/common/Exceptions.h"
 #include "cachelib/common/Hash.h"
+#include "cachelib/common/PeriodicWorker.h"
 #include "cachelib/common/Utils.h"
 #include "cachelib/navy/common/Device.h"
 #include "folly/Range.h"
@@ -109,6 +116,36 @@ class NvmCache {
     // If true, only store the orignal size the user requested.
     bool truncateItemToOriginalAllocSizeInNvm{false};
 
+    // (Optional) bytes of evicted items that are collected and written to navy
+    // in one batch instead of one insert per item. 0 disables batching.
+    uint32_t writebackBatchBytes{0};
+
+    // the longest a partial batch waits for more items before it is written.
+    // A put writes out the batch of its stripe once it is this old, and a
+    // background worker writes out the batches of stripes without puts. It
+    // runs once per max delay, rounded up to a millisecond.
+    std::chrono::microseconds writebackBatchMaxDelay{1000};
+
+    // number of flash hits on a key before a hit inserts the item into DRAM.
+    // Earlier hits return the item through a handle that is not inserted and
+    // is freed once released, so items that are rarely read again do not
+    // evict DRAM data. Hits are counted approximately. 1 promotes every hit.
+    uint32_t promotionMinFlashHits{1};
+
+    // items whose allocations, including chained ones, are smaller than this
+    // are promoted on every hit, regardless of promotionMinFlashHits.
+    uint32_t promotionMinItemSize{0};
+
+    // approximate number of keys whose flash hits are tracked. Counts are
+    // halved after as many hits, so keys that stop being read lose their
+    // earlier hits.
+    uint32_t promotionTrackedKeys{1'000'000};
+
+    // insert promoted items where DRAM evicts them first unless they are
+    // read again, instead of at the head of the eviction queue. Only
+    // MMContainers with a cold queue (MM2Q) support this; others ignore it.
+    bool promoteCold{false};
+
     // serialize the config for debugging purposes
     std::map<std::string, std::string> serialize() const;
 
@@ -128,10 +165,14 @@ class NvmCache {
            bool truncate,
            const ItemDestructor& itemDestructor);
 
-  // Look up item by key
+  // Look up item by key. A hit is inserted into DRAM unless the promotion
+  // policy returns it transiently, through a handle to an item that is not
+  // inserted and is freed once released. Lookups to write always insert.
+  //
   // @param key         key to lookup
+  // @param mode        whether the item is looked up to read or to write
   // @return            WriteHandle
-  WriteHandle find(HashedKey key);
+  WriteHandle find(HashedKey key, AccessMode mode = AccessMode::kRead);
 
   // Returns true if a key is potentially in cache. There is a non-zero chance
   // the key does not exist in cache (e.g. hash collision in NvmCache). This
@@ -284,6 +325,42 @@ class NvmCache {
 
   std::unique_ptr<NvmItem> makeNvmItem(const Item& item);
 
+  // serializes the item and its chained items into an NvmItem created by
+  // make(variableSize, ctorArgs...), after running the encode callback.
+  //
+  // @return  the result of make, or T{} if the encode callback failed
+  template <typename T, typename MakeFn>
+  T serializeItem(const Item& item, MakeFn&& make);
+
+  // adds the put of the item to the writeback batch of its stripe and writes
+  // out the batches that are complete. The token moves to the copy of the key
+  // in the batch, so a remove for the key cancels the put until navy inserts
+  // it, and a get waits for the insert.
+  void putBatched(Item& item,
+                  HashedKey hk,
+                  PutToken token,
+                  util::LatencyTracker tracker);
+
+  // queues the inserts of all entries of the batch to navy
+  void submitWritebackBatch(std::unique_ptr<WritebackBatch> batch);
+
+  // writes out the partial batches of all stripes that are at least minAge
+  // old.
+  void flushWritebackBatches(
+      std::chrono::microseconds minAge = std::chrono::microseconds{0});
+
+  // writes out the partial batch of the stripe of the key and waits until the
+  // batched put for the key is inserted into navy or cancelled.
+  void waitForWriteback(HashedKey hk);
+
+  // records a flash hit on the key and decides if the item is inserted into
+  // DRAM, or only returned to the waiters of the lookup.
+  //
+  // @param hk        the key of the item
+  // @param nvmItem   the item read from navy
+  // @return  true if the item should be inserted into DRAM
+  bool recordFlashHit(HashedKey hk, const NvmItem& nvmItem);
+
   // wrap an item into a blob for writing into navy.
   Blob makeBlob(const Item& it);
   uint32_t getStorageSizeInNvm(const Item& it);
@@ -299,6 +376,7 @@ class NvmCache {
     WriteHandle it; // will be set when Context is being filled
     util::LatencyTracker tracker_;
     bool valid_;
+    bool mustPromote_{false}; // a waiter looks up the item to write
 
     GetCtx(NvmCache& c,
            folly::StringPiece k,
@@ -359,6 +437,11 @@ class NvmCache {
     void invalidate() { valid_ = false; }
 
     bool isValid() const { return valid_; }
+
+    // the filled item has to be inserted into DRAM regardless of the
+    // promotion policy
+    void markMustPromote() { mustPromote_ = true; }
+    bool mustPromote() const { return mustPromote_; }
   };
 
   // Erase entry for the ctx from the fill map
@@ -459,6 +542,31 @@ class NvmCache {
   std::array<InFlightPuts, kShards> inflightPuts_;
   std::array<TombStones, kShards> tombstones_;
 
+  // evicted items waiting to be written to navy in a batch. Striped by key so
+  // that evicting threads mostly add to different batches.
+  struct WritebackStripe {
+    alignas(folly::hardware_destructive_interference_size) TimedMutex mutex;
+    std::unique_ptr<WritebackBatch> batch;
+  };
+  static constexpr size_t kWritebackStripes = 16;
+  // size of a small item in a writeback batch, which the in-flight put
+  // tables are sized for
+  static constexpr size_t kSmallWritebackEntryBytes = 256;
+  std::array<WritebackStripe, kWritebackStripes> writebackStripes_;
+
+  // approximate counts of flash hits per key, that promote an item into DRAM
+  // once they reach promotionMinFlashHits. Striped by key like the writeback
+  // batches. Only allocated if promotionMinFlashHits is larger than 1.
+  struct PromotionStripe {
+    alignas(folly::hardware_destructive_interference_size) TimedMutex mutex;
+    util::CountMinSketch8 flashHits;
+    // hits recorded since the counts were last halved
+    size_t numHits{0};
+  };
+  static constexpr size_t kPromotionStripes = 16;
+  static constexpr uint32_t kPromotionSketchDepth = 4;
+  std::array<PromotionStripe, kPromotionStripes> promotionStripes_;
+
   const ItemDestructor itemDestructor_;
 
   mutable std::array<TimedMutex, kShards> itemDestructorMutex_{TimedMutex()};
@@ -472,6 +580,24 @@ class NvmCache {
 
   std::unique_ptr<cachelib::navy::AbstractCache> navyCache_;
 
+  // writes out the writeback batches that waited for the max delay
+  class WritebackFlusher : public PeriodicWorker {
+   public:
+    explicit WritebackFlusher(NvmCache& nvmCache) : nvmCache_(nvmCache) {}
+    ~WritebackFlusher() override { stop(); }
+
+   private:
+    void work() override {
+      nvmCache_.flushWritebackBatches(nvmCache_.config_.writebackBatchMaxDelay);
+    }
+
+    NvmCache& nvmCache_;
+  };
+  static constexpr folly::StringPiece kWritebackFlusherName{
+      "NvmCacheWritebackFlusher"};
+  // declared last, so it is stopped before the state it flushes is destroyed
+  std::unique_ptr<WritebackFlusher> writebackFlusher_;
+
   friend class tests::NvmCacheTest;
   FRIEND_TEST(CachelibAdminTest, WorkingSetAnalysisLoggingTest);
 };
@@ -485,6 +611,13 @@ std::map<std::string, std::string> NvmCache<C>::Config::serialize() const {
   configMap["encryption"] = deviceEncryptor ? "set" : "empty";
   configMap["truncateItemToOriginalAllocSizeInNvm"] =
       truncateItemToOriginalAllocSizeInNvm ? "true" : "false";
+  configMap["writebackBatchBytes"] = std::to_string(writebackBatchBytes);
+  configMap["writebackBatchMaxDelayUs"] =
+      std::to_string(writebackBatchMaxDelay.count());
+  configMap["promotionMinFlashHits"] = std::to_string(promotionMinFlashHits);
+  configMap["promotionMinItemSize"] = std::to_string(promotionMinItemSize);
+  configMap["promotionTrackedKeys"] = std::to_string(promotionTrackedKeys);
+  configMap["promoteCold"] = promoteCold ? "true" : "false";
   return configMap;
 }
 
@@ -523,6 +656,22 @@ typename NvmCache<C>::Config NvmCache<C>::Config::validateAndSetDefaults() {
     }
   }
 
+  if (promotionMinFlashHits == 0) {
+    throw std::invalid_argument(
+        "promotionMinFlashHits must be at least 1 to promote any item.");
+  }
+
+  if (promotionMinFlashHits > std::numeric_limits<uint8_t>::max()) {
+    throw std::invalid_argument(folly::sformat(
+        "promotionMinFlashHits can not be larger than {}. Current: {}",
+        std::numeric_limits<uint8_t>::max(), promotionMinFlashHits));
+  }
+
+  if (promotionMinFlashHits > 1 && promotionTrackedKeys == 0) {
+    throw std::invalid_argument(
+        "promotionTrackedKeys must be set to track flash hits.");
+  }
+
   return *this;
 }
 
@@ -556,7 +705,8 @@ bool NvmCache<C>::hasTombStone(HashedKey hk) {
 }
 
 template <typename C>
-typename NvmCache<C>::WriteHandle NvmCache<C>::find(HashedKey hk) {
+typename NvmCache<C>::WriteHandle NvmCache<C>::find(HashedKey hk,
+                                                    AccessMode mode) {
   if (!isEnabled()) {
     return WriteHandle{};
   }
@@ -565,8 +715,11 @@ typename NvmCache<C>::WriteHandle NvmCache<C>::find(HashedKey hk) {
 
   auto shard = getShardForKey(hk);
   // invalidateToken any inflight puts for the same key since we are filling
-  // from nvmcache.
-  inflightPuts_[shard].invalidateToken(hk.key());
+  // from nvmcache. A put waiting in a writeback batch is not cancelled, since
+  // its item is no longer in DRAM. We wait for navy to insert it instead.
+  if (inflightPuts_[shard].invalidateUnbatchedToken(hk.key())) {
+    waitForWriteback(hk);
+  }
 
   stats().numNvmGets.inc();
 
@@ -623,6 +776,9 @@ typename NvmCache<C>::WriteHandle NvmCache<C>::find(HashedKey hk) {
 
     if (it != fillMap.end()) {
       ctx = it->second.get();
+      if (mode == AccessMode::kWrite) {
+        ctx->markMustPromote();
+      }
       ctx->addWaiter(std::move(waitContext));
       stats().numNvmGetCoalesced.inc();
       return hdl;
@@ -635,6 +791,9 @@ typename NvmCache<C>::WriteHandle NvmCache<C>::find(HashedKey hk) {
         fillMap.emplace(std::make_pair(newCtx->getKey(), std::move(newCtx)));
     XDCHECK(res.second);
     ctx = res.first->second.get();
+    if (mode == AccessMode::kWrite) {
+      ctx->markMustPromote();
+    }
   } // scope for fill lock
 
   XDCHECK(ctx);
@@ -657,8 +816,10 @@ bool NvmCache<C>::couldExistFast(HashedKey hk) {
 
   auto shard = getShardForKey(hk);
   // invalidateToken any inflight puts for the same key since we are filling
-  // from nvmcache.
-  inflightPuts_[shard].invalidateToken(hk.key());
+  // from nvmcache. A put waiting in a writeback batch will insert the item.
+  if (inflightPuts_[shard].invalidateUnbatchedToken(hk.key())) {
+    return true;
+  }
 
   auto lock = getFillLockForShard(shard);
   // do not use the Cache::find() since that will call back into us.
@@ -902,6 +1063,32 @@ NvmCache<C>::NvmCache(C& c,
       truncate,
       std::move(config.deviceEncryptor),
       itemDestructor_ ? true : false);
+
+  if (config_.promotionMinFlashHits > 1) {
+    const auto width = std::max<uint32_t>(
+        1, config_.promotionTrackedKeys / kPromotionStripes);
+    for (auto& stripe : promotionStripes_) {
+      stripe.flashHits = util::CountMinSketch8{width, kPromotionSketchDepth};
+    }
+  }
+
+  if (config_.writebackBatchBytes > 0) {
+    // every item in a batch that is filled or being inserted holds a put
+    // token until it is committed to navy
+    const size_t batchedPuts = 2 * kWritebackStripes *
+                               config_.writebackBatchBytes /
+                               kSmallWritebackEntryBytes;
+    for (auto& puts : inflightPuts_) {
+      puts.reserve(batchedPuts / kShards);
+    }
+
+    const auto interval = std::max(
+        std::chrono::milliseconds{1},
+        std::chrono::ceil<std::chrono::milliseconds>(
+            config_.writebackBatchMaxDelay));
+    util::startPeriodicWorker(kWritebackFlusherName, writebackFlusher_,
+                              interval, *this);
+  }
 }
 
 template <typename C>
@@ -923,6 +1110,16 @@ uint32_t NvmCache<C>::getStorageSizeInNvm(const Item& it) {
 
 template <typename C>
 std::unique_ptr<NvmItem> NvmCache<C>::makeNvmItem(const Item& item) {
+  return serializeItem<std::unique_ptr<NvmItem>>(
+      item, [](size_t bufSize, auto&&... args) {
+        return std::unique_ptr<NvmItem>(
+            new (bufSize) NvmItem(std::forward<decltype(args)>(args)...));
+      });
+}
+
+template <typename C>
+template <typename T, typename MakeFn>
+T NvmCache<C>::serializeItem(const Item& item, MakeFn&& make) {
   auto poolId = cache_.getAllocInfo((void*)(&item)).poolId;
 
   if (item.isChainedItem()) {
@@ -934,7 +1131,7 @@ std::unique_ptr<NvmItem> NvmCache<C>::makeNvmItem(const Item& item) {
       CacheAPIWrapperForNvm<C>::viewAsChainedAllocsRange(cache_, item);
   if (config_.encodeCb && !config_.encodeCb(EncodeDecodeContext{
                               const_cast<Item&>(item), chainedItemRange})) {
-    return nullptr;
+    return T{};
   }
 
   if (item.hasChainedItem()) {
@@ -946,13 +1143,13 @@ std::unique_ptr<NvmItem> NvmCache<C>::makeNvmItem(const Item& item) {
     }
 
     const size_t bufSize = NvmItem::estimateVariableSize(blobs);
-    return std::unique_ptr<NvmItem>(new (bufSize) NvmItem(
-        poolId, item.getCreationTime(), item.getExpiryTime(), blobs));
+    return make(bufSize, poolId, item.getCreationTime(), item.getExpiryTime(),
+                blobs);
   } else {
     Blob blob = makeBlob(item);
     const size_t bufSize = NvmItem::estimateVariableSize(blob);
-    return std::unique_ptr<NvmItem>(new (bufSize) NvmItem(
-        poolId, item.getCreationTime(), item.getExpiryTime(), blob));
+    return make(bufSize, poolId, item.getCreationTime(), item.getExpiryTime(),
+                blob);
   }
 }
 
@@ -985,6 +1182,11 @@ void NvmCache<C>::put(Item& item, PutToken token) {
     return;
   }
 
+  if (config_.writebackBatchBytes > 0) {
+    putBatched(item, hk, std::move(token), std::move(tracker));
+    return;
+  }
+
   auto nvmItem = makeNvmItem(item);
   if (!nvmItem) {
     stats().numNvmPutEncodeFailure.inc();
@@ -1048,6 +1250,168 @@ void NvmCache<C>::put(Item& item, PutToken token) {
   }
 }
 
+template <typename C>
+void NvmCache<C>::putBatched(Item& item,
+                             HashedKey hk,
+                             PutToken token,
+                             util::LatencyTracker tracker) {
+  auto& stripe = writebackStripes_[hk.keyHash() % kWritebackStripes];
+  // batches that are complete, written out after releasing the stripe lock
+  std::vector<std::unique_ptr<WritebackBatch>> complete;
+  bool encoded = false;
+  bool executed = false;
+  {
+    std::lock_guard<TimedMutex> l(stripe.mutex);
+    // drops the space reserved for the item unless it was committed
+    auto rollback = folly::makeGuard([&stripe]() {
+      if (stripe.batch) {
+        stripe.batch->rollback();
+      }
+    });
+
+    auto* nvmItem = serializeItem<NvmItem*>(
+        item, [&](size_t bufSize, auto&&... args) {
+          const size_t size = sizeof(NvmItem) + bufSize;
+          constexpr size_t kAlign = alignof(NvmItem);
+          uint8_t* mem = stripe.batch
+                             ? stripe.batch->reserve(hk.key(), size, kAlign)
+                             : nullptr;
+          if (!mem) {
+            if (stripe.batch && !stripe.batch->empty()) {
+              complete.push_back(std::move(stripe.batch));
+            }
+            stripe.batch = std::make_unique<WritebackBatch>(std::max<size_t>(
+                config_.writebackBatchBytes,
+                WritebackBatch::maxEntrySize(hk.key().size(), size, kAlign)));
+            mem = stripe.batch->reserve(hk.key(), size, kAlign);
+          }
+          XDCHECK(mem);
+          return ::new (mem) NvmItem(std::forward<decltype(args)>(args)...);
+        });
+
+    if (nvmItem) {
+      encoded = true;
+      if (item.isNvmClean() && item.isNvmEvicted()) {
+        stats().numNvmPutFromClean.inc();
+      }
+
+      // mark it as NvmClean and unNvmEvicted once it is in the batch, like a
+      // put queued to navy. The token keeps the put in flight after the item
+      // is released, so that a remove for the key cancels the insert and a
+      // get waits for it.
+      auto& batch = *stripe.batch;
+      executed = token.rekeyIfValid(batch.reservedKey(), [&]() {
+        item.markNvmClean();
+        item.unmarkNvmEvicted();
+      });
+      if (executed) {
+        batch.commit(hk.keyHash(), std::move(token), std::move(tracker));
+      }
+    }
+
+    if (stripe.batch && !stripe.batch->empty() &&
+        (stripe.batch->isFull() ||
+         stripe.batch->age() >= config_.writebackBatchMaxDelay)) {
+      complete.push_back(std::move(stripe.batch));
+    }
+  }
+
+  if (!encoded) {
+    stats().numNvmPutEncodeFailure.inc();
+  } else if (!executed) {
+    stats().numNvmAbortedPutOnInflightGet.inc();
+  }
+
+  for (auto& batch : complete) {
+    submitWritebackBatch(std::move(batch));
+  }
+}
+
+template <typename C>
+void NvmCache<C>::submitWritebackBatch(std::unique_ptr<WritebackBatch> batch) {
+  std::shared_ptr<WritebackBatch> shared = std::move(batch);
+  std::vector<navy::InsertBatchEntry> entries;
+  entries.reserve(shared->size());
+  for (size_t i = 0; i < shared->size(); i++) {
+    const auto& entry = shared->at(i);
+    entries.push_back(navy::InsertBatchEntry{
+        HashedKey::precomputed(entry.key, entry.keyHash),
+        makeBufferView(entry.value)});
+  }
+
+  navyCache_->insertBatchAsync(
+      std::move(entries),
+      [this, shared](size_t index, folly::FunctionRef<bool()> insert) {
+        auto& entry = shared->at(index);
+        // inserting under the token orders the insert with gets and removes
+        // for the key, like queueing a single put does.
+        if (entry.token.executeIfValidUntilDone(insert)) {
+          return true;
+        }
+        // a remove for the key came after the item was batched. The item was
+        // released as NvmClean, so its destructor runs here.
+        stats().numNvmAbortedPutOnInflightGet.inc();
+        entry.token = PutToken{};
+        evictCB(HashedKey::precomputed(entry.key, entry.keyHash),
+                makeBufferView(entry.value),
+                navy::DestructorEvent::PutFailed);
+        entry.tracker = util::LatencyTracker{};
+        return false;
+      },
+      [this, shared](size_t index, navy::Status st) {
+        auto& entry = shared->at(index);
+        // entries navy rejects before inserting them still hold their token
+        entry.token = PutToken{};
+        if (st == navy::Status::Ok) {
+          stats().nvmPutSize_.trackValue(entry.value.size());
+        } else if (st == navy::Status::BadState) {
+          // we set disable navy since we got a BadState from navy
+          disableNavy("Insert Failure. BadState");
+        } else {
+          if (st == navy::Status::Rejected) {
+            stats().numNvmPutErrs.inc();
+          }
+          // put failed after the item was released as NvmClean, so we
+          // trigger the destructor here for cleanup.
+          evictCB(HashedKey::precomputed(entry.key, entry.keyHash),
+                  makeBufferView(entry.value),
+                  navy::DestructorEvent::PutFailed);
+        }
+        entry.tracker = util::LatencyTracker{};
+      });
+}
+
+template <typename C>
+void NvmCache<C>::flushWritebackBatches(std::chrono::microseconds minAge) {
+  for (auto& stripe : writebackStripes_) {
+    std::unique_ptr<WritebackBatch> batch;
+    {
+      std::lock_guard<TimedMutex> l(stripe.mutex);
+      if (stripe.batch && stripe.batch->age() >= minAge) {
+        batch = std::move(stripe.batch);
+      }
+    }
+    if (batch && !batch->empty()) {
+      submitWritebackBatch(std::move(batch));
+    }
+  }
+}
+
+template <typename C>
+void NvmCache<C>::waitForWriteback(HashedKey hk) {
+  auto& stripe = writebackStripes_[hk.keyHash() % kWritebackStripes];
+  std::unique_ptr<WritebackBatch> batch;
+  {
+    std::lock_guard<TimedMutex> l(stripe.mutex);
+    batch = std::move(stripe.batch);
+  }
+  // the put may be in a batch that was written out already
+  if (batch && !batch->empty()) {
+    submitWritebackBatch(std::move(batch));
+  }
+  inflightPuts_[getShardForKey(hk)].waitForBatchedToken(hk.key());
+}
+
 template <typename C>
 typename NvmCache<C>::PutToken NvmCache<C>::createPutToken(
     folly::StringPiece key) {
@@ -1090,6 +1454,8 @@ void NvmCache<C>::onGetComplete(GetCtx& ctx,
     return;
   }
 
+  const bool promote = recordFlashHit(hk, *nvmItem);
+
   auto it = createItem(hk.key(), *nvmItem);
   if (!it) {
     stats().numNvmGetMiss.inc();
@@ -1102,6 +1468,9 @@ void NvmCache<C>::onGetComplete(GetCtx& ctx,
 
   XDCHECK(it->isNvmClean());
 
+  // a fill whose item is not inserted. Destroyed after the fill lock is
+  // released, which wakes up its waiters.
+  std::unique_ptr<GetCtx> transientFill;
   auto lock = getFillLock(hk);
   if (hasTombStone(hk) || !ctx.isValid()) {
     // a racing remove or evict while we were filling
@@ -1110,14 +1479,62 @@ void NvmCache<C>::onGetComplete(GetCtx& ctx,
     return;
   }
 
+  if (!promote && !ctx.mustPromote()) {
+    // hand the item to the waiters without inserting it. Its handle stays
+    // nascent, so the item is freed once the last handle is released.
+    stats().numNvmGetTransient.inc();
+    it.markWentToNvm();
+    ctx.setWriteHandle(std::move(it));
+    // take the fill out of the map before the fill lock is released. A
+    // lookup to write the item can not be served by an item that is not
+    // inserted, so it must start a fresh fill that promotes the item
+    // instead of joining this one.
+    auto& fillMap = getFillMap(hk);
+    auto fill = fillMap.find(hk.key());
+    XDCHECK(fill != fillMap.end());
+    XDCHECK_EQ(fill->second.get(), &ctx);
+    transientFill = std::move(fill->second);
+    fillMap.erase(fill);
+    guard.dismiss();
+    return;
+  }
+
   // by the time we filled from navy, another thread inserted in RAM. We
   // disregard.
-  if (CacheAPIWrapperForNvm<C>::insertFromNvm(cache_, it)) {
+  if (CacheAPIWrapperForNvm<C>::insertFromNvm(cache_, it,
+                                              config_.promoteCold)) {
     it.markWentToNvm();
     ctx.setWriteHandle(std::move(it));
   }
 } // namespace cachelib
 
+template <typename C>
+bool NvmCache<C>::recordFlashHit(HashedKey hk, const NvmItem& nvmItem) {
+  if (config_.promotionMinFlashHits <= 1) {
+    return true;
+  }
+
+  size_t itemSize = 0;
+  for (size_t i = 0; i < nvmItem.getNumBlobs(); i++) {
+    itemSize += nvmItem.getBlob(i).origAllocSize;
+  }
+  if (itemSize < config_.promotionMinItemSize) {
+    return true;
+  }
+
+  auto& stripe = promotionStripes_[hk.keyHash() % kPromotionStripes];
+  std::lock_guard<TimedMutex> l(stripe.mutex);
+  stripe.flashHits.increment(hk.keyHash());
+  // halve the counts every time the stripe has seen as many hits as it has
+  // counters, so that keys that stopped being read lose their earlier hits.
+  if (++stripe.numHits >= stripe.flashHits.width()) {
+    stripe.numHits = 0;
+    stripe.flashHits.decayCountsBy(0.5);
+  }
+  return stripe.flashHits.getCount(hk.keyHash()) >=
+         config_.promotionMinFlashHits;
+}
+
 template <typename C>
 typename NvmCache<C>::WriteHandle NvmCache<C>::createItem(
     folly::StringPiece key, const NvmItem& nvmItem) {
@@ -1336,6 +1753,7 @@ typename NvmCache<C>::SampleItem NvmCache<C>::getSampleItem() {
 template <typename C>
 bool NvmCache<C>::shutDown() {
   navyEnabled_ = false;
+  util::stopPeriodicWorker(kWritebackFlusherName, writebackFlusher_);
   try {
     this->flushPendingOps();
     navyCache_->persist();
@@ -1349,6 +1767,7 @@ bool NvmCache<C>::shutDown() {
 
 template <typename C>
 void NvmCache<C>::flushPendingOps() {
+  flushWritebackBatches();
   navyCache_->flush();
 }
 
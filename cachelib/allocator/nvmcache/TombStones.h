@@ -17,9 +17,13 @@
 #pragma once
 #include <folly/container/F14Map.h>
 #include <folly/fibers/TimedMutex.h>
+#include <folly/hash/Hash.h>
 #include <folly/lang/Align.h>
 #include <glog/logging.h>
 
+#include <array>
+#include <atomic>
+#include <string>
 #include <utility>
 
 #include "folly/Range.h"
@@ -32,6 +36,13 @@ using folly::fibers::TimedMutex;
 // Utility that helps us track in flight deletes. We maintain a count per key
 // and check for presence against the count to resolve multiple concurrent
 // deletes for the same key in flight.
+//
+// The counts are kept in a small open addressed table of atomic slots keyed
+// by the hash of the key, which are added to, removed from and checked
+// without a lock. Keys are only compared by their hash, so a collision makes
+// another key look present, which only costs an nvmcache write or hit. Once
+// the slots are taken, deletes are counted by the same hash in a map under a
+// mutex instead. Neither holds a copy of the key.
 class alignas(folly::hardware_destructive_interference_size) TombStones {
  public:
   class Guard;
@@ -40,21 +51,32 @@ class alignas(folly::hardware_destructive_interference_size) TombStones {
   // @param key  key for the record
   // @return a valid Guard representing the tombstone
   Guard add(folly::StringPiece key) {
-    std::lock_guard<TimedMutex> l(mutex_);
-    auto it = keys_.find(key);
-
-    if (it == keys_.end()) {
-      it = keys_.insert(std::make_pair(key.toString(), 0)).first;
+    const uint64_t tag = tagOf(key);
+    if (addToSlots(tag)) {
+      return Guard(tag, false /* overflow */, *this);
     }
 
-    ++it->second;
-    return Guard(it->first, *this);
+    std::lock_guard<TimedMutex> l(mutex_);
+    ++keys_[tag];
+    numOverflow_.fetch_add(1, std::memory_order_acq_rel);
+    return Guard(tag, true /* overflow */, *this);
   }
 
   // checks if there is a key present and returns true if so.
   bool isPresent(folly::StringPiece key) {
+    const uint64_t tag = tagOf(key);
+    for (const auto& slot : slots_) {
+      const auto word = slot.load(std::memory_order_acquire);
+      if (word != 0 && (word & kTagMask) == tag) {
+        return true;
+      }
+    }
+
+    if (numOverflow_.load(std::memory_order_acquire) == 0) {
+      return false;
+    }
     std::lock_guard<TimedMutex> l(mutex_);
-    return keys_.count(key) != 0;
+    return keys_.count(tag) != 0;
   }
 
   // Guard that wraps around the tombstone record. Removes the key from the
@@ -65,7 +87,7 @@ class alignas(folly::hardware_destructive_interference_size) TombStones {
     Guard() {}
     ~Guard() {
       if (tombstones_) {
-        tombstones_->remove(key_);
+        tombstones_->remove(tag_, overflow_);
         tombstones_ = nullptr;
       }
     }
@@ -76,7 +98,9 @@ class alignas(folly::hardware_destructive_interference_size) TombStones {
 
     // allow moving
     Guard(Guard&& other) noexcept
-        : key_{std::move(other.key_)}, tombstones_(other.tombstones_) {
+        : tag_(other.tag_),
+          overflow_(other.overflow_),
+          tombstones_(other.tombstones_) {
       other.tombstones_ = nullptr;
     }
     Guard& operator=(Guard&& other) noexcept {
@@ -87,43 +111,106 @@ class alignas(folly::hardware_destructive_interference_size) TombStones {
       return *this;
     }
 
-    folly::StringPiece key() const noexcept { return key_; }
-
     explicit operator bool() const noexcept { return tombstones_ != nullptr; }
 
    private:
     // only tombstone can create a guard.
     friend TombStones;
-    Guard(folly::StringPiece key, TombStones& t) noexcept
-        : key_(key), tombstones_(&t) {}
+    Guard(uint64_t tag, bool overflow, TombStones& t) noexcept
+        : tag_(tag), overflow_(overflow), tombstones_(&t) {}
 
-    // key for the tombstone
-    folly::StringPiece key_;
+    // hash of the key and whether it is counted in the map
+    uint64_t tag_{0};
+    bool overflow_{false};
 
     // tombstone record
     TombStones* tombstones_{nullptr};
   };
 
  private:
+  // the low bits of a slot hold the count of the key, the others its hash. A
+  // key can be counted in more than one slot.
+  static constexpr uint64_t kCountMask = (1ULL << 16) - 1;
+  static constexpr uint64_t kTagMask = ~kCountMask;
+  static constexpr size_t kSlots = 8;
+
+  static uint64_t tagOf(folly::StringPiece key) {
+    return folly::hasher<folly::StringPiece>{}(key) & kTagMask;
+  }
+
+  // counts an instance of the tag in its slot, or claims an empty one.
+  // @return  false if all slots are taken
+  bool addToSlots(uint64_t tag) {
+    for (auto& slot : slots_) {
+      auto word = slot.load(std::memory_order_acquire);
+      while (word != 0 && (word & kTagMask) == tag &&
+             (word & kCountMask) < kCountMask) {
+        if (slot.compare_exchange_weak(word, word + 1,
+                                       std::memory_order_acq_rel)) {
+          return true;
+        }
+      }
+    }
+
+    for (auto& slot : slots_) {
+      uint64_t expected = 0;
+      if (slot.load(std::memory_order_relaxed) == 0 &&
+          slot.compare_exchange_strong(expected, tag | 1,
+                                       std::memory_order_acq_rel)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
   // removes an instance of key. if the count drops to 0, we remove the key
-  void remove(folly::StringPiece key) {
+  void remove(uint64_t tag, bool overflow) {
+    if (overflow) {
+      removeFromMap(tag);
+      return;
+    }
+
+    for (auto& slot : slots_) {
+      auto word = slot.load(std::memory_order_acquire);
+      while (word != 0 && (word & kTagMask) == tag) {
+        const uint64_t newWord = (word & kCountMask) == 1 ? 0 : word - 1;
+        if (slot.compare_exchange_weak(word, newWord,
+                                       std::memory_order_acq_rel)) {
+          return;
+        }
+      }
+    }
+
+    // this is not supposed to happen if guards are destroyed appropriately
+    throw std::runtime_error(fmt::format(
+        "Invalid state. Key hash: {}. State: does not exist", tag));
+  }
+
+  void removeFromMap(uint64_t tag) {
     std::lock_guard<TimedMutex> l(mutex_);
-    auto it = keys_.find(key);
+    auto it = keys_.find(tag);
     if (it == keys_.end() || it->second == 0) {
       // this is not supposed to happen if guards are destroyed appropriately
       throw std::runtime_error(fmt::format(
-          "Invalid state. Key: {}. State: {}", key,
+          "Invalid state. Key hash: {}. State: {}", tag,
           it == keys_.end() ? "does not exist" : "exists, but count is 0"));
     }
 
     if (--(it->second) == 0) {
       keys_.erase(it);
     }
+    numOverflow_.fetch_sub(1, std::memory_order_acq_rel);
   }
 
+  // the hash of the key and the count of every slot
+  std::array<std::atomic<uint64_t>, kSlots> slots_{};
+
+  // number of instances counted in the map below
+  std::atomic<uint64_t> numOverflow_{0};
+
   // mutex protecting the map below
   TimedMutex mutex_;
-  folly::F14NodeMap<std::string, uint64_t> keys_;
+  folly::F14FastMap<uint64_t, uint64_t> keys_;
 };
 
 } // namespace cachelib
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <folly/Range.h>
+#include <folly/logging/xlog.h>
+
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "cachelib/allocator/nvmcache/InFlightPuts.h"
+#include "cachelib/common/PercentileStats.h"
+
+namespace facebook {
+namespace cachelib {
+
+// Puts of evicted items into nvmcache that are written to navy together. The
+// keys and the serialized items are laid out back to back in one buffer that
+// is allocated upfront, so an entry costs no allocation of its own. The
+// buffer lives as long as the batch, which keeps the keys the put tokens are
+// moved to and the values handed to navy valid until the inserts complete.
+//
+// Not thread safe. The caller serializes adding entries and only shares the
+// batch once it is complete.
+class WritebackBatch {
+ public:
+  struct Entry {
+    folly::StringPiece key;
+    uint64_t keyHash{0};
+    folly::ByteRange value;
+    InFlightPuts::PutToken token;
+    util::LatencyTracker tracker;
+  };
+
+  // @param capacity  bytes of keys and values the batch holds
+  explicit WritebackBatch(size_t capacity)
+      : buffer_(new uint8_t[capacity]),
+        capacity_(capacity),
+        createdAt_(std::chrono::steady_clock::now()) {}
+
+  WritebackBatch(const WritebackBatch&) = delete;
+  WritebackBatch& operator=(const WritebackBatch&) = delete;
+
+  // copies the key of a new entry into the batch and reserves valueSize bytes
+  // for its value after it, padded to start at a multiple of valueAlignment.
+  // The entry is added by commit() or dropped by rollback().
+  //
+  // @param valueAlignment  power of two, at most the alignment of new[]
+  //
+  // @return  the memory reserved for the value, or nullptr if the batch does
+  //          not have enough space left
+  uint8_t* reserve(folly::StringPiece key,
+                   size_t valueSize,
+                   size_t valueAlignment) {
+    XDCHECK(reservedValue_.empty());
+    XDCHECK(valueAlignment > 0 &&
+            (valueAlignment & (valueAlignment - 1)) == 0);
+    XDCHECK_LE(valueAlignment, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+    const size_t valueOffset =
+        (used_ + key.size() + valueAlignment - 1) & ~(valueAlignment - 1);
+    if (valueOffset > capacity_ || valueSize > capacity_ - valueOffset) {
+      return nullptr;
+    }
+    uint8_t* keyBegin = buffer_.get() + used_;
+    std::memcpy(keyBegin, key.data(), key.size());
+    reservedKey_ = {reinterpret_cast<const char*>(keyBegin), key.size()};
+    reservedValue_ = {buffer_.get() + valueOffset, valueSize};
+    return buffer_.get() + valueOffset;
+  }
+
+  // bytes an entry takes at most, including the padding of its value
+  static size_t maxEntrySize(size_t keySize,
+                             size_t valueSize,
+                             size_t valueAlignment) {
+    return keySize + valueAlignment - 1 + valueSize;
+  }
+
+  // the copy of the key of the reserved entry
+  folly::StringPiece reservedKey() const { return reservedKey_; }
+
+  // adds the reserved entry to the batch
+  void commit(uint64_t keyHash,
+              InFlightPuts::PutToken token,
+              util::LatencyTracker tracker) {
+    XDCHECK(!reservedValue_.empty());
+    entries_.push_back(Entry{reservedKey_, keyHash, reservedValue_,
+                             std::move(token), std::move(tracker)});
+    used_ = static_cast<size_t>(reservedValue_.end() - buffer_.get());
+    rollback();
+  }
+
+  // drops the reserved entry, if any, freeing its space for the next one
+  void rollback() noexcept {
+    reservedKey_ = {};
+    reservedValue_ = {};
+  }
+
+  bool empty() const noexcept { return entries_.empty(); }
+  size_t size() const noexcept { return entries_.size(); }
+
+  Entry& at(size_t index) { return entries_[index]; }
+
+  // true if no more entries fit
+  bool isFull() const noexcept { return used_ >= capacity_; }
+
+  // time since the batch was created
+  std::chrono::steady_clock::duration age() const {
+    return std::chrono::steady_clock::now() - createdAt_;
+  }
+
+ private:
+  const std::unique_ptr<uint8_t[]> buffer_;
+  const size_t capacity_{0};
+  const std::chrono::steady_clock::time_point createdAt_;
+
+  // bytes taken by the committed entries and their padding
+  size_t used_{0};
+
+  folly::StringPiece reservedKey_;
+  folly::ByteRange reservedValue_;
+
+  // declared after the buffer so that the tokens are released while the keys
+  // they refer to are still valid
+  std::vector<Entry> entries_;
+};
+
+} // namespace cachelib
+} // namespace facebook
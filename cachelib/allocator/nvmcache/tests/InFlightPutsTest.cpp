@@ -14,9 +14,13 @@
  * limitations under the License.
  */
 
+#include <folly/Format.h>
 #include <folly/Random.h>
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <chrono>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -154,6 +158,261 @@ TEST(InFlightPutsTest, InvalidationAndCreate) {
   ASSERT_TRUE(token.executeIfValid(fn));
   ASSERT_TRUE(executed);
 }
+
+TEST(InFlightPutsTest, ManyKeys) {
+  InFlightPuts p;
+  std::vector<std::string> keys;
+  for (int i = 0; i < 100; i++) {
+    keys.push_back(folly::sformat("key{}", i));
+  }
+
+  // puts beyond the slots fall back to the overflow map
+  std::vector<InFlightPuts::PutToken> tokens;
+  for (const auto& key : keys) {
+    auto token = p.tryAcquireToken(key);
+    ASSERT_TRUE(token.isValid()) << key;
+    tokens.push_back(std::move(token));
+  }
+  // a second put for a key fails wherever the first one is tracked
+  for (const auto& key : keys) {
+    ASSERT_FALSE(p.tryAcquireToken(key).isValid()) << key;
+  }
+
+  // releasing a token frees its entry
+  for (size_t i : {size_t{0}, keys.size() - 1}) {
+    bool executed = false;
+    ASSERT_TRUE(tokens[i].executeIfValid([&]() { executed = true; }));
+    ASSERT_TRUE(executed);
+    tokens[i] = p.tryAcquireToken(keys[i]);
+    ASSERT_TRUE(tokens[i].isValid());
+  }
+
+  // invalidating one key leaves the others valid
+  for (size_t i : {size_t{1}, keys.size() - 2}) {
+    p.invalidateToken(keys[i]);
+    ASSERT_FALSE(tokens[i].executeIfValid([]() {}));
+    ASSERT_FALSE(p.tryAcquireToken(keys[i]).isValid());
+    ASSERT_TRUE(tokens[i + 1].executeIfValid([]() {}));
+  }
+
+  // once every token is gone, all keys can be put again
+  tokens.clear();
+  for (const auto& key : keys) {
+    ASSERT_TRUE(p.tryAcquireToken(key).isValid()) << key;
+  }
+}
+
+TEST(InFlightPutsTest, Reserve) {
+  InFlightPuts p;
+  const int nKeys = 10000;
+  p.reserve(nKeys);
+  std::vector<std::string> keys;
+  for (int i = 0; i < nKeys; i++) {
+    keys.push_back(folly::sformat("key{}", i));
+  }
+
+  std::vector<InFlightPuts::PutToken> tokens;
+  for (const auto& key : keys) {
+    auto token = p.tryAcquireToken(key);
+    ASSERT_TRUE(token.isValid()) << key;
+    tokens.push_back(std::move(token));
+  }
+  for (const auto& key : keys) {
+    ASSERT_FALSE(p.tryAcquireToken(key).isValid()) << key;
+  }
+
+  // every other key is invalidated, the others execute
+  for (int i = 0; i < nKeys; i += 2) {
+    p.invalidateToken(keys[i]);
+  }
+  for (int i = 0; i < nKeys; i++) {
+    bool executed = false;
+    ASSERT_EQ(i % 2 == 1,
+              tokens[i].executeIfValid([&]() { executed = true; }));
+    ASSERT_EQ(i % 2 == 1, executed);
+  }
+
+  tokens.clear();
+  for (const auto& key : keys) {
+    ASSERT_TRUE(p.tryAcquireToken(key).isValid()) << key;
+  }
+}
+
+TEST(InFlightPutsTest, OverflowInvalidationWaitsForExecution) {
+  InFlightPuts p;
+  std::vector<InFlightPuts::PutToken> tokens;
+  for (int i = 0; i < 100; i++) {
+    tokens.push_back(p.tryAcquireToken(folly::sformat("key{}", i)));
+    ASSERT_TRUE(tokens.back().isValid());
+  }
+  // the slots are taken long before the last token, so the overflow map
+  // holds it
+  const auto key = folly::sformat("key{}", 99);
+
+  std::atomic<bool> started{false};
+  std::atomic<bool> finished{false};
+  std::thread executor([&]() {
+    ASSERT_TRUE(tokens.back().executeIfValid([&]() {
+      started = true;
+      /* sleep override */
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      finished = true;
+    }));
+  });
+  while (!started) {
+    std::this_thread::yield();
+  }
+  // other keys in the overflow map are not blocked by the function
+  ASSERT_TRUE(tokens[98].executeIfValid([]() {}));
+  p.invalidateToken(key);
+  ASSERT_TRUE(finished);
+  executor.join();
+
+  ASSERT_TRUE(p.tryAcquireToken(key).isValid());
+}
+
+TEST(InFlightPutsTest, InvalidationWaitsForExecution) {
+  InFlightPuts p;
+  folly::StringPiece key = "foobar";
+  auto token = p.tryAcquireToken(key);
+  ASSERT_TRUE(token.isValid());
+
+  std::atomic<bool> started{false};
+  std::atomic<bool> finished{false};
+  std::thread executor([&]() {
+    ASSERT_TRUE(token.executeIfValid([&]() {
+      started = true;
+      /* sleep override */
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      finished = true;
+    }));
+  });
+  while (!started) {
+    std::this_thread::yield();
+  }
+  // an invalidation does not return while the function is executed
+  p.invalidateToken(key);
+  ASSERT_TRUE(finished);
+  executor.join();
+
+  ASSERT_TRUE(p.tryAcquireToken(key).isValid());
+}
+
+TEST(InFlightPutsTest, ExecutionDoesNotBlockOtherKeys) {
+  InFlightPuts p;
+  folly::StringPiece key = "foobar";
+  auto token = p.tryAcquireToken(key);
+  ASSERT_TRUE(token.isValid());
+
+  std::atomic<bool> started{false};
+  std::atomic<bool> release{false};
+  std::thread executor([&]() {
+    ASSERT_TRUE(token.executeIfValid([&]() {
+      started = true;
+      while (!release) {
+        std::this_thread::yield();
+      }
+    }));
+  });
+  while (!started) {
+    std::this_thread::yield();
+  }
+
+  // puts and invalidations of other keys go ahead while the function of the
+  // busy token is executed
+  folly::StringPiece otherKey = "barbaz";
+  auto otherToken = p.tryAcquireToken(otherKey);
+  ASSERT_TRUE(otherToken.isValid());
+  bool executed = false;
+  ASSERT_TRUE(otherToken.executeIfValid([&]() { executed = true; }));
+  ASSERT_TRUE(executed);
+  auto invalidated = p.tryAcquireToken(otherKey);
+  ASSERT_TRUE(invalidated.isValid());
+  p.invalidateToken(otherKey);
+  ASSERT_FALSE(invalidated.executeIfValid([]() {}));
+
+  release = true;
+  executor.join();
+  ASSERT_TRUE(p.tryAcquireToken(key).isValid());
+}
+
+TEST(InFlightPutsTest, BatchedToken) {
+  InFlightPuts p;
+  folly::StringPiece key = "foobar";
+  std::string batchedKey = key.str();
+  auto token = p.tryAcquireToken(key);
+  ASSERT_TRUE(token.isValid());
+  // an unbatched token is invalidated by lookups
+  ASSERT_FALSE(p.invalidateUnbatchedToken(key));
+  ASSERT_FALSE(token.rekeyIfValid(batchedKey, []() {}));
+
+  token = InFlightPuts::PutToken{};
+  token = p.tryAcquireToken(key);
+  ASSERT_TRUE(token.isValid());
+  ASSERT_TRUE(token.rekeyIfValid(batchedKey, []() {}));
+  ASSERT_FALSE(p.tryAcquireToken(key).isValid());
+
+  // a batched token survives lookups, but not removes
+  ASSERT_TRUE(p.invalidateUnbatchedToken(key));
+  ASSERT_TRUE(token.executeIfValidUntilDone([]() { return false; }));
+  ASSERT_TRUE(p.invalidateUnbatchedToken(key));
+  p.invalidateToken(key);
+  ASSERT_FALSE(p.invalidateUnbatchedToken(key));
+  ASSERT_FALSE(token.executeIfValidUntilDone([]() { return true; }));
+  // nothing to wait for once it is invalidated
+  p.waitForBatchedToken(key);
+}
+
+TEST(InFlightPutsTest, LookupWaitsForBatchedToken) {
+  InFlightPuts p;
+  folly::StringPiece key = "foobar";
+  std::string batchedKey = key.str();
+  auto token = p.tryAcquireToken(key);
+  ASSERT_TRUE(token.isValid());
+  ASSERT_TRUE(token.rekeyIfValid(batchedKey, []() {}));
+
+  std::atomic<bool> inserted{false};
+  std::thread inserter([&]() {
+    /* sleep override */
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_TRUE(token.executeIfValidUntilDone([&]() {
+      inserted = true;
+      return true;
+    }));
+  });
+  ASSERT_TRUE(p.invalidateUnbatchedToken(key));
+  p.waitForBatchedToken(key);
+  ASSERT_TRUE(inserted);
+  inserter.join();
+
+  ASSERT_FALSE(p.invalidateUnbatchedToken(key));
+  ASSERT_TRUE(p.tryAcquireToken(key).isValid());
+}
+
+TEST(InFlightPutsTest, ConcurrentAcquire) {
+  InFlightPuts p;
+  folly::StringPiece key = "foobar";
+  std::atomic<int> numAcquired{0};
+  std::atomic<int> numHeld{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; t++) {
+    threads.emplace_back([&]() {
+      for (int i = 0; i < 10000; i++) {
+        auto token = p.tryAcquireToken(key);
+        if (token.isValid()) {
+          // at most one put is in flight for the key at a time
+          ASSERT_EQ(0, numHeld.fetch_add(1));
+          ++numAcquired;
+          numHeld.fetch_sub(1);
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  ASSERT_GT(numAcquired, 0);
+}
 } // namespace tests
 } // namespace cachelib
 } // namespace facebook
@@ -66,6 +66,9 @@ const unsigned int bigHashSizePct = 50;
 const uint32_t bigHashBucketSize = 1024;
 const uint64_t bigHashBucketBfSize = 4;
 const uint64_t bigHashSmallItemMaxSize = 512;
+const uint32_t bigHashAdaptiveBucketSize = 64;
+const uint32_t bigHashAdaptiveUpdateIntervalSecs = 30;
+const unsigned int bigHashAdaptiveHysteresisPct = 10;
 
 const uint32_t maxConcurrentInserts = 50000;
 const uint64_t maxParcelMemoryMB = 512;
@@ -105,7 +108,10 @@ void setBigHashTestSettings(NavyConfig& config) {
   config.bigHash()
       .setSizePctAndMaxItemSize(bigHashSizePct, bigHashSmallItemMaxSize)
       .setBucketSize(bigHashBucketSize)
-      .setBucketBfSize(bigHashBucketBfSize);
+      .setBucketBfSize(bigHashBucketBfSize)
+      .setAdaptiveSmallItemMaxSize(bigHashAdaptiveBucketSize,
+                                   bigHashAdaptiveUpdateIntervalSecs,
+                                   bigHashAdaptiveHysteresisPct);
 }
 
 void setJobSchedulerTestSettings(NavyConfig& config) {
@@ -147,6 +153,7 @@ TEST(NavyConfigTest, DefaultVal) {
   EXPECT_EQ(bigHashConfig.getBucketSize(), 4096);
   EXPECT_EQ(bigHashConfig.getBucketBfSize(), 8);
   EXPECT_EQ(bigHashConfig.getSmallItemMaxSize(), 0);
+  EXPECT_FALSE(bigHashConfig.isAdaptiveSmallItemMaxSizeEnabled());
 
   EXPECT_EQ(config.getMaxConcurrentInserts(), 1'000'000);
   EXPECT_EQ(config.getMaxParcelMemoryMB(), 256);
@@ -206,6 +213,9 @@ TEST(NavyConfigTest, Serialization) {
   expectedConfigMap["navyConfig::bigHashBucketSize"] = "1024";
   expectedConfigMap["navyConfig::bigHashBucketBfSize"] = "4";
   expectedConfigMap["navyConfig::bigHashSmallItemMaxSize"] = "512";
+  expectedConfigMap["navyConfig::bigHashAdaptiveBucketSize"] = "64";
+  expectedConfigMap["navyConfig::bigHashAdaptiveUpdateIntervalSecs"] = "30";
+  expectedConfigMap["navyConfig::bigHashAdaptiveHysteresisPct"] = "10";
 
   expectedConfigMap["navyConfig::maxConcurrentInserts"] = "50000";
   expectedConfigMap["navyConfig::maxParcelMemoryMB"] = "512";
@@ -393,6 +403,22 @@ TEST(NavyConfigTest, BigHash) {
   EXPECT_EQ(config.bigHash().getBucketSize(), bigHashBucketSize);
   EXPECT_EQ(config.bigHash().getBucketBfSize(), bigHashBucketBfSize);
   EXPECT_EQ(config.bigHash().getSmallItemMaxSize(), bigHashSmallItemMaxSize);
+  EXPECT_FALSE(config.bigHash().isAdaptiveSmallItemMaxSizeEnabled());
+
+  EXPECT_THROW(config.bigHash().setAdaptiveSmallItemMaxSize(64, 0),
+               std::invalid_argument);
+  EXPECT_THROW(config.bigHash().setAdaptiveSmallItemMaxSize(64, 30, 101),
+               std::invalid_argument);
+  config.bigHash().setAdaptiveSmallItemMaxSize(
+      bigHashAdaptiveBucketSize, bigHashAdaptiveUpdateIntervalSecs,
+      bigHashAdaptiveHysteresisPct);
+  EXPECT_TRUE(config.bigHash().isAdaptiveSmallItemMaxSizeEnabled());
+  EXPECT_EQ(config.bigHash().getAdaptiveBucketSize(),
+            bigHashAdaptiveBucketSize);
+  EXPECT_EQ(config.bigHash().getAdaptiveUpdateIntervalSecs(),
+            bigHashAdaptiveUpdateIntervalSecs);
+  EXPECT_EQ(config.bigHash().getAdaptiveHysteresisPct(),
+            bigHashAdaptiveHysteresisPct);
 }
 
 TEST(NavyConfigTest, JobScheduler) {
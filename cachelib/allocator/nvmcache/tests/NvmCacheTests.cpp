@@ -18,6 +18,7 @@
 #include <gtest/gtest.h>
 
 #include <climits>
+#include <cstring>
 #include <set>
 #include <thread>
 
@@ -1526,6 +1527,235 @@ TEST_F(NvmCacheTest, TruncatedAllocSize) {
   }
 }
 
+TEST_F(NvmCacheTest, WritebackBatch) {
+  auto& config = this->getConfig();
+  config.nvmConfig->writebackBatchBytes = 64 * 1024;
+  config.nvmConfig->writebackBatchMaxDelay = std::chrono::seconds{60};
+  auto& cache = this->makeCache();
+  auto pid = this->poolId();
+
+  const int nKeys = 100;
+  for (int i = 0; i < nKeys; i++) {
+    auto key = folly::sformat("key{}", i);
+    auto it = cache.allocate(pid, key, 1000);
+    ASSERT_NE(nullptr, it);
+    std::memset(it->getMemory(), i, it->getSize());
+    this->insertOrReplace(it);
+  }
+  // the puts wait in batches until they are full or flushed
+  for (int i = 0; i < nKeys; i++) {
+    auto key = folly::sformat("key{}", i);
+    ASSERT_TRUE(this->pushToNvmCacheFromRamForTesting(key, false));
+    this->removeFromRamForTesting(key);
+  }
+  cache.flushNvmCache();
+
+  for (int i = 0; i < nKeys; i++) {
+    auto key = folly::sformat("key{}", i);
+    auto hdl = this->fetch(key, false /* ramOnly */);
+    hdl.wait();
+    ASSERT_NE(nullptr, hdl) << key;
+    ASSERT_TRUE(hdl.wentToNvm());
+    for (uint32_t j = 0; j < hdl->getSize(); j++) {
+      ASSERT_EQ(static_cast<char>(i),
+                reinterpret_cast<const char*>(hdl->getMemory())[j]);
+    }
+  }
+  EXPECT_EQ(0, cache.getGlobalCacheStats().numNvmAbortedPutOnInflightGet);
+}
+
+TEST_F(NvmCacheTest, WritebackBatchFlushedAfterMaxDelay) {
+  auto& config = this->getConfig();
+  config.nvmConfig->writebackBatchBytes = 64 * 1024;
+  config.nvmConfig->writebackBatchMaxDelay = std::chrono::milliseconds{10};
+  auto& cache = this->makeCache();
+  auto pid = this->poolId();
+
+  {
+    auto it = cache.allocate(pid, "test", 1000);
+    ASSERT_NE(nullptr, it);
+    this->insertOrReplace(it);
+    ASSERT_TRUE(this->pushToNvmCacheFromRamForTesting("test", false));
+  }
+  this->removeFromRamForTesting("test");
+
+  // no more puts come to the stripe, and the partial batch is written out in
+  // the background once it is older than the max delay. A get then finds the
+  // item instead of cancelling its put.
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds{10};
+  while (true) {
+    auto ctrs = cache.getNvmCacheStatsMap().toMap();
+    if (ctrs["navy_accepted"] == 1 && ctrs["navy_concurrent_inserts"] == 0) {
+      break;
+    }
+    ASSERT_LT(std::chrono::steady_clock::now(), deadline);
+    /* sleep override */
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+  }
+  ASSERT_TRUE(this->checkKeyExists("test", false /* ramOnly */));
+  EXPECT_EQ(0, cache.getGlobalCacheStats().numNvmAbortedPutOnInflightGet);
+}
+
+TEST_F(NvmCacheTest, WritebackBatchGetWaitsForInsert) {
+  auto& config = this->getConfig();
+  config.nvmConfig->writebackBatchBytes = 64 * 1024;
+  config.nvmConfig->writebackBatchMaxDelay = std::chrono::seconds{60};
+  auto& cache = this->makeCache();
+  auto pid = this->poolId();
+
+  {
+    auto it = cache.allocate(pid, "test", 1000);
+    ASSERT_NE(nullptr, it);
+    std::memset(it->getMemory(), 'a', it->getSize());
+    this->insertOrReplace(it);
+    ASSERT_TRUE(this->pushToNvmCacheFromRamForTesting("test", false));
+  }
+  this->removeFromRamForTesting("test");
+
+  // the put waits in its batch. A get writes the batch out and finds the
+  // item instead of cancelling the put.
+  {
+    auto hdl = this->fetch("test", false /* ramOnly */);
+    hdl.wait();
+    ASSERT_NE(nullptr, hdl);
+    ASSERT_TRUE(hdl.wentToNvm());
+    ASSERT_EQ('a', reinterpret_cast<const char*>(hdl->getMemory())[0]);
+  }
+  EXPECT_EQ(0, cache.getGlobalCacheStats().numNvmAbortedPutOnInflightGet);
+}
+
+TEST_F(NvmCacheTest, WritebackBatchCancelledByRemove) {
+  auto& config = this->getConfig();
+  config.nvmConfig->writebackBatchBytes = 64 * 1024;
+  config.nvmConfig->writebackBatchMaxDelay = std::chrono::seconds{60};
+  auto& cache = this->makeCache();
+  auto pid = this->poolId();
+
+  {
+    auto it = cache.allocate(pid, "test", 1000);
+    ASSERT_NE(nullptr, it);
+    this->insertOrReplace(it);
+    ASSERT_TRUE(this->pushToNvmCacheFromRamForTesting("test", false));
+  }
+  this->removeFromRamForTesting("test");
+
+  // a remove while the put waits in its batch cancels it
+  this->removeFromNvmForTesting("test");
+  cache.flushNvmCache();
+  ASSERT_FALSE(this->checkKeyExists("test", false /* ramOnly */));
+  EXPECT_EQ(1, cache.getGlobalCacheStats().numNvmAbortedPutOnInflightGet);
+}
+
+TEST_F(NvmCacheTest, PromotionAfterFlashHits) {
+  auto& config = this->getConfig();
+  config.nvmConfig->promotionMinFlashHits = 2;
+  config.nvmConfig->promotionMinItemSize = 100;
+  auto& cache = this->makeCache();
+  auto pid = this->poolId();
+
+  for (const auto& [key, size] :
+       {std::make_pair("large", 1000), std::make_pair("small", 10)}) {
+    auto it = cache.allocate(pid, key, size);
+    ASSERT_NE(nullptr, it);
+    std::memset(it->getMemory(), 'a', it->getSize());
+    this->insertOrReplace(it);
+    ASSERT_TRUE(this->pushToNvmCacheFromRamForTesting(key, false));
+    this->removeFromRamForTesting(key);
+  }
+  cache.flushNvmCache();
+
+  // the first hit returns the item without inserting it into DRAM
+  {
+    auto hdl = this->fetch("large", false /* ramOnly */);
+    hdl.wait();
+    ASSERT_NE(nullptr, hdl);
+    ASSERT_TRUE(hdl.wentToNvm());
+    ASSERT_FALSE(hdl->isAccessible());
+    ASSERT_EQ('a', reinterpret_cast<const char*>(hdl->getMemory())[0]);
+  }
+  ASSERT_FALSE(this->checkKeyExists("large", true /* ramOnly */));
+  EXPECT_EQ(1, cache.getGlobalCacheStats().numNvmGetTransient);
+
+  // the second hit promotes it
+  {
+    auto hdl = this->fetch("large", false /* ramOnly */);
+    hdl.wait();
+    ASSERT_NE(nullptr, hdl);
+    ASSERT_TRUE(hdl.wentToNvm());
+  }
+  ASSERT_TRUE(this->checkKeyExists("large", true /* ramOnly */));
+  EXPECT_EQ(1, cache.getGlobalCacheStats().numNvmGetTransient);
+
+  // small items are promoted on the first hit
+  {
+    auto hdl = this->fetch("small", false /* ramOnly */);
+    hdl.wait();
+    ASSERT_NE(nullptr, hdl);
+  }
+  ASSERT_TRUE(this->checkKeyExists("small", true /* ramOnly */));
+  EXPECT_EQ(1, cache.getGlobalCacheStats().numNvmGetTransient);
+}
+
+TEST_F(NvmCacheTest, PromotionOnWrite) {
+  auto& config = this->getConfig();
+  config.nvmConfig->promotionMinFlashHits = 2;
+  auto& cache = this->makeCache();
+  auto pid = this->poolId();
+
+  {
+    auto it = cache.allocate(pid, "test", 1000);
+    ASSERT_NE(nullptr, it);
+    this->insertOrReplace(it);
+    ASSERT_TRUE(this->pushToNvmCacheFromRamForTesting("test", false));
+  }
+  this->removeFromRamForTesting("test");
+  cache.flushNvmCache();
+
+  // a lookup to write always inserts the item, so that the write is not lost
+  {
+    auto hdl = this->fetchToWrite("test", false /* ramOnly */);
+    ASSERT_NE(nullptr, hdl);
+    ASSERT_TRUE(hdl->isAccessible());
+  }
+  ASSERT_TRUE(this->checkKeyExists("test", true /* ramOnly */));
+  EXPECT_EQ(0, cache.getGlobalCacheStats().numNvmGetTransient);
+}
+
+TEST_F(NvmCacheTest, PromotionOnWriteAfterTransientHit) {
+  auto& config = this->getConfig();
+  config.nvmConfig->promotionMinFlashHits = 3;
+  auto& cache = this->makeCache();
+  auto pid = this->poolId();
+
+  {
+    auto it = cache.allocate(pid, "test", 1000);
+    ASSERT_NE(nullptr, it);
+    this->insertOrReplace(it);
+    ASSERT_TRUE(this->pushToNvmCacheFromRamForTesting("test", false));
+  }
+  this->removeFromRamForTesting("test");
+  cache.flushNvmCache();
+
+  // a transient item that is still held does not turn a lookup to write
+  // into a miss. It fills the item again and inserts it.
+  auto transient = this->fetch("test", false /* ramOnly */);
+  transient.wait();
+  ASSERT_NE(nullptr, transient);
+  ASSERT_FALSE(transient->isAccessible());
+  EXPECT_EQ(1, cache.getGlobalCacheStats().numNvmGetTransient);
+
+  const auto misses = cache.getGlobalCacheStats().numNvmGetMiss;
+  {
+    auto hdl = this->fetchToWrite("test", false /* ramOnly */);
+    ASSERT_NE(nullptr, hdl);
+    ASSERT_TRUE(hdl->isAccessible());
+  }
+  ASSERT_TRUE(this->checkKeyExists("test", true /* ramOnly */));
+  EXPECT_EQ(misses, cache.getGlobalCacheStats().numNvmGetMiss);
+  EXPECT_EQ(1, cache.getGlobalCacheStats().numNvmGetTransient);
+}
+
 TEST_F(NvmCacheTest, NavyStats) {
   // Ensure we export all the stats we expect
   // Everytime we add a new stat, make sure to update this test accordingly
@@ -120,6 +120,37 @@ TEST(TombStoneTest, Move) {
   ASSERT_FALSE(t.isPresent(key));
 }
 
+TEST(TombStoneTest, ManyKeys) {
+  // more keys than the lock free slots hold are counted in the map
+  TombStones t;
+  const int nKeys = 100;
+  std::vector<std::unique_ptr<TombStones::Guard>> guards;
+  for (int i = 0; i < nKeys; i++) {
+    guards.push_back(
+        std::make_unique<TombStones::Guard>(t.add(std::to_string(i))));
+    guards.push_back(
+        std::make_unique<TombStones::Guard>(t.add(std::to_string(i))));
+  }
+  for (int i = 0; i < nKeys; i++) {
+    ASSERT_TRUE(t.isPresent(std::to_string(i)));
+    ASSERT_TRUE(*guards[2 * i]);
+  }
+  ASSERT_FALSE(t.isPresent("absent"));
+
+  for (int i = 0; i < nKeys; i++) {
+    guards[2 * i].reset();
+    ASSERT_TRUE(t.isPresent(std::to_string(i)));
+  }
+  for (int i = 0; i < nKeys; i++) {
+    guards[2 * i + 1].reset();
+    ASSERT_FALSE(t.isPresent(std::to_string(i)));
+  }
+
+  // the slots are free again
+  auto guard = t.add("key");
+  ASSERT_TRUE(t.isPresent("key"));
+}
+
 } // namespace tests
 } // namespace cachelib
 } // namespace facebook
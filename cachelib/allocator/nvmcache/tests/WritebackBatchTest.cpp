@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+
+#include "cachelib/allocator/nvmcache/WritebackBatch.h"
+
+namespace facebook {
+namespace cachelib {
+namespace tests {
+
+TEST(WritebackBatchTest, ValuesAreAligned) {
+  constexpr size_t kAlign = 8;
+  WritebackBatch batch{1024};
+  for (const std::string key : {"a", "abc", "abcdefghi", ""}) {
+    auto* value = batch.reserve(key, 13, kAlign);
+    ASSERT_NE(nullptr, value);
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(value) % kAlign);
+    EXPECT_EQ(key, batch.reservedKey());
+    batch.commit(0, InFlightPuts::PutToken{}, util::LatencyTracker{});
+  }
+  EXPECT_EQ(4, batch.size());
+  for (size_t i = 0; i < batch.size(); i++) {
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(batch.at(i).value.data()) % kAlign);
+    EXPECT_EQ(13, batch.at(i).value.size());
+  }
+}
+
+TEST(WritebackBatchTest, PaddingCountsAgainstCapacity) {
+  constexpr size_t kAlign = 8;
+  // a key of 3 bytes pads the value to offset 8, so 8 + 16 bytes are needed
+  WritebackBatch small{3 + 16};
+  EXPECT_EQ(nullptr, small.reserve("abc", 16, kAlign));
+
+  WritebackBatch batch{WritebackBatch::maxEntrySize(3, 16, kAlign)};
+  ASSERT_NE(nullptr, batch.reserve("abc", 16, kAlign));
+  batch.commit(0, InFlightPuts::PutToken{}, util::LatencyTracker{});
+  // 2 bytes are left, but the value of the next key would start past them
+  EXPECT_EQ(nullptr, batch.reserve("x", 1, kAlign));
+}
+
+TEST(WritebackBatchTest, Rollback) {
+  WritebackBatch batch{64};
+  ASSERT_NE(nullptr, batch.reserve("key", 40, 8));
+  batch.rollback();
+  // the space of the dropped entry is reused
+  ASSERT_NE(nullptr, batch.reserve("key", 40, 8));
+  batch.commit(0, InFlightPuts::PutToken{}, util::LatencyTracker{});
+  EXPECT_EQ(1, batch.size());
+  EXPECT_EQ(nullptr, batch.reserve("key", 40, 8));
+}
+} // namespace tests
+} // namespace cachelib
+} // namespace facebook
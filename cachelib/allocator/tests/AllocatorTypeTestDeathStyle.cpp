@@ -25,6 +25,14 @@ TYPED_TEST_CASE(BaseAllocatorTestDeathStyle, AllocatorTypes);
 TYPED_TEST(BaseAllocatorTestDeathStyle, ReadOnlyCacheView) {
   this->testReadOnlyCacheView();
 }
+
+TYPED_TEST(BaseAllocatorTestDeathStyle, ReadOnlyCacheViewLookup) {
+  this->testReadOnlyCacheViewLookup();
+}
+
+TYPED_TEST(BaseAllocatorTestDeathStyle, ReadOnlyCacheViewLookupMultiProcess) {
+  this->testReadOnlyCacheViewLookupMultiProcess();
+}
 } // namespace tests
 } // namespace cachelib
 } // namespace facebook
@@ -17,6 +17,8 @@
 #pragma once
 
 #include <folly/Random.h>
+#include <folly/Singleton.h>
+#include <sys/wait.h>
 
 #include <algorithm>
 #include <chrono>
@@ -77,6 +79,136 @@ class BaseAllocatorTestDeathStyle : public AllocatorTest<AllocatorT> {
                              allocSize),
                  ".*");
   }
+
+  // look up items by key through the read only cache view and see the
+  // changes the owner makes to them.
+  void testReadOnlyCacheViewLookup() {
+    typename AllocatorT::Config config;
+    config.setCacheSize(20 * Slab::kSize);
+    config.enableCachePersistence(this->cacheDir_);
+    config.enableSharedCacheViewLookups();
+    config.setAccessConfig({10 /* bucket power */, 4 /* lock power */});
+
+    AllocatorT alloc(AllocatorT::SharedMemNew, config);
+    const auto poolId =
+        alloc.addPool("foobar", alloc.getCacheMemoryStats().ramCacheSize);
+    auto insert = [&](const std::string& key, char c, uint32_t size) {
+      auto hdl = util::allocateAccessible(alloc, poolId, key, size);
+      ASSERT_NE(hdl, nullptr);
+      std::memset(hdl->getMemory(), c, size);
+      alloc.insertOrReplace(hdl);
+    };
+    // more keys than buckets, so the lookups walk hash chains
+    const int numKeys = 4000;
+    for (int i = 0; i < numKeys; i++) {
+      insert(folly::sformat("key_{}", i), static_cast<char>('a' + i % 26),
+             100 + i % 100);
+    }
+
+    auto roCache = ReadOnlySharedCacheView(config.cacheDir, config.usePosixShm);
+    std::string value;
+    ASSERT_THROW(roCache.find<AllocatorT>("key_0", value), std::logic_error);
+    roCache.attachAccessContainer(config.accessConfig);
+
+    using Status = ReadOnlySharedCacheView::LookupStatus;
+    for (int i = 0; i < numKeys; i++) {
+      ASSERT_EQ(Status::kFound,
+                roCache.find<AllocatorT>(folly::sformat("key_{}", i), value));
+      ASSERT_EQ(std::string(100 + i % 100, static_cast<char>('a' + i % 26)),
+                value);
+    }
+    ASSERT_EQ(Status::kNotFound, roCache.find<AllocatorT>("missing", value));
+
+    alloc.remove("key_0");
+    ASSERT_EQ(Status::kNotFound, roCache.find<AllocatorT>("key_0", value));
+
+    insert("key_1", 'z', 1000);
+    ASSERT_EQ(Status::kFound, roCache.find<AllocatorT>("key_1", value));
+    ASSERT_EQ(std::string(1000, 'z'), value);
+  }
+
+  // a separate process looks items up through the read only cache view while
+  // the owner keeps replacing and removing them. Every value it gets must be
+  // one the owner wrote in full.
+  void testReadOnlyCacheViewLookupMultiProcess() {
+    typename AllocatorT::Config config;
+    config.setCacheSize(20 * Slab::kSize);
+    config.enableCachePersistence(this->cacheDir_);
+    config.enableSharedCacheViewLookups();
+    config.setAccessConfig({8 /* bucket power */, 2 /* lock power */});
+
+    // Destroy singletons before we fork() below
+    folly::SingletonVault::singleton()->destroyInstances();
+
+    {
+      AllocatorT alloc(AllocatorT::SharedMemNew, config);
+      const auto poolId =
+          alloc.addPool("foobar", alloc.getCacheMemoryStats().ramCacheSize);
+      const int numKeys = 1000;
+      uint32_t version = 0;
+      auto insert = [&](int i) {
+        const char c = static_cast<char>('a' + version++ % 26);
+        const uint32_t size = 100 + folly::Random::rand32(900);
+        auto hdl = util::allocateAccessible(
+            alloc, poolId, folly::sformat("key_{}", i), size);
+        if (hdl) {
+          std::memset(hdl->getMemory(), c, size);
+          alloc.insertOrReplace(hdl);
+        }
+      };
+      for (int i = 0; i < numKeys; i++) {
+        insert(i);
+      }
+
+      auto pid = fork();
+      ASSERT_GE(pid, 0);
+      if (pid == 0) {
+        // use the return code to tell the parent what we saw, since
+        // assertions do not work in the child.
+        int found = 0;
+        int code = 5;
+        try {
+          auto roCache =
+              ReadOnlySharedCacheView(config.cacheDir, config.usePosixShm);
+          roCache.attachAccessContainer(config.accessConfig);
+          std::string value;
+          for (int i = 0; i < 200000; i++) {
+            const auto status = roCache.find<AllocatorT>(
+                folly::sformat("key_{}", i % numKeys), value);
+            if (status != ReadOnlySharedCacheView::LookupStatus::kFound) {
+              continue;
+            }
+            ++found;
+            if (value.size() < 100 || value.size() >= 1000 ||
+                std::count(value.begin(), value.end(), value[0]) !=
+                    static_cast<long>(value.size())) {
+              code = 1;
+              break;
+            }
+          }
+        } catch (const std::exception&) {
+          code = 2;
+        }
+        _exit(found > 0 ? code : 3);
+      }
+
+      int status = 0;
+      while (waitpid(pid, &status, WNOHANG) == 0) {
+        const int i = folly::Random::rand32(numKeys);
+        if (folly::Random::oneIn(10)) {
+          alloc.remove(folly::sformat("key_{}", i));
+        } else {
+          insert(i);
+        }
+      }
+      ASSERT_TRUE(WIFEXITED(status));
+      ASSERT_EQ(WEXITSTATUS(status), 5);
+      ASSERT_EQ(AllocatorT::ShutDownStatus::kSuccess, alloc.shutDown());
+    }
+
+    // Re-enable folly::Singleton creation
+    folly::SingletonVault::singleton()->reenableInstances();
+  }
 };
 } // namespace tests
 } // namespace cachelib
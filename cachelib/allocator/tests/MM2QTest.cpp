@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+
 #include <folly/Random.h>
 
 #include "cachelib/allocator/MM2Q.h"
@@ -649,6 +651,62 @@ TEST_F(MM2QTest, QueueAges) {
   ASSERT_EQ(8, c1.getEvictionAgeStat(0).coldQueueStat.oldestElementAge);
 }
 
+TEST_F(MM2QTest, AddCold) {
+  MM2Q::Config config;
+  config.lruRefreshTime = 0;
+  config.coldSizePercent = 50;
+  config.hotSizePercent = 30;
+  const size_t numItems = 10;
+  std::vector<std::unique_ptr<Node>> nodes;
+
+  Container c(config, {});
+  for (uint32_t i = 0; i < numItems; i++) {
+    nodes.emplace_back(new Node{static_cast<int>(i)});
+    ASSERT_TRUE(c.add(*nodes[i]));
+  }
+  // nodes ordering:
+  //  hot: 9 -> 8 -> 7
+  //  warm: none
+  //  cold: 6 -> 5 -> 4 -> 3 -> 2 -> 1 -> 0
+  const auto hotSize = c.getEvictionAgeStat(0).hotQueueStat.size;
+  const auto coldSize = c.getEvictionAgeStat(0).coldQueueStat.size;
+
+  nodes.emplace_back(new Node{static_cast<int>(numItems)});
+  auto& coldNode = *nodes.back();
+  ASSERT_TRUE(c.addCold(coldNode));
+  ASSERT_FALSE(c.addCold(coldNode));
+  ASSERT_FALSE(c.add(coldNode));
+  ASSERT_TRUE(coldNode.isInMMContainer());
+  // nodes ordering:
+  //  hot: 9 -> 8 -> 7
+  //  warm: none
+  //  cold: 10 -> 6 -> 5 -> 4 -> 3 -> 2 -> 1 -> 0
+  ASSERT_EQ(hotSize, c.getEvictionAgeStat(0).hotQueueStat.size);
+  ASSERT_EQ(coldSize + 1, c.getEvictionAgeStat(0).coldQueueStat.size);
+
+  // the node is evicted after the older cold nodes, but before any hot one
+  std::vector<int> evictionOrder;
+  for (auto itr = c.getEvictionIterator(); itr; ++itr) {
+    evictionOrder.push_back(itr->getId());
+  }
+  auto positionOf = [&](int id) {
+    return std::find(evictionOrder.begin(), evictionOrder.end(), id) -
+           evictionOrder.begin();
+  };
+  ASSERT_EQ(numItems + 1, evictionOrder.size());
+  ASSERT_LT(positionOf(0), positionOf(numItems));
+  ASSERT_LT(positionOf(numItems), positionOf(7));
+
+  // an access moves it to the warm queue like any other cold node
+  c.recordAccess(coldNode, AccessMode::kRead);
+  ASSERT_EQ(hotSize, c.getEvictionAgeStat(0).hotQueueStat.size);
+  ASSERT_EQ(1, c.getEvictionAgeStat(0).warmQueueStat.size);
+  ASSERT_EQ(coldSize, c.getEvictionAgeStat(0).coldQueueStat.size);
+
+  ASSERT_TRUE(c.remove(coldNode));
+  ASSERT_FALSE(coldNode.isInMMContainer());
+}
+
 TEST_F(MM2QTest, TailTrackingEnabledCheck) {
   MM2Q::Config config;
 
@@ -205,6 +205,89 @@ TEST_F(NvmAdmissionPolicyTest, CacheAllocatorConfigInitTest) {
   EXPECT_THROW({ config5.setNvmAdmissionMinTTL(5); }, std::invalid_argument);
 }
 
+TEST_F(NvmAdmissionPolicyTest, EvictionAgeAP) {
+  LruAllocator::Config config;
+  config.setCacheSize(100 * Slab::kSize);
+  LruAllocator cache{config};
+  const auto pid =
+      cache.addPool("default", cache.getCacheMemoryStats().ramCacheSize);
+  const int nKeys = 100;
+  for (int i = 0; i < nKeys; i++) {
+    auto handle = cache.allocate(pid, folly::sformat("key{}", i), 1000);
+    ASSERT_NE(nullptr, handle);
+    cache.insertOrReplace(handle);
+  }
+
+  EvictionAgeAP<LruAllocator>::Config apConfig;
+  apConfig.flashRetention = std::chrono::seconds{100};
+  // refreshed by the test only
+  apConfig.refreshInterval = std::chrono::hours{1};
+  EvictionAgeAP<LruAllocator> ap{apConfig};
+  ap.initCache(cache);
+  folly::Range<LruAllocator::ChainedItemIter> noChainedItems;
+  const auto now = util::getCurrentTimeSec();
+
+  // never inserted, so it has no hits of its own
+  auto fresh = cache.allocate(pid, "fresh", 1000);
+  ASSERT_NE(nullptr, fresh);
+
+  // the class has no signal until it is refreshed twice
+  ap.refresh(now);
+  EXPECT_TRUE(ap.accept(*fresh, noChainedItems));
+
+  // 1000 hits on 100 items in 10 seconds predict a reuse every second
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_NE(nullptr, cache.find(folly::sformat("key{}", i % nKeys)));
+  }
+  ap.refresh(now + 10);
+  EXPECT_TRUE(ap.accept(*fresh, noChainedItems));
+
+  // no hits predict no reuse
+  ap.refresh(now + 20);
+  EXPECT_FALSE(ap.accept(*fresh, noChainedItems));
+
+  auto ctrs = ap.getCounters();
+  EXPECT_EQ(ctrs["ap.accepted"], 2);
+  EXPECT_EQ(ctrs["ap.rejected"], 1);
+  EXPECT_EQ(ctrs["ap.eviction_age_retention_secs"], 100);
+}
+
+TEST_F(NvmAdmissionPolicyTest, EvictionAgeAPWriteBudget) {
+  LruAllocator::Config config;
+  config.setCacheSize(100 * Slab::kSize);
+  LruAllocator cache{config};
+  const auto pid =
+      cache.addPool("default", cache.getCacheMemoryStats().ramCacheSize);
+  auto item = cache.allocate(pid, "key", 1000);
+  ASSERT_NE(nullptr, item);
+
+  EvictionAgeAP<LruAllocator>::Config apConfig;
+  apConfig.flashRetention = std::chrono::seconds{100};
+  apConfig.writeBudgetBytesPerSec = 100;
+  apConfig.refreshInterval = std::chrono::hours{1};
+  EvictionAgeAP<LruAllocator> ap{apConfig};
+  ap.initCache(cache);
+  folly::Range<LruAllocator::ChainedItemIter> noChainedItems;
+  const auto now = util::getCurrentTimeSec();
+
+  ap.refresh(now);
+  // 10 items of more than 1000 bytes in 10 seconds exceed the budget 10 times
+  for (int i = 0; i < 10; i++) {
+    EXPECT_TRUE(ap.accept(*item, noChainedItems));
+  }
+  ap.refresh(now + 10);
+  auto ctrs = ap.getCounters();
+  EXPECT_GE(ctrs["ap.eviction_age_retention_secs"], 1);
+  EXPECT_LT(ctrs["ap.eviction_age_retention_secs"], 10);
+
+  // the retention time grows back while under the budget
+  const auto shrunk = ctrs["ap.eviction_age_retention_secs"];
+  ap.refresh(now + 20);
+  ctrs = ap.getCounters();
+  EXPECT_GT(ctrs["ap.eviction_age_retention_secs"], shrunk);
+  EXPECT_LE(ctrs["ap.eviction_age_retention_secs"], 100);
+}
+
 } // namespace tests
 } // namespace cachelib
 } // namespace facebook
@@ -18,7 +18,10 @@
 #include <folly/init/Init.h>
 #include <gflags/gflags.h>
 
+#include <atomic>
 #include <random>
+#include <thread>
+#include <vector>
 
 #include "cachelib/allocator/CacheAllocator.h"
 #include "cachelib/compact_cache/CCacheCreator.h"
@@ -30,10 +33,17 @@ DEFINE_double(miss_percentage, 0.05, "Percentage of misses in read operations");
 DEFINE_uint64(cache_size, 10UL * 1024UL * 1024UL * 1024UL, "size of cache");
 DEFINE_uint64(num_keys, 10UL * 1000UL * 1000UL, "number of keys");
 DEFINE_uint64(num_ops, 100UL * 1000UL * 1000UL, "number of operations");
+DEFINE_double(mt_write_percentage,
+              0.01,
+              "Percentage of write operations of the multithreaded runs");
+DEFINE_uint64(mt_hot_keys,
+              1000,
+              "number of keys the multithreaded runs access, so threads keep "
+              "hitting the same buckets");
 
 inline uint32_t getKey(uint32_t i) { return i % FLAGS_num_keys; }
 
-template <size_t KeySize>
+template <size_t KeySize, bool SplitBucket = false, typename ValueT = NoValue>
 struct CacheTestImpl {
   struct FOLLY_PACK_ATTR Key {
     uint32_t value;
@@ -50,7 +60,10 @@ struct CacheTestImpl {
   std::unique_ptr<LruAllocator> cache_;
   PoolId itemPool;
 
-  using CCacheType = typename CCacheCreator<CCacheAllocator, Key>::type;
+  using CCacheType = typename std::conditional<
+      SplitBucket,
+      typename CCacheSplitBucketCreator<CCacheAllocator, Key, ValueT>::type,
+      typename CCacheCreator<CCacheAllocator, Key, ValueT>::type>::type;
   CCacheType* ccache_{nullptr};
 
   CacheTestImpl() {
@@ -80,7 +93,12 @@ struct CacheTestImpl {
     }
     for (uint32_t i = 0; i < numKeys; ++i) {
       Key key{i};
-      ccache_->set(key);
+      if constexpr (std::is_same<ValueT, NoValue>::value) {
+        ccache_->set(key);
+      } else {
+        ValueT val{};
+        ccache_->set(key, &val);
+      }
     }
   }
 };
@@ -128,6 +146,71 @@ void runCacheRW(bool isItemCache) {
   }
 }
 
+// Read heavy mix over a few hot keys from many threads, where the locked read
+// path bounces the bucket locks between cores and the split bucket path only
+// reads the bucket.
+template <size_t KeySize, bool SplitBucket>
+void runCompactCacheMT(uint32_t iters, size_t numThreads) {
+  using CacheTest = CacheTestImpl<KeySize, SplitBucket, uint64_t>;
+  std::unique_ptr<CacheTest> t;
+  BENCHMARK_SUSPEND { t = std::make_unique<CacheTest>(); };
+
+  const uint64_t opsPerThread = FLAGS_num_ops / numThreads;
+  const uint32_t writeEvery =
+      FLAGS_mt_write_percentage > 0
+          ? static_cast<uint32_t>(1 / FLAGS_mt_write_percentage)
+          : 0;
+  for (uint32_t iter = 0; iter < iters; iter++) {
+    std::vector<std::thread> threads;
+    for (size_t tid = 0; tid < numThreads; tid++) {
+      threads.emplace_back([&, tid] {
+        std::mt19937 gen(tid);
+        std::uniform_int_distribution<uint32_t> keyDist(
+            0, FLAGS_mt_hot_keys - 1);
+        uint64_t val = 0;
+        for (uint64_t i = 0; i < opsPerThread; i++) {
+          typename CacheTest::Key key{keyDist(gen)};
+          if (writeEvery != 0 && i % writeEvery == 0) {
+            val = i;
+            t->ccache_->set(key, &val);
+          } else {
+            t->ccache_->get(key, &val);
+          }
+        }
+        folly::doNotOptimizeAway(val);
+      });
+    }
+    for (auto& th : threads) {
+      th.join();
+    }
+  }
+}
+
+// The benchmark macros paste the function name into an identifier, so they
+// can't take the template instantiations directly.
+void lockedBucket8(uint32_t iters, size_t numThreads) {
+  runCompactCacheMT<8, false>(iters, numThreads);
+}
+void splitBucket8(uint32_t iters, size_t numThreads) {
+  runCompactCacheMT<8, true>(iters, numThreads);
+}
+void lockedBucket32(uint32_t iters, size_t numThreads) {
+  runCompactCacheMT<32, false>(iters, numThreads);
+}
+void splitBucket32(uint32_t iters, size_t numThreads) {
+  runCompactCacheMT<32, true>(iters, numThreads);
+}
+
+BENCHMARK_PARAM(lockedBucket8, 1)
+BENCHMARK_RELATIVE_PARAM(splitBucket8, 1)
+BENCHMARK_PARAM(lockedBucket8, 4)
+BENCHMARK_RELATIVE_PARAM(splitBucket8, 4)
+BENCHMARK_PARAM(lockedBucket8, 16)
+BENCHMARK_RELATIVE_PARAM(splitBucket8, 16)
+BENCHMARK_PARAM(lockedBucket32, 16)
+BENCHMARK_RELATIVE_PARAM(splitBucket32, 16)
+BENCHMARK_DRAW_LINE();
+
 BENCHMARK(ItemCache10) { runCacheRW<10>(true); }
 BENCHMARK_RELATIVE(CompactCache10) { runCacheRW<10>(false); }
 BENCHMARK(ItemCache32) { runCacheRW<32>(true); }
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the latency of compact cache requests while the compact cache is
+// resized under them. Threads get and set random keys of a full compact
+// cache while the main thread grows and shrinks its pool by a few slabs and
+// resizes the compact cache. Prints the latency percentiles of the requests
+// issued during the resizes and of the ones issued between them, how long
+// the resizes took and how many buckets requests migrated themselves.
+
+#include <folly/Format.h>
+#include <folly/Random.h>
+#include <folly/init/Init.h>
+#include <gflags/gflags.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "cachelib/allocator/CacheAllocator.h"
+#include "cachelib/common/PercentileStats.h"
+#include "cachelib/compact_cache/CCacheCreator.h"
+
+DEFINE_uint64(cache_size_mb, 1024, "size of the cache");
+DEFINE_uint64(ccache_size_mb, 256, "initial size of the compact cache");
+DEFINE_uint32(resize_slabs, 16, "slabs every resize adds, then removes");
+DEFINE_uint32(num_resizes, 10, "number of grow and shrink rounds");
+DEFINE_uint32(num_threads, 8, "threads issuing requests");
+DEFINE_uint32(write_pct, 10, "share of sets in percent, the rest get");
+DEFINE_uint32(pause_ms, 200, "time between resizes");
+
+namespace facebook {
+namespace cachelib {
+namespace {
+struct CACHELIB_PACKED_ATTR Key {
+  uint64_t value;
+  /* implicit */ Key(uint64_t v = 0) : value(v) {}
+  bool operator==(const Key& other) const { return value == other.value; }
+  bool isEmpty() const { return value == 0; }
+};
+
+using CCache = CCacheCreator<CCacheAllocator, Key, uint64_t>::type;
+
+void printEstimates(folly::StringPiece name, util::PercentileStats& stats) {
+  const auto e = stats.estimate();
+  std::cout << folly::sformat("{:<10} {:>10} {:>10} {:>10} {:>10} {:>12}",
+                              name, e.p50, e.p99, e.p999, e.p9999, e.p100)
+            << std::endl;
+}
+
+void run() {
+  LruAllocator::Config config;
+  config.size = FLAGS_cache_size_mb * 1024 * 1024;
+  config.enableCompactCache();
+  LruAllocator cache(config);
+  auto& ccache =
+      *cache.addCompactCache<CCache>("ccache", FLAGS_ccache_size_mb << 20);
+  const auto pid = ccache.getPoolId();
+  const uint64_t numKeys = ccache.getNumEntries();
+  for (uint64_t i = 1; i <= numKeys; i++) {
+    ccache.set(i, &i);
+  }
+
+  // requests started while a resize runs are tracked apart
+  std::atomic<bool> resizing{false};
+  std::atomic<bool> stop{false};
+  util::PercentileStats duringResize{std::chrono::seconds{3600}};
+  util::PercentileStats betweenResizes{std::chrono::seconds{3600}};
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t < FLAGS_num_threads; t++) {
+    threads.emplace_back([&] {
+      uint64_t val = 0;
+      while (!stop) {
+        const uint64_t key = 1 + folly::Random::rand64(numKeys);
+        util::LatencyTracker tracker{resizing ? duringResize : betweenResizes};
+        if (folly::Random::rand32(100) < FLAGS_write_pct) {
+          ccache.set(key, &key);
+        } else {
+          ccache.get(key, &val);
+        }
+      }
+    });
+  }
+
+  auto timedResize = [&] {
+    resizing = true;
+    const auto begin = std::chrono::steady_clock::now();
+    ccache.resize();
+    const auto elapsed = std::chrono::steady_clock::now() - begin;
+    resizing = false;
+    return std::chrono::duration<double, std::milli>(elapsed).count();
+  };
+
+  const size_t resizeBytes = FLAGS_resize_slabs * Slab::kSize;
+  double growMs = 0;
+  double shrinkMs = 0;
+  for (uint32_t i = 0; i < FLAGS_num_resizes; i++) {
+    /* sleep override */
+    std::this_thread::sleep_for(std::chrono::milliseconds(FLAGS_pause_ms));
+    if (!cache.growPool(pid, resizeBytes)) {
+      throw std::runtime_error("not enough free memory to grow the pool");
+    }
+    growMs += timedResize();
+
+    /* sleep override */
+    std::this_thread::sleep_for(std::chrono::milliseconds(FLAGS_pause_ms));
+    cache.shrinkPool(pid, resizeBytes);
+    shrinkMs += timedResize();
+  }
+  stop = true;
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  std::cout << folly::sformat("{:<10} {:>10} {:>10} {:>10} {:>10} {:>12}",
+                              "ns", "p50", "p99", "p999", "p9999", "max")
+            << std::endl;
+  printEstimates("resizing", duringResize);
+  printEstimates("steady", betweenResizes);
+
+  const auto stats = ccache.getStats();
+  std::cout << folly::sformat(
+                   "avg grow {:.2f} ms, avg shrink {:.2f} ms, buckets "
+                   "migrated on access {}, by the sweep {}",
+                   growMs / FLAGS_num_resizes, shrinkMs / FLAGS_num_resizes,
+                   stats.resizeMigrationsOnAccess, stats.resizeMigrationsSwept)
+            << std::endl;
+}
+} // namespace
+} // namespace cachelib
+} // namespace facebook
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  facebook::cachelib::run();
+  return 0;
+}
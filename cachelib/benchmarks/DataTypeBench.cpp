@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compares lookups and inserts of cachelib::Map with each index layout
+// against std::unordered_map, at several map sizes. Lookups hit keys in a
+// random order. Inserts build maps of the given size from the default
+// capacity, so they include the expansions of the index.
+//
+// Also compares range reads of cachelib::RangeMap: a request of several small
+// ranges looked up one by one against rangeLookupBatch, and a scan of the
+// whole map with the plain iterator against the one that reads ahead.
+
+#include <folly/Benchmark.h>
+#include <folly/Random.h>
+#include <folly/init/Init.h>
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "cachelib/allocator/CacheAllocator.h"
+#include "cachelib/allocator/Util.h"
+#include "cachelib/datatype/Map.h"
+#include "cachelib/datatype/RangeMap.h"
+
+namespace facebook {
+namespace cachelib {
+namespace {
+using Value = uint64_t;
+
+LruAllocator& getCache() {
+  static auto cache = [] {
+    LruAllocator::Config config;
+    config.configureChainedItems();
+    config.setCacheSize(64 * Slab::kSize);
+    config.setDefaultAllocSizes(util::generateAllocSizes(1.25, 1024 * 1024));
+    auto c = std::make_unique<LruAllocator>(config);
+    c->addPool("default", c->getCacheMemoryStats().ramCacheSize);
+    return c;
+  }();
+  return *cache;
+}
+
+std::vector<uint64_t> makeKeys(size_t size) {
+  std::vector<uint64_t> keys(size);
+  std::mt19937_64 gen{folly::Random::rand64()};
+  for (auto& key : keys) {
+    key = gen();
+  }
+  return keys;
+}
+
+template <MapIndexLayout Layout>
+using BenchMap = Map<uint64_t, Value, LruAllocator, Layout>;
+
+template <MapIndexLayout Layout>
+void mapLookup(uint32_t iters, size_t size) {
+  BenchMap<Layout> map;
+  std::vector<uint64_t> keys;
+  BENCHMARK_SUSPEND {
+    map = BenchMap<Layout>::create(getCache(), 0, "map");
+    keys = makeKeys(size);
+    for (auto key : keys) {
+      map.insert(key, key);
+    }
+    std::shuffle(keys.begin(), keys.end(), std::mt19937_64{});
+  }
+
+  for (uint32_t i = 0; i < iters; ++i) {
+    folly::doNotOptimizeAway(map.find(keys[i % size]));
+  }
+
+  BENCHMARK_SUSPEND { map = nullptr; }
+}
+
+template <MapIndexLayout Layout>
+void mapInsert(uint32_t iters, size_t size) {
+  std::vector<uint64_t> keys;
+  BENCHMARK_SUSPEND { keys = makeKeys(size); }
+
+  for (uint32_t done = 0; done < iters;) {
+    BenchMap<Layout> map;
+    BENCHMARK_SUSPEND { map = BenchMap<Layout>::create(getCache(), 0, "map"); }
+    for (size_t i = 0; i < size && done < iters; ++i, ++done) {
+      map.insert(keys[i], keys[i]);
+    }
+    BENCHMARK_SUSPEND { map = nullptr; }
+  }
+}
+
+void stdLookup(uint32_t iters, size_t size) {
+  std::unordered_map<uint64_t, Value> map;
+  std::vector<uint64_t> keys;
+  BENCHMARK_SUSPEND {
+    keys = makeKeys(size);
+    for (auto key : keys) {
+      map.emplace(key, key);
+    }
+    std::shuffle(keys.begin(), keys.end(), std::mt19937_64{});
+  }
+
+  for (uint32_t i = 0; i < iters; ++i) {
+    folly::doNotOptimizeAway(map.find(keys[i % size]));
+  }
+}
+
+void stdInsert(uint32_t iters, size_t size) {
+  std::vector<uint64_t> keys;
+  BENCHMARK_SUSPEND { keys = makeKeys(size); }
+
+  for (uint32_t done = 0; done < iters;) {
+    std::unordered_map<uint64_t, Value> map;
+    for (size_t i = 0; i < size && done < iters; ++i, ++done) {
+      map.emplace(keys[i], keys[i]);
+    }
+    BENCHMARK_SUSPEND { map = {}; }
+  }
+}
+
+using BenchRangeMap = RangeMap<uint64_t, Value, LruAllocator>;
+
+// Keys are timestamps kKeyStep apart. A request reads kRangesPerRequest
+// ranges of about kKeysPerRange keys each at random places in the map.
+constexpr uint64_t kKeyStep = 10;
+constexpr size_t kRangesPerRequest = 8;
+constexpr uint64_t kKeysPerRange = 16;
+constexpr size_t kNumRequests = 1024;
+
+// Inserts the keys in a random order, so that the values of neighbouring
+// keys end up scattered over the chained items.
+BenchRangeMap makeRangeMap(size_t size) {
+  std::vector<uint64_t> keys(size);
+  for (size_t i = 0; i < size; ++i) {
+    keys[i] = i * kKeyStep;
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937_64{});
+  auto map = BenchRangeMap::create(getCache(), 0, "range_map");
+  for (auto key : keys) {
+    map.insert(key, key);
+  }
+  return map;
+}
+
+std::vector<std::vector<BenchRangeMap::KeyRange>> makeRangeRequests(
+    size_t size) {
+  std::vector<std::vector<BenchRangeMap::KeyRange>> requests(kNumRequests);
+  for (auto& request : requests) {
+    for (size_t i = 0; i < kRangesPerRequest; ++i) {
+      const uint64_t first = folly::Random::rand64(size) * kKeyStep;
+      request.emplace_back(first, first + kKeysPerRange * kKeyStep);
+    }
+  }
+  return requests;
+}
+
+void rangeLookupEach(uint32_t iters, size_t size) {
+  std::optional<BenchRangeMap> map;
+  std::vector<std::vector<BenchRangeMap::KeyRange>> requests;
+  BENCHMARK_SUSPEND {
+    map = makeRangeMap(size);
+    requests = makeRangeRequests(size);
+  }
+
+  const auto& crm = *map;
+  for (uint32_t i = 0; i < iters; ++i) {
+    uint64_t sum = 0;
+    for (const auto& [first, last] : requests[i % kNumRequests]) {
+      for (const auto& kv : crm.rangeLookupApproximate(first, last)) {
+        sum += kv.value;
+      }
+    }
+    folly::doNotOptimizeAway(sum);
+  }
+
+  BENCHMARK_SUSPEND { map.reset(); }
+}
+
+void rangeLookupBatched(uint32_t iters, size_t size) {
+  std::optional<BenchRangeMap> map;
+  std::vector<std::vector<BenchRangeMap::KeyRange>> requests;
+  BENCHMARK_SUSPEND {
+    map = makeRangeMap(size);
+    requests = makeRangeRequests(size);
+  }
+
+  const auto& crm = *map;
+  for (uint32_t i = 0; i < iters; ++i) {
+    uint64_t sum = 0;
+    for (const auto& range : crm.rangeLookupBatch(requests[i % kNumRequests])) {
+      for (const auto& kv : range) {
+        sum += kv.value;
+      }
+    }
+    folly::doNotOptimizeAway(sum);
+  }
+
+  BENCHMARK_SUSPEND { map.reset(); }
+}
+
+void rangeScan(uint32_t iters, size_t size) {
+  std::optional<BenchRangeMap> map;
+  BENCHMARK_SUSPEND { map = makeRangeMap(size); }
+
+  const auto& crm = *map;
+  for (uint32_t i = 0; i < iters; ++i) {
+    uint64_t sum = 0;
+    for (const auto& kv : crm) {
+      sum += kv.value;
+    }
+    folly::doNotOptimizeAway(sum);
+  }
+
+  BENCHMARK_SUSPEND { map.reset(); }
+}
+
+void rangeScanReadahead(uint32_t iters, size_t size) {
+  std::optional<BenchRangeMap> map;
+  BENCHMARK_SUSPEND { map = makeRangeMap(size); }
+
+  const auto& crm = *map;
+  const std::vector<BenchRangeMap::KeyRange> all{
+      {0, std::numeric_limits<uint64_t>::max()}};
+  for (uint32_t i = 0; i < iters; ++i) {
+    const auto ranges = crm.rangeLookupBatch(all);
+    uint64_t sum = 0;
+    for (const auto& kv : ranges.at(0)) {
+      sum += kv.value;
+    }
+    folly::doNotOptimizeAway(sum);
+  }
+
+  BENCHMARK_SUSPEND { map.reset(); }
+}
+
+// The benchmark macros paste the function name into an identifier, so they
+// can't take the template instantiations directly.
+void robinHoodLookup(uint32_t iters, size_t size) {
+  mapLookup<MapIndexLayout::kRobinHood>(iters, size);
+}
+void groupedLookup(uint32_t iters, size_t size) {
+  mapLookup<MapIndexLayout::kGrouped>(iters, size);
+}
+void groupedInlineLookup(uint32_t iters, size_t size) {
+  mapLookup<MapIndexLayout::kGroupedInline>(iters, size);
+}
+void robinHoodInsert(uint32_t iters, size_t size) {
+  mapInsert<MapIndexLayout::kRobinHood>(iters, size);
+}
+void groupedInsert(uint32_t iters, size_t size) {
+  mapInsert<MapIndexLayout::kGrouped>(iters, size);
+}
+void groupedInlineInsert(uint32_t iters, size_t size) {
+  mapInsert<MapIndexLayout::kGroupedInline>(iters, size);
+}
+} // namespace
+} // namespace cachelib
+} // namespace facebook
+
+using namespace facebook::cachelib;
+
+// The biggest size stays clear of the 1MB limit of the index item for every
+// layout.
+#define DATATYPE_BENCH_SIZE(op, size)               \
+  BENCHMARK_PARAM(std##op, size)                    \
+  BENCHMARK_RELATIVE_PARAM(robinHood##op, size)     \
+  BENCHMARK_RELATIVE_PARAM(grouped##op, size)       \
+  BENCHMARK_RELATIVE_PARAM(groupedInline##op, size) \
+  BENCHMARK_DRAW_LINE();
+
+DATATYPE_BENCH_SIZE(Lookup, 100)
+DATATYPE_BENCH_SIZE(Lookup, 1000)
+DATATYPE_BENCH_SIZE(Lookup, 10000)
+DATATYPE_BENCH_SIZE(Lookup, 20000)
+DATATYPE_BENCH_SIZE(Insert, 100)
+DATATYPE_BENCH_SIZE(Insert, 1000)
+DATATYPE_BENCH_SIZE(Insert, 10000)
+DATATYPE_BENCH_SIZE(Insert, 20000)
+
+// The index of a range map has to stay under 1MB and is expanded at half of
+// its capacity, which keeps these maps below about 40k entries.
+#define RANGEMAP_BENCH_SIZE(size)                    \
+  BENCHMARK_PARAM(rangeLookupEach, size)             \
+  BENCHMARK_RELATIVE_PARAM(rangeLookupBatched, size) \
+  BENCHMARK_PARAM(rangeScan, size)                   \
+  BENCHMARK_RELATIVE_PARAM(rangeScanReadahead, size) \
+  BENCHMARK_DRAW_LINE();
+
+RANGEMAP_BENCH_SIZE(1000)
+RANGEMAP_BENCH_SIZE(10000)
+RANGEMAP_BENCH_SIZE(40000)
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures how the in-flight put and delete tracking of nvmcache scales with
+// the number of threads. Like NvmCache, the InFlightPuts and TombStones are
+// sharded by key. Every thread runs the same mix of operations on random keys:
+//  - put: acquire a put token, check for a tombstone and execute on the token
+//  - delete: add a tombstone, invalidate the put token and drop the tombstone
+//  - get: invalidate the put token and check for a tombstone
+// Prints the operations per second for a doubling number of threads.
+
+#include <folly/Format.h>
+#include <folly/Random.h>
+#include <folly/init/Init.h>
+#include <gflags/gflags.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cachelib/allocator/nvmcache/InFlightPuts.h"
+#include "cachelib/allocator/nvmcache/TombStones.h"
+
+DEFINE_uint64(num_keys, 1000000, "number of distinct keys");
+DEFINE_uint32(num_shards, 8192, "number of shards, like NvmCache::kShards");
+DEFINE_uint32(max_threads, 32, "largest number of threads to run with");
+DEFINE_uint32(duration_ms, 2000, "time every run takes");
+DEFINE_uint32(put_pct, 50, "percentage of puts");
+DEFINE_uint32(delete_pct, 10, "percentage of deletes. The rest are gets");
+
+namespace facebook {
+namespace cachelib {
+namespace {
+struct Shards {
+  explicit Shards(uint32_t n)
+      : puts(new InFlightPuts[n]), tombstones(new TombStones[n]) {}
+
+  std::unique_ptr<InFlightPuts[]> puts;
+  std::unique_ptr<TombStones[]> tombstones;
+};
+
+std::vector<std::string> makeKeys() {
+  std::vector<std::string> keys;
+  keys.reserve(FLAGS_num_keys);
+  for (uint64_t i = 0; i < FLAGS_num_keys; i++) {
+    keys.push_back(folly::sformat("key_{}", i));
+  }
+  return keys;
+}
+
+void runOp(Shards& shards, folly::StringPiece key, uint32_t shard) {
+  auto& puts = shards.puts[shard];
+  auto& tombstones = shards.tombstones[shard];
+  const auto op = folly::Random::rand32(100);
+  if (op < FLAGS_put_pct) {
+    auto token = puts.tryAcquireToken(key);
+    if (token.isValid() && !tombstones.isPresent(key)) {
+      token.executeIfValid([]() {});
+    }
+  } else if (op < FLAGS_put_pct + FLAGS_delete_pct) {
+    auto guard = tombstones.add(key);
+    puts.invalidateToken(key);
+  } else {
+    puts.invalidateToken(key);
+    tombstones.isPresent(key);
+  }
+}
+
+// @return  operations per second of numThreads threads
+double run(Shards& shards,
+           const std::vector<std::string>& keys,
+           uint32_t numThreads) {
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> ops{0};
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t < numThreads; t++) {
+    threads.emplace_back([&] {
+      uint64_t done = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        const auto i = folly::Random::rand64(keys.size());
+        runOp(shards, keys[i], static_cast<uint32_t>(i % FLAGS_num_shards));
+        ++done;
+      }
+      ops += done;
+    });
+  }
+
+  /* sleep override */
+  std::this_thread::sleep_for(std::chrono::milliseconds(FLAGS_duration_ms));
+  stop = true;
+  for (auto& t : threads) {
+    t.join();
+  }
+  return ops * 1000.0 / FLAGS_duration_ms;
+}
+
+void runAll() {
+  Shards shards(FLAGS_num_shards);
+  const auto keys = makeKeys();
+  std::cout << folly::sformat("{:>8} {:>16} {:>16}", "threads", "ops/s",
+                              "ops/s/thread")
+            << std::endl;
+  for (uint32_t n = 1; n <= FLAGS_max_threads; n *= 2) {
+    const auto opsPerSec = run(shards, keys, n);
+    std::cout << folly::sformat("{:>8} {:>16.0f} {:>16.0f}", n, opsPerSec,
+                                opsPerSec / n)
+              << std::endl;
+  }
+}
+} // namespace
+} // namespace cachelib
+} // namespace facebook
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  facebook::cachelib::runAll();
+  return 0;
+}
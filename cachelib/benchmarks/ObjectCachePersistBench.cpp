@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compares persist and restore of an object cache filled with synthetic
+// objects between the record format (one thrift record per object through an
+// MPMC queue of objects) and the streaming format (batched hand out, chunked
+// shards, zstd), uncompressed and compressed. Objects are strings of random
+// words, so they compress about as well as typical serialized structs.
+// Prints the persist and restore times and the bytes written.
+
+#include <folly/Conv.h>
+#include <folly/Format.h>
+#include <folly/Random.h>
+#include <folly/init/Init.h>
+#include <folly/io/IOBuf.h>
+#include <gflags/gflags.h>
+#include <sys/stat.h>
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cachelib/allocator/CacheAllocator.h"
+#include "cachelib/object_cache/ObjectCache.h"
+
+DEFINE_uint64(num_objects, 1000 * 1000, "objects in the cache");
+DEFINE_uint32(object_size, 1024, "bytes of every object");
+DEFINE_uint32(threads, 8, "persist and restore threads");
+DEFINE_int32(compression_level, 3, "zstd level of the compressed run");
+DEFINE_string(path, "/tmp/objcache_persist_bench", "base path of the files");
+
+namespace facebook {
+namespace cachelib {
+namespace objcache2 {
+namespace {
+using ObjectCache = ObjectCache<LruAllocator>;
+
+enum class Mode { kRecords, kStreaming, kStreamingCompressed };
+
+struct Result {
+  double persistSecs{0};
+  double restoreSecs{0};
+  uint64_t bytes{0};
+  uint64_t restored{0};
+};
+
+std::string makeObject(std::mt19937_64& gen) {
+  static const std::vector<std::string> kWords{
+      "cache", "object", "flash", "memory", "item",  "slab",
+      "pool",  "key",    "value", "hit",    "miss", "evict"};
+  std::string s;
+  s.reserve(FLAGS_object_size);
+  while (s.size() < FLAGS_object_size) {
+    s += kWords[gen() % kWords.size()];
+    s += folly::to<std::string>(gen() % 1000);
+  }
+  s.resize(FLAGS_object_size);
+  return s;
+}
+
+uint64_t bytesOnDisk(uint32_t numFiles) {
+  uint64_t total = 0;
+  struct stat st;
+  if (::stat(FLAGS_path.c_str(), &st) == 0) {
+    total += st.st_size;
+  }
+  for (uint32_t i = 0; i < numFiles; i++) {
+    if (::stat(folly::sformat("{}_{}", FLAGS_path, i).c_str(), &st) == 0) {
+      total += st.st_size;
+    }
+  }
+  return total;
+}
+
+void removeFiles(uint32_t numFiles) {
+  std::remove(FLAGS_path.c_str());
+  for (uint32_t i = 0; i < numFiles; i++) {
+    std::remove(folly::sformat("{}_{}", FLAGS_path, i).c_str());
+  }
+}
+
+Result run(Mode mode) {
+  auto serialize = [](typename ObjectCache::Serializer serializer) {
+    return serializer.template serialize<std::string>(
+        std::function<std::unique_ptr<folly::IOBuf>(std::string*)>(
+            [](std::string* s) { return folly::IOBuf::copyBuffer(*s); }));
+  };
+  auto deserialize = [](typename ObjectCache::Deserializer deserializer) {
+    return deserializer.template deserialize<std::string>(
+        std::function<std::unique_ptr<std::string>(folly::StringPiece)>(
+            [](folly::StringPiece payload) {
+              return std::make_unique<std::string>(payload.str());
+            }));
+  };
+
+  ObjectCache::Config config;
+  config.setCacheName("bench")
+      .setCacheCapacity(FLAGS_num_objects)
+      .setItemDestructor([](ObjectCacheDestructorData data) {
+        data.deleteObject<std::string>();
+      });
+  if (mode == Mode::kRecords) {
+    config.enablePersistence(FLAGS_threads, FLAGS_path, serialize,
+                             deserialize);
+  } else {
+    config.enableStreamingPersistence(
+        FLAGS_threads, makeFilePersistStreams(FLAGS_path), serialize,
+        deserialize,
+        mode == Mode::kStreaming ? 0 : FLAGS_compression_level);
+  }
+
+  Result result;
+  {
+    auto objcache = ObjectCache::create(config);
+    std::mt19937_64 gen{folly::Random::rand64()};
+    for (uint64_t i = 0; i < FLAGS_num_objects; i++) {
+      auto obj = std::make_unique<std::string>(makeObject(gen));
+      objcache->insertOrReplace(folly::to<std::string>("key_", i),
+                                std::move(obj), FLAGS_object_size);
+    }
+    const auto begin = std::chrono::steady_clock::now();
+    if (!objcache->persist()) {
+      throw std::runtime_error("persist failed");
+    }
+    result.persistSecs = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - begin)
+                             .count();
+  }
+  result.bytes = bytesOnDisk(FLAGS_threads);
+
+  {
+    auto objcache = ObjectCache::create(config);
+    const auto begin = std::chrono::steady_clock::now();
+    if (!objcache->recover()) {
+      throw std::runtime_error("recover failed");
+    }
+    result.restoreSecs = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - begin)
+                             .count();
+    result.restored = objcache->getNumEntries();
+  }
+  removeFiles(FLAGS_threads);
+  return result;
+}
+} // namespace
+} // namespace objcache2
+} // namespace cachelib
+} // namespace facebook
+
+int main(int argc, char** argv) {
+  using namespace facebook::cachelib::objcache2;
+  folly::init(&argc, &argv);
+
+  std::cout << folly::sformat("{:<22} {:>12} {:>12} {:>14} {:>10}", "format",
+                              "persist s", "restore s", "bytes", "restored")
+            << std::endl;
+  for (auto mode :
+       {Mode::kRecords, Mode::kStreaming, Mode::kStreamingCompressed}) {
+    const auto r = run(mode);
+    const char* name = mode == Mode::kRecords     ? "records"
+                       : mode == Mode::kStreaming ? "streaming"
+                                                  : "streaming+zstd";
+    std::cout << folly::sformat("{:<22} {:>12.3f} {:>12.3f} {:>14} {:>10}",
+                                name, r.persistSecs, r.restoreSecs, r.bytes,
+                                r.restored)
+              << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compares the two ways a size-aware object cache bounds its memory under
+// churn: the periodic size controller, which adjusts the entries limit from
+// the average object size every tick, and the size limit applied on every
+// insert. Threads replace random keys with strings of random sizes and, after
+// every insert, record how far the total object size is above the limit.
+// Prints the throughput, the largest overshoot, the share of inserts that
+// left the cache above its limit and the evictions made on insert.
+
+#include <folly/Benchmark.h>
+#include <folly/Conv.h>
+#include <folly/Format.h>
+#include <folly/Random.h>
+#include <folly/init/Init.h>
+#include <folly/logging/xlog.h>
+#include <gflags/gflags.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cachelib/allocator/CacheAllocator.h"
+#include "cachelib/object_cache/ObjectCache.h"
+#include "cachelib/object_cache/util/ObjectSizeHooks.h"
+
+DEFINE_uint32(num_threads, 8, "threads inserting into the cache");
+DEFINE_uint64(num_keys, 200 * 1000, "number of distinct keys");
+DEFINE_uint64(ops_per_thread, 1000 * 1000, "operations per thread");
+DEFINE_uint32(find_pct, 20, "share of finds in percent, the rest replace");
+DEFINE_uint64(size_limit_mb, 64, "total object size limit");
+DEFINE_uint32(min_object_size, 64, "smallest string payload");
+DEFINE_uint32(max_object_size, 16 * 1024, "largest string payload");
+DEFINE_int32(size_controller_interval_ms,
+             100,
+             "interval of the size controller");
+
+namespace facebook {
+namespace cachelib {
+namespace objcache2 {
+namespace {
+using ObjectCache = ObjectCache<LruAllocator>;
+
+struct Result {
+  double opsPerSec{0};
+  double maxOverPct{0};
+  double insertsOverPct{0};
+  double sizeEvictions{0};
+};
+
+Result run(bool sizeLimitOnInsert) {
+  const size_t limit = FLAGS_size_limit_mb * 1024 * 1024;
+  ObjectCache::Config config;
+  config.setCacheName("bench").setItemDestructor(
+      [](ObjectCacheDestructorData data) {
+        data.deleteObject<std::string>();
+      });
+  if (sizeLimitOnInsert) {
+    config.setSizeAwareCapacity(FLAGS_num_keys, limit)
+        .setObjectSizeHook(allocatorSizeClassHook);
+  } else {
+    config.setCacheCapacity(FLAGS_num_keys, limit,
+                            FLAGS_size_controller_interval_ms);
+  }
+  auto objcache = ObjectCache::create(config);
+
+  std::atomic<uint64_t> inserts{0};
+  std::atomic<uint64_t> insertsOver{0};
+  std::atomic<size_t> maxTotal{0};
+  auto worker = [&](uint32_t id) {
+    std::mt19937_64 gen{folly::Random::rand64() + id};
+    std::uniform_int_distribution<uint64_t> keyDist(0, FLAGS_num_keys - 1);
+    std::uniform_int_distribution<uint32_t> sizeDist(FLAGS_min_object_size,
+                                                     FLAGS_max_object_size);
+    std::uniform_int_distribution<uint32_t> opDist(0, 99);
+    uint64_t localInserts = 0;
+    uint64_t localOver = 0;
+    size_t localMax = 0;
+    for (uint64_t i = 0; i < FLAGS_ops_per_thread; i++) {
+      const auto key = folly::to<std::string>("key_", keyDist(gen));
+      if (opDist(gen) < FLAGS_find_pct) {
+        folly::doNotOptimizeAway(objcache->find<std::string>(key));
+        continue;
+      }
+      auto str = std::make_unique<std::string>(sizeDist(gen), 'a');
+      const auto size = sizeof(std::string) + str->capacity();
+      objcache->insertOrReplace(key, std::move(str), size);
+      const auto total = objcache->getTotalObjectSize();
+      localInserts++;
+      localOver += total > limit;
+      localMax = std::max(localMax, total);
+    }
+    inserts += localInserts;
+    insertsOver += localOver;
+    auto cur = maxTotal.load();
+    while (localMax > cur && !maxTotal.compare_exchange_weak(cur, localMax)) {
+    }
+  };
+
+  const auto begin = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t < FLAGS_num_threads; t++) {
+    threads.emplace_back(worker, t);
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  const auto secs = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - begin)
+                        .count();
+
+  Result result;
+  result.opsPerSec = FLAGS_num_threads * FLAGS_ops_per_thread / secs;
+  const size_t max = maxTotal.load();
+  result.maxOverPct = max > limit ? 100.0 * (max - limit) / limit : 0.0;
+  result.insertsOverPct =
+      100.0 * insertsOver.load() / std::max<uint64_t>(inserts.load(), 1);
+  objcache->getObjectCacheCounters(
+      [&](folly::StringPiece name, double value) {
+        if (name == "objcache.evictions.size_limit") {
+          result.sizeEvictions = value;
+        }
+      });
+  return result;
+}
+} // namespace
+} // namespace objcache2
+} // namespace cachelib
+} // namespace facebook
+
+int main(int argc, char** argv) {
+  using namespace facebook::cachelib::objcache2;
+  folly::init(&argc, &argv);
+
+  std::cout << folly::sformat("{:<16} {:>12} {:>10} {:>13} {:>15}", "mode",
+                              "ops/s", "max over", "inserts over",
+                              "size evictions")
+            << std::endl;
+  for (bool onInsert : {false, true}) {
+    const auto r = run(onInsert);
+    std::cout << folly::sformat(
+                     "{:<16} {:>12.0f} {:>9.2f}% {:>12.2f}% {:>15.0f}",
+                     onInsert ? "sizeLimitInsert" : "sizeController",
+                     r.opsPerSec, r.maxOverPct, r.insertsOverPct,
+                     r.sizeEvictions)
+              << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures how fast the replay generators can hand out requests, without a
+// cache behind them. Every benchmark iteration replays the whole synthetic
+// trace once: a generator is created, --num_threads stressor threads drain it
+// with getReq()/notifyResult() until EndOfTrace, and the generator is torn
+// down again.
+
+#include <folly/Benchmark.h>
+#include <folly/FileUtil.h>
+#include <folly/Format.h>
+#include <folly/Random.h>
+#include <folly/init/Init.h>
+#include <folly/logging/xlog.h>
+#include <folly/testing/TestUtil.h>
+#include <gflags/gflags.h>
+
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cachelib/cachebench/workload/KVReplayGenerator.h"
+#include "cachelib/cachebench/workload/OGBinaryReplayGenerator.h"
+
+DEFINE_uint64(num_records, 5 * 1000 * 1000, "requests in the synthetic trace");
+DEFINE_uint32(num_threads, 4, "stressor threads draining the generator");
+DEFINE_uint32(amp_factor, 1, "replay generator amplification factor");
+
+namespace facebook {
+namespace cachelib {
+namespace cachebench {
+namespace {
+folly::test::TemporaryDirectory& tmpDir() {
+  static folly::test::TemporaryDirectory dir{"replay_generator_bench"};
+  return dir;
+}
+
+std::string kvTracePath() { return (tmpDir().path() / "kv.csv").string(); }
+std::string binaryTracePath() {
+  return (tmpDir().path() / "trace.bin").string();
+}
+
+void writeTraces() {
+  std::string csv = "op_time,key,key_size,op,op_count,size,cache_hits,ttl\n";
+  std::vector<OracleGeneralBinRecord> records(FLAGS_num_records);
+  for (size_t i = 0; i < records.size(); i++) {
+    const auto objId = folly::Random::rand64(1000 * 1000);
+    const auto objSize = 1 + folly::Random::rand32(100 * 1000);
+    csv += folly::sformat("{},{},20,GET,1,{},0,0\n", i / 1000, objId, objSize);
+
+    records[i].clockTime = static_cast<uint32_t>(i / 1000);
+    records[i].objId = objId;
+    records[i].objSize = objSize;
+    records[i].nextAccessVtime = -1;
+  }
+  XCHECK(folly::writeFile(csv, kvTracePath().c_str()));
+  XCHECK(folly::writeFile(
+      std::string(reinterpret_cast<const char*>(records.data()),
+                  records.size() * sizeof(OracleGeneralBinRecord)),
+      binaryTracePath().c_str()));
+}
+
+StressorConfig makeConfig(const std::string& path) {
+  StressorConfig config;
+  config.traceFileName = path;
+  config.numThreads = FLAGS_num_threads;
+  config.replayGeneratorConfig.ampFactor = FLAGS_amp_factor;
+  return config;
+}
+
+template <typename Generator>
+void drain(const StressorConfig& config) {
+  auto generator = std::make_unique<Generator>(config);
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t < config.numThreads; t++) {
+    threads.emplace_back([&generator]() {
+      std::mt19937_64 gen;
+      uint64_t sum = 0;
+      while (true) {
+        try {
+          const auto& req = generator->getReq(0, gen);
+          sum += *req.sizeBegin;
+          generator->notifyResult(*req.requestId, OpResultType::kGetMiss);
+        } catch (const EndOfTrace&) {
+          break;
+        }
+      }
+      generator->markFinish();
+      folly::doNotOptimizeAway(sum);
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  generator->markShutdown();
+}
+} // namespace
+} // namespace cachebench
+} // namespace cachelib
+} // namespace facebook
+
+using namespace facebook::cachelib::cachebench;
+
+BENCHMARK(KVReplayGenerator) {
+  drain<KVReplayGenerator>(makeConfig(kvTracePath()));
+}
+
+BENCHMARK(OGBinaryReplayGenerator) {
+  auto config = makeConfig(binaryTracePath());
+  config.zstdTrace = true;
+  config.compressed = false;
+  drain<OGBinaryReplayGenerator>(config);
+}
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  writeTraces();
+  folly::runBenchmarks();
+  return 0;
+}
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the lookup throughput of the RocksDB secondary cache adaptor the
+// way RocksDB drives it. Single Gets look a block up and wait for it right
+// away. MultiGet looks up a batch of blocks without waiting and then waits
+// for the whole batch through WaitAll(). The cache holds many more blocks
+// than its DRAM part, so most lookups read from flash. Prints the blocks
+// looked up per second for each mode.
+
+#include <folly/Format.h>
+#include <folly/Random.h>
+#include <folly/init/Init.h>
+#include <gflags/gflags.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cachelib/adaptor/rocks_secondary_cache/CachelibWrapper.h"
+
+DEFINE_uint64(num_blocks, 200000, "number of blocks inserted");
+DEFINE_uint32(block_size, 4000, "bytes of every block");
+DEFINE_uint64(volatile_size_mb, 64, "size of the DRAM part of the cache");
+DEFINE_uint64(flash_size_mb, 2048, "size of the cache file");
+DEFINE_string(file, "/tmp/rocks_secondary_cache_bench", "cache file");
+DEFINE_uint32(batch_size, 32, "blocks in every MultiGet");
+DEFINE_uint32(num_threads, 8, "threads looking up blocks");
+DEFINE_uint32(duration_ms, 5000, "time every mode runs");
+
+namespace facebook {
+namespace rocks_secondary_cache {
+namespace {
+struct Block {
+  std::string data;
+};
+
+struct BenchContext : public rocksdb::Cache::CreateContext {};
+
+size_t sizeCb(void* obj) { return static_cast<Block*>(obj)->data.size(); }
+
+rocksdb::Status saveToCb(void* obj, size_t offset, size_t size, char* out) {
+  std::memcpy(out, static_cast<Block*>(obj)->data.data() + offset, size);
+  return rocksdb::Status::OK();
+}
+
+void deleteCb(void* obj, rocksdb::MemoryAllocator*) {
+  delete static_cast<Block*>(obj);
+}
+
+rocksdb::Status createCb(const rocksdb::Slice& data,
+                         rocksdb::CompressionType,
+                         rocksdb::CacheTier,
+                         rocksdb::Cache::CreateContext*,
+                         rocksdb::MemoryAllocator*,
+                         void** out,
+                         size_t* charge) {
+  *out = new Block{data.ToString()};
+  *charge = data.size();
+  return rocksdb::Status::OK();
+}
+
+const rocksdb::Cache::CacheItemHelper kHelperNoSecondary{
+    rocksdb::CacheEntryRole::kMisc, deleteCb};
+const rocksdb::Cache::CacheItemHelper kHelper{rocksdb::CacheEntryRole::kMisc,
+                                              deleteCb,
+                                              sizeCb,
+                                              saveToCb,
+                                              createCb,
+                                              &kHelperNoSecondary};
+
+std::unique_ptr<rocksdb::SecondaryCacheResultHandle> lookup(
+    rocksdb::SecondaryCache& cache, BenchContext& context, bool wait) {
+  const auto key =
+      folly::sformat("block_{}", folly::Random::rand64(FLAGS_num_blocks));
+  bool isInSecCache = false;
+  return cache.Lookup(key, &kHelper, &context, wait,
+                      /*advise_erase=*/false,
+#if ROCKSDB_MAJOR > 8 || (ROCKSDB_MAJOR == 8 && ROCKSDB_MINOR > 9)
+                      /*stats=*/nullptr,
+#endif
+                      isInSecCache);
+}
+
+// looks up blocks one by one, waiting for each
+uint64_t singleGets(rocksdb::SecondaryCache& cache, BenchContext& context) {
+  auto handle = lookup(cache, context, /*wait=*/true);
+  if (handle) {
+    delete static_cast<Block*>(handle->Value());
+  }
+  return 1;
+}
+
+// looks up a batch of blocks and waits for all of them together
+uint64_t multiGet(rocksdb::SecondaryCache& cache, BenchContext& context) {
+  std::vector<std::unique_ptr<rocksdb::SecondaryCacheResultHandle>> handles;
+  std::vector<rocksdb::SecondaryCacheResultHandle*> pending;
+  for (uint32_t i = 0; i < FLAGS_batch_size; i++) {
+    auto handle = lookup(cache, context, /*wait=*/false);
+    if (handle) {
+      pending.push_back(handle.get());
+      handles.push_back(std::move(handle));
+    }
+  }
+  cache.WaitAll(pending);
+  for (auto& handle : handles) {
+    delete static_cast<Block*>(handle->Value());
+  }
+  return FLAGS_batch_size;
+}
+
+template <typename Fn>
+double run(rocksdb::SecondaryCache& cache, Fn&& fn) {
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> total{0};
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t < FLAGS_num_threads; t++) {
+    threads.emplace_back([&] {
+      BenchContext context;
+      uint64_t done = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        done += fn(cache, context);
+      }
+      total += done;
+    });
+  }
+  /* sleep override */
+  std::this_thread::sleep_for(std::chrono::milliseconds(FLAGS_duration_ms));
+  stop = true;
+  for (auto& t : threads) {
+    t.join();
+  }
+  return total * 1000.0 / FLAGS_duration_ms;
+}
+
+void runAll() {
+  RocksCachelibOptions opts;
+  opts.cacheName = "RocksSecondaryCacheBench";
+  opts.fileName = FLAGS_file;
+  opts.size = FLAGS_flash_size_mb << 20;
+  opts.volatileSize = FLAGS_volatile_size_mb << 20;
+  auto cache = NewRocksCachelibWrapper(opts);
+
+  for (uint64_t i = 0; i < FLAGS_num_blocks; i++) {
+    Block block{std::string(FLAGS_block_size, static_cast<char>(i))};
+    auto status = cache->Insert(folly::sformat("block_{}", i), &block,
+                                &kHelper, /*force_insert=*/false);
+    if (!status.ok()) {
+      throw std::runtime_error(status.ToString());
+    }
+  }
+
+  std::cout << folly::sformat("{:<24} {:>14}", "mode", "blocks/s")
+            << std::endl;
+  std::cout << folly::sformat("{:<24} {:>14.0f}", "single gets",
+                              run(*cache, singleGets))
+            << std::endl;
+  std::cout << folly::sformat(
+                   "{:<24} {:>14.0f}",
+                   folly::sformat("multiget of {}", FLAGS_batch_size),
+                   run(*cache, multiGet))
+            << std::endl;
+  static_cast<RocksCachelibWrapper*>(cache.get())->Close();
+}
+} // namespace
+} // namespace rocks_secondary_cache
+} // namespace facebook
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  facebook::rocks_secondary_cache::runAll();
+  return 0;
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compares the throughput of copying values out of a shm cache by key through
+// the owner's find() and through the lock free lookups of a
+// ReadOnlySharedCacheView. Reader threads look up random keys of a filled
+// cache for a while, optionally while writer threads replace random items.
+// The view maps the cache a second time in the same process, which costs the
+// same as mapping it from a sidecar process. Prints lookups per second and
+// the share of view lookups that gave up on a bucket the writers kept
+// changing.
+
+#include <folly/Format.h>
+#include <folly/Random.h>
+#include <folly/init/Init.h>
+#include <gflags/gflags.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "cachelib/allocator/CacheAllocator.h"
+#include "cachelib/allocator/ReadOnlySharedCacheView.h"
+#include "cachelib/common/Utils.h"
+
+DEFINE_uint64(cache_size_mb, 1024, "size of the cache");
+DEFINE_uint64(num_keys, 1000000, "number of items in the cache");
+DEFINE_uint32(value_size, 256, "bytes of every value");
+DEFINE_uint32(num_readers, 8, "threads looking up keys");
+DEFINE_uint32(num_writers, 2, "threads replacing items in the second run");
+DEFINE_uint32(duration_ms, 2000, "time every run takes");
+DEFINE_string(cache_dir, "/tmp/shared_cache_view_bench", "cache dir");
+
+namespace facebook {
+namespace cachelib {
+namespace {
+struct Result {
+  double lookupsPerSec{0};
+  double conflictPct{0};
+};
+
+std::string makeKey(uint64_t i) { return folly::sformat("key_{}", i); }
+
+void replace(LruAllocator& cache, PoolId pid, uint64_t i) {
+  auto handle = cache.allocate(pid, makeKey(i), FLAGS_value_size);
+  if (handle) {
+    std::memset(handle->getMemory(), static_cast<int>(i), FLAGS_value_size);
+    cache.insertOrReplace(handle);
+  }
+}
+
+// runs the readers with the given lookup for duration_ms while num_writers
+// threads replace items
+template <typename LookupFn>
+Result run(LruAllocator& cache,
+           PoolId pid,
+           uint32_t numWriters,
+           LookupFn&& lookup) {
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> lookups{0};
+  std::atomic<uint64_t> conflicts{0};
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t < FLAGS_num_readers; t++) {
+    threads.emplace_back([&] {
+      std::string value;
+      uint64_t done = 0;
+      uint64_t conflicted = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        if (!lookup(makeKey(folly::Random::rand64(FLAGS_num_keys)), value)) {
+          ++conflicted;
+        }
+        ++done;
+      }
+      lookups += done;
+      conflicts += conflicted;
+    });
+  }
+  for (uint32_t t = 0; t < numWriters; t++) {
+    threads.emplace_back([&] {
+      while (!stop.load(std::memory_order_relaxed)) {
+        replace(cache, pid, folly::Random::rand64(FLAGS_num_keys));
+      }
+    });
+  }
+
+  /* sleep override */
+  std::this_thread::sleep_for(std::chrono::milliseconds(FLAGS_duration_ms));
+  stop = true;
+  for (auto& t : threads) {
+    t.join();
+  }
+  return {lookups * 1000.0 / FLAGS_duration_ms,
+          lookups ? conflicts * 100.0 / lookups : 0};
+}
+
+void printResult(folly::StringPiece name, const Result& r) {
+  std::cout << folly::sformat("{:<24} {:>16.0f} {:>12.3f}", name,
+                              r.lookupsPerSec, r.conflictPct)
+            << std::endl;
+}
+
+void runAll() {
+  LruAllocator::Config config;
+  config.setCacheSize(FLAGS_cache_size_mb * 1024 * 1024)
+      .enableCachePersistence(FLAGS_cache_dir)
+      .enableSharedCacheViewLookups()
+      .setAccessConfig(FLAGS_num_keys)
+      .validate();
+  LruAllocator cache(LruAllocator::SharedMemNew, config);
+  const auto pid =
+      cache.addPool("default", cache.getCacheMemoryStats().ramCacheSize);
+  for (uint64_t i = 0; i < FLAGS_num_keys; i++) {
+    replace(cache, pid, i);
+  }
+
+  ReadOnlySharedCacheView view(config.cacheDir, config.usePosixShm);
+  view.attachAccessContainer(config.accessConfig);
+
+  auto ownerFind = [&](const std::string& key, std::string& value) {
+    if (auto handle = cache.find(key)) {
+      value.assign(reinterpret_cast<const char*>(handle->getMemory()),
+                   handle->getSize());
+    }
+    return true;
+  };
+  auto viewFind = [&](const std::string& key, std::string& value) {
+    return view.find<LruAllocator>(key, value) !=
+           ReadOnlySharedCacheView::LookupStatus::kConflict;
+  };
+
+  std::cout << folly::sformat("{:<24} {:>16} {:>12}", "lookup", "lookups/s",
+                              "conflict %")
+            << std::endl;
+  printResult("owner find", run(cache, pid, 0, ownerFind));
+  printResult("view find", run(cache, pid, 0, viewFind));
+  printResult("owner find + writers",
+              run(cache, pid, FLAGS_num_writers, ownerFind));
+  printResult("view find + writers",
+              run(cache, pid, FLAGS_num_writers, viewFind));
+  cache.shutDown();
+}
+} // namespace
+} // namespace cachelib
+} // namespace facebook
+
+int main(int argc, char** argv) {
+  using namespace facebook::cachelib;
+  folly::init(&argc, &argv);
+  util::makeDir(FLAGS_cache_dir);
+  runAll();
+  LruAllocator::ShmManager::cleanup(FLAGS_cache_dir, false);
+  util::removePath(FLAGS_cache_dir);
+  return 0;
+}
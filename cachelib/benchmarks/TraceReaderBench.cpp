@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures how fast oracleGeneral binary traces can be read, independent of
+// any cache or stressor. Every benchmark iteration reads the whole trace once.
+//
+// The synthetic traces are written to a temporary directory at startup:
+//  - raw:          uncompressed records
+//  - single frame: one zstd frame, as produced by `zstd` without -B
+//  - multi frame:  one zstd frame per --frame_records records, as produced by
+//                  pzstd or `zstd -B`
+
+#include <folly/Benchmark.h>
+#include <folly/FileUtil.h>
+#include <folly/Random.h>
+#include <folly/init/Init.h>
+#include <folly/logging/xlog.h>
+#include <folly/testing/TestUtil.h>
+#include <gflags/gflags.h>
+#include <zstd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "cachelib/cachebench/workload/MmapTraceReader.h"
+#include "cachelib/cachebench/workload/ZstdReader.h"
+
+DEFINE_uint64(num_records, 20 * 1000 * 1000, "records in the synthetic trace");
+DEFINE_uint64(frame_records,
+              1000 * 1000,
+              "records per zstd frame in the multi frame trace");
+DEFINE_uint32(num_threads, 4, "decompression threads for multi frame trace");
+
+namespace facebook {
+namespace cachelib {
+namespace cachebench {
+namespace {
+folly::test::TemporaryDirectory& tmpDir() {
+  static folly::test::TemporaryDirectory dir{"trace_reader_bench"};
+  return dir;
+}
+
+std::string rawPath() { return (tmpDir().path() / "raw.bin").string(); }
+std::string singleFramePath() {
+  return (tmpDir().path() / "single.bin.zst").string();
+}
+std::string multiFramePath() {
+  return (tmpDir().path() / "multi.bin.zst").string();
+}
+
+std::string compress(const char* data, size_t len) {
+  std::string out(ZSTD_compressBound(len), '\0');
+  size_t ret = ZSTD_compress(out.data(), out.size(), data, len, 3);
+  XCHECK(!ZSTD_isError(ret)) << ZSTD_getErrorName(ret);
+  out.resize(ret);
+  return out;
+}
+
+void writeTraces() {
+  std::vector<OracleGeneralBinRecord> records(FLAGS_num_records);
+  for (size_t i = 0; i < records.size(); i++) {
+    records[i].clockTime = static_cast<uint32_t>(i / 1000);
+    records[i].objId = folly::Random::rand64(1000 * 1000);
+    records[i].objSize = 1 + folly::Random::rand32(100 * 1000);
+    records[i].nextAccessVtime = -1;
+  }
+  const char* data = reinterpret_cast<const char*>(records.data());
+  const size_t len = records.size() * sizeof(OracleGeneralBinRecord);
+
+  XCHECK(folly::writeFile(std::string(data, len), rawPath().c_str()));
+  XCHECK(folly::writeFile(compress(data, len), singleFramePath().c_str()));
+
+  std::string multi;
+  const size_t frameLen =
+      FLAGS_frame_records * sizeof(OracleGeneralBinRecord);
+  for (size_t off = 0; off < len; off += frameLen) {
+    multi += compress(data + off, std::min(frameLen, len - off));
+  }
+  XCHECK(folly::writeFile(multi, multiFramePath().c_str()));
+}
+
+void readWithZstdReader(const std::string& path, bool compressed) {
+  ZstdReader reader;
+  reader.open(path, compressed);
+  OracleGeneralBinRequest req;
+  uint64_t sum = 0;
+  while (reader.read_one_req(&req)) {
+    sum += req.objSize;
+  }
+  folly::doNotOptimizeAway(sum);
+}
+
+void readWithMmapReader(const std::string& path,
+                        bool compressed,
+                        uint32_t numThreads) {
+  MmapTraceReader reader;
+  reader.open(path, compressed, numThreads);
+  uint64_t sum = 0;
+  while (auto rec = reader.next()) {
+    sum += rec->objSize;
+  }
+  folly::doNotOptimizeAway(sum);
+}
+} // namespace
+} // namespace cachebench
+} // namespace cachelib
+} // namespace facebook
+
+using namespace facebook::cachelib::cachebench;
+
+BENCHMARK(ZstdReaderRaw) { readWithZstdReader(rawPath(), false); }
+
+BENCHMARK_RELATIVE(MmapReaderRaw) { readWithMmapReader(rawPath(), false, 1); }
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(ZstdReaderSingleFrame) {
+  readWithZstdReader(singleFramePath(), true);
+}
+
+BENCHMARK_RELATIVE(MmapReaderSingleFrame) {
+  readWithMmapReader(singleFramePath(), true, 1);
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(ZstdReaderMultiFrame) { readWithZstdReader(multiFramePath(), true); }
+
+BENCHMARK_RELATIVE(MmapReaderMultiFrame1Thread) {
+  readWithMmapReader(multiFramePath(), true, 1);
+}
+
+BENCHMARK_RELATIVE(MmapReaderMultiFrameNThreads) {
+  readWithMmapReader(multiFramePath(), true, FLAGS_num_threads);
+}
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  writeTraces();
+  folly::runBenchmarks();
+  return 0;
+}
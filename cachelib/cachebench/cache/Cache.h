@@ -17,11 +17,13 @@
 #pragma once
 
 #include <folly/Format.h>
+#include <folly/String.h>
 #include <folly/hash/Hash.h>
 #include <folly/json/DynamicConverter.h>
 #include <folly/json/json.h>
 #include <folly/logging/xlog.h>
 #include <gflags/gflags.h>
+#include <sys/prctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
@@ -313,6 +315,10 @@ class Cache {
   // returns true if touching value is enabled.
   bool touchValueEnabled() const { return touchValue_; }
 
+  // returns true if the cache only simulates items: their values are never
+  // initialized, written, read or copied.
+  bool simulationEnabled() const { return config_.simulate; }
+
   // return true if the key was previously detected to be inconsistent. This
   // is useful only when consistency checking is enabled by calling
   // enableConsistencyCheck()
@@ -394,6 +400,23 @@ class Cache {
     deltaStats_[requestId] = statsStr;
   }
 
+  bool exactMrcEnabled() const { return config_.enableExactMrc; }
+
+  // Compare the footprint and Shards curves of every class against the exact
+  // ones and record their errors at requestId. The footprint curve is
+  // compared against the exact curve of the same window, Shards against the
+  // exact curve of the whole run.
+  void recordMrcErrors(uint64_t requestId);
+
+  // sink for the stats time series, or nullptr if statsSeriesFile is not set
+  StatsSeriesWriter* getStatsSeries() const {
+    return allocatorConfig_.statsSeries.get();
+  }
+
+  // Record the hits, evictions, tail hits, slabs, eviction age and items of
+  // every class into the stats series.
+  void recordClassSeries(uint64_t requestId);
+
   std::map<std::string, std::map<ClassId, double>> getPoolDeltaStats(
       PoolId pid) {
     return cache_->getPoolDeltaStats(pid);
@@ -567,6 +590,8 @@ class Cache {
 
   std::unordered_map<uint64_t, std::string> deltaStats_;
 
+  std::map<uint64_t, MrcErrors> mrcErrors_;
+
 
 };
 
@@ -681,7 +706,7 @@ Cache<Allocator>::Cache(const CacheConfig& config,
                         std::string cacheDir,
                         bool touchValue)
     : config_(config),
-      touchValue_(touchValue),
+      touchValue_(touchValue && !config.simulate),
       nandBytesBegin_{fetchNandWrites()},
       itemRecords_(config_.enableItemDestructorCheck) {
   constexpr size_t MB = 1024ULL * 1024ULL;
@@ -701,6 +726,11 @@ Cache<Allocator>::Cache(const CacheConfig& config,
     allocatorConfig_.enableFootPrintMrc = true;
     allocatorConfig_.footprintBufferSize = config_.footprintBufferSize;
   }
+  allocatorConfig_.enableExactMrc = config_.enableExactMrc;
+  if (!config_.statsSeriesFile.empty()) {
+    allocatorConfig_.statsSeries =
+        std::make_shared<StatsSeriesWriter>(config_.statsSeriesFile);
+  }
   XLOGF(INFO, "Using rebalance interval: {}", config_.poolRebalanceIntervalSec);
   auto rebalanceStrategy = config_.getRebalanceStrategy();
   if (rebalanceStrategy) {
@@ -720,11 +750,41 @@ Cache<Allocator>::Cache(const CacheConfig& config,
 
   if (config_.moveOnSlabRelease) {
     XLOGF(INFO, "Enabling moving on slab release");
-    allocatorConfig_.enableMovingOnSlabRelease([](Item& oldItem, Item& newItem,
-                                                  Item* parentPtr) {
-      XDCHECK(oldItem.isChainedItem() == (parentPtr != nullptr));
-      std::memcpy(newItem.getMemory(), oldItem.getMemory(), oldItem.getSize());
-    });
+    allocatorConfig_.enableMovingOnSlabRelease(
+        [simulate = config_.simulate](Item& oldItem, Item& newItem,
+                                      Item* parentPtr) {
+          XDCHECK(oldItem.isChainedItem() == (parentPtr != nullptr));
+          if (!simulate) {
+            std::memcpy(newItem.getMemory(), oldItem.getMemory(),
+                        oldItem.getSize());
+          }
+        });
+  }
+
+  if (config_.simulate) {
+    if (config_.enableItemDestructorCheck) {
+      throw std::invalid_argument(
+          "Item destructor check needs item values, which are not kept when "
+          "simulating");
+    }
+    // Slab memory is mmapped lazily, so the pages backing values that are
+    // never written are never faulted in. Keep THP from rounding every item
+    // header fault up to a 2MB page.
+    //
+    // The allocator does not expose its slab mappings, so this turns THP off
+    // for the whole process rather than for this cache's memory: every cache,
+    // the hash tables and the stressor's own heap lose huge pages too, and the
+    // setting stays in place after this cache is destroyed. That is fine for
+    // a simulation run, which is the only thing the process does, but a
+    // simulated cache must not share a process with one that is benchmarked
+    // for throughput.
+    if (prctl(PR_SET_THP_DISABLE, 1, 0, 0, 0) != 0) {
+      XLOGF(WARN, "Failed to disable transparent huge pages: {}",
+            folly::errnoStr(errno));
+    } else {
+      XLOG(INFO) << "Simulate mode: transparent huge pages are disabled for "
+                    "the whole process";
+    }
   }
 
   if (config_.allocSizes.empty()) {
@@ -879,6 +939,12 @@ Cache<Allocator>::Cache(const CacheConfig& config,
                                     config_.navySmallItemMaxSize)
           .setBucketSize(config_.navyBigHashBucketSize)
           .setBucketBfSize(config_.navyBloomFilterPerBucketSize);
+      if (config_.navySmallItemAdaptiveBucketSize > 0) {
+        nvmConfig.navyConfig.bigHash().setAdaptiveSmallItemMaxSize(
+            config_.navySmallItemAdaptiveBucketSize,
+            config_.navySmallItemAdaptiveIntervalSecs,
+            config_.navySmallItemAdaptiveHysteresisPct);
+      }
     }
 
     nvmConfig.navyConfig.setMaxParcelMemoryMB(config_.navyParcelMemoryMB);
@@ -905,6 +971,12 @@ Cache<Allocator>::Cache(const CacheConfig& config,
 
     nvmConfig.truncateItemToOriginalAllocSizeInNvm =
         config_.truncateItemToOriginalAllocSizeInNvm;
+    nvmConfig.writebackBatchBytes = config_.nvmWritebackBatchBytes;
+    nvmConfig.writebackBatchMaxDelay =
+        std::chrono::microseconds{config_.nvmWritebackBatchMaxDelayUs};
+    nvmConfig.promotionMinFlashHits = config_.nvmPromotionMinFlashHits;
+    nvmConfig.promotionMinItemSize = config_.nvmPromotionMinItemSize;
+    nvmConfig.promoteCold = config_.nvmPromoteCold;
 
     nvmConfig.navyConfig.setDeviceMaxWriteSize(config_.deviceMaxWriteSize);
 
@@ -930,6 +1002,15 @@ Cache<Allocator>::Cache(const CacheConfig& config,
       nvmAdmissionPolicy_ = std::make_shared<RetentionAP<Allocator>>(
           config_.nvmAdmissionRetentionTimeThreshold);
       allocatorConfig_.setNvmCacheAdmissionPolicy(nvmAdmissionPolicy_);
+    } else if (config_.nvmAdmissionFlashRetentionSecs > 0) {
+      typename EvictionAgeAP<Allocator>::Config apConfig;
+      apConfig.flashRetention =
+          std::chrono::seconds{config_.nvmAdmissionFlashRetentionSecs};
+      apConfig.writeBudgetBytesPerSec =
+          uint64_t{config_.nvmAdmissionWriteBudgetMBPerSec} * MB;
+      nvmAdmissionPolicy_ =
+          std::make_shared<EvictionAgeAP<Allocator>>(apConfig);
+      allocatorConfig_.setNvmCacheAdmissionPolicy(nvmAdmissionPolicy_);
     }
 
     allocatorConfig_.setNvmAdmissionMinTTL(config_.memoryOnlyTTL);
@@ -1042,6 +1123,11 @@ template <typename Allocator>
 void Cache<Allocator>::enableConsistencyCheck(
     const std::vector<std::string>& keys) {
   XDCHECK(valueTracker_ == nullptr);
+  if (config_.simulate) {
+    throw std::invalid_argument(
+        "Consistency check needs item values, which are not kept when "
+        "simulating");
+  }
   valueTracker_ =
       std::make_unique<ValueTracker>(ValueTracker::wrapStrings(keys));
   for (const std::string& key : keys) {
@@ -1078,7 +1164,7 @@ template <typename Allocator>
 typename Cache<Allocator>::WriteHandle Cache<Allocator>::allocateChainedItem(
     const ReadHandle& parent, size_t size) {
   auto handle = cache_->allocateChainedItem(parent, CacheValue::getSize(size));
-  if (handle) {
+  if (handle && !config_.simulate) {
     CacheValue::initialize(handle->getMemory());
   }
   return handle;
@@ -1112,7 +1198,7 @@ typename Cache<Allocator>::WriteHandle Cache<Allocator>::allocate(
   WriteHandle handle;
   try {
     handle = cache_->allocate(pid, key, CacheValue::getSize(size), ttlSecs);
-    if (handle) {
+    if (handle && !config_.simulate) {
       CacheValue::initialize(handle->getMemory());
     }
   } catch (const std::invalid_argument& e) {
@@ -1336,6 +1422,98 @@ double Cache<Allocator>::getNvmBytesWritten() const {
   return 0;
 }
 
+template <typename Allocator>
+void Cache<Allocator>::recordClassSeries(uint64_t requestId) {
+  auto* series = getStatsSeries();
+  if (!series) {
+    return;
+  }
+  for (auto pid : pools_) {
+    const auto poolStats = cache_->getPoolStats(pid);
+    for (const auto& [cid, stats] : poolStats.cacheStats) {
+      StatsSeriesRecord record;
+      record.requestId = requestId;
+      record.kind = StatsSeriesRecord::kClassStats;
+      record.poolId = pid;
+      record.classId = cid;
+      record.values = {
+          static_cast<double>(stats.numHits),
+          static_cast<double>(stats.numEvictions()),
+          static_cast<double>(stats.containerStat.numTailAccesses),
+          static_cast<double>(poolStats.numSlabsForClass(cid)),
+          static_cast<double>(poolStats.evictionAgeForClass(cid)),
+          static_cast<double>(stats.numItems())};
+      series->append(record);
+    }
+  }
+}
+
+template <typename Allocator>
+void Cache<Allocator>::recordMrcErrors(uint64_t requestId) {
+  std::map<std::string, double> weightedSum;
+  std::map<std::string, uint64_t> weights;
+  auto& errors = mrcErrors_[requestId];
+  auto record = [&](const std::string& estimator, ClassId cid, double error,
+                    uint64_t accesses) {
+    errors.perClass[estimator][cid] = error;
+    weightedSum[estimator] += error * accesses;
+    weights[estimator] += accesses;
+  };
+
+  for (auto pid : pools_) {
+    const auto* exact = cache_->getExactMrcForPool(pid);
+    if (!exact) {
+      continue;
+    }
+    const auto& pool = cache_->getPool(pid);
+    const size_t maxSlabs = pool.getPoolSize() / Slab::kSize;
+
+    std::map<ClassId, std::tuple<std::map<size_t, double>,
+                                 std::map<size_t, double>, size_t>>
+        footprint;
+    const auto* footprintMrc = cache_->getFootprintMrcForPool(pid);
+    if (footprintMrc && exact->getWindowSize() > 0) {
+      std::map<ClassId, size_t> allocsPerSlab;
+      for (unsigned int i = 0; i < pool.getNumClassId(); i++) {
+        const auto cid = static_cast<ClassId>(i);
+        allocsPerSlab[cid] = pool.getAllocationClass(cid).getAllocsPerSlab();
+      }
+      footprint = footprintMrc->queryMrc(allocsPerSlab, maxSlabs);
+    }
+
+    for (unsigned int i = 0; i < pool.getNumClassId(); i++) {
+      const auto cid = static_cast<ClassId>(i);
+      const auto curve = exact->mrc(cid, maxSlabs);
+      if (curve.empty()) {
+        continue;
+      }
+      if (auto it = footprint.find(cid); it != footprint.end()) {
+        const auto window = exact->windowMrc(cid, maxSlabs);
+        if (!window.empty()) {
+          const auto& points = std::get<0>(it->second);
+          record("footprint", cid,
+                 ExactMrc::meanAbsoluteError(
+                     window, std::map<uint64_t, double>(points.begin(),
+                                                        points.end())),
+                 exact->getWindowAccesses(cid));
+        }
+      }
+      const auto shards = cache_->queryShardsMrc(pid, cid);
+      if (!shards.empty()) {
+        record("shards", cid, ExactMrc::meanAbsoluteError(curve, shards),
+               exact->getAccesses(cid));
+      }
+    }
+  }
+
+  for (const auto& [estimator, sum] : weightedSum) {
+    const auto weight = weights[estimator];
+    errors.overall[estimator] = weight > 0 ? sum / weight : 0.0;
+    XLOGF(DBG, "mrc_error_logging: {{\"i\": {}, \"{}\": {}}}", requestId,
+          estimator, errors.overall[estimator]);
+  }
+}
+
 template <typename Allocator>
 Stats Cache<Allocator>::getStats() const {
   PoolStats aggregate = cache_->getPoolStats(pools_[0]);
@@ -1354,6 +1532,23 @@ Stats Cache<Allocator>::getStats() const {
   ret.missRatios = missRatios_;
   ret.mhCVs = mhCVs_;
   ret.deltaStats = deltaStats_;
+  ret.mrcErrors = mrcErrors_;
+  ret.perfSampleEvery = PerfCounters::getSampleEvery();
+  if (ret.perfSampleEvery > 0) {
+    ret.perfRegions = PerfCounters::getCounts();
+  }
+  for (auto pid : pools_) {
+    if (const auto* exact = cache_->getExactMrcForPool(pid)) {
+      const auto& pool = cache_->getPool(pid);
+      const size_t maxSlabs = pool.getPoolSize() / Slab::kSize;
+      for (unsigned int i = 0; i < pool.getNumClassId(); i++) {
+        auto curve = exact->mrc(static_cast<ClassId>(i), maxSlabs);
+        if (!curve.empty()) {
+          ret.exactMrcs[pid][static_cast<ClassId>(i)] = std::move(curve);
+        }
+      }
+    }
+  }
 
   ret.poolUsageFraction.push_back(usageFraction);
   for (size_t pid = 1; pid < pools_.size(); pid++) {
@@ -1428,6 +1623,7 @@ Stats Cache<Allocator>::getStats() const {
   ret.numNvmGets = cacheStats.numNvmGets;
   ret.numNvmGetMiss = cacheStats.numNvmGetMiss;
   ret.numNvmGetCoalesced = cacheStats.numNvmGetCoalesced;
+  ret.numNvmGetTransient = cacheStats.numNvmGetTransient;
   ret.numNvmRejectsByExpiry = cacheStats.numNvmRejectsByExpiry;
   ret.numNvmRejectsByClean = cacheStats.numNvmRejectsByClean;
 
@@ -19,6 +19,7 @@
 #include <gflags/gflags.h>
 
 #include "cachelib/common/PercentileStats.h"
+#include "cachelib/common/PerfCounters.h"
 
 DECLARE_bool(report_api_latency);
 DECLARE_string(report_ac_memory_usage_stats);
@@ -49,6 +50,42 @@ struct BackgroundPromotionStats {
   uint64_t nTraversals{0};
 };
 
+// Error of the online MRC estimators against the exact curves at one
+// rebalance, keyed by estimator ("footprint" or "shards").
+struct MrcErrors {
+  // mean absolute error of every class that has been accessed
+  std::map<std::string, std::map<ClassId, double>> perClass;
+  // mean of the class errors weighted by their accesses
+  std::map<std::string, double> overall;
+};
+
+// Latency of one op type over a window of an open loop replay, measured from
+// the intended send time in nanoseconds.
+struct LatencySummary {
+  uint64_t count{0};
+  uint64_t p50{0};
+  uint64_t p90{0};
+  uint64_t p99{0};
+  uint64_t p999{0};
+  uint64_t p9999{0};
+  uint64_t max{0};
+  double mean{0};
+
+  folly::dynamic toDynamic() const {
+    return folly::dynamic::object("count", count)("p50", p50)("p90", p90)(
+        "p99", p99)("p999", p999)("p9999", p9999)("max", max)("mean", mean);
+  }
+};
+
+// Latencies of one reporting interval of an open loop replay. requestId is
+// the progress of the first stressor thread, the same clock the rebalance
+// events are logged against.
+struct LatencyInterval {
+  uint64_t elapsedMs{0};
+  uint64_t requestId{0};
+  std::map<std::string, LatencySummary> ops;
+};
+
 struct Stats {
   BackgroundEvictionStats backgndEvicStats;
   BackgroundPromotionStats backgndPromoStats;
@@ -71,6 +108,7 @@ struct Stats {
   uint64_t numNvmGets{0};
   uint64_t numNvmGetMiss{0};
   uint64_t numNvmGetCoalesced{0};
+  uint64_t numNvmGetTransient{0};
 
   uint64_t numNvmItems{0};
   uint64_t numNvmPuts{0};
@@ -99,6 +137,24 @@ struct Stats {
   std::unordered_map<uint64_t, std::tuple<double, uint64_t, uint64_t>> missRatios;
   std::unordered_map<uint64_t, double> mhCVs;
 
+  // estimator errors by request id, and the final exact miss ratio curves of
+  // every class in slab units. Only set when enableExactMrc is.
+  std::map<uint64_t, MrcErrors> mrcErrors;
+  std::map<PoolId, std::map<ClassId, std::vector<double>>> exactMrcs;
+
+  // per op type over the whole run and per interval. Only set with
+  // openLoopReplay.
+  std::map<std::string, LatencySummary> openLoopLatency;
+  std::vector<LatencyInterval> openLoopIntervals;
+
+  // hardware counter sums of the sampled entries of every region, and the
+  // cycles and ops of the stressor threads. Only set with
+  // perfCountersEveryXOps.
+  uint64_t perfSampleEvery{0};
+  PerfCounters::RegionCounts perfRegions{};
+  uint64_t stressorCycles{0};
+  uint64_t stressorOps{0};
+
   util::PercentileStats::Estimates cacheAllocateLatencyNs;
   util::PercentileStats::Estimates cacheFindLatencyNs;
 
@@ -226,6 +282,64 @@ struct Stats {
     folly::dynamic deltaStatsJson = mapToDynamicObject(deltaStats);
     json["deltaStats"] = deltaStatsJson;
 
+    if (!exactMrcs.empty()) {
+      folly::dynamic mrcErrorsJson = folly::dynamic::object;
+      for (const auto& [reqId, errors] : mrcErrors) {
+        folly::dynamic entry = folly::dynamic::object;
+        for (const auto& [estimator, perClass] : errors.perClass) {
+          entry[estimator] = folly::dynamic::object(
+              "overall", errors.overall.at(estimator))(
+              "classes", mapToDynamicObject(perClass));
+        }
+        mrcErrorsJson[folly::to<std::string>(reqId)] = entry;
+      }
+      json["mrcErrors"] = mrcErrorsJson;
+
+      folly::dynamic exactMrcsJson = folly::dynamic::object;
+      for (const auto& [pid, curves] : exactMrcs) {
+        folly::dynamic poolJson = folly::dynamic::object;
+        for (const auto& [cid, curve] : curves) {
+          poolJson[folly::to<std::string>(cid)] = vecToDynamicArray(curve);
+        }
+        exactMrcsJson[folly::to<std::string>(pid)] = poolJson;
+      }
+      json["exactMrcs"] = exactMrcsJson;
+    }
+
+    if (!openLoopLatency.empty()) {
+      folly::dynamic latencyJson = folly::dynamic::object;
+      for (const auto& [op, summary] : openLoopLatency) {
+        latencyJson[op] = summary.toDynamic();
+      }
+      json["openLoopLatency"] = latencyJson;
+
+      folly::dynamic intervalsJson = folly::dynamic::array;
+      for (const auto& interval : openLoopIntervals) {
+        folly::dynamic ops = folly::dynamic::object;
+        for (const auto& [op, summary] : interval.ops) {
+          ops[op] = summary.toDynamic();
+        }
+        intervalsJson.push_back(folly::dynamic::object(
+            "elapsedMs", interval.elapsedMs)("request_id", interval.requestId)(
+            "ops", ops));
+      }
+      json["openLoopIntervals"] = intervalsJson;
+    }
+
+    if (perfSampleEvery > 0) {
+      folly::dynamic regionsJson = folly::dynamic::object;
+      for (size_t i = 0; i < perfRegions.size(); i++) {
+        const auto& c = perfRegions[i];
+        regionsJson[PerfCounters::regionName(static_cast<PerfRegion>(i))] =
+            folly::dynamic::object("samples", c.samples)("cycles", c.cycles)(
+                "instructions", c.instructions)("llcMisses", c.llcMisses)(
+                "dtlbMisses", c.dtlbMisses);
+      }
+      json["perfCounters"] = folly::dynamic::object(
+          "sampleEvery", perfSampleEvery)("stressorCycles", stressorCycles)(
+          "stressorOps", stressorOps)("regions", regionsJson);
+    }
+
     json["getMissRatio"] = invertPctFn(numCacheGetMiss, numCacheGets);
     json["poolUsableSize"] = poolUsableSize;  
     json["poolFragmentationSize"] = poolFragementationSize.at(0);
@@ -545,6 +659,53 @@ struct Stats {
       }
     }
 
+    if (!openLoopLatency.empty()) {
+      out << "== Open Loop Latency (from intended send time) ==" << std::endl;
+      for (const auto& [op, l] : openLoopLatency) {
+        out << folly::sformat(
+                   "{:10} count: {:,} p50: {:,} ns p99: {:,} ns p999: {:,} ns "
+                   "p9999: {:,} ns max: {:,} ns",
+                   op, l.count, l.p50, l.p99, l.p999, l.p9999, l.max)
+            << std::endl;
+      }
+    }
+
+    if (perfSampleEvery > 0) {
+      out << folly::sformat(
+                 "== Hardware Counters (every {}th entry, user space) ==",
+                 perfSampleEvery)
+          << std::endl;
+      if (stressorOps > 0) {
+        out << folly::sformat("Stressor cycles/op : {:.1f}",
+                              static_cast<double>(stressorCycles) /
+                                  stressorOps)
+            << std::endl;
+      }
+      for (size_t i = 0; i < perfRegions.size(); i++) {
+        const auto& c = perfRegions[i];
+        if (c.samples == 0) {
+          continue;
+        }
+        const auto region = static_cast<PerfRegion>(i);
+        const double samples = static_cast<double>(c.samples);
+        const double ipc =
+            c.cycles == 0 ? 0.0
+                          : static_cast<double>(c.instructions) / c.cycles;
+        out << folly::sformat(
+            "{:18} samples: {:,} cycles: {:.1f} IPC: {:.2f} LLC misses: "
+            "{:.3f} dTLB misses: {:.3f}",
+            PerfCounters::regionName(region), c.samples, c.cycles / samples,
+            ipc, c.llcMisses / samples, c.dtlbMisses / samples);
+        // the rebalancer runs on its own thread
+        if (!PerfCounters::isSampledAlways(region) && stressorCycles > 0) {
+          out << folly::sformat(
+              " share of stressor cycles: {:.2f}%",
+              100.0 * c.cycles * perfSampleEvery / stressorCycles);
+        }
+        out << std::endl;
+      }
+    }
+
     if (!backgroundEvictionClasses.empty() &&
         backgndEvicStats.nEvictedItems > 0) {
       out << "== Class Background Eviction Counters Map ==" << std::endl;
@@ -643,11 +804,14 @@ struct Stats {
                     numNvmPuts);
     const double cleanEvictPct = pctFn(numNvmCleanEvict, numNvmEvictions);
     const double getCoalescedPct = pctFn(numNvmGetCoalesced, numNvmGets);
-    out << folly::sformat("{:14}: {:15,}, {:10}: {:6.2f}%",
+    const double getTransientPct = pctFn(numNvmGetTransient, numNvmGets);
+    out << folly::sformat("{:14}: {:15,}, {:10}: {:6.2f}%, {:10}: {:6.2f}%",
                           "NVM Gets",
                           numNvmGets,
                           "Coalesced",
-                          getCoalescedPct)
+                          getCoalescedPct,
+                          "Transient",
+                          getTransientPct)
         << std::endl;
     out << folly::sformat(
                "{:14}: {:15,}, {:10}: {:6.2f}%, {:8}: {:6.2f}%, {:16}: "
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <folly/Conv.h>
+#include <folly/hash/Hash.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cachelib/cachebench/cache/Cache.h"
+
+namespace facebook {
+namespace cachelib {
+namespace cachebench {
+namespace test {
+namespace {
+struct ReplayResult {
+  std::vector<bool> hits;
+  uint64_t evictions{0};
+  uint64_t items{0};
+};
+
+// Replays a skewed get/set-on-miss workload with sizes spanning many
+// allocation classes.
+ReplayResult replay(bool simulate) {
+  CacheConfig config;
+  config.cacheSizeMB = 64;
+  config.lruRefreshSec = 0;
+  config.simulate = simulate;
+  Cache<LruAllocator> cache{config};
+
+  std::mt19937_64 gen{42};
+  std::uniform_real_distribution<double> dist;
+  constexpr size_t kNumKeys = 50 * 1000;
+  ReplayResult result;
+  for (size_t i = 0; i < 200 * 1000; i++) {
+    const auto id =
+        static_cast<uint64_t>(kNumKeys * std::pow(dist(gen), 3.0));
+    const auto key = folly::to<std::string>(id);
+    auto handle = cache.find(key);
+    result.hits.push_back(handle != nullptr);
+    if (!handle) {
+      const size_t size = 100 + folly::hash::twang_mix64(id) % (64 * 1024);
+      auto wh = cache.allocate(0, key, size);
+      if (wh) {
+        cache.insertOrReplace(wh);
+      }
+    }
+  }
+  auto stats = cache.getPoolStats(0);
+  result.evictions = stats.numEvictions();
+  result.items = stats.numItems();
+  return result;
+}
+} // namespace
+
+// Simulation must not change any caching decision.
+TEST(CacheSimulateTest, SameDecisionsAsNormalMode) {
+  auto normal = replay(false);
+  auto simulated = replay(true);
+  EXPECT_GT(normal.evictions, 0u);
+  EXPECT_EQ(normal.evictions, simulated.evictions);
+  EXPECT_EQ(normal.items, simulated.items);
+  EXPECT_EQ(normal.hits, simulated.hits);
+}
+
+TEST(CacheSimulateTest, RejectsValueChecks) {
+  CacheConfig config;
+  config.cacheSizeMB = 64;
+  config.simulate = true;
+  config.enableItemDestructorCheck = true;
+  EXPECT_THROW(Cache<LruAllocator>{config}, std::invalid_argument);
+
+  config.enableItemDestructorCheck = false;
+  Cache<LruAllocator> cache{config};
+  EXPECT_TRUE(cache.simulationEnabled());
+  EXPECT_FALSE(cache.touchValueEnabled());
+  EXPECT_THROW(cache.enableConsistencyCheck({"key"}), std::invalid_argument);
+}
+} // namespace test
+} // namespace cachebench
+} // namespace cachelib
+} // namespace facebook
@@ -14,15 +14,20 @@
  * limitations under the License.
  */
 
+#include <folly/String.h>
 #include <folly/io/async/EventBase.h>
 #include <folly/logging/LoggerDB.h>
 #include <gflags/gflags.h>
 
 #include <memory>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include "cachelib/cachebench/runner/Runner.h"
 #include "cachelib/cachebench/runner/Stressor.h"
+#include "cachelib/cachebench/runner/SweepRunner.h"
+#include "cachelib/cachebench/workload/PhasedGenerator.h"
 #include "cachelib/common/Utils.h"
 
 #ifdef CACHEBENCH_FB_ENV
@@ -63,8 +68,26 @@ DEFINE_bool(disable_progress_tracker, false, "Disable the progress tracker in ca
 DEFINE_string(dump_tx_file,
               "",
               "File to log the throughput during the test");
+DEFINE_string(sweep_dirs,
+              "",
+              "Comma separated experiment directories, each with a "
+              "config.json. The experiments replay the same trace in a single "
+              "pass and write their results into their directories. Replaces "
+              "--json_test_config");
+DEFINE_uint64(sweep_ring_records,
+              1 << 20,
+              "Trace records the sweep buffers ahead of the slowest "
+              "experiment");
+DEFINE_string(phased_trace_out,
+              "",
+              "Write the stream of the phased generator in the config to this "
+              "oracleGeneral trace, with next access times, and exit");
+DEFINE_uint64(phased_trace_requests,
+              10 * 1000 * 1000,
+              "Number of requests written by --phased_trace_out");
 struct sigaction act;
 std::unique_ptr<facebook::cachelib::cachebench::Runner> runnerInstance;
+std::unique_ptr<facebook::cachelib::cachebench::SweepRunner> sweepInstance;
 std::unique_ptr<std::thread> stopperThread;
 
 void sigint_handler(int sig_num) {
@@ -74,6 +97,9 @@ void sigint_handler(int sig_num) {
     if (runnerInstance) {
       runnerInstance->abort();
     }
+    if (sweepInstance) {
+      sweepInstance->abort();
+    }
     break;
   }
   }
@@ -102,6 +128,9 @@ void setupTimeoutHandler() {
             if (runnerInstance) {
               runnerInstance->abort();
             }
+            if (sweepInstance) {
+              sweepInstance->abort();
+            }
             eb.terminateLoopSoon();
           },
           FLAGS_timeout_seconds * 1000);
@@ -115,6 +144,9 @@ void setupTimeoutHandler() {
 }
 
 bool checkArgsValidity() {
+  if (!FLAGS_sweep_dirs.empty()) {
+    return true;
+  }
   if (FLAGS_json_test_config.empty() ||
       !facebook::cachelib::util::pathExists(FLAGS_json_test_config)) {
     std::cout << "Invalid config file: " << FLAGS_json_test_config
@@ -126,6 +158,27 @@ bool checkArgsValidity() {
   return true;
 }
 
+// Replay the trace once for all experiments in --sweep_dirs.
+int runSweep() {
+  if (FLAGS_enable_debug_log) {
+    folly::LoggerDB::get().setLevel("", folly::LogLevel::DBG);
+  }
+  std::vector<std::string> dirs;
+  folly::split(',', FLAGS_sweep_dirs, dirs, /* ignoreEmpty */ true);
+  try {
+    sweepInstance =
+        std::make_unique<facebook::cachelib::cachebench::SweepRunner>(
+            dirs, FLAGS_sweep_ring_records);
+    setupSignalHandler();
+    setupTimeoutHandler();
+
+    return sweepInstance->run() ? 0 : 1;
+  } catch (const std::exception& e) {
+    std::cout << "Invalid configuration. Exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
+
 int main(int argc, char** argv) {
   using namespace facebook::cachelib;
   using namespace facebook::cachelib::cachebench;
@@ -153,9 +206,25 @@ int main(int argc, char** argv) {
     return 1;
   }
 
+  if (!FLAGS_sweep_dirs.empty()) {
+    return runSweep();
+  }
+
   CacheBenchConfig config(FLAGS_json_test_config);
   std::cout << "Welcome to OSS version of cachebench" << std::endl;
 #endif
+  if (!FLAGS_phased_trace_out.empty()) {
+    try {
+      PhasedGenerator::writeOracleTrace(config.getStressorConfig(),
+                                        FLAGS_phased_trace_out,
+                                        FLAGS_phased_trace_requests);
+      return 0;
+    } catch (const std::exception& e) {
+      std::cout << "Failed to write phased trace. Exception: " << e.what()
+                << std::endl;
+      return 1;
+    }
+  }
   if(FLAGS_enable_debug_log) {
     folly::LoggerDB::get().setLevel("", folly::LogLevel::DBG);
   }
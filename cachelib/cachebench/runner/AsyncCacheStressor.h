@@ -387,7 +387,7 @@ class AsyncCacheStressor : public Stressor {
 
   // populate the input item handle according to the stress setup.
   void populateItem(WriteHandle& handle) {
-    if (!config_.populateItem) {
+    if (!config_.populateItem || cache_->simulationEnabled()) {
       return;
     }
     XDCHECK(handle);
@@ -37,6 +37,7 @@
 
 #include "cachelib/cachebench/cache/Cache.h"
 #include "cachelib/cachebench/cache/TimeStampTicker.h"
+#include "cachelib/cachebench/runner/OpenLoop.h"
 #include "cachelib/cachebench/runner/Stressor.h"
 #include "cachelib/cachebench/util/Config.h"
 #include "cachelib/cachebench/util/Exceptions.h"
@@ -45,6 +46,7 @@
 #include "cachelib/cachebench/workload/GeneratorBase.h"
 #include "cachelib/common/DistributionAnomalyDetector.h"
 #include "cachelib/common/EWMA.h"
+#include "cachelib/common/PerfCounters.h"
 #include "cachelib/common/ThreadCpuCycleCounter.h"
 
 typedef void (*set_mock_time_t)(time_t, long);
@@ -124,6 +126,7 @@ class CacheStressor : public Stressor {
     rebalanceIntervalInUse_ = wakeUpRebalancerEveryXReqs_;
     minRebalanceInterval_ = wakeUpRebalancerEveryXReqs_;
     anomalyDetectionFrequency_ = cacheConfig.anomalyDetectionFrequency;
+    statsSeriesEveryXReqs_ = cacheConfig.statsSeriesEveryXReqs;
     useAdaptiveRebalanceInterval_ = cacheConfig.useAdaptiveRebalanceInterval;
     useAdaptiveRebalanceIntervalV2_ =
         cacheConfig.useAdaptiveRebalanceIntervalV2;
@@ -191,6 +194,18 @@ class CacheStressor : public Stressor {
                                     ? config_.opRateBurstSize
                                     : config_.opRatePerSec);
     }
+    if (config_.openLoopReplay) {
+      openLoopClock_ = std::make_unique<OpenLoopClock>(config_.replaySpeed);
+    }
+    if (config_.deterministicReplay) {
+      logicalClock_ = wg_->setLogicalClockCallback(
+          [this](uint64_t t) { return onLogicalClock(t); });
+      if (!logicalClock_) {
+        XLOG(WARN) << "deterministicReplay is only supported by the "
+                      "oracleGeneral binary replay generator. Global events "
+                      "run per request instead.";
+      }
+    }
   }
 
   ~CacheStressor() override { finish(); }
@@ -206,6 +221,12 @@ class CacheStressor : public Stressor {
     std::cout << folly::sformat("Total {:.2f}M ops to be run",
                                 config_.numThreads * config_.numOps / 1e6)
               << std::endl;
+    if (openLoopClock_) {
+      openLoopLatency_ = std::make_unique<OpenLoopLatency>(
+          std::chrono::milliseconds{config_.latencyIntervalMs}, [this] {
+            return openLoopProgress_.load(std::memory_order_relaxed);
+          });
+    }
 
     stressWorker_ = std::thread([this] {
       std::vector<std::thread> workers;
@@ -221,6 +242,9 @@ class CacheStressor : public Stressor {
       for (auto& worker : workers) {
         worker.join();
       }
+      if (openLoopLatency_) {
+        openLoopLatency_->finish();
+      }
       {
         std::lock_guard<std::mutex> l(timeMutex_);
         //endTime_ = std::chrono::system_clock::now();
@@ -261,7 +285,17 @@ class CacheStressor : public Stressor {
   }
 
   // obtain stats from the cache instance.
-  Stats getCacheStats() const override { return cache_->getStats(); }
+  Stats getCacheStats() const override {
+    auto stats = cache_->getStats();
+    if (openLoopLatency_) {
+      openLoopLatency_->fillStats(stats);
+    }
+    if (stats.perfSampleEvery > 0) {
+      stats.stressorCycles = stressorCycles_.load(std::memory_order_relaxed);
+      stats.stressorOps = aggregateThroughputStats().ops;
+    }
+    return stats;
+  }
 
   // obtain aggregated throughput stats for the stress run so far.
   ThroughputStats aggregateThroughputStats() const override {
@@ -295,6 +329,11 @@ class CacheStressor : public Stressor {
     return result;
   }
 
+  // number of times the stressor woke up the pool rebalancer
+  uint64_t getRebalancerWakeUps() const {
+    return rebalancerWakeUps_.load(std::memory_order_relaxed);
+  }
+
  private:
   static std::string genHardcodedString() {
     const std::string s = "The quick brown fox jumps over the lazy dog. ";
@@ -323,7 +362,7 @@ class CacheStressor : public Stressor {
 
   // populate the input item handle according to the stress setup.
   void populateItem(WriteHandle& handle, const std::string& itemValue = "") {
-    if (!config_.populateItem) {
+    if (!config_.populateItem || cache_->simulationEnabled()) {
       return;
     }
     XDCHECK(handle);
@@ -368,9 +407,18 @@ class CacheStressor : public Stressor {
     std::optional<uint64_t> lastRequestId = std::nullopt;
     std::optional<uint64_t> lastRequestTs = std::nullopt;
     updateRebalanceInterval(0, rebalanceIntervalInUse_, "init");
-    
-    // facebook::cachelib::ThreadCpuCycleCounter cycleCounter;
-    // uint64_t cyclesBefore = cycleCounter.read();
+
+    std::optional<OpenLoopPacer> pacer;
+    if (openLoopClock_) {
+      pacer.emplace(*openLoopClock_);
+    }
+
+    // with hardware counters on, count all the cycles of this thread to put
+    // the sampled regions in proportion
+    std::optional<ThreadCpuCycleCounter> cycleCounter;
+    if (PerfCounters::getSampleEvery() > 0) {
+      cycleCounter.emplace();
+    }
 
     for (uint64_t i = 0;
          i < config_.numOps &&
@@ -401,145 +449,39 @@ class CacheStressor : public Stressor {
         const auto pid = static_cast<PoolId>(opPoolDist(gen));
         const Request& req(getReq(pid, gen, lastRequestId));
 
+        // latency counts from when the trace says the request was sent, so
+        // time spent queued behind a slow request is not hidden
+        std::optional<OpenLoopClock::Clock::time_point> intendedTime;
+        if (pacer) {
+          intendedTime = pacer->pace(req.timestamp);
+          if (threadIdx == 0) {
+            openLoopProgress_.store(i, std::memory_order_relaxed);
+          }
+        }
+
         if (config_.useTraceTimer &&
             (!lastRequestTs.has_value() || req.timestamp > lastRequestTs)) {
           setMockTimeFunc_(req.timestamp, 0);
         }
 
-        if (anomalyDetectionFrequency_ > 0 &&
-            i % anomalyDetectionFrequency_ == 0) {
-              std::map<PoolId, std::map<ClassId, uint64_t>> getDelta = cache_->fetchAcCacheGetDelta();
-              std::map<PoolId, std::map<ClassId, uint64_t>> missDelta = cache_->fetchAcCacheGetMissDelta();
-
-              
-              uint64_t totalGetDelta = 0;
-              uint64_t totalMissDelta = 0;
-              for (const auto& [poolId, classMap] : getDelta) {
-                  for (const auto& [classId, getDeltaValue] : classMap) {
-                      totalGetDelta += getDeltaValue;
-                  }
-              }
-              for (const auto& [poolId, classMap] : missDelta) {
-                  for (const auto& [classId, missDeltaValue] : classMap) {
-                      totalMissDelta += missDeltaValue;
-                  }
-              }
-
-              double missRatio = totalGetDelta > 0 ? static_cast<double>(totalMissDelta) / totalGetDelta : 0.0;
-              cache_->recordMissRatios(i, missRatio, totalMissDelta, totalGetDelta);
-              // Log the result in JSON format
-              XLOGF(DBG, "miss_ratio_logging: {{\"i\": {}, \"miss_ratio\": {}}}", i, missRatio);
-              
-              // Print the delta for both gets and misses
-              for (const auto& [poolId, classMap] : getDelta) {
-                  for (const auto& [classId, getDeltaValue] : classMap) {
-                      uint64_t missDeltaValue = 0;
-              
-                      // Check if the same key exists in the missDelta map
-                      if (missDelta.count(poolId) && missDelta[poolId].count(classId)) {
-                          missDeltaValue = missDelta[poolId][classId];
-                      }
-      
-                      XLOGF(DBG, "Miss count from the simulator: PoolId: {}, ClassId: {}, Get Delta: {}, Miss Delta: {}",
-                        poolId, classId, getDeltaValue, missDeltaValue);
-                  }
-              }
-
-              auto rawStats = cache_->getPoolDeltaStats(pid);
-
-              auto statsToDynamic = [](const std::map<ClassId, double>& stats) {
-                  folly::dynamic result = folly::dynamic::object;
-                  for (const auto& [classId, value] : stats) {
-                      result[folly::to<std::string>(classId)] = value;
-                  }
-                  return result;
-              };
-
-              folly::dynamic jsonStats = folly::dynamic::object;
-              constexpr std::array<const char*, 8> metrics = {
-                  "tailAge",
-                  "marginalHits",
-                  "hits",
-                  "evictions",
-                  "hitsPerSlab",
-                  "missEstimation",
-                  "numSlabs",
-                  "freeMemory"
-              };
-              
-              bool allSlabsAllocated = cache_->allSlabsAllocated(pid);
-              
-              for (const auto& metric : metrics) {
-                  auto it = rawStats.find(metric);
-                  if (it != rawStats.end()) {
-                      jsonStats[metric] = statsToDynamic(it->second);
-                  }
-              }
-            
-              if (!jsonStats.empty()) {
-                jsonStats["request_id"] = i;
-                jsonStats["allSlabsAllocated"] = allSlabsAllocated;
-                XLOGF(DBG, "Delta_statistics_logging: {}", folly::toJson(jsonStats));
-                //cache_->recordDeltaStats(i, folly::toJson(jsonStats));
-              }
-
-
-              if (allSlabsAllocated && !rawStats.empty() && rawStats.find("marginalHits") != rawStats.end()) {
-                double speedOfChange = maxMinDiffOverAnomalyFreq(rawStats["marginalHits"]);
-                double cv = coefficientOfVariation(rawStats["marginalHits"]);
-                cache_->recordMhCV(i, cv);
-                bool anomaly1 = ewma_.update(cv);
-                bool anomaly2 = ewmaDelta_.update(cv - lastCV_);
-                if((anomaly1 || anomaly2) && useAnomalyDetection_) {
-                    auto newInterval = minRebalanceInterval_;
-                    XLOG(INFO, "Rebalance interval adjusted due to anomaly");
-                    updateRebalanceInterval(i, newInterval, "reset");
-                    cache_->clearRebalancerPoolEventMap(pid);
-                    cache_->incrAnomalyCount();
-                    cache_->addAnomayRequestId(i);
-                }
-                lastCV_ = cv;
-              }
-
-        }
-
-        if(resetIntervalTimings_.count(i) > 0) {
-          XLOGF(INFO, "Resetting interval timings at i = {}", i);
-          updateRebalanceInterval(i, wakeUpRebalancerEveryXReqs_, "reset");
-          cache_->clearRebalancerPoolEventMap(pid);
-        }
-
-      
-
-        if ((threadIdx == 0) && (i - lastRebalanceTime_) >= (rebalanceIntervalInUse_ / config_.numThreads) && !rebalancerDisabled_) {
-          // printf("Waking up rebalancer at i = %lu, interval = %lu\n", i, rebalanceIntervalInUse_);
-          cache_->wakeupPoolRebalancer(syncRebalance_, i);
-          lastRebalanceTime_ = i;
-          //cache_->addRebalanceRequestId(i);
-          double emr = cache_->getEffectiveMovementRate(pid);
-          //cache_->addEffectiveMovementRate(emr);
-        
-          if (useAdaptiveRebalanceInterval_ || useAdaptiveRebalanceIntervalV2_) {
-            auto rebalanceEventCount = cache_->getRebalancerPoolEventCount(pid);
-            double effectiveMoveRate = cache_->getEffectiveMovementRate(pid);
-            //v2: MD
-            if(useAdaptiveRebalanceIntervalV2_ && effectiveMoveRate >= 0.95 && rebalanceEventCount >= cache_->getNumClassId(pid)){
-              auto newInterval = std::max<uint64_t>(rebalanceIntervalInUse_ / increaseIntervalFactor_, 1);
-              XLOGF(DBG, "Effective movement rate is high ({}, {}), decreasing "
-                        "the rebalance interval, from {} : {}", effectiveMoveRate, rebalanceEventCount, rebalanceIntervalInUse_, newInterval);
-              updateRebalanceInterval(i, newInterval, "MD");
-              cache_->clearRebalancerPoolEventMap(pid);
-            }
-            //v1: MI
-            if (effectiveMoveRate < 0.5 && rebalanceEventCount >= 5) {
-              XLOGF(DBG, "Effective movement rate is low ({}, {}), increasing "
-                        "the rebalance interval, from {} : {}", effectiveMoveRate, rebalanceEventCount, rebalanceIntervalInUse_, rebalanceIntervalInUse_ * increaseIntervalFactor_);
-              auto newInterval = rebalanceIntervalInUse_ * increaseIntervalFactor_;
-              updateRebalanceInterval(i, newInterval, "MI");
-              cache_->clearRebalancerPoolEventMap(pid);
-            }
+        if (!logicalClock_) {
+          if (anomalyDetectionFrequency_ > 0 &&
+              i % anomalyDetectionFrequency_ == 0) {
+            detectAnomaly(i, pid);
+          }
+          if (threadIdx == 0 && statsSeriesEveryXReqs_ > 0 &&
+              i % statsSeriesEveryXReqs_ == 0) {
+            cache_->recordClassSeries(i);
+          }
+          if (resetIntervalTimings_.count(i) > 0) {
+            resetRebalanceInterval(i, pid);
+          }
+          if ((threadIdx == 0) &&
+              (i - lastRebalanceTime_) >=
+                  (rebalanceIntervalInUse_ / config_.numThreads) &&
+              !rebalancerDisabled_) {
+            wakeUpRebalancer(i, pid);
           }
-
         }
 
         OpType op = req.getOp();
@@ -559,7 +501,9 @@ class CacheStressor : public Stressor {
           if (config_.onlySetIfMiss) {
             auto it = cache_->find(*key);
             if (it != nullptr) {
-              continue;
+              // still notify the generator so the request can be recycled
+              result = OpResultType::kSetSkip;
+              break;
             }
           }
           auto lock = chainedItemAcquireUniqueLock(*key);
@@ -688,6 +632,13 @@ class CacheStressor : public Stressor {
           break;
         }
 
+        if (intendedTime) {
+          openLoopLatency_->record(
+              op, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      OpenLoopClock::Clock::now() - *intendedTime)
+                      .count());
+        }
+
         lastRequestId = req.requestId;
         lastRequestTs = req.timestamp;
         if (req.requestId) {
@@ -699,10 +650,10 @@ class CacheStressor : public Stressor {
       }
     }
 
-    // uint64_t cyclesAfter = cycleCounter.read();
-    // uint64_t cyclesDelta = cyclesAfter - cyclesBefore;
-    // std::cout << "CPU cycles for serving requests: " << cyclesDelta << std::endl;
-    // cycleCounter.stop(); 
+    if (cycleCounter) {
+      stressorCycles_.fetch_add(cycleCounter->stop(),
+                                std::memory_order_relaxed);
+    }
     wg_->markFinish();
   }
 
@@ -849,6 +800,229 @@ double coefficientOfVariation(const std::map<ClassId, double>& values) {
 }
 
 
+// Samples the per-class get/miss deltas and feeds the anomaly detector that
+// resets the rebalance interval.
+void detectAnomaly(uint64_t i, PoolId pid) {
+    std::map<PoolId, std::map<ClassId, uint64_t>> getDelta = cache_->fetchAcCacheGetDelta();
+    std::map<PoolId, std::map<ClassId, uint64_t>> missDelta = cache_->fetchAcCacheGetMissDelta();
+
+
+    uint64_t totalGetDelta = 0;
+    uint64_t totalMissDelta = 0;
+    for (const auto& [poolId, classMap] : getDelta) {
+        for (const auto& [classId, getDeltaValue] : classMap) {
+            totalGetDelta += getDeltaValue;
+        }
+    }
+    for (const auto& [poolId, classMap] : missDelta) {
+        for (const auto& [classId, missDeltaValue] : classMap) {
+            totalMissDelta += missDeltaValue;
+        }
+    }
+
+    double missRatio = totalGetDelta > 0 ? static_cast<double>(totalMissDelta) / totalGetDelta : 0.0;
+    cache_->recordMissRatios(i, missRatio, totalMissDelta, totalGetDelta);
+    auto* series = cache_->getStatsSeries();
+    if (series) {
+      StatsSeriesRecord record;
+      record.requestId = i;
+      record.kind = StatsSeriesRecord::kMissRatio;
+      record.poolId = pid;
+      record.values = {missRatio, static_cast<double>(totalMissDelta),
+                       static_cast<double>(totalGetDelta)};
+      series->append(record);
+    }
+    // Log the result in JSON format
+    XLOGF(DBG, "miss_ratio_logging: {{\"i\": {}, \"miss_ratio\": {}}}", i, missRatio);
+
+    // Print the delta for both gets and misses
+    for (const auto& [poolId, classMap] : getDelta) {
+        for (const auto& [classId, getDeltaValue] : classMap) {
+            uint64_t missDeltaValue = 0;
+
+            // Check if the same key exists in the missDelta map
+            if (missDelta.count(poolId) && missDelta[poolId].count(classId)) {
+                missDeltaValue = missDelta[poolId][classId];
+            }
+
+            XLOGF(DBG, "Miss count from the simulator: PoolId: {}, ClassId: {}, Get Delta: {}, Miss Delta: {}",
+              poolId, classId, getDeltaValue, missDeltaValue);
+        }
+    }
+
+    auto rawStats = cache_->getPoolDeltaStats(pid);
+
+    auto statsToDynamic = [](const std::map<ClassId, double>& stats) {
+        folly::dynamic result = folly::dynamic::object;
+        for (const auto& [classId, value] : stats) {
+            result[folly::to<std::string>(classId)] = value;
+        }
+        return result;
+    };
+
+    constexpr std::array<const char*, StatsSeriesRecord::kNumValues> metrics = {
+        "tailAge",
+        "marginalHits",
+        "hits",
+        "evictions",
+        "hitsPerSlab",
+        "missEstimation",
+        "numSlabs",
+        "freeMemory"
+    };
+
+    bool allSlabsAllocated = cache_->allSlabsAllocated(pid);
+
+    if (series) {
+      // one record per class with the metrics in the order above
+      std::map<ClassId, StatsSeriesRecord> records;
+      for (size_t m = 0; m < metrics.size(); m++) {
+        auto it = rawStats.find(metrics[m]);
+        if (it == rawStats.end()) {
+          continue;
+        }
+        for (const auto& [classId, value] : it->second) {
+          auto& record = records[classId];
+          record.values[m] = value;
+        }
+      }
+      for (auto& [classId, record] : records) {
+        record.requestId = i;
+        record.kind = StatsSeriesRecord::kDeltaStats;
+        record.poolId = pid;
+        record.classId = classId;
+        series->append(record);
+      }
+    }
+
+    // only build the json when somebody reads it
+    if (XLOG_IS_ON(DBG)) {
+      folly::dynamic jsonStats = folly::dynamic::object;
+      for (const auto& metric : metrics) {
+          auto it = rawStats.find(metric);
+          if (it != rawStats.end()) {
+              jsonStats[metric] = statsToDynamic(it->second);
+          }
+      }
+
+      if (!jsonStats.empty()) {
+        jsonStats["request_id"] = i;
+        jsonStats["allSlabsAllocated"] = allSlabsAllocated;
+        XLOGF(DBG, "Delta_statistics_logging: {}", folly::toJson(jsonStats));
+        //cache_->recordDeltaStats(i, folly::toJson(jsonStats));
+      }
+    }
+
+
+    if (allSlabsAllocated && !rawStats.empty() && rawStats.find("marginalHits") != rawStats.end()) {
+      double speedOfChange = maxMinDiffOverAnomalyFreq(rawStats["marginalHits"]);
+      double cv = coefficientOfVariation(rawStats["marginalHits"]);
+      cache_->recordMhCV(i, cv);
+      bool anomaly1 = ewma_.update(cv);
+      bool anomaly2 = ewmaDelta_.update(cv - lastCV_);
+      if((anomaly1 || anomaly2) && useAnomalyDetection_) {
+          auto newInterval = minRebalanceInterval_;
+          XLOG(INFO, "Rebalance interval adjusted due to anomaly");
+          updateRebalanceInterval(i, newInterval, "reset");
+          cache_->clearRebalancerPoolEventMap(pid);
+          cache_->incrAnomalyCount();
+          cache_->addAnomayRequestId(i);
+      }
+      lastCV_ = cv;
+    }
+}
+
+void resetRebalanceInterval(uint64_t i, PoolId pid) {
+    XLOGF(INFO, "Resetting interval timings at i = {}", i);
+    updateRebalanceInterval(i, wakeUpRebalancerEveryXReqs_, "reset");
+    cache_->clearRebalancerPoolEventMap(pid);
+}
+
+// Wakes up the rebalancer and adapts the rebalance interval to how
+// effective the slab moves have been.
+void wakeUpRebalancer(uint64_t i, PoolId pid) {
+    // printf("Waking up rebalancer at i = %lu, interval = %lu\n", i, rebalanceIntervalInUse_);
+    if (statsSeriesEveryXReqs_ == 0) {
+      cache_->recordClassSeries(i);
+    }
+    if (cache_->exactMrcEnabled()) {
+      // score the estimates the rebalancer is about to act on
+      cache_->recordMrcErrors(i);
+    }
+    cache_->wakeupPoolRebalancer(syncRebalance_, i);
+    rebalancerWakeUps_.fetch_add(1, std::memory_order_relaxed);
+    lastRebalanceTime_ = i;
+    //cache_->addRebalanceRequestId(i);
+    double emr = cache_->getEffectiveMovementRate(pid);
+    //cache_->addEffectiveMovementRate(emr);
+
+    if (useAdaptiveRebalanceInterval_ || useAdaptiveRebalanceIntervalV2_) {
+      auto rebalanceEventCount = cache_->getRebalancerPoolEventCount(pid);
+      double effectiveMoveRate = cache_->getEffectiveMovementRate(pid);
+      //v2: MD
+      if(useAdaptiveRebalanceIntervalV2_ && effectiveMoveRate >= 0.95 && rebalanceEventCount >= cache_->getNumClassId(pid)){
+        auto newInterval = std::max<uint64_t>(rebalanceIntervalInUse_ / increaseIntervalFactor_, 1);
+        XLOGF(DBG, "Effective movement rate is high ({}, {}), decreasing "
+                  "the rebalance interval, from {} : {}", effectiveMoveRate, rebalanceEventCount, rebalanceIntervalInUse_, newInterval);
+        updateRebalanceInterval(i, newInterval, "MD");
+        cache_->clearRebalancerPoolEventMap(pid);
+      }
+      //v1: MI
+      if (effectiveMoveRate < 0.5 && rebalanceEventCount >= 5) {
+        XLOGF(DBG, "Effective movement rate is low ({}, {}), increasing "
+                  "the rebalance interval, from {} : {}", effectiveMoveRate, rebalanceEventCount, rebalanceIntervalInUse_, rebalanceIntervalInUse_ * increaseIntervalFactor_);
+        auto newInterval = rebalanceIntervalInUse_ * increaseIntervalFactor_;
+        updateRebalanceInterval(i, newInterval, "MI");
+        cache_->clearRebalancerPoolEventMap(pid);
+      }
+    }
+}
+
+// Runs the global events of a deterministic replay. The generator calls this
+// at logical time t (requests dispatched so far) once all earlier requests
+// have completed, so events land at the same trace position in every run no
+// matter how many stressor threads there are. Returns the logical time of
+// the next event.
+uint64_t onLogicalClock(uint64_t t) {
+    // pools are picked per request; the adaptive controls follow the first
+    const PoolId pid = 0;
+    if (anomalyDetectionFrequency_ > 0 && t % anomalyDetectionFrequency_ == 0) {
+      detectAnomaly(t, pid);
+    }
+    if (statsSeriesEveryXReqs_ > 0 && t % statsSeriesEveryXReqs_ == 0) {
+      cache_->recordClassSeries(t);
+    }
+    if (t <= std::numeric_limits<unsigned int>::max() &&
+        resetIntervalTimings_.count(static_cast<unsigned int>(t)) > 0) {
+      resetRebalanceInterval(t, pid);
+    }
+    if (!rebalancerDisabled_ &&
+        t - lastRebalanceTime_ >= rebalanceIntervalInUse_) {
+      wakeUpRebalancer(t, pid);
+    }
+
+    uint64_t next = std::numeric_limits<uint64_t>::max();
+    if (anomalyDetectionFrequency_ > 0) {
+      next = std::min(next, (t / anomalyDetectionFrequency_ + 1) *
+                                anomalyDetectionFrequency_);
+    }
+    if (statsSeriesEveryXReqs_ > 0) {
+      next = std::min(
+          next, (t / statsSeriesEveryXReqs_ + 1) * statsSeriesEveryXReqs_);
+    }
+    if (t < std::numeric_limits<unsigned int>::max()) {
+      auto it = resetIntervalTimings_.upper_bound(static_cast<unsigned int>(t));
+      if (it != resetIntervalTimings_.end()) {
+        next = std::min<uint64_t>(next, *it);
+      }
+    }
+    if (!rebalancerDisabled_) {
+      next = std::min(
+          next, std::max(lastRebalanceTime_ + rebalanceIntervalInUse_, t + 1));
+    }
+    return next;
+}
+
 void updateRebalanceInterval(uint64_t requestId, uint64_t newInterval, std::string reason = "") {
     XLOGF(INFO, "Rebalance interval updated from {} to {} at request id {}", rebalanceIntervalInUse_, newInterval, requestId);
     rebalanceIntervalInUse_ = newInterval; 
@@ -919,6 +1093,15 @@ std::chrono::system_clock::time_point getRealTime() const {
   // Whether flash cache has been warmed up
   bool hasNvmCacheWarmedUp_{false};
 
+  // set with openLoopReplay. The progress is the request index of the first
+  // stressor thread, which the latency intervals are labelled with.
+  std::unique_ptr<OpenLoopClock> openLoopClock_;
+  std::unique_ptr<OpenLoopLatency> openLoopLatency_;
+  std::atomic<uint64_t> openLoopProgress_{0};
+
+  // cycles of the finished stressor threads, with perfCountersEveryXOps
+  std::atomic<uint64_t> stressorCycles_{0};
+
   // for loading the mock timer shared library
   void* mockTimerHandle_;
 
@@ -927,6 +1110,8 @@ std::chrono::system_clock::time_point getRealTime() const {
   uint64_t wakeUpRebalancerEveryXReqs_;
 
   uint64_t anomalyDetectionFrequency_{0};
+  // 0 samples the per-class stats series at every rebalance instead
+  uint64_t statsSeriesEveryXReqs_{0};
 
   uint64_t rebalanceIntervalInUse_;
 
@@ -946,6 +1131,11 @@ std::chrono::system_clock::time_point getRealTime() const {
 
   bool rebalancerDisabled_{false};
 
+  // whether the generator drives the global events off its logical clock
+  bool logicalClock_{false};
+
+  std::atomic<uint64_t> rebalancerWakeUps_{0};
+
   std::string intervalAdjustmentStrategy_{"mimd"};
 
   double lastCV_{0.0};
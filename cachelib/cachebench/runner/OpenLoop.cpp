@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cachelib/cachebench/runner/OpenLoop.h"
+
+#include <folly/Format.h>
+#include <folly/logging/xlog.h>
+
+#include <stdexcept>
+#include <thread>
+
+namespace facebook {
+namespace cachelib {
+namespace cachebench {
+
+OpenLoopClock::OpenLoopClock(double speed) : speed_(speed) {
+  if (speed <= 0) {
+    throw std::invalid_argument(
+        folly::sformat("replay speed must be positive: {}", speed));
+  }
+}
+
+OpenLoopClock::Clock::time_point OpenLoopClock::intendedTime(
+    uint64_t traceSecs, std::chrono::nanoseconds offset) {
+  std::call_once(anchorOnce_, [&] {
+    anchorSecs_ = traceSecs;
+    anchorTime_ = Clock::now();
+  });
+  if (traceSecs < anchorSecs_) {
+    return anchorTime_;
+  }
+  const auto traceNs = std::chrono::duration<double, std::nano>(
+      std::chrono::seconds{static_cast<int64_t>(traceSecs - anchorSecs_)} +
+      offset);
+  return anchorTime_ + std::chrono::duration_cast<Clock::duration>(
+                           traceNs / speed_);
+}
+
+OpenLoopClock::Clock::time_point OpenLoopPacer::pace(uint64_t traceSecs) {
+  if (traceSecs != curSecs_) {
+    // a gap in the trace leaves no estimate for the new second
+    prevSecCount_ = traceSecs == curSecs_ + 1 ? countInSec_ : 0;
+    curSecs_ = traceSecs;
+    countInSec_ = 0;
+  }
+  std::chrono::nanoseconds offset{0};
+  if (prevSecCount_ > 0) {
+    // a second busier than the last one bunches up at its end
+    const uint64_t slot = std::min(countInSec_, prevSecCount_ - 1);
+    offset = std::chrono::nanoseconds{static_cast<int64_t>(
+        1000ULL * 1000 * 1000 * slot / prevSecCount_)};
+  }
+  countInSec_++;
+
+  const auto intended = clock_.intendedTime(traceSecs, offset);
+  if (intended > OpenLoopClock::Clock::now()) {
+    std::this_thread::sleep_until(intended);
+  }
+  return intended;
+}
+
+OpenLoopLatency::OpenLoopLatency(std::chrono::milliseconds interval,
+                                 std::function<uint64_t()> progress)
+    : progress_(std::move(progress)),
+      start_(std::chrono::steady_clock::now()),
+      current_(makeHistograms()),
+      interval_(makeHistograms()),
+      totals_(makeHistograms()) {
+  if (interval.count() == 0) {
+    throw std::invalid_argument("latency interval must be positive");
+  }
+  start(interval, "open_loop_latency");
+}
+
+OpenLoopLatency::~OpenLoopLatency() { stop(); }
+
+OpenLoopLatency::Histograms OpenLoopLatency::makeHistograms() {
+  Histograms histograms;
+  for (auto& h : histograms) {
+    h = std::make_unique<util::HdrHistogram>(kMaxLatencyNs, kSignificantDigits);
+  }
+  return histograms;
+}
+
+const char* OpenLoopLatency::opName(size_t op) {
+  switch (static_cast<OpType>(op)) {
+  case OpType::kSet:
+    return "set";
+  case OpType::kGet:
+    return "get";
+  case OpType::kDel:
+    return "del";
+  case OpType::kAddChained:
+    return "addChained";
+  case OpType::kLoneGet:
+    return "loneGet";
+  case OpType::kLoneSet:
+    return "loneSet";
+  case OpType::kUpdate:
+    return "update";
+  case OpType::kCouldExist:
+    return "couldExist";
+  default:
+    return "unknown";
+  }
+}
+
+LatencySummary OpenLoopLatency::summarize(const util::HdrHistogram& h) {
+  LatencySummary s;
+  s.count = h.count();
+  s.p50 = h.valueAtPercentile(50);
+  s.p90 = h.valueAtPercentile(90);
+  s.p99 = h.valueAtPercentile(99);
+  s.p999 = h.valueAtPercentile(99.9);
+  s.p9999 = h.valueAtPercentile(99.99);
+  s.max = h.max();
+  s.mean = h.mean();
+  return s;
+}
+
+void OpenLoopLatency::work() { drainInterval(); }
+
+void OpenLoopLatency::finish() {
+  stop();
+  drainInterval();
+}
+
+void OpenLoopLatency::drainInterval() {
+  LatencyInterval interval;
+  interval.elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::steady_clock::now() - start_)
+                           .count();
+  interval.requestId = progress_();
+  for (size_t op = 0; op < kNumOps; op++) {
+    current_[op]->drainInto(*interval_[op]);
+    if (interval_[op]->count() > 0) {
+      interval.ops[opName(op)] = summarize(*interval_[op]);
+    }
+  }
+
+  std::lock_guard<std::mutex> l(mutex_);
+  for (size_t op = 0; op < kNumOps; op++) {
+    interval_[op]->drainInto(*totals_[op]);
+  }
+  if (!interval.ops.empty()) {
+    intervals_.push_back(std::move(interval));
+  }
+}
+
+void OpenLoopLatency::fillStats(Stats& stats) const {
+  std::lock_guard<std::mutex> l(mutex_);
+  for (size_t op = 0; op < kNumOps; op++) {
+    if (totals_[op]->count() > 0) {
+      stats.openLoopLatency[opName(op)] = summarize(*totals_[op]);
+    }
+  }
+  stats.openLoopIntervals = intervals_;
+}
+
+} // namespace cachebench
+} // namespace cachelib
+} // namespace facebook
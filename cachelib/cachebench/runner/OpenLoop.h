@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "cachelib/cachebench/cache/CacheStats.h"
+#include "cachelib/cachebench/util/Request.h"
+#include "cachelib/common/HdrHistogram.h"
+#include "cachelib/common/PeriodicWorker.h"
+
+namespace facebook {
+namespace cachelib {
+namespace cachebench {
+
+// Maps trace timestamps to wall clock send times for an open loop replay.
+// The first timestamp seen is anchored to the moment it is seen; a speed
+// above 1 compresses the trace.
+class OpenLoopClock {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit OpenLoopClock(double speed);
+
+  // Send time of a request at trace second traceSecs plus offset into that
+  // second, in trace time. Requests older than the anchor are due at once.
+  Clock::time_point intendedTime(uint64_t traceSecs,
+                                 std::chrono::nanoseconds offset);
+
+ private:
+  const double speed_;
+  std::once_flag anchorOnce_;
+  uint64_t anchorSecs_{0};
+  Clock::time_point anchorTime_;
+};
+
+// Per stressor thread pacer. Trace timestamps only have second granularity,
+// so the requests of one trace second are spread evenly over it, using the
+// number of requests this thread saw in the previous second as the estimate.
+// Keys are sharded over threads, so pacing each thread on its own keeps the
+// order of requests to a key.
+class OpenLoopPacer {
+ public:
+  explicit OpenLoopPacer(OpenLoopClock& clock) : clock_(clock) {}
+
+  // Block until the request is due and return when it was due. A thread
+  // that falls behind does not sleep; its lateness is part of the latency.
+  OpenLoopClock::Clock::time_point pace(uint64_t traceSecs);
+
+ private:
+  OpenLoopClock& clock_;
+  uint64_t curSecs_{0};
+  uint64_t countInSec_{0};
+  uint64_t prevSecCount_{0};
+};
+
+// Lock free per op type latency histograms of an open loop replay. A
+// background worker drains them every interval into the run totals and keeps
+// the percentiles of every interval.
+class OpenLoopLatency : public PeriodicWorker {
+ public:
+  // @param interval  reporting interval
+  // @param progress  returns the request id to label an interval with
+  OpenLoopLatency(std::chrono::milliseconds interval,
+                  std::function<uint64_t()> progress);
+  ~OpenLoopLatency() override;
+
+  void record(OpType op, uint64_t latencyNs) noexcept {
+    current_[static_cast<size_t>(op)]->record(latencyNs);
+  }
+
+  // stop reporting, folding in the last partial interval
+  void finish();
+
+  void fillStats(Stats& stats) const;
+
+ private:
+  static constexpr size_t kNumOps = static_cast<size_t>(OpType::kSize);
+  // latencies above an hour are clamped
+  static constexpr uint64_t kMaxLatencyNs = 3600ULL * 1000 * 1000 * 1000;
+  static constexpr uint32_t kSignificantDigits = 3;
+
+  using Histograms = std::array<std::unique_ptr<util::HdrHistogram>, kNumOps>;
+
+  static Histograms makeHistograms();
+  static LatencySummary summarize(const util::HdrHistogram& h);
+  static const char* opName(size_t op);
+
+  void work() override;
+  void drainInterval();
+
+  const std::function<uint64_t()> progress_;
+  const std::chrono::steady_clock::time_point start_;
+
+  // recorded into by the stressor threads
+  Histograms current_;
+
+  // owned by the worker; totals and intervals are read under the lock
+  Histograms interval_;
+  mutable std::mutex mutex_;
+  Histograms totals_;
+  std::vector<LatencyInterval> intervals_;
+};
+
+} // namespace cachebench
+} // namespace cachelib
+} // namespace facebook
@@ -17,6 +17,7 @@
 #include "cachelib/cachebench/runner/Runner.h"
 
 #include "cachelib/cachebench/runner/Stressor.h"
+#include "cachelib/common/PerfCounters.h"
 #include <folly/Random.h>
 #include <folly/dynamic.h>
 #include <folly/json.h>
@@ -25,9 +26,63 @@
 namespace facebook {
 namespace cachelib {
 namespace cachebench {
-Runner::Runner(const CacheBenchConfig& config)
-    : stressor_{Stressor::makeStressor(config.getCacheConfig(),
-                                       config.getStressorConfig())} {}
+Stats Runner::renderResults(Stressor& stressor,
+                            std::ostream& out,
+                            const std::string& dumpResultJsonFile,
+                            const std::string& dumpTxFile) {
+  uint64_t durationNs = stressor.getTestDurationNs();
+  auto cacheStats = stressor.getCacheStats();
+  auto opsStats = stressor.aggregateThroughputStats();
+
+  out << "== Test Results ==\n== Allocator Stats ==" << std::endl;
+  cacheStats.render(out);
+
+  out << "\n== Throughput for  ==\n";
+  out << "\n== Duration: " << (static_cast<double>(durationNs) / 1e9) << " s) ==\n";
+  out << "== Ops: " << opsStats.ops << " ==\n";
+  out << "== Throughput: "
+      << opsStats.ops / (static_cast<double>(durationNs) / 1e9) << " ==\n";
+
+  if (!dumpTxFile.empty()) {
+    auto uuid = folly::sformat("{:016x}-{:016x}",
+                               folly::Random::secureRand64(),
+                               folly::Random::secureRand64());
+    std::string outFile = dumpTxFile + "." + uuid + ".json";
+
+    folly::dynamic j = folly::dynamic::object;
+    j["duration_ns"] = durationNs;
+    j["ops"] = opsStats.ops;
+    j["throughput"] = static_cast<double>(opsStats.ops) / (static_cast<double>(durationNs) / 1e9);
+
+    std::ofstream ofs(outFile);
+    if (ofs) {
+      ofs << folly::toPrettyJson(j) << std::endl;
+      out << "== Throughput JSON written to " << outFile << std::endl;
+    } else {
+      std::cerr << "Failed to write throughput JSON to " << outFile << std::endl;
+    }
+  }
+
+  opsStats.render(durationNs, out);
+
+  if (!dumpResultJsonFile.empty()) {
+    out << "== Writing result to json file" << dumpResultJsonFile << std::endl;
+    cacheStats.renderToJson(dumpResultJsonFile);
+  }
+
+  stressor.renderWorkloadGeneratorStats(durationNs, out);
+  out << std::endl;
+  return cacheStats;
+}
+
+Runner::Runner(const CacheBenchConfig& config) {
+  // the hardware counters are process wide, so they are set up once here
+  // rather than by each cache
+  PerfCounters::setSampleEvery(
+      static_cast<uint32_t>(config.getCacheConfig().perfCountersEveryXOps));
+  stressor_ = Stressor::makeStressor(config.getCacheConfig(),
+                                     config.getStressorConfig());
+}
 
 bool Runner::run(std::chrono::seconds progressInterval,
                  const std::string& progressStatsFile,
@@ -48,52 +103,12 @@ bool Runner::run(std::chrono::seconds progressInterval,
 
   stressor_->finish();
 
-  uint64_t durationNs = stressor_->getTestDurationNs();
-  auto cacheStats = stressor_->getCacheStats();
-  auto opsStats = stressor_->aggregateThroughputStats();
   if (!disableProgressTracker) {
     tracker.stop();
   }
 
-  std::cout << "== Test Results ==\n== Allocator Stats ==" << std::endl;
-  cacheStats.render(std::cout);
-
-  std::cout << "\n== Throughput for  ==\n";
-  std::cout << "\n== Duration: " << (static_cast<double>(durationNs) / 1e9) << " s) ==\n";
-  std::cout << "== Ops: " << opsStats.ops << " ==\n";
-  std::cout << "== Throughput: "
-          << opsStats.ops / (static_cast<double>(durationNs) / 1e9)  << " ==\n";
-  
-    if (!dumpTxFile.empty()) {
-      auto uuid = folly::sformat("{:016x}-{:016x}",
-                                folly::Random::secureRand64(),
-                                folly::Random::secureRand64());
-      std::string outFile = dumpTxFile + "." + uuid + ".json";
-
-    folly::dynamic j = folly::dynamic::object;
-    j["duration_ns"] = durationNs;
-    j["ops"] = opsStats.ops;
-    j["throughput"] = static_cast<double>(opsStats.ops) / (static_cast<double>(durationNs) / 1e9);
-
-    std::ofstream ofs(outFile);
-    if (ofs) {
-      ofs << folly::toPrettyJson(j) << std::endl;
-      std::cout << "== Throughput JSON written to " << outFile << std::endl;
-    } else {
-      std::cerr << "Failed to write throughput JSON to " << outFile << std::endl;
-    }
-  }
-
-  opsStats.render(durationNs, std::cout);
-
-  if (!dumpResultJsonFile.empty()) {
-    std::cout << "== Writing result to json file" <<  dumpResultJsonFile  << std::endl;
-    cacheStats.renderToJson(dumpResultJsonFile);
-  }
-
-  stressor_->renderWorkloadGeneratorStats(durationNs, std::cout);
-  std::cout << std::endl;
-
+  auto cacheStats = renderResults(*stressor_, std::cout, dumpResultJsonFile,
+                                  dumpTxFile);
   stressor_.reset();
 
   bool passed = cacheStats.renderIsTestPassed(std::cout);
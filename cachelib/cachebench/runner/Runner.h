@@ -18,6 +18,7 @@
 
 #include <folly/Benchmark.h>
 
+#include <ostream>
 #include <string>
 
 #include "cachelib/cachebench/runner/ProgressTracker.h"
@@ -54,6 +55,21 @@ class Runner {
   // and put metrics into folly::UserCounters to show metrics in output results.
   bool run(folly::UserCounters&);
 
+  // Print the results of a finished stressor and dump them to the result
+  // and throughput files when those are set.
+  //
+  // @param stressor            stressor that has finished its run
+  // @param out                 stream to print the results to
+  // @param dumpResultJsonFile  file to dump the cache stats to as json.
+  //                            Ignored if empty
+  // @param dumpTxFile          prefix of the file to dump the throughput to
+  //                            as json. Ignored if empty
+  // @return the cache stats of the run
+  static Stats renderResults(Stressor& stressor,
+                             std::ostream& out,
+                             const std::string& dumpResultJsonFile,
+                             const std::string& dumpTxFile);
+
   void abort() {
     aborted_ = true;
     if (stressor_) {
@@ -25,6 +25,7 @@
 #include "cachelib/cachebench/workload/KVReplayGenerator.h"
 #include "cachelib/cachebench/workload/OGBinaryReplayGenerator.h"
 #include "cachelib/cachebench/workload/OnlineGenerator.h"
+#include "cachelib/cachebench/workload/PhasedGenerator.h"
 #include "cachelib/cachebench/workload/PieceWiseReplayGenerator.h"
 #include "cachelib/cachebench/workload/WorkloadGenerator.h"
 #include "cachelib/common/Utils.h"
@@ -154,6 +155,8 @@ std::unique_ptr<GeneratorBase> makeGenerator(const StressorConfig& config) {
     return std::make_unique<WorkloadGenerator>(config);
   } else if (config.generator == "online") {
     return std::make_unique<OnlineGenerator>(config);
+  } else if (config.generator == "phased") {
+    return std::make_unique<PhasedGenerator>(config);
 
   } else {
     throw std::invalid_argument(fmt::format(
@@ -199,31 +202,39 @@ std::unique_ptr<Stressor> Stressor::makeStressor(
           cacheConfig, stressorConfig, std::move(generator));
     }
   } else {
-    auto generator = makeGenerator(stressorConfig);
-    if (cacheConfig.allocator == "LRU") {
-      // default allocator is LRU, other allocator types should be added here
-      return std::make_unique<CacheStressor<LruAllocator>>(
-          cacheConfig, stressorConfig, std::move(generator));
-    } else if (cacheConfig.allocator == "LRU2Q") {
-      return std::make_unique<CacheStressor<Lru2QAllocator>>(
-          cacheConfig, stressorConfig, std::move(generator));
-    } else if (cacheConfig.allocator == "TINYLFU") {
-      return std::make_unique<CacheStressor<TinyLFUAllocator>>(
-          cacheConfig, stressorConfig, std::move(generator));
-    } else if (cacheConfig.allocator == "SIMPLE3Q") {
-      return std::make_unique<CacheStressor<Simple3QAllocator>>(
-          cacheConfig, stressorConfig, std::move(generator));
-    } else if (cacheConfig.allocator == "SIMPLE2Q") {
-      return std::make_unique<CacheStressor<Simple2QAllocator>>(
-          cacheConfig, stressorConfig, std::move(generator));
-    } else if (cacheConfig.allocator == "TINYLFUTail") {
-      return std::make_unique<CacheStressor<TinyLFUTailAllocator>>(
-          cacheConfig, stressorConfig, std::move(generator));
-    } else if (cacheConfig.allocator == "S3FIFO") {
-      printf("Creating S3FIFO Stressor\n");
-      return std::make_unique<CacheStressor<S3FIFOAllocator>>(
-          cacheConfig, stressorConfig, std::move(generator));
-    }
+    return makeStressor(cacheConfig, stressorConfig,
+                        makeGenerator(stressorConfig));
+  }
+  throw std::invalid_argument("Invalid config");
+}
+
+std::unique_ptr<Stressor> Stressor::makeStressor(
+    const CacheConfig& cacheConfig,
+    const StressorConfig& stressorConfig,
+    std::unique_ptr<GeneratorBase> generator) {
+  if (cacheConfig.allocator == "LRU") {
+    // default allocator is LRU, other allocator types should be added here
+    return std::make_unique<CacheStressor<LruAllocator>>(
+        cacheConfig, stressorConfig, std::move(generator));
+  } else if (cacheConfig.allocator == "LRU2Q") {
+    return std::make_unique<CacheStressor<Lru2QAllocator>>(
+        cacheConfig, stressorConfig, std::move(generator));
+  } else if (cacheConfig.allocator == "TINYLFU") {
+    return std::make_unique<CacheStressor<TinyLFUAllocator>>(
+        cacheConfig, stressorConfig, std::move(generator));
+  } else if (cacheConfig.allocator == "SIMPLE3Q") {
+    return std::make_unique<CacheStressor<Simple3QAllocator>>(
+        cacheConfig, stressorConfig, std::move(generator));
+  } else if (cacheConfig.allocator == "SIMPLE2Q") {
+    return std::make_unique<CacheStressor<Simple2QAllocator>>(
+        cacheConfig, stressorConfig, std::move(generator));
+  } else if (cacheConfig.allocator == "TINYLFUTail") {
+    return std::make_unique<CacheStressor<TinyLFUTailAllocator>>(
+        cacheConfig, stressorConfig, std::move(generator));
+  } else if (cacheConfig.allocator == "S3FIFO") {
+    printf("Creating S3FIFO Stressor\n");
+    return std::make_unique<CacheStressor<S3FIFOAllocator>>(
+        cacheConfig, stressorConfig, std::move(generator));
   }
   throw std::invalid_argument("Invalid config");
 }
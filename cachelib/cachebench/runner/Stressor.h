@@ -69,6 +69,13 @@ class Stressor {
   static std::unique_ptr<Stressor> makeStressor(
       const CacheConfig& cacheConfig, const StressorConfig& stressorConfig);
 
+  // create a cache stressor that replays requests from the given generator
+  // instead of the one described by the stressor config.
+  static std::unique_ptr<Stressor> makeStressor(
+      const CacheConfig& cacheConfig,
+      const StressorConfig& stressorConfig,
+      std::unique_ptr<GeneratorBase> generator);
+
   virtual ~Stressor() {}
 
   // report the stats from the cache  while the stress test is being run.
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cachelib/cachebench/runner/SweepRunner.h"
+
+#include <folly/Format.h>
+
+#include <fstream>
+#include <iostream>
+
+#include "cachelib/cachebench/runner/Runner.h"
+#include "cachelib/cachebench/workload/TraceBroadcaster.h"
+#include "cachelib/common/PerfCounters.h"
+
+namespace facebook {
+namespace cachelib {
+namespace cachebench {
+namespace {
+// The experiments replay one stream of records, so everything that decides
+// which records are read and how time advances has to agree.
+void checkSameTrace(const StressorConfig& a,
+                    const StressorConfig& b,
+                    const std::string& dir) {
+  if (a.generator != b.generator || a.traceFileName != b.traceFileName ||
+      a.zstdTrace != b.zstdTrace || a.compressed != b.compressed ||
+      a.useTraceTimer != b.useTraceTimer) {
+    throw std::invalid_argument(folly::sformat(
+        "{} does not replay the same trace as the other experiments", dir));
+  }
+}
+} // namespace
+
+SweepRunner::SweepRunner(const std::vector<std::string>& dirs,
+                         size_t ringRecords) {
+  if (dirs.empty()) {
+    throw std::invalid_argument("No experiments to run");
+  }
+  std::vector<CacheBenchConfig> configs;
+  for (const auto& dir : dirs) {
+    configs.emplace_back(dir + "/config.json");
+    const auto& stressorConfig = configs.back().getStressorConfig();
+    if (stressorConfig.generator != "oracle-general-replay") {
+      throw std::invalid_argument(folly::sformat(
+          "{}: sweeps only replay oracle-general-replay traces", dir));
+    }
+    checkSameTrace(configs.front().getStressorConfig(), stressorConfig, dir);
+    // the hardware counters are process wide and shared by all experiments
+    if (configs.back().getCacheConfig().perfCountersEveryXOps !=
+        configs.front().getCacheConfig().perfCountersEveryXOps) {
+      throw std::invalid_argument(folly::sformat(
+          "{} samples hardware counters at a different rate than the other "
+          "experiments",
+          dir));
+    }
+  }
+  PerfCounters::setSampleEvery(static_cast<uint32_t>(
+      configs.front().getCacheConfig().perfCountersEveryXOps));
+
+  const auto& first = configs.front().getStressorConfig();
+  broadcaster_ = std::make_shared<TraceBroadcaster>(
+      first, static_cast<uint32_t>(dirs.size()), ringRecords,
+      first.useTraceTimer);
+  for (size_t i = 0; i < dirs.size(); i++) {
+    const auto& config = configs[i];
+    auto generator = std::make_unique<BroadcastReplayGenerator>(
+        config.getStressorConfig(), broadcaster_, static_cast<uint32_t>(i));
+    experiments_.push_back(
+        {dirs[i],
+         Stressor::makeStressor(config.getCacheConfig(),
+                                config.getStressorConfig(),
+                                std::move(generator))});
+  }
+}
+
+SweepRunner::~SweepRunner() = default;
+
+bool SweepRunner::run() {
+  for (auto& e : experiments_) {
+    e.stressor->start();
+  }
+  broadcaster_->start();
+  std::cout << folly::sformat("Replaying the trace for {} experiments",
+                              experiments_.size())
+            << std::endl;
+
+  for (auto& e : experiments_) {
+    e.stressor->finish();
+  }
+
+  bool passed = true;
+  for (auto& e : experiments_) {
+    std::ofstream log(e.dir + "/log.txt");
+    auto cacheStats = Runner::renderResults(*e.stressor, log,
+                                            e.dir + "/result.json",
+                                            e.dir + "/tx");
+    e.stressor.reset();
+    bool ok = cacheStats.renderIsTestPassed(log);
+    std::cout << folly::sformat("{}: {}", e.dir, ok ? "passed" : "failed")
+              << std::endl;
+    passed = passed && ok;
+  }
+  std::cout << folly::sformat("Trace records: {}, producer waits: {}",
+                              broadcaster_->getRecords(),
+                              broadcaster_->getProducerWaits())
+            << std::endl;
+
+  if (aborted_) {
+    std::cerr << "Test aborted.\n";
+    passed = false;
+  }
+  return passed;
+}
+
+void SweepRunner::abort() {
+  aborted_ = true;
+  for (auto& e : experiments_) {
+    if (e.stressor) {
+      e.stressor->abort();
+    }
+  }
+}
+} // namespace cachebench
+} // namespace cachelib
+} // namespace facebook
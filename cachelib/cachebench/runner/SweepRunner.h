@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cachelib/cachebench/runner/Stressor.h"
+#include "cachelib/cachebench/util/Config.h"
+
+namespace facebook {
+namespace cachelib {
+namespace cachebench {
+
+class TraceBroadcaster;
+
+// Runs several cachebench experiments over the same trace in one pass.
+//
+// Every experiment directory holds a config.json as used by Runner. The
+// trace is decoded once by a TraceBroadcaster and every request is fanned
+// out to one cache instance per experiment, each replayed by its own
+// stressor thread. The cache configs may differ freely; the trace related
+// parts of the test configs (trace file, generator, trace timer) must match.
+//
+// Each experiment writes the same outputs as a standalone cachebench run
+// with --dump_result_json_file and --dump_tx_file into its directory:
+// result.json, tx.<uuid>.json and the printed results in log.txt.
+class SweepRunner {
+ public:
+  // @param dirs          experiment directories
+  // @param ringRecords   trace records buffered ahead of the slowest
+  //                      experiment
+  //
+  // @throw std::invalid_argument if the experiments can not share a trace
+  SweepRunner(const std::vector<std::string>& dirs, size_t ringRecords);
+  ~SweepRunner();
+
+  // @return true if every experiment passed, false otherwise.
+  bool run();
+
+  void abort();
+
+ private:
+  struct Experiment {
+    std::string dir;
+    std::unique_ptr<Stressor> stressor;
+  };
+
+  std::shared_ptr<TraceBroadcaster> broadcaster_;
+  std::vector<Experiment> experiments_;
+
+  std::atomic<bool> aborted_{false};
+};
+} // namespace cachebench
+} // namespace cachelib
+} // namespace facebook
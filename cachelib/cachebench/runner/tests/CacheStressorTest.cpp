@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <folly/Conv.h>
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cachelib/cachebench/runner/CacheStressor.h"
+#include "cachelib/cachebench/workload/ReplayGeneratorBase.h"
+
+namespace facebook {
+namespace cachelib {
+namespace cachebench {
+namespace test {
+namespace {
+// Replays gets for a new key on every request. Like the KV and piecewise
+// generators, it does not drive a logical clock.
+class SimpleReplayGenerator : public ReplayGeneratorBase {
+ public:
+  explicit SimpleReplayGenerator(const StressorConfig& config)
+      : ReplayGeneratorBase(config) {}
+
+  const Request& getReq(uint8_t,
+                        std::mt19937_64&,
+                        std::optional<uint64_t>) override {
+    key_ = folly::to<std::string>(next_++);
+    return req_;
+  }
+
+ private:
+  uint64_t next_{0};
+  std::string key_;
+  std::vector<size_t> sizes_{100};
+  Request req_{key_, sizes_.begin(), sizes_.end(), OpType::kGet};
+};
+} // namespace
+
+// Only the oracleGeneral binary generator drives the logical clock. Others
+// keep waking up the rebalancer per request under deterministicReplay.
+TEST(CacheStressorTest, DeterministicReplayWithoutLogicalClock) {
+  CacheConfig cacheConfig;
+  cacheConfig.cacheSizeMB = 64;
+  cacheConfig.rebalanceStrategy = "default";
+  cacheConfig.poolRebalanceIntervalSec = 1;
+  cacheConfig.wakeUpRebalancerEveryXReqs = 100;
+  cacheConfig.syncRebalance = true;
+
+  StressorConfig config;
+  config.numOps = 1000;
+  config.numThreads = 1;
+  config.deterministicReplay = true;
+
+  auto wg = std::make_unique<SimpleReplayGenerator>(config);
+  EXPECT_FALSE(wg->setLogicalClockCallback([](uint64_t t) { return t + 1; }));
+
+  CacheStressor<LruAllocator> stressor{cacheConfig, config, std::move(wg)};
+  stressor.start();
+  stressor.finish();
+  EXPECT_GE(stressor.getRebalancerWakeUps(), 9u);
+}
+} // namespace test
+} // namespace cachebench
+} // namespace cachelib
+} // namespace facebook
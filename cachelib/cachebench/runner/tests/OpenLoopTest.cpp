@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "cachelib/cachebench/runner/OpenLoop.h"
+
+namespace facebook {
+namespace cachelib {
+namespace cachebench {
+namespace test {
+namespace {
+using Clock = OpenLoopClock::Clock;
+using namespace std::chrono_literals;
+
+// at this speed a trace second is replayed in a millisecond
+constexpr double kFastSpeed = 1000;
+
+// the send time of a request in a trace second, relative to the anchor
+std::chrono::nanoseconds sendTime(uint64_t secs,
+                                  std::chrono::nanoseconds offset) {
+  return (std::chrono::nanoseconds{std::chrono::seconds{
+              static_cast<int64_t>(secs)}} +
+          offset) /
+         static_cast<int64_t>(kFastSpeed);
+}
+} // namespace
+
+TEST(OpenLoopClock, InvalidSpeed) {
+  EXPECT_THROW(OpenLoopClock{0}, std::invalid_argument);
+  EXPECT_THROW(OpenLoopClock{-1}, std::invalid_argument);
+}
+
+TEST(OpenLoopClock, IntendedTime) {
+  const auto before = Clock::now();
+  OpenLoopClock clock{kFastSpeed};
+  // the first timestamp is anchored to now
+  const auto anchor = clock.intendedTime(100, 0ns);
+  EXPECT_GE(anchor, before);
+  EXPECT_LE(anchor, Clock::now());
+
+  EXPECT_EQ(sendTime(1, 0ns), clock.intendedTime(101, 0ns) - anchor);
+  EXPECT_EQ(sendTime(10, 500ms), clock.intendedTime(110, 500ms) - anchor);
+
+  // requests older than the anchor are due at once
+  EXPECT_EQ(anchor, clock.intendedTime(99, 0ns));
+  EXPECT_EQ(anchor, clock.intendedTime(0, 500ms));
+}
+
+TEST(OpenLoopPacer, Schedule) {
+  OpenLoopClock clock{kFastSpeed};
+  OpenLoopPacer pacer{clock};
+  auto pace = [&pacer](uint64_t secs, size_t n) {
+    std::vector<Clock::time_point> times;
+    for (size_t i = 0; i < n; i++) {
+      times.push_back(pacer.pace(secs));
+      // the pacer sleeps until the request is due
+      EXPECT_GE(Clock::now(), times.back());
+    }
+    return times;
+  };
+
+  // without a previous second to estimate from, all requests of the first
+  // second are due at its start
+  const auto first = pace(10, 3);
+  const auto anchor = first[0];
+  for (auto t : first) {
+    EXPECT_EQ(anchor, t);
+  }
+
+  // 4 requests in the previous second spread the next 4 evenly over it
+  pace(11, 4);
+  const auto spread = pace(12, 4);
+  for (size_t i = 0; i < spread.size(); i++) {
+    EXPECT_EQ(sendTime(2, static_cast<int64_t>(i) * 250ms),
+              spread[i] - anchor);
+  }
+
+  // a second busier than the last one bunches up at its end
+  const auto busy = pace(13, 6);
+  for (size_t i = 0; i < busy.size(); i++) {
+    EXPECT_EQ(sendTime(3, std::min<int64_t>(i, 3) * 250ms), busy[i] - anchor);
+  }
+
+  // a gap in the trace leaves no estimate for the new second
+  const auto gap = pace(15, 2);
+  for (auto t : gap) {
+    EXPECT_EQ(sendTime(5, 0ns), t - anchor);
+  }
+}
+
+TEST(OpenLoopPacer, FallsBehind) {
+  // a trace second is replayed in 100ms
+  OpenLoopClock clock{10};
+  OpenLoopPacer pacer{clock};
+  const auto anchor = pacer.pace(10);
+  std::this_thread::sleep_for(50ms);
+
+  // a thread that is behind gets back the time the request was due, without
+  // sleeping, so that its lateness is part of the latency
+  const auto before = Clock::now();
+  EXPECT_EQ(anchor, pacer.pace(10));
+  EXPECT_EQ(anchor, pacer.pace(9));
+  EXPECT_LT(Clock::now() - before, 500ms);
+  EXPECT_GE(before - anchor, 50ms);
+
+  // the next second is still due on schedule
+  EXPECT_EQ(anchor + 100ms, pacer.pace(11));
+  EXPECT_GE(Clock::now(), anchor + 100ms);
+}
+} // namespace test
+} // namespace cachebench
+} // namespace cachelib
+} // namespace facebook
@@ -16,6 +16,8 @@
 
 #include "cachelib/cachebench/util/CacheConfig.h"
 
+#include <limits>
+
 #include "cachelib/allocator/FreeMemStrategy.h"
 #include "cachelib/allocator/HitsPerSlabStrategy.h"
 #include "cachelib/allocator/HitsPerSlabToggleStrategy.h"
@@ -41,6 +43,9 @@ CacheConfig::CacheConfig(const folly::dynamic& configJson) {
   JSONSetVal(configJson, poolRebalancerDisableForcedWakeUp);
   JSONSetVal(configJson, wakeUpRebalancerEveryXReqs);
   JSONSetVal(configJson, anomalyDetectionFrequency);
+  JSONSetVal(configJson, statsSeriesFile);
+  JSONSetVal(configJson, statsSeriesEveryXReqs);
+  JSONSetVal(configJson, perfCountersEveryXOps);
   JSONSetVal(configJson, useAdaptiveRebalanceInterval);
   JSONSetVal(configJson, useAdaptiveRebalanceIntervalV2);
   JSONSetVal(configJson, syncRebalance);
@@ -79,6 +84,7 @@ CacheConfig::CacheConfig(const folly::dynamic& configJson) {
   JSONSetVal(configJson, enableTailHitsTracking);
   JSONSetVal(configJson, tailSlabCnt);
   JSONSetVal(configJson, enableShardsMrc);
+  JSONSetVal(configJson, enableExactMrc);
   JSONSetVal(configJson, mhFilterReceiverByEvictionRate);
   JSONSetVal(configJson, mhDecayWithHits);
   JSONSetVal(configJson, mhAutoDecThreshold);
@@ -138,6 +144,9 @@ CacheConfig::CacheConfig(const folly::dynamic& configJson) {
   JSONSetVal(configJson, navyBigHashBucketSize);
   JSONSetVal(configJson, navyBloomFilterPerBucketSize);
   JSONSetVal(configJson, navySmallItemMaxSize);
+  JSONSetVal(configJson, navySmallItemAdaptiveBucketSize);
+  JSONSetVal(configJson, navySmallItemAdaptiveIntervalSecs);
+  JSONSetVal(configJson, navySmallItemAdaptiveHysteresisPct);
   JSONSetVal(configJson, navyParcelMemoryMB);
   JSONSetVal(configJson, navyHitsReinsertionThreshold);
   JSONSetVal(configJson, navyProbabilityReinsertionThreshold);
@@ -152,6 +161,11 @@ CacheConfig::CacheConfig(const folly::dynamic& configJson) {
   JSONSetVal(configJson, navyCleanRegionThreads);
   JSONSetVal(configJson, navyAdmissionWriteRateMB);
   JSONSetVal(configJson, navyMaxConcurrentInserts);
+  JSONSetVal(configJson, nvmWritebackBatchBytes);
+  JSONSetVal(configJson, nvmWritebackBatchMaxDelayUs);
+  JSONSetVal(configJson, nvmPromotionMinFlashHits);
+  JSONSetVal(configJson, nvmPromotionMinItemSize);
+  JSONSetVal(configJson, nvmPromoteCold);
   JSONSetVal(configJson, navyDataChecksum);
   JSONSetVal(configJson, navyNumInmemBuffers);
   JSONSetVal(configJson, truncateItemToOriginalAllocSizeInNvm);
@@ -163,6 +177,7 @@ CacheConfig::CacheConfig(const folly::dynamic& configJson) {
 
   JSONSetVal(configJson, usePosixShm);
   JSONSetVal(configJson, lockMemory);
+  JSONSetVal(configJson, simulate);
   if (configJson.count("memoryTiers")) {
     for (auto& it : configJson["memoryTiers"]) {
       memoryTierConfigs.push_back(
@@ -176,6 +191,8 @@ CacheConfig::CacheConfig(const folly::dynamic& configJson) {
   JSONSetVal(configJson, enableItemDestructorCheck);
   JSONSetVal(configJson, enableItemDestructor);
   JSONSetVal(configJson, nvmAdmissionRetentionTimeThreshold);
+  JSONSetVal(configJson, nvmAdmissionFlashRetentionSecs);
+  JSONSetVal(configJson, nvmAdmissionWriteBudgetMBPerSec);
 
   JSONSetVal(configJson, customConfigJson);
 
@@ -184,7 +201,7 @@ CacheConfig::CacheConfig(const folly::dynamic& configJson) {
   // if you added new fields to the configuration, update the JSONSetVal
   // to make them available for the json configs and increment the size
   // below
-  checkCorrectSize<CacheConfig, 1064>();
+  checkCorrectSize<CacheConfig, 1160>();
 
   if (numPools != poolSizes.size()) {
     throw std::invalid_argument(folly::sformat(
@@ -192,6 +209,10 @@ CacheConfig::CacheConfig(const folly::dynamic& configJson) {
         "numPools: {}, poolSizes.size(): {}",
         numPools, poolSizes.size()));
   }
+  if (perfCountersEveryXOps > std::numeric_limits<uint32_t>::max()) {
+    throw std::invalid_argument(folly::sformat(
+        "perfCountersEveryXOps is too large: {}", perfCountersEveryXOps));
+  }
 }
 
 std::shared_ptr<RebalanceStrategy> CacheConfig::getRebalanceStrategy() const {
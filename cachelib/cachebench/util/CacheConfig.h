@@ -83,6 +83,20 @@ struct CacheConfig : public JSONConfig {
   bool poolRebalancerDisableForcedWakeUp{false};
   uint64_t wakeUpRebalancerEveryXReqs{0};
   uint64_t anomalyDetectionFrequency{0}; // disabled
+  // Binary stats series (see cachelib/common/StatsSeries.h). If set, the
+  // miss ratio, delta stats, slab movements and rebalance decisions are
+  // written to this file, along with the per-class hits, evictions, tail
+  // hits, slabs and eviction age every statsSeriesEveryXReqs requests, or at
+  // every rebalance if that is 0.
+  std::string statsSeriesFile{""};
+  uint64_t statsSeriesEveryXReqs{0};
+  // If set, sample the hardware counters (cycles, instructions, LLC and dTLB
+  // misses) of every perfCountersEveryXOps-th entry of the cache hot paths and
+  // the rebalancer on every thread, and report them with the cycles of the
+  // stressor threads. The counters are process wide, so the runner sets the
+  // rate once and all experiments of a sweep must agree on it. See
+  // cachelib/common/PerfCounters.h.
+  uint64_t perfCountersEveryXOps{0};
   unsigned int increaseIntervalFactor{2};
   bool syncRebalance{false};
   bool useAdaptiveRebalanceInterval{false};
@@ -133,6 +147,10 @@ struct CacheConfig : public JSONConfig {
   bool enableTailHitsTracking{false};
   unsigned int tailSlabCnt{1};
   bool enableShardsMrc{false};
+  // Analysis mode: compute the exact per-class miss ratio curves and report
+  // the error of the footprint and Shards estimators at every rebalance.
+  // Keeps one entry per distinct key, so only meant for offline runs.
+  bool enableExactMrc{false};
   bool mhFilterReceiverByEvictionRate{false};
   bool mhDecayWithHits{false};
   bool mhEnableOnlineLearning{false};
@@ -251,6 +269,18 @@ struct CacheConfig : public JSONConfig {
   // can be admitted into Big Hash engine.
   uint64_t navySmallItemMaxSize = 2048;
 
+  // If non-zero, the small item max size above is only where Navy starts and
+  // it is learned from the hits per byte written of BigHash and BlockCache,
+  // moving by buckets of this many bytes.
+  uint64_t navySmallItemAdaptiveBucketSize = 0;
+
+  // How often the learned small item max size is re-evaluated.
+  uint64_t navySmallItemAdaptiveIntervalSecs = 60;
+
+  // By how many percent one engine has to lead in hits per byte written for
+  // the learned small item max size to move.
+  uint64_t navySmallItemAdaptiveHysteresisPct = 20;
+
   // total memory limit for in-flight insertion operations for NVM. Once this is
   // reached, requests will be rejected until the memory usage gets under
   // the limit.
@@ -294,6 +324,19 @@ struct CacheConfig : public JSONConfig {
   // maximum pending inserts before rejecting new inserts.
   uint32_t navyMaxConcurrentInserts{1000000};
 
+  // bytes of evicted items written to navy in one batch. disabled when 0
+  uint32_t nvmWritebackBatchBytes{0};
+
+  // longest time a partial writeback batch waits for more items
+  uint32_t nvmWritebackBatchMaxDelayUs{1000};
+
+  // flash hits on a key before a hit inserts the item into DRAM. Earlier hits
+  // return the item without inserting it. 1 promotes on every hit.
+  uint32_t nvmPromotionMinFlashHits{1};
+
+  // items smaller than this are promoted on every flash hit
+  uint32_t nvmPromotionMinItemSize{0};
+
   // enables data checksuming for navy. metadata checksum is enabled by
   // default
   bool navyDataChecksum{true};
@@ -304,6 +347,9 @@ struct CacheConfig : public JSONConfig {
   // by default, we do not encrypt content in Navy
   bool navyEncryption = false;
 
+  // insert items promoted from flash into the cold queue of MM2Q
+  bool nvmPromoteCold = false;
+
   // number of navy in-memory buffers
   uint32_t navyNumInmemBuffers{30};
 
@@ -324,6 +370,16 @@ struct CacheConfig : public JSONConfig {
   // Lock memory in the RAM
   bool lockMemory{false};
 
+  // Simulate the cache for miss-ratio and slab-rebalancing studies. Items are
+  // still allocated, evicted, moved and rebalanced through the real slab
+  // allocator and MMContainers, and item sizes still come from the workload,
+  // but values are never initialized, written, read or copied. Slab memory
+  // that only backs values is therefore never paged in.
+  // Transparent huge pages are disabled for the entire process
+  // (PR_SET_THP_DISABLE), not just for this cache, and stay disabled after the
+  // cache is destroyed.
+  bool simulate{false};
+
   // Memory tiers configs
   std::vector<MemoryTierCacheConfig> memoryTierConfigs{};
 
@@ -355,6 +411,13 @@ struct CacheConfig : public JSONConfig {
   // eviction-age is more than this threshold. 0 means no threshold
   uint32_t nvmAdmissionRetentionTimeThreshold{0};
 
+  // If specified, we admit items into NvmCache only if the eviction signals
+  // of their class predict a reuse within this many seconds. 0 means disabled
+  uint32_t nvmAdmissionFlashRetentionSecs{0};
+
+  // flash write budget of the above admission policy. 0 means no budget
+  uint32_t nvmAdmissionWriteBudgetMBPerSec{0};
+
   //
   // Options below are not to be populated with JSON
   //
@@ -59,6 +59,7 @@ StressorConfig::StressorConfig(const folly::dynamic& configJson) {
   JSONSetVal(configJson, zstdTrace);
   JSONSetVal(configJson, compressed);
   JSONSetVal(configJson, ignoreLargeReq);
+  JSONSetVal(configJson, traceReaderThreads);
   JSONSetVal(configJson, configPath);
 
   JSONSetVal(configJson, cachePieceSize);
@@ -67,6 +68,10 @@ StressorConfig::StressorConfig(const folly::dynamic& configJson) {
   JSONSetVal(configJson, maxInvalidDestructorCount);
 
   JSONSetVal(configJson, repeatTraceReplay);
+  JSONSetVal(configJson, deterministicReplay);
+  JSONSetVal(configJson, openLoopReplay);
+  JSONSetVal(configJson, replaySpeed);
+  JSONSetVal(configJson, latencyIntervalMs);
   JSONSetVal(configJson, timestampFactor);
 
   JSONSetVal(configJson, checkNvmCacheWarmUp);
@@ -86,6 +91,11 @@ StressorConfig::StressorConfig(const folly::dynamic& configJson) {
         ReplayGeneratorConfig{configJson["replayGeneratorConfig"]};
   }
 
+  if (configJson.count("phasedGeneratorConfig")) {
+    phasedGeneratorConfig =
+        PhasedGeneratorConfig{configJson["phasedGeneratorConfig"]};
+  }
+
   if (!traceFileName.empty() && !traceFileNames.empty()) {
     throw std::invalid_argument(
         folly::sformat("set only one of traceFileName or traceFileNames"));
@@ -94,7 +104,7 @@ StressorConfig::StressorConfig(const folly::dynamic& configJson) {
   // If you added new fields to the configuration, update the JSONSetVal
   // to make them available for the json configs and increment the size
   // below
-  checkCorrectSize<StressorConfig, 520>();
+  checkCorrectSize<StressorConfig, 576>();
 }
 
 bool StressorConfig::usesChainedItems() const {
@@ -237,6 +247,45 @@ ReplayGeneratorConfig::getSerializationMode() const {
   return ReplayGeneratorConfig::SerializeMode::strict;
 }
 
+PhasedKeyspaceConfig::PhasedKeyspaceConfig(const folly::dynamic& configJson) {
+  JSONSetVal(configJson, numKeys);
+  JSONSetVal(configJson, popularity);
+  JSONSetVal(configJson, alpha);
+  JSONSetVal(configJson, share);
+  JSONSetVal(configJson, valSizeRange);
+  JSONSetVal(configJson, valSizeRangeProbability);
+  JSONSetVal(configJson, hotSetSize);
+  JSONSetVal(configJson, hotSetProbability);
+  JSONSetVal(configJson, hotSetChurnEveryXReqs);
+
+  checkCorrectSize<PhasedKeyspaceConfig, 128>();
+}
+
+PhaseConfig::PhaseConfig(const folly::dynamic& configJson) {
+  JSONSetVal(configJson, numRequests);
+  JSONSetVal(configJson, setRatio);
+  JSONSetVal(configJson, delRatio);
+  if (configJson.count("keyspaces")) {
+    for (const auto& it : configJson["keyspaces"]) {
+      keyspaces.emplace_back(it);
+    }
+  }
+
+  checkCorrectSize<PhaseConfig, 48>();
+}
+
+PhasedGeneratorConfig::PhasedGeneratorConfig(const folly::dynamic& configJson) {
+  JSONSetVal(configJson, seed);
+  JSONSetVal(configJson, requestsPerSecond);
+  if (configJson.count("phases")) {
+    for (const auto& it : configJson["phases"]) {
+      phases.emplace_back(it);
+    }
+  }
+
+  checkCorrectSize<PhasedGeneratorConfig, 40>();
+}
+
 MLAdmissionConfig::MLAdmissionConfig(const folly::dynamic& configJson) {
   JSONSetVal(configJson, modelPath);
   JSONSetVal(configJson, numericFeatures);
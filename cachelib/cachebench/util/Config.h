@@ -170,6 +170,59 @@ class StressorAdmPolicy {
   }
 };
 
+// One keyspace of a phase of the phased generator. Keyspaces are matched by
+// their position across phases, so a later phase can change the popularity
+// or the sizes of the same keys.
+struct PhasedKeyspaceConfig : public JSONConfig {
+  PhasedKeyspaceConfig() {}
+  explicit PhasedKeyspaceConfig(const folly::dynamic& configJson);
+
+  uint64_t numKeys{0};
+
+  // zipf, uniform, scan (sequential over the keyspace) or hotset (a window
+  // of hotSetSize keys taking hotSetProbability of the accesses, moving by
+  // its size every hotSetChurnEveryXReqs requests)
+  std::string popularity{"zipf"};
+  double alpha{1.0};
+
+  // relative share of the requests of the phase going to this keyspace
+  double share{1.0};
+
+  // value sizes as in DistributionConfig: valSizeRange has one more entry
+  // than valSizeRangeProbability. A key keeps its size within a phase.
+  std::vector<double> valSizeRange{};
+  std::vector<double> valSizeRangeProbability{};
+
+  uint64_t hotSetSize{0};
+  double hotSetProbability{0.9};
+  uint64_t hotSetChurnEveryXReqs{0};
+};
+
+struct PhaseConfig : public JSONConfig {
+  PhaseConfig() {}
+  explicit PhaseConfig(const folly::dynamic& configJson);
+
+  // length of the phase in requests over all stressor threads
+  uint64_t numRequests{0};
+  // the rest of the requests are gets
+  double setRatio{0.0};
+  double delRatio{0.0};
+
+  std::vector<PhasedKeyspaceConfig> keyspaces;
+};
+
+struct PhasedGeneratorConfig : public JSONConfig {
+  PhasedGeneratorConfig() {}
+  explicit PhasedGeneratorConfig(const folly::dynamic& configJson);
+
+  uint64_t seed{1};
+  // request timestamps advance by one second every requestsPerSecond
+  // requests
+  uint64_t requestsPerSecond{1000 * 1000};
+  // run in order and repeated until the end of the test
+  std::vector<PhaseConfig> phases;
+};
+
 struct StressorConfig : public JSONConfig {
   // Which workload generator to use, default is
   // workload generator which samples from some distribution
@@ -179,6 +232,9 @@ struct StressorConfig : public JSONConfig {
   // Valid when generator is replay generator
   ReplayGeneratorConfig replayGeneratorConfig;
 
+  // Valid when generator is phased
+  PhasedGeneratorConfig phasedGeneratorConfig;
+
   // name identifying a custom type of the stress test. When empty, launches a
   // standard stress test using the workload config against an instance of the
   // cache defined by the CacheConfig. Other supported options are
@@ -250,6 +306,9 @@ struct StressorConfig : public JSONConfig {
   bool zstdTrace{false};
   bool compressed{true};
   bool ignoreLargeReq{false}; // ignore large requests in the trace file
+  // number of threads decompressing a zstd trace ahead of the replay. Only
+  // traces made of multiple zstd frames can use more than one thread.
+  uint32_t traceReaderThreads{1};
 
   // location of the path for the files referenced inside the json. If not
   // specified, it defaults to the path of the json file being parsed.
@@ -266,6 +325,20 @@ struct StressorConfig : public JSONConfig {
   // and again until the number of operations specified in the test config.
   bool repeatTraceReplay{false};
 
+  // If enabled, a trace replay keeps rebalancer wake-ups, anomaly detection
+  // and interval resets at fixed positions in the trace regardless of the
+  // number of stressor threads. Requests for one key always go to the same
+  // thread in trace order.
+  bool deterministicReplay{false};
+
+  // If enabled, requests are sent at their trace timestamps, scaled down by
+  // replaySpeed, instead of as fast as possible. Latency is measured from the
+  // intended send time, so a stalled cache shows up as queueing delay of the
+  // requests behind it, and is reported every latencyIntervalMs.
+  bool openLoopReplay{false};
+  double replaySpeed{1.0};
+  uint64_t latencyIntervalMs{1000};
+
   // Max number of invalid destructor detection (destructor call more than once
   // for an item or wrong version).
   uint64_t maxInvalidDestructorCount{50};
@@ -19,6 +19,7 @@
 #include <folly/Benchmark.h>
 
 #include <atomic>
+#include <functional>
 
 #include "cachelib/cachebench/util/Request.h"
 
@@ -28,6 +29,12 @@ namespace cachebench {
 
 class GeneratorBase {
  public:
+  // Invoked with the current logical time (number of requests dispatched so
+  // far) once every earlier request has completed and before any later one is
+  // handed out. Returns the logical time of the next invocation, which must be
+  // larger than the current one.
+  using LogicalClockCallback = std::function<uint64_t(uint64_t)>;
+
   virtual ~GeneratorBase() {}
 
   // Grab the next request given the last request in the sequence or using the
@@ -73,6 +80,13 @@ class GeneratorBase {
   // Should be called when working thread finish its operations
   virtual void markFinish() {}
 
+  // Register the callback driving global events (e.g. rebalancer wake-ups)
+  // off the generator's logical clock. The first invocation happens at
+  // logical time 0. Returns false if the generator does not support it.
+  virtual bool setLogicalClockCallback(LogicalClockCallback /*cb*/) {
+    return false;
+  }
+
  protected:
   bool shouldShutdown() const {
     return isShutdown_.load(std::memory_order_relaxed);
@@ -18,16 +18,20 @@
 
 #include <folly/Conv.h>
 #include <folly/ProducerConsumerQueue.h>
+#include <folly/ScopeGuard.h>
 #include <folly/ThreadLocal.h>
 #include <folly/lang/Aligned.h>
 #include <folly/logging/xlog.h>
 #include <folly/system/ThreadName.h>
 
+#include <cstdio>
+
 #include "cachelib/cachebench/cache/Cache.h"
 #include "cachelib/cachebench/util/Exceptions.h"
 #include "cachelib/cachebench/util/Parallel.h"
 #include "cachelib/cachebench/util/Request.h"
 #include "cachelib/cachebench/workload/ReplayGeneratorBase.h"
+#include "cachelib/cachebench/workload/ReqWrapperPool.h"
 
 namespace facebook {
 namespace cachelib {
@@ -46,6 +50,27 @@ struct ReqWrapper {
              other.req_),
         repeats_(other.repeats_) {}
 
+  // Overwrite this wrapper with the request carried by other. Unlike the copy
+  // constructor, this keeps the request id and reuses the key and size
+  // buffers, so recycled wrappers do not allocate.
+  void copyFrom(const ReqWrapper& other) {
+    key_.assign(other.key_);
+    sizes_.assign(other.sizes_.begin(), other.sizes_.end());
+    req_.sizeBegin = sizes_.begin();
+    req_.sizeEnd = sizes_.end();
+    req_.setOp(other.req_.getOp());
+    req_.ttlSecs = other.req_.ttlSecs;
+    req_.timestamp = other.req_.timestamp;
+    repeats_ = other.repeats_;
+  }
+
+  // Clear the per-request fields that parsing only sets when present.
+  void reset() {
+    req_.ttlSecs = 0;
+    req_.timestamp = 0;
+    repeats_ = 0;
+  }
+
   // current outstanding key
   std::string key_;
   std::vector<size_t> sizes_{1};
@@ -93,7 +118,11 @@ class KVReplayGenerator : public ReplayGeneratorBase {
       {SampleFields::TTL, false, {"ttl"}}};
 
   explicit KVReplayGenerator(const StressorConfig& config)
-      : ReplayGeneratorBase(config), traceStream_(config, 0, columnTable_) {
+      : ReplayGeneratorBase(config),
+        traceStream_(config, 0, columnTable_),
+        reqPool_(numShards_,
+                 numShards_ * (kMaxRequests + kMaxInFlightPerShard),
+                 kKeyCapacity) {
     for (uint32_t i = 0; i < numShards_; ++i) {
       stressorCtxs_.emplace_back(std::make_unique<StressorCtx>(i));
     }
@@ -128,6 +157,8 @@ class KVReplayGenerator : public ReplayGeneratorBase {
                           "Total Processed Samples",
                           (double)parseSuccess.load() / 1e6, parseError.load())
         << std::endl;
+    out << folly::sformat("{}: {}", "Request Pool Waits", poolWaits.load())
+        << std::endl;
   }
 
   void notifyResult(uint64_t requestId, OpResultType result) override;
@@ -135,7 +166,7 @@ class KVReplayGenerator : public ReplayGeneratorBase {
   void markFinish() override { getStressorCtx().markFinish(); }
 
   // Parse the request from the trace line and set the ReqWrapper
-  bool parseRequest(const std::string& line, std::unique_ptr<ReqWrapper>& req);
+  bool parseRequest(const std::string& line, ReqWrapper& req);
 
   // for unit test
   bool setHeaderRow(const std::string& header) {
@@ -150,8 +181,14 @@ class KVReplayGenerator : public ReplayGeneratorBase {
   static constexpr uint64_t checkIntervalUs_ = 100;
   static constexpr size_t kMaxRequests = 10000;
   static constexpr size_t kMinKeySize = 16;
+  // Wrappers a stressor may hold outside of its submission queue (being
+  // processed, pending async completion or waiting to be resubmitted)
+  // before the generator has to wait for one to be returned.
+  static constexpr size_t kMaxInFlightPerShard = 64;
+  // Keys up to this size are copied into buffers reserved at startup
+  static constexpr size_t kKeyCapacity = 64;
 
-  using ReqQueue = folly::ProducerConsumerQueue<std::unique_ptr<ReqWrapper>>;
+  using ReqQueue = folly::ProducerConsumerQueue<ReqWrapper*>;
 
   // StressorCtx keeps track of the state including the submission queues
   // per stressor thread. Since there is only one request generator thread,
@@ -169,7 +206,7 @@ class KVReplayGenerator : public ReplayGeneratorBase {
     void markFinish() { finished_.store(true, std::memory_order_relaxed); }
 
     uint32_t id_{0};
-    std::queue<std::unique_ptr<ReqWrapper>> resubmitQueue_;
+    std::queue<ReqWrapper*> resubmitQueue_;
     folly::cacheline_aligned<ReqQueue> reqQueue_;
     // Thread that finish its operations mark it here, so we will skip
     // further request on its shard
@@ -177,7 +214,11 @@ class KVReplayGenerator : public ReplayGeneratorBase {
   };
 
   // Read next trace line from TraceFileStream and fill ReqWrapper
-  std::unique_ptr<ReqWrapper> getReqInternal();
+  ReqWrapper* getReqInternal();
+
+  // Take a wrapper from the pool, waiting for stressors to return one if
+  // all are outstanding. Returns nullptr on shutdown.
+  ReqWrapper* allocateReqWrapper();
 
   // Used to assign stressorIdx_
   std::atomic<uint32_t> incrementalIdx_{0};
@@ -192,6 +233,9 @@ class KVReplayGenerator : public ReplayGeneratorBase {
 
   TraceFileStream traceStream_;
 
+  // Recycled request wrappers; the addresses double as request ids
+  ReqWrapperPool<ReqWrapper> reqPool_;
+
   std::thread genWorker_;
 
   // Used to signal end of file as EndOfTrace exception
@@ -200,6 +244,7 @@ class KVReplayGenerator : public ReplayGeneratorBase {
   // Stats
   std::atomic<uint64_t> parseError = 0;
   std::atomic<uint64_t> parseSuccess = 0;
+  std::atomic<uint64_t> poolWaits = 0;
 
   void genRequests();
 
@@ -221,7 +266,7 @@ class KVReplayGenerator : public ReplayGeneratorBase {
 };
 
 inline bool KVReplayGenerator::parseRequest(const std::string& line,
-                                            std::unique_ptr<ReqWrapper>& req) {
+                                            ReqWrapper& req) {
   if (!traceStream_.setNextLine(line)) {
     return false;
   }
@@ -231,18 +276,19 @@ inline bool KVReplayGenerator::parseRequest(const std::string& line,
     return false;
   }
 
-  // Set key
-  req->key_ = traceStream_.template getField<>(SampleFields::KEY).value();
+  // Set key; assign in place so a recycled wrapper keeps its key buffer
+  auto keyField = traceStream_.template getField<>(SampleFields::KEY).value();
+  req.key_.assign(keyField.data(), keyField.size());
 
   auto keySizeField =
       traceStream_.template getField<size_t>(SampleFields::KEY_SIZE);
   if (keySizeField.hasValue()) {
     // The key is encoded as <encoded key, key size>.
     // Generate key whose size matches with that of the original one
-    size_t keySize = std::max<size_t>(keySizeField.value(), req->key_.size());
+    size_t keySize = std::max<size_t>(keySizeField.value(), req.key_.size());
     // The key size should not exceed 256
     keySize = std::min<size_t>(keySize, 256);
-    req->key_.resize(keySize, '0');
+    req.key_.resize(keySize, '0');
   }
 
   // Convert timestamp to seconds.
@@ -251,50 +297,73 @@ inline bool KVReplayGenerator::parseRequest(const std::string& line,
   if (timestampField.hasValue()) {
     uint64_t timestampRaw = timestampField.value();
     uint64_t timestampSeconds = timestampRaw / timestampFactor_;
-    req->req_.timestamp = timestampSeconds;
+    req.req_.timestamp = timestampSeconds;
   }
 
   // Set op
   auto op = traceStream_.template getField<>(SampleFields::OP).value();
   // TODO implement GET_LEASE and SET_LEASE emulations
   if (!op.compare("GET") || !op.compare("GET_LEASE")) {
-    req->req_.setOp(OpType::kGet);
+    req.req_.setOp(OpType::kGet);
   } else if (!op.compare("SET") || !op.compare("SET_LEASE")) {
-    req->req_.setOp(OpType::kSet);
+    req.req_.setOp(OpType::kSet);
   } else if (!op.compare("DELETE")) {
-    req->req_.setOp(OpType::kDel);
+    req.req_.setOp(OpType::kDel);
   } else {
     return false;
   }
 
   // Set size
-  req->sizes_[0] = sizeField.value();
+  req.sizes_[0] = sizeField.value();
 
   // Set op_count
   auto opCountField =
       traceStream_.template getField<uint32_t>(SampleFields::OP_COUNT);
-  req->repeats_ = opCountField.value_or(1);
-  if (!req->repeats_) {
+  req.repeats_ = opCountField.value_or(1);
+  if (!req.repeats_) {
     return false;
   }
   if (config_.ignoreOpCount) {
-    req->repeats_ = 1;
+    req.repeats_ = 1;
   }
 
   // Set TTL (optional)
   auto ttlField = traceStream_.template getField<size_t>(SampleFields::TTL);
-  req->req_.ttlSecs = ttlField.value_or(0);
+  req.req_.ttlSecs = ttlField.value_or(0);
 
   return true;
 }
 
-inline std::unique_ptr<ReqWrapper> KVReplayGenerator::getReqInternal() {
-  auto reqWrapper = std::make_unique<ReqWrapper>();
+inline ReqWrapper* KVReplayGenerator::allocateReqWrapper() {
+  ReqWrapper* reqWrapper;
+  bool waited = false;
+  while (!(reqWrapper = reqPool_.allocate())) {
+    if (shouldShutdown()) {
+      return nullptr;
+    }
+    if (!waited) {
+      // count allocations that had to wait, not how often they slept
+      poolWaits++;
+      waited = true;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds{checkIntervalUs_});
+  }
+  reqWrapper->reset();
+  return reqWrapper;
+}
+
+inline ReqWrapper* KVReplayGenerator::getReqInternal() {
+  auto reqWrapper = allocateReqWrapper();
+  if (!reqWrapper) {
+    throw EndOfTrace("Test stopped");
+  }
+  // hand the wrapper back if the trace runs out while parsing
+  auto guard = folly::makeGuard([&] { reqPool_.releaseLocal(reqWrapper); });
+  std::string line;
   do {
-    std::string line;
     traceStream_.getline(line); // can throw
 
-    if (!parseRequest(line, reqWrapper)) {
+    if (!parseRequest(line, *reqWrapper)) {
       parseError++;
       XLOG_N_PER_MS(ERR, 10, 1000) << folly::sformat(
           "Parsing error (total {}): {}", parseError.load(), line);
@@ -303,12 +372,13 @@ inline std::unique_ptr<ReqWrapper> KVReplayGenerator::getReqInternal() {
     }
   } while (reqWrapper->repeats_ == 0);
 
+  guard.dismiss();
   return reqWrapper;
 }
 
 inline void KVReplayGenerator::genRequests() {
   while (!shouldShutdown()) {
-    std::unique_ptr<ReqWrapper> reqWrapper;
+    ReqWrapper* reqWrapper;
     try {
       reqWrapper = getReqInternal();
     } catch (const EndOfTrace&) {
@@ -316,12 +386,17 @@ inline void KVReplayGenerator::genRequests() {
     }
 
     for (size_t keySuffix = 0; keySuffix < ampFactor_; keySuffix++) {
-      std::unique_ptr<ReqWrapper> req;
+      ReqWrapper* req;
       // Use a copy of ReqWrapper except for the last one
       if (keySuffix == ampFactor_ - 1) {
-        req.swap(reqWrapper);
+        req = reqWrapper;
       } else {
-        req = std::make_unique<ReqWrapper>(*reqWrapper);
+        req = allocateReqWrapper();
+        if (!req) {
+          reqPool_.releaseLocal(reqWrapper);
+          break;
+        }
+        req->copyFrom(*reqWrapper);
       }
 
       if (ampFactor_ > 1) {
@@ -333,15 +408,22 @@ inline void KVReplayGenerator::genRequests() {
           size_t newSize = std::max<size_t>(req->key_.size() - 4, kMinKeySize);
           req->key_.resize(newSize, '0');
         }
-        req->key_.append(folly::sformat("{:04d}", keySuffix));
+        char suffix[8];
+        int len = std::snprintf(suffix, sizeof(suffix), "%04zu", keySuffix);
+        req->key_.append(suffix, len);
       }
 
       auto shardId = getShard(req->req_.key);
       auto& stressorCtx = getStressorCtx(shardId);
       auto& reqQ = *stressorCtx.reqQueue_;
+      reqPool_.setShard(req, shardId);
 
-      while (!reqQ.write(std::move(req)) && !stressorCtx.isFinished() &&
-             !shouldShutdown()) {
+      while (!reqQ.write(req)) {
+        if (stressorCtx.isFinished() || shouldShutdown()) {
+          // nobody will consume it
+          reqPool_.releaseLocal(req);
+          break;
+        }
         // ProducerConsumerQueue does not support blocking, so use sleep
         std::this_thread::sleep_for(
             std::chrono::microseconds{checkIntervalUs_});
@@ -352,10 +434,9 @@ inline void KVReplayGenerator::genRequests() {
   setEOF();
 }
 
-const Request& KVReplayGenerator::getReq(uint8_t,
-                                         std::mt19937_64&,
-                                         std::optional<uint64_t>) {
-  std::unique_ptr<ReqWrapper> reqWrapper;
+inline const Request& KVReplayGenerator::getReq(
+    uint8_t, std::mt19937_64&, std::optional<uint64_t>) {
+  ReqWrapper* reqWrapper = nullptr;
 
   auto& stressorCtx = getStressorCtx();
   auto& reqQ = *stressorCtx.reqQueue_;
@@ -371,25 +452,24 @@ const Request& KVReplayGenerator::getReq(uint8_t,
 
   if (!reqWrapper) {
     XCHECK(!resubmitQueue.empty());
-    reqWrapper.swap(resubmitQueue.front());
+    reqWrapper = resubmitQueue.front();
     resubmitQueue.pop();
   }
 
-  ReqWrapper* reqPtr = reqWrapper.release();
-  return reqPtr->req_;
+  return reqWrapper->req_;
 }
 
-void KVReplayGenerator::notifyResult(uint64_t requestId, OpResultType) {
-  // requestId should point to the ReqWrapper object. The ownership is taken
-  // here to do the clean-up properly if not resubmitted
-  std::unique_ptr<ReqWrapper> reqWrapper(
-      reinterpret_cast<ReqWrapper*>(requestId));
+inline void KVReplayGenerator::notifyResult(uint64_t requestId, OpResultType) {
+  // requestId should point to the ReqWrapper object. It goes back to the
+  // pool unless it needs to be resubmitted
+  auto reqWrapper = reinterpret_cast<ReqWrapper*>(requestId);
   XCHECK_GT(reqWrapper->repeats_, 0u);
   if (--reqWrapper->repeats_ == 0) {
+    reqPool_.release(reqWrapper);
     return;
   }
   // need to insert into the queue again
-  getStressorCtx().resubmitQueue_.emplace(std::move(reqWrapper));
+  getStressorCtx().resubmitQueue_.emplace(reqWrapper);
 }
 
 } // namespace cachebench
@@ -0,0 +1,494 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <fcntl.h>
+#include <folly/CPortability.h>
+#include <folly/Likely.h>
+#include <folly/logging/xlog.h>
+#include <folly/system/ThreadName.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zstd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace facebook {
+namespace cachelib {
+namespace cachebench {
+
+// On-disk layout of a single oracleGeneral binary trace record. Records are
+// handed out as views into the mapped (or decompressed) buffer, so this must
+// match the file format byte for byte.
+struct __attribute__((__packed__)) OracleGeneralBinRecord {
+  uint32_t clockTime;
+  uint64_t objId;
+  uint32_t objSize;
+  int64_t nextAccessVtime;
+};
+static_assert(sizeof(OracleGeneralBinRecord) == 24,
+              "oracleGeneral records are 24 bytes on disk");
+
+// MmapTraceReader reads oracleGeneral binary traces without copying records
+// through an intermediate stream buffer.
+//
+// Uncompressed traces are mmap'ed and each record is returned as a view into
+// the mapping. Zstd traces are mmap'ed as well and decompressed ahead of the
+// consumer into a ring of buffers:
+//  - traces made of several zstd frames (e.g. produced by pzstd or by
+//    `zstd -B`) are decompressed one frame per job by a pool of threads;
+//  - single frame traces are decompressed by one background thread in
+//    fixed size chunks, which still overlaps decompression with replay.
+//
+// The reader is single consumer: next() must be called from one thread.
+class MmapTraceReader {
+ public:
+  static constexpr size_t kRecordSize = sizeof(OracleGeneralBinRecord);
+
+  MmapTraceReader() = default;
+  ~MmapTraceReader() { close(); }
+
+  MmapTraceReader(const MmapTraceReader&) = delete;
+  MmapTraceReader& operator=(const MmapTraceReader&) = delete;
+
+  // @param path        trace file
+  // @param compressed  whether the trace is zstd compressed
+  // @param numThreads  decompression threads used for multi-frame zstd
+  //                    traces. Ignored for uncompressed traces.
+  //
+  // @throw std::runtime_error if the file can not be opened or mapped
+  void open(const std::string& path, bool compressed, uint32_t numThreads = 1);
+
+  // Stops the decompression threads and unmaps the trace.
+  void close();
+
+  // Returns a view of the next record, or nullptr once the trace is
+  // exhausted. The view is valid until the next call to next() or close().
+  const OracleGeneralBinRecord* next() {
+    if (FOLLY_LIKELY(static_cast<size_t>(end_ - cur_) >= kRecordSize)) {
+      auto rec = reinterpret_cast<const OracleGeneralBinRecord*>(cur_);
+      cur_ += kRecordSize;
+      return rec;
+    }
+    return nextSlow();
+  }
+
+  // number of zstd frames decompressed in parallel. 0 when the trace is not
+  // compressed or is decompressed as a single stream.
+  size_t getNumFrames() const { return frames_.size(); }
+
+ private:
+  // decompressed chunk or frame waiting to be consumed
+  struct Buffer {
+    std::vector<char> data;
+    size_t len{0};
+    bool ready{false};
+  };
+
+  struct Frame {
+    size_t offset;
+    size_t size;
+  };
+
+  // output size of each chunk when decompressing a single stream
+  static constexpr size_t kStreamChunkSize = 4 * 1024 * 1024;
+  // number of decompressed buffers kept ahead of the consumer per thread
+  static constexpr size_t kBuffersPerThread = 2;
+
+  const OracleGeneralBinRecord* nextSlow();
+
+  // waits for the next decompressed buffer and points cur_/end_ at it.
+  // Returns false once all buffers are consumed.
+  bool acquireBuffer();
+  // hands the buffer currently being consumed back to the producers
+  void releaseBuffer();
+
+  // blocks a producer until the buffer for seq is free. Returns false if
+  // the reader is shutting down.
+  bool waitForFreeBuffer(uint64_t seq);
+  void publishBuffer(uint64_t seq, size_t len);
+  void publishEnd(uint64_t numBuffers);
+
+  void scanFrames();
+  void decompressFrames();
+  void decompressStream();
+  static void decompressFrame(ZSTD_DCtx* dctx,
+                              const char* src,
+                              size_t srcSize,
+                              Buffer& buf);
+
+  int fd_{-1};
+  const char* map_{nullptr};
+  size_t mapSize_{0};
+  bool compressed_{false};
+
+  // current buffer being consumed
+  const char* cur_{nullptr};
+  const char* end_{nullptr};
+  bool holdsBuffer_{false};
+
+  // staging area for a record that straddles two decompressed buffers
+  alignas(8) char carry_[kRecordSize];
+
+  std::vector<Frame> frames_;
+  std::atomic<uint64_t> nextFrame_{0};
+
+  // ring of decompressed buffers; buffer for sequence s lives at
+  // s % ring_.size() and can be filled once the consumer has released
+  // sequence s - ring_.size().
+  std::vector<Buffer> ring_;
+  std::mutex lock_;
+  std::condition_variable producerCv_;
+  std::condition_variable consumerCv_;
+  uint64_t consumeSeq_{0};
+  uint64_t numBuffers_{std::numeric_limits<uint64_t>::max()};
+  bool stop_{false};
+
+  std::vector<std::thread> workers_;
+};
+
+inline void MmapTraceReader::open(const std::string& path,
+                                  bool compressed,
+                                  uint32_t numThreads) {
+  close();
+  compressed_ = compressed;
+
+  fd_ = ::open(path.c_str(), O_RDONLY);
+  if (fd_ < 0) {
+    throw std::runtime_error("Cannot open file: " + path);
+  }
+  struct stat st;
+  if (::fstat(fd_, &st) != 0) {
+    throw std::runtime_error("Cannot stat file: " + path);
+  }
+  mapSize_ = static_cast<size_t>(st.st_size);
+  if (mapSize_ == 0) {
+    XLOGF(WARN, "Trace file {} is empty", path);
+    numBuffers_ = 0;
+    return;
+  }
+
+  void* addr = ::mmap(nullptr, mapSize_, PROT_READ, MAP_PRIVATE, fd_, 0);
+  if (addr == MAP_FAILED) {
+    throw std::runtime_error("Cannot mmap file: " + path);
+  }
+  map_ = static_cast<const char*>(addr);
+  // The trace is consumed front to back exactly once. Hugepages are only a
+  // hint; file backed THP is not supported by every filesystem.
+  ::madvise(addr, mapSize_, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+  ::madvise(addr, mapSize_, MADV_HUGEPAGE);
+#endif
+
+  if (!compressed_) {
+    cur_ = map_;
+    end_ = map_ + mapSize_ / kRecordSize * kRecordSize;
+    if (mapSize_ % kRecordSize != 0) {
+      XLOGF(WARN, "Trace file {} has {} trailing bytes", path,
+            mapSize_ % kRecordSize);
+    }
+    return;
+  }
+
+  numThreads = std::max<uint32_t>(numThreads, 1);
+  if (numThreads > 1) {
+    scanFrames();
+  }
+
+  if (frames_.size() > 1) {
+    numThreads = std::min<uint32_t>(numThreads, frames_.size());
+    ring_ = std::vector<Buffer>(numThreads * kBuffersPerThread);
+    numBuffers_ = frames_.size();
+    for (uint32_t i = 0; i < numThreads; i++) {
+      workers_.emplace_back([this] {
+        folly::setThreadName("cb_trace_dec");
+        decompressFrames();
+      });
+    }
+  } else {
+    frames_.clear();
+    ring_ = std::vector<Buffer>(kBuffersPerThread);
+    workers_.emplace_back([this] {
+      folly::setThreadName("cb_trace_dec");
+      decompressStream();
+    });
+  }
+
+  XLOGF(INFO,
+        "Reading zstd trace {} with {} decompression threads ({} frames)",
+        path, workers_.size(), frames_.size());
+}
+
+inline void MmapTraceReader::close() {
+  {
+    std::lock_guard<std::mutex> l(lock_);
+    stop_ = true;
+  }
+  producerCv_.notify_all();
+  consumerCv_.notify_all();
+  for (auto& t : workers_) {
+    t.join();
+  }
+  workers_.clear();
+
+  if (map_) {
+    ::munmap(const_cast<char*>(map_), mapSize_);
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+  fd_ = -1;
+  compressed_ = false;
+  map_ = nullptr;
+  mapSize_ = 0;
+  cur_ = end_ = nullptr;
+  holdsBuffer_ = false;
+  frames_.clear();
+  nextFrame_ = 0;
+  ring_.clear();
+  consumeSeq_ = 0;
+  numBuffers_ = std::numeric_limits<uint64_t>::max();
+  stop_ = false;
+}
+
+inline const OracleGeneralBinRecord* MmapTraceReader::nextSlow() {
+  if (!compressed_) {
+    return nullptr;
+  }
+
+  // whatever is left in the current buffer is the head of a record that
+  // continues in the next one; stitch it together in carry_.
+  size_t carried = end_ - cur_;
+  std::memcpy(carry_, cur_, carried);
+  cur_ = end_;
+
+  for (;;) {
+    releaseBuffer();
+    if (!acquireBuffer()) {
+      if (carried > 0) {
+        XLOGF(ERR, "Trace ends with a partial record of {} bytes", carried);
+      }
+      cur_ = end_ = nullptr;
+      return nullptr;
+    }
+
+    const size_t avail = end_ - cur_;
+    if (carried == 0 && avail >= kRecordSize) {
+      return next();
+    }
+    const size_t take = std::min(kRecordSize - carried, avail);
+    std::memcpy(carry_ + carried, cur_, take);
+    cur_ += take;
+    carried += take;
+    if (carried == kRecordSize) {
+      return reinterpret_cast<const OracleGeneralBinRecord*>(carry_);
+    }
+  }
+}
+
+inline bool MmapTraceReader::acquireBuffer() {
+  if (ring_.empty()) {
+    return false;
+  }
+  std::unique_lock<std::mutex> l(lock_);
+  auto& buf = ring_[consumeSeq_ % ring_.size()];
+  consumerCv_.wait(l, [&] {
+    return stop_ || consumeSeq_ >= numBuffers_ || buf.ready;
+  });
+  if (stop_ || !buf.ready) {
+    return false;
+  }
+  cur_ = buf.data.data();
+  end_ = cur_ + buf.len;
+  holdsBuffer_ = true;
+  return true;
+}
+
+inline void MmapTraceReader::releaseBuffer() {
+  if (!holdsBuffer_) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> l(lock_);
+    ring_[consumeSeq_ % ring_.size()].ready = false;
+    ++consumeSeq_;
+  }
+  holdsBuffer_ = false;
+  producerCv_.notify_all();
+}
+
+inline bool MmapTraceReader::waitForFreeBuffer(uint64_t seq) {
+  std::unique_lock<std::mutex> l(lock_);
+  producerCv_.wait(l,
+                   [&] { return stop_ || seq < consumeSeq_ + ring_.size(); });
+  return !stop_;
+}
+
+inline void MmapTraceReader::publishBuffer(uint64_t seq, size_t len) {
+  {
+    std::lock_guard<std::mutex> l(lock_);
+    auto& buf = ring_[seq % ring_.size()];
+    buf.len = len;
+    buf.ready = true;
+  }
+  consumerCv_.notify_all();
+}
+
+inline void MmapTraceReader::publishEnd(uint64_t numBuffers) {
+  {
+    std::lock_guard<std::mutex> l(lock_);
+    numBuffers_ = numBuffers;
+  }
+  consumerCv_.notify_all();
+}
+
+inline void MmapTraceReader::scanFrames() {
+  size_t offset = 0;
+  while (offset < mapSize_) {
+    size_t size = ZSTD_findFrameCompressedSize(map_ + offset, mapSize_ - offset);
+    if (ZSTD_isError(size)) {
+      // a truncated or corrupted frame; the streaming decoder reports the
+      // exact error when it gets there.
+      XLOGF(WARN, "Can not split zstd trace into frames: {}",
+            ZSTD_getErrorName(size));
+      frames_.clear();
+      return;
+    }
+    frames_.push_back(Frame{offset, size});
+    offset += size;
+  }
+}
+
+inline void MmapTraceReader::decompressFrames() {
+  std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> dctx(ZSTD_createDCtx(),
+                                                          ZSTD_freeDCtx);
+  for (;;) {
+    const uint64_t seq = nextFrame_.fetch_add(1, std::memory_order_relaxed);
+    if (seq >= frames_.size()) {
+      return;
+    }
+    if (!waitForFreeBuffer(seq)) {
+      return;
+    }
+    // the buffer is owned by this thread until it is published
+    auto& buf = ring_[seq % ring_.size()];
+    decompressFrame(dctx.get(), map_ + frames_[seq].offset, frames_[seq].size,
+                    buf);
+    publishBuffer(seq, buf.len);
+  }
+}
+
+inline void MmapTraceReader::decompressFrame(ZSTD_DCtx* dctx,
+                                             const char* src,
+                                             size_t srcSize,
+                                             Buffer& buf) {
+  buf.len = 0;
+  const auto contentSize = ZSTD_getFrameContentSize(src, srcSize);
+  if (contentSize != ZSTD_CONTENTSIZE_UNKNOWN &&
+      contentSize != ZSTD_CONTENTSIZE_ERROR) {
+    // only grow; shrinking and growing again would zero fill every time
+    if (buf.data.size() < contentSize) {
+      buf.data.resize(contentSize);
+    }
+    size_t ret =
+        ZSTD_decompressDCtx(dctx, buf.data.data(), contentSize, src, srcSize);
+    if (ZSTD_isError(ret)) {
+      XLOGF(ERR, "Zstd decompression error: {}", ZSTD_getErrorName(ret));
+      return;
+    }
+    buf.len = ret;
+    return;
+  }
+
+  // frame header does not carry the content size; stream it and grow the
+  // buffer as needed.
+  ZSTD_DCtx_reset(dctx, ZSTD_reset_session_only);
+  ZSTD_inBuffer in{src, srcSize, 0};
+  if (buf.data.size() < kStreamChunkSize) {
+    buf.data.resize(kStreamChunkSize);
+  }
+  for (;;) {
+    ZSTD_outBuffer out{buf.data.data(), buf.data.size(), buf.len};
+    size_t ret = ZSTD_decompressStream(dctx, &out, &in);
+    buf.len = out.pos;
+    if (ZSTD_isError(ret)) {
+      XLOGF(ERR, "Zstd decompression error: {}", ZSTD_getErrorName(ret));
+      return;
+    }
+    if (ret == 0 || (in.pos == in.size && out.pos < out.size)) {
+      return;
+    }
+    if (out.pos == out.size) {
+      buf.data.resize(buf.data.size() * 2);
+    }
+  }
+}
+
+inline void MmapTraceReader::decompressStream() {
+  std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> dctx(ZSTD_createDCtx(),
+                                                          ZSTD_freeDCtx);
+  ZSTD_inBuffer in{map_, mapSize_, 0};
+  for (uint64_t seq = 0;; ++seq) {
+    if (!waitForFreeBuffer(seq)) {
+      return;
+    }
+    auto& buf = ring_[seq % ring_.size()];
+    if (buf.data.size() < kStreamChunkSize) {
+      buf.data.resize(kStreamChunkSize);
+    }
+
+    // fill the whole chunk unless the input runs out. The decoder flushes
+    // everything it can whenever it leaves room in the output buffer, so a
+    // partially filled chunk with no input left marks the end.
+    ZSTD_outBuffer out{buf.data.data(), kStreamChunkSize, 0};
+    bool done = false;
+    while (out.pos < out.size) {
+      size_t ret = ZSTD_decompressStream(dctx.get(), &out, &in);
+      if (ZSTD_isError(ret)) {
+        XLOGF(ERR, "Zstd decompression error: {}", ZSTD_getErrorName(ret));
+        done = true;
+        break;
+      }
+      if (in.pos == in.size && out.pos < out.size) {
+        done = true;
+        break;
+      }
+    }
+
+    publishBuffer(seq, out.pos);
+    if (done) {
+      publishEnd(seq + 1);
+      return;
+    }
+  }
+}
+
+} // namespace cachebench
+} // namespace cachelib
+} // namespace facebook
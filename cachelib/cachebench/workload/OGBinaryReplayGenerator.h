@@ -18,17 +18,21 @@
 
 #include <folly/Conv.h>
 #include <folly/ProducerConsumerQueue.h>
+#include <folly/ScopeGuard.h>
 #include <folly/ThreadLocal.h>
 #include <folly/lang/Aligned.h>
 #include <folly/logging/xlog.h>
 #include <folly/system/ThreadName.h>
 
+#include <cstdio>
+
 #include "cachelib/cachebench/cache/Cache.h"
 #include "cachelib/cachebench/util/Exceptions.h"
 #include "cachelib/cachebench/util/Parallel.h"
 #include "cachelib/cachebench/util/Request.h"
 #include "cachelib/cachebench/workload/ReplayGeneratorBase.h"
-#include "cachelib/cachebench/workload/ZstdReader.h"
+#include "cachelib/cachebench/workload/MmapTraceReader.h"
+#include "cachelib/cachebench/workload/ReqWrapperPool.h"
 #include "cachelib/allocator/memory/Slab.h"
 
 namespace facebook {
@@ -48,6 +52,27 @@ struct OGReqWrapper {
              other.req_),
         repeats_(other.repeats_) {}
 
+  // Overwrite this wrapper with the request carried by other. Unlike the copy
+  // constructor, this keeps the request id and reuses the key and size
+  // buffers, so recycled wrappers do not allocate.
+  void copyFrom(const OGReqWrapper& other) {
+    key_.assign(other.key_);
+    sizes_.assign(other.sizes_.begin(), other.sizes_.end());
+    req_.sizeBegin = sizes_.begin();
+    req_.sizeEnd = sizes_.end();
+    req_.setOp(other.req_.getOp());
+    req_.ttlSecs = other.req_.ttlSecs;
+    req_.timestamp = other.req_.timestamp;
+    repeats_ = other.repeats_;
+  }
+
+  // Clear the per-request fields that parsing only sets when present.
+  void reset() {
+    req_.ttlSecs = 0;
+    req_.timestamp = 0;
+    repeats_ = 0;
+  }
+
   // current outstanding key
   std::string key_;
   std::vector<size_t> sizes_{1};
@@ -89,9 +114,14 @@ class OGBinaryReplayGenerator : public ReplayGeneratorBase {
   };
 
   explicit OGBinaryReplayGenerator(const StressorConfig& config)
-      : ReplayGeneratorBase(config), traceStream_(config, 0, columnTable_), zstdReader_() {
+      : ReplayGeneratorBase(config),
+        traceStream_(config, 0, columnTable_),
+        reqPool_(numShards_,
+                 numShards_ * (kMaxRequests + kMaxInFlightPerShard),
+                 kKeyCapacity) {
     if(config.zstdTrace){
-      zstdReader_.open(config.traceFileName, config.compressed);
+      traceReader_.open(config.traceFileName, config.compressed,
+                        config.traceReaderThreads);
       XLOGF(INFO, "Reading zstd trace file");
     }
     for (uint32_t i = 0; i < numShards_; ++i) {
@@ -129,14 +159,28 @@ class OGBinaryReplayGenerator : public ReplayGeneratorBase {
                           "Total Processed Samples",
                           (double)parseSuccess.load() / 1e6, parseError.load())
         << std::endl;
+    out << folly::sformat("{}: {}", "Request Pool Waits", poolWaits.load())
+        << std::endl;
+    if (config_.deterministicReplay) {
+      out << folly::sformat("{}: {}", "Logical Clock Events",
+                            getLogicalClockEvents())
+          << std::endl;
+    }
   }
 
   void notifyResult(uint64_t requestId, OpResultType result) override;
 
-  void markFinish() override { getStressorCtx().markFinish(); }
+  bool setLogicalClockCallback(LogicalClockCallback cb) override {
+    return registerLogicalClockCallback(std::move(cb));
+  }
+
+  void markFinish() override {
+    getStressorCtx().markFinish();
+    markShardFinished();
+  }
 
   // Parse the request from the trace line and set the OGReqWrapper
-  bool parseRequest(const std::string& line, std::unique_ptr<OGReqWrapper>& req);
+  bool parseRequest(const std::string& line, OGReqWrapper& req);
 
   // for unit test
   bool setHeaderRow(const std::string& header) {
@@ -152,8 +196,15 @@ class OGBinaryReplayGenerator : public ReplayGeneratorBase {
   static constexpr size_t kMaxRequests = 10000;
   static constexpr size_t kMinKeySize = 16;
   static constexpr size_t maxSlabSize = 1ULL << facebook::cachelib::Slab::kNumSlabBits;
+  // Wrappers a stressor may hold outside of its submission queue (being
+  // processed, pending async completion or waiting to be resubmitted)
+  // before the generator has to wait for one to be returned.
+  static constexpr size_t kMaxInFlightPerShard = 64;
+  // Keys up to this size are copied into buffers reserved at startup. Binary
+  // trace keys are at most 20 decimal digits plus the amp factor suffix.
+  static constexpr size_t kKeyCapacity = 32;
 
-  using ReqQueue = folly::ProducerConsumerQueue<std::unique_ptr<OGReqWrapper>>;
+  using ReqQueue = folly::ProducerConsumerQueue<OGReqWrapper*>;
 
   // StressorCtx keeps track of the state including the submission queues
   // per stressor thread. Since there is only one request generator thread,
@@ -171,7 +222,7 @@ class OGBinaryReplayGenerator : public ReplayGeneratorBase {
     void markFinish() { finished_.store(true, std::memory_order_relaxed); }
 
     uint32_t id_{0};
-    std::queue<std::unique_ptr<OGReqWrapper>> resubmitQueue_;
+    std::queue<OGReqWrapper*> resubmitQueue_;
     folly::cacheline_aligned<ReqQueue> reqQueue_;
     // Thread that finish its operations mark it here, so we will skip
     // further request on its shard
@@ -179,9 +230,13 @@ class OGBinaryReplayGenerator : public ReplayGeneratorBase {
   };
 
   // Read next trace line from TraceFileStream and fill OGReqWrapper
-  std::unique_ptr<OGReqWrapper> getReqInternal();
+  OGReqWrapper* getReqInternal();
 
-  std::unique_ptr<OGReqWrapper> getReqInternalZstd();
+  OGReqWrapper* getReqInternalZstd();
+
+  // Take a wrapper from the pool, waiting for stressors to return one if
+  // all are outstanding. Returns nullptr on shutdown.
+  OGReqWrapper* allocateReqWrapper();
 
   // Used to assign stressorIdx_
   std::atomic<uint32_t> incrementalIdx_{0};
@@ -196,7 +251,12 @@ class OGBinaryReplayGenerator : public ReplayGeneratorBase {
 
   TraceFileStream traceStream_;
 
-  ZstdReader zstdReader_;
+  // binary trace reader; records are read in place from the mapped file
+  // or from buffers decompressed ahead of time
+  MmapTraceReader traceReader_;
+
+  // Recycled request wrappers; the addresses double as request ids
+  ReqWrapperPool<OGReqWrapper> reqPool_;
 
   std::thread genWorker_;
 
@@ -206,6 +266,7 @@ class OGBinaryReplayGenerator : public ReplayGeneratorBase {
   // Stats
   std::atomic<uint64_t> parseError = 0;
   std::atomic<uint64_t> parseSuccess = 0;
+  std::atomic<uint64_t> poolWaits = 0;
 
   void genRequests();
 
@@ -227,7 +288,7 @@ class OGBinaryReplayGenerator : public ReplayGeneratorBase {
 };
 
 inline bool OGBinaryReplayGenerator::parseRequest(
-  const std::string& line, std::unique_ptr<OGReqWrapper>& req) {
+  const std::string& line, OGReqWrapper& req) {
   if (!traceStream_.setNextLine(line)) {
     return false;
   }
@@ -238,8 +299,10 @@ inline bool OGBinaryReplayGenerator::parseRequest(
     return false;
   }
 
-  // Set key
-  req->key_ = traceStream_.template getField<>(SampleFields::OBJECT_ID).value();
+  // Set key; assign in place so a recycled wrapper keeps its key buffer
+  auto keyField =
+      traceStream_.template getField<>(SampleFields::OBJECT_ID).value();
+  req.key_.assign(keyField.data(), keyField.size());
 
   // Convert timestamp to seconds.
   // todo: clarify time precision
@@ -248,37 +311,57 @@ inline bool OGBinaryReplayGenerator::parseRequest(
   if (timestampField.hasValue()) {
     uint64_t timestampRaw = timestampField.value();
     uint64_t timestampSeconds = timestampRaw / timestampFactor_;
-    req->req_.timestamp = timestampSeconds;
+    req.req_.timestamp = timestampSeconds;
   }
 
   size_t objSize = sizeField.value();
 
-  req->sizes_.clear(); 
-  req->sizes_.resize(1); 
-  req->sizes_[0] = objSize;
-  req->req_.setOp(OpType::kGet);
-  req->req_.sizeBegin = req->sizes_.begin();
-  req->req_.sizeEnd = req->sizes_.end();
+  req.sizes_.resize(1);
+  req.sizes_[0] = objSize;
+  req.req_.setOp(OpType::kGet);
+  req.req_.sizeBegin = req.sizes_.begin();
+  req.req_.sizeEnd = req.sizes_.end();
 
-  req->repeats_ = 1;
-  if (!req->repeats_) {
+  req.repeats_ = 1;
+  if (!req.repeats_) {
     return false;
   }
   if (config_.ignoreOpCount) {
-    req->repeats_ = 1;
+    req.repeats_ = 1;
   }
 
   return true;
 }
 
-inline std::unique_ptr<OGReqWrapper> OGBinaryReplayGenerator::getReqInternal() {
-  auto reqWrapper = std::make_unique<OGReqWrapper>();
+inline OGReqWrapper* OGBinaryReplayGenerator::allocateReqWrapper() {
+  OGReqWrapper* reqWrapper;
+  bool waited = false;
+  while (!(reqWrapper = reqPool_.allocate())) {
+    if (shouldShutdown()) {
+      return nullptr;
+    }
+    if (!waited) {
+      poolWaits++;
+      waited = true;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds{checkIntervalUs_});
+  }
+  reqWrapper->reset();
+  return reqWrapper;
+}
 
+inline OGReqWrapper* OGBinaryReplayGenerator::getReqInternal() {
+  auto reqWrapper = allocateReqWrapper();
+  if (!reqWrapper) {
+    throw EndOfTrace("Test stopped");
+  }
+  // hand the wrapper back if the trace runs out while parsing
+  auto guard = folly::makeGuard([&] { reqPool_.releaseLocal(reqWrapper); });
+  std::string line;
   do {
-    std::string line;
     traceStream_.getline(line); // can throw
 
-    if (!parseRequest(line, reqWrapper)) {
+    if (!parseRequest(line, *reqWrapper)) {
       parseError++;
       XLOG_N_PER_MS(ERR, 10, 1000) << folly::sformat(
           "Parsing error (total {}): {}", parseError.load(), line);
@@ -288,49 +371,60 @@ inline std::unique_ptr<OGReqWrapper> OGBinaryReplayGenerator::getReqInternal() {
       totalSize += reqWrapper->key_.length() + 32;
 
       if (config_.ignoreLargeReq && totalSize >= maxSlabSize) {
-          return getReqInternal();
+        // skip it and parse the next line into the same wrapper
+        reqWrapper->repeats_ = 0;
+        continue;
       }
       parseSuccess++;
     }
   } while (reqWrapper->repeats_ == 0);
 
+  guard.dismiss();
   return reqWrapper;
 }
 
-inline std::unique_ptr<OGReqWrapper> OGBinaryReplayGenerator::getReqInternalZstd() {
-  auto reqWrapper = std::make_unique<OGReqWrapper>();
+inline OGReqWrapper* OGBinaryReplayGenerator::getReqInternalZstd() {
+  auto reqWrapper = allocateReqWrapper();
+  if (!reqWrapper) {
+    throw EndOfTrace("Test stopped");
+  }
+  // hand the wrapper back if the trace runs out
+  auto guard = folly::makeGuard([&] { reqPool_.releaseLocal(reqWrapper); });
 
+  const OracleGeneralBinRecord* req;
   do {
-    OracleGeneralBinRequest req;
-    if (!zstdReader_.read_one_req(&req)) {
+    req = traceReader_.next();
+    if (!req) {
       throw EndOfTrace("EOF reached");
     }
+  } while (req->objSize == 0 ||
+           (config_.ignoreLargeReq &&
+            req->objSize + folly::digits10(req->objId) + 32 >=
+                maxSlabSize));
 
-    reqWrapper->key_ = std::to_string(req.objId);
-    if (config_.ignoreLargeReq &&
-      (req.objSize + reqWrapper->key_.length() + 32) >= maxSlabSize) {
-      return getReqInternalZstd();
-    }
+  // format the object id without going through a temporary string
+  char keyBuf[20];
+  size_t keyLen = folly::uint64ToBufferUnsafe(req->objId, keyBuf);
+  reqWrapper->key_.assign(keyBuf, keyLen);
 
-    reqWrapper->sizes_.clear(); 
-    reqWrapper->sizes_.resize(1); 
-    reqWrapper->sizes_[0] = req.objSize; 
-    reqWrapper->req_.setOp(OpType::kGet);
+  reqWrapper->sizes_.resize(1);
+  reqWrapper->sizes_[0] = req->objSize;
+  reqWrapper->req_.setOp(OpType::kGet);
 
-    reqWrapper->req_.sizeBegin = reqWrapper->sizes_.begin();
-    reqWrapper->req_.sizeEnd = reqWrapper->sizes_.end();
+  reqWrapper->req_.sizeBegin = reqWrapper->sizes_.begin();
+  reqWrapper->req_.sizeEnd = reqWrapper->sizes_.end();
 
-    reqWrapper->req_.timestamp = req.clockTime;
-    reqWrapper->repeats_ = 1;
-    parseSuccess++;
-  } while (reqWrapper->repeats_ == 0);
+  reqWrapper->req_.timestamp = req->clockTime;
+  reqWrapper->repeats_ = 1;
+  parseSuccess++;
 
+  guard.dismiss();
   return reqWrapper;
 }
 
 inline void OGBinaryReplayGenerator::genRequests() {
   while (!shouldShutdown()) {
-    std::unique_ptr<OGReqWrapper> reqWrapper;
+    OGReqWrapper* reqWrapper;
     try {
       if(config_.zstdTrace){
         reqWrapper = getReqInternalZstd();
@@ -342,12 +436,17 @@ inline void OGBinaryReplayGenerator::genRequests() {
     }
 
     for (size_t keySuffix = 0; keySuffix < ampFactor_; keySuffix++) {
-      std::unique_ptr<OGReqWrapper> req;
+      OGReqWrapper* req;
       // Use a copy of ReqWrapper except for the last one
       if (keySuffix == ampFactor_ - 1) {
-        req.swap(reqWrapper);
+        req = reqWrapper;
       } else {
-        req = std::make_unique<OGReqWrapper>(*reqWrapper);
+        req = allocateReqWrapper();
+        if (!req) {
+          reqPool_.releaseLocal(reqWrapper);
+          break;
+        }
+        req->copyFrom(*reqWrapper);
       }
 
       if (ampFactor_ > 1) {
@@ -359,15 +458,31 @@ inline void OGBinaryReplayGenerator::genRequests() {
           size_t newSize = std::max<size_t>(req->key_.size() - 4, kMinKeySize);
           req->key_.resize(newSize, '0');
         }
-        req->key_.append(folly::sformat("{:04d}", keySuffix));
+        char suffix[8];
+        int len = std::snprintf(suffix, sizeof(suffix), "%04zu", keySuffix);
+        req->key_.append(suffix, len);
       }
 
       auto shardId = getShard(req->req_.key);
       auto& stressorCtx = getStressorCtx(shardId);
       auto& reqQ = *stressorCtx.reqQueue_;
+      reqPool_.setShard(req, shardId);
 
-      while (!reqQ.write(std::move(req)) && !stressorCtx.isFinished() &&
-             !shouldShutdown()) {
+      if (!tickLogicalClock()) {
+        reqPool_.releaseLocal(req);
+        if (req != reqWrapper) {
+          reqPool_.releaseLocal(reqWrapper);
+        }
+        break;
+      }
+
+      while (!reqQ.write(req)) {
+        if (stressorCtx.isFinished() || shouldShutdown()) {
+          // nobody will consume it
+          reqPool_.releaseLocal(req);
+          completeLogicalRequest();
+          break;
+        }
         // ProducerConsumerQueue does not support blocking, so use sleep
         std::this_thread::sleep_for(
             std::chrono::microseconds{checkIntervalUs_});
@@ -378,10 +493,9 @@ inline void OGBinaryReplayGenerator::genRequests() {
   setEOF();
 }
 
-const Request& OGBinaryReplayGenerator::getReq(uint8_t,
-                                               std::mt19937_64&,
-                                               std::optional<uint64_t>) {
-  std::unique_ptr<OGReqWrapper> reqWrapper;
+inline const Request& OGBinaryReplayGenerator::getReq(
+    uint8_t, std::mt19937_64&, std::optional<uint64_t>) {
+  OGReqWrapper* reqWrapper = nullptr;
 
   auto& stressorCtx = getStressorCtx();
   auto& reqQ = *stressorCtx.reqQueue_;
@@ -397,25 +511,26 @@ const Request& OGBinaryReplayGenerator::getReq(uint8_t,
 
   if (!reqWrapper) {
     XCHECK(!resubmitQueue.empty());
-    reqWrapper.swap(resubmitQueue.front());
+    reqWrapper = resubmitQueue.front();
     resubmitQueue.pop();
   }
 
-  OGReqWrapper* reqPtr = reqWrapper.release();
-  return reqPtr->req_;
+  return reqWrapper->req_;
 }
 
-void OGBinaryReplayGenerator::notifyResult(uint64_t requestId, OpResultType) {
-  // requestId should point to the OGReqWrapper object. The ownership is taken
-  // here to do the clean-up properly if not resubmitted
-  std::unique_ptr<OGReqWrapper> reqWrapper(
-      reinterpret_cast<OGReqWrapper*>(requestId));
+inline void OGBinaryReplayGenerator::notifyResult(uint64_t requestId,
+                                                  OpResultType) {
+  // requestId should point to the OGReqWrapper object. It goes back to the
+  // pool unless it needs to be resubmitted
+  auto reqWrapper = reinterpret_cast<OGReqWrapper*>(requestId);
   XCHECK_GT(reqWrapper->repeats_, 0u);
   if (--reqWrapper->repeats_ == 0) {
+    reqPool_.release(reqWrapper);
+    completeLogicalRequest();
     return;
   }
   // need to insert into the queue again
-  getStressorCtx().resubmitQueue_.emplace(std::move(reqWrapper));
+  getStressorCtx().resubmitQueue_.emplace(reqWrapper);
 }
 
 } // namespace cachebench
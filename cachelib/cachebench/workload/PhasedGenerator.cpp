@@ -0,0 +1,347 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cachelib/cachebench/workload/PhasedGenerator.h"
+
+#include <folly/Exception.h>
+#include <folly/File.h>
+#include <folly/FileUtil.h>
+#include <folly/Format.h>
+#include <folly/container/F14Map.h>
+#include <folly/hash/Hash.h>
+#include <folly/logging/xlog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "cachelib/cachebench/workload/MmapTraceReader.h"
+
+namespace facebook {
+namespace cachelib {
+namespace cachebench {
+namespace {
+// log1p(x) / x, continuous at 0
+double helper1(double x) {
+  return std::abs(x) > 1e-8 ? std::log1p(x) / x
+                            : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+}
+
+// expm1(x) / x, continuous at 0
+double helper2(double x) {
+  return std::abs(x) > 1e-8
+             ? std::expm1(x) / x
+             : 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+}
+
+double uniform01(std::mt19937_64& gen) {
+  return static_cast<double>(gen() >> 11) * 0x1.0p-53;
+}
+} // namespace
+
+ZipfSampler::ZipfSampler(uint64_t n, double alpha) : n_(n), alpha_(alpha) {
+  if (n == 0 || alpha < 0) {
+    throw std::invalid_argument(
+        folly::sformat("invalid zipf parameters n: {} alpha: {}", n, alpha));
+  }
+  hIntegralX1_ = hIntegral(1.5) - 1.0;
+  hIntegralN_ = hIntegral(static_cast<double>(n) + 0.5);
+  s_ = 2.0 - hIntegralInverse(hIntegral(2.5) - h(2.0));
+}
+
+double ZipfSampler::h(double x) const { return std::exp(-alpha_ * std::log(x)); }
+
+double ZipfSampler::hIntegral(double x) const {
+  const double logX = std::log(x);
+  return helper2((1.0 - alpha_) * logX) * logX;
+}
+
+double ZipfSampler::hIntegralInverse(double x) const {
+  double t = x * (1.0 - alpha_);
+  if (t < -1.0) {
+    // numerical noise near the lower end of the domain
+    t = -1.0;
+  }
+  return std::exp(helper1(t) * x);
+}
+
+uint64_t ZipfSampler::operator()(std::mt19937_64& gen) const {
+  while (true) {
+    const double u =
+        hIntegralN_ + uniform01(gen) * (hIntegralX1_ - hIntegralN_);
+    const double x = hIntegralInverse(u);
+    uint64_t k = static_cast<uint64_t>(x + 0.5);
+    k = std::clamp<uint64_t>(k, 1, n_);
+    const double kd = static_cast<double>(k);
+    if (kd - x <= s_ || u >= hIntegral(kd + 0.5) - h(kd)) {
+      return k;
+    }
+  }
+}
+
+PhasedGenerator::PhasedGenerator(const StressorConfig& config)
+    : PhasedGenerator(config, config.numThreads) {}
+
+PhasedGenerator::PhasedGenerator(const StressorConfig& config,
+                                 uint32_t numThreads)
+    : seed_(config.phasedGeneratorConfig.seed),
+      requestsPerSecond_(
+          std::max<uint64_t>(config.phasedGeneratorConfig.requestsPerSecond, 1)),
+      numThreads_(std::max<uint32_t>(numThreads, 1)) {
+  const auto& phaseConfigs = config.phasedGeneratorConfig.phases;
+  if (phaseConfigs.empty()) {
+    throw std::invalid_argument("phased generator needs at least one phase");
+  }
+
+  // a keyspace keeps its ids across phases and is as wide as its largest
+  // use
+  for (const auto& p : phaseConfigs) {
+    maxKeyspaces_ = std::max(maxKeyspaces_, p.keyspaces.size());
+  }
+  std::vector<uint64_t> firstIds(maxKeyspaces_ + 1, 0);
+  for (size_t k = 0; k < maxKeyspaces_; k++) {
+    uint64_t width = 0;
+    for (const auto& p : phaseConfigs) {
+      if (k < p.keyspaces.size()) {
+        width = std::max(width, p.keyspaces[k].numKeys);
+      }
+    }
+    firstIds[k + 1] = firstIds[k] + width;
+  }
+
+  for (size_t i = 0; i < phaseConfigs.size(); i++) {
+    const auto& pc = phaseConfigs[i];
+    if (pc.numRequests == 0 || pc.keyspaces.empty()) {
+      throw std::invalid_argument(folly::sformat(
+          "phase {} needs requests and at least one keyspace", i));
+    }
+    if (pc.setRatio < 0 || pc.delRatio < 0 || pc.setRatio + pc.delRatio > 1) {
+      throw std::invalid_argument(
+          folly::sformat("phase {} has invalid op ratios", i));
+    }
+
+    Phase phase;
+    phase.numRequests = std::max<uint64_t>(pc.numRequests / numThreads_, 1);
+    phase.setRatio = pc.setRatio;
+    phase.delRatio = pc.delRatio;
+
+    double totalShare = 0;
+    for (const auto& kc : pc.keyspaces) {
+      totalShare += kc.share;
+    }
+    double accumShare = 0;
+    for (size_t k = 0; k < pc.keyspaces.size(); k++) {
+      const auto& kc = pc.keyspaces[k];
+      if (kc.numKeys == 0 || kc.share < 0) {
+        throw std::invalid_argument(folly::sformat(
+            "phase {} keyspace {} has no keys or a negative share", i, k));
+      }
+      accumShare += kc.share;
+      phase.keyspaceCdf.push_back(accumShare / totalShare);
+
+      Keyspace ks;
+      ks.firstId = firstIds[k];
+      ks.numKeys = kc.numKeys;
+      if (kc.popularity == "zipf") {
+        ks.popularity = Popularity::kZipf;
+        ks.zipf = ZipfSampler{kc.numKeys, kc.alpha};
+      } else if (kc.popularity == "uniform") {
+        ks.popularity = Popularity::kUniform;
+      } else if (kc.popularity == "scan") {
+        ks.popularity = Popularity::kScan;
+      } else if (kc.popularity == "hotset") {
+        ks.popularity = Popularity::kHotSet;
+        if (kc.hotSetSize == 0 || kc.hotSetSize > kc.numKeys) {
+          throw std::invalid_argument(folly::sformat(
+              "phase {} keyspace {}: hotSetSize must be within 1 and {}", i, k,
+              kc.numKeys));
+        }
+      } else {
+        throw std::invalid_argument(folly::sformat(
+            "phase {} keyspace {}: unsupported popularity {}", i, k,
+            kc.popularity));
+      }
+      ks.hotSetSize = kc.hotSetSize;
+      ks.hotSetProbability = kc.hotSetProbability;
+      ks.hotSetChurnEveryXReqs = kc.hotSetChurnEveryXReqs;
+
+      if (kc.valSizeRange.size() != kc.valSizeRangeProbability.size() + 1 ||
+          kc.valSizeRangeProbability.empty()) {
+        throw std::invalid_argument(folly::sformat(
+            "phase {} keyspace {}: value size range and probabilities do not "
+            "match up",
+            i, k));
+      }
+      double totalProb = 0;
+      for (auto p : kc.valSizeRangeProbability) {
+        totalProb += p;
+      }
+      double accumProb = 0;
+      for (auto p : kc.valSizeRangeProbability) {
+        accumProb += p;
+        ks.sizeCdf.push_back(accumProb / totalProb);
+      }
+      for (auto size : kc.valSizeRange) {
+        ks.sizeRange.push_back(std::max<uint64_t>(static_cast<uint64_t>(size), 1));
+      }
+      phase.keyspaces.push_back(std::move(ks));
+    }
+    // guard against rounding leaving the last bucket short of 1
+    phase.keyspaceCdf.back() = 1.0;
+    phases_.push_back(std::move(phase));
+  }
+}
+
+void PhasedGenerator::initThread(ThreadState& s) {
+  s.threadId = nextThreadId_.fetch_add(1, std::memory_order_relaxed);
+  s.gen.seed(folly::hash::hash_combine(seed_, s.threadId));
+  s.phase = 0;
+  s.phaseEnd = phases_[0].numRequests;
+  // threads take turns on the ids, so together they sweep the keyspace in
+  // order
+  s.scanCursors.resize(maxKeyspaces_);
+  for (size_t k = 0; k < maxKeyspaces_; k++) {
+    s.scanCursors[k] = s.threadId;
+  }
+  s.key.resize(sizeof(uint64_t));
+  s.initialized = true;
+}
+
+uint64_t PhasedGenerator::sampleIndex(ThreadState& s, size_t keyspaceIdx) {
+  const auto& ks = phases_[s.phase].keyspaces[keyspaceIdx];
+  switch (ks.popularity) {
+  case Popularity::kZipf:
+    return ks.zipf(s.gen) - 1;
+  case Popularity::kUniform:
+    return s.gen() % ks.numKeys;
+  case Popularity::kScan: {
+    auto& cursor = s.scanCursors[keyspaceIdx];
+    const auto idx = cursor % ks.numKeys;
+    cursor = idx + numThreads_;
+    return idx;
+  }
+  case Popularity::kHotSet: {
+    if (uniform01(s.gen) >= ks.hotSetProbability) {
+      return s.gen() % ks.numKeys;
+    }
+    uint64_t start = 0;
+    if (ks.hotSetChurnEveryXReqs > 0) {
+      // move the window on the request count of all threads together
+      const uint64_t moves = s.count * numThreads_ / ks.hotSetChurnEveryXReqs;
+      start = moves % ks.numKeys * ks.hotSetSize % ks.numKeys;
+    }
+    return (start + s.gen() % ks.hotSetSize) % ks.numKeys;
+  }
+  }
+  return 0;
+}
+
+uint64_t PhasedGenerator::sampleSize(const Keyspace& ks, uint64_t id) const {
+  const uint64_t hash = folly::hash::twang_mix64(id ^ seed_);
+  const double u = static_cast<double>(hash >> 11) * 0x1.0p-53;
+  size_t bucket = 0;
+  while (bucket + 1 < ks.sizeCdf.size() && u >= ks.sizeCdf[bucket]) {
+    bucket++;
+  }
+  const uint64_t low = ks.sizeRange[bucket];
+  const uint64_t high = ks.sizeRange[bucket + 1];
+  if (high <= low + 1) {
+    return low;
+  }
+  return low + folly::hash::twang_mix64(hash) % (high - low);
+}
+
+uint64_t PhasedGenerator::next(ThreadState& s) {
+  if (s.count == s.phaseEnd) {
+    s.phase = (s.phase + 1) % phases_.size();
+    s.phaseEnd += phases_[s.phase].numRequests;
+  }
+  const auto& phase = phases_[s.phase];
+
+  // few keyspaces per phase, a linear search is the fastest
+  const double u = uniform01(s.gen);
+  size_t k = 0;
+  while (u >= phase.keyspaceCdf[k] && k + 1 < phase.keyspaceCdf.size()) {
+    k++;
+  }
+  const auto& ks = phase.keyspaces[k];
+  const uint64_t id = ks.firstId + sampleIndex(s, k);
+
+  std::memcpy(s.key.data(), &id, sizeof(id));
+  s.sizes[0] = sampleSize(ks, id);
+  s.req.sizeBegin = s.sizes.begin();
+  s.req.sizeEnd = s.sizes.end();
+
+  const double opU = uniform01(s.gen);
+  if (opU < phase.setRatio) {
+    s.req.setOp(OpType::kSet);
+  } else if (opU < phase.setRatio + phase.delRatio) {
+    s.req.setOp(OpType::kDel);
+  } else {
+    s.req.setOp(OpType::kGet);
+  }
+  s.req.timestamp = s.count * numThreads_ / requestsPerSecond_;
+  s.count++;
+  return id;
+}
+
+const Request& PhasedGenerator::getReq(uint8_t,
+                                       std::mt19937_64&,
+                                       std::optional<uint64_t>) {
+  auto& s = *state_;
+  if (!s.initialized) {
+    initThread(s);
+  }
+  next(s);
+  return s.req;
+}
+
+void PhasedGenerator::writeOracleTrace(const StressorConfig& config,
+                                       const std::string& path,
+                                       uint64_t numRequests) {
+  PhasedGenerator generator{config, 1};
+  ThreadState s;
+  generator.initThread(s);
+
+  std::vector<OracleGeneralBinRecord> records(numRequests);
+  for (uint64_t i = 0; i < numRequests; i++) {
+    auto& record = records[i];
+    record.objId = generator.next(s);
+    record.objSize = static_cast<uint32_t>(*s.req.sizeBegin);
+    record.clockTime = static_cast<uint32_t>(s.req.timestamp);
+  }
+
+  // walk back to find the next access of every request
+  folly::F14FastMap<uint64_t, int64_t> nextAccess;
+  for (uint64_t i = numRequests; i-- > 0;) {
+    auto& record = records[i];
+    auto [it, inserted] =
+        nextAccess.try_emplace(record.objId, static_cast<int64_t>(i));
+    record.nextAccessVtime = inserted ? -1 : it->second;
+    it->second = static_cast<int64_t>(i);
+  }
+
+  folly::File file(path.c_str(), O_CREAT | O_WRONLY | O_TRUNC);
+  const auto bytes = records.size() * sizeof(OracleGeneralBinRecord);
+  folly::checkUnixError(folly::writeFull(file.fd(), records.data(), bytes),
+                        "Failed to write phased trace ", path);
+  XLOGF(INFO, "Wrote {} requests over {} keys to {}", numRequests,
+        nextAccess.size(), path);
+}
+
+} // namespace cachebench
+} // namespace cachelib
+} // namespace facebook
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <folly/ThreadLocal.h>
+
+#include <atomic>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "cachelib/cachebench/util/Config.h"
+#include "cachelib/cachebench/util/Request.h"
+#include "cachelib/cachebench/workload/GeneratorBase.h"
+
+namespace facebook {
+namespace cachelib {
+namespace cachebench {
+
+// Samples ranks 1..n with probability proportional to rank^-alpha in constant
+// time and without tables, by rejection inversion (Hormann and Derflinger,
+// "Rejection-inversion to generate variates from monotone discrete
+// distributions").
+class ZipfSampler {
+ public:
+  ZipfSampler(uint64_t n, double alpha);
+
+  uint64_t operator()(std::mt19937_64& gen) const;
+
+ private:
+  double h(double x) const;
+  double hIntegral(double x) const;
+  double hIntegralInverse(double x) const;
+
+  uint64_t n_;
+  double alpha_;
+  double hIntegralX1_;
+  double hIntegralN_;
+  double s_;
+};
+
+// Synthetic workload made of phases that run one after another and repeat.
+// Every phase sends its requests to a set of keyspaces by share, and every
+// keyspace has its own popularity and value size distribution, so the
+// phases shift the per-class demand the rebalancers have to follow.
+//
+// Each stressor thread generates its own stream from its own seeded random
+// engine, without locks or allocations, and runs through the phases at
+// 1/numThreads of their length. With one thread the stream is the same in
+// every run; with more, each thread's stream is, but which thread gets which
+// stream may vary. Keys are 8 byte key ids and ignore the pool.
+class PhasedGenerator : public GeneratorBase {
+ public:
+  explicit PhasedGenerator(const StressorConfig& config);
+
+  const Request& getReq(
+      uint8_t poolId,
+      std::mt19937_64& gen,
+      std::optional<uint64_t> lastRequestId = std::nullopt) override;
+
+  const std::vector<std::string>& getAllKeys() const override {
+    throw std::logic_error("PhasedGenerator has no keys precomputed!");
+  }
+
+  // Write numRequests of the single threaded stream as an oracleGeneral
+  // binary trace with next_access_vtime filled in, for replaying with
+  // oracle-general-replay against offline optimal baselines.
+  static void writeOracleTrace(const StressorConfig& config,
+                               const std::string& path,
+                               uint64_t numRequests);
+
+ private:
+  enum class Popularity { kZipf, kUniform, kScan, kHotSet };
+
+  struct Keyspace {
+    uint64_t firstId{0};
+    uint64_t numKeys{0};
+    Popularity popularity{Popularity::kZipf};
+    ZipfSampler zipf{1, 1.0};
+    uint64_t hotSetSize{0};
+    double hotSetProbability{0};
+    uint64_t hotSetChurnEveryXReqs{0};
+    // cumulative probabilities and bounds of the value size ranges. Sizes
+    // are a hash of the key id, so a key keeps its size while the
+    // distribution does.
+    std::vector<double> sizeCdf;
+    std::vector<uint64_t> sizeRange;
+  };
+
+  struct Phase {
+    // per thread
+    uint64_t numRequests{0};
+    double setRatio{0};
+    double delRatio{0};
+    // cumulative shares of the keyspaces
+    std::vector<double> keyspaceCdf;
+    std::vector<Keyspace> keyspaces;
+  };
+
+  struct ThreadState {
+    bool initialized{false};
+    uint32_t threadId{0};
+    std::mt19937_64 gen;
+    // requests generated by this thread
+    uint64_t count{0};
+    size_t phase{0};
+    uint64_t phaseEnd{0};
+    std::vector<uint64_t> scanCursors;
+
+    std::string key;
+    std::vector<size_t> sizes{1};
+    Request req{key, sizes.begin(), sizes.end()};
+  };
+
+  PhasedGenerator(const StressorConfig& config, uint32_t numThreads);
+
+  void initThread(ThreadState& s);
+  // fills s.req with the next request of the stream and returns its key id
+  uint64_t next(ThreadState& s);
+  uint64_t sampleIndex(ThreadState& s, size_t keyspaceIdx);
+  uint64_t sampleSize(const Keyspace& ks, uint64_t id) const;
+
+  const uint64_t seed_;
+  const uint64_t requestsPerSecond_;
+  const uint32_t numThreads_;
+  std::vector<Phase> phases_;
+  size_t maxKeyspaces_{0};
+
+  std::atomic<uint32_t> nextThreadId_{0};
+
+  class Tag;
+  folly::ThreadLocal<ThreadState, Tag> state_;
+};
+
+} // namespace cachebench
+} // namespace cachelib
+} // namespace facebook
@@ -21,10 +21,13 @@
 #include <folly/logging/xlog.h>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -271,6 +274,11 @@ class ReplayGeneratorBase : public GeneratorBase {
       throw std::invalid_argument(
           "Cannot replay traces with consistency checking enabled");
     }
+    if (config.deterministicReplay &&
+        mode_ != ReplayGeneratorConfig::SerializeMode::strict) {
+      throw std::invalid_argument(
+          "Deterministic replay requires the strict serialization mode");
+    }
   }
 
   const std::vector<std::string>& getAllKeys() const override {
@@ -278,6 +286,18 @@ class ReplayGeneratorBase : public GeneratorBase {
   }
 
  protected:
+  // Registers the logical clock callback for generators that drive the clock
+  // through tickLogicalClock(), completeLogicalRequest() and
+  // markShardFinished(). They expose it through setLogicalClockCallback().
+  bool registerLogicalClockCallback(LogicalClockCallback cb) {
+    if (!config_.deterministicReplay) {
+      return false;
+    }
+    logicalClockCb_ = std::move(cb);
+    logicalClockReady_.store(true, std::memory_order_release);
+    return true;
+  }
+
   const StressorConfig config_;
   const bool repeatTraceReplay_;
   const size_t ampFactor_;
@@ -293,6 +313,53 @@ class ReplayGeneratorBase : public GeneratorBase {
 
   std::vector<std::string> keys_;
 
+  // Logical clock of a deterministic replay, driven by the generator thread.
+  //
+  // Every request handed to a stressor advances the clock by one. When the
+  // clock reaches the time of the next global event, the generator stops
+  // dispatching until all earlier requests have completed and then runs the
+  // stressor's callback, so the event observes exactly the first t requests
+  // of the trace no matter how they were spread over the stressor threads.
+  //
+  // Returns false if the test is shutting down.
+  bool tickLogicalClock() {
+    if (!config_.deterministicReplay) {
+      return true;
+    }
+    if (logicalTime_ == nextLogicalEvent_) {
+      // once a stressor thread has stopped, the requests left in its queue
+      // never complete, so stop waiting for them
+      while (!logicalClockReady_.load(std::memory_order_acquire) ||
+             (inFlight_.load(std::memory_order_acquire) != 0 &&
+              finishedShards_.load(std::memory_order_relaxed) == 0)) {
+        if (shouldShutdown()) {
+          return false;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds{10});
+      }
+      logicalClockEvents_++;
+      nextLogicalEvent_ = logicalClockCb_(logicalTime_);
+      XCHECK_GT(nextLogicalEvent_, logicalTime_);
+    }
+    logicalTime_++;
+    inFlight_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Marks a request counted by tickLogicalClock() as done, either because
+  // the stressor completed it or because it was never handed out.
+  void completeLogicalRequest() {
+    if (config_.deterministicReplay) {
+      inFlight_.fetch_sub(1, std::memory_order_release);
+    }
+  }
+
+  void markShardFinished() {
+    finishedShards_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  uint64_t getLogicalClockEvents() const { return logicalClockEvents_.load(); }
+
   // Return the shard for the key.
   uint32_t getShard(folly::StringPiece key) {
     if (mode_ == ReplayGeneratorConfig::SerializeMode::strict) {
@@ -303,6 +370,17 @@ class ReplayGeneratorBase : public GeneratorBase {
       return folly::Random::rand32(numShards_);
     }
   }
+
+ private:
+  LogicalClockCallback logicalClockCb_;
+  std::atomic<bool> logicalClockReady_{false};
+  // owned by the generator thread
+  uint64_t logicalTime_{0};
+  uint64_t nextLogicalEvent_{0};
+  // requests dispatched but not completed yet
+  std::atomic<uint64_t> inFlight_{0};
+  std::atomic<uint32_t> finishedShards_{0};
+  std::atomic<uint64_t> logicalClockEvents_{0};
 };
 
 } // namespace cachebench
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <folly/lang/Align.h>
+#include <folly/logging/xlog.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace facebook {
+namespace cachelib {
+namespace cachebench {
+
+// ReqWrapperPool is a fixed-capacity slab of request wrappers that replay
+// generators recycle instead of allocating one wrapper per trace line.
+//
+// All wrappers are constructed up front in one contiguous array, so their
+// addresses (which the replay generators use as request ids) stay stable and
+// the strings and vectors inside keep their capacity across reuses. In steady
+// state neither allocate() nor release() touches the heap.
+//
+// Threading model:
+//  - allocate(), setShard() and releaseLocal() are called by the single
+//    generator thread only.
+//  - release() may be called by any thread, typically the stressor thread
+//    that owns the shard the wrapper was dispatched to.
+//
+// Each shard has its own free list, so stressor threads returning wrappers
+// never contend with each other; the generator drains a whole free list at
+// once when its private list runs dry.
+template <typename T>
+class ReqWrapperPool {
+ public:
+  // @param numShards     number of stressor shards returning wrappers
+  // @param capacity      total number of wrappers in the pool
+  // @param keyCapacity   bytes reserved up front for each wrapper's key_ so
+  //                      that keys up to this size never allocate
+  ReqWrapperPool(uint32_t numShards, size_t capacity, size_t keyCapacity)
+      : slab_(new T[capacity]),
+        next_(new T*[capacity]),
+        shards_(new uint32_t[capacity]),
+        freeLists_(new FreeList[numShards]),
+        numShards_(numShards),
+        capacity_(capacity) {
+    XCHECK_GT(numShards_, 0u);
+    for (size_t i = 0; i < capacity_; i++) {
+      slab_[i].key_.reserve(keyCapacity);
+      next_[i] = i + 1 < capacity_ ? &slab_[i + 1] : nullptr;
+      shards_[i] = 0;
+    }
+    local_ = capacity_ > 0 ? &slab_[0] : nullptr;
+  }
+
+  ReqWrapperPool(const ReqWrapperPool&) = delete;
+  ReqWrapperPool& operator=(const ReqWrapperPool&) = delete;
+
+  // Returns a free wrapper, or nullptr if every wrapper is outstanding. The
+  // wrapper keeps whatever state it had when it was released; callers are
+  // expected to overwrite it.
+  T* allocate() {
+    if (!local_) {
+      refill();
+      if (!local_) {
+        return nullptr;
+      }
+    }
+    T* wrapper = local_;
+    local_ = next_[indexOf(wrapper)];
+    return wrapper;
+  }
+
+  // Records the shard the wrapper is dispatched to; release() returns it to
+  // that shard's free list.
+  void setShard(T* wrapper, uint32_t shard) {
+    XDCHECK_LT(shard, numShards_);
+    shards_[indexOf(wrapper)] = shard;
+  }
+
+  // Returns a wrapper once the request it carries is done.
+  void release(T* wrapper) {
+    const size_t idx = indexOf(wrapper);
+    auto& head = freeLists_[shards_[idx]].head;
+    T* old = head.load(std::memory_order_relaxed);
+    do {
+      next_[idx] = old;
+    } while (!head.compare_exchange_weak(
+        old, wrapper, std::memory_order_release, std::memory_order_relaxed));
+  }
+
+  // Returns a wrapper that the generator allocated but never dispatched.
+  void releaseLocal(T* wrapper) {
+    next_[indexOf(wrapper)] = local_;
+    local_ = wrapper;
+  }
+
+  size_t capacity() const { return capacity_; }
+
+ private:
+  struct alignas(folly::hardware_destructive_interference_size) FreeList {
+    std::atomic<T*> head{nullptr};
+  };
+
+  size_t indexOf(const T* wrapper) const {
+    XDCHECK(wrapper >= slab_.get() && wrapper < slab_.get() + capacity_);
+    return static_cast<size_t>(wrapper - slab_.get());
+  }
+
+  // Take over an entire shard free list. Only the generator pops, so there
+  // is no ABA hazard in swapping the head out.
+  void refill() {
+    for (uint32_t i = 0; i < numShards_ && !local_; i++) {
+      auto& head = freeLists_[nextShard_].head;
+      nextShard_ = (nextShard_ + 1) % numShards_;
+      if (head.load(std::memory_order_relaxed) != nullptr) {
+        local_ = head.exchange(nullptr, std::memory_order_acquire);
+      }
+    }
+  }
+
+  std::unique_ptr<T[]> slab_;
+  // free list links and dispatch shard, indexed like slab_
+  std::unique_ptr<T*[]> next_;
+  std::unique_ptr<uint32_t[]> shards_;
+  std::unique_ptr<FreeList[]> freeLists_;
+  const uint32_t numShards_;
+  const size_t capacity_;
+
+  // generator private free list
+  T* local_{nullptr};
+  // shard free list to drain next
+  uint32_t nextShard_{0};
+};
+
+} // namespace cachebench
+} // namespace cachelib
+} // namespace facebook
@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <folly/Conv.h>
+#include <folly/Likely.h>
+#include <folly/lang/Bits.h>
+#include <folly/lang/Align.h>
+#include <folly/logging/xlog.h>
+#include <folly/system/ThreadName.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#include "cachelib/allocator/memory/Slab.h"
+#include "cachelib/cachebench/util/Config.h"
+#include "cachelib/cachebench/util/Exceptions.h"
+#include "cachelib/cachebench/util/Request.h"
+#include "cachelib/cachebench/workload/MmapTraceReader.h"
+#include "cachelib/cachebench/workload/ReplayGeneratorBase.h"
+
+namespace facebook {
+namespace cachelib {
+namespace cachebench {
+
+// TraceBroadcaster decodes an oracleGeneral binary trace once and hands every
+// record to each of a fixed number of consumers, so that several cache
+// instances can replay the same trace without reading it several times.
+//
+// Records are copied by a single producer thread into a ring that all
+// consumers read from. Each consumer owns a cursor; the producer reuses a
+// slot only after every consumer has moved past it, so the slowest consumer
+// bounds how far ahead the producer can decode. Neither side takes a lock:
+// the producer publishes its head and the consumers publish their cursors in
+// batches, and both sides only poll the other when they run out of room or
+// records.
+//
+// When timeBarrier is set, records with a new timestamp are held back until
+// every consumer has replayed all records of the previous timestamp. Replays
+// driven by the process-wide mock timer (useTraceTimer) thus all observe the
+// same clock while they run concurrently.
+class TraceBroadcaster {
+ public:
+  // @param config        stress config with the trace to replay
+  // @param numConsumers  number of consumers reading every record
+  // @param ringRecords   capacity of the ring, rounded up to a power of two
+  // @param timeBarrier   hold records back at timestamp changes
+  //
+  // @throw std::invalid_argument if the trace is not an oracleGeneral binary
+  //        trace or the parameters are invalid
+  TraceBroadcaster(const StressorConfig& config,
+                   uint32_t numConsumers,
+                   size_t ringRecords,
+                   bool timeBarrier)
+      : numConsumers_(numConsumers),
+        capacity_(folly::nextPowTwo(
+            std::max<size_t>(ringRecords, 2 * kPublishBatch))),
+        mask_(capacity_ - 1),
+        timeBarrier_(timeBarrier),
+        ring_(new OracleGeneralBinRecord[capacity_]),
+        cursors_(new Cursor[numConsumers]) {
+    if (!config.zstdTrace) {
+      throw std::invalid_argument(
+          "Trace broadcast only supports oracleGeneral binary traces");
+    }
+    if (numConsumers_ == 0) {
+      throw std::invalid_argument("Trace broadcast needs a consumer");
+    }
+    reader_.open(config.traceFileName, config.compressed,
+                 config.traceReaderThreads);
+  }
+
+  ~TraceBroadcaster() {
+    stop_.store(true, std::memory_order_relaxed);
+    if (producer_.joinable()) {
+      producer_.join();
+    }
+  }
+
+  TraceBroadcaster(const TraceBroadcaster&) = delete;
+  TraceBroadcaster& operator=(const TraceBroadcaster&) = delete;
+
+  // Start decoding the trace.
+  void start() {
+    producer_ = std::thread([this] {
+      folly::setThreadName("cb_trace_bcast");
+      produce();
+    });
+  }
+
+  // Returns the next record for the consumer, or nullptr once the trace is
+  // exhausted. The record is valid until the consumer calls next() again.
+  // Each consumer must be driven by a single thread.
+  const OracleGeneralBinRecord* next(uint32_t consumer) {
+    XDCHECK_LT(consumer, numConsumers_);
+    auto& cursor = cursors_[consumer];
+    if (FOLLY_UNLIKELY(cursor.local == cursor.cachedHead)) {
+      if (!waitForRecords(cursor)) {
+        return nullptr;
+      }
+    } else if ((cursor.local & (kPublishBatch - 1)) == 0) {
+      cursor.pos.store(cursor.local, std::memory_order_release);
+    }
+    return &ring_[cursor.local++ & mask_];
+  }
+
+  // Stop waiting for the consumer. Must be called by a consumer that stops
+  // reading before the end of the trace, or the producer stalls once the
+  // ring fills up.
+  void detach(uint32_t consumer) {
+    XDCHECK_LT(consumer, numConsumers_);
+    cursors_[consumer].pos.store(kDetached, std::memory_order_release);
+  }
+
+  uint32_t numConsumers() const { return numConsumers_; }
+  size_t capacity() const { return capacity_; }
+
+  // number of records decoded so far
+  uint64_t getRecords() const { return head_.load(std::memory_order_relaxed); }
+
+  // number of times the producer waited for the slowest consumer
+  uint64_t getProducerWaits() const {
+    return producerWaits_.load(std::memory_order_relaxed);
+  }
+
+  // number of timestamp changes that all consumers were synchronized on
+  uint64_t getTimeBarriers() const {
+    return timeBarriers_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  // Records between two publications of the producer head or of a consumer
+  // cursor. Trades staleness for less cache line traffic.
+  static constexpr uint64_t kPublishBatch = 256;
+  static constexpr uint64_t kDetached = std::numeric_limits<uint64_t>::max();
+  static constexpr uint64_t kPollIntervalUs = 10;
+
+  struct alignas(folly::hardware_destructive_interference_size) Cursor {
+    // records the consumer is done with; read by the producer
+    std::atomic<uint64_t> pos{0};
+    // consumer private: next record to read and the last head it saw
+    uint64_t local{0};
+    uint64_t cachedHead{0};
+  };
+
+  bool waitForRecords(Cursor& cursor) {
+    // everything before local is done; let the producer reuse it
+    cursor.pos.store(cursor.local, std::memory_order_release);
+    while ((cursor.cachedHead = head_.load(std::memory_order_acquire)) ==
+           cursor.local) {
+      if (done_.load(std::memory_order_acquire)) {
+        // the last batch is published before done_
+        cursor.cachedHead = head_.load(std::memory_order_acquire);
+        return cursor.cachedHead != cursor.local;
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds{kPollIntervalUs});
+    }
+    return true;
+  }
+
+  uint64_t minCursor() const {
+    uint64_t min = kDetached;
+    for (uint32_t i = 0; i < numConsumers_; i++) {
+      min = std::min(min, cursors_[i].pos.load(std::memory_order_acquire));
+    }
+    return min;
+  }
+
+  // Publish the head and wait until every consumer has read past limit.
+  // Returns false on shutdown or once every consumer has detached.
+  bool waitForConsumers(uint64_t head, uint64_t limit) {
+    head_.store(head, std::memory_order_release);
+    while ((minTail_ = minCursor()) < limit) {
+      if (stop_.load(std::memory_order_relaxed)) {
+        return false;
+      }
+      producerWaits_.fetch_add(1, std::memory_order_relaxed);
+      std::this_thread::sleep_for(std::chrono::microseconds{kPollIntervalUs});
+    }
+    return minTail_ != kDetached;
+  }
+
+  void produce() {
+    uint64_t head = 0;
+    uint32_t lastTime = 0;
+    while (!stop_.load(std::memory_order_relaxed)) {
+      const auto* rec = reader_.next();
+      if (!rec) {
+        break;
+      }
+      if (timeBarrier_ && head > 0 && rec->clockTime != lastTime) {
+        if (!waitForConsumers(head, head)) {
+          break;
+        }
+        timeBarriers_.fetch_add(1, std::memory_order_relaxed);
+      }
+      lastTime = rec->clockTime;
+      // the slot is free once every consumer has moved past the record that
+      // was stored in it capacity_ records ago
+      if (head - minTail_ >= capacity_ &&
+          !waitForConsumers(head, head - capacity_ + 1)) {
+        break;
+      }
+      ring_[head & mask_] = *rec;
+      if ((++head & (kPublishBatch - 1)) == 0) {
+        head_.store(head, std::memory_order_release);
+      }
+    }
+    head_.store(head, std::memory_order_release);
+    done_.store(true, std::memory_order_release);
+    reader_.close();
+  }
+
+  const uint32_t numConsumers_;
+  const size_t capacity_;
+  const size_t mask_;
+  const bool timeBarrier_;
+
+  MmapTraceReader reader_;
+  std::unique_ptr<OracleGeneralBinRecord[]> ring_;
+  std::unique_ptr<Cursor[]> cursors_;
+
+  // records published to the consumers
+  alignas(folly::hardware_destructive_interference_size)
+      std::atomic<uint64_t> head_{0};
+  std::atomic<bool> done_{false};
+  std::atomic<bool> stop_{false};
+
+  // producer private: slowest consumer cursor last seen
+  uint64_t minTail_{0};
+
+  std::atomic<uint64_t> producerWaits_{0};
+  std::atomic<uint64_t> timeBarriers_{0};
+
+  std::thread producer_;
+};
+
+// BroadcastReplayGenerator replays the records one consumer of a
+// TraceBroadcaster receives. It feeds a single stressor thread and applies
+// the same filtering as OGBinaryReplayGenerator does for binary traces.
+class BroadcastReplayGenerator : public ReplayGeneratorBase {
+ public:
+  // @param config        stress config of this replay
+  // @param broadcaster   shared trace broadcaster
+  // @param consumer      consumer id of this replay in the broadcaster
+  //
+  // @throw std::invalid_argument if the config can not be replayed from a
+  //        shared trace
+  BroadcastReplayGenerator(const StressorConfig& config,
+                           std::shared_ptr<TraceBroadcaster> broadcaster,
+                           uint32_t consumer)
+      : ReplayGeneratorBase(config),
+        broadcaster_(std::move(broadcaster)),
+        consumer_(consumer) {
+    if (numShards_ != 1) {
+      throw std::invalid_argument(
+          "Broadcast replay requires a single stressor thread");
+    }
+    if (ampFactor_ != 1 || repeatTraceReplay_ || config_.deterministicReplay) {
+      throw std::invalid_argument(
+          "Broadcast replay does not support ampFactor, repeatTraceReplay or "
+          "deterministicReplay");
+    }
+    XCHECK_LT(consumer_, broadcaster_->numConsumers());
+    key_.reserve(kKeyCapacity);
+  }
+
+  ~BroadcastReplayGenerator() override { broadcaster_->detach(consumer_); }
+
+  const Request& getReq(uint8_t,
+                        std::mt19937_64&,
+                        std::optional<uint64_t> = std::nullopt) override {
+    const OracleGeneralBinRecord* rec;
+    do {
+      rec = broadcaster_->next(consumer_);
+      if (!rec) {
+        throw EndOfTrace("EOF reached");
+      }
+    } while (rec->objSize == 0 ||
+             (config_.ignoreLargeReq &&
+              rec->objSize + folly::digits10(rec->objId) + 32 >=
+                  kMaxSlabSize));
+
+    char keyBuf[20];
+    size_t keyLen = folly::uint64ToBufferUnsafe(rec->objId, keyBuf);
+    key_.assign(keyBuf, keyLen);
+    sizes_[0] = rec->objSize;
+    req_.timestamp = rec->clockTime;
+    req_.setOp(OpType::kGet);
+    replayed_++;
+    return req_;
+  }
+
+  void notifyResult(uint64_t, OpResultType) override {}
+
+  void markFinish() override { broadcaster_->detach(consumer_); }
+
+  void renderStats(uint64_t, std::ostream& out) const override {
+    out << std::endl << "== BroadcastReplayGenerator Stats ==" << std::endl;
+    out << folly::sformat("{}: {:.2f} million", "Total Processed Samples",
+                          replayed_.load() / 1e6)
+        << std::endl;
+    out << folly::sformat("{}: {} (ring {} records, producer waits {})",
+                          "Broadcast Consumers", broadcaster_->numConsumers(),
+                          broadcaster_->capacity(),
+                          broadcaster_->getProducerWaits())
+        << std::endl;
+  }
+
+ private:
+  static constexpr size_t kMaxSlabSize = 1ULL << Slab::kNumSlabBits;
+  static constexpr size_t kKeyCapacity = 32;
+
+  std::shared_ptr<TraceBroadcaster> broadcaster_;
+  const uint32_t consumer_;
+
+  std::string key_;
+  std::vector<size_t> sizes_{0};
+  // requests carry no id: the only outstanding request is this one
+  Request req_{key_, sizes_.begin(), sizes_.end(), OpType::kGet};
+
+  // Stats
+  std::atomic<uint64_t> replayed_{0};
+};
+
+} // namespace cachebench
+} // namespace cachelib
+} // namespace facebook
@@ -131,13 +131,14 @@ TEST(KVReplayGeneratorTest, BasicFormat) {
 
   auto req = std::make_unique<ReqWrapper>();
   // blank line
-  ASSERT_FALSE(replayer.parseRequest("", req));
+  ASSERT_FALSE(replayer.parseRequest("", *req));
   // header lines
-  ASSERT_FALSE(replayer.parseRequest("key,op,size,op_count,key_size", req));
-  ASSERT_FALSE(replayer.parseRequest("key,op,size,op_count,key_size,ttl", req));
+  ASSERT_FALSE(replayer.parseRequest("key,op,size,op_count,key_size", *req));
+  ASSERT_FALSE(
+      replayer.parseRequest("key,op,size,op_count,key_size,ttl", *req));
 
   for (auto& trace : kTraces) {
-    ASSERT_EQ(replayer.parseRequest(trace.getline(HeaderFormat::v1), req),
+    ASSERT_EQ(replayer.parseRequest(trace.getline(HeaderFormat::v1), *req),
               trace.valid_);
     trace.validate(*req);
   }
@@ -146,7 +147,7 @@ TEST(KVReplayGeneratorTest, BasicFormat) {
   for (auto& trace : kTraces) {
     trace.getline(HeaderFormat::v1).append(",");
 
-    ASSERT_EQ(replayer.parseRequest(trace.getline(HeaderFormat::v1), req),
+    ASSERT_EQ(replayer.parseRequest(trace.getline(HeaderFormat::v1), *req),
               trace.valid_);
     trace.validate(*req);
   }
@@ -164,7 +165,7 @@ TEST(KVReplayGeneratorTest, DynamicHeader) {
   // v1 header
   ASSERT_TRUE(replayer.setHeaderRow("key,op,size,op_count,key_size,ttl"));
   for (auto& trace : kTraces) {
-    ASSERT_EQ(replayer.parseRequest(trace.getline(HeaderFormat::v1), req),
+    ASSERT_EQ(replayer.parseRequest(trace.getline(HeaderFormat::v1), *req),
               trace.valid_);
     trace.validate(*req);
   }
@@ -177,9 +178,10 @@ TEST(KVReplayGeneratorTest, DynamicHeader) {
       "op_time,key,key_size,op,op_count,size,cache_hits,ttl"));
   for (auto& trace : kTraces) {
     // v1 trace is not compatible to v2 header
-    ASSERT_FALSE(replayer.parseRequest(trace.getline(HeaderFormat::v1), req));
+    ASSERT_FALSE(
+        replayer.parseRequest(trace.getline(HeaderFormat::v1), *req));
     // get line compatible to the header
-    ASSERT_EQ(replayer.parseRequest(trace.getline(HeaderFormat::v2), req),
+    ASSERT_EQ(replayer.parseRequest(trace.getline(HeaderFormat::v2), *req),
               trace.valid_);
     trace.validate(*req);
   }
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <folly/FileUtil.h>
+#include <folly/testing/TestUtil.h>
+#include <gtest/gtest.h>
+#include <zstd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "cachelib/cachebench/workload/MmapTraceReader.h"
+
+namespace facebook {
+namespace cachelib {
+namespace cachebench {
+namespace {
+std::vector<OracleGeneralBinRecord> makeRecords(size_t n) {
+  std::vector<OracleGeneralBinRecord> records(n);
+  for (size_t i = 0; i < n; i++) {
+    records[i].clockTime = static_cast<uint32_t>(i);
+    records[i].objId = i * 7919;
+    records[i].objSize = static_cast<uint32_t>(i % 1000 + 1);
+    records[i].nextAccessVtime = static_cast<int64_t>(i) - 1;
+  }
+  return records;
+}
+
+std::string toBytes(const std::vector<OracleGeneralBinRecord>& records) {
+  return std::string(reinterpret_cast<const char*>(records.data()),
+                     records.size() * sizeof(OracleGeneralBinRecord));
+}
+
+// compress the bytes into frames of at most frameLen input bytes. frameLen is
+// deliberately not a multiple of the record size so records straddle frames.
+std::string compress(const std::string& bytes, size_t frameLen) {
+  std::string out;
+  for (size_t off = 0; off < bytes.size(); off += frameLen) {
+    const size_t len = std::min(frameLen, bytes.size() - off);
+    std::string frame(ZSTD_compressBound(len), '\0');
+    size_t ret =
+        ZSTD_compress(frame.data(), frame.size(), bytes.data() + off, len, 1);
+    EXPECT_FALSE(ZSTD_isError(ret));
+    frame.resize(ret);
+    out += frame;
+  }
+  return out;
+}
+
+void verify(MmapTraceReader& reader,
+            const std::vector<OracleGeneralBinRecord>& records) {
+  for (const auto& expected : records) {
+    auto rec = reader.next();
+    ASSERT_NE(nullptr, rec);
+    ASSERT_EQ(expected.clockTime, rec->clockTime);
+    ASSERT_EQ(expected.objId, rec->objId);
+    ASSERT_EQ(expected.objSize, rec->objSize);
+    ASSERT_EQ(expected.nextAccessVtime, rec->nextAccessVtime);
+  }
+  EXPECT_EQ(nullptr, reader.next());
+  EXPECT_EQ(nullptr, reader.next());
+}
+} // namespace
+
+TEST(MmapTraceReaderTest, Uncompressed) {
+  folly::test::TemporaryDirectory dir;
+  const auto path = (dir.path() / "trace.bin").string();
+  auto records = makeRecords(1000);
+  // trailing bytes of a partial record are ignored
+  ASSERT_TRUE(folly::writeFile(toBytes(records) + "abc", path.c_str()));
+
+  MmapTraceReader reader;
+  reader.open(path, false);
+  verify(reader, records);
+}
+
+TEST(MmapTraceReaderTest, Empty) {
+  folly::test::TemporaryDirectory dir;
+  const auto path = (dir.path() / "trace.bin").string();
+  ASSERT_TRUE(folly::writeFile(std::string{}, path.c_str()));
+
+  MmapTraceReader reader;
+  reader.open(path, false);
+  EXPECT_EQ(nullptr, reader.next());
+  reader.open(path, true);
+  EXPECT_EQ(nullptr, reader.next());
+}
+
+TEST(MmapTraceReaderTest, MissingFile) {
+  MmapTraceReader reader;
+  EXPECT_THROW(reader.open("/does/not/exist", false), std::runtime_error);
+}
+
+TEST(MmapTraceReaderTest, SingleFrame) {
+  folly::test::TemporaryDirectory dir;
+  const auto path = (dir.path() / "trace.bin.zst").string();
+  // spans a few decompression chunks
+  auto records = makeRecords(500 * 1000);
+  auto bytes = toBytes(records);
+  ASSERT_TRUE(folly::writeFile(compress(bytes, bytes.size()), path.c_str()));
+
+  MmapTraceReader reader;
+  reader.open(path, true, 4);
+  EXPECT_EQ(0u, reader.getNumFrames());
+  verify(reader, records);
+}
+
+TEST(MmapTraceReaderTest, MultiFrame) {
+  folly::test::TemporaryDirectory dir;
+  const auto path = (dir.path() / "trace.bin.zst").string();
+  auto records = makeRecords(100 * 1000);
+  auto bytes = toBytes(records);
+  ASSERT_TRUE(folly::writeFile(compress(bytes, 10007), path.c_str()));
+
+  for (uint32_t numThreads : {1, 2, 8}) {
+    MmapTraceReader reader;
+    reader.open(path, true, numThreads);
+    EXPECT_EQ(numThreads > 1 ? (bytes.size() + 10006) / 10007 : 0,
+              reader.getNumFrames());
+    verify(reader, records);
+  }
+}
+
+TEST(MmapTraceReaderTest, CloseWhileDecompressing) {
+  folly::test::TemporaryDirectory dir;
+  const auto path = (dir.path() / "trace.bin.zst").string();
+  auto bytes = toBytes(makeRecords(200 * 1000));
+  ASSERT_TRUE(folly::writeFile(compress(bytes, 4096), path.c_str()));
+
+  // producers blocked on a full ring must not keep close() from returning
+  MmapTraceReader reader;
+  reader.open(path, true, 4);
+  ASSERT_NE(nullptr, reader.next());
+  reader.close();
+  EXPECT_EQ(nullptr, reader.next());
+}
+} // namespace cachebench
+} // namespace cachelib
+} // namespace facebook
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <folly/FileUtil.h>
+#include <folly/Random.h>
+#include <folly/testing/TestUtil.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "cachelib/cachebench/workload/OGBinaryReplayGenerator.h"
+
+namespace facebook {
+namespace cachelib {
+namespace cachebench {
+namespace tests {
+namespace {
+// Writes an uncompressed trace where clockTime is the position of the record
+// in the trace, so replay order can be checked per key.
+void writeTrace(const std::string& path, size_t numRecords, size_t numKeys) {
+  std::vector<OracleGeneralBinRecord> records(numRecords);
+  for (size_t i = 0; i < numRecords; i++) {
+    records[i].clockTime = static_cast<uint32_t>(i);
+    records[i].objId = folly::Random::rand64(numKeys);
+    records[i].objSize = 100;
+    records[i].nextAccessVtime = -1;
+  }
+  ASSERT_TRUE(folly::writeFile(
+      std::string(reinterpret_cast<const char*>(records.data()),
+                  records.size() * sizeof(OracleGeneralBinRecord)),
+      path.c_str()));
+}
+
+StressorConfig makeConfig(const std::string& path, uint32_t numThreads) {
+  StressorConfig config;
+  config.traceFileName = path;
+  config.zstdTrace = true;
+  config.compressed = false;
+  config.numThreads = numThreads;
+  config.deterministicReplay = true;
+  return config;
+}
+} // namespace
+
+TEST(OGBinaryReplayGeneratorTest, LogicalClock) {
+  constexpr size_t kNumRecords = 100 * 1000;
+  constexpr uint64_t kEventInterval = 997;
+  constexpr uint32_t kNumThreads = 4;
+  folly::test::TemporaryDirectory dir;
+  const auto path = (dir.path() / "trace.bin").string();
+  writeTrace(path, kNumRecords, 1000);
+
+  OGBinaryReplayGenerator replayer{makeConfig(path, kNumThreads)};
+  std::atomic<uint64_t> completed{0};
+  std::vector<uint64_t> events;
+  ASSERT_TRUE(replayer.setLogicalClockCallback([&](uint64_t t) {
+    // every request before t has completed and none after it has started
+    EXPECT_EQ(t, completed.load());
+    events.push_back(t);
+    return t + kEventInterval;
+  }));
+
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < kNumThreads; i++) {
+    threads.emplace_back([&]() {
+      std::mt19937_64 gen;
+      // requests for a key are replayed in trace order by a single thread
+      std::unordered_map<std::string, uint64_t> lastSeen;
+      while (true) {
+        try {
+          const auto& req = replayer.getReq(0, gen);
+          auto it = lastSeen.find(req.key);
+          if (it != lastSeen.end()) {
+            EXPECT_LT(it->second, req.timestamp);
+          }
+          lastSeen[req.key] = req.timestamp;
+          completed++;
+          replayer.notifyResult(*req.requestId, OpResultType::kGetMiss);
+        } catch (const EndOfTrace&) {
+          break;
+        }
+      }
+      replayer.markFinish();
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  replayer.markShutdown();
+
+  EXPECT_EQ(kNumRecords, completed.load());
+  ASSERT_EQ((kNumRecords - 1) / kEventInterval + 1, events.size());
+  for (size_t i = 0; i < events.size(); i++) {
+    EXPECT_EQ(i * kEventInterval, events[i]);
+  }
+}
+
+TEST(OGBinaryReplayGeneratorTest, LogicalClockDisabled) {
+  folly::test::TemporaryDirectory dir;
+  const auto path = (dir.path() / "trace.bin").string();
+  writeTrace(path, 10, 10);
+
+  auto config = makeConfig(path, 1);
+  config.deterministicReplay = false;
+  OGBinaryReplayGenerator replayer{config};
+  EXPECT_FALSE(replayer.setLogicalClockCallback([](uint64_t t) { return t; }));
+  replayer.markShutdown();
+}
+} // namespace tests
+} // namespace cachebench
+} // namespace cachelib
+} // namespace facebook
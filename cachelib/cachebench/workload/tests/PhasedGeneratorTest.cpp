@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <folly/FileUtil.h>
+#include <folly/testing/TestUtil.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstring>
+#include <set>
+
+#include "cachelib/cachebench/util/Config.h"
+#include "cachelib/cachebench/workload/MmapTraceReader.h"
+#include "cachelib/cachebench/workload/PhasedGenerator.h"
+
+namespace facebook {
+namespace cachelib {
+namespace cachebench {
+namespace tests {
+namespace {
+PhasedKeyspaceConfig makeKeyspace(uint64_t numKeys,
+                                  const std::string& popularity,
+                                  double size) {
+  PhasedKeyspaceConfig config;
+  config.numKeys = numKeys;
+  config.popularity = popularity;
+  config.valSizeRange = {size, size + 1};
+  config.valSizeRangeProbability = {1.0};
+  return config;
+}
+
+uint64_t keyId(const Request& req) {
+  uint64_t id;
+  EXPECT_EQ(sizeof(id), req.key.size());
+  std::memcpy(&id, req.key.data(), sizeof(id));
+  return id;
+}
+} // namespace
+
+TEST(ZipfSampler, MatchesDistribution) {
+  constexpr uint64_t kNumKeys = 100;
+  constexpr int kNumSamples = 10 * 1000 * 1000;
+  for (double alpha : {0.0, 0.5, 1.0, 1.2}) {
+    ZipfSampler sampler{kNumKeys, alpha};
+    std::mt19937_64 gen{1};
+    std::vector<double> counts(kNumKeys + 1, 0);
+    for (int i = 0; i < kNumSamples; i++) {
+      const auto rank = sampler(gen);
+      ASSERT_GE(rank, 1);
+      ASSERT_LE(rank, kNumKeys);
+      counts[rank]++;
+    }
+    double norm = 0;
+    for (uint64_t k = 1; k <= kNumKeys; k++) {
+      norm += std::pow(k, -alpha);
+    }
+    for (uint64_t k = 1; k <= kNumKeys; k++) {
+      const double expected = std::pow(k, -alpha) / norm;
+      EXPECT_NEAR(expected, counts[k] / kNumSamples, expected * 0.05)
+          << "alpha " << alpha << " rank " << k;
+    }
+  }
+}
+
+TEST(PhasedGenerator, PhasesAndReproducibility) {
+  StressorConfig config;
+  config.numThreads = 1;
+  PhaseConfig first;
+  first.numRequests = 1000;
+  first.keyspaces = {makeKeyspace(100, "zipf", 100),
+                     makeKeyspace(50, "scan", 1000)};
+  PhaseConfig second;
+  second.numRequests = 500;
+  second.setRatio = 0.5;
+  second.keyspaces = {makeKeyspace(10, "uniform", 5000)};
+  config.phasedGeneratorConfig.phases = {first, second};
+
+  PhasedGenerator a{config};
+  PhasedGenerator b{config};
+  std::mt19937_64 gen;
+  std::set<uint64_t> secondPhaseKeys;
+  uint64_t sets = 0;
+  for (int i = 0; i < 3000; i++) {
+    const auto& req = a.getReq(0, gen);
+    const auto id = keyId(req);
+    const auto size = *req.sizeBegin;
+    const auto op = req.getOp();
+
+    const auto& other = b.getReq(0, gen);
+    EXPECT_EQ(id, keyId(other));
+    EXPECT_EQ(size, *other.sizeBegin);
+    EXPECT_EQ(op, other.getOp());
+
+    if (i % 1500 < 1000) {
+      // the scan keyspace starts after the 100 zipf keys
+      EXPECT_LT(id, 150);
+      EXPECT_EQ(id < 100 ? 100 : 1000, size);
+      EXPECT_EQ(OpType::kGet, op);
+    } else {
+      // the keyspace keeps the ids of the first phase
+      EXPECT_LT(id, 10);
+      EXPECT_EQ(5000, size);
+      secondPhaseKeys.insert(id);
+      sets += op == OpType::kSet;
+    }
+  }
+  EXPECT_EQ(10, secondPhaseKeys.size());
+  EXPECT_NEAR(500, sets, 100);
+}
+
+TEST(PhasedGenerator, HotSetChurn) {
+  StressorConfig config;
+  config.numThreads = 1;
+  PhaseConfig phase;
+  phase.numRequests = 1000 * 1000;
+  auto keyspace = makeKeyspace(1000, "hotset", 10);
+  keyspace.hotSetSize = 10;
+  keyspace.hotSetProbability = 1.0;
+  keyspace.hotSetChurnEveryXReqs = 100;
+  phase.keyspaces = {keyspace};
+  config.phasedGeneratorConfig.phases = {phase};
+
+  PhasedGenerator generator{config};
+  std::mt19937_64 gen;
+  for (uint64_t window = 0; window < 5; window++) {
+    for (int i = 0; i < 100; i++) {
+      const auto id = keyId(generator.getReq(0, gen));
+      EXPECT_GE(id, window * 10);
+      EXPECT_LT(id, (window + 1) * 10);
+    }
+  }
+}
+
+TEST(PhasedGenerator, InvalidConfig) {
+  StressorConfig config;
+  EXPECT_THROW(PhasedGenerator{config}, std::invalid_argument);
+
+  PhaseConfig phase;
+  phase.numRequests = 10;
+  phase.keyspaces = {makeKeyspace(10, "lru", 10)};
+  config.phasedGeneratorConfig.phases = {phase};
+  EXPECT_THROW(PhasedGenerator{config}, std::invalid_argument);
+
+  phase.keyspaces = {makeKeyspace(10, "hotset", 10)};
+  config.phasedGeneratorConfig.phases = {phase};
+  EXPECT_THROW(PhasedGenerator{config}, std::invalid_argument);
+}
+
+TEST(PhasedGenerator, OracleTrace) {
+  StressorConfig config;
+  PhaseConfig phase;
+  phase.numRequests = 1000;
+  phase.keyspaces = {makeKeyspace(100, "zipf", 100)};
+  config.phasedGeneratorConfig.phases = {phase};
+
+  folly::test::TemporaryDirectory dir;
+  const auto path = (dir.path() / "phased.bin").string();
+  constexpr uint64_t kNumRequests = 5000;
+  PhasedGenerator::writeOracleTrace(config, path, kNumRequests);
+
+  std::string content;
+  ASSERT_TRUE(folly::readFile(path.c_str(), content));
+  ASSERT_EQ(kNumRequests * sizeof(OracleGeneralBinRecord), content.size());
+  std::vector<OracleGeneralBinRecord> records(kNumRequests);
+  std::memcpy(records.data(), content.data(), content.size());
+
+  for (uint64_t i = 0; i < kNumRequests; i++) {
+    const auto next = records[i].nextAccessVtime;
+    EXPECT_EQ(100, records[i].objSize);
+    uint64_t expected = kNumRequests;
+    for (uint64_t j = i + 1; j < kNumRequests; j++) {
+      if (records[j].objId == records[i].objId) {
+        expected = j;
+        break;
+      }
+    }
+    if (expected == kNumRequests) {
+      EXPECT_EQ(-1, next);
+    } else {
+      EXPECT_EQ(static_cast<int64_t>(expected), next);
+    }
+  }
+}
+} // namespace tests
+} // namespace cachebench
+} // namespace cachelib
+} // namespace facebook
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <folly/FileUtil.h>
+#include <folly/Random.h>
+#include <folly/testing/TestUtil.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "cachelib/cachebench/workload/TraceBroadcaster.h"
+
+namespace facebook {
+namespace cachelib {
+namespace cachebench {
+namespace tests {
+namespace {
+// Writes an uncompressed trace where objId is the position of the record and
+// every recordsPerSecond records share a timestamp.
+void writeTrace(const std::string& path,
+                size_t numRecords,
+                size_t recordsPerSecond) {
+  std::vector<OracleGeneralBinRecord> records(numRecords);
+  for (size_t i = 0; i < numRecords; i++) {
+    records[i].clockTime = static_cast<uint32_t>(i / recordsPerSecond);
+    records[i].objId = i;
+    records[i].objSize = 100;
+    records[i].nextAccessVtime = -1;
+  }
+  ASSERT_TRUE(folly::writeFile(
+      std::string(reinterpret_cast<const char*>(records.data()),
+                  records.size() * sizeof(OracleGeneralBinRecord)),
+      path.c_str()));
+}
+
+StressorConfig makeConfig(const std::string& path) {
+  StressorConfig config;
+  config.traceFileName = path;
+  config.zstdTrace = true;
+  config.compressed = false;
+  config.numThreads = 1;
+  return config;
+}
+} // namespace
+
+TEST(TraceBroadcasterTest, EveryConsumerSeesEveryRecord) {
+  constexpr size_t kNumRecords = 100 * 1000;
+  constexpr uint32_t kNumConsumers = 4;
+  folly::test::TemporaryDirectory dir;
+  const auto path = (dir.path() / "trace.bin").string();
+  writeTrace(path, kNumRecords, 1000);
+
+  // a ring much smaller than the trace, so the producer laps it many times
+  TraceBroadcaster broadcaster{makeConfig(path), kNumConsumers, 1024, false};
+  broadcaster.start();
+
+  std::vector<std::thread> threads;
+  for (uint32_t c = 0; c < kNumConsumers; c++) {
+    threads.emplace_back([&broadcaster, c]() {
+      uint64_t expected = 0;
+      while (const auto* rec = broadcaster.next(c)) {
+        EXPECT_EQ(expected, rec->objId);
+        expected++;
+        // consumers run at different speeds
+        if (folly::Random::oneIn(1000 * (c + 1))) {
+          std::this_thread::sleep_for(std::chrono::microseconds{100});
+        }
+      }
+      EXPECT_EQ(kNumRecords, expected);
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(kNumRecords, broadcaster.getRecords());
+}
+
+TEST(TraceBroadcasterTest, DetachedConsumerDoesNotStall) {
+  constexpr size_t kNumRecords = 10 * 1000;
+  folly::test::TemporaryDirectory dir;
+  const auto path = (dir.path() / "trace.bin").string();
+  writeTrace(path, kNumRecords, 1000);
+
+  TraceBroadcaster broadcaster{makeConfig(path), 2, 512, false};
+  broadcaster.start();
+
+  // consumer 1 stops early and never comes back
+  for (size_t i = 0; i < 10; i++) {
+    ASSERT_NE(nullptr, broadcaster.next(1));
+  }
+  broadcaster.detach(1);
+
+  size_t count = 0;
+  while (broadcaster.next(0)) {
+    count++;
+  }
+  EXPECT_EQ(kNumRecords, count);
+}
+
+TEST(TraceBroadcasterTest, TimeBarrier) {
+  constexpr size_t kNumRecords = 50 * 1000;
+  constexpr size_t kRecordsPerSecond = 700;
+  constexpr uint32_t kNumConsumers = 3;
+  folly::test::TemporaryDirectory dir;
+  const auto path = (dir.path() / "trace.bin").string();
+  writeTrace(path, kNumRecords, kRecordsPerSecond);
+
+  TraceBroadcaster broadcaster{makeConfig(path), kNumConsumers, 4096, true};
+  broadcaster.start();
+
+  // number of consumers that have seen each timestamp
+  constexpr size_t kSeconds = (kNumRecords - 1) / kRecordsPerSecond + 1;
+  std::vector<std::atomic<uint32_t>> seen(kSeconds);
+  std::vector<std::thread> threads;
+  for (uint32_t c = 0; c < kNumConsumers; c++) {
+    threads.emplace_back([&, c]() {
+      int64_t last = -1;
+      while (const auto* rec = broadcaster.next(c)) {
+        const int64_t time = rec->clockTime;
+        if (time != last) {
+          if (time > 0) {
+            // nobody gets here before every consumer reached the previous
+            // second, however slow it is
+            EXPECT_EQ(kNumConsumers, seen[time - 1].load());
+          }
+          seen[time]++;
+          last = time;
+        }
+        if (folly::Random::oneIn(100 * (c + 1))) {
+          std::this_thread::sleep_for(std::chrono::microseconds{10});
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(kSeconds - 1, broadcaster.getTimeBarriers());
+}
+
+TEST(TraceBroadcasterTest, BroadcastReplayGenerator) {
+  folly::test::TemporaryDirectory dir;
+  const auto path = (dir.path() / "trace.bin").string();
+  writeTrace(path, 100, 10);
+
+  auto config = makeConfig(path);
+  auto broadcaster = std::make_shared<TraceBroadcaster>(config, 1, 512, false);
+  BroadcastReplayGenerator replayer{config, broadcaster, 0};
+  broadcaster->start();
+
+  std::mt19937_64 gen;
+  for (size_t i = 0; i < 100; i++) {
+    const auto& req = replayer.getReq(0, gen);
+    EXPECT_EQ(folly::to<std::string>(i), req.key);
+    EXPECT_EQ(100, *req.sizeBegin);
+    EXPECT_EQ(i / 10, req.timestamp);
+    EXPECT_FALSE(req.requestId.has_value());
+  }
+  EXPECT_THROW(replayer.getReq(0, gen), EndOfTrace);
+
+  config.numThreads = 2;
+  EXPECT_THROW((BroadcastReplayGenerator{config, broadcaster, 0}),
+               std::invalid_argument);
+}
+} // namespace tests
+} // namespace cachebench
+} // namespace cachelib
+} // namespace facebook
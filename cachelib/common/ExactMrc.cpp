@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cachelib/common/ExactMrc.h"
+
+#include <folly/hash/SpookyHashV2.h>
+
+#include <cmath>
+
+namespace facebook {
+namespace cachelib {
+
+ExactMrc::ExactMrc(std::vector<uint32_t> allocsPerSlab, size_t windowSize)
+    : windowSize_(windowSize), window_(windowSize) {
+  classes_.reserve(allocsPerSlab.size());
+  for (auto allocs : allocsPerSlab) {
+    // classes that can not hold an object are never fed
+    classes_.push_back(std::make_unique<ClassState>(std::max(allocs, 1u)));
+  }
+}
+
+void ExactMrc::feed(folly::StringPiece key, ClassId cid) {
+  const auto hash =
+      folly::hash::SpookyHashV2::Hash64(key.data(), key.size(), 0);
+
+  std::lock_guard<std::mutex> l(mutex_);
+  auto& cls = getClassState(cid);
+  if (windowSize_ > 0 && poolTime_ >= windowSize_) {
+    slideWindow();
+  }
+
+  uint64_t distance = 0;
+  uint64_t prevPoolTime = kNoNext;
+  auto [it, inserted] =
+      cls.lastAccess.try_emplace(hash, LastAccess{cls.time, poolTime_});
+  if (!inserted) {
+    // keys accessed at or after the previous access, including this key
+    distance = cls.lastAccessTimes.greater_or_equal_to(it->second.classTime);
+    cls.lastAccessTimes.erase(it->second.classTime);
+    prevPoolTime = it->second.poolTime;
+    it->second = LastAccess{cls.time, poolTime_};
+  }
+  cls.lastAccessTimes.insert(cls.time);
+  cls.time++;
+
+  const auto bucket =
+      distance == 0
+          ? 0
+          : static_cast<uint32_t>((distance - 1) / cls.allocsPerSlab + 1);
+  add(cls.histogram, bucket);
+
+  if (windowSize_ > 0) {
+    // the distance only counts in the window if the previous access is
+    // still in it
+    uint32_t windowBucket = 0;
+    if (prevPoolTime != kNoNext && poolTime_ - prevPoolTime < windowSize_) {
+      windowBucket = bucket;
+      window_[prevPoolTime % windowSize_].next = poolTime_;
+    }
+    window_[poolTime_ % windowSize_] = WindowEntry{kNoNext, windowBucket, cid};
+    add(cls.windowHistogram, windowBucket);
+    cls.windowAccesses++;
+  }
+  poolTime_++;
+}
+
+void ExactMrc::slideWindow() {
+  auto& oldest = window_[(poolTime_ - windowSize_) % windowSize_];
+  auto& cls = getClassState(oldest.cid);
+  cls.windowHistogram[oldest.bucket]--;
+  cls.windowAccesses--;
+  if (oldest.next != kNoNext) {
+    // the next access to the key has lost its previous access
+    auto& next = window_[oldest.next % windowSize_];
+    cls.windowHistogram[next.bucket]--;
+    cls.windowHistogram[0]++;
+    next.bucket = 0;
+  }
+}
+
+void ExactMrc::add(std::vector<uint64_t>& histogram, uint32_t bucket) {
+  if (histogram.size() <= bucket) {
+    histogram.resize(bucket + 1, 0);
+  }
+  histogram[bucket]++;
+}
+
+std::vector<double> ExactMrc::toMrc(const std::vector<uint64_t>& histogram,
+                                    uint64_t accesses,
+                                    size_t maxSlabs) {
+  if (accesses == 0) {
+    return {};
+  }
+  std::vector<double> mrc(maxSlabs + 1);
+  mrc[0] = 1.0;
+  uint64_t hits = 0;
+  for (size_t s = 1; s <= maxSlabs; s++) {
+    if (s < histogram.size()) {
+      hits += histogram[s];
+    }
+    mrc[s] = 1.0 - static_cast<double>(hits) / accesses;
+  }
+  return mrc;
+}
+
+std::vector<double> ExactMrc::mrc(ClassId cid, size_t maxSlabs) const {
+  std::lock_guard<std::mutex> l(mutex_);
+  const auto& cls = getClassState(cid);
+  return toMrc(cls.histogram, cls.time, maxSlabs);
+}
+
+std::vector<double> ExactMrc::windowMrc(ClassId cid, size_t maxSlabs) const {
+  std::lock_guard<std::mutex> l(mutex_);
+  const auto& cls = getClassState(cid);
+  return toMrc(cls.windowHistogram, cls.windowAccesses, maxSlabs);
+}
+
+uint64_t ExactMrc::getAccesses(ClassId cid) const {
+  std::lock_guard<std::mutex> l(mutex_);
+  return getClassState(cid).time;
+}
+
+uint64_t ExactMrc::getWindowAccesses(ClassId cid) const {
+  std::lock_guard<std::mutex> l(mutex_);
+  return getClassState(cid).windowAccesses;
+}
+
+double ExactMrc::meanAbsoluteError(const std::vector<double>& exact,
+                                   const std::vector<double>& estimate) {
+  const size_t n = std::min(exact.size(), estimate.size());
+  if (n <= 1) {
+    return 0;
+  }
+  double sum = 0;
+  for (size_t s = 1; s < n; s++) {
+    sum += std::abs(exact[s] - estimate[s]);
+  }
+  return sum / (n - 1);
+}
+
+double ExactMrc::meanAbsoluteError(const std::vector<double>& exact,
+                                   const std::map<uint64_t, double>& estimate) {
+  if (exact.size() <= 1) {
+    return 0;
+  }
+  double sum = 0;
+  double current = 1.0;
+  auto it = estimate.begin();
+  for (size_t s = 1; s < exact.size(); s++) {
+    while (it != estimate.end() && it->first <= s) {
+      current = it->second;
+      ++it;
+    }
+    sum += std::abs(exact[s] - current);
+  }
+  return sum / (exact.size() - 1);
+}
+
+} // namespace cachelib
+} // namespace facebook
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <folly/Range.h>
+#include <folly/container/F14Map.h>
+#include <folly/logging/xlog.h>
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "cachelib/allocator/memory/Slab.h"
+#include "cachelib/common/SplayTree.h"
+
+namespace facebook {
+namespace cachelib {
+
+// ExactMrc computes the exact LRU miss ratio curve of every allocation class
+// of a pool, in slab units. It is the ground truth the sampled (Shards) and
+// windowed (FootprintMRC) estimators are validated against, and is meant for
+// analysis runs rather than production: it keeps one entry per distinct key.
+//
+// Every access is fed with its class. The stack distance of an access is the
+// number of distinct keys of the class accessed since the previous access to
+// the same key, computed in amortized O(log n) with an order statistic tree
+// over the last access time of every key. Distances are bucketed by the
+// number of objects per slab of the class, so bucket s counts the accesses
+// that hit with s slabs but miss with s - 1.
+//
+// Two curves are kept per class:
+//  - mrc() covers every access since the pool was created, like Shards.
+//  - windowMrc() covers the last windowSize accesses of the pool, like the
+//    circular buffer of FootprintMRC. An access whose previous access has
+//    left the window counts as a cold miss, just as it does for FootprintMRC.
+//
+// All methods are thread safe.
+class ExactMrc {
+ public:
+  // @param allocsPerSlab  objects per slab of each class, indexed by class id
+  // @param windowSize     accesses of the pool the windowed curve covers.
+  //                       0 disables the windowed curve.
+  ExactMrc(std::vector<uint32_t> allocsPerSlab, size_t windowSize);
+
+  ExactMrc(const ExactMrc&) = delete;
+  ExactMrc& operator=(const ExactMrc&) = delete;
+
+  // Record an access to key, which is stored in class cid.
+  void feed(folly::StringPiece key, ClassId cid);
+
+  // Miss ratios of the class with 0 to maxSlabs slabs, over all accesses.
+  // Empty if the class has not been accessed.
+  std::vector<double> mrc(ClassId cid, size_t maxSlabs) const;
+
+  // Miss ratios of the class with 0 to maxSlabs slabs, over the accesses in
+  // the window. Empty if the window is disabled or holds no access of the
+  // class.
+  std::vector<double> windowMrc(ClassId cid, size_t maxSlabs) const;
+
+  // number of accesses to the class, over all accesses and in the window
+  uint64_t getAccesses(ClassId cid) const;
+  uint64_t getWindowAccesses(ClassId cid) const;
+
+  size_t getWindowSize() const { return windowSize_; }
+
+  // Mean absolute error of estimate against exact over 1 to
+  // exact.size() - 1 slabs. Zero slabs are skipped since every estimator
+  // reports a miss ratio of 1 for them.
+  static double meanAbsoluteError(const std::vector<double>& exact,
+                                  const std::vector<double>& estimate);
+
+  // Same for a sparse curve of slab count to miss ratio, as returned by
+  // Shards::mrc(). The estimate is a step function: a slab count without an
+  // entry takes the miss ratio of the closest smaller slab count, or 1 if
+  // there is none.
+  static double meanAbsoluteError(const std::vector<double>& exact,
+                                  const std::map<uint64_t, double>& estimate);
+
+ private:
+  static constexpr uint64_t kNoNext = std::numeric_limits<uint64_t>::max();
+
+  // last access of a key
+  struct LastAccess {
+    // position in the access stream of the class
+    uint64_t classTime;
+    // position in the access stream of the pool
+    uint64_t poolTime;
+  };
+
+  struct ClassState {
+    explicit ClassState(uint32_t allocs) : allocsPerSlab(allocs) {}
+
+    const uint32_t allocsPerSlab;
+    uint64_t time{0};
+    folly::F14FastMap<uint64_t, LastAccess> lastAccess;
+    // class times of the last access of every key
+    SplayTree<uint64_t> lastAccessTimes;
+    // index 0 counts cold misses, index s the accesses first hitting with s
+    // slabs
+    std::vector<uint64_t> histogram;
+    std::vector<uint64_t> windowHistogram;
+    uint64_t windowAccesses{0};
+  };
+
+  // access in the window of the pool
+  struct WindowEntry {
+    // pool time of the next access to the same key while it is in the window
+    uint64_t next{kNoNext};
+    uint32_t bucket{0};
+    ClassId cid{Slab::kInvalidClassId};
+  };
+
+  static void add(std::vector<uint64_t>& histogram, uint32_t bucket);
+  static std::vector<double> toMrc(const std::vector<uint64_t>& histogram,
+                                   uint64_t accesses,
+                                   size_t maxSlabs);
+
+  // drop the oldest access from the window
+  void slideWindow();
+
+  ClassState& getClassState(ClassId cid) const {
+    XDCHECK_LT(static_cast<size_t>(cid), classes_.size());
+    return *classes_[static_cast<size_t>(cid)];
+  }
+
+  std::vector<std::unique_ptr<ClassState>> classes_;
+
+  const size_t windowSize_;
+  std::vector<WindowEntry> window_;
+  uint64_t poolTime_{0};
+
+  mutable std::mutex mutex_;
+};
+
+} // namespace cachelib
+} // namespace facebook
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cachelib/common/HdrHistogram.h"
+
+#include <folly/Format.h>
+#include <folly/lang/Bits.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace facebook {
+namespace cachelib {
+namespace util {
+
+HdrHistogram::HdrHistogram(uint64_t maxValue, uint32_t significantDigits)
+    : highestTrackable_(maxValue), significantDigits_(significantDigits) {
+  if (significantDigits < 1 || significantDigits > 5) {
+    throw std::invalid_argument(folly::sformat(
+        "significant digits must be within 1 and 5, got {}",
+        significantDigits));
+  }
+  if (maxValue < 2) {
+    throw std::invalid_argument(
+        folly::sformat("max trackable value must be at least 2: {}", maxValue));
+  }
+
+  // smallest power of two that resolves 10^digits within one sub bucket
+  const uint64_t largestSingleUnitResolution =
+      2 * static_cast<uint64_t>(std::pow(10, significantDigits));
+  const uint32_t subBucketCountMagnitude =
+      folly::findLastSet(largestSingleUnitResolution - 1);
+  subBucketHalfCountMagnitude_ = subBucketCountMagnitude - 1;
+  const uint64_t subBucketCount = uint64_t{1} << subBucketCountMagnitude;
+  subBucketHalfCount_ = subBucketCount / 2;
+  subBucketMask_ = subBucketCount - 1;
+
+  // buckets needed to cover maxValue
+  uint64_t smallestUntrackable = subBucketCount;
+  size_t bucketCount = 1;
+  while (smallestUntrackable <= maxValue) {
+    if (smallestUntrackable > std::numeric_limits<uint64_t>::max() / 2) {
+      bucketCount++;
+      break;
+    }
+    smallestUntrackable <<= 1;
+    bucketCount++;
+  }
+  countsLen_ = (bucketCount + 1) * subBucketHalfCount_;
+  counts_ = std::make_unique<std::atomic<uint64_t>[]>(countsLen_);
+  for (size_t i = 0; i < countsLen_; i++) {
+    counts_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+size_t HdrHistogram::countsIndex(uint64_t value) const noexcept {
+  const uint32_t pow2Ceiling = folly::findLastSet(value | subBucketMask_);
+  const uint32_t bucketIndex = pow2Ceiling - (subBucketHalfCountMagnitude_ + 1);
+  const uint64_t subBucketIndex = value >> bucketIndex;
+  const size_t bucketBaseIndex = static_cast<size_t>(bucketIndex + 1)
+                                 << subBucketHalfCountMagnitude_;
+  return bucketBaseIndex + subBucketIndex - subBucketHalfCount_;
+}
+
+uint64_t HdrHistogram::valueFromIndex(size_t index) const noexcept {
+  int64_t bucketIndex =
+      static_cast<int64_t>(index >> subBucketHalfCountMagnitude_) - 1;
+  uint64_t subBucketIndex =
+      (index & (subBucketHalfCount_ - 1)) + subBucketHalfCount_;
+  if (bucketIndex < 0) {
+    subBucketIndex -= subBucketHalfCount_;
+    bucketIndex = 0;
+  }
+  return subBucketIndex << bucketIndex;
+}
+
+uint64_t HdrHistogram::highestEquivalentValue(uint64_t value) const noexcept {
+  const uint32_t pow2Ceiling = folly::findLastSet(value | subBucketMask_);
+  const uint32_t bucketIndex = pow2Ceiling - (subBucketHalfCountMagnitude_ + 1);
+  const uint64_t lowest = (value >> bucketIndex) << bucketIndex;
+  return lowest + (uint64_t{1} << bucketIndex) - 1;
+}
+
+void HdrHistogram::updateMinMax(uint64_t min, uint64_t max) noexcept {
+  auto curMin = minValue_.load(std::memory_order_relaxed);
+  while (min < curMin && !minValue_.compare_exchange_weak(
+                             curMin, min, std::memory_order_relaxed)) {
+  }
+  auto curMax = maxValue_.load(std::memory_order_relaxed);
+  while (max > curMax && !maxValue_.compare_exchange_weak(
+                             curMax, max, std::memory_order_relaxed)) {
+  }
+}
+
+void HdrHistogram::record(uint64_t value) noexcept {
+  value = std::min(value, highestTrackable_);
+  counts_[countsIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  totalCount_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+  updateMinMax(value, value);
+}
+
+void HdrHistogram::drainInto(HdrHistogram& out) noexcept {
+  // min and max can not be split between the two sides of a concurrent
+  // record, so take them first; the drained counts never exceed them by more
+  // than the records racing with this call
+  const auto min = minValue_.exchange(std::numeric_limits<uint64_t>::max(),
+                                      std::memory_order_relaxed);
+  const auto max = maxValue_.exchange(0, std::memory_order_relaxed);
+  uint64_t total = 0;
+  for (size_t i = 0; i < countsLen_; i++) {
+    if (counts_[i].load(std::memory_order_relaxed) == 0) {
+      continue;
+    }
+    const auto n = counts_[i].exchange(0, std::memory_order_relaxed);
+    out.counts_[i].fetch_add(n, std::memory_order_relaxed);
+    total += n;
+  }
+  totalCount_.fetch_sub(total, std::memory_order_relaxed);
+  out.totalCount_.fetch_add(total, std::memory_order_relaxed);
+  out.sum_.fetch_add(sum_.exchange(0, std::memory_order_relaxed),
+                     std::memory_order_relaxed);
+  if (total > 0) {
+    out.updateMinMax(min, max);
+  }
+}
+
+void HdrHistogram::merge(const HdrHistogram& other) noexcept {
+  uint64_t total = 0;
+  for (size_t i = 0; i < countsLen_; i++) {
+    const auto n = other.counts_[i].load(std::memory_order_relaxed);
+    if (n > 0) {
+      counts_[i].fetch_add(n, std::memory_order_relaxed);
+      total += n;
+    }
+  }
+  totalCount_.fetch_add(total, std::memory_order_relaxed);
+  sum_.fetch_add(other.sum_.load(std::memory_order_relaxed),
+                 std::memory_order_relaxed);
+  if (total > 0) {
+    updateMinMax(other.minValue_.load(std::memory_order_relaxed),
+                 other.maxValue_.load(std::memory_order_relaxed));
+  }
+}
+
+void HdrHistogram::reset() noexcept {
+  for (size_t i = 0; i < countsLen_; i++) {
+    counts_[i].store(0, std::memory_order_relaxed);
+  }
+  totalCount_.store(0, std::memory_order_relaxed);
+  sum_.store(0, std::memory_order_relaxed);
+  minValue_.store(std::numeric_limits<uint64_t>::max(),
+                  std::memory_order_relaxed);
+  maxValue_.store(0, std::memory_order_relaxed);
+}
+
+uint64_t HdrHistogram::min() const noexcept {
+  return count() == 0 ? 0 : minValue_.load(std::memory_order_relaxed);
+}
+
+double HdrHistogram::mean() const noexcept {
+  const auto n = count();
+  return n == 0 ? 0.0
+                : static_cast<double>(sum_.load(std::memory_order_relaxed)) /
+                      static_cast<double>(n);
+}
+
+uint64_t HdrHistogram::valueAtPercentile(double percentile) const noexcept {
+  const auto total = count();
+  if (total == 0) {
+    return 0;
+  }
+  percentile = std::clamp(percentile, 0.0, 100.0);
+  const auto target = std::max<uint64_t>(
+      1, static_cast<uint64_t>(
+             std::ceil(percentile / 100.0 * static_cast<double>(total))));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < countsLen_; i++) {
+    seen += counts_[i].load(std::memory_order_relaxed);
+    if (seen >= target) {
+      return std::min(highestEquivalentValue(valueFromIndex(i)), max());
+    }
+  }
+  return max();
+}
+
+} // namespace util
+} // namespace cachelib
+} // namespace facebook
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+namespace facebook {
+namespace cachelib {
+namespace util {
+
+// High dynamic range histogram of non-negative integer values, following the
+// layout of HdrHistogram: values are bucketed by powers of two, and every
+// bucket is split linearly so that any recorded value is reported within the
+// configured number of significant decimal digits.
+//
+// Recording is lock free and wait free: a relaxed increment of one counter
+// plus min/max/sum updates, so one histogram can be shared by all threads.
+// Reading while recording is allowed and sees a consistent-enough view for
+// reporting; drainInto() moves the counts out for interval reporting without
+// losing concurrent records.
+class HdrHistogram {
+ public:
+  // @param maxValue           largest value tracked precisely. Larger values
+  //                           are recorded as maxValue.
+  // @param significantDigits  decimal digits of precision, 1 to 5
+  //
+  // @throw std::invalid_argument on out of range parameters
+  HdrHistogram(uint64_t maxValue, uint32_t significantDigits);
+
+  HdrHistogram(const HdrHistogram&) = delete;
+  HdrHistogram& operator=(const HdrHistogram&) = delete;
+
+  void record(uint64_t value) noexcept;
+
+  // Add every count of this histogram to out, which must have the same
+  // configuration, and reset them here.
+  void drainInto(HdrHistogram& out) noexcept;
+
+  // Add every count of other, which must have the same configuration.
+  void merge(const HdrHistogram& other) noexcept;
+
+  void reset() noexcept;
+
+  uint64_t count() const noexcept {
+    return totalCount_.load(std::memory_order_relaxed);
+  }
+
+  // 0 if empty
+  uint64_t min() const noexcept;
+  uint64_t max() const noexcept {
+    return maxValue_.load(std::memory_order_relaxed);
+  }
+  double mean() const noexcept;
+
+  // The value at or below which percentile percent of the recorded values
+  // fall, reported as the highest value equivalent to its bucket. 0 if empty.
+  //
+  // @param percentile  0 to 100
+  uint64_t valueAtPercentile(double percentile) const noexcept;
+
+  uint64_t getMaxTrackableValue() const noexcept { return highestTrackable_; }
+  uint32_t getSignificantDigits() const noexcept { return significantDigits_; }
+
+ private:
+  size_t countsIndex(uint64_t value) const noexcept;
+  // lowest value of the bucket at index
+  uint64_t valueFromIndex(size_t index) const noexcept;
+  // highest value equivalent to value
+  uint64_t highestEquivalentValue(uint64_t value) const noexcept;
+
+  void updateMinMax(uint64_t min, uint64_t max) noexcept;
+
+  const uint64_t highestTrackable_;
+  const uint32_t significantDigits_;
+  uint32_t subBucketHalfCountMagnitude_{0};
+  uint64_t subBucketHalfCount_{0};
+  uint64_t subBucketMask_{0};
+  size_t countsLen_{0};
+
+  std::unique_ptr<std::atomic<uint64_t>[]> counts_;
+  std::atomic<uint64_t> totalCount_{0};
+  std::atomic<uint64_t> sum_{0};
+  std::atomic<uint64_t> minValue_{std::numeric_limits<uint64_t>::max()};
+  std::atomic<uint64_t> maxValue_{0};
+};
+
+} // namespace util
+} // namespace cachelib
+} // namespace facebook
@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cachelib/common/PerfCounters.h"
+
+#include <folly/logging/xlog.h>
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+namespace facebook {
+namespace cachelib {
+
+std::atomic<uint32_t> PerfCounters::sampleEvery_{0};
+
+namespace {
+struct AtomicRegionCounts {
+  std::atomic<uint64_t> samples{0};
+  std::atomic<uint64_t> cycles{0};
+  std::atomic<uint64_t> instructions{0};
+  std::atomic<uint64_t> llcMisses{0};
+  std::atomic<uint64_t> dtlbMisses{0};
+};
+
+std::array<AtomicRegionCounts, PerfCounters::kNumRegions> gCounts;
+
+constexpr uint64_t hwCacheMiss(uint64_t cache) {
+  return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+// The calling thread's counter group, opened on first use and closed when
+// the thread exits.
+class ThreadGroup {
+ public:
+  static constexpr size_t kNumEvents = 4;
+
+  ThreadGroup() {
+    const std::array<std::pair<uint32_t, uint64_t>, kNumEvents> events{{
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HW_CACHE, hwCacheMiss(PERF_COUNT_HW_CACHE_LL)},
+        {PERF_TYPE_HW_CACHE, hwCacheMiss(PERF_COUNT_HW_CACHE_DTLB)},
+    }};
+
+    for (size_t i = 0; i < kNumEvents; i++) {
+      struct perf_event_attr pe;
+      memset(&pe, 0, sizeof(pe));
+      pe.type = events[i].first;
+      pe.size = sizeof(pe);
+      pe.config = events[i].second;
+      pe.disabled = leader_ == -1 ? 1 : 0;
+      // user space only, so the reads of the group do not count themselves
+      // and it works with perf_event_paranoid 2
+      pe.exclude_kernel = 1;
+      pe.exclude_hv = 1;
+      pe.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+      const int fd = static_cast<int>(
+          syscall(__NR_perf_event_open, &pe, 0, -1, leader_, 0));
+      if (fd == -1) {
+        if (leader_ == -1) {
+          XLOG_FIRST_N(WARN, 1)
+              << "perf_event_open failed, no hardware counters: "
+              << strerror(errno);
+          return;
+        }
+        // this event is missing on the PMU and reads as zero
+        continue;
+      }
+      if (leader_ == -1) {
+        leader_ = fd;
+      }
+      fds_[numOpen_] = fd;
+      eventOf_[numOpen_] = i;
+      numOpen_++;
+    }
+
+    ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+
+  ~ThreadGroup() {
+    for (size_t i = 0; i < numOpen_; i++) {
+      close(fds_[i]);
+    }
+  }
+
+  bool ok() const noexcept { return leader_ != -1; }
+
+  // Reads the event counts followed by the time enabled and running.
+  bool read(std::array<uint64_t, kNumEvents + 2>& values) const noexcept {
+    if (leader_ == -1) {
+      return false;
+    }
+    // number of events, time enabled, time running and then the counts in
+    // the order the events were added to the group
+    std::array<uint64_t, kNumEvents + 3> buf;
+    const auto bytes = (numOpen_ + 3) * sizeof(uint64_t);
+    if (::read(leader_, buf.data(), bytes) != static_cast<ssize_t>(bytes)) {
+      return false;
+    }
+    values.fill(0);
+    for (size_t i = 0; i < numOpen_; i++) {
+      values[eventOf_[i]] = buf[i + 3];
+    }
+    values[kNumEvents] = buf[1];
+    values[kNumEvents + 1] = buf[2];
+    return true;
+  }
+
+ private:
+  int leader_{-1};
+  size_t numOpen_{0};
+  std::array<int, kNumEvents> fds_{};
+  std::array<size_t, kNumEvents> eventOf_{};
+};
+
+ThreadGroup& threadGroup() {
+  thread_local ThreadGroup group;
+  return group;
+}
+
+// entries of each region on the calling thread
+thread_local std::array<uint32_t, PerfCounters::kNumRegions> tlEntries{};
+} // namespace
+
+bool PerfCounters::available() { return threadGroup().ok(); }
+
+const char* PerfCounters::regionName(PerfRegion region) {
+  switch (region) {
+  case PerfRegion::kFind:
+    return "find";
+  case PerfRegion::kAllocate:
+    return "allocate";
+  case PerfRegion::kFindEviction:
+    return "findEviction";
+  case PerfRegion::kRecordAccess:
+    return "recordAccess";
+  case PerfRegion::kMrcFeed:
+    return "mrcFeed";
+  case PerfRegion::kRebalancerPick:
+    return "rebalancerPick";
+  case PerfRegion::kRebalancerRelease:
+    return "rebalancerRelease";
+  default:
+    return "unknown";
+  }
+}
+
+bool PerfCounters::read(Values& values) noexcept {
+  static_assert(kNumEvents == ThreadGroup::kNumEvents);
+  static_assert(kNumValues == ThreadGroup::kNumEvents + 2);
+  return threadGroup().read(values);
+}
+
+void PerfCounters::add(PerfRegion region,
+                       const Values& begin,
+                       const Values& end) noexcept {
+  // an event that fails to count in between reads the same at both ends
+  auto delta = [&](size_t v) {
+    return end[v] > begin[v] ? end[v] - begin[v] : 0;
+  };
+  const auto running = delta(kTimeRunning);
+  if (running == 0) {
+    // the group was multiplexed out for the whole sample
+    return;
+  }
+  const double scale = static_cast<double>(delta(kTimeEnabled)) /
+                       static_cast<double>(running);
+  auto scaled = [&](Event e) {
+    return static_cast<uint64_t>(static_cast<double>(delta(e)) * scale);
+  };
+  auto& counts = gCounts[static_cast<size_t>(region)];
+  counts.samples.fetch_add(1, std::memory_order_relaxed);
+  counts.cycles.fetch_add(scaled(kCycles), std::memory_order_relaxed);
+  counts.instructions.fetch_add(scaled(kInstructions),
+                                std::memory_order_relaxed);
+  counts.llcMisses.fetch_add(scaled(kLlcMisses), std::memory_order_relaxed);
+  counts.dtlbMisses.fetch_add(scaled(kDtlbMisses), std::memory_order_relaxed);
+}
+
+PerfCounters::RegionCounts PerfCounters::getCounts() {
+  RegionCounts ret;
+  for (size_t i = 0; i < kNumRegions; i++) {
+    ret[i].samples = gCounts[i].samples.load(std::memory_order_relaxed);
+    ret[i].cycles = gCounts[i].cycles.load(std::memory_order_relaxed);
+    ret[i].instructions =
+        gCounts[i].instructions.load(std::memory_order_relaxed);
+    ret[i].llcMisses = gCounts[i].llcMisses.load(std::memory_order_relaxed);
+    ret[i].dtlbMisses = gCounts[i].dtlbMisses.load(std::memory_order_relaxed);
+  }
+  return ret;
+}
+
+void PerfCounters::reset() {
+  for (auto& counts : gCounts) {
+    counts.samples.store(0, std::memory_order_relaxed);
+    counts.cycles.store(0, std::memory_order_relaxed);
+    counts.instructions.store(0, std::memory_order_relaxed);
+    counts.llcMisses.store(0, std::memory_order_relaxed);
+    counts.dtlbMisses.store(0, std::memory_order_relaxed);
+  }
+}
+
+void PerfRegionScope::begin(PerfRegion region, uint32_t every) noexcept {
+  if (!PerfCounters::isSampledAlways(region) &&
+      ++tlEntries[static_cast<size_t>(region)] % every != 0) {
+    return;
+  }
+  region_ = region;
+  sampled_ = PerfCounters::read(begin_);
+}
+
+void PerfRegionScope::end() noexcept {
+  PerfCounters::Values end;
+  if (PerfCounters::read(end)) {
+    PerfCounters::add(region_, begin_, end);
+  }
+}
+
+} // namespace cachelib
+} // namespace facebook
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <folly/Likely.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace facebook {
+namespace cachelib {
+
+// Code regions the hardware counters are attributed to. Regions nest (find
+// includes recordAccess and the MRC feed of a hit) and every region counts
+// everything below it.
+enum class PerfRegion : uint8_t {
+  kFind = 0,
+  kAllocate,
+  kFindEviction,
+  kRecordAccess,
+  kMrcFeed,
+  kRebalancerPick,
+  kRebalancerRelease,
+  kNumRegions
+};
+
+// Sums of the hardware counters over the sampled entries of a region.
+struct PerfRegionCounts {
+  uint64_t samples{0};
+  uint64_t cycles{0};
+  uint64_t instructions{0};
+  uint64_t llcMisses{0};
+  uint64_t dtlbMisses{0};
+};
+
+// Process wide, opt-in hardware counter sampling of cache code regions.
+//
+// Every thread that enters a region while sampling is on opens its own
+// perf_event_open group of user space cycles, instructions, last level cache
+// misses and dTLB read misses, and reads it with a single read() on entry and
+// exit of every sampleEvery-th entry of each region. The rebalancer regions
+// run a few times a second at most, so every one of their entries is sampled.
+// Events the PMU does not have read as zero; threads that cannot open the
+// group at all (no PMU, perf_event_paranoid) sample nothing. When the kernel
+// multiplexes the group, the counts of a sample are scaled up by the share of
+// the time the group was enabled but not on the PMU; samples during which it
+// never ran are dropped.
+//
+// ThreadCpuCycleCounter counts all the cycles of a thread; together they
+// tell what share of it goes to each region.
+class PerfCounters {
+ public:
+  static constexpr size_t kNumRegions =
+      static_cast<size_t>(PerfRegion::kNumRegions);
+  using RegionCounts = std::array<PerfRegionCounts, kNumRegions>;
+
+  // Sample every sampleEvery-th entry of each region on each thread. 0 turns
+  // sampling off.
+  static void setSampleEvery(uint32_t sampleEvery) noexcept {
+    sampleEvery_.store(sampleEvery, std::memory_order_relaxed);
+  }
+
+  static uint32_t getSampleEvery() noexcept {
+    return sampleEvery_.load(std::memory_order_relaxed);
+  }
+
+  // whether the calling thread can open the counter group
+  static bool available();
+
+  // true for regions whose every entry is sampled
+  static bool isSampledAlways(PerfRegion region) noexcept {
+    return region >= PerfRegion::kRebalancerPick;
+  }
+
+  static const char* regionName(PerfRegion region);
+
+  static RegionCounts getCounts();
+
+  static void reset();
+
+ private:
+  friend class PerfRegionScope;
+
+  enum Event {
+    kCycles = 0,
+    kInstructions,
+    kLlcMisses,
+    kDtlbMisses,
+    kNumEvents
+  };
+  // The event counts are followed by the time the group was enabled and the
+  // time it was actually on the PMU. They differ when the kernel multiplexes
+  // more events than the PMU has counters.
+  enum Time { kTimeEnabled = kNumEvents, kTimeRunning, kNumValues };
+  using Values = std::array<uint64_t, kNumValues>;
+
+  // counts of the calling thread's group; false if it can not be read
+  static bool read(Values& values) noexcept;
+
+  static void add(PerfRegion region,
+                  const Values& begin,
+                  const Values& end) noexcept;
+
+  static std::atomic<uint32_t> sampleEvery_;
+};
+
+// Attributes the hardware counters from construction to destruction to a
+// region when the entry is sampled. When sampling is off it costs a relaxed
+// load.
+class PerfRegionScope {
+ public:
+  explicit PerfRegionScope(PerfRegion region) noexcept {
+    const auto every = PerfCounters::getSampleEvery();
+    if (FOLLY_UNLIKELY(every != 0)) {
+      begin(region, every);
+    }
+  }
+
+  ~PerfRegionScope() {
+    if (FOLLY_UNLIKELY(sampled_)) {
+      end();
+    }
+  }
+
+  PerfRegionScope(const PerfRegionScope&) = delete;
+  PerfRegionScope& operator=(const PerfRegionScope&) = delete;
+
+ private:
+  void begin(PerfRegion region, uint32_t every) noexcept;
+  void end() noexcept;
+
+  PerfRegion region_{PerfRegion::kNumRegions};
+  bool sampled_{false};
+  PerfCounters::Values begin_;
+};
+
+} // namespace cachelib
+} // namespace facebook
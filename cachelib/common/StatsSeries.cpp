@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cachelib/common/StatsSeries.h"
+
+#include <folly/Exception.h>
+#include <folly/FileUtil.h>
+#include <folly/Format.h>
+#include <folly/String.h>
+#include <folly/lang/Bits.h>
+#include <folly/logging/xlog.h>
+#include <folly/system/ThreadName.h>
+
+#include <cstring>
+#include <stdexcept>
+
+namespace facebook {
+namespace cachelib {
+namespace {
+constexpr char kMagic[8] = {'C', 'L', 'S', 'T', 'A', 'T', 'S', '1'};
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t numValues;
+};
+static_assert(sizeof(FileHeader) == 16, "unexpected padding");
+
+// bytes of the columns of one record
+constexpr size_t kRecordBytes = sizeof(uint64_t) + 4 * sizeof(uint8_t) +
+                                StatsSeriesRecord::kNumValues * sizeof(double);
+
+static_assert(folly::kIsLittleEndian,
+              "stats series are written in host byte order");
+
+template <typename T>
+uint8_t* putColumn(uint8_t* out,
+                   const std::vector<StatsSeriesRecord>& records,
+                   size_t n,
+                   T (*get)(const StatsSeriesRecord&)) {
+  for (size_t i = 0; i < n; i++) {
+    const T v = get(records[i]);
+    std::memcpy(out, &v, sizeof(T));
+    out += sizeof(T);
+  }
+  return out;
+}
+
+template <typename T>
+const uint8_t* getColumn(const uint8_t* in,
+                         std::vector<StatsSeriesRecord>& records,
+                         void (*set)(StatsSeriesRecord&, T)) {
+  for (auto& record : records) {
+    T v;
+    std::memcpy(&v, in, sizeof(T));
+    set(record, v);
+    in += sizeof(T);
+  }
+  return in;
+}
+} // namespace
+
+StatsSeriesWriter::StatsSeriesWriter(const std::string& path,
+                                     size_t bufferRecords,
+                                     std::chrono::milliseconds flushInterval)
+    : file_(path.c_str(), O_CREAT | O_WRONLY | O_TRUNC),
+      bufferRecords_(bufferRecords),
+      flushInterval_(flushInterval),
+      active_(bufferRecords),
+      spare_(bufferRecords),
+      columns_(sizeof(uint64_t) + bufferRecords * kRecordBytes) {
+  if (bufferRecords_ == 0) {
+    throw std::invalid_argument("stats series buffer can not be empty");
+  }
+  FileHeader header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.numValues = StatsSeriesRecord::kNumValues;
+  folly::checkUnixError(folly::writeFull(file_.fd(), &header, sizeof(header)),
+                        "Failed to write stats series header");
+
+  writer_ = std::thread([this] {
+    folly::setThreadName("stats_series");
+    writerLoop();
+  });
+}
+
+StatsSeriesWriter::~StatsSeriesWriter() {
+  {
+    std::lock_guard<std::mutex> l(mutex_);
+    stop_ = true;
+  }
+  writerCv_.notify_one();
+  writer_.join();
+}
+
+void StatsSeriesWriter::append(const StatsSeriesRecord& record) {
+  std::unique_lock<std::mutex> l(mutex_);
+  // both buffers are full; wait for the writer to take this one
+  appenderCv_.wait(l, [this] { return activeSize_ < bufferRecords_; });
+  active_[activeSize_++] = record;
+  appended_++;
+  if (activeSize_ == bufferRecords_) {
+    writerCv_.notify_one();
+  }
+}
+
+void StatsSeriesWriter::flush() {
+  std::unique_lock<std::mutex> l(mutex_);
+  const auto target = appended_;
+  flushWaiters_++;
+  writerCv_.notify_one();
+  appenderCv_.wait(l, [this, target] { return written_ >= target; });
+  flushWaiters_--;
+}
+
+uint64_t StatsSeriesWriter::getRecords() const {
+  std::lock_guard<std::mutex> l(mutex_);
+  return appended_;
+}
+
+uint64_t StatsSeriesWriter::getBlocks() const {
+  std::lock_guard<std::mutex> l(mutex_);
+  return blocks_;
+}
+
+void StatsSeriesWriter::writerLoop() {
+  std::unique_lock<std::mutex> l(mutex_);
+  while (true) {
+    writerCv_.wait_for(l, flushInterval_, [this] {
+      return stop_ || activeSize_ == bufferRecords_ ||
+             (flushWaiters_ > 0 && activeSize_ > 0);
+    });
+    const bool stop = stop_;
+    if (activeSize_ > 0) {
+      std::swap(active_, spare_);
+      const size_t n = activeSize_;
+      activeSize_ = 0;
+      appenderCv_.notify_all();
+
+      l.unlock();
+      writeBlock(spare_, n);
+      l.lock();
+
+      written_ += n;
+      blocks_++;
+      appenderCv_.notify_all();
+    }
+    if (stop) {
+      return;
+    }
+  }
+}
+
+void StatsSeriesWriter::writeBlock(
+    const std::vector<StatsSeriesRecord>& records, size_t n) {
+  uint8_t* out = columns_.data();
+  const uint64_t numRecords = n;
+  std::memcpy(out, &numRecords, sizeof(numRecords));
+  out += sizeof(numRecords);
+
+  out = putColumn<uint64_t>(
+      out, records, n, [](const StatsSeriesRecord& r) { return r.requestId; });
+  out = putColumn<uint8_t>(
+      out, records, n, [](const StatsSeriesRecord& r) { return r.kind; });
+  out = putColumn<PoolId>(
+      out, records, n, [](const StatsSeriesRecord& r) { return r.poolId; });
+  out = putColumn<ClassId>(
+      out, records, n, [](const StatsSeriesRecord& r) { return r.classId; });
+  out = putColumn<ClassId>(out, records, n, [](const StatsSeriesRecord& r) {
+    return r.otherClassId;
+  });
+  for (size_t j = 0; j < StatsSeriesRecord::kNumValues; j++) {
+    for (size_t i = 0; i < n; i++) {
+      std::memcpy(out, &records[i].values[j], sizeof(double));
+      out += sizeof(double);
+    }
+  }
+
+  const size_t bytes = out - columns_.data();
+  if (folly::writeFull(file_.fd(), columns_.data(), bytes) !=
+      static_cast<ssize_t>(bytes)) {
+    // the series is diagnostics only; losing it must not take the run down
+    XLOGF(ERR, "Failed to write {} stats series records: {}", n,
+          folly::errnoStr(errno));
+  }
+}
+
+StatsSeriesReader::StatsSeriesReader(const std::string& path)
+    : file_(path.c_str(), O_RDONLY) {
+  FileHeader header{};
+  if (folly::readFull(file_.fd(), &header, sizeof(header)) !=
+          static_cast<ssize_t>(sizeof(header)) ||
+      std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+    throw std::invalid_argument(
+        folly::sformat("{} is not a stats series file", path));
+  }
+  if (header.version != StatsSeriesWriter::kVersion ||
+      header.numValues != StatsSeriesRecord::kNumValues) {
+    throw std::invalid_argument(folly::sformat(
+        "{}: unsupported stats series version {} with {} values", path,
+        header.version, header.numValues));
+  }
+}
+
+bool StatsSeriesReader::nextBlock(std::vector<StatsSeriesRecord>& records) {
+  uint64_t n = 0;
+  const auto res = folly::readFull(file_.fd(), &n, sizeof(n));
+  if (res == 0) {
+    return false;
+  }
+  if (res != static_cast<ssize_t>(sizeof(n))) {
+    throw std::runtime_error("Truncated stats series block header");
+  }
+
+  columns_.resize(n * kRecordBytes);
+  const auto bytes = static_cast<ssize_t>(columns_.size());
+  if (folly::readFull(file_.fd(), columns_.data(), columns_.size()) != bytes) {
+    throw std::runtime_error(
+        folly::sformat("Truncated stats series block of {} records", n));
+  }
+
+  records.assign(n, StatsSeriesRecord{});
+  const uint8_t* in = columns_.data();
+  in = getColumn<uint64_t>(
+      in, records, [](StatsSeriesRecord& r, uint64_t v) { r.requestId = v; });
+  in = getColumn<uint8_t>(
+      in, records, [](StatsSeriesRecord& r, uint8_t v) { r.kind = v; });
+  in = getColumn<PoolId>(
+      in, records, [](StatsSeriesRecord& r, PoolId v) { r.poolId = v; });
+  in = getColumn<ClassId>(
+      in, records, [](StatsSeriesRecord& r, ClassId v) { r.classId = v; });
+  in = getColumn<ClassId>(
+      in, records, [](StatsSeriesRecord& r, ClassId v) { r.otherClassId = v; });
+  for (size_t j = 0; j < StatsSeriesRecord::kNumValues; j++) {
+    for (auto& record : records) {
+      std::memcpy(&record.values[j], in, sizeof(double));
+      in += sizeof(double);
+    }
+  }
+  return true;
+}
+
+std::vector<StatsSeriesRecord> StatsSeriesReader::readAll(
+    const std::string& path) {
+  StatsSeriesReader reader{path};
+  std::vector<StatsSeriesRecord> all;
+  std::vector<StatsSeriesRecord> block;
+  while (reader.nextBlock(block)) {
+    all.insert(all.end(), block.begin(), block.end());
+  }
+  return all;
+}
+
+} // namespace cachelib
+} // namespace facebook
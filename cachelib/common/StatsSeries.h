@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <folly/File.h>
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cachelib/allocator/memory/Slab.h"
+
+namespace facebook {
+namespace cachelib {
+
+// One sample of a stats time series. The layout is fixed so that samples can
+// be recorded on the request path without allocating, and written out column
+// by column.
+struct StatsSeriesRecord {
+  enum Kind : uint8_t {
+    // cache wide, since the previous sample:
+    // values: miss ratio, misses, gets
+    kMissRatio = 0,
+    // per class, cumulative:
+    // values: hits, evictions, tail hits, slabs, eviction age (s), items
+    kClassStats = 1,
+    // per class, as reported by the rebalancer for the last interval:
+    // values: tail age, marginal hits, hits, evictions, hits per slab,
+    // miss estimation, slabs, free memory
+    kDeltaStats = 2,
+    // a slab moved from classId to otherClassId (kInvalidClassId if it was
+    // released to the pool):
+    // values: victim slabs, receiver slabs, victim eviction age (s),
+    // receiver eviction age (s), release time (ms)
+    kSlabMove = 3,
+    // a rebalance round picked classId as victim and otherClassId as
+    // receiver. No values.
+    kRebalance = 4,
+  };
+
+  static constexpr size_t kNumValues = 8;
+
+  uint64_t requestId{0};
+  uint8_t kind{kMissRatio};
+  PoolId poolId{0};
+  ClassId classId{Slab::kInvalidClassId};
+  ClassId otherClassId{Slab::kInvalidClassId};
+  // unused values are 0
+  std::array<double, kNumValues> values{};
+};
+
+// Writes stats samples to a binary columnar file.
+//
+// Samples are appended to a preallocated buffer under a short critical
+// section; a background thread swaps it with a second buffer once it is
+// full or every flushInterval and writes the batch out. Appending only blocks
+// when both buffers are full, i.e. when the disk can not keep up.
+//
+// File layout, little endian:
+//   header:  "CLSTATS1", uint32 version, uint32 kNumValues
+//   blocks:  uint64 n, followed by the columns of n records:
+//            requestId u64[n], kind u8[n], poolId i8[n], classId i8[n],
+//            otherClassId i8[n], values[0] f64[n], ..., values[7] f64[n]
+//
+// StatsSeriesReader reads it back, and slab-rebalance-bench/exp/
+// stats_series.py loads it into a pandas DataFrame.
+class StatsSeriesWriter {
+ public:
+  static constexpr uint32_t kVersion = 1;
+
+  // @param path           file to write, truncated if it exists
+  // @param bufferRecords  records per buffer
+  // @param flushInterval  how often a partially filled buffer is written
+  //
+  // @throw std::system_error if the file can not be opened
+  explicit StatsSeriesWriter(
+      const std::string& path,
+      size_t bufferRecords = 64 * 1024,
+      std::chrono::milliseconds flushInterval = std::chrono::seconds{1});
+
+  // writes out everything appended so far
+  ~StatsSeriesWriter();
+
+  StatsSeriesWriter(const StatsSeriesWriter&) = delete;
+  StatsSeriesWriter& operator=(const StatsSeriesWriter&) = delete;
+
+  void append(const StatsSeriesRecord& record);
+
+  // Block until every record appended before the call is written.
+  void flush();
+
+  uint64_t getRecords() const;
+  uint64_t getBlocks() const;
+
+ private:
+  void writerLoop();
+  void writeBlock(const std::vector<StatsSeriesRecord>& records, size_t n);
+
+  folly::File file_;
+  const size_t bufferRecords_;
+  const std::chrono::milliseconds flushInterval_;
+
+  mutable std::mutex mutex_;
+  // signalled when there is something to write, or on stop
+  std::condition_variable writerCv_;
+  // signalled when a batch has been taken and when it has been written
+  std::condition_variable appenderCv_;
+
+  // records are appended here
+  std::vector<StatsSeriesRecord> active_;
+  size_t activeSize_{0};
+  // owned by the writer thread while it writes
+  std::vector<StatsSeriesRecord> spare_;
+
+  uint64_t appended_{0};
+  uint64_t written_{0};
+  uint64_t blocks_{0};
+  uint32_t flushWaiters_{0};
+  bool stop_{false};
+
+  // staging for the columns of one block, only used by the writer thread
+  std::vector<uint8_t> columns_;
+
+  std::thread writer_;
+};
+
+// Reads a file written by StatsSeriesWriter.
+class StatsSeriesReader {
+ public:
+  // @throw std::invalid_argument if the file is not a stats series
+  explicit StatsSeriesReader(const std::string& path);
+
+  // Read the next block into records, replacing its content.
+  //
+  // @return false at the end of the file
+  // @throw std::runtime_error if the block is truncated
+  bool nextBlock(std::vector<StatsSeriesRecord>& records);
+
+  // all records of the file
+  static std::vector<StatsSeriesRecord> readAll(const std::string& path);
+
+ private:
+  folly::File file_;
+  std::vector<uint8_t> columns_;
+};
+
+} // namespace cachelib
+} // namespace facebook
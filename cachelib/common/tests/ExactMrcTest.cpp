@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <folly/Conv.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "cachelib/common/ExactMrc.h"
+
+namespace facebook {
+namespace cachelib {
+namespace tests {
+namespace {
+struct Access {
+  uint32_t key;
+  ClassId cid;
+};
+
+// Miss ratio curve of the class over trace[from:], simulating the LRU stack
+// directly.
+std::vector<double> bruteForceMrc(const std::vector<Access>& trace,
+                                  size_t from,
+                                  ClassId cid,
+                                  uint32_t allocsPerSlab,
+                                  size_t maxSlabs) {
+  std::vector<uint64_t> histogram(trace.size() + 1, 0);
+  uint64_t accesses = 0;
+  // most recently used at the back
+  std::vector<uint32_t> stack;
+  for (size_t i = from; i < trace.size(); i++) {
+    if (trace[i].cid != cid) {
+      continue;
+    }
+    accesses++;
+    auto it = std::find(stack.begin(), stack.end(), trace[i].key);
+    size_t distance = 0;
+    if (it != stack.end()) {
+      distance = stack.end() - it;
+      stack.erase(it);
+    }
+    stack.push_back(trace[i].key);
+    histogram[distance == 0 ? 0 : (distance - 1) / allocsPerSlab + 1]++;
+  }
+
+  std::vector<double> mrc(maxSlabs + 1, 1.0);
+  uint64_t hits = 0;
+  for (size_t s = 1; s <= maxSlabs; s++) {
+    hits += histogram[s];
+    mrc[s] = 1.0 - static_cast<double>(hits) / accesses;
+  }
+  return mrc;
+}
+} // namespace
+
+TEST(ExactMrc, MatchesLruSimulation) {
+  constexpr size_t kWindow = 300;
+  constexpr size_t kMaxSlabs = 50;
+  const std::vector<uint32_t> allocsPerSlab{3, 5};
+  ExactMrc exact{allocsPerSlab, kWindow};
+
+  std::mt19937 gen(1);
+  std::vector<Access> trace;
+  for (size_t i = 0; i < 5000; i++) {
+    Access a{static_cast<uint32_t>(gen() % 200),
+             static_cast<ClassId>(gen() % 2)};
+    trace.push_back(a);
+    // keys are distinct across classes
+    exact.feed(folly::to<std::string>(a.key, "_", a.cid), a.cid);
+  }
+
+  for (ClassId cid = 0; cid < 2; cid++) {
+    const auto expected =
+        bruteForceMrc(trace, 0, cid, allocsPerSlab[cid], kMaxSlabs);
+    const auto expectedWindow = bruteForceMrc(trace, trace.size() - kWindow,
+                                              cid, allocsPerSlab[cid],
+                                              kMaxSlabs);
+    const auto mrc = exact.mrc(cid, kMaxSlabs);
+    const auto windowMrc = exact.windowMrc(cid, kMaxSlabs);
+    ASSERT_EQ(kMaxSlabs + 1, mrc.size());
+    ASSERT_EQ(kMaxSlabs + 1, windowMrc.size());
+    for (size_t s = 0; s <= kMaxSlabs; s++) {
+      EXPECT_DOUBLE_EQ(expected[s], mrc[s]) << "slabs " << s;
+      EXPECT_DOUBLE_EQ(expectedWindow[s], windowMrc[s]) << "slabs " << s;
+    }
+    EXPECT_DOUBLE_EQ(0.0, ExactMrc::meanAbsoluteError(expected, mrc));
+  }
+  EXPECT_EQ(trace.size(), exact.getAccesses(0) + exact.getAccesses(1));
+  EXPECT_EQ(kWindow, exact.getWindowAccesses(0) + exact.getWindowAccesses(1));
+}
+
+TEST(ExactMrc, Empty) {
+  ExactMrc exact{{4, 4}, 0};
+  exact.feed("key", 0);
+  EXPECT_EQ(11, exact.mrc(0, 10).size());
+  // class 1 was never accessed, and the window is disabled
+  EXPECT_TRUE(exact.mrc(1, 10).empty());
+  EXPECT_TRUE(exact.windowMrc(0, 10).empty());
+}
+
+TEST(ExactMrc, MeanAbsoluteError) {
+  const std::vector<double> exact{1, 1, 0.5, 0.5, 0.25};
+  EXPECT_DOUBLE_EQ(0.0, ExactMrc::meanAbsoluteError(exact, exact));
+  EXPECT_DOUBLE_EQ(
+      0.25 / 4,
+      ExactMrc::meanAbsoluteError(exact, std::vector<double>{1, 1, 0.5, 0.5,
+                                                             0.5}));
+
+  // slab counts without an entry take the closest smaller one
+  EXPECT_DOUBLE_EQ(0.0, ExactMrc::meanAbsoluteError(
+                            exact, std::map<uint64_t, double>{
+                                       {0, 1.0}, {2, 0.5}, {4, 0.25}}));
+  // and 1 when there is none
+  EXPECT_DOUBLE_EQ(0.5 / 4, ExactMrc::meanAbsoluteError(
+                                exact, std::map<uint64_t, double>{
+                                           {3, 0.5}, {4, 0.25}}));
+}
+} // namespace tests
+} // namespace cachelib
+} // namespace facebook
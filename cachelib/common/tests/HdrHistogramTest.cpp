@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "cachelib/common/HdrHistogram.h"
+
+namespace facebook {
+namespace cachelib {
+namespace tests {
+using util::HdrHistogram;
+
+TEST(HdrHistogram, InvalidConfig) {
+  EXPECT_THROW(HdrHistogram(1000, 0), std::invalid_argument);
+  EXPECT_THROW(HdrHistogram(1000, 6), std::invalid_argument);
+  EXPECT_THROW(HdrHistogram(1, 3), std::invalid_argument);
+}
+
+TEST(HdrHistogram, Empty) {
+  HdrHistogram h{1000 * 1000, 3};
+  EXPECT_EQ(0, h.count());
+  EXPECT_EQ(0, h.min());
+  EXPECT_EQ(0, h.max());
+  EXPECT_EQ(0.0, h.mean());
+  EXPECT_EQ(0, h.valueAtPercentile(99));
+}
+
+TEST(HdrHistogram, PercentilesWithinPrecision) {
+  HdrHistogram h{3600ULL * 1000 * 1000 * 1000, 3};
+  std::mt19937_64 rng{1};
+  std::lognormal_distribution<double> dist{10, 2};
+  std::vector<uint64_t> values;
+  for (int i = 0; i < 1000 * 1000; i++) {
+    values.push_back(static_cast<uint64_t>(dist(rng)));
+    h.record(values.back());
+  }
+  std::sort(values.begin(), values.end());
+
+  EXPECT_EQ(values.size(), h.count());
+  EXPECT_EQ(values.front(), h.min());
+  EXPECT_EQ(values.back(), h.max());
+  for (double p : {1.0, 50.0, 90.0, 99.0, 99.9, 99.99, 100.0}) {
+    const auto rank = std::max<size_t>(
+        1, static_cast<size_t>(std::ceil(p / 100 * values.size())));
+    const auto exact = values[rank - 1];
+    const auto got = h.valueAtPercentile(p);
+    EXPECT_GE(got, exact) << p;
+    EXPECT_LE(got - exact, exact / 1000 + 1) << p;
+  }
+}
+
+TEST(HdrHistogram, ClampsToMaxTrackable) {
+  HdrHistogram h{1000, 2};
+  h.record(1000 * 1000);
+  EXPECT_EQ(1, h.count());
+  EXPECT_EQ(1000, h.max());
+  EXPECT_EQ(1000, h.valueAtPercentile(100));
+}
+
+TEST(HdrHistogram, DrainWhileRecording) {
+  HdrHistogram live{1000 * 1000, 3};
+  HdrHistogram total{1000 * 1000, 3};
+  constexpr int kNumThreads = 4;
+  constexpr int kPerThread = 100 * 1000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; t++) {
+    threads.emplace_back([&live]() {
+      for (int i = 0; i < kPerThread; i++) {
+        live.record(i % 1000);
+      }
+    });
+  }
+  // interval reporting drains concurrently with the recorders
+  for (int i = 0; i < 100; i++) {
+    live.drainInto(total);
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  live.drainInto(total);
+
+  EXPECT_EQ(0, live.count());
+  EXPECT_EQ(kNumThreads * kPerThread, total.count());
+  EXPECT_EQ(999, total.max());
+  EXPECT_EQ(0, total.min());
+}
+
+TEST(HdrHistogram, Merge) {
+  HdrHistogram a{1000 * 1000, 3};
+  HdrHistogram b{1000 * 1000, 3};
+  for (uint64_t i = 1; i <= 100; i++) {
+    a.record(i);
+    b.record(i + 100);
+  }
+  a.merge(b);
+  EXPECT_EQ(200, a.count());
+  EXPECT_EQ(1, a.min());
+  EXPECT_EQ(200, a.max());
+  EXPECT_DOUBLE_EQ(100.5, a.mean());
+  EXPECT_EQ(100, a.valueAtPercentile(50));
+  EXPECT_EQ(100, b.count());
+}
+} // namespace tests
+} // namespace cachelib
+} // namespace facebook
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <folly/Benchmark.h>
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+
+#include "cachelib/common/PerfCounters.h"
+
+namespace facebook {
+namespace cachelib {
+namespace tests {
+namespace {
+void spin(uint64_t n) {
+  uint64_t sum = 0;
+  for (uint64_t i = 0; i < n; i++) {
+    sum += i * i;
+    folly::doNotOptimizeAway(sum);
+  }
+}
+
+const PerfRegionCounts& countsOf(const PerfCounters::RegionCounts& counts,
+                                 PerfRegion region) {
+  return counts[static_cast<size_t>(region)];
+}
+
+class PerfCountersTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    if (!PerfCounters::available()) {
+      GTEST_SKIP() << "hardware counters are not available";
+    }
+    PerfCounters::reset();
+  }
+
+  void TearDown() override {
+    PerfCounters::setSampleEvery(0);
+    PerfCounters::reset();
+  }
+};
+} // namespace
+
+TEST(PerfCounters, RegionNames) {
+  for (size_t i = 0; i < PerfCounters::kNumRegions; i++) {
+    EXPECT_NE(std::string{"unknown"},
+              PerfCounters::regionName(static_cast<PerfRegion>(i)));
+  }
+}
+
+TEST_F(PerfCountersTest, DisabledSamplesNothing) {
+  for (int i = 0; i < 100; i++) {
+    PerfRegionScope scope{PerfRegion::kFind};
+    spin(100);
+  }
+  for (const auto& counts : PerfCounters::getCounts()) {
+    EXPECT_EQ(0, counts.samples);
+    EXPECT_EQ(0, counts.cycles);
+  }
+}
+
+TEST_F(PerfCountersTest, SamplesEveryNthEntry) {
+  PerfCounters::setSampleEvery(4);
+  for (int i = 0; i < 100; i++) {
+    PerfRegionScope scope{PerfRegion::kAllocate};
+    spin(1000);
+  }
+  // rebalancer regions are rare and sampled on every entry
+  for (int i = 0; i < 3; i++) {
+    PerfRegionScope scope{PerfRegion::kRebalancerPick};
+    spin(1000);
+  }
+
+  const auto counts = PerfCounters::getCounts();
+  const auto& allocate = countsOf(counts, PerfRegion::kAllocate);
+  EXPECT_EQ(25, allocate.samples);
+  EXPECT_GT(allocate.cycles, 0);
+  // at least an add and a multiply per iteration
+  EXPECT_GT(allocate.instructions, 25 * 1000 * 2);
+  EXPECT_EQ(3, countsOf(counts, PerfRegion::kRebalancerPick).samples);
+  EXPECT_EQ(0, countsOf(counts, PerfRegion::kFind).samples);
+
+  PerfCounters::reset();
+  EXPECT_EQ(0, countsOf(PerfCounters::getCounts(), PerfRegion::kAllocate)
+                   .samples);
+}
+
+TEST_F(PerfCountersTest, NestedRegions) {
+  PerfCounters::setSampleEvery(1);
+  {
+    PerfRegionScope outer{PerfRegion::kFind};
+    spin(1000);
+    {
+      PerfRegionScope inner{PerfRegion::kRecordAccess};
+      spin(1000);
+    }
+  }
+  const auto counts = PerfCounters::getCounts();
+  const auto& find = countsOf(counts, PerfRegion::kFind);
+  const auto& recordAccess = countsOf(counts, PerfRegion::kRecordAccess);
+  EXPECT_EQ(1, find.samples);
+  EXPECT_EQ(1, recordAccess.samples);
+  EXPECT_GT(find.instructions, recordAccess.instructions);
+}
+
+TEST_F(PerfCountersTest, CountsAcrossThreads) {
+  PerfCounters::setSampleEvery(1);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([] {
+      for (int i = 0; i < 10; i++) {
+        PerfRegionScope scope{PerfRegion::kFindEviction};
+        spin(100);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  // threads that can not open a group of their own sample nothing
+  const auto samples =
+      countsOf(PerfCounters::getCounts(), PerfRegion::kFindEviction).samples;
+  EXPECT_TRUE(samples == 0 || samples == 40) << samples;
+}
+} // namespace tests
+} // namespace cachelib
+} // namespace facebook
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <folly/FileUtil.h>
+#include <folly/testing/TestUtil.h>
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "cachelib/common/StatsSeries.h"
+
+namespace facebook {
+namespace cachelib {
+namespace tests {
+namespace {
+StatsSeriesRecord makeRecord(uint64_t i) {
+  StatsSeriesRecord record;
+  record.requestId = i;
+  record.kind = static_cast<uint8_t>(i % 5);
+  record.poolId = static_cast<PoolId>(i % 3);
+  record.classId = static_cast<ClassId>(i % 100);
+  record.otherClassId = Slab::kInvalidClassId;
+  for (size_t j = 0; j < StatsSeriesRecord::kNumValues; j++) {
+    record.values[j] = i * 0.5 + j;
+  }
+  return record;
+}
+
+void expectRecord(uint64_t i, const StatsSeriesRecord& record) {
+  const auto expected = makeRecord(i);
+  EXPECT_EQ(expected.requestId, record.requestId);
+  EXPECT_EQ(expected.kind, record.kind);
+  EXPECT_EQ(expected.poolId, record.poolId);
+  EXPECT_EQ(expected.classId, record.classId);
+  EXPECT_EQ(expected.otherClassId, record.otherClassId);
+  EXPECT_EQ(expected.values, record.values);
+}
+} // namespace
+
+TEST(StatsSeries, RoundTrip) {
+  folly::test::TemporaryDirectory dir;
+  const auto path = (dir.path() / "stats.bin").string();
+  constexpr uint64_t kNumRecords = 10 * 1000;
+  {
+    StatsSeriesWriter writer{path, 1024, std::chrono::hours{1}};
+    for (uint64_t i = 0; i < kNumRecords; i++) {
+      writer.append(makeRecord(i));
+    }
+    writer.flush();
+    EXPECT_EQ(kNumRecords, writer.getRecords());
+    // 9 full buffers and the partial one written by flush()
+    EXPECT_EQ(10, writer.getBlocks());
+  }
+
+  const auto records = StatsSeriesReader::readAll(path);
+  ASSERT_EQ(kNumRecords, records.size());
+  for (uint64_t i = 0; i < kNumRecords; i++) {
+    expectRecord(i, records[i]);
+  }
+}
+
+TEST(StatsSeries, ConcurrentAppendWithSmallBuffers) {
+  folly::test::TemporaryDirectory dir;
+  const auto path = (dir.path() / "stats.bin").string();
+  constexpr uint64_t kNumRecords = 100 * 1000;
+  constexpr uint64_t kNumThreads = 4;
+  {
+    // appenders keep running into full buffers and waiting for the writer
+    StatsSeriesWriter writer{path, 64, std::chrono::milliseconds{1}};
+    std::vector<std::thread> threads;
+    for (uint64_t t = 0; t < kNumThreads; t++) {
+      threads.emplace_back([&writer, t]() {
+        for (uint64_t i = t; i < kNumRecords; i += kNumThreads) {
+          writer.append(makeRecord(i));
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+  }
+
+  // the destructor wrote out everything
+  const auto records = StatsSeriesReader::readAll(path);
+  ASSERT_EQ(kNumRecords, records.size());
+  std::vector<bool> seen(kNumRecords, false);
+  for (const auto& record : records) {
+    ASSERT_LT(record.requestId, kNumRecords);
+    EXPECT_FALSE(seen[record.requestId]);
+    seen[record.requestId] = true;
+    expectRecord(record.requestId, record);
+  }
+}
+
+TEST(StatsSeries, InvalidFile) {
+  folly::test::TemporaryDirectory dir;
+  const auto path = (dir.path() / "stats.bin").string();
+  ASSERT_TRUE(folly::writeFile(std::string("not a stats file"), path.c_str()));
+  EXPECT_THROW(StatsSeriesReader{path}, std::invalid_argument);
+
+  {
+    StatsSeriesWriter writer{path};
+    writer.append(makeRecord(1));
+  }
+  // cut the last record
+  std::string content;
+  ASSERT_TRUE(folly::readFile(path.c_str(), content));
+  content.resize(content.size() - 1);
+  ASSERT_TRUE(folly::writeFile(content, path.c_str()));
+  StatsSeriesReader reader{path};
+  std::vector<StatsSeriesRecord> records;
+  EXPECT_THROW(reader.nextBlock(records), std::runtime_error);
+}
+} // namespace tests
+} // namespace cachelib
+} // namespace facebook
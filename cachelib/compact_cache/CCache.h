@@ -43,6 +43,10 @@
 #include <folly/SharedMutex.h>
 #include <folly/logging/xlog.h>
 
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <type_traits>
 #include <typeinfo>
 
@@ -54,6 +58,7 @@
 #include "cachelib/common/Hash.h"
 #include "cachelib/common/Mutex.h"
 #include "cachelib/compact_cache/CCacheFixedLruBucket.h"
+#include "cachelib/compact_cache/CCacheFixedLruSplitBucket.h"
 #include "cachelib/compact_cache/CCacheVariableLruBucket.h"
 
 /**
@@ -79,6 +84,18 @@ struct DefaultBucketDescriptor {
                                 VariableLruBucket<C>>::type;
 };
 
+namespace detail {
+/**
+ * Whether a bucket descriptor supports lookups without the bucket lock, see
+ * FixedLruSplitBucket::optimisticFind.
+ */
+template <typename B, typename = void>
+struct HasOptimisticReads : std::false_type {};
+template <typename B>
+struct HasOptimisticReads<B, std::void_t<decltype(&B::optimisticFind)>>
+    : std::true_type {};
+} // namespace detail
+
 enum class CCacheReturn : int {
   TIMEOUT = -2,
   ERROR = -1,
@@ -86,7 +103,11 @@ enum class CCacheReturn : int {
   FOUND = 1
 };
 
-enum class RehashOperation { COPY, DELETE };
+/**
+ * COPY and DELETE are the two passes of an offline rehash; MOVE does both on
+ * one bucket at a time and is what an online resize migrates buckets with.
+ */
+enum class RehashOperation { COPY, DELETE, MOVE };
 
 /**
  * Interface for a compact cache. User should not need to directly reference
@@ -119,6 +140,9 @@ class CompactCache : public ICompactCache {
 
   constexpr static bool kHasValues = C::kHasValues;
   constexpr static bool kValuesFixedSize = C::kValuesFixedSize;
+  /** Whether reads look buckets up without locking them first. */
+  constexpr static bool kOptimisticReads =
+      detail::HasOptimisticReads<BucketDescriptor>::value;
 
   enum Operation { READ, WRITE };
 
@@ -193,20 +217,20 @@ class CompactCache : public ICompactCache {
   ~CompactCache();
 
   /**
-   * Resize the arena of this compact cache.
-   * Shrinking the cache:
-   *  (1) Reduce num_chunks, so new requests only hash to the reduced size
-   *  (2) If currently taking requests, wait for all requests that picked up
-   *      the old num_chunk value to drain out. During this time some requests
-   *      will use the old and others will use the new num_chunk value, which
-   *      is ok because we're using a consistent hash.
-   *  (3) Walk the table and free the entries in the chunks we're not using.
-   *  (4) Free no longer used chunks.
-   * Growing the cache:
-   *  (1) Allocate new chunks
-   *  (2) Update num_chunks, wait for refcount on old value to hit 0
-   *  (3) Walk all the entries in the old table size and see which ones would
-   *      now hash to new chunks and move them.
+   * Resize the arena of this compact cache, online. The old and the new
+   * number of chunks coexist while the buckets of the old table migrate:
+   *  (1) When growing, allocate the new chunks.
+   *  (2) Publish the resize state, so requests look keys up where they hash
+   *      with the new number of chunks, after migrating the bucket the key
+   *      used to hash to if nobody did yet. Wait for requests that found
+   *      their bucket before the resize started to drain out.
+   *  (3) Sweep the buckets no request migrated yet. Since the hash is
+   *      consistent, only the chunks past the new size have entries to move
+   *      when shrinking.
+   *  (4) Switch num_chunks to the new value, retire the resize state and
+   *      wait for the requests that still use it.
+   *  (5) When shrinking, free the chunks no longer used.
+   * A request waits at most for the migration of one bucket.
    */
   void resize() override;
 
@@ -377,9 +401,52 @@ class CompactCache : public ICompactCache {
                    size_t newNumChunks,
                    RehashOperation op);
 
+  /** Whether an online resize is migrating buckets right now. */
+  bool isResizing() const {
+    return resizeState_.load(std::memory_order_acquire) != nullptr;
+  }
+
   /** return the current snapshot of all stats */
   CCacheStats getStats() const override { return stats_.getSnapshot(); }
 
+ protected:
+  /**
+   * State of an online resize, published for the time buckets of the old
+   * table migrate to where their entries hash with the new number of
+   * chunks. Holds one bit per bucket of the old table, set once the bucket
+   * has been migrated.
+   */
+  struct ResizeState {
+    ResizeState(size_t oldChunks, size_t newChunks, size_t numBuckets)
+        : oldNumChunks(oldChunks),
+          newNumChunks(newChunks),
+          migrated(new std::atomic<uint64_t>[(numBuckets + 63) / 64]()) {}
+
+    bool isMigrated(size_t idx) const {
+      return migrated[idx / 64].load(std::memory_order_acquire) &
+             (1ULL << (idx % 64));
+    }
+
+    void setMigrated(size_t idx) {
+      migrated[idx / 64].fetch_or(1ULL << (idx % 64),
+                                  std::memory_order_release);
+    }
+
+    const size_t oldNumChunks;
+    const size_t newNumChunks;
+    std::unique_ptr<std::atomic<uint64_t>[]> migrated;
+  };
+
+  /**
+   * The two halves of resize() around the drain of requests that started
+   * before the resize: publish the state of an online resize to
+   * newNumChunks, then sweep the buckets not migrated yet and switch to the
+   * new number of chunks. Must be called with resizeLock_ held, or from
+   * tests.
+   */
+  void beginOnlineResize(size_t newNumChunks);
+  void finishOnlineResize();
+
  private:
   /**
    * Execute a request handler f on a given key.
@@ -410,10 +477,76 @@ class CompactCache : public ICompactCache {
                    Fn f,
                    Args... args);
 
+  /**
+   * Look a key up without taking the bucket lock, only taking it to promote
+   * the entry. Gives up if the bucket keeps changing under the lookup.
+   *
+   * @param rv      set to 0 on a miss, 1 on a hit and -2 if migrating the
+   *                bucket of the key timed out
+   * @return        false if the read must take the bucket lock
+   */
+  bool tryOptimisticGet(const Key& key,
+                        const std::chrono::microseconds& timeout,
+                        Value* val,
+                        bool shouldPromote,
+                        int& rv);
+
+  /** Lookups without the bucket lock tried before taking it. */
+  static constexpr int kOptimisticReadTries = 4;
+
   /** Free chunks whose index is between chunk_index_low, inclusive, and
    * chunk_index_high, exclusive. Used which shrinking the cache. */
   int tableChunksFree(size_t chunkIndexLow, size_t chunkIndexHigh);
 
+  /**
+   * Move or purge the entries of one bucket that would change which chunk
+   * they hash to. Must be called with the bucket locked exclusively.
+   *
+   * A MOVE only tries the locks of the new buckets: the lock of the old
+   * bucket is held meanwhile, and two migrations could otherwise wait for
+   * the same pair of striped locks in opposite orders.
+   *
+   * @param tableChunk    chunk of the bucket
+   * @param bucketIndex   index of the bucket in its chunk
+   * @param moved         entries moved so far, kept across retries of a
+   *                      MOVE
+   *
+   * @return false if a MOVE stopped at a new bucket it could not lock. The
+   *         entries not moved yet stay in the bucket.
+   */
+  bool bucketRehash(Bucket* tableChunk,
+                    size_t bucketIndex,
+                    size_t oldNumChunks,
+                    size_t newNumChunks,
+                    RehashOperation op,
+                    size_t* moved = nullptr);
+
+  enum class MigrateResult { kMigrated, kAlreadyMigrated, kTimeout };
+
+  /**
+   * Migrate a bucket of the old table for an online resize, unless it has
+   * been migrated already. Retries until the bucket is migrated, giving up
+   * once the deadline passes.
+   *
+   * @param deadline  time_point::max() to wait as long as it takes
+   */
+  MigrateResult migrateBucket(
+      ResizeState& state,
+      size_t chunkIndex,
+      size_t bucketIndex,
+      std::chrono::steady_clock::time_point deadline =
+          std::chrono::steady_clock::time_point::max());
+
+  /**
+   * Whether a request that found its bucket without a resize under way
+   * (state == nullptr) must look again because one started since. Called
+   * with the bucket locked, or after reading it optimistically, so any
+   * migration of the bucket shows up as a published resize state.
+   */
+  bool resizeStartedSince(const ResizeState* state) const {
+    return UNLIKELY(state == nullptr && isResizing());
+  }
+
   /**
    * Find the chunk on which the specified key would be located given the
    * specified number of chunks. Used by tableFindBucket for looking update
@@ -427,6 +560,7 @@ class CompactCache : public ICompactCache {
    * @return pointer to the first bucket of the desired chunk.
    */
   Bucket* tableFindChunk(size_t numChunks, const Key& key);
+  size_t tableFindChunkIndex(size_t numChunks, const Key& key);
 
   /**
    * Find out which bucket an entry might be in. Do this in a 2 step process:
@@ -447,7 +581,20 @@ class CompactCache : public ICompactCache {
    * @return bucket that maps to the key.
    */
   Bucket* tableFindBucket(const Key& key);
-  Bucket* tableFindDblWriteBucket(const Key& key);
+
+  /**
+   * Find the bucket of a key while resizes may happen. If a resize is under
+   * way, first migrate the bucket of the old table the key hashes to, then
+   * return the bucket in the new table.
+   *
+   * @param state    set to the resize state used, nullptr if none
+   * @param timeout  if greater than 0, how long to try migrating the bucket
+   *
+   * @return nullptr if migrating the bucket timed out
+   */
+  Bucket* tableFindBucket(const Key& key,
+                          ResizeState*& state,
+                          const std::chrono::microseconds& timeout);
 
   /**
    * Callback called by the bucket descriptor when an entry is evicted.
@@ -552,15 +699,16 @@ class CompactCache : public ICompactCache {
   ValidCb validCb_;
   facebook::cachelib::Cohort cohort_;     /**< resize cohort synchronization */
   mutable folly::SharedMutex resizeLock_; /**< Lock to synchronize resize. */
+  std::atomic<ResizeState*> resizeState_{nullptr}; /**< online resize */
+  std::unique_ptr<ResizeState> ownedResizeState_;  /**< owns resizeState_ */
   const size_t bucketsPerChunk_;
   util::FastStats<CCacheStats> stats_;
   const bool allowPromotions_; /**< Whether promotions are allowed on read
                                     operations */
 
  protected:
-  // expose these two fields for test hack
+  // expose this field for test hack
   std::atomic<size_t> numChunks_;
-  std::atomic<size_t> pendingNumChunks_;
 };
 
 namespace detail {
@@ -669,8 +817,7 @@ CompactCache<C, A, B>::CompactCache(Allocator& allocator,
       bucketsPerChunk_(allocator_.getChunkSize() / sizeof(Bucket)),
       stats_{},
       allowPromotions_(allowPromotions),
-      numChunks_(allocator_.getNumChunks()),
-      pendingNumChunks_(0) {
+      numChunks_(allocator_.getNumChunks()) {
   allocator_.attach(this);
 }
 
@@ -686,7 +833,7 @@ CompactCache<C, A, B>::~CompactCache() {
  * @param oldNumChunks  old size of compact cache
  * @param newNumChunks  new size of compact cache
  * @param op            whether to create new entries COPY or delete
- *                      old ones DELETE in this call
+ *                      old ones DELETE in this call, or both MOVE
  */
 template <typename C, typename A, typename B>
 void CompactCache<C, A, B>::tableRehash(size_t oldNumChunks,
@@ -700,100 +847,207 @@ void CompactCache<C, A, B>::tableRehash(size_t oldNumChunks,
   for (size_t n = 0; n < oldNumChunks; n++) {
     Bucket* table_chunk = reinterpret_cast<Bucket*>(allocator_.getChunk(n));
     for (size_t i = 0; i < bucketsPerChunk_; i++) {
-      Bucket* bucket = &table_chunk[i];
-      auto lock = locks_.lockExclusive(bucket);
-
-      const size_t capacity = BucketDescriptor::nEntriesCapacity(*bucket);
-      /* When expanding the cache (newNumChunks > oldNumChunks) move
-       * the entire capacity elements over.
-       * When shrinking cache to some fraction of its former size,
-       * move that fraction of the to-be-deleted chunks in order to
-       * maintain a non-zero cache lifetime throughout */
-      const size_t max_move = std::min(
-          std::max((newNumChunks * capacity) / oldNumChunks, (size_t)1),
-          capacity);
-      size_t moved = 0;
-      EntryHandle entry = BucketDescriptor::first(&table_chunk[i]);
-      while (entry) {
-        const bool valid_entry = !validCb_ || validCb_(entry.key());
-        auto remove_context =
-            valid_entry ? RemoveContext::kEviction : RemoveContext::kNormal;
-        Bucket* new_chunk = tableFindChunk(newNumChunks, entry.key());
-        if (new_chunk == table_chunk) {
-          entry.next();
-          continue;
-        }
+      auto lock = locks_.lockExclusive(&table_chunk[i]);
+      bucketRehash(table_chunk, i, oldNumChunks, newNumChunks, op);
+    }
+  }
+}
+
+template <typename C, typename A, typename B>
+bool CompactCache<C, A, B>::bucketRehash(Bucket* table_chunk,
+                                         size_t i,
+                                         size_t oldNumChunks,
+                                         size_t newNumChunks,
+                                         RehashOperation op,
+                                         size_t* movedSoFar) {
+  Bucket* bucket = &table_chunk[i];
+  const size_t capacity = BucketDescriptor::nEntriesCapacity(*bucket);
+  /* When expanding the cache (newNumChunks > oldNumChunks) move
+   * the entire capacity elements over.
+   * When shrinking cache to some fraction of its former size,
+   * move that fraction of the to-be-deleted chunks in order to
+   * maintain a non-zero cache lifetime throughout */
+  const size_t max_move = std::min(
+      std::max((newNumChunks * capacity) / oldNumChunks, (size_t)1), capacity);
+  size_t localMoved = 0;
+  size_t& moved = movedSoFar ? *movedSoFar : localMoved;
+  EntryHandle entry = BucketDescriptor::first(bucket);
+  while (entry) {
+    const bool valid_entry = !validCb_ || validCb_(entry.key());
+    auto remove_context =
+        valid_entry ? RemoveContext::kEviction : RemoveContext::kNormal;
+    Bucket* new_chunk = tableFindChunk(newNumChunks, entry.key());
+    if (new_chunk == table_chunk) {
+      entry.next();
+      continue;
+    }
 
-        /* Moving takes two forms. If newNumChunks is bigger, we move
-         * everything to its new place in the newly allocated chunks.
-         * If smaller, we need to preserve read-after-write so we move
-         * a small initial fraction of the newly lost buckets to their
-         * new home, putting them at the head of the LRU.
-         *
-         * This occurs in two stages; first we insert the to-be-moved
-         * entries into their new home and call the removal callbacks
-         * for invalid or excess ones.
-         *
-         * Second, after reads have moved, we delete the old entries
-         * This is done in a new cohort to ensure reads never see
-         * a temporarily disappeared entry in cache.
+    /* Moving takes two forms. If newNumChunks is bigger, we move
+     * everything to its new place in the newly allocated chunks.
+     * If smaller, we need to preserve read-after-write so we move
+     * a small initial fraction of the newly lost buckets to their
+     * new home, putting them at the head of the LRU.
+     *
+     * Offline, this occurs in two stages; first we insert the to-be-moved
+     * entries into their new home and call the removal callbacks
+     * for invalid or excess ones.
+     *
+     * Second, after reads have moved, we delete the old entries
+     * This is done in a new cohort to ensure reads never see
+     * a temporarily disappeared entry in cache.
+     *
+     * Online (MOVE), requests only look the entry up in its new home once
+     * the bucket has been migrated, so both stages happen at once.
+     */
+    if (op != RehashOperation::DELETE) {
+      if (valid_entry && moved < max_move) {
+        /* Add new entry. Offset is the same, so no need to
+         * re-compute that hash
          */
-        if (op == RehashOperation::COPY) {
-          if (valid_entry && moved < max_move) {
-            /* Add new entry. Offset is the same, so no need to
-             * re-compute that hash
-             */
-            Bucket* newBucket = &new_chunk[i];
-            // lock ordering is established by the hash function;
-            // old hash -> new hash
-            // However there can be arbitrary hash collisions, so
-            // don't relock the same lock (we don't use recursive
-            // locks in general)
-            bool sameLock = locks_.isSameLock(newBucket, bucket);
-            auto higher_lock //
-                = sameLock   //
-                      ? std::unique_lock<folly::SharedMutex>()
-                      : locks_.lockExclusive(newBucket);
-            if (kHasValues) {
-              if (kValuesFixedSize) {
-                bucketSet(newBucket, entry.key(), entry.val());
-              } else {
-                bucketSet(newBucket, entry.key(), entry.val(), entry.size());
-              }
-            } else {
-              bucketSet(newBucket, entry.key());
-            }
-            moved++;
+        Bucket* newBucket = &new_chunk[i];
+        // lock ordering is established by the hash function;
+        // old hash -> new hash
+        // However there can be arbitrary hash collisions, so
+        // don't relock the same lock (we don't use recursive
+        // locks in general)
+        bool sameLock = locks_.isSameLock(newBucket, bucket);
+        auto higher_lock //
+            = sameLock   //
+                  ? std::unique_lock<folly::SharedMutex>()
+                  : (op == RehashOperation::MOVE
+                         ? locks_.tryLockExclusive(newBucket)
+                         : locks_.lockExclusive(newBucket));
+        if (!sameLock && !higher_lock.owns_lock()) {
+          // the caller lets go of the bucket and tries again
+          return false;
+        }
+        if (kHasValues) {
+          if (kValuesFixedSize) {
+            bucketSet(newBucket, entry.key(), entry.val());
           } else {
-            // not moving this one, either invalid or we're full
-            // call evict (or delete if invalid) callback
-            if (removeCb_) {
-              detail::callRemoveCb<SelfType>(
-                  removeCb_, entry.key(), entry.val(), remove_context);
-            }
+            bucketSet(newBucket, entry.key(), entry.val(), entry.size());
           }
-          entry.next();
         } else {
-          // on the second pass we run the deletes, to avoid
-          // read requests seeing no data in the interim
-          // actually delete here
-          BucketDescriptor::del(entry);
-          // no entry.next() call as del advances ptr
+          bucketSet(newBucket, entry.key());
+        }
+        moved++;
+      } else {
+        // not moving this one, either invalid or we're full
+        // call evict (or delete if invalid) callback
+        if (removeCb_) {
+          detail::callRemoveCb<SelfType>(
+              removeCb_, entry.key(), entry.val(), remove_context);
         }
       }
-      XDCHECK(newNumChunks <= oldNumChunks || !entry);
+      if (op == RehashOperation::COPY) {
+        entry.next();
+        continue;
+      }
     }
+    // on the second pass we run the deletes, to avoid
+    // read requests seeing no data in the interim
+    // actually delete here
+    BucketDescriptor::del(entry);
+    // no entry.next() call as del advances ptr
   }
+  XDCHECK(newNumChunks <= oldNumChunks || !entry);
+  return true;
 }
 
 template <typename C, typename A, typename B>
-void CompactCache<C, A, B>::resize() {
+typename CompactCache<C, A, B>::MigrateResult
+CompactCache<C, A, B>::migrateBucket(
+    ResizeState& state,
+    size_t chunkIndex,
+    size_t bucketIndex,
+    std::chrono::steady_clock::time_point deadline) {
+  const size_t idx = chunkIndex * bucketsPerChunk_ + bucketIndex;
+  if (state.isMigrated(idx)) {
+    return MigrateResult::kAlreadyMigrated;
+  }
+
+  Bucket* chunk = reinterpret_cast<Bucket*>(allocator_.getChunk(chunkIndex));
+  const bool hasDeadline =
+      deadline != std::chrono::steady_clock::time_point::max();
+  size_t moved = 0;
+  while (true) {
+    std::chrono::microseconds timeout{0};
+    if (hasDeadline) {
+      const auto now = std::chrono::steady_clock::now();
+      if (now >= deadline) {
+        return MigrateResult::kTimeout;
+      }
+      timeout = std::max(
+          std::chrono::duration_cast<std::chrono::microseconds>(deadline - now),
+          std::chrono::microseconds{1});
+    }
+    auto lock = locks_.lockExclusive(timeout, &chunk[bucketIndex]);
+    if (!lock.owns_lock()) {
+      return MigrateResult::kTimeout;
+    }
+    if (state.isMigrated(idx)) {
+      return MigrateResult::kAlreadyMigrated;
+    }
+    if (bucketRehash(chunk, bucketIndex, state.oldNumChunks,
+                     state.newNumChunks, RehashOperation::MOVE, &moved)) {
+      // set while the bucket is locked, so a request that locks it after the
+      // migration and rechecks the resize state sees the resize
+      state.setMigrated(idx);
+      return MigrateResult::kMigrated;
+    }
+    // a new bucket was locked, possibly by a migration waiting for ours
+    lock.unlock();
+    std::this_thread::yield();
+  }
+}
+
+template <typename C, typename A, typename B>
+void CompactCache<C, A, B>::beginOnlineResize(size_t newNumChunks) {
   const size_t oldNumChunks = numChunks_;
+  XDCHECK(!isResizing());
+  XDCHECK_GT(oldNumChunks, 0u);
+  XDCHECK_GT(newNumChunks, 0u);
+  ownedResizeState_ = std::make_unique<ResizeState>(
+      oldNumChunks, newNumChunks, oldNumChunks * bucketsPerChunk_);
+  resizeState_.store(ownedResizeState_.get(), std::memory_order_release);
+}
+
+template <typename C, typename A, typename B>
+void CompactCache<C, A, B>::finishOnlineResize() {
+  ResizeState& state = *ownedResizeState_;
+  const size_t oldNumChunks = state.oldNumChunks;
+  const size_t newNumChunks = state.newNumChunks;
+
+  /* Sweep the buckets requests did not migrate on access. Consistent
+   * hashing keeps keys in their chunk unless it goes away, so when
+   * shrinking only the chunks past the new size have entries to move. */
+  const size_t firstChunk = newNumChunks < oldNumChunks ? newNumChunks : 0;
+  uint64_t swept = 0;
+  for (size_t n = firstChunk; n < oldNumChunks; n++) {
+    for (size_t i = 0; i < bucketsPerChunk_; i++) {
+      swept += migrateBucket(state, n, i) == MigrateResult::kMigrated;
+    }
+  }
+  stats_.tlStats().resizeMigrationsSwept += swept;
+
+  // every key is now where it hashes with the new number of chunks, so
+  // requests that do not see the resize state anymore can use it directly
+  numChunks_ = newNumChunks;
+  resizeState_.store(nullptr, std::memory_order_release);
+
+  // wait for the requests still using the resize state, and the chunks
+  // past the new size when shrinking
+  cohort_.switchCohorts();
+  ownedResizeState_.reset();
+}
+
+template <typename C, typename A, typename B>
+void CompactCache<C, A, B>::resize() {
   const size_t configuredSize = allocator_.getConfiguredSize();
   const size_t numChunksWanted = configuredSize / allocator_.getChunkSize();
 
   /* No change in size */
-  if (oldNumChunks == numChunksWanted) {
+  if (numChunks_ == numChunksWanted) {
     return;
   }
 
@@ -801,6 +1055,12 @@ void CompactCache<C, A, B>::resize() {
    * at a time */
   auto lock = std::unique_lock(resizeLock_);
 
+  /* A resize that held the lock may have done the work already */
+  const size_t oldNumChunks = numChunks_;
+  if (oldNumChunks == numChunksWanted) {
+    return;
+  }
+
   size_t newNumChunks = numChunksWanted;
 
   if (numChunksWanted > oldNumChunks) {
@@ -817,37 +1077,17 @@ void CompactCache<C, A, B>::resize() {
     }
   }
 
-  /* Update the number of chunks so new write requests start hitting both
-   * old and new chunks */
   XDCHECK_NE(newNumChunks, oldNumChunks);
-  XDCHECK_EQ(pendingNumChunks_.load(), 0u);
   /* only bother resharding if not going from/to 0 size */
   if (newNumChunks > 0 && oldNumChunks > 0) {
-    pendingNumChunks_ = newNumChunks;
-    /* Ensure all writes are double writing now */
-    cohort_.switchCohorts();
+    beginOnlineResize(newNumChunks);
 
-    /* Sweep through the table and find all buckets that should now rehash.
-     * In offline mode, move entries; online we just delete
-     * to avoid invalidate races
-     */
-    tableRehash(oldNumChunks, newNumChunks, RehashOperation::COPY);
-
-    // now that rehash happened, we can start reading from the new location
-    // don't yet stop double writes as that ordering (no double write, read
-    // from old location) may not be guaranteed
-    // It likely is fine as those are ordered by a lock which should order
-    // the loads of the num_chunks value properly
-    numChunks_ = newNumChunks;
-    cohort_.switchCohorts();
-
-    // now stop double writes and wait for all requests to complete
-    // so that the old chunk locations are totally unused
-    pendingNumChunks_ = 0;
+    /* Requests that found their bucket before the resize started notice it
+     * under the bucket lock and look again. Wait for them to drain out, so
+     * none of them is left once the sweep is done. */
     cohort_.switchCohorts();
 
-    // now go through again and delete stale entries in the old location
-    tableRehash(oldNumChunks, newNumChunks, RehashOperation::DELETE);
+    finishOnlineResize();
   } else {
     numChunks_ = newNumChunks;
 
@@ -891,6 +1131,12 @@ CCacheReturn CompactCache<C, A, B>::get(
     Value* val,
     size_t* size,
     bool shouldPromote) {
+  if constexpr (kOptimisticReads) {
+    int rv;
+    if (tryOptimisticGet(key, timeout, val, shouldPromote, rv)) {
+      UPDATE_STATS_AND_RETURN(get, rv);
+    }
+  }
   int rv = callBucketFn(key,
                         Operation::READ,
                         timeout,
@@ -904,6 +1150,13 @@ CCacheReturn CompactCache<C, A, B>::get(
 template <typename C, typename A, typename B>
 CCacheReturn CompactCache<C, A, B>::exists(
     const Key& key, const std::chrono::microseconds& timeout) {
+  if constexpr (kOptimisticReads) {
+    int rv;
+    if (tryOptimisticGet(key, timeout, nullptr /* val */,
+                         false /* shouldPromote */, rv)) {
+      UPDATE_STATS_AND_RETURN(get, rv);
+    }
+  }
   int rv = callBucketFn(key,
                         Operation::READ,
                         timeout,
@@ -964,7 +1217,12 @@ int CompactCache<C, A, B>::callBucketFn(
   Cohort::Token tok = cohort_.incrActiveReqs();
 
   /* 2) Find the hash table bucket for the key. */
-  Bucket* bucket = tableFindBucket(key);
+  ResizeState* resizeState;
+  Bucket* bucket = tableFindBucket(key, resizeState, timeout);
+  if (bucket == nullptr) {
+    ++stats_.tlStats().lockTimeout;
+    return -2;
+  }
 
   /* 3) Lock the bucket. Immutable bucket is a parameter
    * regarding whether we're allowed to modify the bucket in any way,
@@ -982,6 +1240,10 @@ int CompactCache<C, A, B>::callBucketFn(
       ++stats_.tlStats().lockTimeout;
       return -2;
     }
+    if (resizeStartedSince(resizeState)) {
+      lock.unlock();
+      return callBucketFn(key, op, timeout, f, args...);
+    }
 
     rv = (this->*f)(bucket, key, args...);
   } else {
@@ -991,6 +1253,10 @@ int CompactCache<C, A, B>::callBucketFn(
       ++stats_.tlStats().lockTimeout;
       return -2;
     }
+    if (resizeStartedSince(resizeState)) {
+      lock.unlock();
+      return callBucketFn(key, op, timeout, f, args...);
+    }
 
     rv = (this->*f)(bucket, key, args...);
   }
@@ -1013,38 +1279,81 @@ int CompactCache<C, A, B>::callBucketFn(
     }
   }
   XDCHECK(rv != BucketReturn::PROMOTE);
+  XDCHECK_NE(toInt(rv), 2);
+  return toInt(rv);
+}
 
-  /* 6) Do the operation on the new location if necessary
-   * Note that although we release the old lock, the order is very
-   * important. The rehasher will be doing lock old -> read old ->
-   * lock new -> write new -> unlock both
-   * So, we need to make sure that our old update either happens
-   * before the rehasher reads, or if it happens after then the new update
-   * also happens after. IE new update has to be second.
-   */
-  Bucket* bucketDbl =
-      (op == Operation::WRITE) ? tableFindDblWriteBucket(key) : nullptr;
+template <typename C, typename A, typename B>
+bool CompactCache<C, A, B>::tryOptimisticGet(
+    const Key& key,
+    const std::chrono::microseconds& timeout,
+    Value* val,
+    bool shouldPromote,
+    int& rv) {
+  if (numChunks_ == 0) {
+    return false;
+  }
+
+  /* Keeps the chunks from being freed by a resize, like for locked reads. */
+  Cohort::Token tok = cohort_.incrActiveReqs();
+  ResizeState* resizeState;
+  Bucket* bucket = tableFindBucket(key, resizeState, timeout);
+  if (bucket == nullptr) {
+    ++stats_.tlStats().lockTimeout;
+    rv = -2;
+    return true;
+  }
 
-  if (bucketDbl != nullptr) {
-    auto lockDbl = locks_.lockExclusive(bucketDbl);
-    if ((this->*f)(bucketDbl, key, args...) == BucketReturn::ERROR) {
-      rv = BucketReturn::ERROR;
+  for (int i = 0; i < kOptimisticReadTries; i++) {
+    int pos = -1;
+    const auto res = BucketDescriptor::optimisticFind(bucket, key, val, pos);
+    if (res == BucketDescriptor::OptimisticResult::kRetry) {
+      continue;
+    }
+    if (resizeStartedSince(resizeState)) {
+      // the entry may have just been migrated out of the bucket
+      return false;
+    }
+    if (res == BucketDescriptor::OptimisticResult::kMiss) {
+      rv = toInt(BucketReturn::NOTFOUND);
+      return true;
+    }
+
+    if (pos == BucketDescriptor::kEntriesPerBucket - 1) {
+      ++stats_.tlStats().tailHits;
+    }
+    if (shouldPromote && allowPromotions_ &&
+        BucketDescriptor::needsPromote(pos)) {
+      auto lock = locks_.lockExclusive(timeout, bucket);
+      if (!lock.owns_lock()) {
+        XDCHECK(timeout > std::chrono::microseconds::zero());
+        ++stats_.tlStats().promoteTimeout;
+      } else {
+        this->bucketPromote(bucket, key);
+      }
     }
+    rv = toInt(BucketReturn::FOUND);
+    return true;
   }
-  XDCHECK_NE(toInt(rv), 2);
-  return toInt(rv);
+  return false;
 }
 
 template <typename C, typename A, typename B>
-typename CompactCache<C, A, B>::Bucket* CompactCache<C, A, B>::tableFindChunk(
-    size_t numChunks, const Key& key) {
+size_t CompactCache<C, A, B>::tableFindChunkIndex(size_t numChunks,
+                                                  const Key& key) {
   XDCHECK_GT(numChunks, 0u);
   XDCHECK_LE(numChunks, allocator_.getNumChunks());
 
   /* furcHash is well behaved; numChunks <= 1 returns 0 for chunkIndex */
-  auto chunkIndex = facebook::cachelib::furcHash(
+  return facebook::cachelib::furcHash(
       reinterpret_cast<const void*>(&key), sizeof(key), numChunks);
-  return reinterpret_cast<Bucket*>(allocator_.getChunk(chunkIndex));
+}
+
+template <typename C, typename A, typename B>
+typename CompactCache<C, A, B>::Bucket* CompactCache<C, A, B>::tableFindChunk(
+    size_t numChunks, const Key& key) {
+  return reinterpret_cast<Bucket*>(
+      allocator_.getChunk(tableFindChunkIndex(numChunks, key)));
 }
 
 template <typename C, typename A, typename B>
@@ -1057,21 +1366,34 @@ typename CompactCache<C, A, B>::Bucket* CompactCache<C, A, B>::tableFindBucket(
 }
 
 template <typename C, typename A, typename B>
-typename CompactCache<C, A, B>::Bucket*
-CompactCache<C, A, B>::tableFindDblWriteBucket(const Key& key) {
-  // this var is volatile and can be 0, which will cause
-  // asserts later; avoid this case
-  size_t pending = pendingNumChunks_;
-  if (pending == 0) {
-    return nullptr;
-  }
-  Bucket* chunk = tableFindChunk(numChunks_, key);
-  Bucket* chunkNew = tableFindChunk(pending, key);
-  if (chunk == chunkNew) {
-    return nullptr;
+typename CompactCache<C, A, B>::Bucket* CompactCache<C, A, B>::tableFindBucket(
+    const Key& key,
+    ResizeState*& state,
+    const std::chrono::microseconds& timeout) {
+  state = resizeState_.load(std::memory_order_acquire);
+  if (LIKELY(state == nullptr)) {
+    return tableFindBucket(key);
   }
+
+  const size_t oldChunk = tableFindChunkIndex(state->oldNumChunks, key);
+  const size_t newChunk = tableFindChunkIndex(state->newNumChunks, key);
   uint32_t hv = MurmurHash2()(reinterpret_cast<const void*>(&key), sizeof(key));
-  return &chunkNew[hv % bucketsPerChunk_];
+  const size_t bucketIndex = hv % bucketsPerChunk_;
+  if (oldChunk != newChunk) {
+    const auto deadline = timeout > std::chrono::microseconds::zero()
+                              ? std::chrono::steady_clock::now() + timeout
+                              : std::chrono::steady_clock::time_point::max();
+    switch (migrateBucket(*state, oldChunk, bucketIndex, deadline)) {
+    case MigrateResult::kMigrated:
+      ++stats_.tlStats().resizeMigrationsOnAccess;
+      break;
+    case MigrateResult::kAlreadyMigrated:
+      break;
+    case MigrateResult::kTimeout:
+      return nullptr;
+    }
+  }
+  return &reinterpret_cast<Bucket*>(allocator_.getChunk(newChunk))[bucketIndex];
 }
 
 template <typename C, typename A, typename B>
@@ -1187,6 +1509,9 @@ CompactCache<C, A, B>::bucketPromote(Bucket* bucket, const Key& key) {
 template <typename C, typename A, typename B>
 typename CompactCache<C, A, B>::EntryHandle CompactCache<C, A, B>::bucketFind(
     Bucket* bucket, const Key& key) {
+  if constexpr (kOptimisticReads) {
+    return BucketDescriptor::find(bucket, key);
+  }
   for (EntryHandle handle = BucketDescriptor::first(bucket); handle;
        handle.next()) {
     if (handle.key() == key) {
@@ -1205,7 +1530,7 @@ bool CompactCache<C, A, B>::forEachBucket(const BucketCallBack& cb) {
 
   // this obtains a resize lock so it cannot be occuring during an actual
   // resize; assert that
-  XDCHECK_EQ(pendingNumChunks_.load(), 0u);
+  XDCHECK(!isResizing());
 
   /* Loop through all buckets in the table. */
   for (size_t n = 0; n < numChunks_; n++) {
@@ -74,6 +74,30 @@ struct CCacheCreator {
   using type = CompactCache<Descriptor, AllocatorT>;
 };
 
+/**
+ * Same as CCacheCreator, with buckets that keep the keys apart from the
+ * values and that reads look up without taking the bucket lock (see
+ * FixedLruSplitBucket). Suits read heavy caches of small keys; the keys must
+ * compare equal exactly when their bytes do.
+ *
+ * using MyCCache = CCacheSplitBucketCreator<A, K, V>::type;
+ */
+template <typename AllocatorT, typename KeyT, typename ValueT = NoValue>
+struct CCacheSplitBucketCreator {
+ private:
+  using ValueDesc = typename std::conditional<std::is_integral<ValueT>::value,
+                                              CounterValueDescriptor<ValueT>,
+                                              ValueDescriptor<ValueT>>::type;
+
+  using Descriptor = CompactCacheDescriptor<KeyT, ValueDesc>;
+
+ public:
+  using type =
+      CompactCache<Descriptor,
+                   AllocatorT,
+                   FixedLruSplitBucket<Descriptor, NB_ENTRIES_PER_BUCKET>>;
+};
+
 /**
  * The following trait can be used for creating a compact cache that stores
  * values of a variable size.
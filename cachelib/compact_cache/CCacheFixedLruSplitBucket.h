@@ -0,0 +1,368 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+/**
+ * This file implements the same bucket management as FixedLruBucket (entries
+ * of a fixed size, most recently used on top, promotion by sliding the
+ * entries above down) with a layout and a version that let readers look up
+ * a bucket without taking its lock:
+ *
+ *  - The keys of a bucket are stored contiguously, apart from the values, so
+ *    a lookup scans sizeof(Key) * kEntriesPerBucket bytes rather than the
+ *    whole bucket, and small keys are compared several at a time with SIMD.
+ *  - Every bucket starts with a sequence number that writers, which hold the
+ *    bucket lock exclusively, make odd while they change the bucket. A reader
+ *    copies out what it needs between two loads of the sequence number and
+ *    retries if the bucket changed in between (see optimisticFind).
+ *
+ * Keys are compared byte by byte, like they are hashed, so Key::operator==
+ * must not consider keys with different bytes equal.
+ *
+ * The layout differs from FixedLruBucket, so a compact cache can not switch
+ * between the two over a warm roll.
+ */
+
+#include <folly/Portability.h>
+#include <folly/lang/Bits.h>
+
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+
+#if FOLLY_SSE >= 2
+#include <emmintrin.h>
+#endif
+
+namespace facebook {
+namespace cachelib {
+
+template <typename CompactCacheDescriptor, unsigned EntriesPerBucket>
+struct FixedLruSplitBucket {
+ public:
+  using Descriptor = CompactCacheDescriptor;
+  using ValueDescriptor = typename Descriptor::ValueDescriptor;
+  using Key = typename Descriptor::Key;
+  using Value = typename ValueDescriptor::Value;
+
+  constexpr static int kEntriesPerBucket = EntriesPerBucket;
+  constexpr static bool kHasValues = Descriptor::kHasValues;
+
+  static_assert(Descriptor::kValuesFixedSize,
+                "This bucket descriptor must be used with values of a fixed"
+                "size");
+  static_assert(kEntriesPerBucket <= 32, "Match masks are 32 bits wide");
+
+  /** Type of a bucket.
+   * Empty entry slots must be zeroed out to avoid spurious matches! A zeroed
+   * bucket is a valid empty bucket. */
+  struct alignas(uint32_t) Bucket {
+    /* odd while a writer changes the bucket */
+    uint32_t seq;
+    Key keys[kEntriesPerBucket];
+    /* Expands to NoValue (size 0) if this cache does not store values */
+    Value vals[kEntriesPerBucket];
+  };
+
+  static_assert(std::is_trivially_copyable<Key>::value &&
+                    std::is_trivially_copyable<Value>::value,
+                "Keys and values are copied and compared as bytes");
+
+  /**
+   * Handle to an entry, see FixedLruBucket::EntryHandle.
+   */
+  class EntryHandle {
+   public:
+    explicit operator bool() const {
+      return pos_ >= 0 && pos_ < kEntriesPerBucket &&
+             !Key(bucket_->keys[pos_]).isEmpty();
+    }
+    void next() {
+      XDCHECK(*this);
+      ++pos_;
+    }
+
+    Key key() const { return bucket_->keys[pos_]; }
+    Value* val() const { return &bucket_->vals[pos_]; }
+    constexpr size_t size() const { return sizeof(Value); }
+
+    EntryHandle() : bucket_(nullptr), pos_(-1) {}
+    EntryHandle(Bucket* bucket, int pos) : bucket_(bucket), pos_(pos) {}
+
+    bool isBucketTail() const { return *this && pos_ == kEntriesPerBucket - 1; }
+
+   private:
+    Bucket* bucket_;
+    int pos_;
+    friend struct FixedLruSplitBucket<CompactCacheDescriptor,
+                                      EntriesPerBucket>;
+  };
+
+  /** Type of the callback to be called when an entry is evicted. */
+  using EvictionCb = std::function<void(const EntryHandle& handle)>;
+
+  /** Result of a lookup without the bucket lock. */
+  enum class OptimisticResult { kRetry, kMiss, kHit };
+
+  static EntryHandle first(Bucket* bucket) { return EntryHandle(bucket, 0); }
+
+  static uint32_t nEntriesCapacity(const Bucket& /*bucket*/) {
+    return kEntriesPerBucket;
+  }
+
+  /**
+   * Find the entry of a key. Must be called under the bucket lock.
+   *
+   * @return handle to the entry or an invalid handle if not found.
+   */
+  static EntryHandle find(Bucket* bucket, const Key& key) {
+    const int pos = findPos(bucket, key);
+    return pos < 0 ? EntryHandle() : EntryHandle(bucket, pos);
+  }
+
+  /**
+   * Look a key up without the bucket lock.
+   *
+   * @param bucket  Bucket to look the key up in.
+   * @param key     Key to look up.
+   * @param val     Where to copy the value to on a hit. Nullptr if the value
+   *                is not needed.
+   * @param pos     Set to the position of the entry on a hit.
+   * @return        kHit or kMiss if the bucket did not change during the
+   *                lookup; kRetry if it did, in which case nothing was
+   *                copied out.
+   */
+  static OptimisticResult optimisticFind(const Bucket* bucket,
+                                         const Key& key,
+                                         Value* val,
+                                         int& pos) {
+    const uint32_t seq = __atomic_load_n(&bucket->seq, __ATOMIC_ACQUIRE);
+    if (seq & 1) {
+      return OptimisticResult::kRetry;
+    }
+    // The bucket may change under us, so everything read here is a snapshot
+    // that is only used once the sequence number shows it was consistent.
+    pos = findPos(bucket, key);
+    alignas(Value) unsigned char copy[kHasValues ? sizeof(Value) : 1];
+    const bool wantValue = kHasValues && val != nullptr && pos >= 0;
+    if (wantValue) {
+      std::memcpy(copy, &bucket->vals[pos], sizeof(Value));
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (__atomic_load_n(&bucket->seq, __ATOMIC_RELAXED) != seq) {
+      return OptimisticResult::kRetry;
+    }
+    if (pos < 0) {
+      return OptimisticResult::kMiss;
+    }
+    if (wantValue) {
+      std::memcpy(val, copy, sizeof(Value));
+    }
+    return OptimisticResult::kHit;
+  }
+
+  /*
+   * Insert a new entry in a bucket, see FixedLruBucket::insert.
+   */
+  static bool insert(Bucket* bucket,
+                     const Key& key,
+                     const Value* val,
+                     size_t,
+                     EvictionCb evictionCb) {
+    bool evicted = false;
+
+    /* The last position is the LRU. Evict it if it holds an entry. */
+    if (!Key(bucket->keys[kEntriesPerBucket - 1]).isEmpty()) {
+      XDCHECK(evictionCb);
+      evictionCb(EntryHandle(bucket, kEntriesPerBucket - 1));
+      evicted = true;
+    }
+
+    WriteScope scope(bucket);
+    /* Slide all the entries down one position. */
+    memmove(&bucket->keys[1], &bucket->keys[0],
+            sizeof(Key) * (kEntriesPerBucket - 1));
+    if (kHasValues) {
+      memmove(&bucket->vals[1], &bucket->vals[0],
+              sizeof(Value) * (kEntriesPerBucket - 1));
+    }
+
+    /* Write our new entry in top of bucket. */
+    memcpy(&bucket->keys[0], &key, sizeof(Key));
+    if (kHasValues) {
+      copyValue(&bucket->vals[0], val);
+    }
+
+    return evicted ? 1 : 0;
+  }
+
+  /**
+   * Promote an entry, see FixedLruBucket::promote.
+   */
+  static void promote(EntryHandle& handle) {
+    XDCHECK(handle);
+    if (handle.pos_ != 0) {
+      Bucket* bucket = handle.bucket_;
+      const int pos = handle.pos_;
+      WriteScope scope(bucket);
+      Key winnerKey = bucket->keys[pos];
+      memmove(&bucket->keys[1], &bucket->keys[0], sizeof(Key) * pos);
+      memcpy(&bucket->keys[0], &winnerKey, sizeof(Key));
+      if (kHasValues) {
+        alignas(Value) unsigned char winnerVal[sizeof(Value)];
+        memcpy(winnerVal, &bucket->vals[pos], sizeof(Value));
+        memmove(&bucket->vals[1], &bucket->vals[0], sizeof(Value) * pos);
+        memcpy(&bucket->vals[0], winnerVal, sizeof(Value));
+      }
+      handle.pos_ = 0;
+    }
+  }
+
+  static inline bool needs_promote(EntryHandle& handle) {
+    XDCHECK(handle);
+    return needsPromote(handle.pos_);
+  }
+
+  static inline bool needsPromote(int pos) {
+    return pos > kEntriesPerBucket / 4;
+  }
+
+  /**
+   * Delete an entry, see FixedLruBucket::del.
+   */
+  static void del(EntryHandle& handle) {
+    XDCHECK(handle);
+    Bucket* bucket = handle.bucket_;
+    const int pos = handle.pos_;
+    const int after = kEntriesPerBucket - pos - 1;
+    WriteScope scope(bucket);
+    memmove(&bucket->keys[pos], &bucket->keys[pos + 1], sizeof(Key) * after);
+    bzero(&bucket->keys[kEntriesPerBucket - 1], sizeof(Key));
+    if (kHasValues) {
+      memmove(&bucket->vals[pos], &bucket->vals[pos + 1],
+              sizeof(Value) * after);
+      bzero(&bucket->vals[kEntriesPerBucket - 1], sizeof(Value));
+    }
+  }
+
+  /**
+   * Update the value of an entry, see FixedLruBucket::updateVal.
+   */
+  static void updateVal(EntryHandle& handle,
+                        const Value* val,
+                        size_t,
+                        EvictionCb /*evictionCb*/) {
+    if (kHasValues) {
+      XDCHECK(val);
+      WriteScope scope(handle.bucket_);
+      copyValue(handle.val(), val);
+    }
+  }
+
+  /**
+   * Copy an entry's value to a buffer, see FixedLruBucket::copyVal.
+   */
+  static void copyVal(Value* val, size_t*, EntryHandle& handle) {
+    XDCHECK(handle);
+    XDCHECK(val);
+    copyValue(val, handle.val());
+  }
+
+ private:
+  /* Makes the sequence number odd for the lifetime of the scope. Writers hold
+   * the bucket lock exclusively, so there is only one at a time. */
+  class WriteScope {
+   public:
+    explicit WriteScope(Bucket* bucket) : bucket_(bucket) {
+      seq_ = __atomic_load_n(&bucket_->seq, __ATOMIC_RELAXED);
+      __atomic_store_n(&bucket_->seq, seq_ + 1, __ATOMIC_RELAXED);
+      std::atomic_thread_fence(std::memory_order_release);
+    }
+    ~WriteScope() {
+      __atomic_store_n(&bucket_->seq, seq_ + 2, __ATOMIC_RELEASE);
+    }
+
+   private:
+    Bucket* bucket_;
+    uint32_t seq_;
+  };
+
+  /* Bit i of the result is set if keys[i] has the same bytes as the key. */
+  static uint32_t matchMask(const Bucket* bucket, const Key& key) {
+    const auto* keys = reinterpret_cast<const unsigned char*>(bucket->keys);
+    uint32_t mask = 0;
+    int i = 0;
+#if FOLLY_SSE >= 2
+    if constexpr (sizeof(Key) == 4 || sizeof(Key) == 8 ||
+                  sizeof(Key) == 16) {
+      constexpr int kPerLane = sizeof(__m128i) / sizeof(Key);
+      __m128i needle;
+      if constexpr (sizeof(Key) == 4) {
+        uint32_t k;
+        memcpy(&k, &key, sizeof(k));
+        needle = _mm_set1_epi32(static_cast<int>(k));
+      } else if constexpr (sizeof(Key) == 8) {
+        uint64_t k;
+        memcpy(&k, &key, sizeof(k));
+        needle = _mm_set1_epi64x(static_cast<long long>(k));
+      } else {
+        needle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&key));
+      }
+      for (; i + kPerLane <= kEntriesPerBucket; i += kPerLane) {
+        const __m128i lane = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(keys + i * sizeof(Key)));
+        // bytes of the lane that are equal to the key
+        const uint32_t eq = static_cast<uint32_t>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(lane, needle)));
+        for (int j = 0; j < kPerLane; j++) {
+          constexpr uint32_t kKeyBytes = (1u << sizeof(Key)) - 1;
+          if (((eq >> (j * sizeof(Key))) & kKeyBytes) == kKeyBytes) {
+            mask |= 1u << (i + j);
+          }
+        }
+      }
+    }
+#endif
+    for (; i < kEntriesPerBucket; i++) {
+      if (memcmp(keys + i * sizeof(Key), &key, sizeof(Key)) == 0) {
+        mask |= 1u << i;
+      }
+    }
+    return mask;
+  }
+
+  /* Position of the key in the bucket or -1. Entries are contiguous from the
+   * top, so a match past the first empty slot is an empty key. */
+  static int findPos(const Bucket* bucket, const Key& key) {
+    const uint32_t mask = matchMask(bucket, key);
+    if (mask == 0) {
+      return -1;
+    }
+    const int pos = folly::findFirstSet(mask) - 1;
+    return Key(bucket->keys[pos]).isEmpty() ? -1 : pos;
+  }
+
+  template <typename T>
+  static void copyValue(T* destPtr, const T* srcPtr) {
+    XDCHECK(destPtr != nullptr);
+    XDCHECK(srcPtr != nullptr);
+    memcpy(destPtr, srcPtr, sizeof(T));
+  }
+};
+} // namespace cachelib
+} // namespace facebook
@@ -19,6 +19,10 @@
 #include <folly/init/Init.h>
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <thread>
+#include <vector>
+
 #include "cachelib/allocator/CacheAllocator.h"
 #include "cachelib/common/TestUtils.h"
 #include "cachelib/compact_cache/allocators/TestAllocator.h"
@@ -82,6 +86,59 @@ class CompactCacheTests : public ::testing::Test {
     using CC = typename CCacheCreator<T, Buffer<93>, Buffer<13>>::type;
     CompactCacheRunBasicTests<CC>();
   }
+
+  void testSplitBucket() {
+    // keys of 4, 8 and 16 bytes are compared with SIMD, others are not
+    CompactCacheRunBasicTests<
+        typename CCacheSplitBucketCreator<T, Int>::type>();
+    CompactCacheRunBasicTests<
+        typename CCacheSplitBucketCreator<T, Int, Buffer<51>>::type>();
+    CompactCacheRunBasicTests<
+        typename CCacheSplitBucketCreator<T, Buffer<8>, Int>::type>();
+    CompactCacheRunBasicTests<
+        typename CCacheSplitBucketCreator<T, Buffer<16>, Buffer<13>>::type>();
+    CompactCacheRunBasicTests<
+        typename CCacheSplitBucketCreator<T, Buffer<17>, Int>::type>();
+  }
+
+  // Readers that do not lock the bucket never see a value torn by writers
+  // updating, promoting and evicting entries of the same bucket.
+  void testSplitBucketConcurrentReads() {
+    using CC = typename CCacheSplitBucketCreator<T, Int, Buffer<64>>::type;
+    TestSetup<CC> setup(1);
+    auto ccache = setup.getCache();
+    constexpr int kNumKeys = CC::BucketDescriptor::kEntriesPerBucket + 2;
+
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> hits{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; t++) {
+      readers.emplace_back([&, t] {
+        uint32_t i = t;
+        while (!stop) {
+          Int key = 1 + (i++ % kNumKeys);
+          Buffer<64> out;
+          auto rv = ccache->get(key, &out);
+          ASSERT_NE(CCacheReturn::ERROR, rv);
+          if (rv == CCacheReturn::FOUND) {
+            // every value is a single int repeated
+            ASSERT_EQ(Buffer<64>(*reinterpret_cast<int*>(out.value.data())),
+                      out);
+            hits++;
+          }
+        }
+      });
+    }
+    for (int i = 0; i < 200'000; i++) {
+      Buffer<64> val(i);
+      ccache->set(1 + (i % kNumKeys), &val);
+    }
+    stop = true;
+    for (auto& r : readers) {
+      r.join();
+    }
+    EXPECT_GT(hits, 0);
+  }
 };
 
 using Allocators = ::testing::Types<TestAllocator>;
@@ -99,6 +156,12 @@ TYPED_TEST(CompactCacheTests, Str2Int) { this->testStr2Int(); }
 
 TYPED_TEST(CompactCacheTests, Str2Str) { this->testStr2Str(); }
 
+TYPED_TEST(CompactCacheTests, SplitBucket) { this->testSplitBucket(); }
+
+TYPED_TEST(CompactCacheTests, SplitBucketConcurrentReads) {
+  this->testSplitBucketConcurrentReads();
+}
+
 template <typename T>
 class CompactCacheAllocatorTests : public ::testing::Test {};
 
@@ -108,7 +171,8 @@ using CompactCacheTypes = ::testing::Types<
     typename CCacheCreator<CCacheAllocator, Int, Buffer<51>>::type,
     typename CCacheCreator<CCacheAllocator, Buffer<67>>::type,
     typename CCacheCreator<CCacheAllocator, Buffer<17>, Int>::type,
-    typename CCacheCreator<CCacheAllocator, Buffer<93>, Buffer<13>>::type>;
+    typename CCacheCreator<CCacheAllocator, Buffer<93>, Buffer<13>>::type,
+    typename CCacheSplitBucketCreator<CCacheAllocator, Int, Int>::type>;
 TYPED_TEST_CASE(CompactCacheAllocatorTests, CompactCacheTypes);
 
 TYPED_TEST(CompactCacheAllocatorTests, warmroll) {
@@ -318,6 +382,56 @@ TYPED_TEST(CompactCacheAllocatorTests, resize) {
   }
 }
 
+TYPED_TEST(CompactCacheAllocatorTests, onlineResize) {
+  LruAllocator::Config config;
+  config.size = 4 * Slab::kSize;
+  config.enableCompactCache();
+  LruAllocator cacheAllocator(config);
+  auto& ccache = *cacheAllocator.addCompactCache<TypeParam>("cc", Slab::kSize);
+  const auto pid = ccache.getPoolId();
+
+  // Writers read back what they wrote while the cache grows and shrinks under
+  // them. Growing keeps every entry; shrinking may drop some, so a miss is
+  // only fine if a shrink ran in between (odd count: one is running).
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> shrinks{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&, t] {
+      typename TypeParam::Value out;
+      for (int i = 0; !stop; i++) {
+        const int key = t * 1000 + i % 100 + 1;
+        typename TypeParam::Value value(i + 1);
+        const auto shrinksBefore = shrinks.load();
+        ASSERT_NE(CCacheReturn::ERROR, ccache.set(key, &value));
+        if (ccache.get(key, &out) == CCacheReturn::FOUND) {
+          ASSERT_EQ(value, out);
+        } else {
+          ASSERT_TRUE(shrinksBefore % 2 == 1 || shrinks != shrinksBefore);
+        }
+      }
+    });
+  }
+
+  for (int i = 0; i < 10; i++) {
+    EXPECT_TRUE(cacheAllocator.growPool(pid, Slab::kSize));
+    ccache.resize();
+    EXPECT_EQ(2 * Slab::kSize, ccache.getSize());
+
+    shrinks++;
+    EXPECT_TRUE(cacheAllocator.shrinkPool(pid, Slab::kSize));
+    ccache.resize();
+    shrinks++;
+    EXPECT_EQ(1 * Slab::kSize, ccache.getSize());
+  }
+  stop = true;
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_FALSE(ccache.isResizing());
+  EXPECT_GT(ccache.getStats().resizeMigrationsSwept, 0u);
+}
+
 } // namespace tests
 } // namespace cachelib
 } // namespace facebook
@@ -25,6 +25,8 @@
 #include <gtest/gtest.h>
 
 #include <memory>
+#include <thread>
+#include <vector>
 
 #include "cachelib/compact_cache/CCacheCreator.h"
 
@@ -135,7 +137,11 @@ class CCWrapper : public CC {
  public:
   std::atomic<size_t>& numChunks() { return CC::numChunks_; }
 
-  std::atomic<size_t>& pendingNumChunks() { return CC::pendingNumChunks_; }
+  void beginOnlineResize(size_t newNumChunks) {
+    CC::beginOnlineResize(newNumChunks);
+  }
+
+  void finishOnlineResize() { CC::finishOnlineResize(); }
 };
 
 /**
@@ -297,17 +303,26 @@ static void testResizeSmaller(bool allowPromotions) {
   auto ccache = setup.getCache();
 
   ASSERT_EQ(ccache->numChunks(), wantSlabs);
-  ccache->pendingNumChunks() = 1;
-  for (int i = 1; i < 100; i++) {
+  // alone in its bucket, so it is among the entries kept by the shrink
+  ASSERT_EQ(CCacheReturn::NOTFOUND, ccache->set(1, &dummyValue));
+
+  // requests migrate the buckets they use while the resize is under way
+  ccache->beginOnlineResize(1);
+  ASSERT_TRUE(ccache->isResizing());
+  ASSERT_EQ(CCacheReturn::FOUND, ccache->get(1, &out));
+  for (int i = 2; i < 100; i++) {
     ASSERT_EQ(CCacheReturn::NOTFOUND, ccache->set(i, &dummyValue));
     ASSERT_EQ(CCacheReturn::FOUND, ccache->get(i, &out));
   }
 
-  // also find them in the new chunk from the double writing
-  ccache->numChunks() = ccache->pendingNumChunks().load();
+  // also find them once the resize is done
+  ccache->finishOnlineResize();
+  ASSERT_FALSE(ccache->isResizing());
+  ASSERT_EQ(ccache->numChunks(), 1);
   for (int i = 1; i < 100; i++) {
     ASSERT_EQ(CCacheReturn::FOUND, ccache->get(i, &out));
   }
+  EXPECT_GT(ccache->getStats().resizeMigrationsOnAccess, 0u);
 }
 
 template <typename CC>
@@ -321,15 +336,68 @@ static void testResizeLarger(bool allowPromotions) {
   auto ccache = setup.getCache();
 
   ASSERT_EQ(ccache->numChunks(), wantSlabs);
-  ccache->pendingNumChunks() = ccache->numChunks().load();
   ccache->numChunks() = 1;
-  for (int i = 1; i < 100; i++) {
+  for (int i = 1; i < 50; i++) {
+    ASSERT_EQ(CCacheReturn::NOTFOUND, ccache->set(i, &dummyValue));
+  }
+
+  // entries set before the resize are found before and after their bucket
+  // migrates, entries set during the resize where they hash with the new size
+  ccache->beginOnlineResize(wantSlabs);
+  for (int i = 1; i < 25; i++) {
+    ASSERT_EQ(CCacheReturn::FOUND, ccache->get(i, &out));
+  }
+  for (int i = 50; i < 100; i++) {
     ASSERT_EQ(CCacheReturn::NOTFOUND, ccache->set(i, &dummyValue));
     ASSERT_EQ(CCacheReturn::FOUND, ccache->get(i, &out));
   }
 
-  // also find them in the new chunk from the double writing
-  ccache->numChunks() = ccache->pendingNumChunks().load();
+  ccache->finishOnlineResize();
+  ASSERT_EQ(ccache->numChunks(), wantSlabs);
+  for (int i = 1; i < 100; i++) {
+    ASSERT_EQ(CCacheReturn::FOUND, ccache->get(i, &out));
+  }
+  const auto stats = ccache->getStats();
+  EXPECT_GT(stats.resizeMigrationsOnAccess, 0u);
+  EXPECT_GT(stats.resizeMigrationsSwept, 0u);
+}
+
+template <typename CC>
+static void testResizeConcurrentMigrations(bool allowPromotions) {
+  typename CC::Value dummyValue(0xFA);
+
+  const int wantSlabs = 15;
+  const int invertBuckets = wantSlabs * BUCKETS_PER_CHUNK;
+  TestSetup<CC> setup(invertBuckets, allowPromotions);
+  auto ccache = setup.getCache();
+
+  ccache->numChunks() = 1;
+  for (int i = 1; i < 50; i++) {
+    ASSERT_EQ(CCacheReturn::NOTFOUND, ccache->set(i, &dummyValue));
+  }
+
+  // requests of several threads migrate buckets at the same time, taking
+  // the locks of buckets that other migrations move entries into
+  ccache->beginOnlineResize(wantSlabs);
+  constexpr int kThreads = 8;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&, t] {
+      typename CC::Value out;
+      for (int i = 1; i < 50; i++) {
+        EXPECT_EQ(CCacheReturn::FOUND, ccache->get(i, &out));
+      }
+      for (int i = 50 + t; i < 100; i += kThreads) {
+        EXPECT_EQ(CCacheReturn::NOTFOUND, ccache->set(i, &dummyValue));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  ccache->finishOnlineResize();
+  typename CC::Value out;
   for (int i = 1; i < 100; i++) {
     ASSERT_EQ(CCacheReturn::FOUND, ccache->get(i, &out));
   }
@@ -630,6 +698,7 @@ static void CompactCacheRunBasicTestsUtil(bool allowPromotions) {
   testDel<CC>(allowPromotions);
   testResizeSmaller<CC>(allowPromotions);
   testResizeLarger<CC>(allowPromotions);
+  testResizeConcurrentMigrations<CC>(allowPromotions);
   testRehashSmaller<CC>(allowPromotions);
   testRehashLarger<CC>(allowPromotions);
   testEvict<CC>(allowPromotions);
@@ -0,0 +1,371 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <folly/Portability.h>
+#include <folly/lang/Bits.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wconversion"
+#include <folly/Format.h>
+#pragma GCC diagnostic pop
+
+#if FOLLY_SSE >= 2
+#include <emmintrin.h>
+#endif
+
+#include "cachelib/common/Hash.h"
+
+namespace facebook::cachelib::detail {
+// An open addressing hash table in the style of SwissTable
+// https://abseil.io/about/design/swisstables
+// Slots are split in groups of kGroupSize. Every slot has a control byte,
+// which holds 7 bits of the hash of its key when the slot is full. The
+// control bytes of a group sit next to each other, so a lookup compares the
+// control bytes of a whole group with one SIMD instruction and only reads
+// the entries whose bits match. Entries are kept apart from the control
+// bytes, and groups are probed one after the other until a group with an
+// empty slot is seen.
+//
+// The table lives in a cache item, so it never reallocates itself. Removing
+// keys leaves tombstones behind, which reclaimDeleted() clears in place.
+//
+// Value is anything trivially copyable: the address of the entry in a
+// BufferManager, or the value itself for maps with small values.
+template <typename Key, typename Value, typename Hasher = MurmurHash2>
+class FOLLY_PACK_ATTR GroupHashTable {
+  static_assert(std::is_trivially_copyable<Key>::value, "key requirements");
+  static_assert(std::is_trivially_copyable<Value>::value,
+                "value requirements");
+
+ public:
+  static constexpr uint32_t kGroupSize = 16;
+
+  struct FOLLY_PACK_ATTR Entry {
+    Key key;
+    Value value;
+  };
+
+  // @param capacity   number of maximum entries for the hash table. This is
+  //                   rounded up to a number of full groups.
+  // @return  bytes required for the hashtable to fit
+  static uint32_t computeStorageSize(size_t capacity) {
+    const size_t numSlots = numGroupsFor(capacity) * kGroupSize;
+    const auto totalSize =
+        sizeof(GroupHashTable) + numSlots * (1 + sizeof(Entry));
+    if (totalSize > std::numeric_limits<uint32_t>::max()) {
+      throw std::invalid_argument(folly::sformat(
+          "required storage size: {} is bigger than max(uint32_t)", totalSize));
+    }
+    return static_cast<uint32_t>(totalSize);
+  }
+
+  explicit GroupHashTable(size_t capacity);
+
+  // @throw std::invalid_argument if capacity is smaller than "other"
+  GroupHashTable(size_t capacity, const GroupHashTable& other);
+
+  // Find an entry to this key. Nullptr if not found.
+  const Entry* find(const Key& key) const;
+  Entry* find(const Key& key) {
+    return const_cast<Entry*>(std::as_const(*this).find(key));
+  }
+
+  // Insert this key if it is not present.
+  // @return the entry of the key and whether it was inserted. The value of
+  //         an inserted entry is Value{}.
+  // @throw std::bad_alloc if hash table is full and cannot insert
+  std::pair<Entry*, bool> emplace(const Key& key);
+
+  // Insert this key. Replace existing key if present.
+  // @return value of the replaced entry. Value{} if no existing key.
+  // @throw std::bad_alloc if hash table is full and cannot insert
+  Value insertOrReplace(const Key& key, const Value& value);
+
+  // Remove entry for this key
+  // @param removed   if not null, receives the value of the removed entry
+  // @return true on success, false on a miss
+  bool erase(const Key& key, Value* removed = nullptr);
+
+  // Remove entry for this key
+  // @return value of the removed entry, Value{} on a miss
+  Value remove(const Key& key) {
+    Value removed{};
+    erase(key, &removed);
+    return removed;
+  }
+
+  uint32_t capacity() const { return numGroups_ * kGroupSize; }
+  uint32_t numEntries() const { return numEntries_; }
+  uint32_t numDeleted() const { return numDeleted_; }
+
+  // Tombstones count against the load as they lengthen probes just as much
+  // as entries do.
+  bool overLimit() const {
+    return numEntries_ + numDeleted_ >= maxLoad(capacity());
+  }
+
+  // When the table is over its limit mostly because of tombstones, clearing
+  // them makes as much room as growing the table would, without a new item.
+  bool shouldReclaimDeleted() const {
+    return numDeleted_ > 0 && numEntries_ <= maxLoad(capacity()) / 2;
+  }
+
+  // Rehash the entries into this same table, dropping the tombstones.
+  void reclaimDeleted();
+
+  // Slot level access for iterating over the entries
+  bool isFull(uint32_t slot) const { return isFullCtrl(ctrl_[slot]); }
+  const Entry& entryAt(uint32_t slot) const { return entries()[slot]; }
+  Entry& entryAt(uint32_t slot) { return entries()[slot]; }
+
+ private:
+  // Control byte of a slot: kEmpty, kDeleted, or the 7 low bits of the hash
+  // of the key in the slot. Only the special values have the high bit set.
+  static constexpr uint8_t kEmpty = 0x80;
+  static constexpr uint8_t kDeleted = 0xFE;
+
+  static bool isFullCtrl(uint8_t ctrl) { return (ctrl & 0x80) == 0; }
+
+  // A little over 7/8 of the slots may be taken before the table grows.
+  static uint32_t maxLoad(uint32_t capacity) {
+    return capacity - capacity / 8;
+  }
+
+  static size_t numGroupsFor(size_t capacity) {
+    return std::max<size_t>(1, (capacity + kGroupSize - 1) / kGroupSize);
+  }
+
+  static uint32_t hash(const Key& key) { return Hasher{}(&key, sizeof(Key)); }
+
+  // The first group to probe, from the bits of the hash above the 7 that
+  // go to the control byte.
+  uint32_t firstGroup(uint32_t hash) const {
+    return static_cast<uint32_t>(
+        (static_cast<uint64_t>(hash >> 7) * numGroups_) >> 25);
+  }
+
+  static uint8_t ctrlOf(uint32_t hash) {
+    return static_cast<uint8_t>(hash & 0x7F);
+  }
+
+  // Bitmask of the slots of a group whose control byte is "ctrl"
+  uint32_t matchGroup(uint32_t group, uint8_t ctrl) const;
+
+  // Bitmask of the slots of a group that are empty or deleted
+  uint32_t matchFreeInGroup(uint32_t group) const;
+
+  // Find the slot of a key, or the free slot it would go to if absent.
+  // @return slot and whether the key was found, or capacity() as slot if
+  //         the key is absent and there is no free slot.
+  std::pair<uint32_t, bool> findSlot(const Key& key, uint32_t hash) const;
+
+  void setCtrl(uint32_t slot, uint8_t ctrl) { ctrl_[slot] = ctrl; }
+
+  Entry* entries() { return reinterpret_cast<Entry*>(&ctrl_[capacity()]); }
+  const Entry* entries() const {
+    return reinterpret_cast<const Entry*>(&ctrl_[capacity()]);
+  }
+
+  // BEGIN private members
+  const uint32_t numGroups_;
+  uint32_t numEntries_{0};
+  uint32_t numDeleted_{0};
+  // capacity() control bytes, followed by capacity() entries
+  uint8_t ctrl_[];
+  // END private members
+};
+
+template <typename Key, typename Value, typename Hasher>
+GroupHashTable<Key, Value, Hasher>::GroupHashTable(size_t capacity)
+    : numGroups_(static_cast<uint32_t>(numGroupsFor(capacity))) {
+  std::memset(&ctrl_[0], kEmpty, this->capacity());
+}
+
+template <typename Key, typename Value, typename Hasher>
+GroupHashTable<Key, Value, Hasher>::GroupHashTable(
+    size_t capacity, const GroupHashTable& other)
+    : GroupHashTable(capacity) {
+  if (this->capacity() < other.capacity()) {
+    throw std::invalid_argument(
+        folly::sformat("capacity too small. self: {}, other: {}",
+                       this->capacity(), other.capacity()));
+  }
+  for (uint32_t i = 0; i < other.capacity(); ++i) {
+    if (other.isFull(i)) {
+      const auto& e = other.entryAt(i);
+      insertOrReplace(e.key, e.value);
+    }
+  }
+}
+
+template <typename Key, typename Value, typename Hasher>
+uint32_t GroupHashTable<Key, Value, Hasher>::matchGroup(uint32_t group,
+                                                        uint8_t ctrl) const {
+  const uint8_t* g = &ctrl_[group * kGroupSize];
+#if FOLLY_SSE >= 2
+  const __m128i lane = _mm_loadu_si128(reinterpret_cast<const __m128i*>(g));
+  return static_cast<uint32_t>(_mm_movemask_epi8(
+      _mm_cmpeq_epi8(lane, _mm_set1_epi8(static_cast<char>(ctrl)))));
+#else
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < kGroupSize; ++i) {
+    mask |= static_cast<uint32_t>(g[i] == ctrl) << i;
+  }
+  return mask;
+#endif
+}
+
+template <typename Key, typename Value, typename Hasher>
+uint32_t GroupHashTable<Key, Value, Hasher>::matchFreeInGroup(
+    uint32_t group) const {
+  const uint8_t* g = &ctrl_[group * kGroupSize];
+#if FOLLY_SSE >= 2
+  // kEmpty and kDeleted are the only control bytes with the high bit set
+  return static_cast<uint32_t>(_mm_movemask_epi8(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(g))));
+#else
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < kGroupSize; ++i) {
+    mask |= static_cast<uint32_t>(!isFullCtrl(g[i])) << i;
+  }
+  return mask;
+#endif
+}
+
+template <typename Key, typename Value, typename Hasher>
+std::pair<uint32_t, bool> GroupHashTable<Key, Value, Hasher>::findSlot(
+    const Key& key, uint32_t hash) const {
+  const uint8_t ctrl = ctrlOf(hash);
+  uint32_t group = firstGroup(hash);
+  uint32_t freeSlot = capacity();
+  for (uint32_t probes = 0; probes < numGroups_; ++probes) {
+    for (uint32_t mask = matchGroup(group, ctrl); mask; mask &= mask - 1) {
+      const uint32_t slot = group * kGroupSize + folly::findFirstSet(mask) - 1;
+      if (entries()[slot].key == key) {
+        return {slot, true};
+      }
+    }
+
+    const uint32_t freeMask = matchFreeInGroup(group);
+    if (freeMask && freeSlot == capacity()) {
+      freeSlot = group * kGroupSize + folly::findFirstSet(freeMask) - 1;
+    }
+    // A key is never placed past a group that had an empty slot, so the
+    // probe ends at the first such group.
+    if (matchGroup(group, kEmpty)) {
+      break;
+    }
+
+    if (++group == numGroups_) {
+      group = 0;
+    }
+  }
+  return {freeSlot, false};
+}
+
+template <typename Key, typename Value, typename Hasher>
+const typename GroupHashTable<Key, Value, Hasher>::Entry*
+GroupHashTable<Key, Value, Hasher>::find(const Key& key) const {
+  const auto [slot, found] = findSlot(key, hash(key));
+  return found ? &entries()[slot] : nullptr;
+}
+
+template <typename Key, typename Value, typename Hasher>
+std::pair<typename GroupHashTable<Key, Value, Hasher>::Entry*, bool>
+GroupHashTable<Key, Value, Hasher>::emplace(const Key& key) {
+  const uint32_t h = hash(key);
+  const auto [slot, found] = findSlot(key, h);
+  if (found) {
+    return {&entries()[slot], false};
+  }
+  if (slot == capacity()) {
+    throw std::bad_alloc();
+  }
+
+  if (ctrl_[slot] == kDeleted) {
+    --numDeleted_;
+  }
+  setCtrl(slot, ctrlOf(h));
+  ++numEntries_;
+
+  auto* e = &entries()[slot];
+  std::memcpy(&e->key, &key, sizeof(Key));
+  e->value = Value{};
+  return {e, true};
+}
+
+template <typename Key, typename Value, typename Hasher>
+Value GroupHashTable<Key, Value, Hasher>::insertOrReplace(const Key& key,
+                                                          const Value& value) {
+  auto [e, inserted] = emplace(key);
+  Value old{};
+  if (!inserted) {
+    old = e->value;
+  }
+  e->value = value;
+  return old;
+}
+
+template <typename Key, typename Value, typename Hasher>
+bool GroupHashTable<Key, Value, Hasher>::erase(const Key& key,
+                                               Value* removed) {
+  const auto [slot, found] = findSlot(key, hash(key));
+  if (!found) {
+    return false;
+  }
+  if (removed) {
+    *removed = entries()[slot].value;
+  }
+
+  // Probes for other keys may have gone past this group only if it had no
+  // empty slot. If it has one, they stop here anyway and the slot can be
+  // emptied. Otherwise it has to stay a tombstone.
+  if (matchGroup(slot / kGroupSize, kEmpty)) {
+    setCtrl(slot, kEmpty);
+  } else {
+    setCtrl(slot, kDeleted);
+    ++numDeleted_;
+  }
+  --numEntries_;
+  return true;
+}
+
+template <typename Key, typename Value, typename Hasher>
+void GroupHashTable<Key, Value, Hasher>::reclaimDeleted() {
+  std::vector<Entry> live;
+  live.reserve(numEntries_);
+  for (uint32_t i = 0; i < capacity(); ++i) {
+    if (isFull(i)) {
+      live.push_back(entries()[i]);
+    }
+  }
+
+  std::memset(&ctrl_[0], kEmpty, capacity());
+  numEntries_ = 0;
+  numDeleted_ = 0;
+  for (const auto& e : live) {
+    insertOrReplace(e.key, e.value);
+  }
+}
+} // namespace facebook::cachelib::detail
@@ -23,6 +23,7 @@
 #include "cachelib/common/Iterators.h"
 #include "cachelib/datatype/Buffer.h"
 #include "cachelib/datatype/DataTypes.h"
+#include "cachelib/datatype/GroupHashTable.h"
 
 namespace facebook::cachelib {
 // Exception when cachelib::Map's index has maxed out.
@@ -264,12 +265,11 @@ uint32_t HashTable<Key, Hasher>::probeDistance(uint32_t desiredIndex,
 }
 
 // @throw std::bad_alloc if failing to allocate a new item
-template <typename K, typename C>
+template <typename K, typename C, typename HT = HashTable<K>>
 auto createHashTable(C& cache,
                      PoolId pid,
                      typename C::Item::Key key,
                      uint32_t capacity) {
-  using HT = HashTable<K>;
   using HTHandle = typename C::template TypedHandle<HT>;
 
   auto handle = cache.allocate(pid, key, HT::computeStorageSize(capacity));
@@ -280,12 +280,10 @@ auto createHashTable(C& cache,
   return HTHandle{std::move(handle)};
 }
 
-template <typename K, typename C>
-auto copyHashTable(
-    C& cache,
-    const typename C::template TypedHandle<HashTable<K>>& oldHashTable,
-    const size_t newCapacity) {
-  using HT = HashTable<K>;
+template <typename K, typename C, typename HT = HashTable<K>>
+auto copyHashTable(C& cache,
+                   const typename C::template TypedHandle<HT>& oldHashTable,
+                   const size_t newCapacity) {
   using HTHandle = typename C::template TypedHandle<HT>;
 
   // Maximum size for an item
@@ -317,31 +315,130 @@ auto copyHashTable(
   return HTHandle{std::move(newHandle)};
 }
 
-template <typename K, typename C>
-auto expandHashTable(
-    C& cache,
-    const typename C::template TypedHandle<HashTable<K>>& oldHashTable,
-    double factor = 2.0) {
+template <typename K, typename C, typename HT = HashTable<K>>
+auto expandHashTable(C& cache,
+                     const typename C::template TypedHandle<HT>& oldHashTable,
+                     double factor = 2.0) {
   XDCHECK_LT(1.0, factor) << "hash table can only grow not shrink";
   const size_t newCapacity =
       static_cast<size_t>(oldHashTable->capacity() * factor);
-  return copyHashTable<K, C>(cache, oldHashTable, newCapacity);
+  return copyHashTable<K, C, HT>(cache, oldHashTable, newCapacity);
 }
 } // namespace detail
 
-template <typename K, typename V, typename C>
+// How a cachelib::Map lays out its index. A map must always be attached to
+// with the layout it was created with.
+enum class MapIndexLayout {
+  // Robin Hood hashing over the addresses of the entries in the buffers
+  kRobinHood,
+  // SwissTable style groups probed with SIMD, over the same addresses
+  kGrouped,
+  // Grouped, with each value stored next to its key in the index instead of
+  // in the buffers. Saves the extra cache miss of a lookup and the buffers
+  // altogether. Only for small values of a fixed size.
+  kGroupedInline,
+};
+
+namespace detail {
+constexpr uint32_t kMaxInlineMapValueSize = 32;
+
+// The index type of each layout. Layouts that keep the values in buffers
+// also tell where an index entry points to.
+template <typename K, typename V, MapIndexLayout Layout>
+struct MapIndex {
+  using type = HashTable<K>;
+  static BufferAddr getAddr(const typename type::Entry& e) { return e.addr; }
+};
+
+template <typename K, typename V>
+struct MapIndex<K, V, MapIndexLayout::kGrouped> {
+  using type = GroupHashTable<K, BufferAddr>;
+  static BufferAddr getAddr(const typename type::Entry& e) { return e.value; }
+};
+
+template <typename K, typename V>
+struct MapIndex<K, V, MapIndexLayout::kGroupedInline> {
+  static_assert(!util::is_variable_length<V>::value,
+                "inline values must have a fixed size");
+  static_assert(sizeof(V) <= kMaxInlineMapValueSize,
+                "value is too big to be stored inline");
+  using type = GroupHashTable<K, V>;
+};
+
+// Iterates over the entries of a map whose values are inline in a
+// GroupHashTable. T is the key/value pair type of the map, which has the
+// same layout as the entries of the index.
+template <typename T, typename HT>
+class MapIndexIterator
+    : public IteratorFacade<MapIndexIterator<T, HT>,
+                            T,
+                            std::forward_iterator_tag> {
+ public:
+  MapIndexIterator() = default;
+  explicit MapIndexIterator(HT& ht) : ht_(&ht) { skipFreeSlots(); }
+
+  enum EndT { End };
+  MapIndexIterator(HT& ht, EndT) : ht_(&ht), slot_(ht.capacity()) {}
+
+  // @throw std::out_of_range if moving the iterator past the end
+  void increment() {
+    if (slot_ >= ht_->capacity()) {
+      throw std::out_of_range("MapIndexIterator:: Moving past the end.");
+    }
+    ++slot_;
+    skipFreeSlots();
+  }
+
+  // @throw std::runtime_error if we're dereferencing a null iterator
+  T& dereference() const {
+    if (!ht_ || slot_ >= ht_->capacity()) {
+      throw std::runtime_error(
+          "MapIndexIterator:: deferencing a null Iterator.");
+    }
+    static_assert(sizeof(T) == sizeof(typename HT::Entry),
+                  "entry layout mismatch");
+    return reinterpret_cast<T&>(ht_->entryAt(slot_));
+  }
+
+  bool equal(const MapIndexIterator& other) const {
+    return ht_ == other.ht_ && slot_ == other.slot_;
+  }
+
+ private:
+  void skipFreeSlots() {
+    while (slot_ < ht_->capacity() && !ht_->isFull(slot_)) {
+      ++slot_;
+    }
+  }
+
+  HT* ht_{nullptr};
+  uint32_t slot_{0};
+};
+} // namespace detail
+
+template <typename K,
+          typename V,
+          typename C,
+          MapIndexLayout Layout = MapIndexLayout::kRobinHood>
 class MapView;
 
 // Map data structure for cachelib
 // Key needs to be a fixed size POD.
 // Value can be variable sized, but must be POD.
-template <typename K, typename V, typename C>
+// Layout picks the index of the map, see MapIndexLayout.
+template <typename K,
+          typename V,
+          typename C,
+          MapIndexLayout Layout = MapIndexLayout::kRobinHood>
 class Map {
  public:
   using EntryKey = K;
   using EntryValue = V;
   using CacheType = C;
 
+  static constexpr bool kInlineValues =
+      Layout == MapIndexLayout::kGroupedInline;
+
   using Item = typename CacheType::Item;
   using WriteHandle = typename Item::WriteHandle;
 
@@ -467,28 +564,55 @@ class Map {
   // Convert a Map to a read-only MapView.
   // The view will become invalid as soon as any mutation happens to the
   // underlying map.
-  MapView<EntryKey, EntryValue, CacheType> toView() const;
+  MapView<EntryKey, EntryValue, CacheType, Layout> toView() const;
 
  private:
   using BufferManager = detail::BufferManager<CacheType>;
+  using Index = detail::MapIndex<EntryKey, EntryValue, Layout>;
+  using HashTable = typename Index::type;
+  using HashTableHandle = typename CacheType::template TypedHandle<HashTable>;
 
  public:
-  using Iterator = detail::BufferManagerIterator<EntryKeyValue, BufferManager>;
-  using ConstIterator =
-      detail::BufferManagerIterator<const EntryKeyValue, BufferManager>;
-
-  Iterator begin() { return Iterator{bufferManager_}; }
-  Iterator end() { return Iterator{bufferManager_, Iterator::End}; }
+  using Iterator = std::conditional_t<
+      kInlineValues,
+      detail::MapIndexIterator<EntryKeyValue, HashTable>,
+      detail::BufferManagerIterator<EntryKeyValue, BufferManager>>;
+  using ConstIterator = std::conditional_t<
+      kInlineValues,
+      detail::MapIndexIterator<const EntryKeyValue, const HashTable>,
+      detail::BufferManagerIterator<const EntryKeyValue, BufferManager>>;
+
+  Iterator begin() {
+    if constexpr (kInlineValues) {
+      return Iterator{*hashtable_};
+    } else {
+      return Iterator{bufferManager_};
+    }
+  }
+  Iterator end() {
+    if constexpr (kInlineValues) {
+      return Iterator{*hashtable_, Iterator::End};
+    } else {
+      return Iterator{bufferManager_, Iterator::End};
+    }
+  }
 
-  ConstIterator begin() const { return ConstIterator{bufferManager_}; }
+  ConstIterator begin() const {
+    if constexpr (kInlineValues) {
+      return ConstIterator{*hashtable_};
+    } else {
+      return ConstIterator{bufferManager_};
+    }
+  }
   ConstIterator end() const {
-    return ConstIterator{bufferManager_, ConstIterator::End};
+    if constexpr (kInlineValues) {
+      return ConstIterator{*hashtable_, ConstIterator::End};
+    } else {
+      return ConstIterator{bufferManager_, ConstIterator::End};
+    }
   }
 
  private:
-  using HashTable = detail::HashTable<EntryKey>;
-  using HashTableHandle = typename CacheType::template TypedHandle<HashTable>;
-
   // Create a new cachelib::Map
   // @throw std::bad_alloc if fail to allocate hashtable or storage for a map
   Map(CacheType& cache,
@@ -507,11 +631,42 @@ class Map {
   //         kReplaced otherwise.
   // @throw std::bad_alloc if failed to allocate
   InsertOrReplaceResult insertImpl(const EntryKey& key,
-                                   const EntryValue& value);
+                                   const EntryValue& value) {
+    if constexpr (kInlineValues) {
+      return insertInlineImpl(key, value);
+    } else {
+      return insertBufferedImpl(key, value);
+    }
+  }
+
+  // Insert with the value stored in the buffers
+  InsertOrReplaceResult insertBufferedImpl(const EntryKey& key,
+                                           const EntryValue& value);
+
+  // Insert with the value stored in the index
+  InsertOrReplaceResult insertInlineImpl(const EntryKey& key,
+                                         const EntryValue& value);
+
+  // Make room in the hash table once it is over its limit. Grouped indexes
+  // clear their tombstones in place when that is enough, the others are
+  // expanded into a new item.
+  // @return true if the hash table was expanded into a new item
+  // @throw std::bad_alloc if failed to allocate a bigger item for hash table
+  bool makeRoomInHashTable();
 
   // @return false if failed to allocate a bigger item for hash table
   bool expandHashTable();
 
+  // Maps with inline values have no buffers
+  static BufferManager attachBufferManager(CacheType& cache,
+                                           WriteHandle& parent) {
+    if constexpr (kInlineValues) {
+      return nullptr;
+    } else {
+      return BufferManager{cache, parent};
+    }
+  }
+
   // BEGIN private members
   CacheType* cache_{nullptr};
   HashTableHandle hashtable_{nullptr};
@@ -524,12 +679,12 @@ class Map {
   static constexpr uint32_t kDefaultNumBytes = kDefaultNumEntries * 8;
 };
 
-template <typename K, typename V, typename C>
-Map<K, V, C> Map<K, V, C>::create(CacheType& cache,
-                                  PoolId pid,
-                                  typename CacheType::Key key,
-                                  uint32_t numEntries,
-                                  uint32_t numBytes) {
+template <typename K, typename V, typename C, MapIndexLayout L>
+Map<K, V, C, L> Map<K, V, C, L>::create(CacheType& cache,
+                                        PoolId pid,
+                                        typename CacheType::Key key,
+                                        uint32_t numEntries,
+                                        uint32_t numBytes) {
   try {
     return Map{cache, pid, key, numEntries, numBytes};
   } catch (const std::bad_alloc&) {
@@ -537,40 +692,45 @@ Map<K, V, C> Map<K, V, C>::create(CacheType& cache,
   }
 }
 
-template <typename K, typename V, typename C>
-Map<K, V, C> Map<K, V, C>::fromWriteHandle(CacheType& cache,
-                                           WriteHandle handle) {
+template <typename K, typename V, typename C, MapIndexLayout L>
+Map<K, V, C, L> Map<K, V, C, L>::fromWriteHandle(CacheType& cache,
+                                                 WriteHandle handle) {
   if (!handle) {
     return nullptr;
   }
   return Map{cache, std::move(handle)};
 }
 
-template <typename K, typename V, typename C>
-Map<K, V, C>::Map(CacheType& cache,
-                  PoolId pid,
-                  typename CacheType::Key key,
-                  uint32_t numEntries,
-                  uint32_t numBytes)
+template <typename K, typename V, typename C, MapIndexLayout L>
+Map<K, V, C, L>::Map(CacheType& cache,
+                     PoolId pid,
+                     typename CacheType::Key key,
+                     uint32_t numEntries,
+                     uint32_t numBytes)
     : cache_(&cache),
-      hashtable_(detail::createHashTable<K, C>(*cache_, pid, key, numEntries)),
-      bufferManager_(
-          BufferManager{*cache_, hashtable_.viewWriteHandle(), numBytes}) {}
-
-template <typename K, typename V, typename C>
-Map<K, V, C>::Map(CacheType& cache, WriteHandle handle)
+      hashtable_(detail::createHashTable<K, C, HashTable>(
+          *cache_, pid, key, numEntries)),
+      bufferManager_(kInlineValues ? BufferManager{nullptr}
+                                   : BufferManager{*cache_,
+                                                   hashtable_.viewWriteHandle(),
+                                                   numBytes}) {}
+
+template <typename K, typename V, typename C, MapIndexLayout L>
+Map<K, V, C, L>::Map(CacheType& cache, WriteHandle handle)
     : cache_(&cache),
       hashtable_(std::move(handle)),
-      bufferManager_(*cache_, hashtable_.viewWriteHandle()) {}
+      bufferManager_(
+          attachBufferManager(*cache_, hashtable_.viewWriteHandle())) {}
 
-template <typename K, typename V, typename C>
-Map<K, V, C>::Map(Map&& other)
+template <typename K, typename V, typename C, MapIndexLayout L>
+Map<K, V, C, L>::Map(Map&& other)
     : cache_(other.cache_),
       hashtable_(std::move(other.hashtable_)),
-      bufferManager_(*cache_, hashtable_.viewWriteHandle()) {}
+      bufferManager_(
+          attachBufferManager(*cache_, hashtable_.viewWriteHandle())) {}
 
-template <typename K, typename V, typename C>
-Map<K, V, C>& Map<K, V, C>::operator=(Map&& other) {
+template <typename K, typename V, typename C, MapIndexLayout L>
+Map<K, V, C, L>& Map<K, V, C, L>::operator=(Map&& other) {
   if (this != &other) {
     this->~Map();
     new (this) Map(std::move(other));
@@ -578,41 +738,41 @@ Map<K, V, C>& Map<K, V, C>::operator=(Map&& other) {
   return *this;
 }
 
-template <typename K, typename V, typename C>
-const typename Map<K, V, C>::EntryValue* Map<K, V, C>::findImpl(
+template <typename K, typename V, typename C, MapIndexLayout L>
+const typename Map<K, V, C, L>::EntryValue* Map<K, V, C, L>::findImpl(
     const EntryKey& key) const {
   auto* entry = hashtable_->find(key);
   if (!entry) {
     return nullptr;
   }
-  return &bufferManager_.template get<EntryKeyValue>(entry->addr)->second;
+  if constexpr (kInlineValues) {
+    return &entry->value;
+  } else {
+    const auto addr = Index::getAddr(*entry);
+    return &bufferManager_.template get<EntryKeyValue>(addr)->second;
+  }
 }
 
-template <typename K, typename V, typename C>
-typename Map<K, V, C>::EntryValue* Map<K, V, C>::find(const EntryKey& key) {
+template <typename K, typename V, typename C, MapIndexLayout L>
+typename Map<K, V, C, L>::EntryValue* Map<K, V, C, L>::find(
+    const EntryKey& key) {
   return const_cast<EntryValue*>(findImpl(key));
 }
 
-template <typename K, typename V, typename C>
-const typename Map<K, V, C>::EntryValue* Map<K, V, C>::find(
+template <typename K, typename V, typename C, MapIndexLayout L>
+const typename Map<K, V, C, L>::EntryValue* Map<K, V, C, L>::find(
     const EntryKey& key) const {
   return findImpl(key);
 }
 
-template <typename K, typename V, typename C>
-typename Map<K, V, C>::InsertOrReplaceResult Map<K, V, C>::insertImpl(
-    const EntryKey& key, const EntryValue& value) {
-  bool chainCloned = false;
+template <typename K, typename V, typename C, MapIndexLayout L>
+typename Map<K, V, C, L>::InsertOrReplaceResult
+Map<K, V, C, L>::insertBufferedImpl(const EntryKey& key,
+                                    const EntryValue& value) {
   auto accessible = hashtable_.viewWriteHandle()->isAccessible();
   // We try to expand hash table if it's full, if we can't do it
   // we have to abort this insert because we may not be albe to insert
-  if (hashtable_->overLimit()) {
-    const auto res = expandHashTable();
-    if (!res) {
-      throw std::bad_alloc();
-    }
-    chainCloned = true;
-  }
+  bool chainCloned = makeRoomInHashTable();
 
   // If wasted space is more than threshold, trigger compaction
   if (bufferManager_.wastedBytesPct() > kWastedBytesPctThreshold) {
@@ -627,8 +787,8 @@ typename Map<K, V, C>::InsertOrReplaceResult Map<K, V, C>::insertImpl(
     // this insert, so that if a user holds an old handle to the Map, that
     // handle will still allow the user to access the old Map.
     if (!chainCloned) {
-      auto newHashTable = detail::copyHashTable<K, C>(*cache_, hashtable_,
-                                                      hashtable_->capacity());
+      auto newHashTable = detail::copyHashTable<K, C, HashTable>(
+          *cache_, hashtable_, hashtable_->capacity());
       if (!newHashTable) {
         throw std::bad_alloc();
       }
@@ -672,8 +832,39 @@ typename Map<K, V, C>::InsertOrReplaceResult Map<K, V, C>::insertImpl(
   return kInserted;
 }
 
-template <typename K, typename V, typename C>
-bool Map<K, V, C>::insert(const EntryKey& key, const EntryValue& value) {
+template <typename K, typename V, typename C, MapIndexLayout L>
+typename Map<K, V, C, L>::InsertOrReplaceResult
+Map<K, V, C, L>::insertInlineImpl(const EntryKey& key,
+                                  const EntryValue& value) {
+  auto accessible = hashtable_.viewWriteHandle()->isAccessible();
+  if (makeRoomInHashTable() && accessible) {
+    cache_->insertOrReplace(hashtable_.viewWriteHandle());
+  }
+
+  auto [entry, inserted] = hashtable_->emplace(key);
+  std::memcpy(&entry->value, &value, sizeof(EntryValue));
+  return inserted ? kInserted : kReplaced;
+}
+
+template <typename K, typename V, typename C, MapIndexLayout L>
+bool Map<K, V, C, L>::makeRoomInHashTable() {
+  if (!hashtable_->overLimit()) {
+    return false;
+  }
+  if constexpr (L != MapIndexLayout::kRobinHood) {
+    if (hashtable_->shouldReclaimDeleted()) {
+      hashtable_->reclaimDeleted();
+      return false;
+    }
+  }
+  if (!expandHashTable()) {
+    throw std::bad_alloc();
+  }
+  return true;
+}
+
+template <typename K, typename V, typename C, MapIndexLayout L>
+bool Map<K, V, C, L>::insert(const EntryKey& key, const EntryValue& value) {
   auto* entry = hashtable_->find(key);
   if (entry) {
     return false;
@@ -682,24 +873,28 @@ bool Map<K, V, C>::insert(const EntryKey& key, const EntryValue& value) {
   return true;
 }
 
-template <typename K, typename V, typename C>
-typename Map<K, V, C>::InsertOrReplaceResult Map<K, V, C>::insertOrReplace(
-    const EntryKey& key, const EntryValue& value) {
+template <typename K, typename V, typename C, MapIndexLayout L>
+typename Map<K, V, C, L>::InsertOrReplaceResult
+Map<K, V, C, L>::insertOrReplace(const EntryKey& key, const EntryValue& value) {
   return insertImpl(key, value);
 }
 
-template <typename K, typename V, typename C>
-bool Map<K, V, C>::erase(const EntryKey& key) {
-  auto addr = hashtable_->remove(key);
-  if (addr) {
-    bufferManager_.remove(addr);
-    return true;
+template <typename K, typename V, typename C, MapIndexLayout L>
+bool Map<K, V, C, L>::erase(const EntryKey& key) {
+  if constexpr (kInlineValues) {
+    return hashtable_->erase(key);
+  } else {
+    auto addr = hashtable_->remove(key);
+    if (addr) {
+      bufferManager_.remove(addr);
+      return true;
+    }
+    return false;
   }
-  return false;
 }
 
-template <typename K, typename V, typename C>
-size_t Map<K, V, C>::sizeInBytes() const {
+template <typename K, typename V, typename C, MapIndexLayout L>
+size_t Map<K, V, C, L>::sizeInBytes() const {
   size_t numBytes = 0;
 
   const WriteHandle& parent = hashtable_.viewWriteHandle();
@@ -712,35 +907,45 @@ size_t Map<K, V, C>::sizeInBytes() const {
   return numBytes;
 }
 
-template <typename K, typename V, typename C>
-void Map<K, V, C>::compact() {
-  // The idea below is first we compact all allocations in buffer manager.
-  // Afterwards, we iterate through each allocation in buffer manager,
-  // and for each allocation, we replace its key/value in the hashtable
-  // with its new buffer address.
-  bufferManager_.compact();
-  for (auto itr = begin(), endItr = end(); itr != endItr; ++itr) {
-    detail::BufferAddr oldAddr;
-    try {
-      oldAddr = hashtable_->insertOrReplace(itr->first, itr.getAsBufferAddr());
-    } catch (const std::bad_alloc&) {
-      throw std::runtime_error(
-          "hashtable cannot have insufficient space during a compaction");
-    }
-    if (!oldAddr) {
-      auto key = itr->first;
-      throw std::runtime_error(folly::sformat(
-          "old entry is missing, this should never happen. key: {}", key));
+template <typename K, typename V, typename C, MapIndexLayout L>
+void Map<K, V, C, L>::compact() {
+  if constexpr (kInlineValues) {
+    // values are in the index, there are no buffers to compact
+  } else {
+    // The idea below is first we compact all allocations in buffer manager.
+    // Afterwards, we iterate through each allocation in buffer manager,
+    // and for each allocation, we replace its key/value in the hashtable
+    // with its new buffer address.
+    bufferManager_.compact();
+    for (auto itr = begin(), endItr = end(); itr != endItr; ++itr) {
+      detail::BufferAddr oldAddr;
+      try {
+        oldAddr =
+            hashtable_->insertOrReplace(itr->first, itr.getAsBufferAddr());
+      } catch (const std::bad_alloc&) {
+        throw std::runtime_error(
+            "hashtable cannot have insufficient space during a compaction");
+      }
+      if (!oldAddr) {
+        auto key = itr->first;
+        throw std::runtime_error(folly::sformat(
+            "old entry is missing, this should never happen. key: {}", key));
+      }
     }
   }
 }
 
-template <typename K, typename V, typename C>
-bool Map<K, V, C>::expandHashTable() {
-  auto newHashTable = detail::expandHashTable<K, C>(*cache_, hashtable_);
+template <typename K, typename V, typename C, MapIndexLayout L>
+bool Map<K, V, C, L>::expandHashTable() {
+  auto newHashTable =
+      detail::expandHashTable<K, C, HashTable>(*cache_, hashtable_);
   if (!newHashTable) {
     return false;
   }
+  if constexpr (kInlineValues) {
+    hashtable_ = std::move(newHashTable);
+    return true;
+  }
 
   // Clone the buffers (chaind items) when expanding hash table, so that if a
   // user holds an old handle to the old hashtable, it will still be valid and
@@ -755,10 +960,10 @@ bool Map<K, V, C>::expandHashTable() {
   return true;
 }
 
-template <typename K, typename V, typename C>
-MapView<K, V, C> Map<K, V, C>::toView() const {
+template <typename K, typename V, typename C, MapIndexLayout L>
+MapView<K, V, C, L> Map<K, V, C, L>::toView() const {
   auto& parent = hashtable_.viewWriteHandle();
   auto allocs = cache_->viewAsChainedAllocs(parent);
-  return MapView<K, V, C>{*parent, allocs.getChain()};
+  return MapView<K, V, C, L>{*parent, allocs.getChain()};
 }
 } // namespace facebook::cachelib
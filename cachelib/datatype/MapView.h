@@ -31,7 +31,8 @@ namespace facebook::cachelib {
 // 2. We do not guarantee "MapView" is synced with "Map",i.e. a
 //    MapView is only valid when the corresponding Map is not mutated. The user
 //    is responsible for creating a new view if such mutation occurs.
-template <typename K, typename V, typename C>
+// 3. Layout must be the one of the Map the item belongs to.
+template <typename K, typename V, typename C, MapIndexLayout Layout>
 class MapView {
  public:
   using EntryKey = K;
@@ -40,7 +41,7 @@ class MapView {
 
   using Item = typename CacheType::Item;
   using ChainedItemIter = typename CacheType::ChainedItemIter;
-  using Map = Map<K, V, C>;
+  using Map = Map<K, V, C, Layout>;
   using EntryKeyValue = typename Map::EntryKeyValue;
 
   // Constructor
@@ -68,12 +69,13 @@ class MapView {
 
   using BufferAddr = detail::BufferAddr;
   using Buffer = detail::Buffer;
-  class Iterator : public detail::IteratorFacade<Iterator,
-                                                 const EntryKeyValue,
-                                                 std::forward_iterator_tag> {
+  class BufferIterator
+      : public detail::IteratorFacade<BufferIterator,
+                                      const EntryKeyValue,
+                                      std::forward_iterator_tag> {
    public:
-    Iterator() = default;
-    explicit Iterator(const std::vector<const Buffer*>& buffers)
+    BufferIterator() = default;
+    explicit BufferIterator(const std::vector<const Buffer*>& buffers)
         : buffers_(&buffers),
           curr_(const_cast<Buffer*>(buffers_->at(index_))->begin()) {
       if (curr_ == Buffer::Iterator()) {
@@ -84,7 +86,7 @@ class MapView {
     }
 
     enum EndT { End };
-    Iterator(const std::vector<const Buffer*>& buffers, EndT)
+    BufferIterator(const std::vector<const Buffer*>& buffers, EndT)
         : buffers_(&buffers), index_(buffers_->size()) {}
 
     BufferAddr getAsBufferAddr() const {
@@ -116,7 +118,7 @@ class MapView {
       return reinterpret_cast<const EntryKeyValue&>(curr_.dereference());
     }
 
-    bool equal(const Iterator& other) const {
+    bool equal(const BufferIterator& other) const {
       return index_ == other.index_ && buffers_ == other.buffers_ &&
              curr_ == other.curr_;
     }
@@ -137,12 +139,32 @@ class MapView {
     Buffer::Iterator curr_{};
   };
 
+  using Index = detail::MapIndex<EntryKey, EntryValue, Layout>;
+  using HashTable = typename Index::type;
+
+  // Maps with inline values are iterated over through their index
+  using Iterator = std::conditional_t<
+      Map::kInlineValues,
+      detail::MapIndexIterator<const EntryKeyValue, const HashTable>,
+      BufferIterator>;
+
   // These iterators are only valid when this MapView object is valid
-  Iterator begin() const { return Iterator{buffers_}; }
-  Iterator end() const { return Iterator{buffers_, Iterator::End}; }
+  Iterator begin() const {
+    if constexpr (Map::kInlineValues) {
+      return Iterator{*hashtable_};
+    } else {
+      return Iterator{buffers_};
+    }
+  }
+  Iterator end() const {
+    if constexpr (Map::kInlineValues) {
+      return Iterator{*hashtable_, Iterator::End};
+    } else {
+      return Iterator{buffers_, Iterator::End};
+    }
+  }
 
  private:
-  using HashTable = detail::HashTable<EntryKey>;
 
   // Get the keyValuEntry stored at the corresponding itemOffset and byteOffset
   // @throw std::invalid_argument on addr being nullptr
@@ -159,8 +181,11 @@ class MapView {
 // functionalities (e.g. lookup, iteration).
 // Different from MapView, ReadOnlyMap DOES own the underlying data because it
 // contains a ReadHandle to hold the ownership.
-template <typename K, typename V, typename C>
-class ReadOnlyMap : public MapView<K, V, C> {
+template <typename K,
+          typename V,
+          typename C,
+          MapIndexLayout Layout = MapIndexLayout::kRobinHood>
+class ReadOnlyMap : public MapView<K, V, C, Layout> {
  public:
   using EntryKey = K;
   using EntryValue = V;
@@ -168,7 +193,7 @@ class ReadOnlyMap : public MapView<K, V, C> {
 
   using Item = typename CacheType::Item;
   using ReadHandle = typename Item::ReadHandle;
-  using MapView = MapView<K, V, C>;
+  using MapView = MapView<K, V, C, Layout>;
 
   // Convert a read handle to a cachelib::ReadOnlyMap
   // @param cache   cache allocator to allocate from
@@ -199,9 +224,9 @@ class ReadOnlyMap : public MapView<K, V, C> {
   ReadHandle handle_;
 };
 
-template <typename K, typename V, typename C>
-MapView<K, V, C>::MapView(const Item& parent,
-                          const folly::Range<ChainedItemIter>& children) {
+template <typename K, typename V, typename C, MapIndexLayout L>
+MapView<K, V, C, L>::MapView(const Item& parent,
+                             const folly::Range<ChainedItemIter>& children) {
   hashtable_ = reinterpret_cast<const HashTable*>(parent.getMemory());
   numBytes_ += parent.getSize();
   for (auto& item : children) {
@@ -213,14 +238,14 @@ MapView<K, V, C>::MapView(const Item& parent,
   std::reverse(buffers_.begin(), buffers_.end());
 }
 
-template <typename K, typename V, typename C>
-MapView<K, V, C>::MapView(MapView&& other) noexcept
+template <typename K, typename V, typename C, MapIndexLayout L>
+MapView<K, V, C, L>::MapView(MapView&& other) noexcept
     : hashtable_(other.hashtable_),
       buffers_(std::move(other.buffers_)),
       numBytes_(other.numBytes_) {}
 
-template <typename K, typename V, typename C>
-MapView<K, V, C>& MapView<K, V, C>::operator=(MapView&& other) noexcept {
+template <typename K, typename V, typename C, MapIndexLayout L>
+MapView<K, V, C, L>& MapView<K, V, C, L>::operator=(MapView&& other) noexcept {
   if (this != &other) {
     this->~MapView();
     new (this) MapView(std::move(other));
@@ -228,28 +253,32 @@ MapView<K, V, C>& MapView<K, V, C>::operator=(MapView&& other) noexcept {
   return *this;
 }
 
-template <typename K, typename V, typename C>
-size_t MapView<K, V, C>::sizeInBytes() const {
+template <typename K, typename V, typename C, MapIndexLayout L>
+size_t MapView<K, V, C, L>::sizeInBytes() const {
   return numBytes_;
 }
 
-template <typename K, typename V, typename C>
-uint32_t MapView<K, V, C>::size() const {
+template <typename K, typename V, typename C, MapIndexLayout L>
+uint32_t MapView<K, V, C, L>::size() const {
   return hashtable_->numEntries();
 }
 
-template <typename K, typename V, typename C>
-const typename MapView<K, V, C>::EntryValue* MapView<K, V, C>::find(
+template <typename K, typename V, typename C, MapIndexLayout L>
+const typename MapView<K, V, C, L>::EntryValue* MapView<K, V, C, L>::find(
     const EntryKey& key) const {
   auto* entry = hashtable_->find(key);
   if (!entry) {
     return nullptr;
   }
-  return &get(entry->addr)->second;
+  if constexpr (Map::kInlineValues) {
+    return &entry->value;
+  } else {
+    return &get(Index::getAddr(*entry))->second;
+  }
 }
 
-template <typename K, typename V, typename C>
-const typename MapView<K, V, C>::EntryKeyValue* MapView<K, V, C>::get(
+template <typename K, typename V, typename C, MapIndexLayout L>
+const typename MapView<K, V, C, L>::EntryKeyValue* MapView<K, V, C, L>::get(
     BufferAddr addr) const {
   if (!addr) {
     throw std::invalid_argument("cannot get null address");
@@ -262,12 +291,12 @@ const typename MapView<K, V, C>::EntryKeyValue* MapView<K, V, C>::get(
   return reinterpret_cast<const EntryKeyValue*>(buffer->getData(byteOffset));
 }
 
-template <typename K, typename V, typename C>
-ReadOnlyMap<K, V, C>::ReadOnlyMap(ReadOnlyMap&& other) noexcept
+template <typename K, typename V, typename C, MapIndexLayout L>
+ReadOnlyMap<K, V, C, L>::ReadOnlyMap(ReadOnlyMap&& other) noexcept
     : MapView(std::move(other)), handle_(std::move(other.handle_)) {}
 
-template <typename K, typename V, typename C>
-ReadOnlyMap<K, V, C>& ReadOnlyMap<K, V, C>::operator=(
+template <typename K, typename V, typename C, MapIndexLayout L>
+ReadOnlyMap<K, V, C, L>& ReadOnlyMap<K, V, C, L>::operator=(
     ReadOnlyMap&& other) noexcept {
   if (this != &other) {
     this->~ReadOnlyMap();
@@ -276,17 +305,17 @@ ReadOnlyMap<K, V, C>& ReadOnlyMap<K, V, C>::operator=(
   return *this;
 }
 
-template <typename K, typename V, typename C>
-ReadOnlyMap<K, V, C> ReadOnlyMap<K, V, C>::fromReadHandle(CacheType& cache,
-                                                          ReadHandle handle) {
+template <typename K, typename V, typename C, MapIndexLayout L>
+ReadOnlyMap<K, V, C, L> ReadOnlyMap<K, V, C, L>::fromReadHandle(
+    CacheType& cache, ReadHandle handle) {
   if (!handle) {
     return {nullptr};
   }
   return ReadOnlyMap(cache, std::move(handle));
 }
 
-template <typename K, typename V, typename C>
-ReadOnlyMap<K, V, C>::ReadOnlyMap(CacheType& cache, ReadHandle handle)
+template <typename K, typename V, typename C, MapIndexLayout L>
+ReadOnlyMap<K, V, C, L>::ReadOnlyMap(CacheType& cache, ReadHandle handle)
     : MapView(*handle, cache.viewAsChainedAllocsRange(*handle)),
       handle_(std::move(handle)) {}
 } // namespace facebook::cachelib
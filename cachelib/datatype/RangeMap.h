@@ -16,7 +16,10 @@
 
 #pragma once
 
+#include <algorithm>
 #include <limits>
+#include <utility>
+#include <vector>
 
 #include "cachelib/allocator/TypedHandle.h"
 #include "cachelib/common/Exceptions.h"
@@ -30,7 +33,11 @@ namespace detail {
 template <typename Key>
 class FOLLY_PACK_ATTR BinaryIndex;
 
-template <typename Key, typename Value, typename BufManager>
+// Readahead is how many entries ahead the iterator prefetches the values of.
+template <typename Key,
+          typename Value,
+          typename BufManager,
+          uint32_t Readahead = 0>
 class BinaryIndexIterator;
 } // namespace detail
 
@@ -57,6 +64,18 @@ class RangeMap {
                                                const EntryKeyValue,
                                                detail::BufferManager<Cache>>;
 
+  // Iterator that prefetches the values of the entries a few positions ahead,
+  // so that a scan doesn't stall on each value in the chained items.
+  static constexpr uint32_t kReadaheadEntries = 4;
+  using ReadaheadItr =
+      detail::BinaryIndexIterator<EntryKey,
+                                  const EntryKeyValue,
+                                  detail::BufferManager<Cache>,
+                                  kReadaheadEntries>;
+
+  // Inclusive range of keys [first, second]
+  using KeyRange = std::pair<EntryKey, EntryKey>;
+
   // Create a new cachelib::RangeMap
   // @param cache   cache allocator to allocate from
   // @param pid     pool where we'll allocate the map from
@@ -129,6 +148,14 @@ class RangeMap {
   folly::Range<ConstItr> rangeLookupApproximate(const EntryKey& key1,
                                                 const EntryKey& key2) const;
 
+  // Look up several ranges in one call. Like rangeLookupApproximate, the
+  // bounds of a range don't need to be in the map. Overlapping ranges are
+  // merged and the ranges are searched in key order, each search starting
+  // where the previous one ended. Returns the merged ranges that aren't
+  // empty, in key order.
+  std::vector<folly::Range<ReadaheadItr>> rangeLookupBatch(
+      folly::Range<const KeyRange*> ranges) const;
+
   // Iterate through the map in a sorted order via mutable or const.
   Itr begin();
   Itr end();
@@ -236,6 +263,12 @@ class FOLLY_PACK_ATTR BinaryIndex {
   Entry* lookupLowerbound(Key key);
   const Entry* lookupLowerbound(Key key) const;
 
+  // Same as above, but only search the entries from "from" onwards.
+  const Entry* lookupLowerbound(Key key, const Entry* from) const;
+
+  // Return the first entry greater than key, searching from "from" onwards.
+  const Entry* lookupUpperbound(Key key, const Entry* from) const;
+
   // Return old addr if exists.
   BufferAddr insertOrReplace(Key key, BufferAddr addr);
 
@@ -266,8 +299,21 @@ class FOLLY_PACK_ATTR BinaryIndex {
  private:
   static constexpr double kCapacityOverlimitRatio = 0.5;
 
+  // Searches narrow arithmetic keys down to a block of this many entries by
+  // binary search and then scan the block. The scan has no branches to
+  // mispredict and the block spans just a few cache lines.
+  static constexpr uint32_t kSearchBlockSize =
+      std::is_arithmetic<Key>::value ? 16 : 1;
+
   explicit BinaryIndex(uint32_t capacity);
 
+  // Return the first entry in [first, last) for which isBefore is false.
+  // The entries for which it is true must all precede the others.
+  template <typename IsBefore>
+  static const Entry* partitionPoint(const Entry* first,
+                                     const Entry* last,
+                                     IsBefore isBefore);
+
   void insertInternal(Key key, BufferAddr addr);
 
   uint32_t capacity_{};
@@ -277,11 +323,15 @@ class FOLLY_PACK_ATTR BinaryIndex {
 
 // An interator interface that can return a custom Value type. The iterators
 // are sorted according to their order in BinaryIndex.
-template <typename Key, typename Value, typename BufManager>
+template <typename Key,
+          typename Value,
+          typename BufManager,
+          uint32_t Readahead>
 class BinaryIndexIterator
-    : public IteratorFacade<BinaryIndexIterator<Key, Value, BufManager>,
-                            Value,
-                            std::forward_iterator_tag> {
+    : public IteratorFacade<
+          BinaryIndexIterator<Key, Value, BufManager, Readahead>,
+          Value,
+          std::forward_iterator_tag> {
  public:
   BinaryIndexIterator() = default;
   BinaryIndexIterator(const BufManager* manager,
@@ -290,16 +340,22 @@ class BinaryIndexIterator
       : entry_{entry}, index_{index}, manager_{manager} {
     if (index_ != nullptr && entry_ != index_->end()) {
       value_ = manager_->template get<Value>(entry_->addr);
+      for (uint32_t i = 1; i <= Readahead; i++) {
+        prefetchValue(i);
+      }
     }
   }
 
-  BinaryIndexIterator<Key, const Value, BufManager> toConstItr();
+  BinaryIndexIterator<Key, const Value, BufManager, Readahead> toConstItr();
 
   Value& dereference() const;
   void increment();
   bool equal(const BinaryIndexIterator& other) const;
 
  private:
+  // Prefetch the value of the entry this many positions ahead, if any
+  void prefetchValue(uint32_t ahead) const;
+
   const typename BinaryIndex<Key>::Entry* entry_{nullptr};
   Value* value_{nullptr};
 
@@ -353,9 +409,45 @@ typename BinaryIndex<Key>::Entry* BinaryIndex<Key>::lookupLowerbound(Key key) {
 template <typename Key>
 const typename BinaryIndex<Key>::Entry* BinaryIndex<Key>::lookupLowerbound(
     Key key) const {
-  return std::lower_bound(
-      entries_, entries_ + numEntries_, key,
-      [](const Entry& e, const Key& k) { return e.key < k; });
+  return lookupLowerbound(key, begin());
+}
+
+template <typename Key>
+const typename BinaryIndex<Key>::Entry* BinaryIndex<Key>::lookupLowerbound(
+    Key key, const Entry* from) const {
+  XDCHECK_GE(reinterpret_cast<uintptr_t>(from),
+             reinterpret_cast<uintptr_t>(begin()));
+  return partitionPoint(from, end(),
+                        [key](const Entry& e) { return e.key < key; });
+}
+
+template <typename Key>
+const typename BinaryIndex<Key>::Entry* BinaryIndex<Key>::lookupUpperbound(
+    Key key, const Entry* from) const {
+  XDCHECK_GE(reinterpret_cast<uintptr_t>(from),
+             reinterpret_cast<uintptr_t>(begin()));
+  return partitionPoint(from, end(),
+                        [key](const Entry& e) { return !(key < e.key); });
+}
+
+template <typename Key>
+template <typename IsBefore>
+const typename BinaryIndex<Key>::Entry* BinaryIndex<Key>::partitionPoint(
+    const Entry* first, const Entry* last, IsBefore isBefore) {
+  // The partition point is always within [first, first + n]. Each step
+  // halves n without a branch on the comparison, so it compiles into a
+  // conditional move.
+  size_t n = last - first;
+  while (n > kSearchBlockSize) {
+    const size_t half = n / 2;
+    first = isBefore(first[half - 1]) ? first + half : first;
+    n -= half;
+  }
+  size_t numBefore = 0;
+  for (size_t i = 0; i < n; i++) {
+    numBefore += isBefore(first[i]) ? 1 : 0;
+  }
+  return first + numBefore;
 }
 
 template <typename Key>
@@ -440,19 +532,41 @@ void BinaryIndex<Key>::insertInternal(Key key, BufferAddr addr) {
   *res = Entry{key, addr};
 }
 
-template <typename Key, typename Value, typename BufManager>
-BinaryIndexIterator<Key, const Value, BufManager>
-BinaryIndexIterator<Key, Value, BufManager>::toConstItr() {
+template <typename Key,
+          typename Value,
+          typename BufManager,
+          uint32_t Readahead>
+BinaryIndexIterator<Key, const Value, BufManager, Readahead>
+BinaryIndexIterator<Key, Value, BufManager, Readahead>::toConstItr() {
   return {manager_, index_, entry_};
 }
 
-template <typename Key, typename Value, typename BufManager>
-Value& BinaryIndexIterator<Key, Value, BufManager>::dereference() const {
+template <typename Key,
+          typename Value,
+          typename BufManager,
+          uint32_t Readahead>
+Value& BinaryIndexIterator<Key, Value, BufManager, Readahead>::dereference()
+    const {
   return *value_;
 }
 
-template <typename Key, typename Value, typename BufManager>
-void BinaryIndexIterator<Key, Value, BufManager>::increment() {
+template <typename Key,
+          typename Value,
+          typename BufManager,
+          uint32_t Readahead>
+void BinaryIndexIterator<Key, Value, BufManager, Readahead>::prefetchValue(
+    uint32_t ahead) const {
+  if (index_->end() - entry_ > static_cast<std::ptrdiff_t>(ahead)) {
+    __builtin_prefetch(manager_->template get<Value>(entry_[ahead].addr),
+                       /* read */ 0, /* locality hint */ 3);
+  }
+}
+
+template <typename Key,
+          typename Value,
+          typename BufManager,
+          uint32_t Readahead>
+void BinaryIndexIterator<Key, Value, BufManager, Readahead>::increment() {
   XDCHECK_NE(reinterpret_cast<uintptr_t>(nullptr),
              reinterpret_cast<uintptr_t>(index_));
   entry_++;
@@ -464,11 +578,17 @@ void BinaryIndexIterator<Key, Value, BufManager>::increment() {
     value_ = nullptr;
   } else {
     value_ = manager_->template get<Value>(entry_->addr);
+    if (Readahead > 0) {
+      prefetchValue(Readahead);
+    }
   }
 }
 
-template <typename Key, typename Value, typename BufManager>
-bool BinaryIndexIterator<Key, Value, BufManager>::equal(
+template <typename Key,
+          typename Value,
+          typename BufManager,
+          uint32_t Readahead>
+bool BinaryIndexIterator<Key, Value, BufManager, Readahead>::equal(
     const BinaryIndexIterator& other) const {
   return index_ == other.index_ && entry_ == other.entry_ &&
          value_ == other.value_ && manager_ == other.manager_;
@@ -649,6 +769,40 @@ RangeMap<K, V, C>::rangeLookupApproximate(const EntryKey& key1,
   return {mutableRange.begin().toConstItr(), mutableRange.end().toConstItr()};
 }
 
+template <typename K, typename V, typename C>
+std::vector<folly::Range<typename RangeMap<K, V, C>::ReadaheadItr>>
+RangeMap<K, V, C>::rangeLookupBatch(
+    folly::Range<const KeyRange*> ranges) const {
+  std::vector<KeyRange> sorted(ranges.begin(), ranges.end());
+  std::sort(sorted.begin(), sorted.end(),
+            [](const KeyRange& a, const KeyRange& b) {
+              return a.first < b.first;
+            });
+
+  auto* index = handle_->template getMemoryAs<BinaryIndex>();
+  std::vector<folly::Range<ReadaheadItr>> result;
+  const auto* from = index->begin();
+  for (size_t i = 0; i < sorted.size();) {
+    const auto lo = sorted[i].first;
+    auto hi = sorted[i].second;
+    XDCHECK(!(hi < lo));
+    for (++i; i < sorted.size() && !(hi < sorted[i].first); ++i) {
+      if (hi < sorted[i].second) {
+        hi = sorted[i].second;
+      }
+    }
+
+    const auto* first = index->lookupLowerbound(lo, from);
+    const auto* last = index->lookupUpperbound(hi, first);
+    if (first != last) {
+      result.emplace_back(ReadaheadItr{&bufferManager_, index, first},
+                          ReadaheadItr{&bufferManager_, index, last});
+    }
+    from = last;
+  }
+  return result;
+}
+
 template <typename K, typename V, typename C>
 typename RangeMap<K, V, C>::Itr RangeMap<K, V, C>::begin() {
   auto* index = handle_->template getMemoryAs<BinaryIndex>();
@@ -22,6 +22,7 @@
 #include "cachelib/allocator/tests/TestBase.h"
 #include "cachelib/datatype/Buffer.h"
 #include "cachelib/datatype/Map.h"
+#include "cachelib/datatype/MapView.h"
 #include "cachelib/datatype/tests/DataTypeTest.h"
 
 namespace facebook {
@@ -311,6 +312,130 @@ TEST(HashTable, Rehash) {
   ASSERT_THROW(new (buffer3.get()) HTable(50, *ht1), std::invalid_argument);
 }
 
+TEST(GroupHashTable, Basic) {
+  using HTable = detail::GroupHashTable<uint64_t, detail::BufferAddr>;
+  auto buffer = std::make_unique<uint8_t[]>(HTable::computeStorageSize(100));
+  HTable* ht = new (buffer.get()) HTable(100);
+  // rounded up to full groups
+  ASSERT_EQ(112, ht->capacity());
+
+  const uint64_t key = 1234;
+  const detail::BufferAddr dummyAddr{1 /* item offset */, 0 /* byte offset */};
+
+  ASSERT_EQ(nullptr, ht->find(key));
+  ASSERT_EQ(nullptr, ht->insertOrReplace(key, dummyAddr));
+  ASSERT_EQ(1, ht->numEntries());
+  auto* e = ht->find(key);
+  ASSERT_NE(nullptr, e);
+  ASSERT_EQ(dummyAddr, e->value);
+
+  ASSERT_EQ(dummyAddr, ht->insertOrReplace(key, detail::BufferAddr{1, 100}));
+  ASSERT_EQ(1, ht->numEntries());
+
+  auto [e2, inserted] = ht->emplace(key);
+  ASSERT_FALSE(inserted);
+  ASSERT_EQ(e, e2);
+
+  ASSERT_EQ((detail::BufferAddr{1, 100}), ht->remove(key));
+  ASSERT_EQ(nullptr, ht->find(key));
+  ASSERT_EQ(nullptr, ht->remove(key));
+  ASSERT_EQ(0, ht->numEntries());
+}
+
+TEST(GroupHashTable, ManyKeys) {
+  using HTable = detail::GroupHashTable<uint64_t, uint64_t>;
+  auto buffer = std::make_unique<uint8_t[]>(HTable::computeStorageSize(1000));
+  HTable* ht = new (buffer.get()) HTable(1000);
+
+  for (uint64_t key = 0; key < 800; ++key) {
+    ASSERT_EQ(0, ht->insertOrReplace(key, key + 1));
+  }
+  ASSERT_EQ(800, ht->numEntries());
+  for (uint64_t key = 0; key < 800; ++key) {
+    auto* e = ht->find(key);
+    ASSERT_NE(nullptr, e);
+    ASSERT_EQ(key + 1, e->value);
+  }
+  for (uint64_t key = 800; key < 1600; ++key) {
+    ASSERT_EQ(nullptr, ht->find(key));
+  }
+
+  uint64_t removed = 0;
+  for (uint64_t key = 0; key < 800; key += 2) {
+    ASSERT_TRUE(ht->erase(key, &removed));
+    ASSERT_EQ(key + 1, removed);
+    ASSERT_FALSE(ht->erase(key));
+  }
+  ASSERT_EQ(400, ht->numEntries());
+  for (uint64_t key = 0; key < 800; ++key) {
+    ASSERT_EQ(key % 2 == 1, ht->find(key) != nullptr);
+  }
+
+  uint32_t numFull = 0;
+  for (uint32_t slot = 0; slot < ht->capacity(); ++slot) {
+    if (ht->isFull(slot)) {
+      ASSERT_EQ(1, ht->entryAt(slot).key % 2);
+      ++numFull;
+    }
+  }
+  ASSERT_EQ(400, numFull);
+}
+
+TEST(GroupHashTable, ReclaimDeleted) {
+  using HTable = detail::GroupHashTable<uint64_t, uint64_t>;
+  auto buffer = std::make_unique<uint8_t[]>(HTable::computeStorageSize(16));
+  HTable* ht = new (buffer.get()) HTable(16);
+  ASSERT_EQ(16, ht->capacity());
+
+  // A single group. Once it is full, erasing leaves tombstones behind.
+  for (uint64_t key = 0; key < 16; ++key) {
+    ASSERT_EQ(0, ht->insertOrReplace(key, key));
+  }
+  ASSERT_TRUE(ht->overLimit());
+  ASSERT_THROW(ht->insertOrReplace(16, 16), std::bad_alloc);
+
+  for (uint64_t key = 0; key < 10; ++key) {
+    ASSERT_TRUE(ht->erase(key));
+  }
+  ASSERT_EQ(6, ht->numEntries());
+  ASSERT_EQ(10, ht->numDeleted());
+  ASSERT_TRUE(ht->overLimit());
+  ASSERT_TRUE(ht->shouldReclaimDeleted());
+
+  ht->reclaimDeleted();
+  ASSERT_EQ(6, ht->numEntries());
+  ASSERT_EQ(0, ht->numDeleted());
+  ASSERT_FALSE(ht->overLimit());
+  for (uint64_t key = 0; key < 16; ++key) {
+    auto* e = ht->find(key);
+    ASSERT_EQ(key >= 10, e != nullptr);
+    if (e) {
+      ASSERT_EQ(key, e->value);
+    }
+  }
+}
+
+TEST(GroupHashTable, Rehash) {
+  using HTable = detail::GroupHashTable<uint64_t, uint64_t>;
+
+  auto buffer1 = std::make_unique<uint8_t[]>(HTable::computeStorageSize(128));
+  HTable* ht1 = new (buffer1.get()) HTable(128);
+  for (uint64_t i = 0; i < 100; ++i) {
+    ASSERT_EQ(0, ht1->insertOrReplace(i, i));
+  }
+
+  auto buffer2 = std::make_unique<uint8_t[]>(HTable::computeStorageSize(256));
+  ASSERT_NO_THROW(new (buffer2.get()) HTable(256, *ht1));
+  auto* ht2 = reinterpret_cast<HTable*>(buffer2.get());
+  ASSERT_EQ(100, ht2->numEntries());
+  for (uint64_t i = 0; i < 100; ++i) {
+    ASSERT_NE(nullptr, ht2->find(i));
+  }
+
+  auto buffer3 = std::make_unique<uint8_t[]>(HTable::computeStorageSize(64));
+  ASSERT_THROW(new (buffer3.get()) HTable(64, *ht1), std::invalid_argument);
+}
+
 template <typename AllocatorT>
 class MapTest : public ::testing::Test {
  private:
@@ -914,6 +1039,102 @@ class MapTest : public ::testing::Test {
     auto* v3 = map.find(15);
     EXPECT_EQ(200, *v3);
   }
+
+  template <MapIndexLayout Layout>
+  void testIndexLayout() {
+    auto cache = DataTypeTest::createCache<AllocatorT>();
+    const auto pid = cache->getPoolId(DataTypeTest::kDefaultPool);
+
+    using BasicMap = cachelib::Map<int, uint64_t, AllocatorT, Layout>;
+    auto map = BasicMap::create(*cache, pid, "my_map");
+    auto valueOf = [](int key) -> uint64_t { return key == 1 ? 11 : key * 10; };
+
+    // Enough keys to expand the index several times
+    const int numKeys = 5000;
+    for (int key = 0; key < numKeys; ++key) {
+      ASSERT_TRUE(map.insert(key, key * 10));
+    }
+    ASSERT_FALSE(map.insert(0, 0));
+    ASSERT_EQ(BasicMap::kReplaced, map.insertOrReplace(1, 11));
+    ASSERT_EQ(numKeys, map.size());
+
+    for (int key = 0; key < numKeys; ++key) {
+      auto* v = map.find(key);
+      ASSERT_NE(nullptr, v);
+      ASSERT_EQ(valueOf(key), *v);
+    }
+    ASSERT_EQ(nullptr, map.find(numKeys));
+
+    // Churn through the keys, which leaves tombstones in grouped indexes
+    for (int round = 0; round < 5; ++round) {
+      for (int key = 0; key < numKeys; key += 2) {
+        ASSERT_TRUE(map.erase(key));
+      }
+      ASSERT_EQ(numKeys / 2, map.size());
+      for (int key = 0; key < numKeys; key += 2) {
+        ASSERT_EQ(nullptr, map.find(key));
+        ASSERT_TRUE(map.insert(key, key * 10));
+      }
+    }
+
+    uint64_t sum = 0;
+    int count = 0;
+    for (auto& kv : map) {
+      ASSERT_EQ(valueOf(kv.first), kv.second);
+      sum += kv.second;
+      ++count;
+    }
+    ASSERT_EQ(numKeys, count);
+
+    auto view = map.toView();
+    ASSERT_EQ(numKeys, view.size());
+    for (int key = 0; key < numKeys; ++key) {
+      auto* v = view.find(key);
+      ASSERT_NE(nullptr, v);
+      ASSERT_EQ(valueOf(key), *v);
+    }
+    uint64_t viewSum = 0;
+    for (const auto& kv : view) {
+      viewSum += kv.second;
+    }
+    ASSERT_EQ(sum, viewSum);
+
+    // Attaching to the item gives back the same map
+    cache->insertOrReplace(map.viewWriteHandle());
+    auto map2 = BasicMap::fromWriteHandle(*cache, cache->findToWrite("my_map"));
+    ASSERT_EQ(numKeys, map2.size());
+    ASSERT_NE(nullptr, map2.find(numKeys - 1));
+  }
+
+  void testGroupedIndex() {
+    testIndexLayout<MapIndexLayout::kGrouped>();
+  }
+
+  void testGroupedInlineIndex() {
+    testIndexLayout<MapIndexLayout::kGroupedInline>();
+
+    auto cache = DataTypeTest::createCache<AllocatorT>();
+    const auto pid = cache->getPoolId(DataTypeTest::kDefaultPool);
+
+    // Inline values live in the index item, without any chained item
+    using InlineMap = cachelib::
+        Map<int, uint64_t, AllocatorT, MapIndexLayout::kGroupedInline>;
+    auto map = InlineMap::create(*cache, pid, "my_map");
+    for (int key = 0; key < 100; ++key) {
+      ASSERT_TRUE(map.insert(key, key));
+    }
+    ASSERT_FALSE(map.viewWriteHandle()->hasChainedItem());
+    ASSERT_EQ(map.viewWriteHandle()->getSize(), map.sizeInBytes());
+
+    // Values can be updated in place
+    *map.find(5) = 50;
+    ASSERT_EQ(50, *map.find(5));
+
+    for (int key = 0; key < 100; ++key) {
+      ASSERT_TRUE(map.erase(key));
+    }
+    ASSERT_EQ(map.begin(), map.end());
+  }
 };
 
 TYPED_TEST_CASE(MapTest, AllocatorTypes);
@@ -935,6 +1156,8 @@ TYPED_TEST(MapTest, ForkChainAtExpandTable) {
 TYPED_TEST(MapTest, ForkChainAtAppend) { this->testForkChainAtAppend(); }
 TYPED_TEST(MapTest, StdAlgorithms) { this->testStdAlgorithms(); }
 TYPED_TEST(MapTest, TinyMap) { this->testTinyMap(); }
+TYPED_TEST(MapTest, GroupedIndex) { this->testGroupedIndex(); }
+TYPED_TEST(MapTest, GroupedInlineIndex) { this->testGroupedInlineIndex(); }
 } // namespace tests
 } // namespace cachelib
 } // namespace facebook
@@ -17,6 +17,7 @@
 #include <folly/Random.h>
 
 #include <algorithm>
+#include <random>
 
 #include "cachelib/allocator/Util.h"
 #include "cachelib/allocator/tests/TestBase.h"
@@ -265,6 +266,46 @@ TEST(BinaryIndex, Clone) {
   EXPECT_FALSE(bi2->overLimit());
 }
 
+TEST(BinaryIndex, LookupBounds) {
+  using BI = detail::BinaryIndex<uint64_t>;
+
+  // Enough entries for the search to go through a few binary steps before it
+  // scans a block
+  const uint32_t numEntries = 200;
+  auto storageSize = BI::computeStorageSize(numEntries);
+  std::unique_ptr<uint8_t[]> buffer = std::make_unique<uint8_t[]>(storageSize);
+  auto* bi = BI::createNewIndex(buffer.get(), numEntries);
+  for (uint32_t i = 0; i < numEntries; i++) {
+    EXPECT_TRUE(bi->insert(i * 2, makeAddr(0, i)));
+  }
+
+  const auto* cbi = bi;
+  for (uint64_t key = 0; key < numEntries * 2 + 2; key++) {
+    const auto* lower = cbi->lookupLowerbound(key);
+    const auto* upper = cbi->lookupUpperbound(key, cbi->begin());
+    // the largest key is 2 * (numEntries - 1)
+    if (key >= numEntries * 2 - 1) {
+      EXPECT_EQ(cbi->end(), lower);
+    } else {
+      ASSERT_NE(cbi->end(), lower);
+      EXPECT_EQ((key + 1) / 2 * 2, lower->key);
+    }
+    if (key >= numEntries * 2 - 2) {
+      EXPECT_EQ(cbi->end(), upper);
+    } else {
+      ASSERT_NE(cbi->end(), upper);
+      EXPECT_EQ(key / 2 * 2 + 2, upper->key);
+    }
+  }
+
+  // Searching from an entry past the bound returns that entry
+  const auto* from = cbi->begin() + 100;
+  EXPECT_EQ(from, cbi->lookupLowerbound(10, from));
+  EXPECT_EQ(from, cbi->lookupUpperbound(10, from));
+  EXPECT_EQ(from + 1, cbi->lookupLowerbound(201, from));
+  EXPECT_EQ(cbi->end(), cbi->lookupUpperbound(1000, from));
+}
+
 TEST(BinaryIndexIterator, Basic) {
   using BI = detail::BinaryIndex<uint64_t>;
   using BufManager = detail::BufferManager<LruAllocator>;
@@ -585,6 +626,88 @@ TEST(RangeMap, RangeLookupApprox) {
   EXPECT_EQ(10, i);
 }
 
+TEST(RangeMap, RangeLookupBatch) {
+  using RM = RangeMap<uint64_t, uint64_t, LruAllocator>;
+
+  auto cache = createCache();
+  auto rm = RM::create(*cache, 0, "range_map");
+  const auto& crm = rm;
+  using Ranges = std::vector<RM::KeyRange>;
+  EXPECT_TRUE(crm.rangeLookupBatch(Ranges{{1, 10}}).empty());
+
+  // Insert the keys out of order so that the values of neighbouring keys
+  // are scattered over the chained items
+  std::vector<uint64_t> keys;
+  for (uint64_t i = 0; i < 1000; i++) {
+    keys.push_back(i * 10);
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{});
+  for (auto key : keys) {
+    EXPECT_TRUE(rm.insert(key, key * 11));
+  }
+
+  auto collectKeys = [](const auto& ranges) {
+    std::vector<std::vector<uint64_t>> result;
+    for (const auto& range : ranges) {
+      result.emplace_back();
+      for (const auto& kv : range) {
+        EXPECT_EQ(kv.key * 11, kv.value);
+        result.back().push_back(kv.key);
+      }
+    }
+    return result;
+  };
+
+  // Ranges come back in key order. The overlapping ones are merged and the
+  // empty ones are left out.
+  auto ranges = crm.rangeLookupBatch(
+      Ranges{{95, 125}, {1, 25}, {5001, 5005}, {20, 30}, {121, 141}});
+  EXPECT_EQ((std::vector<std::vector<uint64_t>>{{10, 20, 30},
+                                                {100, 110, 120, 130, 140}}),
+            collectKeys(ranges));
+
+  // Bounds are inclusive and don't need to be in the map
+  ranges = crm.rangeLookupBatch(Ranges{{9980, 20000}, {0, 0}, {40, 40}});
+  EXPECT_EQ((std::vector<std::vector<uint64_t>>{{0}, {40}, {9980, 9990}}),
+            collectKeys(ranges));
+
+  // A range covering the whole map iterates the same entries as begin()
+  ranges = crm.rangeLookupBatch(Ranges{{0, 10000}});
+  ASSERT_EQ(1, ranges.size());
+  auto itr = crm.begin();
+  for (const auto& kv : ranges[0]) {
+    ASSERT_NE(crm.end(), itr);
+    EXPECT_EQ(itr->key, kv.key);
+    EXPECT_EQ(itr->value, kv.value);
+    ++itr;
+  }
+  EXPECT_EQ(crm.end(), itr);
+
+  // Batch results agree with looking up each range on its own
+  for (int i = 0; i < 100; i++) {
+    Ranges batch;
+    for (int j = 0; j < 8; j++) {
+      const uint64_t lo = folly::Random::rand64(10100);
+      batch.emplace_back(lo, lo + folly::Random::rand64(100));
+    }
+    std::vector<uint64_t> expected;
+    for (const auto& [lo, hi] : batch) {
+      for (const auto& kv : crm.rangeLookupApproximate(lo, hi)) {
+        expected.push_back(kv.key);
+      }
+    }
+    std::sort(expected.begin(), expected.end());
+    expected.erase(std::unique(expected.begin(), expected.end()),
+                   expected.end());
+
+    std::vector<uint64_t> actual;
+    for (const auto& range : collectKeys(crm.rangeLookupBatch(batch))) {
+      actual.insert(actual.end(), range.begin(), range.end());
+    }
+    EXPECT_EQ(expected, actual);
+  }
+}
+
 TEST(RangeMap, LargeMap) {
   using RM = RangeMap<uint64_t, uint64_t, LruAllocator>;
 
@@ -23,6 +23,7 @@
 #include <functional>
 #include <memory>
 #include <stdexcept>
+#include <vector>
 
 #include "cachelib/navy/common/Buffer.h"
 #include "cachelib/navy/common/Hash.h"
@@ -44,6 +45,19 @@ using LookupCallback =
 
 using RemoveCallback = folly::Function<void(Status status, HashedKey key)>;
 
+// An entry of a batch insert. See AbstractCache::insertBatchAsync.
+struct InsertBatchEntry {
+  HashedKey key;
+  BufferView value;
+};
+
+// Runs the insert of the batch entry at index, which returns false when it
+// has to be retried later. Returns false to skip the entry instead.
+using InsertBatchCommit =
+    folly::Function<bool(size_t index, folly::FunctionRef<bool()> insert)>;
+
+using InsertBatchCallback = folly::Function<void(size_t index, Status status)>;
+
 // Generic cache interface.
 // All functions are synchronous, unless stated the opposite.
 class AbstractCache {
@@ -76,6 +90,22 @@ class AbstractCache {
                              BufferView value,
                              InsertCallback cb) = 0;
 
+  // Asynchronously inserts a batch of entries with one job per engine pair
+  // instead of one per entry. Entries are admitted one by one like by
+  // insertAsync, and the rejected ones get their callback right away. The
+  // insert of every admitted entry runs through commit on a worker thread,
+  // with its callback invoked afterwards unless commit skipped it.
+  //
+  // A batch job is only ordered with the other requests for the key of its
+  // first entry. commit lets the caller order the insert of every other entry
+  // with its own requests for the same key, e.g. by skipping it when a remove
+  // came after the entry was batched.
+  //
+  // @entries must stay valid until the entry got its callback or was skipped.
+  virtual void insertBatchAsync(std::vector<InsertBatchEntry> entries,
+                                InsertBatchCommit commit,
+                                InsertBatchCallback cb) = 0;
+
   // Looks up value. Returns non-null buffer if found.
   // Returns: Ok, NotFound, DeviceError
   virtual Status lookup(HashedKey key, Buffer& value) = 0;
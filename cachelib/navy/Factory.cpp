@@ -19,6 +19,7 @@
 #include <folly/Format.h>
 #include <folly/Random.h>
 
+#include <optional>
 #include <stdexcept>
 
 #include "cachelib/navy/admission_policy/DynamicRandomAP.h"
@@ -29,6 +30,7 @@
 #include "cachelib/navy/block_cache/LruPolicy.h"
 #include "cachelib/navy/common/Device.h"
 #include "cachelib/navy/driver/Driver.h"
+#include "cachelib/navy/engine/AdaptiveSizeRouter.h"
 #include "cachelib/navy/serialization/RecordIO.h"
 
 /* O_DIRECT not available on Mac OS */
@@ -188,6 +190,7 @@ class EnginePairProtoImpl final : public EnginePairProto {
     bigHashProto_ = std::move(proto.bigHashProto_);
     blockCacheProto_ = std::move(proto.blockCacheProto_);
     smallItemMaxSize_ = proto.smallItemMaxSize_;
+    sizeRouterConfig_ = std::move(proto.sizeRouterConfig_);
   }
 
   void setBigHash(std::unique_ptr<BigHashProto> proto,
@@ -200,6 +203,16 @@ class EnginePairProtoImpl final : public EnginePairProto {
     blockCacheProto_ = std::move(proto);
   }
 
+  void setAdaptiveSmallItemMaxSize(uint32_t bucketSize,
+                                   std::chrono::seconds updateInterval,
+                                   double hysteresis) override {
+    AdaptiveSizeRouter::Config config;
+    config.bucketSize = bucketSize;
+    config.updateInterval = updateInterval;
+    config.hysteresis = hysteresis;
+    sizeRouterConfig_ = std::move(config);
+  }
+
   EnginePair create(Device* device,
                     ExpiredCheck checkExpired,
                     DestructorCallback destructorCb,
@@ -224,14 +237,23 @@ class EnginePairProtoImpl final : public EnginePairProto {
       }
     }
 
+    std::unique_ptr<AdaptiveSizeRouter> sizeRouter;
+    if (sizeRouterConfig_ && bh && bc) {
+      sizeRouterConfig_->maxSmallItemMaxSize =
+          static_cast<uint32_t>(bh->getMaxItemSize());
+      sizeRouter = std::make_unique<AdaptiveSizeRouter>(
+          std::move(*sizeRouterConfig_), smallItemMaxSize_);
+    }
+
     return EnginePair{std::move(bh), std::move(bc), smallItemMaxSize_,
-                      &scheduler};
+                      &scheduler, std::move(sizeRouter)};
   }
 
  private:
   std::unique_ptr<BigHashProto> bigHashProto_;
   std::unique_ptr<BlockCacheProto> blockCacheProto_;
   uint32_t smallItemMaxSize_;
+  std::optional<AdaptiveSizeRouter::Config> sizeRouterConfig_;
 };
 
 class CacheProtoImpl final : public CacheProto {
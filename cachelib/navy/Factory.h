@@ -122,6 +122,15 @@ class EnginePairProto {
   // Set up big hash engine.
   virtual void setBigHash(std::unique_ptr<BigHashProto> proto,
                           uint32_t smallItemMaxSize) = 0;
+
+  // Learn the small item max size instead of keeping it fixed. It moves by
+  // buckets of bucketSize bytes at most once per updateInterval, when one
+  // engine gets more hits per byte written than the other by hysteresis, a
+  // fraction in [0, 1]. Only applies with both engines set.
+  virtual void setAdaptiveSmallItemMaxSize(
+      uint32_t bucketSize,
+      std::chrono::seconds updateInterval,
+      double hysteresis) = 0;
 };
 
 // Cache object prototype. Setup cache desired parameters and pass proto to
@@ -174,6 +174,61 @@ Status Driver::insertAsync(HashedKey hk, BufferView value, InsertCallback cb) {
   return Status::Ok;
 }
 
+void Driver::insertBatchAsync(std::vector<InsertBatchEntry> entries,
+                              InsertBatchCommit commit,
+                              InsertBatchCallback cb) {
+  // shared by the jobs of all engine pairs
+  struct Batch {
+    std::vector<InsertBatchEntry> entries;
+    InsertBatchCommit commit;
+    InsertBatchCallback cb;
+  };
+  auto batch = std::make_shared<Batch>(
+      Batch{std::move(entries), std::move(commit), std::move(cb)});
+
+  std::vector<std::vector<size_t>> admitted(enginePairs_.size());
+  for (size_t i = 0; i < batch->entries.size(); i++) {
+    const auto& entry = batch->entries[i];
+    if (entry.key.key().size() > kMaxKeySize) {
+      rejectedCount_.inc();
+      rejectedBytes_.add(entry.key.key().size() + entry.value.size());
+      batch->cb(i, Status::Rejected);
+      continue;
+    }
+    if (!admissionTest(entry.key, entry.value)) {
+      batch->cb(i, Status::Rejected);
+      continue;
+    }
+    admitted[selectEnginePair(entry.key)].push_back(i);
+  }
+
+  for (size_t pair = 0; pair < admitted.size(); pair++) {
+    if (admitted[pair].empty()) {
+      continue;
+    }
+    std::vector<InsertBatchEntry> pairEntries;
+    pairEntries.reserve(admitted[pair].size());
+    for (auto i : admitted[pair]) {
+      pairEntries.push_back(batch->entries[i]);
+    }
+    auto indices =
+        std::make_shared<std::vector<size_t>>(std::move(admitted[pair]));
+    enginePairs_[pair].scheduleInsertBatch(
+        std::move(pairEntries),
+        [batch, indices](size_t i, folly::FunctionRef<bool()> insert) {
+          return batch->commit((*indices)[i], insert);
+        },
+        [this, batch, indices](size_t i, std::optional<Status> status) {
+          const auto& entry = batch->entries[(*indices)[i]];
+          if (status) {
+            batch->cb((*indices)[i], *status);
+          }
+          parcelMemory_.sub(entry.key.key().size() + entry.value.size());
+          concurrentInserts_.dec();
+        });
+  }
+}
+
 Status Driver::lookup(HashedKey hk, Buffer& value) {
   return enginePairs_[selectEnginePair(hk)].lookupSync(hk, value);
 }
@@ -96,6 +96,16 @@ class Driver final : public AbstractCache {
                      BufferView value,
                      InsertCallback cb) override;
 
+  // insert a batch of keys and values into the cache asynchronously, with
+  // one job per engine pair.
+  // @param entries  the keys and values
+  // @param commit   runs the insert of every admitted entry
+  // @param cb       a callback function be triggered for every entry that
+  //                 was rejected, or inserted without commit skipping it
+  void insertBatchAsync(std::vector<InsertBatchEntry> entries,
+                        InsertBatchCommit commit,
+                        InsertBatchCallback cb) override;
+
   // lookup a key in the cache.
   // @param key    the item key to lookup
   // @param value  the returned value for the key if found
@@ -21,6 +21,7 @@
 
 #include "cachelib/navy/common/Hash.h"
 #include "cachelib/navy/driver/Driver.h"
+#include "cachelib/navy/engine/AdaptiveSizeRouter.h"
 #include "cachelib/navy/engine/NoopEngine.h"
 #include "cachelib/navy/scheduler/ThreadPoolJobScheduler.h"
 #include "cachelib/navy/testing/BufferGen.h"
@@ -497,6 +498,68 @@ TEST(Driver, InsertRetryRemoveOther) {
   EXPECT_EQ(smallValue.view(), valueLookup.view());
 }
 
+TEST(Driver, InsertRetryAfterThresholdMoves) {
+  BufferGen bg;
+  // with the key, the item is large at the initial threshold of 256 bytes and
+  // small once the threshold moved up to 320 bytes
+  auto value = bg.gen(300 - 3);
+
+  // The small item engine retries the first remove. The retry has to remove
+  // from it again, not from the engine the item was just inserted into.
+  auto bc = std::make_unique<MockEngine>();
+  auto si = std::make_unique<MockEngine>();
+  {
+    testing::InSequence inSeq;
+    EXPECT_CALL(*bc, insert(makeHK("key"), value.view()));
+    EXPECT_CALL(*si, remove(makeHK("key")))
+        .WillOnce(Return(Status::Retry))
+        .WillOnce(testing::DoDefault());
+  }
+  EXPECT_CALL(*si, insert(_, _)).Times(0);
+  EXPECT_CALL(*bc, remove(_)).Times(0);
+
+  AdaptiveSizeRouter::Config routerConfig;
+  routerConfig.bucketSize = 64;
+  routerConfig.maxSmallItemMaxSize = 1024;
+  routerConfig.updateInterval = std::chrono::seconds{3600};
+  routerConfig.stableWindows = 1;
+  routerConfig.minHits = 10;
+  auto router =
+      std::make_unique<AdaptiveSizeRouter>(std::move(routerConfig), 256);
+  auto* routerPtr = router.get();
+
+  MockJobScheduler ex;
+  EnginePair pair{std::move(si), std::move(bc), 256, &ex, std::move(router)};
+
+  Status insertStatus = Status::BadState;
+  pair.scheduleInsert(makeHK("key"), value.view(),
+                      [&insertStatus](Status status, HashedKey) {
+                        insertStatus = status;
+                      });
+  EXPECT_FALSE(ex.runFirst());
+
+  // small items earn more hits per byte than the large ones right above the
+  // threshold, which moves it past the item
+  for (int i = 0; i < 100; i++) {
+    routerPtr->recordInsert(100, true /* small */);
+    routerPtr->recordHit(100, true /* small */);
+    routerPtr->recordInsert(300, false /* small */);
+  }
+  for (int i = 0; i < 30; i++) {
+    routerPtr->recordHit(300, false /* small */);
+  }
+  routerPtr->update();
+  EXPECT_EQ(320, routerPtr->getSmallItemMaxSize());
+
+  EXPECT_TRUE(ex.runFirst());
+  EXPECT_EQ(Status::Ok, insertStatus);
+  EXPECT_EQ(1, ex.getRescheduleCount());
+
+  Buffer valueLookup;
+  EXPECT_EQ(Status::Ok, pair.lookupSync(makeHK("key"), valueLookup));
+  EXPECT_EQ(value.view(), valueLookup.view());
+}
+
 TEST(Driver, Remove) {
   BufferGen bg;
   auto smallValue = bg.gen(16);
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cachelib/navy/engine/AdaptiveSizeRouter.h"
+
+#include <folly/Format.h>
+#include <folly/logging/xlog.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "cachelib/navy/common/Utils.h"
+
+namespace facebook::cachelib::navy {
+
+namespace {
+double hitsPerByte(uint64_t hits, uint64_t bytes) {
+  return static_cast<double>(hits) / static_cast<double>(bytes);
+}
+} // namespace
+
+AdaptiveSizeRouter::Config& AdaptiveSizeRouter::Config::validate() {
+  if (bucketSize == 0) {
+    throw std::invalid_argument{"Bucket size must be greater than 0"};
+  }
+  if (maxSmallItemMaxSize < bucketSize) {
+    throw std::invalid_argument{folly::sformat(
+        "Max small item max size {} must be at least one bucket of {} bytes",
+        maxSmallItemMaxSize, bucketSize)};
+  }
+  if (updateInterval == std::chrono::seconds{0}) {
+    throw std::invalid_argument{
+        folly::sformat("Update interval must be greater than 0. Interval: {}",
+                       updateInterval.count())};
+  }
+  if (!between(hysteresis, 0, 1)) {
+    throw std::invalid_argument{folly::sformat(
+        "Hysteresis must be in range [0, 1]. Hysteresis: {}", hysteresis)};
+  }
+  if (stableWindows == 0) {
+    throw std::invalid_argument{"Stable windows must be greater than 0"};
+  }
+  return *this;
+}
+
+AdaptiveSizeRouter::AdaptiveSizeRouter(Config&& config,
+                                       uint32_t initialSmallItemMaxSize)
+    : bucketSize_{config.validate().bucketSize},
+      maxSmallItemMaxSize_{config.maxSmallItemMaxSize / bucketSize_ *
+                           bucketSize_},
+      updateInterval_{config.updateInterval},
+      hysteresis_{config.hysteresis},
+      stableWindows_{config.stableWindows},
+      minHits_{config.minHits},
+      numBuckets_{config.maxSmallItemMaxSize / bucketSize_ + 1},
+      smallItemMaxSize_{std::clamp(
+          initialSmallItemMaxSize / bucketSize_ * bucketSize_,
+          bucketSize_,
+          maxSmallItemMaxSize_)},
+      nextUpdateTime_{getSteadyClockSeconds() + updateInterval_} {
+  for (size_t engine : {kSmall, kLarge}) {
+    bytes_[engine] = std::make_unique<TLCounter[]>(numBuckets_);
+    hits_[engine] = std::make_unique<TLCounter[]>(numBuckets_);
+    lastBytes_[engine].resize(numBuckets_);
+    lastHits_[engine].resize(numBuckets_);
+  }
+  XLOGF(INFO,
+        "AdaptiveSizeRouter: small item max size {} within [{}, {}], bucket "
+        "size {}, update interval {} s, hysteresis {}.",
+        getSmallItemMaxSize(), bucketSize_, maxSmallItemMaxSize_, bucketSize_,
+        updateInterval_.count(), hysteresis_);
+}
+
+size_t AdaptiveSizeRouter::bucketOf(uint32_t size) const {
+  if (size == 0) {
+    return 0;
+  }
+  return std::min<size_t>((size - 1) / bucketSize_, numBuckets_ - 1);
+}
+
+void AdaptiveSizeRouter::recordInsert(uint32_t size, bool small) {
+  bytes_[small ? kSmall : kLarge][bucketOf(size)].add(size);
+}
+
+void AdaptiveSizeRouter::recordHit(uint32_t size, bool small) {
+  hits_[small ? kSmall : kLarge][bucketOf(size)].inc();
+}
+
+void AdaptiveSizeRouter::maybeUpdate() {
+  const auto curTime = getSteadyClockSeconds();
+  if (curTime < nextUpdateTime_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  // Lots of threads can get into this section. First to grab the lock will
+  // update. Let proceed the rest.
+  std::unique_lock<std::mutex> lock{mutex_, std::try_to_lock};
+  if (lock.owns_lock()) {
+    updateLocked(curTime);
+  }
+}
+
+void AdaptiveSizeRouter::update() {
+  std::lock_guard<std::mutex> lock{mutex_};
+  updateLocked(getSteadyClockSeconds());
+}
+
+AdaptiveSizeRouter::Window AdaptiveSizeRouter::takeWindowLocked(
+    size_t engine) {
+  Window window;
+  window.bytes.resize(numBuckets_);
+  window.hits.resize(numBuckets_);
+  for (size_t b = 0; b < numBuckets_; b++) {
+    const auto bytes = bytes_[engine][b].get();
+    const auto hits = hits_[engine][b].get();
+    window.bytes[b] = bytes - lastBytes_[engine][b];
+    window.hits[b] = hits - lastHits_[engine][b];
+    lastBytes_[engine][b] = bytes;
+    lastHits_[engine][b] = hits;
+    window.totalBytes += window.bytes[b];
+    window.totalHits += window.hits[b];
+  }
+  return window;
+}
+
+uint32_t AdaptiveSizeRouter::evaluateLocked(const Window& small,
+                                            const Window& large) const {
+  const uint32_t cur = getSmallItemMaxSize();
+  if (small.totalHits < minHits_ || large.totalHits < minHits_ ||
+      small.totalBytes == 0 || large.totalBytes == 0) {
+    return cur;
+  }
+  const double smallHitsPerByte =
+      hitsPerByte(small.totalHits, small.totalBytes);
+  const double largeHitsPerByte =
+      hitsPerByte(large.totalHits, large.totalBytes);
+  // buckets [0, firstLarge) go to the small item engine
+  const size_t firstLarge = cur / bucketSize_;
+
+  // The threshold may sit in a gap of the size distribution, so compare with
+  // the nearest buckets that were written on either side.
+  uint32_t up = cur;
+  for (size_t b = firstLarge; b + 1 < numBuckets_; b++) {
+    if (large.bytes[b] > 0) {
+      if (smallHitsPerByte >
+          hitsPerByte(large.hits[b], large.bytes[b]) * (1 + hysteresis_)) {
+        up = static_cast<uint32_t>((b + 1) * bucketSize_);
+      }
+      break;
+    }
+  }
+
+  // The first bucket always stays with the small item engine.
+  uint32_t down = cur;
+  for (size_t b = firstLarge - 1; b > 0; b--) {
+    if (small.bytes[b] > 0) {
+      if (hitsPerByte(small.hits[b], small.bytes[b]) * (1 + hysteresis_) <
+          largeHitsPerByte) {
+        down = static_cast<uint32_t>(b * bucketSize_);
+      }
+      break;
+    }
+  }
+
+  if (up != cur && down != cur) {
+    // both sides want the other's items, which does not point anywhere.
+    return cur;
+  }
+  return up != cur ? up : down;
+}
+
+void AdaptiveSizeRouter::updateLocked(std::chrono::seconds curTime) {
+  nextUpdateTime_.store(curTime + updateInterval_, std::memory_order_relaxed);
+
+  const auto small = takeWindowLocked(kSmall);
+  const auto large = takeWindowLocked(kLarge);
+  if (small.totalBytes > 0) {
+    hitsPerMB_[kSmall] = hitsPerByte(small.totalHits, small.totalBytes) * 1e6;
+  }
+  if (large.totalBytes > 0) {
+    hitsPerMB_[kLarge] = hitsPerByte(large.totalHits, large.totalBytes) * 1e6;
+  }
+
+  const uint32_t cur = getSmallItemMaxSize();
+  const uint32_t target = evaluateLocked(small, large);
+  const int direction = target > cur ? 1 : (target < cur ? -1 : 0);
+  if (direction != pendingDirection_) {
+    pendingDirection_ = direction;
+    pendingWindows_ = 0;
+  }
+  if (direction == 0 || ++pendingWindows_ < stableWindows_) {
+    return;
+  }
+
+  XLOGF(INFO, "AdaptiveSizeRouter: small item max size {} -> {}", cur, target);
+  smallItemMaxSize_.store(target, std::memory_order_relaxed);
+  changes_.inc();
+  pendingDirection_ = 0;
+  pendingWindows_ = 0;
+}
+
+void AdaptiveSizeRouter::getCounters(const CounterVisitor& visitor) const {
+  visitor("navy_small_item_max_size", getSmallItemMaxSize());
+  visitor("navy_small_item_max_size_changes",
+          changes_.get(),
+          CounterVisitor::CounterType::RATE);
+  visitor("navy_bh_hits_per_mb_written", hitsPerMB_[kSmall].load());
+  visitor("navy_bc_hits_per_mb_written", hitsPerMB_[kLarge].load());
+}
+} // namespace facebook::cachelib::navy
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "cachelib/common/AtomicCounter.h"
+#include "cachelib/navy/common/Types.h"
+
+namespace facebook {
+namespace cachelib {
+namespace navy {
+
+/**
+ * Learns the size up to which items of an engine pair go to the small item
+ * engine, instead of using a fixed small item max size.
+ *
+ * Items are grouped into size buckets of bucketSize bytes. For every bucket
+ * and engine, the router counts the bytes inserted and the lookup hits. Once
+ * per updateInterval it compares the hits per byte written of each engine
+ * with those of the items right at the other side of the threshold:
+ *  - if the small item engine earns more per byte than the large item engine
+ *    does with the smallest of its items, the threshold moves up past them.
+ *  - if the large item engine earns more per byte than the small item engine
+ *    does with the largest of its items, the threshold moves down below them.
+ * Either engine has to lead by more than the hysteresis and the same move has
+ * to win stableWindows windows in a row before the threshold changes.
+ *
+ * The threshold stays between one bucket and maxSmallItemMaxSize. Moving it
+ * only affects where new inserts go, lookups and removes check both engines.
+ *
+ * Thread safe.
+ */
+class AdaptiveSizeRouter {
+ public:
+  struct Config {
+    // Width of the size buckets in bytes. The threshold moves by whole
+    // buckets.
+    uint32_t bucketSize{64};
+
+    // Largest threshold, the max item size of the small item engine.
+    uint32_t maxSmallItemMaxSize{0};
+
+    // Interval to re-evaluate the threshold.
+    std::chrono::seconds updateInterval{60};
+
+    // Fraction by which the hits per byte of one side have to exceed the
+    // other's for the threshold to move, e.g. 0.2.
+    double hysteresis{0.2};
+
+    // Number of consecutive windows that have to agree on a move.
+    uint32_t stableWindows{2};
+
+    // Hits either engine needs within a window for it to be evaluated.
+    uint64_t minHits{1000};
+
+    // Throws if invalid config
+    Config& validate();
+  };
+
+  // @param config                   config that is validated here
+  // @param initialSmallItemMaxSize  threshold to start from. It is aligned
+  //                                 down to a bucket.
+  //
+  // @throw std::invalid_argument on bad config.
+  AdaptiveSizeRouter(Config&& config, uint32_t initialSmallItemMaxSize);
+  AdaptiveSizeRouter(const AdaptiveSizeRouter&) = delete;
+  AdaptiveSizeRouter& operator=(const AdaptiveSizeRouter&) = delete;
+
+  // Items larger than this go to the large item engine.
+  uint32_t getSmallItemMaxSize() const {
+    return smallItemMaxSize_.load(std::memory_order_relaxed);
+  }
+
+  // Records an item of size bytes inserted into one of the engines.
+  void recordInsert(uint32_t size, bool small);
+
+  // Records a lookup hit for an item of size bytes in one of the engines.
+  void recordHit(uint32_t size, bool small);
+
+  // Re-evaluates the threshold if updateInterval passed since the last time.
+  // Cheap otherwise, meant to be called from the insert path.
+  void maybeUpdate();
+
+  // Re-evaluates the threshold from what was recorded since the last time.
+  void update();
+
+  // Get stats counters to export.
+  void getCounters(const CounterVisitor& visitor) const;
+
+ private:
+  static constexpr size_t kSmall = 0;
+  static constexpr size_t kLarge = 1;
+
+  // Bucket counts of one engine within a window.
+  struct Window {
+    std::vector<uint64_t> bytes;
+    std::vector<uint64_t> hits;
+    uint64_t totalBytes{0};
+    uint64_t totalHits{0};
+  };
+
+  // Items larger than the max threshold share the last bucket, which never
+  // moves to the small item engine.
+  size_t bucketOf(uint32_t size) const;
+
+  // Collects what was recorded for an engine since the last window.
+  Window takeWindowLocked(size_t engine);
+
+  // @return  the new threshold the window suggests, or the current one
+  uint32_t evaluateLocked(const Window& small, const Window& large) const;
+
+  void updateLocked(std::chrono::seconds curTime);
+
+  const uint32_t bucketSize_{};
+  const uint32_t maxSmallItemMaxSize_{};
+  const std::chrono::seconds updateInterval_{};
+  const double hysteresis_{};
+  const uint32_t stableWindows_{};
+  const uint64_t minHits_{};
+  const size_t numBuckets_{};
+
+  std::atomic<uint32_t> smallItemMaxSize_{};
+
+  // indexed by engine and then bucket. Thread local, since every insert and
+  // lookup hit records into them.
+  std::unique_ptr<TLCounter[]> bytes_[2];
+  std::unique_ptr<TLCounter[]> hits_[2];
+
+  std::atomic<std::chrono::seconds> nextUpdateTime_{};
+
+  // Protects the window state below.
+  std::mutex mutex_;
+  std::vector<uint64_t> lastBytes_[2];
+  std::vector<uint64_t> lastHits_[2];
+  // direction of the move the last windows agreed on and how many did
+  int pendingDirection_{0};
+  uint32_t pendingWindows_{0};
+
+  // Hits per MB written of either engine in the last window.
+  std::atomic<double> hitsPerMB_[2]{};
+  AtomicCounter changes_;
+};
+} // namespace navy
+} // namespace cachelib
+} // namespace facebook
@@ -23,14 +23,19 @@ namespace facebook::cachelib::navy {
 EnginePair::EnginePair(std::unique_ptr<Engine> smallItemCache,
                        std::unique_ptr<Engine> largeItemCache,
                        uint32_t smallItemMaxSize,
-                       JobScheduler* scheduler)
+                       JobScheduler* scheduler,
+                       std::unique_ptr<AdaptiveSizeRouter> sizeRouter)
     : smallItemMaxSize_(smallItemCache ? smallItemMaxSize : 0),
       largeItemCache_{std::move(largeItemCache)},
       smallItemCache_{std::move(smallItemCache)},
-      scheduler_(scheduler) {}
+      scheduler_(scheduler),
+      sizeRouter_{smallItemCache_ && largeItemCache_ ? std::move(sizeRouter)
+                                                     : nullptr} {}
 
 bool EnginePair::isItemLarge(HashedKey key, BufferView value) const {
-  return key.key().size() + value.size() > smallItemMaxSize_;
+  const uint32_t smallItemMaxSize =
+      sizeRouter_ ? sizeRouter_->getSmallItemMaxSize() : smallItemMaxSize_;
+  return key.key().size() + value.size() > smallItemMaxSize;
 }
 
 std::pair<Engine&, Engine&> EnginePair::select(HashedKey key,
@@ -62,10 +67,15 @@ Status EnginePair::lookupSync(HashedKey hk, Buffer& value) const {
   while ((status = largeItemCache_->lookup(hk, value)) == Status::Retry) {
     std::this_thread::yield();
   }
-  if (status == Status::NotFound) {
+  if (status == Status::Ok) {
+    recordHit(hk, value, false /* small */);
+  } else if (status == Status::NotFound) {
     while ((status = smallItemCache_->lookup(hk, value)) == Status::Retry) {
       std::this_thread::yield();
     }
+    if (status == Status::Ok) {
+      recordHit(hk, value, true /* small */);
+    }
   }
   updateLookupStats(status);
   return status;
@@ -73,18 +83,28 @@ Status EnginePair::lookupSync(HashedKey hk, Buffer& value) const {
 
 Status EnginePair::insertInternal(HashedKey hk,
                                   BufferView value,
-                                  bool& skipInsertion) {
-  auto selection = select(hk, value);
+                                  bool& skipInsertion,
+                                  bool& insertedLarge) {
+  if (!skipInsertion) {
+    insertedLarge = isItemLarge(hk, value);
+  }
+  Engine& target = insertedLarge ? *largeItemCache_ : *smallItemCache_;
+  Engine& other = insertedLarge ? *smallItemCache_ : *largeItemCache_;
   Status status = Status::Ok;
   if (!skipInsertion) {
-    status = selection.first.insert(hk, value);
+    status = target.insert(hk, value);
     if (status == Status::Retry) {
       return status;
     }
     skipInsertion = true;
+    if (sizeRouter_ && status == Status::Ok) {
+      sizeRouter_->recordInsert(hk.key().size() + value.size(),
+                                !insertedLarge);
+      sizeRouter_->maybeUpdate();
+    }
   }
   if (status != Status::DeviceError) {
-    auto rs = selection.second.remove(hk);
+    auto rs = other.remove(hk);
     if (rs == Status::Retry) {
       return rs;
     }
@@ -113,8 +133,9 @@ void EnginePair::scheduleInsert(HashedKey hk,
                                 InsertCallback cb) {
   insertCount_.inc();
   scheduler_->enqueueWithKey(
-      [this, cb = std::move(cb), hk, value, skipInsertion = false]() mutable {
-        auto status = insertInternal(hk, value, skipInsertion);
+      [this, cb = std::move(cb), hk, value, skipInsertion = false,
+       insertedLarge = false]() mutable {
+        auto status = insertInternal(hk, value, skipInsertion, insertedLarge);
         if (status == Status::Retry) {
           return JobExitCode::Reschedule;
         }
@@ -130,6 +151,46 @@ void EnginePair::scheduleInsert(HashedKey hk,
       hk.keyHash());
 }
 
+void EnginePair::scheduleInsertBatch(std::vector<InsertBatchEntry> entries,
+                                     InsertBatchCommit commit,
+                                     InsertBatchDoneCallback done) {
+  XDCHECK(!entries.empty());
+  insertCount_.add(entries.size());
+  const auto orderKey = entries.front().key.keyHash();
+  scheduler_->enqueueWithKey(
+      [this, entries = std::move(entries), commit = std::move(commit),
+       done = std::move(done), next = size_t{0}, skipInsertion = false,
+       insertedLarge = false]() mutable {
+        for (; next < entries.size(); next++) {
+          auto& entry = entries[next];
+          Status status = Status::Ok;
+          bool committed = true;
+          if (skipInsertion) {
+            // the entry is already in, only the removal from the other engine
+            // has to be retried.
+            status = insertInternal(entry.key, entry.value, skipInsertion,
+                                    insertedLarge);
+          } else {
+            committed = commit(next, [&]() {
+              status = insertInternal(entry.key, entry.value, skipInsertion,
+                                      insertedLarge);
+              return status != Status::Retry;
+            });
+          }
+          if (committed && status == Status::Retry) {
+            return JobExitCode::Reschedule;
+          }
+
+          skipInsertion = false;
+          done(next, committed ? std::make_optional(status) : std::nullopt);
+        }
+        return JobExitCode::Done;
+      },
+      "insert_batch",
+      JobType::Write,
+      orderKey);
+}
+
 void EnginePair::updateLookupStats(Status status) const {
   switch (status) {
   case Status::Ok:
@@ -142,6 +203,14 @@ void EnginePair::updateLookupStats(Status status) const {
   }
 }
 
+void EnginePair::recordHit(HashedKey hk,
+                           const Buffer& value,
+                           bool small) const {
+  if (sizeRouter_) {
+    sizeRouter_->recordHit(hk.key().size() + value.size(), small);
+  }
+}
+
 Status EnginePair::lookupInternal(HashedKey hk,
                                   Buffer& value,
                                   bool& skipLargeItemCache) const {
@@ -152,12 +221,18 @@ Status EnginePair::lookupInternal(HashedKey hk,
       return status;
     }
     skipLargeItemCache = true;
+    if (status == Status::Ok) {
+      recordHit(hk, value, false /* small */);
+    }
   }
   if (status == Status::NotFound) {
     status = smallItemCache_->lookup(hk, value);
     if (status == Status::Retry) {
       return status;
     }
+    if (status == Status::Ok) {
+      recordHit(hk, value, true /* small */);
+    }
   }
   updateLookupStats(status);
   return status;
@@ -280,6 +355,9 @@ void EnginePair::getCounters(const CounterVisitor& visitor) const {
   visitor(
       "navy_io_errors", ioErrorCount_.get(), CounterVisitor::CounterType::RATE);
   visitor("navy_total_usable_size", getUsableSize());
+  if (sizeRouter_) {
+    sizeRouter_->getCounters(visitor);
+  }
   largeItemCache_->getCounters(visitor);
   smallItemCache_->getCounters(visitor);
 }
@@ -20,6 +20,10 @@
 #include <cachelib/navy/common/Buffer.h>
 #include <folly/Random.h>
 
+#include <optional>
+#include <vector>
+
+#include "cachelib/navy/engine/AdaptiveSizeRouter.h"
 #include "cachelib/navy/engine/Engine.h"
 #include "cachelib/navy/scheduler/JobScheduler.h"
 
@@ -31,17 +35,21 @@ namespace navy {
 // A driver must have at least one engine pair.
 class EnginePair {
  public:
+  // @param sizeRouter  if set, learns the small item max size starting from
+  //                    smallItemMaxSize. Only used with both engines.
   EnginePair(std::unique_ptr<Engine> smallItemCache,
              std::unique_ptr<Engine> largeItemCache,
              uint32_t smallItemMaxSize,
-             JobScheduler* scheduler);
+             JobScheduler* scheduler,
+             std::unique_ptr<AdaptiveSizeRouter> sizeRouter = nullptr);
 
   // Move constructor.
   EnginePair(EnginePair&& ep) noexcept
-      : EnginePair(std::move(ep.smallItemCache_),
-                   std::move(ep.largeItemCache_),
-                   ep.smallItemMaxSize_,
-                   ep.scheduler_) {}
+      : smallItemMaxSize_(ep.smallItemMaxSize_),
+        largeItemCache_(std::move(ep.largeItemCache_)),
+        smallItemCache_(std::move(ep.smallItemCache_)),
+        scheduler_(ep.scheduler_),
+        sizeRouter_(std::move(ep.sizeRouter_)) {}
 
   // Move assignment operator.
   EnginePair& operator=(EnginePair&& other) = delete;
@@ -67,6 +75,18 @@ class EnginePair {
   // Schedule an insert.
   void scheduleInsert(HashedKey hk, BufferView value, InsertCallback cb);
 
+  // Invoked for every entry of a batch insert once it is done, with the
+  // insert status or without one if commit skipped the entry.
+  using InsertBatchDoneCallback =
+      folly::Function<void(size_t index, std::optional<Status> status)>;
+
+  // Schedule the inserts of a batch of entries as a single job, ordered with
+  // the other requests for the key of the first entry. Every entry is inserted
+  // through commit.
+  void scheduleInsertBatch(std::vector<InsertBatchEntry> entries,
+                           InsertBatchCommit commit,
+                           InsertBatchDoneCallback done);
+
   // Perform lookup by keeping retrying until a result (Ok, NotFound, Error) is
   // reached.
   Status lookupSync(HashedKey hk, Buffer& value) const;
@@ -114,14 +134,22 @@ class EnginePair {
   //   - second: the other engine to remove key
   std::pair<Engine&, Engine&> select(HashedKey key, BufferView value) const;
 
+  // Records a lookup hit in one of the engines with the size router.
+  void recordHit(HashedKey hk, const Buffer& value, bool small) const;
+
   // Perform lookup in a retry friendly manner.
   Status lookupInternal(HashedKey hk,
                         Buffer& value,
                         bool& skipLargeItemCache) const;
 
   // insert an item to one of the engine and remove it from the other.
-  // An option can be specified to skip insertion on retry.
-  Status insertInternal(HashedKey key, BufferView value, bool& skipInsertion);
+  // An option can be specified to skip insertion on retry. The engine the item
+  // was inserted into is kept in insertedLarge then, since the small item max
+  // size can change in between.
+  Status insertInternal(HashedKey key,
+                        BufferView value,
+                        bool& skipInsertion,
+                        bool& insertedLarge);
 
   // Performa a remove by hashed key in a retry friendly manner.
   Status removeHashedKeyInternal(HashedKey hk, bool& skipSmallItemCache);
@@ -135,6 +163,9 @@ class EnginePair {
 
   JobScheduler* scheduler_;
 
+  // Moves the small item max size if set.
+  std::unique_ptr<AdaptiveSizeRouter> sizeRouter_;
+
   // These stats are bumped only once per call.
   mutable TLCounter insertCount_;
   mutable TLCounter lookupCount_;
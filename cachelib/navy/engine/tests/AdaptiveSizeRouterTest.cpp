@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <string>
+
+#include "cachelib/navy/engine/AdaptiveSizeRouter.h"
+
+namespace facebook::cachelib::navy {
+namespace {
+constexpr uint32_t kBucketSize{64};
+
+AdaptiveSizeRouter::Config makeConfig() {
+  AdaptiveSizeRouter::Config config;
+  config.bucketSize = kBucketSize;
+  config.maxSmallItemMaxSize = 1024;
+  config.updateInterval = std::chrono::seconds{3600};
+  config.hysteresis = 0.2;
+  config.stableWindows = 2;
+  config.minHits = 10;
+  return config;
+}
+
+// Records numItems inserts of size bytes and numHits hits for them.
+void record(AdaptiveSizeRouter& router,
+            bool small,
+            uint32_t size,
+            uint32_t numItems,
+            uint32_t numHits) {
+  for (uint32_t i = 0; i < numItems; i++) {
+    router.recordInsert(size, small);
+  }
+  for (uint32_t i = 0; i < numHits; i++) {
+    router.recordHit(size, small);
+  }
+}
+} // namespace
+
+TEST(AdaptiveSizeRouterTest, Config) {
+  {
+    auto config = makeConfig();
+    config.bucketSize = 0;
+    EXPECT_THROW(AdaptiveSizeRouter(std::move(config), 256),
+                 std::invalid_argument);
+  }
+  {
+    auto config = makeConfig();
+    config.maxSmallItemMaxSize = kBucketSize - 1;
+    EXPECT_THROW(AdaptiveSizeRouter(std::move(config), 256),
+                 std::invalid_argument);
+  }
+  {
+    auto config = makeConfig();
+    config.hysteresis = 1.5;
+    EXPECT_THROW(AdaptiveSizeRouter(std::move(config), 256),
+                 std::invalid_argument);
+  }
+  {
+    auto config = makeConfig();
+    config.stableWindows = 0;
+    EXPECT_THROW(AdaptiveSizeRouter(std::move(config), 256),
+                 std::invalid_argument);
+  }
+
+  // the initial threshold is aligned down to a bucket and kept in range
+  EXPECT_EQ(256, AdaptiveSizeRouter(makeConfig(), 300).getSmallItemMaxSize());
+  EXPECT_EQ(kBucketSize,
+            AdaptiveSizeRouter(makeConfig(), 10).getSmallItemMaxSize());
+  EXPECT_EQ(1024,
+            AdaptiveSizeRouter(makeConfig(), 4096).getSmallItemMaxSize());
+}
+
+TEST(AdaptiveSizeRouterTest, MoveUp) {
+  AdaptiveSizeRouter router{makeConfig(), 256};
+  for (int window = 0; window < 2; window++) {
+    EXPECT_EQ(256, router.getSmallItemMaxSize());
+    // small items get a hit per 100 bytes written, the large ones right above
+    // the threshold one per 1000 bytes.
+    record(router, true /* small */, 100, 100, 100);
+    record(router, false /* small */, 300, 100, 30);
+    router.update();
+  }
+  // moves past the bucket of the large items
+  EXPECT_EQ(320, router.getSmallItemMaxSize());
+
+  std::map<std::string, double> counters;
+  router.getCounters(
+      {[&counters](folly::StringPiece name, double count) {
+        counters[name.str()] = count;
+      }});
+  EXPECT_EQ(320, counters["navy_small_item_max_size"]);
+  EXPECT_EQ(1, counters["navy_small_item_max_size_changes"]);
+  EXPECT_EQ(10'000, counters["navy_bh_hits_per_mb_written"]);
+  EXPECT_EQ(1'000, counters["navy_bc_hits_per_mb_written"]);
+}
+
+TEST(AdaptiveSizeRouterTest, MoveDown) {
+  AdaptiveSizeRouter router{makeConfig(), 256};
+  for (int window = 0; window < 2; window++) {
+    EXPECT_EQ(256, router.getSmallItemMaxSize());
+    // the largest small items get a hit per 2000 bytes written, the large
+    // items one per 500 bytes.
+    record(router, true /* small */, 200, 100, 10);
+    record(router, false /* small */, 500, 100, 100);
+    router.update();
+  }
+  // moves below the bucket of the largest small items
+  EXPECT_EQ(192, router.getSmallItemMaxSize());
+}
+
+TEST(AdaptiveSizeRouterTest, SkipEmptyBuckets) {
+  // bimodal sizes with a gap of buckets around the threshold
+  AdaptiveSizeRouter router{makeConfig(), 256};
+  for (int window = 0; window < 2; window++) {
+    record(router, true /* small */, 60, 100, 100);
+    record(router, false /* small */, 700, 100, 10);
+    router.update();
+  }
+  EXPECT_EQ(704, router.getSmallItemMaxSize());
+}
+
+TEST(AdaptiveSizeRouterTest, Hysteresis) {
+  AdaptiveSizeRouter router{makeConfig(), 256};
+  for (int window = 0; window < 4; window++) {
+    // the small item engine leads by 10%, below the hysteresis
+    record(router, true /* small */, 100, 100, 110);
+    record(router, false /* small */, 300, 100, 300);
+    router.update();
+  }
+  EXPECT_EQ(256, router.getSmallItemMaxSize());
+}
+
+TEST(AdaptiveSizeRouterTest, StableWindows) {
+  AdaptiveSizeRouter router{makeConfig(), 256};
+  // windows that want to move up and down alternate
+  for (int window = 0; window < 4; window++) {
+    if (window % 2 == 0) {
+      record(router, true /* small */, 100, 100, 100);
+      record(router, false /* small */, 300, 100, 30);
+    } else {
+      record(router, true /* small */, 200, 100, 10);
+      record(router, false /* small */, 500, 100, 100);
+    }
+    router.update();
+  }
+  EXPECT_EQ(256, router.getSmallItemMaxSize());
+
+  // not enough hits to tell
+  for (int window = 0; window < 4; window++) {
+    record(router, true /* small */, 100, 100, 5);
+    record(router, false /* small */, 300, 100, 1);
+    router.update();
+  }
+  EXPECT_EQ(256, router.getSmallItemMaxSize());
+}
+
+TEST(AdaptiveSizeRouterTest, Bounds) {
+  {
+    AdaptiveSizeRouter router{makeConfig(), 1024};
+    // items over the max small item size never move to the small item engine
+    for (int window = 0; window < 4; window++) {
+      record(router, true /* small */, 100, 100, 100);
+      record(router, false /* small */, 2000, 100, 10);
+      router.update();
+    }
+    EXPECT_EQ(1024, router.getSmallItemMaxSize());
+  }
+  {
+    AdaptiveSizeRouter router{makeConfig(), kBucketSize};
+    // the first bucket always stays with the small item engine
+    for (int window = 0; window < 4; window++) {
+      record(router, true /* small */, 50, 100, 10);
+      record(router, false /* small */, 500, 100, 100);
+      router.update();
+    }
+    EXPECT_EQ(kBucketSize, router.getSmallItemMaxSize());
+  }
+}
+} // namespace facebook::cachelib::navy
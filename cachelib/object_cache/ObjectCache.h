@@ -39,7 +39,9 @@
 #include "cachelib/object_cache/ObjectCacheSizeController.h"
 #include "cachelib/object_cache/ObjectCacheSizeDistTracker.h"
 #include "cachelib/object_cache/persistence/Persistence.h"
+#include "cachelib/object_cache/persistence/StreamingPersistence.h"
 #include "cachelib/object_cache/persistence/gen-cpp2/persistent_data_types.h"
+#include "cachelib/object_cache/util/ObjectSizeHooks.h"
 #include "cachelib/object_cache/util/ThreadMemoryTracker.h"
 
 namespace facebook::cachelib::objcache2 {
@@ -51,6 +53,10 @@ class ObjectCacheTest;
 struct ObjectCacheItem {
   uintptr_t objectPtr;
   size_t objectSize;
+  // Set when the item is removed to stay within the size limit. The object
+  // may outlive the removal on a reader thread, so the reason travels with
+  // the item to its destructor.
+  bool evictedForSize{false};
 };
 
 enum class ObjectCacheDestructorContext {
@@ -146,6 +152,10 @@ class ObjectCache : public ObjectCacheBase<AllocatorT> {
 
  public:
   using ItemDestructor = std::function<void(ObjectCacheDestructorData)>;
+  // Returns the bytes to account for an object given the object and the size
+  // passed along with it.
+  using ObjectSizeHook =
+      std::function<size_t(const void* object, size_t objectSize)>;
   using Key = KAllocation::Key;
   using Config = ObjectCacheConfig<ObjectCache<AllocatorT>>;
   using EvictionPolicyConfig = typename AllocatorT::MMType::Config;
@@ -156,6 +166,8 @@ class ObjectCache : public ObjectCacheBase<AllocatorT> {
   using DeserializeCb = std::function<bool(Deserializer)>;
   using Persistor = Persistor<ObjectCache<AllocatorT>>;
   using Restorer = Restorer<ObjectCache<AllocatorT>>;
+  using StreamingPersistor = StreamingPersistor<ObjectCache<AllocatorT>>;
+  using StreamingRestorer = StreamingRestorer<ObjectCache<AllocatorT>>;
   using EvictionIterator = typename AllocatorT::EvictionIterator;
   using AccessIterator = typename AllocatorT::AccessIterator;
 
@@ -197,7 +209,7 @@ class ObjectCache : public ObjectCacheBase<AllocatorT> {
   // @param object       unique pointer for the object to be inserted.
   // @param objectSize   size of the object to be inserted.
   //                     if objectSizeTracking is enabled, a non-zero value must
-  //                     be passed.
+  //                     be passed, unless an object size hook is set.
   // @param ttlSecs      object expiring seconds.
   //
   // @throw cachelib::exception::RefcountOverflow if the item we are replacing
@@ -221,7 +233,7 @@ class ObjectCache : public ObjectCacheBase<AllocatorT> {
   // @param object       unique pointer for the object to be inserted.
   // @param objectSize   size of the object to be inserted.
   //                     if objectSizeTracking is enabled, a non-zero value must
-  //                     be passed.
+  //                     be passed, unless an object size hook is set.
   // @param ttlSecs      object expiring seconds.
   //
   // @throw cachelib::exception::RefcountOverflow if the item we are replacing
@@ -461,6 +473,24 @@ class ObjectCache : public ObjectCacheBase<AllocatorT> {
                                                   uint32_t ttl,
                                                   uint32_t creationTime);
 
+  // Apply the object size hook to the size passed with an object.
+  //
+  // @throw std::invalid_argument if the hook accounts the object as 0 bytes.
+  size_t getAccountedSize(const void* object, size_t objectSize) const;
+
+  // Evict objects from the tail of the eviction queues, starting with pool
+  // pid, until the total object size minus pendingBytes is within the limit.
+  // The object at keep is never evicted. pendingBytes are held by objects
+  // that already left the cache but are still referenced.
+  void evictToSizeLimit(PoolId pid, uintptr_t keep, size_t pendingBytes);
+
+  // Evict the last object of pool pid other than keep.
+  //
+  // @return false if there is nothing to evict
+  bool evictTailForSize(PoolId pid, uintptr_t keep);
+
+  PoolId getPoolId(folly::StringPiece key) const;
+
   // Allocate the placeholder and add it to the placeholder vector.
   //
   // @return true if the allocation is successful
@@ -514,6 +544,7 @@ class ObjectCache : public ObjectCacheBase<AllocatorT> {
   std::atomic<size_t> totalObjectSizeBytes_{0};
 
   TLCounter evictions_{};
+  TLCounter sizeLimitEvictions_{};
   TLCounter lookups_;
   TLCounter succL1Lookups_;
   TLCounter inserts_;
@@ -527,6 +558,7 @@ class ObjectCache : public ObjectCacheBase<AllocatorT> {
   friend class ObjectCacheSizeController;
 
   friend Persistor;
+  friend StreamingPersistor;
 };
 
 template <typename AllocatorT>
@@ -565,6 +597,12 @@ void ObjectCache<AllocatorT>::init() {
         auto& item = data.item;
 
         auto itemPtr = reinterpret_cast<ObjectCacheItem*>(item.getMemory());
+        if (ctx == ObjectCacheDestructorContext::kRemoved &&
+            itemPtr->evictedForSize) {
+          evictions_.inc();
+          sizeLimitEvictions_.inc();
+          ctx = ObjectCacheDestructorContext::kEvicted;
+        }
 
         SCOPE_EXIT {
           if (config_.objectSizeTrackingEnabled) {
@@ -700,7 +738,8 @@ ObjectCache<AllocatorT>::insertOrReplace(folly::StringPiece key,
                                          std::unique_ptr<T> object,
                                          size_t objectSize,
                                          uint32_t ttlSecs) {
-  if (config_.objectSizeTrackingEnabled && objectSize == 0) {
+  if (config_.objectSizeTrackingEnabled && objectSize == 0 &&
+      !config_.objectSizeHook) {
     throw std::invalid_argument(
         "Object size tracking is enabled but object size is set to be 0.");
   }
@@ -711,6 +750,7 @@ ObjectCache<AllocatorT>::insertOrReplace(folly::StringPiece key,
         "Object size tracking is not enabled but object size is set to be {}.",
         objectSize);
   }
+  objectSize = getAccountedSize(object.get(), objectSize);
 
   inserts_.inc();
 
@@ -737,9 +777,11 @@ ObjectCache<AllocatorT>::insertOrReplace(folly::StringPiece key,
   auto replaced = this->l1Cache_->insertOrReplace(handle);
 
   std::shared_ptr<T> replacedPtr = nullptr;
+  size_t replacedSize = 0;
   if (replaced) {
     replaces_.inc();
     auto itemPtr = reinterpret_cast<ObjectCacheItem*>(replaced->getMemory());
+    replacedSize = itemPtr->objectSize;
     // Just release the handle. Cache destorys object when all handles
     // released.
     auto deleter = [h = std::move(replaced)](T*) {};
@@ -747,6 +789,12 @@ ObjectCache<AllocatorT>::insertOrReplace(folly::StringPiece key,
                                      std::move(deleter));
   }
 
+  if (config_.sizeLimitOnInsertEnabled) {
+    // the replaced object leaves the total once the caller drops it
+    evictToSizeLimit(getPoolId(key), reinterpret_cast<uintptr_t>(ptr),
+                     replacedSize);
+  }
+
   // Release the object as it has been successfully inserted to the cache.
   object.release();
 
@@ -763,7 +811,8 @@ ObjectCache<AllocatorT>::insert(folly::StringPiece key,
                                 std::unique_ptr<T> object,
                                 size_t objectSize,
                                 uint32_t ttlSecs) {
-  if (config_.objectSizeTrackingEnabled && objectSize == 0) {
+  if (config_.objectSizeTrackingEnabled && objectSize == 0 &&
+      !config_.objectSizeHook) {
     throw std::invalid_argument(
         "Object size tracking is enabled but object size is set to be 0.");
   }
@@ -773,6 +822,7 @@ ObjectCache<AllocatorT>::insert(folly::StringPiece key,
         "Object size tracking is not enabled but object size is set. Are you "
         "trying to set TTL?");
   }
+  objectSize = getAccountedSize(object.get(), objectSize);
 
   inserts_.inc();
 
@@ -801,21 +851,119 @@ ObjectCache<AllocatorT>::insert(folly::StringPiece key,
   // when it's evicted/removed.
   object.release();
 
+  if (config_.sizeLimitOnInsertEnabled) {
+    evictToSizeLimit(getPoolId(key), reinterpret_cast<uintptr_t>(ptr), 0);
+  }
+
   // Use custom deleter
   auto deleter = Deleter<T>(std::move(handle));
   return {AllocStatus::kSuccess, std::shared_ptr<T>(ptr, std::move(deleter))};
 }
 
+template <typename AllocatorT>
+PoolId ObjectCache<AllocatorT>::getPoolId(folly::StringPiece key) const {
+  if (config_.l1NumShards <= 1) {
+    return 0;
+  }
+  auto hash = cachelib::MurmurHash2{}(key.data(), key.size());
+  return static_cast<PoolId>(hash % config_.l1NumShards);
+}
+
 template <typename AllocatorT>
 typename AllocatorT::WriteHandle ObjectCache<AllocatorT>::allocateFromL1(
     folly::StringPiece key, uint32_t ttl, uint32_t creationTime) {
-  PoolId poolId = 0;
-  if (config_.l1NumShards > 1) {
-    auto hash = cachelib::MurmurHash2{}(key.data(), key.size());
-    poolId = static_cast<PoolId>(hash % config_.l1NumShards);
+  return this->l1Cache_->allocate(getPoolId(key), key, sizeof(ObjectCacheItem),
+                                  ttl, creationTime);
+}
+
+template <typename AllocatorT>
+size_t ObjectCache<AllocatorT>::getAccountedSize(const void* object,
+                                                 size_t objectSize) const {
+  if (!config_.objectSizeHook) {
+    return objectSize;
+  }
+  const auto size = config_.objectSizeHook(object, objectSize);
+  if (size == 0) {
+    throw std::invalid_argument("Object size hook accounted 0 bytes.");
+  }
+  return size;
+}
+
+template <typename AllocatorT>
+void ObjectCache<AllocatorT>::evictToSizeLimit(PoolId pid,
+                                               uintptr_t keep,
+                                               size_t pendingBytes) {
+  const auto limit = config_.totalObjectSizeLimit + pendingBytes;
+  for (size_t i = 0; i < config_.l1NumShards; i++) {
+    const auto poolId = static_cast<PoolId>((pid + i) % config_.l1NumShards);
+    while (getTotalObjectSize() > limit) {
+      if (!evictTailForSize(poolId, keep)) {
+        break;
+      }
+    }
+    if (getTotalObjectSize() <= limit) {
+      return;
+    }
   }
-  return this->l1Cache_->allocate(poolId, key, sizeof(ObjectCacheItem), ttl,
-                                  creationTime);
+}
+
+template <typename AllocatorT>
+bool ObjectCache<AllocatorT>::evictTailForSize(PoolId pid, uintptr_t keep) {
+  // Pick the candidate under the eviction queue lock but remove it after
+  // letting go of the lock, which removing it needs.
+  std::string key;
+  uintptr_t objectPtr = 0;
+  {
+    auto itr = getEvictionIterator(pid);
+    for (uint32_t tries = 0;
+         itr && (config_.evictionSearchLimit == 0 ||
+                 tries < config_.evictionSearchLimit);
+         ++itr, ++tries) {
+      const auto* item =
+          reinterpret_cast<const ObjectCacheItem*>(itr->getMemory());
+      if (item->objectPtr != keep) {
+        key = itr->getKey().str();
+        objectPtr = item->objectPtr;
+        break;
+      }
+    }
+  }
+  if (objectPtr == 0) {
+    return false;
+  }
+
+  auto handle = this->l1Cache_->peek(key);
+  if (!handle) {
+    // removed in the meantime, which frees space as well
+    return true;
+  }
+  // the item memory is ours even through a read handle
+  auto* item = const_cast<ObjectCacheItem*>(
+      handle->template getMemoryAs<ObjectCacheItem>());
+  if (item->objectPtr != objectPtr) {
+    // replaced in the meantime
+    return true;
+  }
+  // Mark the item before removing it: once removed, the destructor runs on
+  // whichever thread lets go of it last. Holding the handle keeps it from
+  // running before the mark is undone on a failed remove.
+  item->evictedForSize = true;
+  if (this->l1Cache_->remove(handle) != AllocatorT::RemoveRes::kSuccess) {
+    // removed in the meantime
+    item->evictedForSize = false;
+    return true;
+  }
+  // Stop accounting the object now rather than when the last reader lets go
+  // of it, so one object in use does not make us evict more.
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Watomic-alignment"
+  const auto size = __sync_lock_test_and_set(&(item->objectSize), 0);
+#pragma clang diagnostic pop
+  totalObjectSizeBytes_.fetch_sub(size, std::memory_order_relaxed);
+
+  // destroys the object here unless it is still referenced elsewhere
+  handle.reset();
+  return true;
 }
 
 template <typename AllocatorT>
@@ -876,6 +1024,8 @@ void ObjectCache<AllocatorT>::getObjectCacheCounters(
           util::CounterVisitor::CounterType::RATE);
   visitor("objcache.evictions", evictions_.get(),
           util::CounterVisitor::CounterType::RATE);
+  visitor("objcache.evictions.size_limit", sizeLimitEvictions_.get(),
+          util::CounterVisitor::CounterType::RATE);
   visitor("objcache.object_size_bytes", getTotalObjectSize());
   if (sizeController_) {
     sizeController_->getCounters(visitor);
@@ -904,7 +1054,8 @@ ObjectCache<AllocatorT>::serializeConfigParams() const {
 
 template <typename AllocatorT>
 bool ObjectCache<AllocatorT>::persist() {
-  if (config_.persistBaseFilePath.empty() || !config_.serializeCb) {
+  if ((config_.persistBaseFilePath.empty() && !config_.persistStreams) ||
+      !config_.serializeCb) {
     return false;
   }
 
@@ -913,6 +1064,12 @@ bool ObjectCache<AllocatorT>::persist() {
     return false;
   }
 
+  if (config_.persistStreams) {
+    StreamingPersistor persistor(
+        config_.persistThreadCount, config_.persistStreams, config_.serializeCb,
+        config_.persistCompressionLevel, config_.persistChunkSize, *this);
+    return persistor.run();
+  }
   Persistor persistor(config_.persistThreadCount, config_.persistBaseFilePath,
                       config_.serializeCb, *this);
   return persistor.run();
@@ -920,9 +1077,15 @@ bool ObjectCache<AllocatorT>::persist() {
 
 template <typename AllocatorT>
 bool ObjectCache<AllocatorT>::recover() {
-  if (config_.persistBaseFilePath.empty() || !config_.deserializeCb) {
+  if ((config_.persistBaseFilePath.empty() && !config_.persistStreams) ||
+      !config_.deserializeCb) {
     return false;
   }
+  if (config_.persistStreams) {
+    StreamingRestorer restorer(config_.persistStreams, config_.deserializeCb,
+                               *this);
+    return restorer.run();
+  }
   Restorer restorer(config_.persistBaseFilePath, config_.deserializeCb, *this);
   return restorer.run();
 }
@@ -950,6 +1113,9 @@ void ObjectCache<AllocatorT>::mutateObject(const std::shared_ptr<T>& object,
     ObjectCacheItem* o = reinterpret_cast<ObjectCacheItem*>(hdl->getMemory());
     __atomic_fetch_add(&(o->objectSize), memUsageDiff, __ATOMIC_SEQ_CST);
     totalObjectSizeBytes_.fetch_add(memUsageDiff, std::memory_order_relaxed);
+    if (config_.sizeLimitOnInsertEnabled) {
+      evictToSizeLimit(getPoolId(hdl->getKey()), o->objectPtr, 0);
+    }
   } else if (memUsageAfter < memUsageBefore) { // updated to a smaller value
     memUsageDiff = memUsageBefore - memUsageAfter;
     // do atomic update on objectSize
@@ -980,15 +1146,18 @@ bool ObjectCache<AllocatorT>::updateObjectSize(const std::shared_ptr<T>& object,
     return false;
   }
 
+  newSize = getAccountedSize(object.get(), newSize);
+
   // do atomic update on objectSize
-  const auto oldSize = __sync_lock_test_and_set(
-      &(reinterpret_cast<ObjectCacheItem*>(
-            getWriteHandleRefInternal<T>(object)->getMemory())
-            ->objectSize),
-      newSize);
+  auto& hdl = getWriteHandleRefInternal<T>(object);
+  auto* item = reinterpret_cast<ObjectCacheItem*>(hdl->getMemory());
+  const auto oldSize = __sync_lock_test_and_set(&(item->objectSize), newSize);
   if (newSize > oldSize) {
     totalObjectSizeBytes_.fetch_add(newSize - oldSize,
                                     std::memory_order_relaxed);
+    if (config_.sizeLimitOnInsertEnabled) {
+      evictToSizeLimit(getPoolId(hdl->getKey()), item->objectPtr, 0);
+    }
   } else if (newSize < oldSize) {
     totalObjectSizeBytes_.fetch_sub(oldSize - newSize,
                                     std::memory_order_relaxed);
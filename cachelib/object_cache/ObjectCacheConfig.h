@@ -22,6 +22,7 @@
 #include "cachelib/allocator/KAllocation.h"
 #include "cachelib/common/EventInterface.h"
 #include "cachelib/common/Throttler.h"
+#include "cachelib/object_cache/persistence/StreamingPersistence.h"
 
 namespace facebook {
 namespace cachelib {
@@ -35,6 +36,7 @@ struct ObjectCacheConfig {
   using SerializeCb = typename ObjectCache::SerializeCb;
   using DeserializeCb = typename ObjectCache::DeserializeCb;
   using EvictionPolicyConfig = typename ObjectCache::EvictionPolicyConfig;
+  using ObjectSizeHook = typename ObjectCache::ObjectSizeHook;
 
   // Set cache name as a string
   ObjectCacheConfig& setCacheName(const std::string& _cacheName);
@@ -53,6 +55,22 @@ struct ObjectCacheConfig {
                                       size_t _totalObjectSizeLimit = 0,
                                       int _sizeControllerIntervalMs = 0);
 
+  // Set the cache capacity for a "size-aware" object cache that keeps the
+  // total object size within totalObjectSizeLimit on every insert rather
+  // than every size controller tick. An insert or size update that pushes the
+  // total above the limit evicts objects from the tail of the eviction queue
+  // right away, on the calling thread, so no size controller is needed.
+  // l1EntriesLimit still bounds the number of objects.
+  ObjectCacheConfig& setSizeAwareCapacity(size_t _l1EntriesLimit,
+                                          size_t _totalObjectSizeLimit);
+
+  // Set the hook that turns the size passed on insert or updateObjectSize
+  // into the bytes the object is accounted for, e.g. rounding it up to the
+  // allocator size class (see util/ObjectSizeHooks.h). With a hook set, the
+  // size passed may be 0 if the hook works it out from the object itself.
+  // Needs object size tracking.
+  ObjectCacheConfig& setObjectSizeHook(ObjectSizeHook hook);
+
   // Set the number of internal cache pools to be used for sharding.
   // This determines the number of concurrent inserts/removes. Default is 1
   ObjectCacheConfig& setNumShards(size_t _l1NumShards);
@@ -130,6 +148,24 @@ struct ObjectCacheConfig {
       SerializeCb serializeCallback,
       DeserializeCb deserializeCallback);
 
+  // Run in a multi-thread mode with the streaming format: every thread
+  // streams a shard of its own as zstd compressed chunks, and restore reads
+  // all the shards in parallel. Eviction order is not guaranteed to persist.
+  // @param threadCount          number of threads, and shards, to persist
+  //                             with; restore uses one thread per shard
+  // @param streams              streams to write and read the shards through,
+  //                             e.g. makeFilePersistStreams(baseFilePath)
+  // @param serializeCallback    callback to serialize an object
+  // @param deserializeCallback  callback to deserialize an object
+  // @param compressionLevel     zstd compression level; 0 stores the chunks
+  //                             uncompressed
+  ObjectCacheConfig& enableStreamingPersistence(
+      uint32_t threadCount,
+      PersistStreams streams,
+      SerializeCb serializeCallback,
+      DeserializeCb deserializeCallback,
+      int compressionLevel = kDefaultPersistCompressionLevel);
+
   // Enable tracking Jemalloc external fragmentation.
   ObjectCacheConfig& enableFragmentationTracking();
 
@@ -183,6 +219,14 @@ struct ObjectCacheConfig {
   // disabled.
   int sizeControllerIntervalMs{0};
 
+  // If this is enabled, inserts and size updates evict objects to keep the
+  // total object size within totalObjectSizeLimit
+  bool sizeLimitOnInsertEnabled{false};
+
+  // Maps the size given on insert to the accounted object size. Identity if
+  // not set.
+  ObjectSizeHook objectSizeHook{};
+
   // With size controller enabled, if total object size is above this limit,
   // the cache will start evicting
   size_t totalObjectSizeLimit{0};
@@ -215,6 +259,19 @@ struct ObjectCacheConfig {
   // Empty means cache persistence is not enabled.
   std::string persistBaseFilePath{};
 
+  // Streams to persist to in the streaming format. If set, it is used instead
+  // of persistBaseFilePath.
+  PersistStreams persistStreams{};
+
+  static constexpr int kDefaultPersistCompressionLevel{3};
+
+  // zstd compression level of the streaming format; 0 means uncompressed
+  int persistCompressionLevel{kDefaultPersistCompressionLevel};
+
+  // Uncompressed size of a chunk of the streaming format. Every persist
+  // thread buffers up to one chunk.
+  size_t persistChunkSize{4 * 1024 * 1024};
+
   // Serialize callback for cache persistence
   SerializeCb serializeCb{};
 
@@ -262,6 +319,29 @@ ObjectCacheConfig<T>& ObjectCacheConfig<T>::setCacheCapacity(
   return *this;
 }
 
+template <typename T>
+ObjectCacheConfig<T>& ObjectCacheConfig<T>::setSizeAwareCapacity(
+    size_t _l1EntriesLimit, size_t _totalObjectSizeLimit) {
+  if (!_totalObjectSizeLimit) {
+    throw std::invalid_argument(
+        "totalObjectSizeLimit should be provided to bound the cache size on "
+        "insert");
+  }
+  l1EntriesLimit = _l1EntriesLimit;
+  totalObjectSizeLimit = _totalObjectSizeLimit;
+  sizeControllerIntervalMs = 0;
+  objectSizeTrackingEnabled = true;
+  sizeLimitOnInsertEnabled = true;
+  return *this;
+}
+
+template <typename T>
+ObjectCacheConfig<T>& ObjectCacheConfig<T>::setObjectSizeHook(
+    ObjectSizeHook hook) {
+  objectSizeHook = std::move(hook);
+  return *this;
+}
+
 template <typename T>
 ObjectCacheConfig<T>& ObjectCacheConfig<T>::setNumShards(size_t _l1NumShards) {
   l1NumShards = _l1NumShards;
@@ -375,6 +455,52 @@ ObjectCacheConfig<T>& ObjectCacheConfig<T>::enablePersistenceWithEvictionOrder(
   return *this;
 }
 
+template <typename T>
+ObjectCacheConfig<T>& ObjectCacheConfig<T>::enableStreamingPersistence(
+    uint32_t threadCount,
+    PersistStreams streams,
+    SerializeCb serializeCallback,
+    DeserializeCb deserializeCallback,
+    int compressionLevel) {
+  if (persistenceEnabled) {
+    throw std::invalid_argument("cache persistence is already enabled");
+  }
+
+  if (threadCount == 0) {
+    throw std::invalid_argument(
+        "A non-zero thread count must be set to enable cache persistence");
+  }
+
+  if (threadCount > streaming::kMaxShards) {
+    throw std::invalid_argument(
+        folly::sformat("Persist thread count {} exceeds the maximum of {}",
+                       threadCount, streaming::kMaxShards));
+  }
+
+  if (!streams) {
+    throw std::invalid_argument(
+        "Valid persist streams must be provided to enable cache persistence");
+  }
+
+  if (!serializeCallback || !deserializeCallback) {
+    throw std::invalid_argument(
+        "Serialize and deserialize callback must be set to enable cache "
+        "persistence");
+  }
+
+  if (compressionLevel < ZSTD_minCLevel() ||
+      compressionLevel > ZSTD_maxCLevel()) {
+    throw std::invalid_argument(folly::sformat(
+        "Invalid persist compression level: {}", compressionLevel));
+  }
+  persistThreadCount = threadCount;
+  persistStreams = std::move(streams);
+  serializeCb = std::move(serializeCallback);
+  deserializeCb = std::move(deserializeCallback);
+  persistCompressionLevel = compressionLevel;
+  return *this;
+}
+
 template <typename T>
 ObjectCacheConfig<T>& ObjectCacheConfig<T>::setItemReaperInterval(
     std::chrono::milliseconds _reaperInterval) {
@@ -418,7 +544,7 @@ const ObjectCacheConfig<T>& ObjectCacheConfig<T>::validate() const {
         "ItemDestructor is mandatory, but not provided");
   }
 
-  if (objectSizeTrackingEnabled) {
+  if (objectSizeTrackingEnabled && !sizeLimitOnInsertEnabled) {
     if ((sizeControllerIntervalMs && !totalObjectSizeLimit) ||
         (!sizeControllerIntervalMs && totalObjectSizeLimit)) {
       throw std::invalid_argument(
@@ -433,6 +559,11 @@ const ObjectCacheConfig<T>& ObjectCacheConfig<T>::validate() const {
         "tracking");
   }
 
+  if (objectSizeHook && !objectSizeTrackingEnabled) {
+    throw std::invalid_argument(
+        "Object size tracking has to be enabled to use an object size hook");
+  }
+
   if (objectSizeDistributionTrackingEnabled && !objectSizeTrackingEnabled) {
     throw std::invalid_argument(
         "Object size tracking has to be enabled to track object size "
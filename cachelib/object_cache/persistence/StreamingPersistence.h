@@ -0,0 +1,651 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <folly/File.h>
+#include <folly/Format.h>
+#include <folly/MPMCQueue.h>
+#include <folly/String.h>
+#include <folly/hash/Checksum.h>
+#include <folly/io/IOBuf.h>
+#include <folly/io/IOBufQueue.h>
+#include <folly/logging/xlog.h>
+#include <zstd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cachelib/common/Time.h"
+#include "cachelib/persistence/PersistenceManager.h"
+
+namespace facebook::cachelib::objcache2 {
+
+// Where the streaming format (see ObjectCacheConfig::enableStreamingPersistence)
+// goes: shard i of a persist is written through makeWriter(i) and read back
+// through makeReader(i). Every shard is written and read by a thread of its
+// own, so the streams do not need to be thread safe.
+struct PersistStreams {
+  using WriterFactory =
+      std::function<std::unique_ptr<persistence::PersistenceStreamWriter>(
+          uint32_t shard)>;
+  using ReaderFactory =
+      std::function<std::unique_ptr<persistence::PersistenceStreamReader>(
+          uint32_t shard)>;
+
+  WriterFactory makeWriter;
+  ReaderFactory makeReader;
+
+  explicit operator bool() const { return makeWriter && makeReader; }
+};
+
+// Streams of the shards in the files "baseFilePath_i".
+inline PersistStreams makeFilePersistStreams(std::string baseFilePath) {
+  PersistStreams streams;
+  streams.makeWriter = [baseFilePath](uint32_t shard) {
+    return std::make_unique<persistence::FilePersistenceStreamWriter>(
+        folly::File(folly::sformat("{}_{}", baseFilePath, shard),
+                    O_CREAT | O_WRONLY | O_TRUNC));
+  };
+  streams.makeReader = [baseFilePath](uint32_t shard) {
+    return std::make_unique<persistence::FilePersistenceStreamReader>(
+        folly::File(folly::sformat("{}_{}", baseFilePath, shard), O_RDONLY));
+  };
+  return streams;
+}
+
+namespace streaming {
+// Every shard starts with a ShardHeader followed by chunks. A chunk is a
+// ChunkHeader and storedSize bytes: a single zstd frame, or the records as is
+// when compression is off or does not pay off. A chunk without items ends
+// the shard, so a truncated shard is told apart from a complete one.
+// The records of a chunk are a RecordHeader followed by the key and the
+// serialized payload each.
+constexpr uint32_t kShardMagic = 0x5453434f; // "OCST"
+constexpr uint32_t kFormatVersion = 2;
+constexpr uint32_t kChunkCompressed = 1;
+// Upper bound on the number of shards, i.e. persist threads. The restorer
+// starts a thread per shard, so a corrupted count must not be trusted.
+constexpr uint32_t kMaxShards = 1024;
+
+struct ShardHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t shardId;
+  uint32_t numShards;
+};
+
+struct ChunkHeader {
+  uint32_t numItems;
+  uint32_t flags;
+  uint32_t rawSize;
+  uint32_t storedSize;
+  uint32_t checksum; // crc32 of the raw records
+};
+
+struct RecordHeader {
+  uint32_t keySize;
+  uint32_t payloadSize;
+  uint32_t objectSize;
+  uint32_t expiryTime;
+};
+
+template <typename T>
+T readHeader(persistence::PersistenceStreamReader& reader) {
+  auto buf = reader.read(sizeof(T));
+  if (buf.length() != sizeof(T)) {
+    throw std::runtime_error("Unexpected end of persist stream");
+  }
+  T header;
+  std::memcpy(&header, buf.data(), sizeof(T));
+  return header;
+}
+
+template <typename T>
+void writeHeader(persistence::PersistenceStreamWriter& writer,
+                 const T& header) {
+  writer.write(folly::IOBuf(folly::IOBuf::COPY_BUFFER, &header, sizeof(T)));
+}
+} // namespace streaming
+
+template <typename ObjectCache>
+class StreamingPersistWorker {
+ public:
+  struct WorkUnit {
+    typename ObjectCache::Key key;
+    uintptr_t objectPtr;
+    size_t objectSize;
+    uint32_t expiryTime;
+  };
+  // an empty batch tells the worker to finish its shard
+  using Batch = std::vector<WorkUnit>;
+  using SerializeCb = typename ObjectCache::SerializeCb;
+
+  StreamingPersistWorker(
+      uint32_t id,
+      uint32_t numShards,
+      std::unique_ptr<persistence::PersistenceStreamWriter> writer,
+      SerializeCb& serializeCb,
+      folly::MPMCQueue<Batch>& queue,
+      int compressionLevel,
+      size_t chunkSize)
+      : id_(id),
+        numShards_(numShards),
+        writer_(std::move(writer)),
+        serializeCb_(serializeCb),
+        queue_(queue),
+        compressionLevel_(compressionLevel),
+        chunkSize_(chunkSize) {}
+
+  // Consume batches until the persistor is done and finish the shard. Once
+  // the stream fails the rest of the batches are drained and dropped.
+  void work();
+
+  bool failed() const { return failed_; }
+
+  uint64_t getNumPersisted() const { return numPersisted_; }
+
+  uint64_t getBytesWritten() const { return bytesWritten_; }
+
+  std::string getName() const {
+    return folly::sformat("StreamingPersistWorker_{}", id_);
+  }
+
+ private:
+  void add(const WorkUnit& unit);
+
+  // Compress and write the pending chunk.
+  void writeChunk();
+
+  const uint32_t id_;
+  const uint32_t numShards_;
+  std::unique_ptr<persistence::PersistenceStreamWriter> writer_;
+  SerializeCb& serializeCb_;
+  folly::MPMCQueue<Batch>& queue_;
+  const int compressionLevel_;
+  const size_t chunkSize_;
+
+  // records of the pending chunk; small payloads are packed into the buffers
+  // of the queue and large ones are chained as they are
+  folly::IOBufQueue chunk_{folly::IOBufQueue::cacheChainLength()};
+  uint32_t chunkItems_{0};
+  std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> cctx_{nullptr,
+                                                              ZSTD_freeCCtx};
+
+  bool failed_{false};
+  uint64_t numPersisted_{0};
+  uint64_t bytesWritten_{0};
+};
+
+// Persists the objects of the cache in the streaming format. The cache is
+// walked by a single producer that hands out batches of objects; every
+// worker serializes the objects it gets into chunks of its own shard and
+// compresses and writes them as they fill up, so serialization, compression
+// and writing of all the shards go on in parallel.
+template <typename ObjectCache>
+class StreamingPersistor {
+ public:
+  using Worker = StreamingPersistWorker<ObjectCache>;
+  using WorkUnit = typename Worker::WorkUnit;
+  using Batch = typename Worker::Batch;
+  using SerializeCb = typename Worker::SerializeCb;
+
+  StreamingPersistor(uint32_t threadCount,
+                     const PersistStreams& streams,
+                     SerializeCb& serializeCb,
+                     int compressionLevel,
+                     size_t chunkSize,
+                     ObjectCache& objCache);
+
+  // @return false if a shard could not be opened or written
+  bool run();
+
+  uint32_t getNumExpired() const { return numExpired_; }
+
+  uint64_t getNumPersisted() const { return numPersisted_; }
+
+  uint64_t getBytesWritten() const { return bytesWritten_; }
+
+ private:
+  static constexpr size_t kBatchSize{256};
+  // batches in flight per worker
+  static constexpr size_t kQueueSizePerWorker{8};
+
+  bool initSuccess_{true};
+  folly::MPMCQueue<Batch> queue_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  ObjectCache& objCache_;
+  uint32_t numExpired_{0};
+  uint64_t numPersisted_{0};
+  uint64_t bytesWritten_{0};
+};
+
+// Restores the objects of every shard in a thread of its own, deserializing
+// them straight out of the decompressed chunks into the cache.
+template <typename ObjectCache>
+class StreamingRestorer {
+ public:
+  using DeserializeCb = typename ObjectCache::DeserializeCb;
+
+  StreamingRestorer(const PersistStreams& streams,
+                    DeserializeCb& deserializeCb,
+                    ObjectCache& objCache)
+      : streams_(streams), deserializeCb_(deserializeCb), objCache_(objCache) {}
+
+  // @return false if a shard is missing, truncated or corrupted; objects
+  //         restored from the other shards stay in the cache
+  bool run();
+
+  uint32_t getNumExpired() const { return numExpired_; }
+
+  uint64_t getNumRestored() const { return numRestored_; }
+
+ private:
+  // Restore one shard, throwing if it can not be read.
+  void restoreShard(uint32_t shard,
+                    persistence::PersistenceStreamReader& reader);
+
+  const PersistStreams& streams_;
+  DeserializeCb& deserializeCb_;
+  ObjectCache& objCache_;
+  std::atomic<uint32_t> numExpired_{0};
+  std::atomic<uint64_t> numRestored_{0};
+};
+
+template <typename ObjectCache>
+void StreamingPersistWorker<ObjectCache>::work() {
+  try {
+    if (compressionLevel_ != 0) {
+      cctx_.reset(ZSTD_createCCtx());
+      ZSTD_CCtx_setParameter(cctx_.get(), ZSTD_c_compressionLevel,
+                             compressionLevel_);
+      ZSTD_CCtx_setParameter(cctx_.get(), ZSTD_c_checksumFlag, 1);
+    }
+    streaming::writeHeader(
+        *writer_,
+        streaming::ShardHeader{streaming::kShardMagic,
+                               streaming::kFormatVersion, id_, numShards_});
+    bytesWritten_ += sizeof(streaming::ShardHeader);
+  } catch (const std::exception& e) {
+    XLOGF(ERR, "{} failed to start shard, reason = {}", getName(),
+          folly::exceptionStr(e));
+    failed_ = true;
+  }
+
+  Batch batch;
+  while (true) {
+    queue_.blockingRead(batch);
+    if (batch.empty()) {
+      break;
+    }
+    if (failed_) {
+      continue;
+    }
+    try {
+      for (const auto& unit : batch) {
+        add(unit);
+      }
+    } catch (const std::exception& e) {
+      XLOGF(ERR, "{} failed to write shard, reason = {}", getName(),
+            folly::exceptionStr(e));
+      failed_ = true;
+    }
+  }
+
+  if (failed_) {
+    return;
+  }
+  try {
+    writeChunk();
+    // end of shard
+    streaming::writeHeader(*writer_, streaming::ChunkHeader{0, 0, 0, 0, 0});
+    bytesWritten_ += sizeof(streaming::ChunkHeader);
+    writer_->flush();
+  } catch (const std::exception& e) {
+    XLOGF(ERR, "{} failed to finish shard, reason = {}", getName(),
+          folly::exceptionStr(e));
+    failed_ = true;
+  }
+}
+
+template <typename ObjectCache>
+void StreamingPersistWorker<ObjectCache>::add(const WorkUnit& unit) {
+  auto payload = serializeCb_(
+      typename ObjectCache::Serializer(unit.key, unit.objectPtr));
+  if (!payload) {
+    XLOG_EVERY_N(ERR, 1000) << folly::sformat(
+        "Failed to serialize object for key = {}", unit.key);
+    return;
+  }
+
+  streaming::RecordHeader header{
+      static_cast<uint32_t>(unit.key.size()),
+      static_cast<uint32_t>(payload->computeChainDataLength()),
+      static_cast<uint32_t>(unit.objectSize), unit.expiryTime};
+  chunk_.append(&header, sizeof(header));
+  chunk_.append(unit.key.data(), unit.key.size());
+  chunk_.append(std::move(payload), true /* pack */);
+  chunkItems_++;
+  numPersisted_++;
+
+  if (chunk_.chainLength() >= chunkSize_) {
+    writeChunk();
+  }
+}
+
+template <typename ObjectCache>
+void StreamingPersistWorker<ObjectCache>::writeChunk() {
+  if (chunkItems_ == 0) {
+    return;
+  }
+  auto raw = chunk_.move();
+  const size_t rawSize = raw->computeChainDataLength();
+  uint32_t checksum = ~0U;
+  for (auto range : *raw) {
+    checksum = folly::crc32(range.data(), range.size(), checksum);
+  }
+
+  std::unique_ptr<folly::IOBuf> compressed;
+  if (cctx_) {
+    // feed the chain as it is rather than coalescing it first
+    compressed = folly::IOBuf::create(ZSTD_compressBound(rawSize));
+    ZSTD_CCtx_reset(cctx_.get(), ZSTD_reset_session_only);
+    ZSTD_CCtx_setPledgedSrcSize(cctx_.get(), rawSize);
+    ZSTD_outBuffer out{compressed->writableData(), compressed->capacity(), 0};
+    auto check = [](size_t ret) {
+      if (ZSTD_isError(ret)) {
+        throw std::runtime_error(folly::sformat(
+            "Failed to compress chunk: {}", ZSTD_getErrorName(ret)));
+      }
+      return ret;
+    };
+    for (auto range : *raw) {
+      ZSTD_inBuffer in{range.data(), range.size(), 0};
+      while (in.pos < in.size) {
+        check(ZSTD_compressStream2(cctx_.get(), &out, &in, ZSTD_e_continue));
+      }
+    }
+    ZSTD_inBuffer end{nullptr, 0, 0};
+    while (check(ZSTD_compressStream2(cctx_.get(), &out, &end, ZSTD_e_end)) !=
+           0) {
+    }
+    compressed->append(out.pos);
+    // incompressible payloads are stored as they are
+    if (out.pos >= rawSize) {
+      compressed.reset();
+    }
+  }
+
+  auto& data = compressed ? compressed : raw;
+  const size_t storedSize = compressed ? compressed->length() : rawSize;
+  streaming::writeHeader(
+      *writer_,
+      streaming::ChunkHeader{chunkItems_,
+                             compressed ? streaming::kChunkCompressed : 0u,
+                             static_cast<uint32_t>(rawSize),
+                             static_cast<uint32_t>(storedSize), checksum});
+  writer_->write(std::move(*data));
+  // the writer may hold on to the buffers until flushed
+  writer_->flush();
+  bytesWritten_ += sizeof(streaming::ChunkHeader) + storedSize;
+  chunkItems_ = 0;
+}
+
+template <typename ObjectCache>
+StreamingPersistor<ObjectCache>::StreamingPersistor(
+    uint32_t threadCount,
+    const PersistStreams& streams,
+    SerializeCb& serializeCb,
+    int compressionLevel,
+    size_t chunkSize,
+    ObjectCache& objCache)
+    : queue_(threadCount * kQueueSizePerWorker), objCache_(objCache) {
+  for (uint32_t i = 0; i < threadCount; i++) {
+    try {
+      workers_.emplace_back(std::make_unique<Worker>(
+          i, threadCount, streams.makeWriter(i), serializeCb, queue_,
+          compressionLevel, chunkSize));
+    } catch (const std::exception& e) {
+      XLOGF(ERR,
+            "StreamingPersistor initialization failed: Failed to open shard "
+            "{}, reason = {}",
+            i, folly::exceptionStr(e));
+      initSuccess_ = false;
+      break;
+    }
+  }
+}
+
+template <typename ObjectCache>
+bool StreamingPersistor<ObjectCache>::run() {
+  if (!initSuccess_) {
+    return false;
+  }
+  std::vector<std::thread> threads;
+  for (auto& worker : workers_) {
+    threads.emplace_back([&worker] { worker->work(); });
+  }
+
+  std::vector<typename ObjectCache::EvictionIterator> evictionItrs;
+  auto poolIds = objCache_.l1Cache_->getRegularPoolIds();
+  for (auto poolId : poolIds) {
+    evictionItrs.emplace_back(objCache_.getEvictionIterator(poolId));
+  }
+
+  Batch batch;
+  batch.reserve(kBatchSize);
+  size_t finished = 0;
+  // round-robin each eviction iterator until all iterators are finished
+  while (finished < evictionItrs.size()) {
+    finished = 0;
+    for (auto& itr : evictionItrs) {
+      if (!itr) {
+        finished++;
+        continue;
+      }
+      // no need to persist if item is already expired
+      if (itr->isExpired()) {
+        numExpired_++;
+      } else {
+        auto itemPtr =
+            reinterpret_cast<typename ObjectCache::Item*>(itr->getMemory());
+        batch.push_back(WorkUnit{itr->getKey(), itemPtr->objectPtr,
+                                 itemPtr->objectSize, itr->getExpiryTime()});
+        if (batch.size() == kBatchSize) {
+          queue_.blockingWrite(std::move(batch));
+          batch = Batch{};
+          batch.reserve(kBatchSize);
+        }
+      }
+      ++itr;
+    }
+  }
+  if (!batch.empty()) {
+    queue_.blockingWrite(std::move(batch));
+  }
+  // one end marker for every worker
+  for (size_t i = 0; i < workers_.size(); i++) {
+    queue_.blockingWrite(Batch{});
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  bool success = true;
+  for (auto& worker : workers_) {
+    success = success && !worker->failed();
+    numPersisted_ += worker->getNumPersisted();
+    bytesWritten_ += worker->getBytesWritten();
+  }
+  XLOGF(INFO,
+        "StreamingPersistor persisted {} objects in {} bytes, found {} "
+        "expired objects",
+        numPersisted_, bytesWritten_, numExpired_);
+  return success;
+}
+
+template <typename ObjectCache>
+bool StreamingRestorer<ObjectCache>::run() {
+  // the first shard tells how many there are
+  std::unique_ptr<persistence::PersistenceStreamReader> firstReader;
+  uint32_t numShards = 0;
+  try {
+    firstReader = streams_.makeReader(0);
+    auto header =
+        streaming::readHeader<streaming::ShardHeader>(*firstReader);
+    if (header.magic != streaming::kShardMagic ||
+        header.version != streaming::kFormatVersion || header.shardId != 0 ||
+        header.numShards == 0 || header.numShards > streaming::kMaxShards) {
+      throw std::runtime_error("Invalid shard header");
+    }
+    numShards = header.numShards;
+  } catch (const std::exception& e) {
+    XLOGF(ERR,
+          "StreamingRestorer initialization failed: Failed to read shard 0, "
+          "reason = {}",
+          folly::exceptionStr(e));
+    return false;
+  }
+
+  std::atomic<bool> success{true};
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < numShards; i++) {
+    threads.emplace_back([&, i] {
+      try {
+        if (i == 0) {
+          restoreShard(0, *firstReader);
+          return;
+        }
+        auto reader = streams_.makeReader(i);
+        auto header = streaming::readHeader<streaming::ShardHeader>(*reader);
+        if (header.magic != streaming::kShardMagic ||
+            header.version != streaming::kFormatVersion ||
+            header.shardId != i || header.numShards != numShards) {
+          throw std::runtime_error("Invalid shard header");
+        }
+        restoreShard(i, *reader);
+      } catch (const std::exception& e) {
+        XLOGF(ERR, "StreamingRestorer failed to restore shard {}, reason = {}",
+              i, folly::exceptionStr(e));
+        success = false;
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  XLOGF(INFO, "StreamingRestorer restored {} objects, found {} expired objects",
+        numRestored_.load(), numExpired_.load());
+  return success;
+}
+
+template <typename ObjectCache>
+void StreamingRestorer<ObjectCache>::restoreShard(
+    uint32_t shard, persistence::PersistenceStreamReader& reader) {
+  std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> dctx{nullptr,
+                                                            ZSTD_freeDCtx};
+  std::unique_ptr<uint8_t[]> rawBuf;
+  size_t rawCapacity = 0;
+  const uint32_t currentTime = util::getCurrentTimeSec();
+
+  while (true) {
+    const auto header = streaming::readHeader<streaming::ChunkHeader>(reader);
+    if (header.numItems == 0) {
+      return;
+    }
+    // valid until the next read
+    auto stored = reader.read(header.storedSize);
+    if (stored.length() != header.storedSize) {
+      throw std::runtime_error("Unexpected end of persist stream");
+    }
+
+    const uint8_t* data = stored.data();
+    if (header.flags & streaming::kChunkCompressed) {
+      if (!dctx) {
+        dctx.reset(ZSTD_createDCtx());
+      }
+      if (rawCapacity < header.rawSize) {
+        rawBuf = std::make_unique<uint8_t[]>(header.rawSize);
+        rawCapacity = header.rawSize;
+      }
+      const auto ret = ZSTD_decompressDCtx(dctx.get(), rawBuf.get(),
+                                           header.rawSize, stored.data(),
+                                           stored.length());
+      if (ZSTD_isError(ret) || ret != header.rawSize) {
+        throw std::runtime_error(folly::sformat(
+            "Failed to decompress chunk: {}",
+            ZSTD_isError(ret) ? ZSTD_getErrorName(ret) : "size mismatch"));
+      }
+      data = rawBuf.get();
+    } else if (header.rawSize != header.storedSize) {
+      throw std::runtime_error("Invalid chunk header");
+    }
+    if (folly::crc32(data, header.rawSize) != header.checksum) {
+      throw std::runtime_error("Invalid chunk checksum");
+    }
+
+    const uint8_t* const end = data + header.rawSize;
+    for (uint32_t i = 0; i < header.numItems; i++) {
+      streaming::RecordHeader record;
+      if (end - data < static_cast<ptrdiff_t>(sizeof(record))) {
+        throw std::runtime_error("Corrupted chunk");
+      }
+      std::memcpy(&record, data, sizeof(record));
+      data += sizeof(record);
+      if (static_cast<size_t>(end - data) <
+          static_cast<size_t>(record.keySize) + record.payloadSize) {
+        throw std::runtime_error("Corrupted chunk");
+      }
+      folly::StringPiece key{reinterpret_cast<const char*>(data),
+                             record.keySize};
+      folly::StringPiece payload{
+          reinterpret_cast<const char*>(data + record.keySize),
+          record.payloadSize};
+      data += record.keySize + record.payloadSize;
+
+      // no need to recover if object is already expired
+      if (record.expiryTime > 0 && record.expiryTime <= currentTime) {
+        numExpired_++;
+        continue;
+      }
+      uint32_t ttlSecs =
+          record.expiryTime == 0 ? 0 : record.expiryTime - currentTime;
+      try {
+        if (deserializeCb_(typename ObjectCache::Deserializer(
+                key, payload, record.objectSize, ttlSecs, objCache_))) {
+          numRestored_++;
+        } else {
+          XLOG_EVERY_N(ERR, 1000) << folly::sformat(
+              "Shard {} failed to deserialize object for key = {}", shard,
+              key);
+        }
+      } catch (const std::exception& e) {
+        XLOG_EVERY_N(ERR, 1000) << folly::sformat(
+            "Shard {} failed to deserialize object for key = {}, exception "
+            "= {}",
+            shard, key, folly::exceptionStr(e));
+      }
+    }
+  }
+}
+} // namespace facebook::cachelib::objcache2
@@ -15,8 +15,11 @@
  */
 
 #include <folly/Benchmark.h>
+#include <folly/FileUtil.h>
 #include <folly/Random.h>
 #include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <cstddef>
 #include <memory>
@@ -157,6 +160,38 @@ class ObjectCacheTest : public ::testing::Test {
                        },
                        nullptr),
                    std::invalid_argument);
+      // missing streams
+      EXPECT_THROW(config.enableStreamingPersistence(
+                       1, PersistStreams{},
+                       [&](typename ObjectCache::Serializer serializer) {
+                         return serializer.template serialize<ThriftFoo>();
+                       },
+                       [&](typename ObjectCache::Deserializer deserializer) {
+                         return deserializer.template deserialize<ThriftFoo>();
+                       }),
+                   std::invalid_argument);
+      // more shards than a restore accepts
+      EXPECT_THROW(config.enableStreamingPersistence(
+                       streaming::kMaxShards + 1,
+                       makeFilePersistStreams("persistent_file"),
+                       [&](typename ObjectCache::Serializer serializer) {
+                         return serializer.template serialize<ThriftFoo>();
+                       },
+                       [&](typename ObjectCache::Deserializer deserializer) {
+                         return deserializer.template deserialize<ThriftFoo>();
+                       }),
+                   std::invalid_argument);
+      // invalid compression level
+      EXPECT_THROW(config.enableStreamingPersistence(
+                       1, makeFilePersistStreams("persistent_file"),
+                       [&](typename ObjectCache::Serializer serializer) {
+                         return serializer.template serialize<ThriftFoo>();
+                       },
+                       [&](typename ObjectCache::Deserializer deserializer) {
+                         return deserializer.template deserialize<ThriftFoo>();
+                       },
+                       ZSTD_maxCLevel() + 1),
+                   std::invalid_argument);
     }
   }
 
@@ -836,6 +871,142 @@ class ObjectCacheTest : public ::testing::Test {
     EXPECT_EQ(newSize, objcache->getTotalObjectSize());
   }
 
+  void testSizeLimitOnInsert() {
+    int evicted = 0;
+    ObjectCacheConfig config;
+    config.setCacheName("test")
+        .setSizeAwareCapacity(50 /* l1EntriesLimit*/,
+                              100 /* totalObjectSizeLimit */)
+        .setItemDestructor([&](ObjectCacheDestructorData data) {
+          if (data.context == ObjectCacheDestructorContext::kEvicted) {
+            evicted++;
+          }
+          data.deleteObject<Foo>();
+        });
+    auto objcache = ObjectCache::create(config);
+
+    // the total never exceeds the limit, not even until the next tick
+    for (size_t i = 0; i < 10; i++) {
+      auto key = folly::sformat("key_{}", i);
+      auto res = objcache->insert(key, std::make_unique<Foo>(), 25);
+      ASSERT_EQ(ObjectCache::AllocStatus::kSuccess, res.first);
+      EXPECT_LE(objcache->getTotalObjectSize(), 100);
+      EXPECT_NE(nullptr, objcache->template find<Foo>(key));
+    }
+    EXPECT_EQ(100, objcache->getTotalObjectSize());
+    EXPECT_EQ(4, objcache->getNumEntries());
+    EXPECT_EQ(6, evicted);
+
+    // one large object makes room by evicting more than one
+    objcache->insertOrReplace("large", std::make_unique<Foo>(), 60);
+    EXPECT_EQ(85, objcache->getTotalObjectSize());
+    EXPECT_EQ(2, objcache->getNumEntries());
+    EXPECT_EQ(9, evicted);
+
+    // growing an object evicts others, never the object itself
+    auto large = objcache->template findToWrite<Foo>("large");
+    ASSERT_TRUE(objcache->updateObjectSize(large, 90));
+    EXPECT_EQ(90, objcache->getTotalObjectSize());
+    EXPECT_EQ(1, objcache->getNumEntries());
+    EXPECT_EQ(large.get(), objcache->template find<Foo>("large").get());
+    EXPECT_EQ(10, evicted);
+
+    int numCounters = 0;
+    objcache->getObjectCacheCounters(
+        [&](folly::StringPiece name, double value) {
+          if (name == "objcache.evictions.size_limit") {
+            EXPECT_EQ(10, value);
+            numCounters++;
+          }
+        });
+    EXPECT_EQ(1, numCounters);
+  }
+
+  void testSizeLimitOnInsertWithReaders() {
+    int evicted = 0;
+    int removed = 0;
+    ObjectCacheConfig config;
+    config.setCacheName("test")
+        .setSizeAwareCapacity(50 /* l1EntriesLimit*/,
+                              100 /* totalObjectSizeLimit */)
+        .setItemDestructor([&](ObjectCacheDestructorData data) {
+          if (data.context == ObjectCacheDestructorContext::kEvicted) {
+            evicted++;
+          } else if (data.context == ObjectCacheDestructorContext::kRemoved) {
+            removed++;
+          }
+          data.deleteObject<Foo>();
+        });
+    auto objcache = ObjectCache::create(config);
+
+    for (size_t i = 0; i < 4; i++) {
+      auto foo = std::make_unique<Foo>();
+      foo->a = static_cast<int>(i);
+      objcache->insert(folly::sformat("key_{}", i), std::move(foo), 25);
+    }
+    std::vector<std::shared_ptr<const Foo>> readers;
+    for (size_t i = 0; i < 4; i++) {
+      readers.push_back(
+          objcache->template find<Foo>(folly::sformat("key_{}", i)));
+    }
+
+    // objects still in use are not accounted once evicted, so the cache
+    // evicts just enough
+    objcache->insert("key_4", std::make_unique<Foo>(), 50);
+    EXPECT_EQ(100, objcache->getTotalObjectSize());
+    EXPECT_EQ(3, objcache->getNumEntries());
+    EXPECT_EQ(0, evicted);
+    for (size_t i = 0; i < 4; i++) {
+      EXPECT_EQ(static_cast<int>(i), readers[i]->a);
+    }
+    // the objects are destroyed on this thread but still count as evicted
+    readers.clear();
+    EXPECT_EQ(2, evicted);
+    EXPECT_EQ(0, removed);
+    EXPECT_EQ(100, objcache->getTotalObjectSize());
+  }
+
+  void testObjectSizeHook() {
+    ObjectCacheConfig config;
+    config.setCacheName("test")
+        .setCacheCapacity(10'000 /* l1EntriesLimit*/)
+        .setObjectSizeHook([](const void* object, size_t objectSize) {
+          // account a fixed header per object; 0 asks for a default size
+          EXPECT_NE(nullptr, object);
+          return objectSize == 0 ? 100 : objectSize + 16;
+        })
+        .setItemDestructor(
+            [&](ObjectCacheDestructorData data) { data.deleteObject<Foo>(); });
+    // a hook needs size tracking
+    EXPECT_THROW(ObjectCache::create(config), std::invalid_argument);
+
+    config.objectSizeTrackingEnabled = true;
+    auto objcache = ObjectCache::create(config);
+    auto res = objcache->insert("foo", std::make_unique<Foo>(), 10);
+    ASSERT_EQ(ObjectCache::AllocStatus::kSuccess, res.first);
+    EXPECT_EQ(26, objcache->template getObjectSize(res.second));
+    objcache->insertOrReplace("bar", std::make_unique<Foo>());
+    EXPECT_EQ(126, objcache->getTotalObjectSize());
+
+    ASSERT_TRUE(objcache->updateObjectSize(res.second, 20));
+    EXPECT_EQ(36, objcache->template getObjectSize(res.second));
+    EXPECT_EQ(136, objcache->getTotalObjectSize());
+
+    ASSERT_TRUE(objcache->remove("foo"));
+    ASSERT_TRUE(objcache->remove("bar"));
+    res.second.reset();
+    EXPECT_EQ(0, objcache->getTotalObjectSize());
+
+    // the allocator size class is at least the size asked for
+    EXPECT_GE(allocatorSizeClassHook(nullptr, 100), 100);
+    EXPECT_EQ(0, allocatorSizeClassHook(nullptr, 0));
+    auto [str, size] = makeObjectWithSize<std::string>(1000, 'a');
+    EXPECT_EQ(1000, str->size());
+    if (folly::usingJEMalloc()) {
+      EXPECT_GE(size, 1000);
+    }
+  }
+
   void testMultithreadObjectSizeTrackingWithMutation() {
     if (!folly::usingJEMalloc()) {
       return;
@@ -1278,6 +1449,126 @@ class ObjectCacheTest : public ::testing::Test {
     EXPECT_EQ(evictionItrDumpAfter, evictionItrDumpBefore);
   }
 
+  void testStreamingPersistence() {
+    auto persistBaseFilePath = std::tmpnam(nullptr);
+    uint32_t threadsCount = 4;
+    int objectNum = 10'000;
+    size_t totalObjectSize = 0;
+
+    auto makeConfig = [&](int compressionLevel) {
+      ObjectCacheConfig config;
+      config.setCacheName("test")
+          .setCacheCapacity(20'000 /*l1EntriesLimit*/)
+          .setItemDestructor([&](ObjectCacheDestructorData data) {
+            data.deleteObject<ThriftFoo>();
+          })
+          .enableStreamingPersistence(
+              threadsCount, makeFilePersistStreams(persistBaseFilePath),
+              [&](typename ObjectCache::Serializer serializer) {
+                return serializer.template serialize<ThriftFoo>();
+              },
+              [&](typename ObjectCache::Deserializer deserializer) {
+                return deserializer.template deserialize<ThriftFoo>();
+              },
+              compressionLevel);
+      config.objectSizeTrackingEnabled = true;
+      // several chunks per shard
+      config.persistChunkSize = 4096;
+      return config;
+    };
+
+    // the uncompressed persist goes last for the corruption checks below
+    for (int level : {3, 0}) {
+      auto config = makeConfig(level);
+      totalObjectSize = 0;
+      {
+        auto objcache = ObjectCache::create(config);
+        for (int i = 0; i < objectNum; i++) {
+          int objectSize = i + 10;
+          auto object = std::make_unique<ThriftFoo>();
+          object->a().value() = i;
+          object->b().value() = i + 1;
+          object->c().value() = i + 2;
+          objcache->insertOrReplace(folly::sformat("key_{}", i),
+                                    std::move(object), objectSize);
+          totalObjectSize += objectSize;
+        }
+        // expires before it is restored
+        objcache->insertOrReplace("expired", std::make_unique<ThriftFoo>(), 1,
+                                  1 /* ttlSecs */);
+        ASSERT_EQ(objcache->persist(), true);
+      }
+      std::this_thread::sleep_for(std::chrono::seconds{2});
+
+      {
+        auto objcache = ObjectCache::create(config);
+        ASSERT_EQ(objcache->recover(), true);
+        for (int i = 0; i < objectNum; i++) {
+          auto found =
+              objcache->template find<ThriftFoo>(folly::sformat("key_{}", i));
+          ASSERT_NE(nullptr, found);
+          EXPECT_EQ(i, found->a_ref());
+          EXPECT_EQ(i + 1, found->b_ref());
+          EXPECT_EQ(i + 2, found->c_ref());
+        }
+        EXPECT_EQ(nullptr, objcache->template find<ThriftFoo>("expired"));
+        EXPECT_EQ(objcache->getNumEntries(), objectNum);
+        EXPECT_EQ(objcache->getTotalObjectSize(), totalObjectSize);
+      }
+    }
+
+    // a corrupted record fails the checksum of its chunk
+    {
+      auto shardPath = folly::sformat("{}_{}", persistBaseFilePath, 2);
+      struct stat st;
+      ASSERT_EQ(0, ::stat(shardPath.c_str(), &st));
+      folly::File file(shardPath, O_RDWR);
+      // the last payload byte of the last chunk, before the end of shard
+      const off_t offset = st.st_size - sizeof(streaming::ChunkHeader) - 1;
+      char c;
+      ASSERT_EQ(1, ::pread(file.fd(), &c, 1, offset));
+      const char corrupted = static_cast<char>(~c);
+      ASSERT_EQ(1, ::pwrite(file.fd(), &corrupted, 1, offset));
+      {
+        auto objcache = ObjectCache::create(makeConfig(0));
+        ASSERT_EQ(objcache->recover(), false);
+      }
+      ASSERT_EQ(1, ::pwrite(file.fd(), &c, 1, offset));
+    }
+
+    // a truncated shard fails the restore
+    {
+      auto shardPath = folly::sformat("{}_{}", persistBaseFilePath, 1);
+      struct stat st;
+      ASSERT_EQ(0, ::stat(shardPath.c_str(), &st));
+      ASSERT_EQ(0, ::truncate(shardPath.c_str(), st.st_size - 1));
+      auto objcache = ObjectCache::create(makeConfig(3));
+      ASSERT_EQ(objcache->recover(), false);
+    }
+
+    // a shard count beyond the limit is not trusted
+    {
+      auto shardPath = folly::sformat("{}_{}", persistBaseFilePath, 0);
+      folly::File file(shardPath, O_WRONLY | O_TRUNC);
+      streaming::ShardHeader header{streaming::kShardMagic,
+                                    streaming::kFormatVersion, 0,
+                                    streaming::kMaxShards + 1};
+      ASSERT_EQ(static_cast<ssize_t>(sizeof(header)),
+                folly::writeFull(file.fd(), &header, sizeof(header)));
+      auto objcache = ObjectCache::create(makeConfig(0));
+      ASSERT_EQ(objcache->recover(), false);
+      EXPECT_EQ(0, objcache->getNumEntries());
+    }
+
+    // a missing first shard fails the restore
+    {
+      auto config = makeConfig(3);
+      config.persistStreams = makeFilePersistStreams("random_path");
+      auto objcache = ObjectCache::create(config);
+      ASSERT_EQ(objcache->recover(), false);
+    }
+  }
+
   void testPersistenceNonThrift() {
     auto persistBaseFilePath = std::tmpnam(nullptr);
     size_t threadsCount = 10;
@@ -1845,6 +2136,13 @@ TYPED_TEST(ObjectCacheTest, ObjectSizeTrackingWithSizeUpdate) {
 TYPED_TEST(ObjectCacheTest, MultithreadObjectSizeTrackingWithMutation) {
   this->testMultithreadObjectSizeTrackingWithMutation();
 }
+TYPED_TEST(ObjectCacheTest, SizeLimitOnInsert) {
+  this->testSizeLimitOnInsert();
+}
+TYPED_TEST(ObjectCacheTest, SizeLimitOnInsertWithReaders) {
+  this->testSizeLimitOnInsertWithReaders();
+}
+TYPED_TEST(ObjectCacheTest, ObjectSizeHook) { this->testObjectSizeHook(); }
 
 TYPED_TEST(ObjectCacheTest, Persistence) { this->testPersistence(); }
 TYPED_TEST(ObjectCacheTest, PersistenceMultiType) {
@@ -1858,6 +2156,9 @@ TYPED_TEST(ObjectCacheTest, PersistenceWithEvictionOrder) {
     this->testPersistenceWithEvictionOrder();
   }
 }
+TYPED_TEST(ObjectCacheTest, StreamingPersistence) {
+  this->testStreamingPersistence();
+}
 TYPED_TEST(ObjectCacheTest, PersistenceNonThrift) {
   this->testPersistenceNonThrift();
 }
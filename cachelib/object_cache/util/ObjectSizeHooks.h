@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <folly/memory/Malloc.h>
+
+#include <memory>
+#include <utility>
+
+#include "cachelib/object_cache/util/ThreadMemoryTracker.h"
+
+namespace facebook {
+namespace cachelib {
+namespace objcache2 {
+
+// Object size hook (see ObjectCacheConfig::setObjectSizeHook) that rounds the
+// size passed on insert up to the malloc size class it is served from
+// (nallocx under jemalloc), so objects are accounted for the bytes they
+// occupy rather than the bytes they asked for.
+// Example:
+//      config.setSizeAwareCapacity(entriesLimit, sizeLimit)
+//          .setObjectSizeHook(allocatorSizeClassHook);
+//      objcache->insert(key, std::move(buf), buf->capacity());
+inline size_t allocatorSizeClassHook(const void* /* object */,
+                                     size_t objectSize) {
+  return objectSize == 0 ? 0 : folly::goodMallocSize(objectSize);
+}
+
+// Construct an object and return it along with the bytes its construction
+// left allocated on this thread: the exact footprint of the object and
+// everything it owns, in allocator size classes. Needs jemalloc; the size is
+// 0 otherwise.
+// Example:
+//      auto [obj, size] = makeObjectWithSize<Foo>(args...);
+//      objcache->insert(key, std::move(obj), size);
+template <typename T, typename... Args>
+std::pair<std::unique_ptr<T>, size_t> makeObjectWithSize(Args&&... args) {
+  ThreadMemoryTracker tMemTracker;
+  const auto before = tMemTracker.getMemUsageBytes();
+  auto object = std::make_unique<T>(std::forward<Args>(args)...);
+  const auto after = tMemTracker.getMemUsageBytes();
+  return {std::move(object),
+          after > before ? static_cast<size_t>(after - before) : 0};
+}
+
+} // namespace objcache2
+} // namespace cachelib
+} // namespace facebook
@@ -18,11 +18,22 @@
 
 #include <folly/File.h>
 #include <folly/FileUtil.h>
+#include <folly/MPMCQueue.h>
+#include <folly/String.h>
 #include <folly/hash/Checksum.h>
+#include <zstd.h>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <fstream>
+#include <mutex>
+#include <optional>
+#include <thread>
 
 #include "cachelib/allocator/CacheAllocatorConfig.h"
+#include "cachelib/allocator/memory/SlabAllocator.h"
+#include "cachelib/allocator/serialize/gen-cpp2/objects_types.h"
 #include "cachelib/common/Utils.h"
 
 namespace facebook::cachelib::persistence {
@@ -30,6 +41,7 @@ namespace facebook::cachelib::persistence {
 using CopyBufferOp = folly::IOBuf::CopyBufferOp;
 
 const char PersistenceManager::DATA_BEGIN_CHAR = static_cast<char>(28);
+const char PersistenceManager::SNAPSHOT_BEGIN_CHAR = static_cast<char>(29);
 const char PersistenceManager::DATA_MARK_CHAR = static_cast<char>(30);
 const char PersistenceManager::DATA_END_CHAR = static_cast<char>(31);
 
@@ -71,48 +83,404 @@ struct FOLLY_PACK_ATTR DataBlock {
   }
 };
 
-void PersistenceManager::saveCache(PersistenceStreamWriter& writer) {
-  util::Timer timer;
-  timer.startOrResume();
+/**
+ * The snapshot format starts with SNAPSHOT_BEGIN_CHAR and saves the versions,
+ * configs and nvm cache state the same way. Every shm segment and navy file
+ * is then saved as a header with the length of a SnapshotSegmentIndex, the
+ * index, and the chunks that cover its extents in order. A chunk is a
+ * SnapshotChunkHeader followed by storedSize bytes, either a zstd frame or
+ * the data as is. The chunks name their offset, so they can be restored in
+ * any order and by several threads.
+ */
+struct FOLLY_PACK_ATTR SnapshotChunkHeader {
+  uint64_t offset; // in the shm segment or navy file
+  uint32_t rawSize;
+  uint32_t storedSize;
+  uint32_t checksum; // crc32 of the raw data
+  uint32_t flags;
+};
 
-  XLOGF(INFO, "Start saving cache: cacheName {}, cacheDir {}",
-        *config_.cacheName(), cacheDir_);
-  writer.write(DATA_BEGIN_CHAR);
+namespace {
+constexpr uint32_t kChunkCompressed = 1;
 
-  // save versions
-  {
-    auto buf = Serializer::serializeToIOBuf(versions_);
-    auto header = makeHeader(PersistenceType::Versions, buf->length());
+using ZstdCCtxPtr = std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)>;
+using ZstdDCtxPtr = std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)>;
 
-    // The persisted stream consists of headers that are thrift serialized and
-    // data blocks that are custom serialized in binary format to stream in
-    // chunks. While restoring/deserializing from the stream, we want to read
-    // from the stream only the bytes around the serialization boundaries to
-    // simplify implementation. Hence,  we persist the size of thrift header in
-    // binary format first so that we can read only that much from the stream
-    // before proceeding to read/copy custom serialized blobs. Only one length
-    // is persisted if we use BinarySerializer (fix encoding) not
-    // CompactSerializer(variant encoding), this will be used to deserialize all
-    // headers in restoreCache().
-    size_t headerLength = header.length();
+SnapshotExtent makeExtent(size_t offset, size_t length) {
+  SnapshotExtent extent;
+  extent.offset() = offset;
+  extent.length() = length;
+  return extent;
+}
 
-    writer.write(
-        folly::IOBuf(CopyBufferOp::COPY_BUFFER, &headerLength, sizeof(size_t)));
-    writer.write(header);
-    writer.write(*buf);
+// The chunks of a segment in the order they are saved
+std::vector<SnapshotExtent> splitIntoChunks(const SnapshotSegmentIndex& index) {
+  CACHELIB_CHECK_THROW(*index.chunkSize() > 0, "invalid chunk size");
+  const size_t chunkSize = *index.chunkSize();
+  std::vector<SnapshotExtent> chunks;
+  for (const auto& extent : *index.extents()) {
+    const size_t end = *extent.offset() + *extent.length();
+    CACHELIB_CHECK_THROW(
+        *extent.offset() >= 0 && *extent.length() >= 0 &&
+            end <= static_cast<size_t>(*index.segmentSize()),
+        "invalid extent");
+    for (size_t offset = *extent.offset(); offset < end; offset += chunkSize) {
+      chunks.push_back(makeExtent(offset, std::min(chunkSize, end - offset)));
+    }
   }
+  return chunks;
+}
 
-  // save configs
-  {
-    writer.write(DATA_MARK_CHAR);
-    auto buf = Serializer::serializeToIOBuf(config_);
-    writer.write(makeHeader(PersistenceType::Configs, buf->length()));
-    writer.write(*buf);
+// Slab memory of the shm cache segment that is in use, according to the
+// memory allocator state saved in the shm info segment. Slabs that are free
+// in the slab allocator, a pool or an allocation class, advised away or never
+// handed out hold no allocations. Neither does the part of the current slab
+// of an allocation class past its current offset.
+std::vector<SnapshotExtent> computeUsedExtents(const ShmAddr& shmInfo,
+                                               size_t shmSize) {
+  const auto* infoStart = static_cast<const uint8_t*>(shmInfo.addr);
+  Deserializer deserializer(infoStart, infoStart + shmInfo.size);
+  deserializer.deserialize<serialization::CacheAllocatorMetadata>();
+  const auto allocator =
+      deserializer.deserialize<serialization::MemoryAllocatorObject>();
+  const auto& slabAllocator = *allocator.slabAllocator();
+
+  const size_t memorySize = *slabAllocator.memorySize();
+  CACHELIB_CHECK_THROWF(
+      memorySize <= shmSize && *slabAllocator.slabSize() == Slab::kSize,
+      "unexpected slab allocator state, memory size {}, shm size {}",
+      memorySize, shmSize);
+  const int32_t numSlabs = SlabAllocator::getNumUsableSlabs(memorySize);
+  const size_t slabMemoryStart =
+      (memorySize / Slab::kSize - numSlabs) * Slab::kSize;
+
+  // bytes in use from the start of every slab
+  std::vector<uint32_t> usedBytes(numSlabs, 0);
+  std::fill(usedBytes.begin(),
+            usedBytes.begin() +
+                std::clamp(*slabAllocator.nextSlabIdx(), 0, numSlabs),
+            Slab::kSize);
+  auto markFree = [&](int32_t idx) {
+    if (idx >= 0 && idx < numSlabs) {
+      usedBytes[idx] = 0;
+    }
+  };
+  for (auto idx : *slabAllocator.freeSlabIdxs()) {
+    markFree(idx);
+  }
+  for (auto idx : *slabAllocator.advisedSlabIdxs()) {
+    markFree(idx);
+  }
+  for (const auto& pool : *allocator.memoryPoolManager()->pools()) {
+    for (auto idx : *pool.freeSlabIdxs()) {
+      markFree(idx);
+    }
+    for (const auto& ac : *pool.ac()) {
+      for (auto idx : *ac.freeSlabIdxs()) {
+        markFree(idx);
+      }
+      const auto idx = *ac.currSlabIdx();
+      if (idx >= 0 && idx < numSlabs) {
+        usedBytes[idx] = std::min<uint32_t>(usedBytes[idx], *ac.currOffset());
+      }
+    }
   }
 
-  // save meta data file (cache_dir/NvmCacheState)
-  saveFile(writer, PersistenceType::NvmCacheState,
-           NvmCacheState::getNvmCacheStateFilePath(cacheDir_));
+  std::vector<SnapshotExtent> extents;
+  auto addExtent = [&extents](size_t offset, size_t length) {
+    if (length == 0) {
+      return;
+    }
+    if (!extents.empty() &&
+        static_cast<size_t>(*extents.back().offset() +
+                            *extents.back().length()) == offset) {
+      *extents.back().length() += length;
+      return;
+    }
+    extents.push_back(makeExtent(offset, length));
+  };
+  // slab headers
+  addExtent(0, slabMemoryStart);
+  for (int32_t i = 0; i < numSlabs; ++i) {
+    addExtent(slabMemoryStart + i * Slab::kSize, usedBytes[i]);
+  }
+  const size_t slabMemoryEnd = slabMemoryStart + numSlabs * Slab::kSize;
+  addExtent(slabMemoryEnd, shmSize - slabMemoryEnd);
+  return extents;
+}
+
+// Runs produce(thread, i) for every i in [0, n) on numThreads threads and
+// hands the results to consume(result) on the calling thread in the order of
+// i. At most window results are produced ahead of the one consumed. The first
+// exception thrown by either stops the others and is rethrown.
+template <typename T, typename ProduceFn, typename ConsumeFn>
+void runInOrder(size_t n,
+                uint32_t numThreads,
+                size_t window,
+                ProduceFn&& produce,
+                ConsumeFn&& consume) {
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<std::optional<T>> slots(window);
+  size_t next = 0;
+  size_t consumed = 0;
+  std::exception_ptr error;
+  auto setError = [&](std::exception_ptr e) {
+    std::lock_guard<std::mutex> l(mutex);
+    if (!error) {
+      error = std::move(e);
+    }
+    cv.notify_all();
+  };
+
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t < numThreads; ++t) {
+    threads.emplace_back([&, t] {
+      while (true) {
+        size_t i;
+        {
+          std::unique_lock<std::mutex> l(mutex);
+          cv.wait(l, [&] {
+            return error || next >= n || next < consumed + window;
+          });
+          if (error || next >= n) {
+            return;
+          }
+          i = next++;
+        }
+        try {
+          auto result = produce(t, i);
+          std::lock_guard<std::mutex> l(mutex);
+          slots[i % window] = std::move(result);
+          cv.notify_all();
+        } catch (...) {
+          setError(std::current_exception());
+          return;
+        }
+      }
+    });
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    std::optional<T> result;
+    {
+      std::unique_lock<std::mutex> l(mutex);
+      cv.wait(l, [&] { return error || slots[i % window].has_value(); });
+      if (error) {
+        break;
+      }
+      result = std::move(slots[i % window]);
+      slots[i % window].reset();
+      consumed = i + 1;
+      cv.notify_all();
+    }
+    try {
+      consume(std::move(*result));
+    } catch (...) {
+      setError(std::current_exception());
+      break;
+    }
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+} // namespace
+
+/**
+ * Restores the chunks of a snapshot: the calling thread reads them off the
+ * stream and the threads of the restorer decompress them, validate them and
+ * copy them into the shm segment or write them to the navy file.
+ */
+class PersistenceManager::SnapshotRestorer {
+ public:
+  explicit SnapshotRestorer(uint32_t numThreads)
+      : queue_(std::max(numThreads, 1u) * 2) {
+    CACHELIB_CHECK_THROW(numThreads > 0, "invalid snapshot config");
+    for (uint32_t i = 0; i < numThreads; ++i) {
+      threads_.emplace_back([this] { run(); });
+    }
+  }
+
+  ~SnapshotRestorer() { stop(); }
+
+  // read the chunks that follow the index; they end up in addr if it is not
+  // null, or in the file fd otherwise
+  void restoreChunks(PersistenceStreamReader& reader,
+                     const SnapshotSegmentIndex& index,
+                     uint8_t* addr,
+                     int fd) {
+    for (const auto& chunk : splitIntoChunks(index)) {
+      // stop reading once a chunk failed
+      throwIfError();
+      auto headerBuf = reader.read(sizeof(SnapshotChunkHeader));
+      CACHELIB_CHECK_THROW(headerBuf.length() == sizeof(SnapshotChunkHeader),
+                           "invalid data");
+      Task task;
+      std::memcpy(&task.header, headerBuf.data(), sizeof(SnapshotChunkHeader));
+      CACHELIB_CHECK_THROW(
+          task.header.offset == static_cast<uint64_t>(*chunk.offset()) &&
+              task.header.rawSize == static_cast<uint64_t>(*chunk.length()),
+          "invalid chunk");
+      CACHELIB_CHECK_THROW(
+          task.header.storedSize <= ZSTD_compressBound(task.header.rawSize),
+          "invalid chunk");
+
+      auto buf = reader.read(task.header.storedSize);
+      CACHELIB_CHECK_THROW(buf.length() == task.header.storedSize,
+                           "invalid data");
+      // the reader only keeps the data valid until the next read
+      task.data = folly::IOBuf::copyBuffer(buf.data(), buf.length());
+      task.addr = addr;
+      task.fd = fd;
+      queue_.blockingWrite(std::move(task));
+    }
+  }
+
+  // wait for the chunks to be restored, throws the first error
+  void finish() {
+    stop();
+    throwIfError();
+  }
+
+ private:
+  struct Task {
+    SnapshotChunkHeader header{};
+    // null tells the thread to stop
+    std::unique_ptr<folly::IOBuf> data;
+    uint8_t* addr{nullptr};
+    int fd{-1};
+  };
+
+  void throwIfError() {
+    if (!hasError_.load(std::memory_order_acquire)) {
+      return;
+    }
+    std::lock_guard<std::mutex> l(errorMutex_);
+    std::rethrow_exception(error_);
+  }
+
+  void stop() {
+    for (size_t i = 0; i < threads_.size(); ++i) {
+      queue_.blockingWrite(Task{});
+    }
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+    threads_.clear();
+  }
+
+  void run() {
+    ZstdDCtxPtr dctx{nullptr, ZSTD_freeDCtx};
+    std::vector<uint8_t> fileBuffer;
+    Task task;
+    while (true) {
+      queue_.blockingRead(task);
+      if (!task.data) {
+        return;
+      }
+      // keep draining the queue after an error so the reader never blocks
+      if (hasError_.load(std::memory_order_relaxed)) {
+        continue;
+      }
+      try {
+        restoreChunk(task, dctx, fileBuffer);
+      } catch (...) {
+        std::lock_guard<std::mutex> l(errorMutex_);
+        if (!error_) {
+          error_ = std::current_exception();
+        }
+        hasError_ = true;
+      }
+    }
+  }
+
+  static void restoreChunk(const Task& task,
+                           ZstdDCtxPtr& dctx,
+                           std::vector<uint8_t>& fileBuffer) {
+    const auto& header = task.header;
+    uint8_t* dst;
+    if (task.addr) {
+      dst = task.addr + header.offset;
+    } else {
+      fileBuffer.resize(header.rawSize);
+      dst = fileBuffer.data();
+    }
+
+    if (header.flags & kChunkCompressed) {
+      if (!dctx) {
+        dctx.reset(ZSTD_createDCtx());
+      }
+      const auto ret =
+          ZSTD_decompressDCtx(dctx.get(), dst, header.rawSize,
+                              task.data->data(), task.data->length());
+      CACHELIB_CHECK_THROWF(!ZSTD_isError(ret) && ret == header.rawSize,
+                            "fail to decompress chunk at {}", header.offset);
+    } else {
+      CACHELIB_CHECK_THROW(task.data->length() == header.rawSize,
+                           "invalid chunk");
+      std::memcpy(dst, task.data->data(), header.rawSize);
+    }
+    CACHELIB_CHECK_THROW(folly::crc32(dst, header.rawSize) == header.checksum,
+                         "invalid checksum");
+
+    if (!task.addr) {
+      auto res = folly::pwriteFull(task.fd, dst, header.rawSize, header.offset);
+      CACHELIB_CHECK_THROWF(res == static_cast<ssize_t>(header.rawSize),
+                            "fail to write navy file, errno: {}", errno);
+    }
+  }
+
+  folly::MPMCQueue<Task> queue_;
+  std::vector<std::thread> threads_;
+
+  std::atomic<bool> hasError_{false};
+  std::mutex errorMutex_;
+  std::exception_ptr error_;
+};
+
+void FilePersistenceStreamWriter::write(folly::IOBuf buffer) {
+  for (auto range : buffer) {
+    auto res = folly::writeFull(file_.fd(), range.data(), range.size());
+    CACHELIB_CHECK_THROWF(res == static_cast<ssize_t>(range.size()),
+                          "fail to write persistence stream: {}",
+                          folly::errnoStr(errno));
+  }
+}
+
+void FilePersistenceStreamWriter::write(char c) {
+  write(folly::IOBuf(folly::IOBuf::WRAP_BUFFER, &c, 1));
+}
+
+folly::IOBuf FilePersistenceStreamReader::read(size_t length) {
+  folly::IOBuf buf(folly::IOBuf::CREATE, length);
+  auto res = folly::readFull(file_.fd(), buf.writableData(), length);
+  CACHELIB_CHECK_THROWF(res != -1, "fail to read persistence stream: {}",
+                        folly::errnoStr(errno));
+  buf.append(res);
+  return buf;
+}
+
+char FilePersistenceStreamReader::read() {
+  char c = 0;
+  auto res = folly::readFull(file_.fd(), &c, 1);
+  CACHELIB_CHECK_THROWF(res != -1, "fail to read persistence stream: {}",
+                        folly::errnoStr(errno));
+  return c;
+}
+
+void PersistenceManager::saveCache(PersistenceStreamWriter& writer) {
+  util::Timer timer;
+  timer.startOrResume();
+
+  XLOGF(INFO, "Start saving cache: cacheName {}, cacheDir {}",
+        *config_.cacheName(), cacheDir_);
+  writer.write(DATA_BEGIN_CHAR);
+  saveMetadata(writer);
 
   // save shm_info
   auto shmInfo =
@@ -160,14 +528,90 @@ void PersistenceManager::saveCache(PersistenceStreamWriter& writer) {
   XLOGF(INFO, "saveCache finish, spent {} seconds", timer.getDurationSec());
 }
 
+void PersistenceManager::saveCache(PersistenceStreamWriter& writer,
+                                   const SnapshotConfig& config) {
+  CACHELIB_CHECK_THROW(config.numThreads > 0 && config.chunkSize > 0,
+                       "invalid snapshot config");
+  util::Timer timer;
+  timer.startOrResume();
+
+  XLOGF(INFO, "Start saving cache snapshot: cacheName {}, cacheDir {}",
+        *config_.cacheName(), cacheDir_);
+  writer.write(SNAPSHOT_BEGIN_CHAR);
+  saveMetadata(writer);
+
+  auto shmInfo = saveShmSnapshot(writer, PersistenceType::ShmInfo,
+                                 detail::kShmInfoName, config, nullptr);
+  auto shmHT = saveShmSnapshot(writer, PersistenceType::ShmHT,
+                               detail::kShmHashTableName, config, nullptr);
+  auto shmChainedHT =
+      saveShmSnapshot(writer, PersistenceType::ShmChainedItemHT,
+                      detail::kShmChainedItemHashTableName, config, nullptr);
+  const auto infoAddr = shmInfo->getCurrentMapping();
+  auto shmCache = saveShmSnapshot(
+      writer, PersistenceType::ShmData, detail::kShmCacheName, config,
+      config.skipUnusedSlabMemory ? &infoAddr : nullptr);
+  saveNavySnapshot(writer, config);
+
+  writer.write(DATA_END_CHAR);
+  writer.flush();
+
+  timer.pause();
+  XLOGF(INFO, "saveCache snapshot finish, spent {} seconds",
+        timer.getDurationSec());
+}
+
+void PersistenceManager::saveMetadata(PersistenceStreamWriter& writer) {
+  // save versions
+  {
+    auto buf = Serializer::serializeToIOBuf(versions_);
+    auto header = makeHeader(PersistenceType::Versions, buf->length());
+
+    // The persisted stream consists of headers that are thrift serialized and
+    // data blocks that are custom serialized in binary format to stream in
+    // chunks. While restoring/deserializing from the stream, we want to read
+    // from the stream only the bytes around the serialization boundaries to
+    // simplify implementation. Hence,  we persist the size of thrift header in
+    // binary format first so that we can read only that much from the stream
+    // before proceeding to read/copy custom serialized blobs. Only one length
+    // is persisted if we use BinarySerializer (fix encoding) not
+    // CompactSerializer(variant encoding), this will be used to deserialize all
+    // headers in restoreCache().
+    size_t headerLength = header.length();
+
+    writer.write(
+        folly::IOBuf(CopyBufferOp::COPY_BUFFER, &headerLength, sizeof(size_t)));
+    writer.write(header);
+    writer.write(*buf);
+  }
+
+  // save configs
+  {
+    writer.write(DATA_MARK_CHAR);
+    auto buf = Serializer::serializeToIOBuf(config_);
+    writer.write(makeHeader(PersistenceType::Configs, buf->length()));
+    writer.write(*buf);
+  }
+
+  // save meta data file (cache_dir/NvmCacheState)
+  saveFile(writer, PersistenceType::NvmCacheState,
+           NvmCacheState::getNvmCacheStateFilePath(cacheDir_));
+}
+
 void PersistenceManager::restoreCache(PersistenceStreamReader& reader) {
+  restoreCache(reader, SnapshotConfig{});
+}
+
+void PersistenceManager::restoreCache(PersistenceStreamReader& reader,
+                                      const SnapshotConfig& config) {
   util::Timer timer;
   timer.startOrResume();
 
   XLOGF(INFO, "Start restoring cache: cacheName {}, cacheDir {}",
         *config_.cacheName(), cacheDir_);
 
-  CACHELIB_CHECK_THROW(reader.read() == DATA_BEGIN_CHAR,
+  const char begin = reader.read();
+  CACHELIB_CHECK_THROW(begin == DATA_BEGIN_CHAR || begin == SNAPSHOT_BEGIN_CHAR,
                        "invalid beginning character");
 
   auto headerLengthBuf = reader.read(sizeof(size_t));
@@ -177,6 +621,14 @@ void PersistenceManager::restoreCache(PersistenceStreamReader& reader) {
   ShmManager shmManager(cacheDir_, true);
   SCOPE_SUCCESS { shmManager.shutDown(); };
 
+  // the navy files of a snapshot are written by the restorer threads, so they
+  // must outlive them
+  std::vector<folly::File> navyFiles;
+  std::unique_ptr<SnapshotRestorer> restorer;
+  if (begin == SNAPSHOT_BEGIN_CHAR) {
+    restorer = std::make_unique<SnapshotRestorer>(config.numThreads);
+  }
+
   while (true) {
     auto headerBuf = reader.read(headerLength);
     CACHELIB_CHECK_THROW(headerBuf.length() == headerLength, "invalid data");
@@ -209,31 +661,42 @@ void PersistenceManager::restoreCache(PersistenceStreamReader& reader) {
       break;
     }
     case PersistenceType::ShmInfo: {
-      auto shm = shmManager.createShm(detail::kShmInfoName, dataLen);
-      restoreDataFromBlocks(reader, static_cast<uint8_t*>(shm.addr), dataLen);
+      restoreShm(reader, shmManager, detail::kShmInfoName, dataLen, {},
+                 restorer.get());
       break;
     }
     case PersistenceType::ShmHT: {
-      auto shm = shmManager.createShm(detail::kShmHashTableName, dataLen);
-      restoreDataFromBlocks(reader, static_cast<uint8_t*>(shm.addr), dataLen);
+      restoreShm(reader, shmManager, detail::kShmHashTableName, dataLen, {},
+                 restorer.get());
       break;
     }
     case PersistenceType::ShmChainedItemHT: {
-      auto shm =
-          shmManager.createShm(detail::kShmChainedItemHashTableName, dataLen);
-      restoreDataFromBlocks(reader, static_cast<uint8_t*>(shm.addr), dataLen);
+      restoreShm(reader, shmManager, detail::kShmChainedItemHashTableName,
+                 dataLen, {}, restorer.get());
       break;
     }
     case PersistenceType::ShmData: {
       ShmSegmentOpts opts;
       opts.alignment = sizeof(Slab); // 4MB
-      auto shm = shmManager.createShm(detail::kShmCacheName, *header.length(),
-                                      nullptr, opts);
-      restoreDataFromBlocks(reader, static_cast<uint8_t*>(shm.addr),
-                            *header.length());
+      restoreShm(reader, shmManager, detail::kShmCacheName, dataLen, opts,
+                 restorer.get());
       break;
     }
     case PersistenceType::NavyPartition: {
+      if (restorer) {
+        // a snapshot saves every navy file in a partition of its own
+        auto index = readSnapshotIndex(reader, dataLen);
+        const auto idx = static_cast<size_t>(*index.navyFileIdx());
+        CACHELIB_CHECK_THROW(idx < navyFiles_.size(), "invalid navy file");
+        navyFiles.emplace_back(navyFiles_[idx], O_CREAT | O_WRONLY | O_TRUNC);
+        auto res = ::ftruncate(navyFiles.back().fd(), *index.segmentSize());
+        CACHELIB_CHECK_THROWF(res == 0, "fail to write file {}, errno: {}",
+                              navyFiles_[idx], errno);
+        restorer->restoreChunks(reader, index, nullptr,
+                                navyFiles.back().fd());
+        break;
+      }
+
       int32_t navyFileSize = *header.length();
       int32_t numBlock =
           util::getAlignedSize(navyFileSize, kDataBlockSize) / kDataBlockSize;
@@ -263,6 +726,9 @@ void PersistenceManager::restoreCache(PersistenceStreamReader& reader) {
     case DATA_MARK_CHAR:
       continue;
     case DATA_END_CHAR:
+      if (restorer) {
+        restorer->finish();
+      }
       timer.pause();
       XLOGF(INFO, "restoreCache finish, spent {} seconds",
             timer.getDurationSec());
@@ -366,6 +832,141 @@ void PersistenceManager::saveDataInBlocks(PersistenceStreamWriter& writer,
   }
 }
 
+std::unique_ptr<ShmSegment> PersistenceManager::saveShmSnapshot(
+    PersistenceStreamWriter& writer,
+    PersistenceType type,
+    const std::string& name,
+    const SnapshotConfig& config,
+    const ShmAddr* shmInfo) {
+  auto segment = ShmManager::attachShmReadOnly(cacheDir_, name, true);
+  auto shm = segment->getCurrentMapping();
+  CACHELIB_CHECK_THROWF(shm.size > 0, "shm {} is empty.", name);
+
+  SnapshotSegmentIndex index;
+  index.type() = type;
+  index.segmentSize() = shm.size;
+  index.chunkSize() = config.chunkSize;
+  if (shmInfo) {
+    index.extents() = computeUsedExtents(*shmInfo, shm.size);
+  } else {
+    index.extents()->push_back(makeExtent(0, shm.size));
+  }
+  saveSnapshotSegment(writer, index, static_cast<const uint8_t*>(shm.addr),
+                      -1, config);
+  return segment;
+}
+
+void PersistenceManager::saveNavySnapshot(PersistenceStreamWriter& writer,
+                                          const SnapshotConfig& config) {
+  for (size_t i = 0; i < navyFiles_.size(); ++i) {
+    folly::File f(navyFiles_[i]);
+    SnapshotSegmentIndex index;
+    index.type() = PersistenceType::NavyPartition;
+    index.segmentSize() = navyFileSize_;
+    index.chunkSize() = config.chunkSize;
+    index.extents()->push_back(makeExtent(0, navyFileSize_));
+    index.navyFileIdx() = i;
+    saveSnapshotSegment(writer, index, nullptr, f.fd(), config);
+  }
+}
+
+void PersistenceManager::saveSnapshotSegment(PersistenceStreamWriter& writer,
+                                             const SnapshotSegmentIndex& index,
+                                             const uint8_t* addr,
+                                             int fd,
+                                             const SnapshotConfig& config) {
+  auto buf = Serializer::serializeToIOBuf(index);
+  writer.write(DATA_MARK_CHAR);
+  writer.write(makeHeader(*index.type(), buf->length()));
+  writer.write(*buf);
+
+  const auto chunks = splitIntoChunks(index);
+  std::vector<ZstdCCtxPtr> cctxs;
+  for (uint32_t i = 0; i < config.numThreads; ++i) {
+    cctxs.emplace_back(nullptr, ZSTD_freeCCtx);
+  }
+
+  auto compressChunk = [&](uint32_t thread, size_t i) {
+    const size_t offset = *chunks[i].offset();
+    const size_t length = *chunks[i].length();
+
+    // shm data is compressed in place. Navy data is read into a buffer
+    // first, the part past the end of a short file is zero.
+    std::unique_ptr<folly::IOBuf> raw;
+    const uint8_t* data = addr + offset;
+    if (!addr) {
+      raw = folly::IOBuf::create(length);
+      auto res = folly::preadFull(fd, raw->writableData(), length, offset);
+      CACHELIB_CHECK_THROWF(res != -1, "fail to read navy file, errno: {}",
+                            errno);
+      std::memset(raw->writableData() + res, 0, length - res);
+      raw->append(length);
+      data = raw->data();
+    }
+
+    SnapshotChunkHeader header{};
+    header.offset = offset;
+    header.rawSize = length;
+    header.checksum = folly::crc32(data, length);
+
+    std::unique_ptr<folly::IOBuf> stored;
+    if (config.compressionLevel != 0) {
+      auto& cctx = cctxs[thread];
+      if (!cctx) {
+        cctx.reset(ZSTD_createCCtx());
+      }
+      auto compressed = folly::IOBuf::create(ZSTD_compressBound(length));
+      const auto ret = ZSTD_compressCCtx(
+          cctx.get(), compressed->writableData(), compressed->capacity(),
+          data, length, config.compressionLevel);
+      // chunks that don't compress are stored as they are
+      if (!ZSTD_isError(ret) && ret < length) {
+        compressed->append(ret);
+        stored = std::move(compressed);
+        header.flags |= kChunkCompressed;
+      }
+    }
+    if (!stored) {
+      // shm stays attached until the writer is flushed
+      stored = raw ? std::move(raw) : folly::IOBuf::wrapBuffer(data, length);
+    }
+    header.storedSize = stored->length();
+
+    folly::IOBuf chunk(CopyBufferOp::COPY_BUFFER, &header, sizeof(header));
+    chunk.appendToChain(std::move(stored));
+    return chunk;
+  };
+
+  runInOrder<folly::IOBuf>(
+      chunks.size(), config.numThreads, 2 * config.numThreads, compressChunk,
+      [&writer](folly::IOBuf chunk) { writer.write(std::move(chunk)); });
+}
+
+void PersistenceManager::restoreShm(PersistenceStreamReader& reader,
+                                    ShmManager& shmManager,
+                                    const std::string& name,
+                                    size_t dataLen,
+                                    const ShmSegmentOpts& opts,
+                                    SnapshotRestorer* restorer) {
+  if (!restorer) {
+    auto shm = shmManager.createShm(name, dataLen, nullptr, opts);
+    restoreDataFromBlocks(reader, static_cast<uint8_t*>(shm.addr), dataLen);
+    return;
+  }
+
+  auto index = readSnapshotIndex(reader, dataLen);
+  auto shm =
+      shmManager.createShm(name, *index.segmentSize(), nullptr, opts);
+  restorer->restoreChunks(reader, index, static_cast<uint8_t*>(shm.addr), -1);
+}
+
+SnapshotSegmentIndex PersistenceManager::readSnapshotIndex(
+    PersistenceStreamReader& reader, size_t dataLen) {
+  auto buf = reader.read(dataLen);
+  CACHELIB_CHECK_THROW(buf.length() == dataLen, "invalid data");
+  return deserialize<SnapshotSegmentIndex>(buf);
+}
+
 void PersistenceManager::restoreDataFromBlocks(PersistenceStreamReader& reader,
                                                uint8_t* ptr,
                                                size_t size) {
@@ -15,6 +15,7 @@
  */
 
 #pragma once
+#include <folly/File.h>
 #include <folly/io/IOBuf.h>
 #include <folly/logging/xlog.h>
 
@@ -67,6 +68,58 @@ class PersistenceStreamWriter {
   virtual void flush() = 0;
 };
 
+/**
+ * Stream reader and writer on a local file.
+ * Writes go straight to the file, so flush() has nothing to do.
+ */
+class FilePersistenceStreamWriter : public PersistenceStreamWriter {
+ public:
+  explicit FilePersistenceStreamWriter(folly::File file)
+      : file_(std::move(file)) {}
+
+  void write(folly::IOBuf buffer) override;
+  void write(char c) override;
+  void flush() override {}
+
+ private:
+  folly::File file_;
+};
+
+class FilePersistenceStreamReader : public PersistenceStreamReader {
+ public:
+  explicit FilePersistenceStreamReader(folly::File file)
+      : file_(std::move(file)) {}
+
+  folly::IOBuf read(size_t length) override;
+  char read() override;
+
+ private:
+  folly::File file_;
+};
+
+/**
+ * Options of the snapshot format, see saveCache(writer, SnapshotConfig).
+ */
+struct SnapshotConfig {
+  // threads that read and compress the chunks on save, and decompress and
+  // copy them in place on restore. The stream is still used by the calling
+  // thread only.
+  uint32_t numThreads{4};
+
+  // zstd level of the chunks, 0 stores them uncompressed. Chunks that don't
+  // get smaller are stored uncompressed as well.
+  int compressionLevel{1};
+
+  // bytes of shm or navy data in a chunk, the last chunk of an extent can be
+  // smaller.
+  uint32_t chunkSize{4 * 1024 * 1024};
+
+  // leave out the slabs that hold no allocations and the part of every
+  // allocation class' current slab that is not carved into allocations yet.
+  // They are restored as zeros.
+  bool skipUnusedSlabMemory{true};
+};
+
 /**
  * PersistenceManager is to save cachelib instance to a remote storage, and
  * restore the cache cross host.
@@ -132,13 +185,28 @@ class PersistenceManager {
   /* call reader.read(), restore cache metadata/data to memory/disk */
   void restoreCache(PersistenceStreamReader& reader);
 
+  /* save cache metadata/data in the snapshot format: shm segments and navy
+   * files are split into chunks that are read and compressed in parallel,
+   * and the unused slab memory is left out. */
+  void saveCache(PersistenceStreamWriter& writer, const SnapshotConfig& config);
+  /* restore a stream of either format, snapshot chunks are decompressed and
+   * copied by config.numThreads threads */
+  void restoreCache(PersistenceStreamReader& reader,
+                    const SnapshotConfig& config);
+
   const static char DATA_BEGIN_CHAR;
+  const static char SNAPSHOT_BEGIN_CHAR;
   const static char DATA_MARK_CHAR;
   const static char DATA_END_CHAR;
 
  private:
+  class SnapshotRestorer;
+
   folly::IOBuf makeHeader(PersistenceType, size_t);
 
+  // versions, configs and nvm cache state, common to both formats
+  void saveMetadata(PersistenceStreamWriter&);
+
   void saveFile(PersistenceStreamWriter&,
                 PersistenceType,
                 const folly::StringPiece);
@@ -154,6 +222,28 @@ class PersistenceManager {
   void saveDataInBlocks(PersistenceStreamWriter&, const ShmAddr&);
   void restoreDataFromBlocks(PersistenceStreamReader&, uint8_t*, size_t);
 
+  // snapshot format, see PersistenceManager.cpp
+  std::unique_ptr<ShmSegment> saveShmSnapshot(PersistenceStreamWriter&,
+                                              PersistenceType,
+                                              const std::string&,
+                                              const SnapshotConfig&,
+                                              const ShmAddr* shmInfo);
+  void saveNavySnapshot(PersistenceStreamWriter&, const SnapshotConfig&);
+  void saveSnapshotSegment(PersistenceStreamWriter&,
+                           const SnapshotSegmentIndex&,
+                           const uint8_t* addr,
+                           int fd,
+                           const SnapshotConfig&);
+
+  // creates the shm and fills it from the stream of either format
+  void restoreShm(PersistenceStreamReader&,
+                  ShmManager&,
+                  const std::string& name,
+                  size_t dataLen,
+                  const ShmSegmentOpts& opts,
+                  SnapshotRestorer* restorer);
+  SnapshotSegmentIndex readSnapshotIndex(PersistenceStreamReader&, size_t);
+
   void deserializeAndValidateVersions(const folly::IOBuf&);
 
   template <typename T>
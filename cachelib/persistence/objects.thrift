@@ -42,6 +42,26 @@ struct PersistenceHeader {
   1: required PersistenceType type;
   // total length of data, if the data is split
   // in blocks, it also includes checksum and length
-  // of each block.
+  // of each block. In the snapshot format, the length
+  // of the SnapshotSegmentIndex that follows for shm
+  // segments and navy files.
   2: required i64 length;
 }
+
+// A byte range of a shm segment or a navy file saved in a snapshot
+struct SnapshotExtent {
+  1: required i64 offset;
+  2: required i64 length;
+}
+
+// Precedes the chunks of a shm segment or a navy file in the snapshot
+// format. The extents are split into chunks of chunkSize bytes, in order,
+// and bytes outside of them are left zero on restore.
+struct SnapshotSegmentIndex {
+  1: required PersistenceType type;
+  2: required i64 segmentSize;
+  3: required i32 chunkSize;
+  4: required list<SnapshotExtent> extents;
+  // index into the navy files for NavyPartition
+  5: i32 navyFileIdx = 0;
+}
@@ -172,10 +172,13 @@ class PersistenceCache {
     cache.shutDown();
   }
 
-  void test(std::vector<std::pair<std::string, std::string>> items,
-            uint32_t numPools,
-            uint32_t numChained,
-            bool testNvm) {
+  // saves the cache in the snapshot format if snapshotConfig is set.
+  // returns the number of bytes saved.
+  size_t test(std::vector<std::pair<std::string, std::string>> items,
+              uint32_t numPools,
+              uint32_t numChained,
+              bool testNvm,
+              std::optional<SnapshotConfig> snapshotConfig = std::nullopt) {
     PersistenceManager manager(config_);
     // setup cache, insert data
     auto evictedKeys = cacheSetup(items, numPools, numChained, testNvm);
@@ -184,17 +187,26 @@ class PersistenceCache {
 
     // persist cache
     MockPersistenceStreamWriter writer(buffer_.get());
-    manager.saveCache(writer);
+    if (snapshotConfig) {
+      manager.saveCache(writer, *snapshotConfig);
+    } else {
+      manager.saveCache(writer);
+    }
 
     // clean up memory and disk cache data
     cacheCleanup();
 
     // restore cache
     MockPersistenceStreamReader reader(buffer_->data(), buffer_->length());
-    manager.restoreCache(reader);
+    if (snapshotConfig) {
+      manager.restoreCache(reader, *snapshotConfig);
+    } else {
+      manager.restoreCache(reader);
+    }
 
     // verify restored cache data
     cacheVerify(items, numChained, evictedKeys);
+    return buffer_->length();
   }
 
   std::vector<std::pair<std::string, std::string>> getKeyValuePairs(
@@ -164,6 +164,98 @@ TEST_F(PersistenceManagerTest, testNvmRaidLarge) {
   cache_.test(cache_.getKeyValuePairs(100 * 1000), 1, 0, true);
 }
 
+TEST_F(PersistenceManagerTest, testSnapshotSmall) {
+  SnapshotConfig snapshotConfig;
+  // chunks smaller than the shm info and hash table segments
+  snapshotConfig.chunkSize = 64 * 1024;
+  // test three items, two pools
+  cache_.test(cache_.getKeyValuePairs(3), 2, 0, false, snapshotConfig);
+}
+
+TEST_F(PersistenceManagerTest, testSnapshotChained) {
+  // test three items, three chained item, uncompressed
+  SnapshotConfig snapshotConfig;
+  snapshotConfig.compressionLevel = 0;
+  cache_.test(cache_.getKeyValuePairs(3), 1, 3, false, snapshotConfig);
+}
+
+TEST_F(PersistenceManagerTest, testSnapshotSize) {
+  // the values are random, so compression only shrinks the hash tables,
+  // which are mostly empty
+  auto items = cache_.getKeyValuePairs(10 * 1000);
+  const auto legacySize = cache_.test(items, 2, 0, false);
+  cache_.cacheCleanup();
+
+  SnapshotConfig snapshotConfig;
+  snapshotConfig.compressionLevel = 0;
+  const auto rawSize = cache_.test(items, 2, 0, false, snapshotConfig);
+  cache_.cacheCleanup();
+
+  snapshotConfig.compressionLevel = 1;
+  snapshotConfig.numThreads = 8;
+  const auto compressedSize = cache_.test(items, 2, 0, false, snapshotConfig);
+
+  // more than half of the slab memory holds no allocations
+  EXPECT_LT(rawSize + cache_.kCacheSize / 2, legacySize);
+  EXPECT_LT(compressedSize, rawSize / 2);
+  XLOGF(INFO, "legacy {} bytes, snapshot {} bytes, compressed {} bytes",
+        legacySize, rawSize, compressedSize);
+}
+
+TEST_F(PersistenceManagerTest, testSnapshotNvmRaid) {
+  LruAllocator::NvmCacheConfig nvmConfig;
+  nvmConfig.navyConfig = utils::getNvmTestConfig(cache_.cacheDir_);
+  util::makeDir(cache_.cacheDir_ + "/navy");
+
+  // non-fullMB navy file size, to get a short last chunk
+  nvmConfig.navyConfig.setSimpleFile("", 0);
+  nvmConfig.navyConfig.setRaidFiles(
+      {cache_.cacheDir_ + "/navy/CACHE0", cache_.cacheDir_ + "/navy/CACHE1"},
+      25 * 1024ULL * 1024ULL - 1, true);
+
+  cache_.config_.enableNvmCache(nvmConfig);
+  // test ten items, three chained item, nvm
+  cache_.test(cache_.getKeyValuePairs(10), 1, 3, true, SnapshotConfig{});
+}
+
+TEST_F(PersistenceManagerTest, testSnapshotCorruption) {
+  PersistenceManager manager(cache_.config_);
+  auto items = cache_.getKeyValuePairs(100);
+  auto evictedKeys = cache_.cacheSetup(items, 1, 0, false);
+  SnapshotConfig snapshotConfig;
+  snapshotConfig.compressionLevel = 0;
+  MockPersistenceStreamWriter writer(cache_.buffer_.get());
+  manager.saveCache(writer, snapshotConfig);
+  cache_.cacheCleanup();
+
+  {
+    // flip the last byte of the last chunk, before the end character
+    auto* data = cache_.buffer_->writableData();
+    const auto length = cache_.buffer_->length();
+    data[length - 2] ^= 0xff;
+    SCOPE_EXIT { data[length - 2] ^= 0xff; };
+    MockPersistenceStreamReader reader(data, length);
+    ASSERT_THROW_WITH_MSG(manager.restoreCache(reader, snapshotConfig),
+                          std::invalid_argument, "invalid checksum");
+  }
+
+  {
+    // a truncated snapshot fails too
+    MockPersistenceStreamReader reader(cache_.buffer_->data(),
+                                       cache_.buffer_->length() - 100);
+    ASSERT_THROW_WITH_MSG(manager.restoreCache(reader, snapshotConfig),
+                          std::invalid_argument, "invalid data");
+  }
+
+  {
+    // restoreCache without a config reads snapshots too
+    MockPersistenceStreamReader reader(cache_.buffer_->data(),
+                                       cache_.buffer_->length());
+    manager.restoreCache(reader);
+    cache_.cacheVerify(items, 0, evictedKeys);
+  }
+}
+
 TEST_F(PersistenceManagerTest, testCompactCache) {
   cache_.config_.enableCompactCache();
 
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//! Compares the per key cost of the single key bindings (`set_or_replace`, `get`) with the
+//! batched ones (`set_or_replace_many`, `get_many`) for a range of batch sizes. Prints the
+//! nanoseconds spent per key for each.
+
+use std::time::Instant;
+
+use anyhow::Result;
+use bytes::Bytes;
+use cachelib::*;
+use fbinit::FacebookInit;
+
+const NUM_KEYS: usize = 100_000;
+const VALUE_SIZE: usize = 256;
+const ROUNDS: usize = 10;
+
+fn ns_per_key(keys: usize, f: impl FnMut() -> Result<()>) -> Result<f64> {
+    let mut f = f;
+    let begin = Instant::now();
+    for _ in 0..ROUNDS {
+        f()?;
+    }
+    Ok(begin.elapsed().as_nanos() as f64 / (keys * ROUNDS) as f64)
+}
+
+#[fbinit::main]
+fn main(fb: FacebookInit) -> Result<()> {
+    init_cache(fb, LruCacheConfig::new(512 * 1024 * 1024))?;
+    let pool = get_or_create_volatile_pool("bench", 256 * 1024 * 1024)?;
+
+    let keys: Vec<Vec<u8>> = (0..NUM_KEYS)
+        .map(|i| format!("key_{}", i).into_bytes())
+        .collect();
+    let value = Bytes::from(vec![b'x'; VALUE_SIZE]);
+
+    println!(
+        "{:<12} {:>14} {:>14}",
+        "batch size", "set ns/key", "get ns/key"
+    );
+    let set = ns_per_key(NUM_KEYS, || {
+        for key in &keys {
+            pool.set_or_replace(key, value.clone())?;
+        }
+        Ok(())
+    })?;
+    let get = ns_per_key(NUM_KEYS, || {
+        for key in &keys {
+            let value = pool.get(key)?;
+            assert!(value.is_some());
+        }
+        Ok(())
+    })?;
+    println!("{:<12} {:>14.1} {:>14.1}", "single", set, get);
+
+    for batch_size in [4, 16, 64, 256] {
+        let set = ns_per_key(NUM_KEYS, || {
+            for batch in keys.chunks(batch_size) {
+                pool.set_or_replace_many(batch.iter().map(|key| (key, &value)))?;
+            }
+            Ok(())
+        })?;
+        let get = ns_per_key(NUM_KEYS, || {
+            for batch in keys.chunks(batch_size) {
+                let values = pool.get_many(batch)?;
+                assert!(values.iter().all(|value| value.is_some()));
+            }
+            Ok(())
+        })?;
+        println!("{:<12} {:>14.1} {:>14.1}", batch_size, set, get);
+    }
+    Ok(())
+}
@@ -19,11 +19,14 @@
 #include <folly/Range.h>
 
 #include <chrono>
+#include <cstring>
+#include <stdexcept>
 
 #include "cachelib/allocator/CacheAllocator.h"
 #include "cachelib/allocator/HitsPerSlabStrategy.h"
 #include "cachelib/allocator/LruTailAgeStrategy.h"
 #include "cachelib/facebook/twutil/TwUtil.h"
+#include "cachelib/rust/src/lib.rs.h"
 
 namespace facebook {
 namespace rust {
@@ -184,6 +187,94 @@ std::unique_ptr<LruItemHandle> find_item(const LruAllocator& cache,
     return std::unique_ptr<LruItemHandle>();
   }
 }
+
+namespace {
+// Walks a buffer of byte strings packed back to back.
+class PackedStrings {
+ public:
+  PackedStrings(rust::Slice<const uint8_t> data, rust::Slice<const size_t> lens)
+      : data_(data), lens_(lens) {}
+
+  size_t size() const { return lens_.size(); }
+
+  folly::StringPiece next() {
+    const auto len = lens_[idx_++];
+    if (offset_ + len > data_.size()) {
+      throw std::out_of_range("packed string out of range");
+    }
+    folly::StringPiece s(reinterpret_cast<const char*>(data_.data()) + offset_,
+                         len);
+    offset_ += len;
+    return s;
+  }
+
+ private:
+  rust::Slice<const uint8_t> data_;
+  rust::Slice<const size_t> lens_;
+  size_t idx_{0};
+  size_t offset_{0};
+};
+} // namespace
+
+std::unique_ptr<LruItemHandleBatch> find_items(
+    const LruAllocator& cache,
+    rust::Slice<const uint8_t> keys,
+    rust::Slice<const size_t> keyLens,
+    rust::Slice<ItemView> views) {
+  PackedStrings packedKeys(keys, keyLens);
+  if (views.size() != packedKeys.size()) {
+    throw std::invalid_argument("one view is needed per key");
+  }
+
+  auto batch = std::make_unique<LruItemHandleBatch>();
+  batch->handles.reserve(packedKeys.size());
+  for (auto& view : views) {
+    auto handle = const_cast<LruAllocator&>(cache).find(packedKeys.next());
+    if (handle) {
+      view.memory = static_cast<const uint8_t*>(handle->getMemory());
+      view.size = handle->getSize();
+      batch->handles.push_back(std::move(handle));
+    } else {
+      view.memory = nullptr;
+      view.size = 0;
+    }
+  }
+  return batch;
+}
+
+void set_items(const LruAllocator& cache,
+               facebook::cachelib::PoolId id,
+               rust::Slice<const uint8_t> keys,
+               rust::Slice<const size_t> keyLens,
+               rust::Slice<const ItemView> values,
+               uint32_t ttlSecs,
+               bool replace,
+               rust::Slice<bool> inserted) {
+  PackedStrings packedKeys(keys, keyLens);
+  if (values.size() != packedKeys.size() ||
+      inserted.size() != packedKeys.size()) {
+    throw std::invalid_argument("one value and result is needed per key");
+  }
+
+  auto& mutableCache = const_cast<LruAllocator&>(cache);
+  for (size_t i = 0; i < values.size(); i++) {
+    const auto key = packedKeys.next();
+    const auto& value = values[i];
+    auto handle = mutableCache.allocate(id, key, value.size, ttlSecs);
+    if (!handle) {
+      inserted[i] = false;
+      continue;
+    }
+    std::memcpy(handle->getMemory(), value.memory, value.size);
+    if (replace) {
+      mutableCache.insertOrReplace(handle);
+      inserted[i] = true;
+    } else {
+      inserted[i] = mutableCache.insert(handle);
+    }
+  }
+}
+
 size_t get_pool_size(const LruAllocator& cache, facebook::cachelib::PoolId id) {
   return cache.getPool(id).getPoolSize();
 }
@@ -18,10 +18,12 @@
 
 #include <chrono>
 #include <memory>
+#include <vector>
 
 #include "cachelib/allocator/CacheAllocator.h"
 #include "cachelib/allocator/RebalanceStrategy.h"
 #include "cachelib/facebook/admin/CacheAdmin.h"
+#include "rust/cxx.h"
 
 namespace facebook {
 namespace rust {
@@ -30,6 +32,15 @@ using LruAllocator = facebook::cachelib::LruAllocator;
 using LruAllocatorConfig = LruAllocator::Config;
 using LruItemHandle = LruAllocator::WriteHandle;
 
+// Defined by the bridge in lib.rs.
+struct ItemView;
+
+// Read handles of the items found by one find_items() call. The memory the
+// item views point to stays valid as long as the batch is alive.
+struct LruItemHandleBatch {
+  std::vector<LruAllocator::ReadHandle> handles;
+};
+
 std::unique_ptr<facebook::cachelib::CacheAdmin> make_cacheadmin(
     LruAllocator& cache, const std::string& oncall);
 std::unique_ptr<LruAllocator> make_lru_allocator(
@@ -106,6 +117,28 @@ void insert_or_replace_handle(const LruAllocator& cache, LruItemHandle& handle);
 void remove_item(const LruAllocator& cache, folly::StringPiece key);
 std::unique_ptr<LruItemHandle> find_item(const LruAllocator& cache,
                                          folly::StringPiece key);
+
+// Looks up the keys packed back to back in keys, with the length of each in
+// keyLens, and fills views with the memory and size of the values found. The
+// memory of a missing key is null.
+std::unique_ptr<LruItemHandleBatch> find_items(
+    const LruAllocator& cache,
+    rust::Slice<const uint8_t> keys,
+    rust::Slice<const size_t> keyLens,
+    rust::Slice<ItemView> views);
+// Allocates, fills and inserts an item for each key, packed like the keys of
+// find_items(), and the value in values at the same index. Existing keys are
+// replaced if replace is set. inserted tells for every key whether its value
+// made it into the cache.
+void set_items(const LruAllocator& cache,
+               facebook::cachelib::PoolId id,
+               rust::Slice<const uint8_t> keys,
+               rust::Slice<const size_t> keyLens,
+               rust::Slice<const ItemView> values,
+               uint32_t ttlSecs,
+               bool replace,
+               rust::Slice<bool> inserted);
+
 size_t get_pool_size(const LruAllocator& cache, facebook::cachelib::PoolId id);
 bool grow_pool(const LruAllocator& cache,
                facebook::cachelib::PoolId id,
@@ -37,6 +37,13 @@ mod ffi {
         type StringPiece<'a> = folly::StringPiece<'a>;
     }
 
+    /// The memory and size of a value, passed to and from the batched calls. The memory of a
+    /// key that `find_items` did not find is null.
+    struct ItemView {
+        memory: *const u8,
+        size: usize,
+    }
+
     unsafe extern "C++" {
         include!("cachelib/rust/src/cachelib.h");
 
@@ -152,6 +159,24 @@ mod ffi {
             key: StringPiece<'_>,
         ) -> Result<UniquePtr<LruItemHandle>>;
 
+        type LruItemHandleBatch;
+        fn find_items(
+            cache: &LruAllocator,
+            keys: &[u8],
+            key_lens: &[usize],
+            views: &mut [ItemView],
+        ) -> Result<UniquePtr<LruItemHandleBatch>>;
+        fn set_items(
+            cache: &LruAllocator,
+            id: i8,
+            keys: &[u8],
+            key_lens: &[usize],
+            values: &[ItemView],
+            ttl_secs: u32,
+            replace: bool,
+            inserted: &mut [bool],
+        ) -> Result<()>;
+
         fn get_pool_size(cache: &LruAllocator, pool: i8) -> Result<usize>;
         fn grow_pool(cache: &LruAllocator, pool: i8, size: usize) -> Result<bool>;
         fn shrink_pool(cache: &LruAllocator, pool: i8, size: usize) -> Result<bool>;
@@ -679,6 +679,67 @@ impl<'a> LruCacheRemoteHandle<'a> {
     }
 }
 
+// Cachelib uses a 0 TTL for "infinite". Turn larger than 2**32 seconds
+// into 2**32, and no TTL into infinite
+// If you ask for a TTL less than 1 second, turn it into 1 second
+fn ttl_to_secs(ttl: Option<Duration>) -> u32 {
+    ttl.map_or(0, |d| std::cmp::max(d.as_secs(), 1))
+        .try_into()
+        .unwrap_or(u32::MAX)
+}
+
+// Pack the pool prefixed keys back to back into one buffer, so that a batch of keys crosses the
+// FFI boundary as two slices.
+fn pack_keys<K>(prefix: &[u8], keys: impl IntoIterator<Item = K>) -> (Vec<u8>, Vec<usize>)
+where
+    K: AsRef<[u8]>,
+{
+    let mut packed = Vec::new();
+    let mut lens = Vec::new();
+    for key in keys {
+        packed.extend_from_slice(prefix);
+        packed.extend_from_slice(key.as_ref());
+        lens.push(prefix.len() + key.as_ref().len());
+    }
+    (packed, lens)
+}
+
+/// The values found by `get_many`, in the order of the keys asked for.
+///
+/// The values are read in place in the cache memory, without copying. Every value found is pinned
+/// in the cache until the batch is dropped, so do not hold onto it for longer than necessary.
+pub struct LruCacheHandleBatch {
+    _handles: cxx::UniquePtr<ffi::LruItemHandleBatch>,
+    views: Vec<ffi::ItemView>,
+}
+
+impl LruCacheHandleBatch {
+    /// The number of keys looked up
+    pub fn len(&self) -> usize {
+        self.views.len()
+    }
+
+    /// True if no keys were looked up
+    pub fn is_empty(&self) -> bool {
+        self.views.is_empty()
+    }
+
+    /// Get the value of the key at index, or None if the key was not found
+    pub fn get(&self, index: usize) -> Option<&[u8]> {
+        let view = self.views.get(index)?;
+        if view.memory.is_null() {
+            None
+        } else {
+            Some(unsafe { slice::from_raw_parts(view.memory, view.size) })
+        }
+    }
+
+    /// Iterate over the values in the order of the keys
+    pub fn iter(&self) -> impl Iterator<Item = Option<&[u8]>> + '_ {
+        (0..self.len()).map(move |index| self.get(index))
+    }
+}
+
 /// An LRU cache pool
 ///
 /// There are two interfaces to the cache, depending on the complexity of your use case:
@@ -688,6 +749,9 @@ impl<'a> LruCacheRemoteHandle<'a> {
 /// The simple `get`/`set` interface involves multiple copies of data, but protects you from making mistakes
 /// The `allocate`/`insert_handle`/`get_handle` interface allows you to pin data in the cache by mistake,
 /// but allows you to avoid copying into and out of the cache.
+///
+/// `get_many`/`set_many` look up or insert a batch of keys with a single call into cachelib,
+/// which is cheaper per key than the calls above. `get_many` reads the values in place.
 #[derive(Clone)]
 pub struct LruCachePool {
     pool: i8,
@@ -714,13 +778,7 @@ impl LruCachePool {
         let mut full_key = self.pool_name.clone().into_bytes();
         full_key.extend_from_slice(key.as_ref());
         let key = StringPiece::from(full_key.as_slice());
-        // Cachelib uses a 0 TTL for "infinite". Turn larger than 2**32 seconds
-        // into 2**32, and no TTL into infinite
-        // If you ask for a TTL less than 1 second, turn it into 1 second
-        let ttl_secs = ttl
-            .map_or(0, |d| std::cmp::min(d.as_secs(), 1))
-            .try_into()
-            .unwrap_or(u32::MAX);
+        let ttl_secs = ttl_to_secs(ttl);
         let size = size.try_into().context("Cache allocation too large")?;
         let handle = ffi::allocate_item(cache, self.pool, key, size, ttl_secs)?;
         if handle.is_null() {
@@ -909,6 +967,112 @@ impl LruCachePool {
         }
     }
 
+    /// Fetch the values for a batch of keys. The values are borrowed from the returned batch,
+    /// which keeps them pinned in the cache until it is dropped.
+    pub fn get_many<K>(&self, keys: impl IntoIterator<Item = K>) -> Result<LruCacheHandleBatch>
+    where
+        K: AsRef<[u8]>,
+    {
+        let cache = get_global_cache()?.get_allocator()?;
+        let (keys, key_lens) = pack_keys(self.pool_name.as_bytes(), keys);
+        let mut views: Vec<_> = key_lens
+            .iter()
+            .map(|_| ffi::ItemView {
+                memory: std::ptr::null(),
+                size: 0,
+            })
+            .collect();
+        let handles = ffi::find_items(cache, &keys, &key_lens, &mut views)?;
+
+        Ok(LruCacheHandleBatch {
+            _handles: handles,
+            views,
+        })
+    }
+
+    fn set_items<K, V>(
+        &self,
+        items: impl IntoIterator<Item = (K, V)>,
+        ttl: Option<Duration>,
+        replace: bool,
+    ) -> Result<Vec<bool>>
+    where
+        K: AsRef<[u8]>,
+        V: AsRef<[u8]>,
+    {
+        let cache = get_global_cache()?.get_allocator()?;
+        let (keys, values): (Vec<K>, Vec<V>) = items.into_iter().unzip();
+        let (keys, key_lens) = pack_keys(self.pool_name.as_bytes(), keys);
+        let views: Vec<_> = values
+            .iter()
+            .map(|value| ffi::ItemView {
+                memory: value.as_ref().as_ptr(),
+                size: value.as_ref().len(),
+            })
+            .collect();
+        let mut inserted = vec![false; views.len()];
+        ffi::set_items(
+            cache,
+            self.pool,
+            &keys,
+            &key_lens,
+            &views,
+            ttl_to_secs(ttl),
+            replace,
+            &mut inserted,
+        )?;
+        Ok(inserted)
+    }
+
+    /// Insert a batch of key->value mappings into the pool. Returns whether each insertion was
+    /// successful, in the order of the items. This will not overwrite existing data.
+    pub fn set_many_with_ttl<K, V>(
+        &self,
+        items: impl IntoIterator<Item = (K, V)>,
+        ttl: Option<Duration>,
+    ) -> Result<Vec<bool>>
+    where
+        K: AsRef<[u8]>,
+        V: AsRef<[u8]>,
+    {
+        self.set_items(items, ttl, false)
+    }
+
+    /// As set_many_with_ttl, but sets the TTL to infinite
+    pub fn set_many<K, V>(&self, items: impl IntoIterator<Item = (K, V)>) -> Result<Vec<bool>>
+    where
+        K: AsRef<[u8]>,
+        V: AsRef<[u8]>,
+    {
+        self.set_items(items, None, false)
+    }
+
+    /// Insert a batch of key->value mappings into the pool. Returns whether each insertion was
+    /// successful, in the order of the items. This will overwrite existing data.
+    pub fn set_or_replace_many_with_ttl<K, V>(
+        &self,
+        items: impl IntoIterator<Item = (K, V)>,
+        ttl: Option<Duration>,
+    ) -> Result<Vec<bool>>
+    where
+        K: AsRef<[u8]>,
+        V: AsRef<[u8]>,
+    {
+        self.set_items(items, ttl, true)
+    }
+
+    /// As set_or_replace_many_with_ttl, but sets the TTL to infinite
+    pub fn set_or_replace_many<K, V>(
+        &self,
+        items: impl IntoIterator<Item = (K, V)>,
+    ) -> Result<Vec<bool>>
+    where
+        K: AsRef<[u8]>,
+        V: AsRef<[u8]>,
+    {
+        self.set_items(items, None, true)
+    }
+
     /// Remove the value for a key. Returns true is successful
     pub fn remove<K>(&self, key: K) -> Result<()>
     where
@@ -1091,6 +1255,37 @@ impl VolatileLruCachePool {
         self.inner.get(key)
     }
 
+    /// Fetch the values for a batch of keys. See `LruCachePool::get_many`
+    pub fn get_many<K>(&self, keys: impl IntoIterator<Item = K>) -> Result<LruCacheHandleBatch>
+    where
+        K: AsRef<[u8]>,
+    {
+        self.inner.get_many(keys)
+    }
+
+    /// Insert a batch of key->value mappings into the pool without overwriting existing data.
+    /// See `LruCachePool::set_many`
+    pub fn set_many<K, V>(&self, items: impl IntoIterator<Item = (K, V)>) -> Result<Vec<bool>>
+    where
+        K: AsRef<[u8]>,
+        V: AsRef<[u8]>,
+    {
+        self.inner.set_many(items)
+    }
+
+    /// Insert a batch of key->value mappings into the pool, overwriting existing data.
+    /// See `LruCachePool::set_or_replace_many`
+    pub fn set_or_replace_many<K, V>(
+        &self,
+        items: impl IntoIterator<Item = (K, V)>,
+    ) -> Result<Vec<bool>>
+    where
+        K: AsRef<[u8]>,
+        V: AsRef<[u8]>,
+    {
+        self.inner.set_or_replace_many(items)
+    }
+
     /// Return the current size of this pool
     pub fn get_size(&self) -> Result<usize> {
         self.inner.get_size()
@@ -1233,6 +1428,45 @@ mod test {
         );
     }
 
+    #[test]
+    fn ttl_to_secs_rounds_up_to_one_second() {
+        assert_eq!(ttl_to_secs(None), 0);
+        assert_eq!(ttl_to_secs(Some(Duration::from_millis(10))), 1);
+        assert_eq!(ttl_to_secs(Some(Duration::from_secs(30))), 30);
+        assert_eq!(
+            ttl_to_secs(Some(Duration::from_secs(u64::from(u32::MAX) + 1))),
+            u32::MAX
+        );
+    }
+
+    #[fbinit::test]
+    fn set_item_with_ttl(fb: FacebookInit) {
+        create_cache(fb);
+
+        let pool = get_or_create_volatile_pool("set_item_with_ttl", 4 * 1024 * 1024)
+            .unwrap()
+            .inner;
+
+        assert!(
+            pool.set_with_ttl(
+                b"rimmer",
+                Bytes::from(b"I am a fish".as_ref()),
+                Some(Duration::from_secs(2)),
+            )
+            .unwrap(),
+            "Set failed"
+        );
+        // a multi-second TTL must not be cut short to a second. Expiry has
+        // second granularity, so the item can only have expired once the
+        // clock passed two full seconds after its creation.
+        std::thread::sleep(Duration::from_millis(1500));
+        assert_eq!(
+            pool.get(b"rimmer").unwrap(),
+            Some(Bytes::from(b"I am a fish".as_ref())),
+            "Item expired early"
+        );
+    }
+
     #[fbinit::test]
     fn set_or_replace_item(fb: FacebookInit) {
         // Insert only, and confirm insert success
@@ -1303,6 +1537,49 @@ mod test {
         );
     }
 
+    #[fbinit::test]
+    fn set_many_and_get_many(fb: FacebookInit) -> Result<()> {
+        // Set a batch of items, including a duplicate key, and fetch them back in a batch
+        // together with a key that was never set
+        create_cache(fb);
+
+        let pool = get_or_create_volatile_pool("set_many", 4 * 1024 * 1024)?;
+
+        let items: [(&[u8], &[u8]); 3] = [
+            (b"rimmer", b"I am a fish"),
+            (b"lister", b"smoke me a kipper"),
+            (b"rimmer", b"I am not a fish"),
+        ];
+        let inserted = pool.set_many(items)?;
+        assert_eq!(inserted, vec![true, true, false], "Set failed");
+
+        let inserted = pool.set_or_replace_many([(b"lister", b"better than life")])?;
+        assert_eq!(inserted, vec![true], "Replace failed");
+
+        let keys: [&[u8]; 3] = [b"rimmer", b"cat", b"lister"];
+        let batch = pool.get_many(keys)?;
+        assert_eq!(batch.len(), 3);
+        assert_eq!(batch.get(0), Some(b"I am a fish".as_ref()), "Fetch failed");
+        assert_eq!(batch.get(1), None, "Successfully fetched a bad value");
+        assert_eq!(
+            batch.get(2),
+            Some(b"better than life".as_ref()),
+            "Fetch failed"
+        );
+        assert_eq!(batch.get(3), None, "Fetched past the end of the batch");
+
+        // The values stay readable while the batch pins them
+        pool.remove(b"rimmer")?;
+        assert_eq!(
+            batch.get(0),
+            Some(b"I am a fish".as_ref()),
+            "Value unpinned"
+        );
+        assert_eq!(pool.get(b"rimmer")?, None, "Remove failed");
+
+        Ok(())
+    }
+
     #[fbinit::test]
     fn find_pool_by_name(fb: FacebookInit) -> Result<()> {
         create_cache(fb);
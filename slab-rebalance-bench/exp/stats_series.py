@@ -0,0 +1,98 @@
+"""
+Reader for the binary stats series cachebench writes with statsSeriesFile.
+See cachelib/common/StatsSeries.h for the layout.
+
+    df = read_stats_series("stats.bin")
+    class_stats = df[df["kind"] == "class_stats"]
+"""
+import struct
+import sys
+
+import numpy as np
+import pandas as pd
+
+MAGIC = b"CLSTATS1"
+VERSION = 1
+
+KINDS = {
+    0: "miss_ratio",
+    1: "class_stats",
+    2: "delta_stats",
+    3: "slab_move",
+    4: "rebalance",
+}
+
+# names of the value columns of each kind, in order
+VALUE_NAMES = {
+    "miss_ratio": ["miss_ratio", "misses", "gets"],
+    "class_stats": ["hits", "evictions", "tail_hits", "slabs",
+                    "eviction_age", "items"],
+    "delta_stats": ["tail_age", "marginal_hits", "hits", "evictions",
+                    "hits_per_slab", "miss_estimation", "slabs",
+                    "free_memory"],
+    "slab_move": ["victim_slabs", "receiver_slabs", "victim_eviction_age",
+                  "receiver_eviction_age", "release_ms"],
+    "rebalance": [],
+}
+
+
+def read_stats_series(path):
+    """
+    Returns a DataFrame with one row per record and the columns request_id,
+    kind, pool_id, class_id, other_class_id and v0..v7. Use value_columns()
+    to name the values of one kind.
+    """
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:8] != MAGIC:
+        raise ValueError(f"{path} is not a stats series file")
+    version, num_values = struct.unpack_from("<II", data, 8)
+    if version != VERSION:
+        raise ValueError(f"{path}: unsupported stats series version {version}")
+
+    columns = {"request_id": [], "kind": [], "pool_id": [], "class_id": [],
+               "other_class_id": []}
+    values = [[] for _ in range(num_values)]
+    offset = 16
+    while offset < len(data):
+        (n,) = struct.unpack_from("<Q", data, offset)
+        offset += 8
+        for name, dtype in [("request_id", "<u8"), ("kind", "u1"),
+                            ("pool_id", "i1"), ("class_id", "i1"),
+                            ("other_class_id", "i1")]:
+            col = np.frombuffer(data, dtype=dtype, count=n, offset=offset)
+            columns[name].append(col)
+            offset += col.nbytes
+        for j in range(num_values):
+            col = np.frombuffer(data, dtype="<f8", count=n, offset=offset)
+            values[j].append(col)
+            offset += col.nbytes
+
+    def concat(chunks, dtype):
+        return np.concatenate(chunks) if chunks else np.empty(0, dtype=dtype)
+
+    df = pd.DataFrame({
+        "request_id": concat(columns["request_id"], "<u8"),
+        "kind": pd.Categorical.from_codes(
+            concat(columns["kind"], "u1"), categories=list(KINDS.values())),
+        "pool_id": concat(columns["pool_id"], "i1"),
+        "class_id": concat(columns["class_id"], "i1"),
+        "other_class_id": concat(columns["other_class_id"], "i1"),
+    })
+    for j in range(num_values):
+        df[f"v{j}"] = concat(values[j], "<f8")
+    return df
+
+
+def value_columns(df, kind):
+    """Rows of one kind with the value columns renamed, unused ones dropped."""
+    names = VALUE_NAMES[kind]
+    rows = df[df["kind"] == kind]
+    rows = rows.rename(columns={f"v{j}": name for j, name in enumerate(names)})
+    unused = [c for c in rows.columns if c.startswith("v") and c[1:].isdigit()]
+    return rows.drop(columns=unused).reset_index(drop=True)
+
+
+if __name__ == "__main__":
+    df = read_stats_series(sys.argv[1])
+    print(df["kind"].value_counts().to_string())
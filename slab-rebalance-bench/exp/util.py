@@ -125,4 +125,33 @@ def run_cachebench(top_dir, repeat=1):
     # If all runs succeed, write last return code (should be 0)
     with open(rc_file, 'w') as rc_out:
         rc_out.write(str(result.returncode) + "\n")
-    return result.returncode
\ No newline at end of file
+    return result.returncode
+
+def run_cachebench_sweep(top_dirs):
+    """Run several experiment dirs that replay the same trace in one
+    cachebench process. Each dir gets the same result.json, tx.*.json,
+    log.txt and rc.txt as with run_cachebench."""
+    slab_sizes = set()
+    use_trace_timer = False
+    for top_dir in top_dirs:
+        with open(os.path.join(top_dir, "meta.json"), 'r') as f:
+            slab_sizes.add(int(json.load(f)["slab_size"]))
+        with open(os.path.join(top_dir, "config.json"), 'r') as f:
+            use_trace_timer |= bool(json.load(f)["test_config"]["useTraceTimer"])
+    if len(slab_sizes) != 1:
+        raise ValueError(f"Sweep mixes slab sizes {sorted(slab_sizes)}")
+
+    cachelib_path = CACHEBENCH_BINARY_PATH2 if slab_sizes.pop() == 1 else CACHEBENCH_BINARY_PATH
+    command = [
+        cachelib_path,
+        "--sweep_dirs", ",".join(top_dirs),
+    ]
+    if use_trace_timer:
+        command.insert(0, f'MOCK_TIMER_LIB_PATH="{MOCK_TIMER_PATH}"')
+
+    result = subprocess.run(" ".join(command), shell=True)
+    # the sweep passes or fails as a whole
+    for top_dir in top_dirs:
+        with open(os.path.join(top_dir, "rc.txt"), 'w') as rc_out:
+            rc_out.write(str(result.returncode) + "\n")
+    return result.returncode